@@ -0,0 +1,289 @@
+//
+//  SKPDFSyncParser.c
+//  Skim
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SKPDFSyncParser.h"
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the number of digits that always fit in the mantissa
+#define MAX_DIGITS 18
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline bool isNewline(char c) {
+    return c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static inline bool isDigit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+static inline const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p))
+        p++;
+    return p;
+}
+
+static inline const char *lineEnd(const char *p, const char *end) {
+    while (p < end && isNewline(*p) == false)
+        p++;
+    return p;
+}
+
+static inline const char *skipNewlines(const char *p, const char *end) {
+    while (p < end && isNewline(*p))
+        p++;
+    return p;
+}
+
+// leading spaces and a sign are allowed, like for NSScanner; values that are too large saturate
+static bool scanInteger(const char **pp, const char *end, long *value) {
+    const char *p = skipSpaces(*pp, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end || isDigit(*p) == false)
+        return false;
+    uint64_t n = 0;
+    int digits = 0;
+    for (; p < end && isDigit(*p); p++) {
+        if (digits++ < MAX_DIGITS)
+            n = 10 * n + (uint64_t)(*p - '0');
+        else
+            n = (uint64_t)LONG_MAX;
+    }
+    if (n > (uint64_t)LONG_MAX)
+        n = (uint64_t)LONG_MAX;
+    if (value)
+        *value = negative ? -(long)n : (long)n;
+    *pp = p;
+    return true;
+}
+
+// decimal numbers with an optional exponent, like for NSScanner, extra digits beyond the precision of the mantissa are dropped
+static bool scanNumber(const char **pp, const char *end, double *value) {
+    static const double powersOf10[MAX_DIGITS + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+    const char *p = skipSpaces(*pp, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    uint64_t n = 0;
+    int digits = 0, scale = 0, fractionDigits = 0;
+    bool hasDigits = false;
+    for (; p < end && isDigit(*p); p++) {
+        hasDigits = true;
+        if (n == 0 && *p == '0')
+            continue;
+        if (digits < MAX_DIGITS) {
+            n = 10 * n + (uint64_t)(*p - '0');
+            digits++;
+        } else {
+            scale++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            hasDigits = true;
+            if (n == 0 && *p == '0') {
+                // leading zeros only shift the digits
+                if (fractionDigits < 100000)
+                    fractionDigits++;
+            } else if (digits < MAX_DIGITS) {
+                n = 10 * n + (uint64_t)(*p - '0');
+                digits++;
+                fractionDigits++;
+            }
+        }
+    }
+    if (hasDigits == false)
+        return false;
+    int exponent = scale - fractionDigits;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        // an exponent without digits is not part of the number
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++) {
+                if (e < 100000)
+                    e = 10 * e + (*q - '0');
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+    double d = (double)n;
+    if (exponent > 0)
+        d *= exponent <= MAX_DIGITS ? powersOf10[exponent] : pow(10.0, exponent);
+    else if (exponent < 0)
+        d /= -exponent <= MAX_DIGITS ? powersOf10[-exponent] : pow(10.0, -exponent);
+    *value = negative ? -d : d;
+    *pp = p;
+    return true;
+}
+
+static inline bool scanKeyword(const char **pp, const char *end, const char *keyword, size_t length) {
+    const char *p = skipSpaces(*pp, end);
+    size_t i;
+    if ((size_t)(end - p) < length)
+        return false;
+    // NSScanner is case insensitive by default
+    for (i = 0; i < length; i++) {
+        if ((p[i] | 0x20) != keyword[i])
+            return false;
+    }
+    *pp = p + length;
+    return true;
+}
+
+bool SKPDFSyncParseBytes(const char *bytes, size_t length, SKPDFSyncParserCallback callback, void *context) {
+    const char *p = bytes, *end = bytes + length;
+    SKPDFSyncParserRecord record;
+    
+    memset(&record, 0, sizeof(SKPDFSyncParserRecord));
+    
+    // the first line has the main source file, followed by the version, which we ignore
+    const char *file = skipSpaces(p, end);
+    p = lineEnd(file, end);
+    if (p == file || p == end)
+        return false;
+    record.type = SKPDFSyncRecordTypeOpenFile;
+    record.file = file;
+    record.fileLength = (size_t)(p - file);
+    p = skipNewlines(p, end);
+    if (scanKeyword(&p, end, "version", 7) == false || scanInteger(&p, end, NULL) == false)
+        return false;
+    if (callback(&record, context) == false)
+        return false;
+    p = skipNewlines(lineEnd(p, end), end);
+    
+    while (p < end) {
+        p = skipSpaces(p, end);
+        if (p == end)
+            break;
+        
+        record.file = NULL;
+        record.fileLength = 0;
+        
+        switch (*p++) {
+            case 'l':
+                if (scanInteger(&p, end, &record.recordIndex) && scanInteger(&p, end, &record.line)) {
+                    // we ignore the column
+                    record.type = SKPDFSyncRecordTypeLine;
+                    if (callback(&record, context) == false)
+                        return false;
+                }
+                break;
+            case 'p':
+                // we ignore * and + modifiers
+                p = skipSpaces(p, end);
+                if (p < end && (*p == '*' || *p == '+'))
+                    p++;
+                if (scanInteger(&p, end, &record.recordIndex) && scanNumber(&p, end, &record.x) && scanNumber(&p, end, &record.y)) {
+                    record.type = SKPDFSyncRecordTypePoint;
+                    if (callback(&record, context) == false)
+                        return false;
+                }
+                break;
+            case 's':
+                // start of a new page
+                if (scanInteger(&p, end, &record.line) == false)
+                    record.line = SKPDFSyncNoPageNumber;
+                record.type = SKPDFSyncRecordTypePage;
+                if (callback(&record, context) == false)
+                    return false;
+                break;
+            case '(':
+                // start of a new source file
+                file = skipSpaces(p, end);
+                p = lineEnd(file, end);
+                if (p > file) {
+                    record.type = SKPDFSyncRecordTypeOpenFile;
+                    record.file = file;
+                    record.fileLength = (size_t)(p - file);
+                    if (callback(&record, context) == false)
+                        return false;
+                }
+                break;
+            case ')':
+                // closing of a source file
+                record.type = SKPDFSyncRecordTypeCloseFile;
+                if (callback(&record, context) == false)
+                    return false;
+                break;
+            default:
+                // shouldn't reach
+                break;
+        }
+        
+        p = skipNewlines(lineEnd(p, end), end);
+    }
+    
+    return true;
+}
+
+bool SKPDFSyncParseFile(const char *path, SKPDFSyncParserCallback callback, void *context) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    
+    bool rv = false;
+    struct stat sb;
+    
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+        size_t length = (size_t)sb.st_size;
+        void *bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (bytes != MAP_FAILED) {
+            madvise(bytes, length, MADV_SEQUENTIAL);
+            rv = SKPDFSyncParseBytes((const char *)bytes, length, callback, context);
+            munmap(bytes, length);
+        }
+    }
+    
+    close(fd);
+    return rv;
+}
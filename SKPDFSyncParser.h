@@ -0,0 +1,80 @@
+//
+//  SKPDFSyncParser.h
+//  Skim
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SKPDFSyncRecordTypeLine,       // l recordIndex line [column]
+    SKPDFSyncRecordTypePoint,      // p recordIndex x y, also p* and p+
+    SKPDFSyncRecordTypePage,       // s pageNumber
+    SKPDFSyncRecordTypeOpenFile,   // ( file, also the main file on the first line
+    SKPDFSyncRecordTypeCloseFile   // )
+} SKPDFSyncRecordType;
+
+// used as the line of a page record without a page number
+#define SKPDFSyncNoPageNumber LONG_MIN
+
+typedef struct _SKPDFSyncParserRecord {
+    SKPDFSyncRecordType type;
+    long recordIndex;
+    long line;          // the page number for a page record
+    double x;           // in pdfsync units
+    double y;
+    const char *file;   // not NUL terminated, points into the parsed bytes
+    size_t fileLength;
+} SKPDFSyncParserRecord;
+
+// return false to stop parsing
+typedef bool (*SKPDFSyncParserCallback)(const SKPDFSyncParserRecord *record, void *context);
+
+// Parses the UTF-8 bytes of a pdfsync file, calling the callback for every record in the order of the file.
+// Returns false when the header is missing or when the callback stopped the parsing.
+extern bool SKPDFSyncParseBytes(const char *bytes, size_t length, SKPDFSyncParserCallback callback, void *context);
+
+// Maps the file at path and parses its bytes.
+extern bool SKPDFSyncParseFile(const char *path, SKPDFSyncParserCallback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,5 @@
 //
-//  SKPDFSyncRecord.m
+//  SKPDFSyncRecords.h
 //  Skim
 //
 //  Created by Christiaan Hofman on 7/12/08.
@@ -36,38 +36,47 @@
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#import "SKPDFSyncRecord.h"
-#import "NSPointerArray_SKExtensions.h"
+#import <Cocoa/Cocoa.h>
 
+typedef struct _SKPDFSyncLineEntry SKPDFSyncLineEntry;
+typedef struct _SKPDFSyncPageEntry SKPDFSyncPageEntry;
 
-@implementation SKPDFSyncRecord
+// Stores the records of a pdfsync file as parallel arrays, indexed by the order in which records were first seen.
+// The entries for lines and pages refer to these positions, and are sorted by -sortRecords before any lookup.
+@interface SKPDFSyncRecords : NSObject {
+    NSUInteger count;
+    NSUInteger capacity;
+    NSInteger *recordIndexes;
+    NSUInteger *fileIDs;
+    NSInteger *lines;
+    NSUInteger *pageIndexes;
+    CGFloat *xs;
+    CGFloat *ys;
+    NSMapTable *positions;
+    
+    NSUInteger numberOfPages;
+    
+    SKPDFSyncLineEntry *lineEntries;
+    NSUInteger lineEntryCount;
+    NSUInteger lineEntryCapacity;
+    SKPDFSyncPageEntry *pageEntries;
+    NSUInteger pageEntryCount;
+    NSUInteger pageEntryCapacity;
+}
 
-@synthesize recordIndex, pageIndex, point, file, line;
-@dynamic x, y;
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic) NSUInteger numberOfPages;
 
-- (id)initWithRecordIndex:(NSInteger)aRecordIndex {
-    self = [super init];
-    if (self) {
-        recordIndex = aRecordIndex;
-        pageIndex = NSNotFound;
-        point = NSZeroPoint;
-        file = nil;
-        line = -1;
-    }
-    return self;
-}
+- (void)removeAllRecords;
 
-- (void)dealloc {
-    SKDESTROY(file);
-    [super dealloc];
-}
+// adds the record to the lines of the file, unless fileID is NSNotFound
+- (void)setLine:(NSInteger)line fileID:(NSUInteger)fileID forRecordIndex:(NSInteger)recordIndex;
+// adds the record to the last page
+- (void)setPoint:(NSPoint)point forRecordIndex:(NSInteger)recordIndex;
 
-- (CGFloat)x {
-    return point.x;
-}
+- (void)sortRecords;
 
-- (CGFloat)y {
-    return point.y;
-}
+- (BOOL)getLine:(NSInteger *)linePtr fileID:(NSUInteger *)fileIDPtr forLocation:(NSPoint)point inRect:(NSRect)rect atPageIndex:(NSUInteger)pageIndex;
+- (BOOL)getPageIndex:(NSUInteger *)pageIndexPtr location:(NSPoint *)pointPtr forLine:(NSInteger)line fileID:(NSUInteger)fileID;
 
 @end
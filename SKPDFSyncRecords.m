@@ -0,0 +1,349 @@
+//
+//  SKPDFSyncRecords.m
+//  Skim
+//
+//  Created by Christiaan Hofman on 7/12/08.
+/*
+ This software is Copyright (c) 2008-2023
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "SKPDFSyncRecords.h"
+
+struct _SKPDFSyncLineEntry {
+    NSUInteger fileID;
+    NSInteger line;
+    NSUInteger order;
+    NSUInteger position;
+};
+
+struct _SKPDFSyncPageEntry {
+    NSUInteger pageIndex;
+    CGFloat y;
+    CGFloat x;
+    NSUInteger order;
+    NSUInteger position;
+};
+
+static void *growBuffer(void *buffer, NSUInteger *capacityPtr, NSUInteger minCapacity, size_t size) {
+    if (minCapacity <= *capacityPtr)
+        return buffer;
+    NSUInteger newCapacity = MAX(*capacityPtr * 2, MAX(minCapacity, (NSUInteger)64));
+    void *newBuffer = NSZoneRealloc(NSDefaultMallocZone(), buffer, newCapacity * size);
+    *capacityPtr = newCapacity;
+    return newBuffer;
+}
+
+// lines ascending, equal lines keep the order of the file
+static int compareLineEntries(const void *p1, const void *p2) {
+    const SKPDFSyncLineEntry *e1 = p1, *e2 = p2;
+    if (e1->fileID != e2->fileID)
+        return e1->fileID < e2->fileID ? -1 : 1;
+    if (e1->line != e2->line)
+        return e1->line < e2->line ? -1 : 1;
+    return e1->order < e2->order ? -1 : e1->order > e2->order;
+}
+
+// top to bottom, then left to right, equal points keep the order of the file
+static int comparePageEntries(const void *p1, const void *p2) {
+    const SKPDFSyncPageEntry *e1 = p1, *e2 = p2;
+    if (e1->pageIndex != e2->pageIndex)
+        return e1->pageIndex < e2->pageIndex ? -1 : 1;
+    if (e1->y != e2->y)
+        return e1->y > e2->y ? -1 : 1;
+    if (e1->x != e2->x)
+        return e1->x < e2->x ? -1 : 1;
+    return e1->order < e2->order ? -1 : e1->order > e2->order;
+}
+
+@implementation SKPDFSyncRecords
+
+@synthesize count, numberOfPages;
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        count = 0;
+        capacity = 0;
+        recordIndexes = NULL;
+        fileIDs = NULL;
+        lines = NULL;
+        pageIndexes = NULL;
+        xs = NULL;
+        ys = NULL;
+        positions = NSCreateMapTable(NSIntegerMapKeyCallBacks, NSIntegerMapValueCallBacks, 0);
+        numberOfPages = 0;
+        lineEntries = NULL;
+        lineEntryCount = 0;
+        lineEntryCapacity = 0;
+        pageEntries = NULL;
+        pageEntryCount = 0;
+        pageEntryCapacity = 0;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    NSZoneFree(NSDefaultMallocZone(), recordIndexes);
+    NSZoneFree(NSDefaultMallocZone(), fileIDs);
+    NSZoneFree(NSDefaultMallocZone(), lines);
+    NSZoneFree(NSDefaultMallocZone(), pageIndexes);
+    NSZoneFree(NSDefaultMallocZone(), xs);
+    NSZoneFree(NSDefaultMallocZone(), ys);
+    NSZoneFree(NSDefaultMallocZone(), lineEntries);
+    NSZoneFree(NSDefaultMallocZone(), pageEntries);
+    if (positions) NSFreeMapTable(positions);
+    positions = NULL;
+    [super dealloc];
+}
+
+- (void)removeAllRecords {
+    NSResetMapTable(positions);
+    count = 0;
+    numberOfPages = 0;
+    lineEntryCount = 0;
+    pageEntryCount = 0;
+}
+
+- (NSUInteger)positionForRecordIndex:(NSInteger)recordIndex {
+    NSUInteger position = (NSUInteger)NSMapGet(positions, (const void *)recordIndex);
+    if (position == 0) {
+        if (count == capacity) {
+            NSUInteger newCapacity = capacity;
+            recordIndexes = growBuffer(recordIndexes, &newCapacity, count + 1, sizeof(NSInteger));
+            fileIDs = (NSUInteger *)NSZoneRealloc(NSDefaultMallocZone(), fileIDs, newCapacity * sizeof(NSUInteger));
+            lines = (NSInteger *)NSZoneRealloc(NSDefaultMallocZone(), lines, newCapacity * sizeof(NSInteger));
+            pageIndexes = (NSUInteger *)NSZoneRealloc(NSDefaultMallocZone(), pageIndexes, newCapacity * sizeof(NSUInteger));
+            xs = (CGFloat *)NSZoneRealloc(NSDefaultMallocZone(), xs, newCapacity * sizeof(CGFloat));
+            ys = (CGFloat *)NSZoneRealloc(NSDefaultMallocZone(), ys, newCapacity * sizeof(CGFloat));
+            capacity = newCapacity;
+        }
+        recordIndexes[count] = recordIndex;
+        fileIDs[count] = NSNotFound;
+        lines[count] = -1;
+        pageIndexes[count] = NSNotFound;
+        xs[count] = 0.0;
+        ys[count] = 0.0;
+        position = ++count;
+        NSMapInsert(positions, (const void *)recordIndex, (const void *)position);
+    }
+    return position - 1;
+}
+
+- (void)setLine:(NSInteger)line fileID:(NSUInteger)fileID forRecordIndex:(NSInteger)recordIndex {
+    NSUInteger position = [self positionForRecordIndex:recordIndex];
+    fileIDs[position] = fileID;
+    lines[position] = line;
+    if (fileID == NSNotFound)
+        return;
+    lineEntries = growBuffer(lineEntries, &lineEntryCapacity, lineEntryCount + 1, sizeof(SKPDFSyncLineEntry));
+    lineEntries[lineEntryCount].fileID = fileID;
+    lineEntries[lineEntryCount].position = position;
+    lineEntryCount++;
+}
+
+- (void)setPoint:(NSPoint)point forRecordIndex:(NSInteger)recordIndex {
+    if (numberOfPages == 0)
+        return;
+    NSUInteger position = [self positionForRecordIndex:recordIndex];
+    pageIndexes[position] = numberOfPages - 1;
+    xs[position] = point.x;
+    ys[position] = point.y;
+    pageEntries = growBuffer(pageEntries, &pageEntryCapacity, pageEntryCount + 1, sizeof(SKPDFSyncPageEntry));
+    pageEntries[pageEntryCount].pageIndex = numberOfPages - 1;
+    pageEntries[pageEntryCount].position = position;
+    pageEntryCount++;
+}
+
+- (void)sortRecords {
+    NSUInteger i, position;
+    
+    for (i = 0; i < lineEntryCount; i++) {
+        position = lineEntries[i].position;
+        lineEntries[i].line = lines[position];
+        lineEntries[i].order = i;
+    }
+    for (i = 0; i < pageEntryCount; i++) {
+        position = pageEntries[i].position;
+        pageEntries[i].y = ys[position];
+        pageEntries[i].x = xs[position];
+        pageEntries[i].order = i;
+    }
+    
+    if (lineEntryCount > 1)
+        qsort(lineEntries, lineEntryCount, sizeof(SKPDFSyncLineEntry), &compareLineEntries);
+    if (pageEntryCount > 1)
+        qsort(pageEntries, pageEntryCount, sizeof(SKPDFSyncPageEntry), &comparePageEntries);
+}
+
+- (BOOL)getLine:(NSInteger *)linePtr fileID:(NSUInteger *)fileIDPtr forLocation:(NSPoint)point inRect:(NSRect)rect atPageIndex:(NSUInteger)pageIndex {
+    if (pageIndex >= numberOfPages)
+        return NO;
+    
+    CGFloat maxY = NSMaxY(rect);
+    NSUInteger lo = 0, hi = pageEntryCount, mid;
+    
+    // find the first entry on the page that is not above the rect
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (pageEntries[mid].pageIndex < pageIndex || (pageEntries[mid].pageIndex == pageIndex && pageEntries[mid].y > maxY))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    NSUInteger position;
+    NSUInteger beforePosition = NSNotFound;
+    NSUInteger afterPosition = NSNotFound;
+    NSUInteger atPosition = NSNotFound;
+    CGFloat atDistance = 0.0;
+    NSUInteger i;
+    
+    for (i = lo; i > 0 && pageEntries[i - 1].pageIndex == pageIndex; i--) {
+        position = pageEntries[i - 1].position;
+        if (lines[position] != 0) {
+            beforePosition = position;
+            break;
+        }
+    }
+    
+    for (i = lo; i < pageEntryCount && pageEntries[i].pageIndex == pageIndex; i++) {
+        position = pageEntries[i].position;
+        if (lines[position] == 0)
+            continue;
+        CGFloat x = xs[position], y = ys[position];
+        if (y > maxY) {
+            beforePosition = position;
+        } else if (y < NSMinY(rect)) {
+            afterPosition = position;
+            break;
+        } else if (x < NSMinX(rect)) {
+            beforePosition = position;
+        } else if (x > NSMaxX(rect)) {
+            afterPosition = position;
+            break;
+        } else {
+            // the nearest one wins, and the last of equally near ones
+            CGFloat distance = fabs(x - point.x);
+            if (atPosition == NSNotFound || distance <= atDistance) {
+                atPosition = position;
+                atDistance = distance;
+            }
+        }
+    }
+    
+    position = NSNotFound;
+    if (atPosition != NSNotFound) {
+        position = atPosition;
+    } else if (beforePosition != NSNotFound && afterPosition != NSNotFound) {
+        CGFloat beforeDistanceY = ys[beforePosition] - point.y, afterDistanceY = point.y - ys[afterPosition];
+        CGFloat beforeDistanceX = xs[beforePosition] - point.x, afterDistanceX = point.x - xs[afterPosition];
+        if (beforeDistanceY < afterDistanceY)
+            position = beforePosition;
+        else if (beforeDistanceY > afterDistanceY)
+            position = afterPosition;
+        else if (beforeDistanceX < afterDistanceX)
+            position = beforePosition;
+        else if (beforeDistanceX > afterDistanceX)
+            position = afterPosition;
+        else
+            position = beforePosition;
+    } else if (beforePosition != NSNotFound) {
+        position = beforePosition;
+    } else if (afterPosition != NSNotFound) {
+        position = afterPosition;
+    }
+    
+    if (position == NSNotFound)
+        return NO;
+    
+    *linePtr = lines[position];
+    *fileIDPtr = fileIDs[position];
+    return YES;
+}
+
+- (BOOL)getPageIndex:(NSUInteger *)pageIndexPtr location:(NSPoint *)pointPtr forLine:(NSInteger)line fileID:(NSUInteger)fileID {
+    NSUInteger lo = 0, hi = lineEntryCount, mid;
+    
+    // find the first entry for the file that is not before the line
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (lineEntries[mid].fileID < fileID || (lineEntries[mid].fileID == fileID && lineEntries[mid].line < line))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    NSUInteger position;
+    NSUInteger beforePosition = NSNotFound;
+    NSUInteger afterPosition = NSNotFound;
+    NSUInteger i;
+    
+    // only records that were placed on a page count
+    for (i = lo; i > 0 && lineEntries[i - 1].fileID == fileID; i--) {
+        position = lineEntries[i - 1].position;
+        if (pageIndexes[position] != NSNotFound) {
+            beforePosition = position;
+            break;
+        }
+    }
+    
+    for (i = lo; i < lineEntryCount && lineEntries[i].fileID == fileID; i++) {
+        position = lineEntries[i].position;
+        if (pageIndexes[position] != NSNotFound) {
+            afterPosition = position;
+            break;
+        }
+    }
+    
+    position = NSNotFound;
+    if (afterPosition != NSNotFound && lines[afterPosition] == line) {
+        position = afterPosition;
+    } else if (beforePosition != NSNotFound && afterPosition != NSNotFound) {
+        if (lines[beforePosition] - line > line - lines[afterPosition])
+            position = afterPosition;
+        else
+            position = beforePosition;
+    } else if (beforePosition != NSNotFound) {
+        position = beforePosition;
+    } else if (afterPosition != NSNotFound) {
+        position = afterPosition;
+    }
+    
+    if (position == NSNotFound)
+        return NO;
+    
+    *pageIndexPtr = pageIndexes[position];
+    *pointPtr = NSMakePoint(xs[position], ys[position]);
+    return YES;
+}
+
+@end
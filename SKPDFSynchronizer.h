@@ -49,6 +49,8 @@ typedef NS_OPTIONS(NSUInteger, SKPDFSynchronizerOption) {
 
 @protocol SKPDFSynchronizerDelegate;
 
+@class SKPDFSyncRecords;
+
 @interface SKPDFSynchronizer : NSObject {
     id <SKPDFSynchronizerDelegate> delegate;
     
@@ -62,19 +64,37 @@ typedef NS_OPTIONS(NSUInteger, SKPDFSynchronizerOption) {
     
     NSFileManager *fileManager;
     
-    NSMutableArray *pages;
-    NSMapTable *lines;
+    SKPDFSyncRecords *records;
+    NSMutableArray *files;
+    NSMapTable *fileIDs;
     
-    NSMapTable *filenames;
+    NSMutableDictionary *synctexTags;
+    NSMutableDictionary *synctexBaseNameTags;
+    NSMapTable *synctexFiles;
+    NSMutableDictionary *sourceFiles;
     synctex_scanner_p scanner;
     
     _Atomic(BOOL) shouldKeepRunning;
+    
+    _Atomic(NSUInteger) fileLineGeneration;
+    _Atomic(NSUInteger) pageGeneration;
+    _Atomic(NSUInteger) pendingQueries;
+    _Atomic(BOOL) syncFileChecked;
+    BOOL syncFileLoaded;
+    
+    _Atomic(NSUInteger) numberOfIssuedQueries;
+    _Atomic(NSUInteger) numberOfCoalescedQueries;
+    _Atomic(NSUInteger) numberOfExecutedQueries;
 }
 
 @property (nonatomic, assign) id <SKPDFSynchronizerDelegate> delegate;
 @property (copy) NSString *fileName;
 @property (readonly) BOOL shouldKeepRunning;
 
+// a query is coalesced when a newer query of the same kind was issued before it could run
+@property (readonly) NSUInteger numberOfIssuedQueries, numberOfCoalescedQueries, numberOfExecutedQueries;
+
+// only the latest query of each kind is answered, older pending queries are dropped
 - (void)findFileAndLineForLocation:(NSPoint)point inRect:(NSRect)rect pageBounds:(NSRect)bounds atPageIndex:(NSUInteger)pageIndex;
 - (void)findPageAndLocationForLine:(NSInteger)line inFile:(NSString *)file options:(SKPDFSynchronizerOption)options;
 
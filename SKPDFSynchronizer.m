@@ -37,9 +37,8 @@
  */
 
 #import "SKPDFSynchronizer.h"
-#import "SKPDFSyncRecord.h"
-#import "NSCharacterSet_SKExtensions.h"
-#import "NSScanner_SKExtensions.h"
+#import "SKPDFSyncRecords.h"
+#import "SKPDFSyncParser.h"
 #import <CoreFoundation/CoreFoundation.h>
 #import "NSFileManager_SKExtensions.h"
 
@@ -54,12 +53,17 @@ static NSArray *SKPDFSynchronizerTexExtensions = nil;
 static BOOL caseInsensitiveStringEqual(const void *item1, const void *item2, NSUInteger (*size)(const void *item));
 static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)(const void *item));
 
+// a case and normalization insensitive form of a path, to be used as a key with ordinary string hashing
+static inline NSString *foldedPath(NSString *path) {
+    return [[path decomposedStringWithCanonicalMapping] lowercaseString];
+}
+
 #pragma mark -
 
 @implementation SKPDFSynchronizer
 
 @synthesize delegate;
-@dynamic fileName, shouldKeepRunning;
+@dynamic fileName, shouldKeepRunning, numberOfIssuedQueries, numberOfCoalescedQueries, numberOfExecutedQueries;
 
 + (void)initialize {
     SKINITIALIZE;
@@ -77,14 +81,28 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
         lastModDate = nil;
         isPdfsync = YES;
         
-        pages = nil;
-        lines = nil;
+        records = nil;
+        files = nil;
+        fileIDs = nil;
         
-        filenames = nil;
+        synctexTags = nil;
+        synctexBaseNameTags = nil;
+        synctexFiles = nil;
+        sourceFiles = nil;
         scanner = NULL;
         
         shouldKeepRunning = YES;
         
+        fileLineGeneration = 0;
+        pageGeneration = 0;
+        pendingQueries = 0;
+        syncFileChecked = NO;
+        syncFileLoaded = NO;
+        
+        numberOfIssuedQueries = 0;
+        numberOfCoalescedQueries = 0;
+        numberOfExecutedQueries = 0;
+        
         // it is not safe to use the defaultManager on background threads
         fileManager = [[NSFileManager alloc] init];
     }
@@ -95,9 +113,13 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
     SKDISPATCHDESTROY(queue);
     SKDISPATCHDESTROY(lockQueue);
     SKDESTROY(fileManager);
-    SKDESTROY(pages);
-    SKDESTROY(lines);
-    SKDESTROY(filenames);
+    SKDESTROY(records);
+    SKDESTROY(files);
+    SKDESTROY(fileIDs);
+    SKDESTROY(synctexTags);
+    SKDESTROY(synctexBaseNameTags);
+    SKDESTROY(synctexFiles);
+    SKDESTROY(sourceFiles);
     SKDESTROY(fileName);
     SKDESTROY(syncFileName);
     SKDESTROY(lastModDate);
@@ -119,6 +141,18 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
     return atomic_load(&shouldKeepRunning);
 }
 
+- (NSUInteger)numberOfIssuedQueries {
+    return atomic_load(&numberOfIssuedQueries);
+}
+
+- (NSUInteger)numberOfCoalescedQueries {
+    return atomic_load(&numberOfCoalescedQueries);
+}
+
+- (NSUInteger)numberOfExecutedQueries {
+    return atomic_load(&numberOfExecutedQueries);
+}
+
 - (NSString *)fileName {
     NSString __block *file = nil;
     dispatch_sync(lockQueue, ^{
@@ -135,6 +169,7 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
             if ([fileName isEqualToString:newFileName] == NO) {
                 SKDESTROY(syncFileName);
                 SKDESTROY(lastModDate);
+                atomic_store(&syncFileChecked, NO);
             }
             [fileName release];
             fileName = [newFileName retain];
@@ -190,6 +225,18 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
     return [[file stringByResolvingSymlinksInPath] stringByStandardizingPath];
 }
 
+// resolving touches the file system, so we remember the source file of each name until the sync file is reloaded
+- (NSString *)cachedSourceFileForFileName:(NSString *)file {
+    NSString *sourceFile = [sourceFiles objectForKey:file];
+    if (sourceFile == nil) {
+        sourceFile = [self sourceFileForFileName:file isTeX:YES removeQuotes:NO];
+        if (sourceFiles == nil)
+            sourceFiles = [[NSMutableDictionary alloc] init];
+        [sourceFiles setObject:sourceFile forKey:file];
+    }
+    return sourceFile;
+}
+
 - (NSString *)defaultSourceFile {
     NSString *file = [[self fileName] stringByDeletingPathExtension];
     for (NSString *extension in SKPDFSynchronizerTexExtensions) {
@@ -200,261 +247,126 @@ static NSUInteger caseInsensitiveStringHash(const void *item, NSUInteger (*size)
     return [file stringByAppendingPathExtension:[SKPDFSynchronizerTexExtensions firstObject]];
 }
 
+- (NSString *)synctexCacheDirectory {
+    NSURL *cachesURL = [fileManager URLForDirectory:NSCachesDirectory inDomain:NSUserDomainMask appropriateForURL:nil create:YES error:NULL];
+    NSString *bundleIdentifier = [[NSBundle mainBundle] bundleIdentifier];
+    if (cachesURL == nil || bundleIdentifier == nil)
+        return nil;
+    NSURL *cacheURL = [[cachesURL URLByAppendingPathComponent:bundleIdentifier isDirectory:YES] URLByAppendingPathComponent:@"SyncTeX" isDirectory:YES];
+    if ([fileManager createDirectoryAtURL:cacheURL withIntermediateDirectories:YES attributes:nil error:NULL] == NO)
+        return nil;
+    return [cacheURL path];
+}
+
 #pragma mark PDFSync
 
-static inline SKPDFSyncRecord *recordForIndex(NSMapTable *records, NSInteger recordIndex) {
-    SKPDFSyncRecord *record = NSMapGet(records, (const void *)recordIndex);
-    if (record == nil) {
-        record = [[SKPDFSyncRecord alloc] initWithRecordIndex:recordIndex];
-        NSMapInsert(records, (const void *)recordIndex, record);
-        [record release];
+// file names are interned, the records refer to them by their index in files
+- (NSUInteger)fileIDForFile:(NSString *)file {
+    NSUInteger fileID = (NSUInteger)NSMapGet(fileIDs, file);
+    if (fileID == 0) {
+        [files addObject:file];
+        fileID = [files count];
+        NSMapInsert(fileIDs, file, (const void *)fileID);
+    }
+    return fileID - 1;
+}
+
+typedef struct _SKPDFSyncParserContext {
+    SKPDFSynchronizer *synchronizer;
+    NSMutableArray *fileStack;
+    NSUInteger fileID;
+} SKPDFSyncParserContext;
+
+static bool addPdfsyncRecord(const SKPDFSyncParserRecord *record, void *info) {
+    SKPDFSyncParserContext *context = (SKPDFSyncParserContext *)info;
+    SKPDFSynchronizer *synchronizer = context->synchronizer;
+    switch (record->type) {
+        case SKPDFSyncRecordTypeLine:
+            [synchronizer->records setLine:record->line fileID:context->fileID forRecordIndex:record->recordIndex];
+            break;
+        case SKPDFSyncRecordTypePoint:
+            [synchronizer->records setPoint:NSMakePoint(PDFSYNC_TO_PDF(record->x) + pdfOffset.x, PDFSYNC_TO_PDF(record->y) + pdfOffset.y) forRecordIndex:record->recordIndex];
+            break;
+        case SKPDFSyncRecordTypePage:
+        {
+            // the page number should always equal the number of pages+1
+            NSUInteger numberOfPages = [synchronizer->records numberOfPages];
+            NSInteger pageNumber = record->line == SKPDFSyncNoPageNumber ? (NSInteger)numberOfPages + 1 : record->line;
+            if (pageNumber > (NSInteger)numberOfPages)
+                [synchronizer->records setNumberOfPages:pageNumber];
+            break;
+        }
+        case SKPDFSyncRecordTypeOpenFile:
+        {
+            NSString *file = [[NSString alloc] initWithBytes:record->file length:record->fileLength encoding:NSUTF8StringEncoding];
+            if (file == nil)
+                return false;
+            context->fileID = [synchronizer fileIDForFile:[synchronizer sourceFileForFileName:file isTeX:YES removeQuotes:YES]];
+            [context->fileStack addObject:[NSNumber numberWithUnsignedInteger:context->fileID]];
+            [file release];
+            break;
+        }
+        case SKPDFSyncRecordTypeCloseFile:
+            if ([context->fileStack count]) {
+                [context->fileStack removeLastObject];
+                context->fileID = [context->fileStack count] ? [[context->fileStack lastObject] unsignedIntegerValue] : NSNotFound;
+            }
+            break;
     }
-    return record;
+    return atomic_load(&synchronizer->shouldKeepRunning);
 }
 
 - (BOOL)loadPdfsyncFile:(NSString *)theFileName {
 
-    if (pages)
-        [pages removeAllObjects];
-    else
-        pages = [[NSMutableArray alloc] init];
-    if (lines) {
-        [lines removeAllObjects];
+    if (records) {
+        [records removeAllRecords];
+        [files removeAllObjects];
+        [fileIDs removeAllObjects];
     } else {
+        records = [[SKPDFSyncRecords alloc] init];
+        files = [[NSMutableArray alloc] init];
         NSPointerFunctions *keyPointerFunctions = [NSPointerFunctions pointerFunctionsWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality];
         [keyPointerFunctions setIsEqualFunction:&caseInsensitiveStringEqual];
         [keyPointerFunctions setHashFunction:&caseInsensitiveStringHash];
-        NSPointerFunctions *valuePointerFunctions = [NSPointerFunctions pointerFunctionsWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality];
-        lines = [[NSMapTable alloc] initWithKeyPointerFunctions:keyPointerFunctions valuePointerFunctions:valuePointerFunctions capacity:0];
+        NSPointerFunctions *valuePointerFunctions = [NSPointerFunctions pointerFunctionsWithOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsIntegerPersonality];
+        fileIDs = [[NSMapTable alloc] initWithKeyPointerFunctions:keyPointerFunctions valuePointerFunctions:valuePointerFunctions capacity:0];
     }
     
+    [sourceFiles removeAllObjects];
+    
     [self setSyncFileName:theFileName];
     isPdfsync = YES;
     
-    NSString *pdfsyncString = [NSString stringWithContentsOfFile:theFileName encoding:NSUTF8StringEncoding error:NULL];
-    BOOL rv = NO;
+    SKPDFSyncParserContext context;
+    context.synchronizer = self;
+    context.fileStack = [[NSMutableArray alloc] init];
+    context.fileID = NSNotFound;
     
-    if ([pdfsyncString length]) {
-        
-        NSMapTable *records = NSCreateMapTable(NSIntegerMapKeyCallBacks, NSObjectMapValueCallBacks, 0);
-        NSMutableArray *files = [[NSMutableArray alloc] init];
-        NSString *file;
-        NSInteger recordIndex, line, pageIndex;
-        double x, y;
-        SKPDFSyncRecord *record;
-        NSMutableArray *array;
-        unichar ch;
-        NSScanner *sc = [[NSScanner alloc] initWithString:pdfsyncString];
-        NSCharacterSet *newlines = [NSCharacterSet newlineCharacterSet];
-        
-        [sc setCharactersToBeSkipped:[NSCharacterSet whitespaceCharacterSet]];
-        
-        if ([sc scanUpToCharactersFromSet:newlines intoString:&file] &&
-            [sc scanCharactersFromSet:newlines intoString:NULL]) {
-            
-            file = [self sourceFileForFileName:file isTeX:YES removeQuotes:YES];
-            [files addObject:file];
-            
-            array = [[NSMutableArray alloc] init];
-            [lines setObject:array forKey:file];
-            [array release];
-            
-            // we ignore the version
-            if ([sc scanString:@"version" intoString:NULL] && [sc scanInteger:NULL]) {
-                
-                [sc scanCharactersFromSet:newlines intoString:NULL];
-                
-                while ([self shouldKeepRunning] && [sc scanCharacter:&ch]) {
-                    
-                    switch (ch) {
-                        case 'l':
-                            if ([sc scanInteger:&recordIndex] && [sc scanInteger:&line]) {
-                                // we ignore the column
-                                [sc scanInteger:NULL];
-                                record = recordForIndex(records, recordIndex);
-                                [record setFile:file];
-                                [record setLine:line];
-                                [[lines objectForKey:file] addObject:record];
-                            }
-                            break;
-                        case 'p':
-                            // we ignore * and + modifiers
-                            if ([sc scanString:@"*" intoString:NULL] == NO)
-                                [sc scanString:@"+" intoString:NULL];
-                            if ([sc scanInteger:&recordIndex] && [sc scanDouble:&x] && [sc scanDouble:&y]) {
-                                record = recordForIndex(records, recordIndex);
-                                [record setPageIndex:[pages count] - 1];
-                                [record setPoint:NSMakePoint(PDFSYNC_TO_PDF(x) + pdfOffset.x, PDFSYNC_TO_PDF(y) + pdfOffset.y)];
-                                [[pages lastObject] addObject:record];
-                            }
-                            break;
-                        case 's':
-                            // start of a new page, the scanned integer should always equal [pages count]+1
-                            if ([sc scanInteger:&pageIndex] == NO) pageIndex = [pages count] + 1;
-                            while (pageIndex > (NSInteger)[pages count]) {
-                                array = [[NSMutableArray alloc] init];
-                                [pages addObject:array];
-                                [array release];
-                            }
-                            break;
-                        case '(':
-                            // start of a new source file
-                            if ([sc scanUpToCharactersFromSet:newlines intoString:&file]) {
-                                file = [self sourceFileForFileName:file isTeX:YES removeQuotes:YES];
-                                [files addObject:file];
-                                if ([lines objectForKey:file] == nil) {
-                                    array = [[NSMutableArray alloc] init];
-                                    [lines setObject:array forKey:file];
-                                    [array release];
-                                }
-                            }
-                            break;
-                        case ')':
-                            // closing of a source file
-                            if ([files count]) {
-                                [files removeLastObject];
-                                file = [files lastObject];
-                            }
-                            break;
-                        default:
-                            // shouldn't reach
-                            break;
-                    }
-                    
-                    [sc scanUpToCharactersFromSet:newlines intoString:NULL];
-                    [sc scanCharactersFromSet:newlines intoString:NULL];
-                }
-                
-                NSSortDescriptor *lineSortDescriptor = [[[NSSortDescriptor alloc] initWithKey:@"line" ascending:YES] autorelease];
-                NSSortDescriptor *xSortDescriptor = [[[NSSortDescriptor alloc] initWithKey:@"x" ascending:YES] autorelease];
-                NSSortDescriptor *ySortDescriptor = [[[NSSortDescriptor alloc] initWithKey:@"y" ascending:NO] autorelease];
-                NSArray *lineSortDescriptors = @[lineSortDescriptor];
-                
-                for (array in [lines objectEnumerator])
-                    [array sortUsingDescriptors:lineSortDescriptors];
-                [pages makeObjectsPerformSelector:@selector(sortUsingDescriptors:)
-                                       withObject:@[ySortDescriptor, xSortDescriptor]];
-                
-                rv = [self shouldKeepRunning];
-            }
-        }
-        
-        NSFreeMapTable(records);
-        [files release];
-        [sc release];
+    BOOL rv = SKPDFSyncParseFile([theFileName fileSystemRepresentation], &addPdfsyncRecord, &context);
+    
+    [context.fileStack release];
+    
+    if (rv) {
+        [records sortRecords];
+        rv = [self shouldKeepRunning];
     }
     
     return rv;
 }
 
 - (BOOL)pdfsyncFindFileLine:(NSInteger *)linePtr file:(NSString **)filePtr forLocation:(NSPoint)point inRect:(NSRect)rect pageBounds:(NSRect)bounds atPageIndex:(NSUInteger)pageIndex {
-    BOOL rv = NO;
-    if (pageIndex < [pages count]) {
-        
-        SKPDFSyncRecord *record = nil;
-        SKPDFSyncRecord *beforeRecord = nil;
-        SKPDFSyncRecord *afterRecord = nil;
-        NSMutableDictionary *atRecords = [NSMutableDictionary dictionary];
-        
-        for (record in [pages objectAtIndex:pageIndex]) {
-            if ([record line] == 0)
-                continue;
-            NSPoint p = [record point];
-            if (p.y > NSMaxY(rect)) {
-                beforeRecord = record;
-            } else if (p.y < NSMinY(rect)) {
-                afterRecord = record;
-                break;
-            } else if (p.x < NSMinX(rect)) {
-                beforeRecord = record;
-            } else if (p.x > NSMaxX(rect)) {
-                afterRecord = record;
-                break;
-            } else {
-                [atRecords setObject:record forKey:[NSNumber numberWithDouble:fabs(p.x - point.x)]];
-            }
-        }
-        
-        record = nil;
-        if ([atRecords count]) {
-            NSNumber *nearest = [[[atRecords allKeys] sortedArrayUsingSelector:@selector(compare:)] objectAtIndex:0];
-            record = [atRecords objectForKey:nearest];
-        } else if (beforeRecord && afterRecord) {
-            NSPoint beforePoint = [beforeRecord point];
-            NSPoint afterPoint = [afterRecord point];
-            if (beforePoint.y - point.y < point.y - afterPoint.y)
-                record = beforeRecord;
-            else if (beforePoint.y - point.y > point.y - afterPoint.y)
-                record = afterRecord;
-            else if (beforePoint.x - point.x < point.x - afterPoint.x)
-                record = beforeRecord;
-            else if (beforePoint.x - point.x > point.x - afterPoint.x)
-                record = afterRecord;
-            else
-                record = beforeRecord;
-        } else if (beforeRecord) {
-            record = beforeRecord;
-        } else if (afterRecord) {
-            record = afterRecord;
-        }
-        
-        if (record) {
-            *linePtr = [record line];
-            *filePtr = [record file];
-            rv = YES;
-        }
-    }
-    if (rv == NO)
+    NSUInteger fileID = NSNotFound;
+    BOOL rv = [records getLine:linePtr fileID:&fileID forLocation:point inRect:rect atPageIndex:pageIndex];
+    if (rv)
+        *filePtr = fileID < [files count] ? [files objectAtIndex:fileID] : nil;
+    else
         NSLog(@"PDFSync was unable to find file and line.");
     return rv;
 }
 
 - (BOOL)pdfsyncFindPage:(NSUInteger *)pageIndexPtr location:(NSPoint *)pointPtr forLine:(NSInteger)line inFile:(NSString *)file {
-    BOOL rv = NO;
-    NSArray *theLines = [lines objectForKey:file];
-    if (theLines) {
-        
-        SKPDFSyncRecord *record = nil;
-        SKPDFSyncRecord *beforeRecord = nil;
-        SKPDFSyncRecord *afterRecord = nil;
-        SKPDFSyncRecord *atRecord = nil;
-        
-        for (record in theLines) {
-            if ([record pageIndex] == NSNotFound)
-                continue;
-            NSInteger l = [record line];
-            if (l < line) {
-                beforeRecord = record;
-            } else if (l > line) {
-                afterRecord = record;
-                break;
-            } else {
-                atRecord = record;
-                break;
-            }
-        }
-        
-        if (atRecord) {
-            record = atRecord;
-        } else if (beforeRecord && afterRecord) {
-            NSInteger beforeLine = [beforeRecord line];
-            NSInteger afterLine = [afterRecord line];
-            if (beforeLine - line > line - afterLine)
-                record = afterRecord;
-            else
-                record = beforeRecord;
-        } else if (beforeRecord) {
-            record = beforeRecord;
-        } else if (afterRecord) {
-            record = afterRecord;
-        }
-        
-        if (record) {
-            *pageIndexPtr = [record pageIndex];
-            *pointPtr = [record point];
-            rv = YES;
-        }
-    }
+    NSUInteger fileID = (NSUInteger)NSMapGet(fileIDs, file);
+    BOOL rv = fileID > 0 && [records getPageIndex:pageIndexPtr location:pointPtr forLine:line fileID:fileID - 1];
     if (rv == NO)
         NSLog(@"PDFSync was unable to find location and page.");
     return rv;
@@ -464,25 +376,58 @@ static inline SKPDFSyncRecord *recordForIndex(NSMapTable *records, NSInteger rec
 
 - (BOOL)loadSynctexFileForFile:(NSString *)theFileName {
     BOOL rv = NO;
-    if (scanner)
-        synctex_scanner_free(scanner);
-    scanner = synctex_scanner_new_with_output_file([theFileName UTF8String], NULL, 1);
+    [sourceFiles removeAllObjects];
+    synctex_scanner_p previous = scanner;
+    scanner = synctex_scanner_new_with_output_file([theFileName UTF8String], NULL, 0);
+    synctex_scanner_set_parse_options(scanner, synctex_parse_option_lazy | synctex_parse_option_mapped | synctex_parse_option_threaded_inflate);
+    if (previous) {
+        // reuse the pages that did not change since the last typesetting, this also frees the previous scanner
+        synctex_scanner_set_previous(scanner, previous);
+    } else {
+        NSString *cacheDirectory = [self synctexCacheDirectory];
+        if (cacheDirectory)
+            synctex_scanner_set_cache_directory(scanner, [cacheDirectory fileSystemRepresentation]);
+    }
+    scanner = synctex_scanner_parse(scanner);
     if (scanner) {
         const char *fileRep = synctex_scanner_get_synctex(scanner);
         [self setSyncFileName:[self sourceFileForFileName:[NSString stringWithUTF8String:fileRep] isTeX:NO removeQuotes:NO]];
-        if (filenames) {
-            NSResetMapTable(filenames);
+        if (synctexTags) {
+            [synctexTags removeAllObjects];
+            [synctexBaseNameTags removeAllObjects];
+            NSResetMapTable(synctexFiles);
         } else {
-            NSPointerFunctions *keyPointerFunctions = [NSPointerFunctions pointerFunctionsWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPersonality];
-            [keyPointerFunctions setIsEqualFunction:&caseInsensitiveStringEqual];
-            [keyPointerFunctions setHashFunction:&caseInsensitiveStringHash];
-            NSPointerFunctions *valuePointerFunctions = [NSPointerFunctions pointerFunctionsWithOptions:NSPointerFunctionsMallocMemory | NSPointerFunctionsCStringPersonality | NSPointerFunctionsCopyIn];
-            filenames = [[NSMapTable alloc] initWithKeyPointerFunctions:keyPointerFunctions valuePointerFunctions:valuePointerFunctions capacity:0];
+            synctexTags = [[NSMutableDictionary alloc] init];
+            synctexBaseNameTags = [[NSMutableDictionary alloc] init];
+            synctexFiles = NSCreateMapTable(NSIntegerMapKeyCallBacks, NSObjectMapValueCallBacks, 0);
         }
+        // resolve the file of each input once, so queries can pass the tag to the scanner
+        NSString *directory = [theFileName stringByDeletingLastPathComponent];
         synctex_node_p node = synctex_scanner_input(scanner);
         do {
-            if ((fileRep = synctex_scanner_get_name(scanner, synctex_node_tag(node)))) {
-                NSMapInsert(filenames, [self sourceFileForFileName:[NSString stringWithUTF8String:fileRep] isTeX:YES removeQuotes:NO], fileRep);
+            int tag = synctex_node_tag(node);
+            if ((fileRep = synctex_scanner_get_name(scanner, tag))) {
+                NSString *name = [NSString stringWithUTF8String:fileRep];
+                NSString *file = [self cachedSourceFileForFileName:name];
+                NSNumber *tagNumber = [NSNumber numberWithInt:tag];
+                NSString *key = foldedPath(file);
+                if ([synctexTags objectForKey:key] == nil)
+                    [synctexTags setObject:tagNumber forKey:key];
+                // also the path as TeX knows it, without resolving symlinks
+                if ([name isAbsolutePath] == NO)
+                    name = [directory stringByAppendingPathComponent:name];
+                key = foldedPath([name stringByStandardizingPath]);
+                if ([synctexTags objectForKey:key] == nil)
+                    [synctexTags setObject:tagNumber forKey:key];
+                // a base name shared by different files is ambiguous, like for synctex_scanner_get_tag
+                key = foldedPath([file lastPathComponent]);
+                NSNumber *baseNameTag = [synctexBaseNameTags objectForKey:key];
+                if (baseNameTag == nil)
+                    [synctexBaseNameTags setObject:tagNumber forKey:key];
+                else if ([baseNameTag intValue] != 0 && [foldedPath(NSMapGet(synctexFiles, (const void *)(NSInteger)[baseNameTag intValue])) isEqualToString:foldedPath(file)] == NO)
+                    [synctexBaseNameTags setObject:[NSNumber numberWithInt:0] forKey:key];
+                if (NSMapGet(synctexFiles, (const void *)(NSInteger)tag) == nil)
+                    NSMapInsert(synctexFiles, (const void *)(NSInteger)tag, file);
             }
         } while ((node = synctex_node_next(node)));
         isPdfsync = NO;
@@ -497,9 +442,13 @@ static inline SKPDFSyncRecord *recordForIndex(NSMapTable *records, NSInteger rec
         synctex_node_p node;
         const char *file;
         while (rv == NO && (node = synctex_scanner_next_result(scanner))) {
-            if ((file = synctex_scanner_get_name(scanner, synctex_node_tag(node)))) {
+            int tag = synctex_node_tag(node);
+            NSString *sourceFile = NSMapGet(synctexFiles, (const void *)(NSInteger)tag);
+            if (sourceFile == nil && (file = synctex_scanner_get_name(scanner, tag)))
+                sourceFile = [self cachedSourceFileForFileName:[NSString stringWithUTF8String:file]];
+            if (sourceFile) {
                 *linePtr = MAX(synctex_node_line(node), 1) - 1;
-                *filePtr = [self sourceFileForFileName:[NSString stringWithUTF8String:file] isTeX:YES removeQuotes:NO];
+                *filePtr = sourceFile;
                 rv = YES;
             }
         }
@@ -511,18 +460,13 @@ static inline SKPDFSyncRecord *recordForIndex(NSMapTable *records, NSInteger rec
 
 - (BOOL)synctexFindPage:(NSUInteger *)pageIndexPtr location:(NSPoint *)pointPtr forLine:(NSInteger)line inFile:(NSString *)file {
     BOOL rv = NO;
-    char *filename = NSMapGet(filenames, file) ?: NSMapGet(filenames, [[file stringByResolvingSymlinksInPath] stringByStandardizingPath]);
-    if (filename == NULL) {
-        for (NSString *fn in filenames) {
-            if ([[fn lastPathComponent] caseInsensitiveCompare:[file lastPathComponent]] == NSOrderedSame) {
-                filename = NSMapGet(filenames, file);
-                break;
-            }
-        }
-        if (filename == NULL)
-            filename = (char *)[[file lastPathComponent] UTF8String];
-    }
-    if (synctex_display_query(scanner, filename, (int)line + 1, 0, -1) > 0) {
+    NSNumber *tag = [synctexTags objectForKey:foldedPath(file)] ?: [synctexBaseNameTags objectForKey:foldedPath([file lastPathComponent])];
+    synctex_status_t count;
+    if (tag)
+        count = synctex_display_query_tag(scanner, [tag intValue], (int)line + 1, 0, -1);
+    else
+        count = synctex_display_query(scanner, [[file lastPathComponent] UTF8String], (int)line + 1, 0, -1);
+    if (count > 0) {
         synctex_node_p node = synctex_scanner_next_result(scanner);
         if (node) {
             NSUInteger page = synctex_node_page(node);
@@ -577,55 +521,89 @@ static inline SKPDFSyncRecord *recordForIndex(NSMapTable *records, NSInteger rec
     return queue;
 }
 
+#pragma mark Query coalescing
+
+// the sync file is checked once for all queries that are queued together
+- (BOOL)beginQuery {
+    if (atomic_exchange(&syncFileChecked, YES) == NO)
+        syncFileLoaded = [self loadSyncFileIfNeeded];
+    return syncFileLoaded;
+}
+
+- (void)endQuery {
+    if (atomic_fetch_sub(&pendingQueries, 1) == 1)
+        atomic_store(&syncFileChecked, NO);
+}
+
 #pragma mark Finding API
 
 - (void)findFileAndLineForLocation:(NSPoint)point inRect:(NSRect)rect pageBounds:(NSRect)bounds atPageIndex:(NSUInteger)pageIndex {
+    NSUInteger generation = atomic_fetch_add(&fileLineGeneration, 1) + 1;
+    atomic_fetch_add(&numberOfIssuedQueries, 1);
+    atomic_fetch_add(&pendingQueries, 1);
     dispatch_async([self queue], ^{
-        if ([self shouldKeepRunning] && [self loadSyncFileIfNeeded]) {
+        if (atomic_load(&fileLineGeneration) != generation) {
+            atomic_fetch_add(&numberOfCoalescedQueries, 1);
+        } else if ([self shouldKeepRunning] && [self beginQuery]) {
             NSInteger foundLine = 0;
             NSString *foundFile = nil;
             BOOL success = NO;
             
+            atomic_fetch_add(&numberOfExecutedQueries, 1);
+            
             if (isPdfsync)
                 success = [self pdfsyncFindFileLine:&foundLine file:&foundFile forLocation:point inRect:rect pageBounds:bounds atPageIndex:pageIndex];
             else
                 success = [self synctexFindFileLine:&foundLine file:&foundFile forLocation:point inRect:rect pageBounds:bounds atPageIndex:pageIndex];
             
-            if (success && [self shouldKeepRunning]) {
+            if (success && [self shouldKeepRunning] && atomic_load(&fileLineGeneration) == generation) {
                 dispatch_async(dispatch_get_main_queue(), ^{
-                    [delegate synchronizer:self foundLine:foundLine inFile:foundFile];
+                    // a newer query may have been issued in the meantime
+                    if (atomic_load(&fileLineGeneration) == generation)
+                        [delegate synchronizer:self foundLine:foundLine inFile:foundFile];
                 });
             }
         }
+        [self endQuery];
     });
 }
 
 - (void)findPageAndLocationForLine:(NSInteger)line inFile:(NSString *)file options:(SKPDFSynchronizerOption)options {
     if (file == nil)
         file = [self defaultSourceFile];
+    NSUInteger generation = atomic_fetch_add(&pageGeneration, 1) + 1;
+    atomic_fetch_add(&numberOfIssuedQueries, 1);
+    atomic_fetch_add(&pendingQueries, 1);
     dispatch_async([self queue], ^{
-        if (file && [self shouldKeepRunning] && [self loadSyncFileIfNeeded]) {
+        if (atomic_load(&pageGeneration) != generation) {
+            atomic_fetch_add(&numberOfCoalescedQueries, 1);
+        } else if (file && [self shouldKeepRunning] && [self beginQuery]) {
             NSUInteger foundPageIndex = NSNotFound;
             NSPoint foundPoint = NSZeroPoint;
             SKPDFSynchronizerOption foundOptions = options;
             BOOL success = NO;
-            NSString *fixedFile = [self sourceFileForFileName:file isTeX:YES removeQuotes:NO];
+            NSString *fixedFile = [self cachedSourceFileForFileName:file];
+            
+            atomic_fetch_add(&numberOfExecutedQueries, 1);
             
             if (isPdfsync)
                 success = [self pdfsyncFindPage:&foundPageIndex location:&foundPoint forLine:line inFile:fixedFile];
             else
                 success = [self synctexFindPage:&foundPageIndex location:&foundPoint forLine:line inFile:fixedFile];
             
-            if (success && [self shouldKeepRunning]) {
+            if (success && [self shouldKeepRunning] && atomic_load(&pageGeneration) == generation) {
                 if (isPdfsync)
                     foundOptions &= ~SKPDFSynchronizerFlippedMask;
                 else
                     foundOptions |= SKPDFSynchronizerFlippedMask;
                 dispatch_async(dispatch_get_main_queue(), ^{
-                    [delegate synchronizer:self foundLocation:foundPoint atPageIndex:foundPageIndex options:foundOptions];
+                    // a newer query may have been issued in the meantime
+                    if (atomic_load(&pageGeneration) == generation)
+                        [delegate synchronizer:self foundLocation:foundPoint atPageIndex:foundPageIndex options:foundOptions];
                 });
             }
         }
+        [self endQuery];
     });
 }
 
@@ -49,10 +49,12 @@
  @discussion  These options can be passed to the main methods for writing Skim notes to extended attributes or to file.
  @constant    SKNSkimNotesWritingPlist      Write plist data rather than archived data.  Always implied on iOS.
  @constant    SKNSkimNotesWritingSyncable   Hint to add a syncable flag to the attribute names if available, when writing to extended attributes.
+ @constant    SKNSkimNotesWritingCompact    Write compact binary data rather than archived or plist data.  Takes precedence over <code>SKNSkimNotesWritingPlist</code>.  This data cannot be read by older versions of SkimNotes.
  */
 enum {
     SKNSkimNotesWritingPlist = 1 << 0,
-    SKNSkimNotesWritingSyncable = 1 << 1
+    SKNSkimNotesWritingSyncable = 1 << 1,
+    SKNSkimNotesWritingCompact = 1 << 2
 };
 typedef NSInteger SKNSkimNotesWritingOptions;
 
@@ -221,6 +223,32 @@ extern NSArray *SKNSkimNotesFromData(NSData *data);
 */
 extern NSData *SKNDataFromSkimNotes(NSArray *notes, BOOL asPlist);
 
+/*!
+    @abstract   Returns compact binary data for the Skim notes.
+    @discussion The data starts with a table of contents by page, so the notes on some pages can be read without reading the others, and shares repeated strings and colors between the notes.  This data cannot be read by older versions of SkimNotes.
+    @param      notes An array of dictionaries containing Skim note properties, as returned by the properties of a <code>PDFAnnotation</code>.
+    @result     A compact data representation of the notes.
+*/
+extern NSData *SKNCompactDataFromSkimNotes(NSArray *notes);
+
+/*!
+    @abstract   Returns an array of Skim notes on a range of pages from the data.
+    @discussion For compact data, only the notes on the pages in the range are decoded.  Other data is decoded completely.  Mapped data can be passed to avoid reading the rest of a file.
+    @param      data The data object to extract the notes from, either compact, archive, or plist data.
+    @param      pageRange The range of page indexes of the notes to return.
+    @result     An array of dictionaries containing Skim notes properties, in their original order.
+*/
+extern NSArray *SKNSkimNotesFromDataInPageRange(NSData *data, NSRange pageRange);
+
+/*!
+    @abstract   Returns the number of Skim notes on a range of pages in the data.
+    @discussion For compact data, this only reads the table of contents.
+    @param      data The data object containing the notes, either compact, archive, or plist data.
+    @param      pageRange The range of page indexes of the notes to count.
+    @result     The number of notes on the pages in the range.
+*/
+extern NSUInteger SKNNumberOfSkimNotesInData(NSData *data, NSRange pageRange);
+
 /*!
     @abstract   Returns a string representation of Skim notes.
     @discussion This is used to write a default Skim text notes representation when not provided for writing.
@@ -236,3 +264,13 @@ extern NSString *SKNSkimTextNotes(NSArray *noteDicts);
     @result     An RTF data representation of the notes.
 */
 extern NSData *SKNSkimRTFNotes(NSArray *noteDicts);
+
+/*!
+    @abstract   Creates the string and RTF data representations of Skim notes directly from their data.
+    @discussion This only decodes the fields needed for the text representations, and skips images.  The results are cached by a hash of the data, so repeated calls for the same notes are cheap.  This can be called from a background thread.
+    @param      data The data object to extract the notes from, either an archive or plist data.
+    @param      textNotes On return, a string representation of the notes.  Pass <code>NULL</code> if you don't need it.
+    @param      rtfNotes On return, an RTF data representation of the notes.  Pass <code>NULL</code> if you don't need it.
+    @result     <code>YES</code> if the data contained any notes, <code>NO</code> otherwise.
+*/
+extern BOOL SKNSkimTextAndRTFNotesFromData(NSData *data, NSString **textNotes, NSData **rtfNotes);
@@ -40,6 +40,7 @@
 #import "SKNExtendedAttributeManager.h"
 #import "SKNUtilities.h"
 
+#define SYNCABLE_FLAG @"#S"
 
 @implementation NSFileManager (SKNExtensions)
 
@@ -57,29 +58,53 @@
     if ([aURL isFileURL]) {
         NSString *path = [aURL path];
         BOOL asPlist = (options & SKNSkimNotesWritingPlist) != 0;
-        NSData *data = SKNDataFromSkimNotes(notes, asPlist);
+        NSData *data = (options & SKNSkimNotesWritingCompact) ? SKNCompactDataFromSkimNotes(notes) : SKNDataFromSkimNotes(notes, asPlist);
         NSError *error = nil;
         SKNExtendedAttributeManager *eam = [SKNExtendedAttributeManager sharedManager];
         
-        // first remove all old notes
-        if ([eam removeExtendedAttributeNamed:SKIM_NOTES_KEY atPath:path traverseLink:YES error:&error] == NO) {
-            // should we set success to NO and return an error?
-            //NSLog(@"%@: %@", self, error);
+        // first remove all old notes, unless we can replace them in place and keep the fragments that did not change
+        NSArray *attrNames = [notes count] ? [eam extendedAttributeNamesAtPath:path traverseLink:YES error:NULL] : nil;
+        NSString *otherNotesKey = (options & SKNSkimNotesWritingSyncable) ? SKIM_NOTES_KEY : SKIM_NOTES_KEY SYNCABLE_FLAG;
+        if ([notes count] == 0 || [attrNames containsObject:otherNotesKey]) {
+            if ([eam removeExtendedAttributeNamed:SKIM_NOTES_KEY atPath:path traverseLink:YES error:&error] == NO) {
+                // should we set success to NO and return an error?
+                //NSLog(@"%@: %@", self, error);
+            }
+            [eam removeExtendedAttributeNamed:SKIM_TEXT_NOTES_KEY atPath:path traverseLink:YES error:NULL];
+            [eam removeExtendedAttributeNamed:SKIM_RTF_NOTES_KEY atPath:path traverseLink:YES error:NULL];
         }
-        [eam removeExtendedAttributeNamed:SKIM_TEXT_NOTES_KEY atPath:path traverseLink:YES error:NULL];
-        [eam removeExtendedAttributeNamed:SKIM_RTF_NOTES_KEY atPath:path traverseLink:YES error:NULL];
         
         if ([notes count]) {
             SKNXattrFlags xattrOptions = (options & SKNSkimNotesWritingSyncable) ? kSKNXattrSyncable : kSKNXattrDefault;
-            if ([eam setExtendedAttributeNamed:SKIM_NOTES_KEY toValue:data atPath:path options:xattrOptions error:&error] == NO) {
+            // render the missing text representations from the data in the background while we write the notes themselves
+            __block NSString *generatedNotesString = nil;
+            __block NSData *generatedNotesRTFData = nil;
+            BOOL needsNotesString = notesString == nil, needsNotesRTFData = notesRTFData == nil;
+            dispatch_group_t group = NULL;
+            if (needsNotesString || needsNotesRTFData) {
+                group = dispatch_group_create();
+                dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+                    SKNSkimTextAndRTFNotesFromData(data, needsNotesString ? &generatedNotesString : NULL, needsNotesRTFData ? &generatedNotesRTFData : NULL);
+                    [generatedNotesString retain];
+                    [generatedNotesRTFData retain];
+                    [pool release];
+                });
+            }
+            BOOL didWrite = [eam setExtendedAttributeNamed:SKIM_NOTES_KEY toValue:data atPath:path options:xattrOptions error:&error];
+            if (group) {
+                dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                dispatch_release(group);
+                if (needsNotesString)
+                    notesString = [generatedNotesString autorelease];
+                if (needsNotesRTFData)
+                    notesRTFData = [generatedNotesRTFData autorelease];
+            }
+            if (didWrite == NO) {
                 success = NO;
                 if (outError) *outError = error;
                 //NSLog(@"%@: %@", self, error);
             } else {
-                if (notesString == nil)
-                    notesString = SKNSkimTextNotes(notes);
-                if (notesRTFData == nil)
-                    notesRTFData = SKNSkimRTFNotes(notes);
                 [eam setExtendedAttributeNamed:SKIM_TEXT_NOTES_KEY toPropertyListValue:notesString atPath:path options:xattrOptions error:NULL];
                 [eam setExtendedAttributeNamed:SKIM_RTF_NOTES_KEY toValue:notesRTFData atPath:path options:xattrOptions error:NULL];
             }
@@ -97,7 +122,7 @@
     
     if ([aURL isFileURL]) {
         BOOL asPlist = (options & SKNSkimNotesWritingPlist) != 0;
-        NSData *data = SKNDataFromSkimNotes(notes, asPlist);
+        NSData *data = (options & SKNSkimNotesWritingCompact) ? SKNCompactDataFromSkimNotes(notes) : SKNDataFromSkimNotes(notes, asPlist);
         success = [data writeToURL:aURL options:NSAtomicWrite error:outError];
     }
     return success;
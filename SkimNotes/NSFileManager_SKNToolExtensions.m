@@ -153,16 +153,28 @@
     NSError *error = nil;
     NSString *extension = [path pathExtension];
     
-    [self removeSkimNotesAtPath:path error:NULL];
+    // attributes are replaced in place, keeping the fragments that did not change, unless they were written with the other syncable flag
+    if ([notesData length] == 0 || [extension caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame || [self hasSkimNotesAtPath:path syncable:syncable ? SKNNonSyncable : SKNSyncable])
+        [self removeSkimNotesAtPath:path error:NULL];
     if ([notesData length]) {
-        if (textNotes == nil || rtfNotesData == nil) {
-            NSArray *notes = SKNSkimNotesFromData(notesData);
-            if ([notes count]) {
-                if (textNotes == nil)
-                    textNotes = SKNSkimTextNotes(notes);
-                if (rtfNotesData == nil)
-                    rtfNotesData = SKNSkimRTFNotes(notes);
-            }
+        // render the missing text representations in the background while we write the notes themselves
+        __block NSString *generatedTextNotes = nil;
+        __block NSData *generatedRTFNotesData = nil;
+        BOOL needsTextNotes = textNotes == nil, needsRTFNotes = rtfNotesData == nil;
+        dispatch_group_t group = NULL;
+        if (needsTextNotes || needsRTFNotes) {
+            group = dispatch_group_create();
+            dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                NSAutoreleasePool *pool = [NSAutoreleasePool new];
+                if (SKNSkimTextAndRTFNotesFromData(notesData, needsTextNotes ? &generatedTextNotes : NULL, needsRTFNotes ? &generatedRTFNotesData : NULL)) {
+                    [generatedTextNotes retain];
+                    [generatedRTFNotesData retain];
+                } else {
+                    generatedTextNotes = nil;
+                    generatedRTFNotesData = nil;
+                }
+                [pool release];
+            });
         }
         if ([extension caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame) {
             NSString *name = [[path lastPathComponent] stringByDeletingPathExtension];
@@ -170,6 +182,13 @@
                 name = [name stringByAppendingString:@"1"];
             NSString *notePath = [[path stringByAppendingPathComponent:name] stringByAppendingPathExtension:SKIM_EXTENSION];
             success = [notesData writeToFile:notePath options:0 error:&error];
+            if (group) {
+                dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                if (needsTextNotes)
+                    textNotes = [generatedTextNotes autorelease];
+                if (needsRTFNotes)
+                    rtfNotesData = [generatedRTFNotesData autorelease];
+            }
             if (textNotes) {
                 notePath = [[path stringByAppendingPathComponent:name] stringByAppendingPathExtension:TXT_EXTENSION];
                 [textNotes writeToFile:notePath atomically:NO encoding:NSUTF8StringEncoding error:NULL];
@@ -182,11 +201,24 @@
             SKNExtendedAttributeManager *eam = [SKNExtendedAttributeManager sharedManager];
             SKNXattrFlags options = syncable ? kSKNXattrSyncable : kSKNXattrDefault;
             success = [eam setExtendedAttributeNamed:SKIM_NOTES_KEY toValue:notesData atPath:path options:options error:&error];
+            if (group) {
+                dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+                if (needsTextNotes)
+                    textNotes = [generatedTextNotes autorelease];
+                if (needsRTFNotes)
+                    rtfNotesData = [generatedRTFNotesData autorelease];
+            }
             if (textNotes)
                 [eam setExtendedAttributeNamed:SKIM_TEXT_NOTES_KEY toPropertyListValue:textNotes atPath:path options:options error:NULL];
+            else
+                [eam removeExtendedAttributeNamed:SKIM_TEXT_NOTES_KEY atPath:path traverseLink:YES error:NULL];
             if (rtfNotesData)
                 [eam setExtendedAttributeNamed:SKIM_RTF_NOTES_KEY toValue:rtfNotesData atPath:path options:options error:NULL];
+            else
+                [eam removeExtendedAttributeNamed:SKIM_RTF_NOTES_KEY atPath:path traverseLink:YES error:NULL];
         }
+        if (group)
+            dispatch_release(group);
     }
     return success;
 }
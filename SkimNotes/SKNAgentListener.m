@@ -129,4 +129,41 @@
     return [string dataUsingEncoding:encoding];
 }
 
+// the files are read concurrently, every block returns an autoreleased result or nil
+- (NSArray *)notesAtPaths:(NSArray *)files usingBlock:(NSData *(^)(NSString *aFile))block;
+{
+    NSUInteger count = [files count];
+    id *results = (id *)NSZoneCalloc(NULL, MAX(count, 1), sizeof(id));
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i){
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSString *aFile = [files objectAtIndex:i];
+        if ([aFile isKindOfClass:[NSString class]])
+            results[i] = [block(aFile) retain];
+        [pool release];
+    });
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+    NSUInteger i;
+    for (i = 0; i < count; i++) {
+        [array addObject:results[i] ?: [NSNull null]];
+        [results[i] release];
+    }
+    NSZoneFree(NULL, results);
+    return array;
+}
+
+- (bycopy NSArray *)SkimNotesAtPaths:(in bycopy NSArray *)files;
+{
+    return [self notesAtPaths:files usingBlock:^(NSString *aFile){ return [self SkimNotesAtPath:aFile]; }];
+}
+
+- (bycopy NSArray *)RTFNotesAtPaths:(in bycopy NSArray *)files;
+{
+    return [self notesAtPaths:files usingBlock:^(NSString *aFile){ return [self RTFNotesAtPath:aFile]; }];
+}
+
+- (bycopy NSArray *)textNotesAtPaths:(in bycopy NSArray *)files encoding:(NSStringEncoding)encoding;
+{
+    return [self notesAtPaths:files usingBlock:^(NSString *aFile){ return [self textNotesAtPath:aFile encoding:encoding]; }];
+}
+
 @end
@@ -41,4 +41,9 @@
 - (bycopy NSData *)RTFNotesAtPath:(in bycopy NSString *)aFile;
 - (bycopy NSData *)textNotesAtPath:(in bycopy NSString *)aFile encoding:(NSStringEncoding)encoding;
 
+// batch versions, the results are in the same order as the files, with NSNull for files that failed
+- (bycopy NSArray *)SkimNotesAtPaths:(in bycopy NSArray *)files;
+- (bycopy NSArray *)RTFNotesAtPaths:(in bycopy NSArray *)files;
+- (bycopy NSArray *)textNotesAtPaths:(in bycopy NSArray *)files encoding:(NSStringEncoding)encoding;
+
 @end
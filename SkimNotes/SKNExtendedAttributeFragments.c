@@ -0,0 +1,720 @@
+//
+//  SKNExtendedAttributeFragments.c
+//  SkimNotes
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SKNExtendedAttributeFragments.h"
+#include <sys/types.h>
+#include <sys/xattr.h>
+#include <bzlib.h>
+#include <zlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAGMENT_NAME_SEPARATOR '-'
+#define MAX_FRAGMENT_NAME_LENGTH 1024
+
+#if defined(__APPLE__)
+#define SKNGetxattr(path, name, value, size, follow) getxattr(path, name, value, size, 0, (follow) ? 0 : XATTR_NOFOLLOW)
+#define SKNListxattr(path, names, size, follow) listxattr(path, names, size, (follow) ? 0 : XATTR_NOFOLLOW)
+#else
+#define SKNGetxattr(path, name, value, size, follow) ((follow) ? getxattr(path, name, value, size) : lgetxattr(path, name, value, size))
+#define SKNListxattr(path, names, size, follow) ((follow) ? listxattr(path, names, size) : llistxattr(path, names, size))
+#ifndef ENOATTR
+#define ENOATTR ENODATA
+#endif
+#endif
+
+#if defined(__APPLE__)
+#include <compression.h>
+#define SKN_HAS_COMPRESSION_FRAMEWORK 1
+#endif
+
+#define BZIP_COMPRESSION_LEVEL 5
+// on notes archives this is within a few percent of the default level at a third of the time
+#define ZLIB_COMPRESSION_LEVEL 1
+
+int SKNCodecIsAvailable(SKNCodec codec) {
+    switch (codec) {
+        case SKNCodecBzip2:
+        case SKNCodecZlib:
+            return 1;
+        case SKNCodecLZ4:
+        case SKNCodecLZFSE:
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+            // libcompression is weakly linked
+            if (__builtin_available(macOS 10.11, iOS 9.0, *))
+                return 1;
+#endif
+            return 0;
+    }
+    return 0;
+}
+
+SKNCodec SKNDefaultCodec(void) {
+    // the only codec older versions can read
+    return SKNCodecBzip2;
+}
+
+void *SKNCopyCompressedBytes(SKNCodec codec, const void *bytes, size_t length, size_t *compressedLength) {
+    size_t capacity;
+    char *buffer;
+    int success = 0;
+    
+    if (SKNCodecIsAvailable(codec) == 0) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    if (length > UINT_MAX / 2) {
+        errno = EFBIG;
+        return NULL;
+    }
+    
+    switch (codec) {
+        case SKNCodecBzip2:
+            // the bound given by the bzip2 documentation
+            capacity = length + length / 100 + 601;
+            break;
+        case SKNCodecZlib:
+            capacity = compressBound((uLong)length);
+            break;
+        default:
+            // incompressible data is stored in raw blocks
+            capacity = length + length / 16 + 1024;
+            break;
+    }
+    
+    buffer = (char *)malloc(capacity);
+    if (buffer == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    
+    switch (codec) {
+        case SKNCodecBzip2:
+        {
+            unsigned int destLength = (unsigned int)capacity;
+            if (BZ2_bzBuffToBuffCompress(buffer, &destLength, (char *)bytes, (unsigned int)length, BZIP_COMPRESSION_LEVEL, 0, 0) == BZ_OK) {
+                *compressedLength = destLength;
+                success = 1;
+            }
+            break;
+        }
+        case SKNCodecZlib:
+        {
+            uLongf destLength = (uLongf)capacity;
+            if (compress2((Bytef *)buffer, &destLength, (const Bytef *)bytes, (uLong)length, ZLIB_COMPRESSION_LEVEL) == Z_OK) {
+                *compressedLength = destLength;
+                success = 1;
+            }
+            break;
+        }
+        case SKNCodecLZ4:
+        case SKNCodecLZFSE:
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+            if (__builtin_available(macOS 10.11, iOS 9.0, *)) {
+                size_t destLength = compression_encode_buffer((uint8_t *)buffer, capacity, (const uint8_t *)bytes, length, NULL, codec == SKNCodecLZ4 ? COMPRESSION_LZ4 : COMPRESSION_LZFSE);
+                if (destLength > 0) {
+                    *compressedLength = destLength;
+                    success = 1;
+                }
+            }
+#endif
+            break;
+    }
+    
+    if (success == 0) {
+        free(buffer);
+        errno = EINVAL;
+        return NULL;
+    }
+    return buffer;
+}
+
+typedef enum {
+    SKNDecodeOK,
+    SKNDecodeEnd,
+    SKNDecodeError
+} SKNDecodeStatus;
+
+typedef struct {
+    SKNCodec codec;
+    union {
+        bz_stream bz;
+        z_stream z;
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+        compression_stream cs;
+#endif
+    } stream;
+} SKNDecoder;
+
+static int SKNDecoderInit(SKNDecoder *decoder, SKNCodec codec) {
+    memset(decoder, 0, sizeof(SKNDecoder));
+    decoder->codec = codec;
+    switch (codec) {
+        case SKNCodecBzip2:
+            return BZ2_bzDecompressInit(&decoder->stream.bz, 0, 0) == BZ_OK;
+        case SKNCodecZlib:
+            return inflateInit(&decoder->stream.z) == Z_OK;
+        case SKNCodecLZ4:
+        case SKNCodecLZFSE:
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+            if (__builtin_available(macOS 10.11, iOS 9.0, *))
+                return compression_stream_init(&decoder->stream.cs, COMPRESSION_STREAM_DECODE, codec == SKNCodecLZ4 ? COMPRESSION_LZ4 : COMPRESSION_LZFSE) == COMPRESSION_STATUS_OK;
+#endif
+            return 0;
+    }
+    return 0;
+}
+
+static void SKNDecoderEnd(SKNDecoder *decoder) {
+    switch (decoder->codec) {
+        case SKNCodecBzip2:
+            BZ2_bzDecompressEnd(&decoder->stream.bz);
+            break;
+        case SKNCodecZlib:
+            inflateEnd(&decoder->stream.z);
+            break;
+        case SKNCodecLZ4:
+        case SKNCodecLZFSE:
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+            if (__builtin_available(macOS 10.11, iOS 9.0, *))
+                compression_stream_destroy(&decoder->stream.cs);
+#endif
+            break;
+    }
+}
+
+// Decodes as much of the input as fits in the output, setting how much of either was used.
+static SKNDecodeStatus SKNDecoderProcess(SKNDecoder *decoder, const char *input, size_t inputLength, size_t *inputUsed, char *output, size_t outputLength, size_t *outputUsed, int finish) {
+    unsigned int availableIn = (unsigned int)(inputLength < (size_t)UINT_MAX ? inputLength : UINT_MAX);
+    unsigned int availableOut = (unsigned int)(outputLength < (size_t)UINT_MAX ? outputLength : UINT_MAX);
+    SKNDecodeStatus status = SKNDecodeError;
+    
+    *inputUsed = 0;
+    *outputUsed = 0;
+    
+    switch (decoder->codec) {
+        case SKNCodecBzip2:
+        {
+            bz_stream *stream = &decoder->stream.bz;
+            int bzret;
+            stream->next_in = (char *)input;
+            stream->avail_in = availableIn;
+            stream->next_out = output;
+            stream->avail_out = availableOut;
+            bzret = BZ2_bzDecompress(stream);
+            *inputUsed = availableIn - stream->avail_in;
+            *outputUsed = availableOut - stream->avail_out;
+            status = bzret == BZ_STREAM_END ? SKNDecodeEnd : bzret == BZ_OK ? SKNDecodeOK : SKNDecodeError;
+            break;
+        }
+        case SKNCodecZlib:
+        {
+            z_stream *stream = &decoder->stream.z;
+            int zret;
+            stream->next_in = (Bytef *)input;
+            stream->avail_in = availableIn;
+            stream->next_out = (Bytef *)output;
+            stream->avail_out = availableOut;
+            zret = inflate(stream, Z_NO_FLUSH);
+            *inputUsed = availableIn - stream->avail_in;
+            *outputUsed = availableOut - stream->avail_out;
+            // a buffer error only means that no progress was possible
+            status = zret == Z_STREAM_END ? SKNDecodeEnd : (zret == Z_OK || zret == Z_BUF_ERROR) ? SKNDecodeOK : SKNDecodeError;
+            break;
+        }
+        case SKNCodecLZ4:
+        case SKNCodecLZFSE:
+#ifdef SKN_HAS_COMPRESSION_FRAMEWORK
+            if (__builtin_available(macOS 10.11, iOS 9.0, *)) {
+                compression_stream *stream = &decoder->stream.cs;
+                compression_status cstatus;
+                stream->src_ptr = (const uint8_t *)input;
+                stream->src_size = inputLength;
+                stream->dst_ptr = (uint8_t *)output;
+                stream->dst_size = outputLength;
+                cstatus = compression_stream_process(stream, finish ? COMPRESSION_STREAM_FINALIZE : 0);
+                *inputUsed = inputLength - stream->src_size;
+                *outputUsed = outputLength - stream->dst_size;
+                status = cstatus == COMPRESSION_STATUS_END ? SKNDecodeEnd : cstatus == COMPRESSION_STATUS_OK ? SKNDecodeOK : SKNDecodeError;
+            }
+#endif
+            break;
+    }
+    return status;
+}
+
+void *SKNCopyExtendedAttribute(const char *path, const char *name, int follow, size_t expectedLength, size_t *length) {
+    size_t size = expectedLength > 0 ? expectedLength : 1;
+    char *value = (char *)malloc(size);
+    ssize_t status;
+    
+    if (value == NULL)
+        return NULL;
+    
+    while ((status = SKNGetxattr(path, name, value, size, follow)) == -1 && errno == ERANGE) {
+        // longer than expected, only now ask for the size
+        char *newValue;
+        status = SKNGetxattr(path, name, NULL, 0, follow);
+        if (status == -1)
+            break;
+        size = status > 0 ? (size_t)status : 1;
+        newValue = (char *)realloc(value, size);
+        if (newValue == NULL) {
+            free(value);
+            errno = ENOMEM;
+            return NULL;
+        }
+        value = newValue;
+    }
+    
+    if (status == -1) {
+        int err = errno;
+        free(value);
+        errno = err;
+        return NULL;
+    }
+    
+    *length = (size_t)status;
+    return value;
+}
+
+// Lists the attribute names in a single call for the usual number of names.
+static char *SKNCopyExtendedAttributeNames(const char *path, int follow, size_t expectedLength, size_t *length) {
+    size_t size = expectedLength;
+    char *names = NULL;
+    ssize_t status;
+    
+    do {
+        char *newNames = (char *)realloc(names, size);
+        if (newNames == NULL) {
+            free(names);
+            errno = ENOMEM;
+            return NULL;
+        }
+        names = newNames;
+        status = SKNListxattr(path, names, size, follow);
+        if (status == -1 && errno == ERANGE) {
+            status = SKNListxattr(path, NULL, 0, follow);
+            if (status != -1) {
+                size = (size_t)status + 1;
+                errno = ERANGE;
+                status = -1;
+            }
+        }
+    } while (status == -1 && errno == ERANGE);
+    
+    if (status == -1) {
+        int err = errno;
+        free(names);
+        errno = err;
+        return NULL;
+    }
+    
+    *length = (size_t)status;
+    return names;
+}
+
+// Marks the fragments of uniqueName in the listed names, with the given suffix or without one.
+// Returns the number of different fragments found.
+static size_t SKNFindFragments(const char *names, size_t length, const char *uniqueName, const char *suffix, size_t numberOfFragments, unsigned char *found, unsigned char *foundWithoutSuffix) {
+    size_t uniqueLength = strlen(uniqueName);
+    const char *name = names, *end = names + length;
+    size_t count = 0;
+    
+    while (name < end) {
+        size_t nameLength = strnlen(name, end - name);
+        if (nameLength > uniqueLength + 1 && strncmp(name, uniqueName, uniqueLength) == 0 && name[uniqueLength] == FRAGMENT_NAME_SEPARATOR) {
+            const char *ptr = name + uniqueLength + 1;
+            size_t i = 0;
+            if (*ptr >= '0' && *ptr <= '9') {
+                while (*ptr >= '0' && *ptr <= '9' && i < numberOfFragments)
+                    i = 10 * i + (*ptr++ - '0');
+                if (i < numberOfFragments) {
+                    if (strcmp(ptr, suffix) == 0) {
+                        if (found[i] == 0)
+                            count++;
+                        found[i] = 1;
+                    } else if (*ptr == '\0') {
+                        foundWithoutSuffix[i] = 1;
+                    }
+                }
+            }
+        }
+        name += nameLength + 1;
+    }
+    return count;
+}
+
+// Decompresses the input after what was consumed, growing the output buffer as needed.
+// When finish is set, all the input has been read, and the stream must end.
+static SKNDecodeStatus SKNDecompress(SKNDecoder *decoder, const char *input, size_t inputLength, size_t *consumed, char **output, size_t *outputLength, size_t *outputCapacity, int finish) {
+    SKNDecodeStatus status = SKNDecodeOK;
+    
+    while (status == SKNDecodeOK && (*consumed < inputLength || finish)) {
+        size_t inputUsed, outputUsed;
+        if (*outputLength == *outputCapacity) {
+            size_t capacity = 2 * *outputCapacity;
+            char *newOutput = (char *)realloc(*output, capacity);
+            if (newOutput == NULL)
+                return SKNDecodeError;
+            *output = newOutput;
+            *outputCapacity = capacity;
+        }
+        status = SKNDecoderProcess(decoder, input + *consumed, inputLength - *consumed, &inputUsed, *output + *outputLength, *outputCapacity - *outputLength, &outputUsed, finish);
+        *consumed += inputUsed;
+        *outputLength += outputUsed;
+        // without progress we need more input, and when there is none the data was truncated
+        if (status == SKNDecodeOK && inputUsed == 0 && outputUsed == 0)
+            return finish ? SKNDecodeError : SKNDecodeOK;
+    }
+    return status;
+}
+
+// Reads the fragments one by one, each with a single call at its offset, and decompresses them into the output as they come in.
+// When tryWithoutSuffix is set and the first fragment is not found, the fragments written before the suffix was used are read.
+static SKNFragmentsStatus SKNDecompressFragments(const char *path, const char *uniqueName, const char *suffix, int tryWithoutSuffix, size_t numberOfFragments, size_t fragmentLength, SKNCodec codec, int follow, char **output, size_t *outputLength, size_t *outputCapacity) {
+    char name[MAX_FRAGMENT_NAME_LENGTH];
+    char *input = NULL;
+    size_t inputLength = 0, inputCapacity, consumed = 0;
+    size_t i;
+    SKNDecoder decoder;
+    SKNDecodeStatus decodeStatus = SKNDecodeOK;
+    int err = 0;
+    
+    // all fragments but the last have the full length
+    inputCapacity = numberOfFragments * fragmentLength;
+    input = (char *)malloc(inputCapacity);
+    if (input == NULL) {
+        errno = ENOMEM;
+        return SKNFragmentsMissing;
+    }
+    if (SKNDecoderInit(&decoder, codec) == 0) {
+        free(input);
+        return SKNFragmentsInvalidData;
+    }
+    
+    for (i = 0; i < numberOfFragments && decodeStatus == SKNDecodeOK; i++) {
+        ssize_t status;
+
+        if (inputLength == inputCapacity) {
+            // earlier fragments were longer than expected, and reading with a zero size would only get the size
+            char *newInput = (char *)realloc(input, inputCapacity + fragmentLength);
+            if (newInput == NULL) {
+                err = ENOMEM;
+                break;
+            }
+            input = newInput;
+            inputCapacity += fragmentLength;
+        }
+
+        snprintf(name, sizeof(name), "%s%c%lu%s", uniqueName, FRAGMENT_NAME_SEPARATOR, (unsigned long)i, suffix);
+        status = SKNGetxattr(path, name, input + inputLength, inputCapacity - inputLength, follow);
+        if (status == -1 && errno == ENOATTR && i == 0 && tryWithoutSuffix && *suffix != '\0') {
+            // we could not list the names, try the old name without the suffix
+            snprintf(name, sizeof(name), "%s%c%lu", uniqueName, FRAGMENT_NAME_SEPARATOR, (unsigned long)i);
+            status = SKNGetxattr(path, name, input + inputLength, inputCapacity - inputLength, follow);
+            if (status != -1)
+                suffix = "";
+        }
+        while (status == -1 && errno == ERANGE) {
+            // a fragment longer than expected, written by someone else
+            char *newInput;
+            status = SKNGetxattr(path, name, NULL, 0, follow);
+            if (status == -1)
+                break;
+            inputCapacity = inputLength + (size_t)status + (numberOfFragments - i - 1) * fragmentLength;
+            newInput = (char *)realloc(input, inputCapacity);
+            if (newInput == NULL) {
+                errno = ENOMEM;
+                status = -1;
+                break;
+            }
+            input = newInput;
+            status = SKNGetxattr(path, name, input + inputLength, inputCapacity - inputLength, follow);
+        }
+        if (status == -1) {
+            err = errno;
+            break;
+        }
+        inputLength += (size_t)status;
+        
+        // decompress what we have while the next fragments are still to be read
+        decodeStatus = SKNDecompress(&decoder, input, inputLength, &consumed, output, outputLength, outputCapacity, i == numberOfFragments - 1);
+    }
+    
+    SKNDecoderEnd(&decoder);
+    free(input);
+    
+    if (err != 0) {
+        errno = err;
+        return SKNFragmentsMissing;
+    }
+    return decodeStatus == SKNDecodeEnd ? SKNFragmentsOK : SKNFragmentsInvalidData;
+}
+
+// Shrinks the output to its length and hands it over.
+static void SKNSetOutput(char *output, size_t outputLength, void **bytes, size_t *length) {
+    char *value = (char *)realloc(output, outputLength > 0 ? outputLength : 1);
+    *bytes = value ? value : output;
+    *length = outputLength;
+}
+
+SKNFragmentsStatus SKNCopyReassembledFragments(const char *path, const char *uniqueName, const char *suffix, size_t numberOfFragments, size_t fragmentLength, SKNCodec codec, int follow, void **bytes, size_t *length) {
+    SKNFragmentsStatus result;
+    size_t uniqueLength = strlen(uniqueName);
+    char *names = NULL;
+    size_t namesLength = 0;
+    int listed = 0;
+    unsigned char *found = NULL;
+    char *output = NULL;
+    size_t outputLength = 0, outputCapacity;
+    
+    if (numberOfFragments == 0 || fragmentLength == 0 || uniqueLength + strlen(suffix) + 24 > MAX_FRAGMENT_NAME_LENGTH) {
+        errno = EINVAL;
+        return SKNFragmentsMissing;
+    }
+    
+    // list the names once, to find out how the fragments are named and whether they are all there
+    names = SKNCopyExtendedAttributeNames(path, follow, numberOfFragments * (uniqueLength + strlen(suffix) + 8) + 4096, &namesLength);
+    if (names) {
+        listed = 1;
+        found = (unsigned char *)calloc(2 * numberOfFragments, 1);
+        if (found == NULL) {
+            free(names);
+            errno = ENOMEM;
+            return SKNFragmentsMissing;
+        }
+        if (SKNFindFragments(names, namesLength, uniqueName, suffix, numberOfFragments, found, found + numberOfFragments) < numberOfFragments) {
+            // fragments written before the suffix was used
+            if (*suffix != '\0' && memchr(found + numberOfFragments, 0, numberOfFragments) == NULL) {
+                suffix = "";
+            } else {
+                free(found);
+                free(names);
+                errno = ENOATTR;
+                return SKNFragmentsMissing;
+            }
+        }
+        free(found);
+        free(names);
+    }
+    
+    outputCapacity = 4 * numberOfFragments * fragmentLength;
+    output = (char *)malloc(outputCapacity);
+    if (output == NULL) {
+        errno = ENOMEM;
+        return SKNFragmentsMissing;
+    }
+    
+    result = SKNDecompressFragments(path, uniqueName, suffix, listed == 0, numberOfFragments, fragmentLength, codec, follow, &output, &outputLength, &outputCapacity);
+    
+    if (result == SKNFragmentsOK) {
+        SKNSetOutput(output, outputLength, bytes, length);
+    } else {
+        int err = errno;
+        free(output);
+        errno = err;
+    }
+    return result;
+}
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t SKNFinalMix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline uint64_t SKNReadLittleEndian64(const unsigned char *bytes, size_t length) {
+    uint64_t k = 0;
+    while (length-- > 0)
+        k = (k << 8) | bytes[length];
+    return k;
+}
+
+// MurmurHash3 x64 128, independent of the byte order of the machine
+void SKNChunkDigest(const void *data, size_t length, uint64_t seed, unsigned char digest[SKN_CHUNK_DIGEST_LENGTH]) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed, h2 = seed, k1, k2;
+    size_t i, blocks = length / 16, tail = length % 16;
+    
+    for (i = 0; i < blocks; i++) {
+        k1 = SKNReadLittleEndian64(bytes + 16 * i, 8);
+        k2 = SKNReadLittleEndian64(bytes + 16 * i + 8, 8);
+        k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    
+    bytes += 16 * blocks;
+    if (tail > 8) {
+        k2 = SKNReadLittleEndian64(bytes + 8, tail - 8);
+        k2 *= c2; k2 = ROTL64(k2, 33); k2 *= c1; h2 ^= k2;
+    }
+    if (tail > 0) {
+        k1 = SKNReadLittleEndian64(bytes, tail > 8 ? 8 : tail);
+        k1 *= c1; k1 = ROTL64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+    
+    h1 ^= (uint64_t)length;
+    h2 ^= (uint64_t)length;
+    h1 += h2;
+    h2 += h1;
+    h1 = SKNFinalMix(h1);
+    h2 = SKNFinalMix(h2);
+    h1 += h2;
+    h2 += h1;
+    
+    for (i = 0; i < 8; i++) {
+        digest[i] = (unsigned char)(h1 >> (56 - 8 * i));
+        digest[8 + i] = (unsigned char)(h2 >> (56 - 8 * i));
+    }
+}
+
+uint64_t SKNChunkSeed(const char *name, SKNCodec codec) {
+    unsigned char digest[SKN_CHUNK_DIGEST_LENGTH];
+    SKNChunkDigest(name, strlen(name), (uint64_t)codec, digest);
+    return SKNReadLittleEndian64(digest, 8);
+}
+
+SKNChunk *SKNCopyContentDefinedChunks(const void *bytes, size_t length, size_t averageLength, uint64_t seed, size_t *count) {
+    const unsigned char *data = (const unsigned char *)bytes;
+    uint64_t gear[256], x = 0;
+    size_t minLength, maxLength, capacity, n = 0, start = 0;
+    unsigned int bits = 0;
+    uint64_t mask;
+    SKNChunk *chunks;
+    int i;
+    
+    if (averageLength < 64) {
+        errno = EINVAL;
+        return NULL;
+    }
+    
+    // a fixed pseudo-random table, the chunk boundaries must not change between versions
+    for (i = 0; i < 256; i++) {
+        x += 0x9e3779b97f4a7c15ULL;
+        gear[i] = SKNFinalMix(x);
+    }
+    
+    while (((size_t)1 << (bits + 1)) <= averageLength)
+        bits++;
+    minLength = averageLength / 4;
+    maxLength = averageLength * 4;
+    // testing the top bits - 1 bits puts a boundary on average half of averageLength past the minimum
+    mask = ~(uint64_t)0 << (64 - (bits - 1));
+    
+    capacity = length / minLength + 1;
+    chunks = (SKNChunk *)malloc(capacity * sizeof(SKNChunk));
+    if (chunks == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    
+    while (start < length) {
+        size_t end = length - start <= minLength ? length : start + minLength;
+        size_t limit = length - start <= maxLength ? length : start + maxLength;
+        uint64_t hash = 0;
+        
+        // the gear hash depends on the last 64 bytes, so boundaries realign soon after an edit
+        while (end < limit) {
+            hash = (hash << 1) + gear[data[end++]];
+            if ((hash & mask) == 0)
+                break;
+        }
+        
+        chunks[n].offset = start;
+        chunks[n].length = end - start;
+        SKNChunkDigest(data + start, end - start, seed, chunks[n].digest);
+        n++;
+        start = end;
+    }
+    
+    *count = n;
+    return chunks;
+}
+
+SKNFragmentsStatus SKNCopyReassembledChunks(const char *path, const char * const *uniqueNames, const size_t *numbersOfFragments, size_t count, const char *suffix, size_t fragmentLength, SKNCodec codec, int follow, void **bytes, size_t *length) {
+    SKNFragmentsStatus result = SKNFragmentsOK;
+    char *output = NULL;
+    size_t outputLength = 0, outputCapacity = 0;
+    size_t i;
+    
+    if (fragmentLength == 0) {
+        errno = EINVAL;
+        return SKNFragmentsMissing;
+    }
+    for (i = 0; i < count; i++) {
+        if (numbersOfFragments[i] == 0 || strlen(uniqueNames[i]) + strlen(suffix) + 24 > MAX_FRAGMENT_NAME_LENGTH) {
+            errno = EINVAL;
+            return SKNFragmentsMissing;
+        }
+        outputCapacity += 4 * numbersOfFragments[i] * fragmentLength;
+    }
+    
+    output = (char *)malloc(outputCapacity > 0 ? outputCapacity : 1);
+    if (output == NULL) {
+        errno = ENOMEM;
+        return SKNFragmentsMissing;
+    }
+    if (outputCapacity == 0)
+        outputCapacity = 1;
+    
+    // the chunks are compressed separately, and are never written without the suffix
+    for (i = 0; i < count && result == SKNFragmentsOK; i++)
+        result = SKNDecompressFragments(path, uniqueNames[i], suffix, 0, numbersOfFragments[i], fragmentLength, codec, follow, &output, &outputLength, &outputCapacity);
+    
+    if (result == SKNFragmentsOK) {
+        SKNSetOutput(output, outputLength, bytes, length);
+    } else {
+        int err = errno;
+        free(output);
+        errno = err;
+    }
+    return result;
+}
@@ -0,0 +1,106 @@
+//
+//  SKNExtendedAttributeFragments.h
+//  SkimNotes
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SKNFragmentsOK,
+    SKNFragmentsMissing,       // a fragment could not be read, errno is set
+    SKNFragmentsInvalidData    // the fragments do not contain valid data for the codec
+} SKNFragmentsStatus;
+
+// The same values as SKNXattrCodec
+typedef enum {
+    SKNCodecBzip2,
+    SKNCodecZlib,
+    SKNCodecLZ4,
+    SKNCodecLZFSE
+} SKNCodec;
+
+// Whether data can be compressed and decompressed with the codec on this system.
+extern int SKNCodecIsAvailable(SKNCodec codec);
+
+// The codec used when none is specified, bzip2.
+extern SKNCodec SKNDefaultCodec(void);
+
+// Compresses the bytes with the codec.
+// Returns a malloc'ed buffer, or NULL with errno set.
+extern void *SKNCopyCompressedBytes(SKNCodec codec, const void *bytes, size_t length, size_t *compressedLength);
+
+// Reads the value of an attribute in a single call when it is not longer than expectedLength.
+// Returns a malloc'ed buffer, or NULL with errno set.
+extern void *SKNCopyExtendedAttribute(const char *path, const char *name, int follow, size_t expectedLength, size_t *length);
+
+// Reassembles and decompresses the value of a split attribute from the fragments named uniqueName-0suffix to uniqueName-(numberOfFragments-1)suffix,
+// or without the suffix when the fragments were written before the suffix was used.
+// The attribute names are listed once, each fragment is read with a single call at its offset in a buffer allocated from fragmentLength,
+// and the data is decompressed with the codec as the fragments come in.
+// On success, bytes is set to a malloc'ed buffer with the value.
+extern SKNFragmentsStatus SKNCopyReassembledFragments(const char *path, const char *uniqueName, const char *suffix, size_t numberOfFragments, size_t fragmentLength, SKNCodec codec, int follow, void **bytes, size_t *length);
+
+#define SKN_CHUNK_DIGEST_LENGTH 16
+
+typedef struct {
+    size_t offset;
+    size_t length;
+    unsigned char digest[SKN_CHUNK_DIGEST_LENGTH];
+} SKNChunk;
+
+// A seed for the digests of the chunks of an attribute, so different attributes and codecs never share chunk names.
+extern uint64_t SKNChunkSeed(const char *name, SKNCodec codec);
+
+// A 128 bit hash of the bytes and the seed.
+extern void SKNChunkDigest(const void *bytes, size_t length, uint64_t seed, unsigned char digest[SKN_CHUNK_DIGEST_LENGTH]);
+
+// Splits the bytes into chunks of about averageLength at boundaries determined by the content, so an edit only changes the chunks around it.
+// The digest of each chunk is the SKNChunkDigest of its bytes and the seed.
+// Returns a malloc'ed array of chunks, or NULL with errno set.
+extern SKNChunk *SKNCopyContentDefinedChunks(const void *bytes, size_t length, size_t averageLength, uint64_t seed, size_t *count);
+
+// Reassembles a value from chunks that were compressed separately, the fragments of chunk i are named uniqueNames[i]-0suffix to uniqueNames[i]-(numbersOfFragments[i]-1)suffix.
+// On success, bytes is set to a malloc'ed buffer with the value.
+extern SKNFragmentsStatus SKNCopyReassembledChunks(const char *path, const char * const *uniqueNames, const size_t *numbersOfFragments, size_t count, const char *suffix, size_t fragmentLength, SKNCodec codec, int follow, void **bytes, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
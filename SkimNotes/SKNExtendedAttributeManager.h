@@ -53,6 +53,7 @@
     @constant    kSKNXattrNoSplitData  Don't split data objects into segments.
     @constant    kSKNXattrNoCompress   Don't compress data to reduce space for long attributes.
     @constant    kSKNXattrSyncable     Add a syncable flag to the attribute name if available.
+    @constant    kSKNXattrChunkData    Split data into content-addressed chunks, so setting it again only writes the changed chunks.  Older versions of SkimNotes cannot read data split this way.
 */
 enum {
     kSKNXattrDefault     = 0,
@@ -61,10 +62,31 @@ enum {
     kSKNXattrReplaceOnly = 1 << 3,
     kSKNXattrNoSplitData = 1 << 4,
     kSKNXattrNoCompress  = 1 << 5,
-    kSKNXattrSyncable    = 1 << 6
+    kSKNXattrSyncable    = 1 << 6,
+    kSKNXattrChunkData   = 1 << 7
 };
 typedef NSInteger SKNXattrFlags;
 
+/*!
+    @enum        SKNXattrCodec 
+    @abstract    Codecs for compressing split extended attributes.
+    @discussion  Data that is split into fragments is compressed using one of these codecs.  The codec is saved with the fragments, so the data can be read back whatever codec was used.
+                 Data compressed using a codec other than bzip2 cannot be read by versions of SkimNotes that do not know about codecs.
+    @constant    kSKNXattrCodecDefault  bzip2.
+    @constant    kSKNXattrCodecBzip2    bzip2, compresses best but is slowest.  This is the only codec older versions of SkimNotes can read.
+    @constant    kSKNXattrCodecZlib     zlib.
+    @constant    kSKNXattrCodecLZ4      LZ4, fastest but compresses least.  Requires macOS 10.11.
+    @constant    kSKNXattrCodecLZFSE    LZFSE.  Requires macOS 10.11.
+*/
+enum {
+    kSKNXattrCodecDefault = -1,
+    kSKNXattrCodecBzip2   = 0,
+    kSKNXattrCodecZlib    = 1,
+    kSKNXattrCodecLZ4     = 2,
+    kSKNXattrCodecLZFSE   = 3
+};
+typedef NSInteger SKNXattrCodec;
+
 /*!
     @discussion  Error domain for the extended attribute manager used for non-POSIX errors.
 */
@@ -95,6 +117,9 @@ enum {
     NSString *uniqueKey;
     NSString *wrapperKey;
     NSString *fragmentsKey;
+    NSString *codecKey;
+    NSString *chunksKey;
+    NSString *chunkListKey;
 }
 
 /*!
@@ -169,7 +194,8 @@ enum {
 /*!
     @abstract   Sets the value of attribute named <code>attr</code> to <code>value</code>, which is an <code>NSData</code> object.
     @discussion Calls <code>setxattr(2)</code> to set the attributes for the file.
-                If the options do not contain the <code>kSKNXattrNoSplitData</code> flag and the prefix is not <code>nil</code>, the data may be split into subfragments and a dictionary pointing to the fragments is saved in the attribute names <code>attr</code>.
+                If the options do not contain the <code>kSKNXattrNoSplitData</code> flag and the prefix is not <code>nil</code>, the data may be split into subfragments and a dictionary pointing to the fragments is saved in the attribute names <code>attr</code>. The fragments are compressed using the default codec.
+                If the options contain the <code>kSKNXattrChunkData</code> flag, the data is cut into chunks at places determined by its content, and the fragments of a chunk are named after a hash of its content.  When an attribute is set again, only the chunks that changed are written, and only the fragments that are no longer used are removed.
     @param      attr The attribute name.
     @param      value The value of the attribute as <code>NSData</code>.
     @param      path Path to the object in the file system.
@@ -179,6 +205,20 @@ enum {
 */
 - (BOOL)setExtendedAttributeNamed:(NSString *)attr toValue:(NSData *)value atPath:(NSString *)path options:(SKNXattrFlags)options error:(NSError **)error;
 
+/*!
+    @abstract   Sets the value of attribute named <code>attr</code> to <code>value</code>, which is an <code>NSData</code> object, compressing fragments using the given codec.
+    @discussion Like <code>setExtendedAttributeNamed:toValue:atPath:options:error:</code>, except that when the data is split into fragments it is compressed using <code>codec</code> rather than the default codec.
+                When the codec is not available, bzip2 is used.
+    @param      attr The attribute name.
+    @param      value The value of the attribute as <code>NSData</code>.
+    @param      path Path to the object in the file system.
+    @param      options See </code>SKNXattrFlags<code> for valid options and their behavior.
+    @param      codec See </code>SKNXattrCodec<code> for valid codecs.
+    @param      error Error object describing the error if <code>NO</code> was returned.
+    @result     Returns <code>NO</code> if an error occurred.
+*/
+- (BOOL)setExtendedAttributeNamed:(NSString *)attr toValue:(NSData *)value atPath:(NSString *)path options:(SKNXattrFlags)options codec:(SKNXattrCodec)codec error:(NSError **)error;
+
 /*!
     @abstract   Sets the extended attribute named <code>attr</code> to the specified property list.
     @discussion The plist is converted to <code>NSData</code> using <code>NSPropertyListSerialization</code> and set using <code>setExtendedAttributeNamed:toValue:atPath:options:error:</code>.
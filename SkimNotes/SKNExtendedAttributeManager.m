@@ -36,6 +36,7 @@
  */
 
 #import "SKNExtendedAttributeManager.h"
+#import "SKNExtendedAttributeFragments.h"
 #include <sys/xattr.h>
 #import <bzlib.h>
 
@@ -48,6 +49,16 @@
 #define UNIQUE_KEY_SUFFIX       @"_unique_key"
 #define WRAPPER_KEY_SUFFIX      @"_has_wrapper"
 #define FRAGMENTS_KEY_SUFFIX    @"_number_of_fragments"
+#define CODEC_KEY_SUFFIX        @"_codec"
+#define CHUNKS_KEY_SUFFIX       @"_chunks"
+#define CHUNK_LIST_KEY_SUFFIX   @"_chunk_list"
+
+// a chunk is listed by its digest and its number of fragments as 2 big-endian bytes
+#define CHUNK_ENTRY_LENGTH      (SKN_CHUNK_DIGEST_LENGTH + 2)
+// a longer list of chunks does not fit in the wrapper, and is saved in a chunk of its own
+#define MAX_INLINE_CHUNKS       88
+#define MAX_NUMBER_OF_CHUNKS    4096
+#define MIN_AVERAGE_CHUNK_LENGTH (16 * 1024)
 
 #define SYNCABLE_FLAG @"#S"
 
@@ -57,14 +68,29 @@
 
 NSString *SKNSkimNotesErrorDomain = @"SKNSkimNotesErrorDomain";
 
+// names of the codecs saved in the wrapper, indexed by SKNXattrCodec; no name means bzip2
+static NSString *codecNames[] = {@"bzip2", @"zlib", @"lz4", @"lzfse"};
+
 @interface SKNExtendedAttributeManager (SKNPrivate)
 // private methods to get a unique attractor name for fragments
 - (NSString *)uniqueName;
+// private methods to name and write chunks of fragments
+- (NSString *)chunkNameForDigest:(const unsigned char *)digest;
+- (NSArray *)chunkNamesFromData:(NSData *)data numbersOfFragments:(NSArray **)numbers;
+- (NSData *)chunksFromWrapper:(NSDictionary *)wrapper atPath:(NSString *)path suffix:(NSString *)suffix traverseLink:(BOOL)follow;
+- (int)writeChunkNamed:(NSString *)chunkName bytes:(const char *)bytes length:(size_t)length suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts codec:(SKNXattrCodec)codec numberOfFragments:(NSUInteger *)numberOfFragments;
+- (BOOL)setFragmentsOfValue:(NSData *)value forAttributeNamed:(NSString *)attr atPath:(NSString *)path options:(int)xopts codec:(SKNXattrCodec)codec error:(NSError **)error;
+- (BOOL)setChunksOfValue:(NSData *)value forAttributeNamed:(NSString *)attr atPath:(NSString *)path options:(int)xopts codec:(SKNXattrCodec)codec error:(NSError **)error;
+- (NSDictionary *)chunksOfAttributeNamed:(NSString *)attr atPath:(NSString *)path suffix:(NSString *)suffix traverseLink:(BOOL)follow uniqueValue:(NSString **)uniqueValue numberOfFragments:(NSUInteger *)numberOfFragments;
+- (void)removeChunks:(NSDictionary *)oldChunks notIn:(NSDictionary *)newChunks uniqueValue:(NSString *)uniqueValue numberOfFragments:(NSUInteger)numberOfFragments suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts;
+- (void)removeFragmentsNamed:(NSString *)uniqueName count:(NSUInteger)numberOfFragments suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts;
 // private methods to (un)compress data
 - (NSData *)bzipData:(NSData *)data;
 - (NSData *)bunzipData:(NSData *)data;
 - (BOOL)isBzipData:(NSData *)data;
 - (BOOL)isPlistData:(NSData *)data;
+// private method to find the codec used for fragments, or -1 when it is not supported
+- (NSInteger)codecFromWrapper:(NSDictionary *)wrapper;
 // private method to print error messages
 - (NSError *)xattrError:(NSInteger)err forPath:(NSString *)path;
 @end
@@ -110,6 +136,9 @@ static id sharedNoSplitManager = nil;
         uniqueKey = [[prefix stringByAppendingString:UNIQUE_KEY_SUFFIX] retain];
         wrapperKey = [[prefix stringByAppendingString:WRAPPER_KEY_SUFFIX] retain];
         fragmentsKey = [[prefix stringByAppendingString:FRAGMENTS_KEY_SUFFIX] retain];
+        codecKey = [[prefix stringByAppendingString:CODEC_KEY_SUFFIX] retain];
+        chunksKey = [[prefix stringByAppendingString:CHUNKS_KEY_SUFFIX] retain];
+        chunkListKey = [[prefix stringByAppendingString:CHUNK_LIST_KEY_SUFFIX] retain];
     }
     return self;
 }
@@ -119,6 +148,9 @@ static id sharedNoSplitManager = nil;
     [uniqueKey release];
     [wrapperKey release];
     [fragmentsKey release];
+    [codecKey release];
+    [chunksKey release];
+    [chunkListKey release];
     [super dealloc];
 }
 
@@ -215,33 +247,15 @@ static id sharedNoSplitManager = nil;
     const char *fsPath = [path fileSystemRepresentation];
     const char *attrName = [attr UTF8String];
     
-    int xopts;
-    
-    if(follow)
-        xopts = 0;
-    else
-        xopts = XATTR_NOFOLLOW;
-    
-    size_t bufSize;
-    ssize_t status;
-    status = getxattr(fsPath, attrName, NULL, 0, 0, xopts);
+    // most attributes are short or wrappers, so this usually needs a single getxattr call
+    size_t bufSize = 0;
+    char *namebuf = SKNCopyExtendedAttribute(fsPath, attrName, follow, MAX_XATTR_LENGTH, &bufSize);
     
-    if(status == -1){
+    if(namebuf == NULL){
         if(error) *error = [self xattrError:errno forPath:path];
         return nil;
     }
     
-    bufSize = status;
-    char *namebuf = (char *)NSZoneMalloc(NSDefaultMallocZone(), sizeof(char) * bufSize);
-    NSAssert(namebuf != NULL, @"unable to allocate memory");
-    status = getxattr(fsPath, attrName, namebuf, bufSize, 0, xopts);
-    
-    if(status == -1){
-        if(error) *error = [self xattrError:errno forPath:path];
-        NSZoneFree(NSDefaultMallocZone(), namebuf);
-        return nil;
-    }
-    
     // let NSData worry about freeing the buffer
     return [[NSData alloc] initWithBytesNoCopy:namebuf length:bufSize];
 }
@@ -267,42 +281,65 @@ static id sharedNoSplitManager = nil;
         if (plist && [plist respondsToSelector:@selector(objectForKey:)] && [[plist objectForKey:wrapperKey] boolValue]) {
             
             NSString *uniqueValue = [plist objectForKey:uniqueKey];
-            NSUInteger i, numberOfFragments = [[plist objectForKey:fragmentsKey] unsignedIntegerValue];
+            NSUInteger numberOfFragments = [[plist objectForKey:fragmentsKey] unsignedIntegerValue];
+            BOOL isChunked = [plist objectForKey:chunksKey] != nil || [plist objectForKey:chunkListKey] != nil;
+            NSData *chunks = nil;
+            NSInteger codec = [self codecFromWrapper:plist];
 
-            NSMutableData *buffer = [NSMutableData data];
-            BOOL success = (nil != uniqueValue && numberOfFragments > 0);
-            
-            if (success == NO)
-                NSLog(@"failed to read unique key %@ for %lu fragments from property list.", uniqueKey, (long)numberOfFragments);
-            
             NSUInteger j = [attr rangeOfString:@"#"].location;
             NSString *suffix = j == NSNotFound || j == [attr length] - 1 ? @"" : [attr substringFromIndex:j];
             
-            // reassemble the original data object
-            for (i = 0; success && i < numberOfFragments; i++) {
-                NSError *tmpError = nil;
-                NSString *name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
-                NSData *subdata = [self copyRawExtendedAttributeNamed:name atPath:path traverseLink:follow error:&tmpError];
-                if (nil == subdata && i == 0 && [suffix length] > 0 && [tmpError code] == ENOATTR) {
-                    NSString *oldName = [[NSString alloc] initWithFormat:@"%@%@%lu", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i];
-                    subdata = [self copyRawExtendedAttributeNamed:oldName atPath:path traverseLink:follow error:&tmpError];
-                    if (subdata)
-                        suffix = @"";
-                    [oldName release];
+            BOOL success;
+            
+            if (codec == -1) {
+                success = YES;
+                NSLog(@"unsupported codec %@ for attribute named %@.", [plist objectForKey:codecKey], attr);
+            } else if (isChunked) {
+                chunks = [self chunksFromWrapper:plist atPath:path suffix:suffix traverseLink:follow];
+                success = (nil != chunks);
+                if (success == NO)
+                    NSLog(@"failed to read chunks for attribute named %@.", attr);
+            } else {
+                success = (nil != uniqueValue && numberOfFragments > 0);
+                if (success == NO)
+                    NSLog(@"failed to read unique key %@ for %lu fragments from property list.", uniqueKey, (long)numberOfFragments);
+            }
+            
+            [attribute release];
+            attribute = nil;
+            
+            // reassemble and decompress the original data object
+            if (success && codec != -1) {
+                void *bytes = NULL;
+                size_t length = 0;
+                SKNFragmentsStatus status;
+                if (chunks) {
+                    NSArray *numbers = nil;
+                    NSArray *names = [self chunkNamesFromData:chunks numbersOfFragments:&numbers];
+                    NSUInteger i, count = [names count];
+                    const char **uniqueNames = (const char **)NSZoneMalloc(NSDefaultMallocZone(), sizeof(const char *) * (count + 1));
+                    size_t *numbersOfFragments = (size_t *)NSZoneMalloc(NSDefaultMallocZone(), sizeof(size_t) * (count + 1));
+                    for (i = 0; i < count; i++) {
+                        uniqueNames[i] = [[names objectAtIndex:i] UTF8String];
+                        numbersOfFragments[i] = [[numbers objectAtIndex:i] unsignedIntegerValue];
+                    }
+                    status = SKNCopyReassembledChunks([path fileSystemRepresentation], uniqueNames, numbersOfFragments, count, [suffix UTF8String], MAX_XATTR_LENGTH, (SKNCodec)codec, follow, &bytes, &length);
+                    NSZoneFree(NSDefaultMallocZone(), uniqueNames);
+                    NSZoneFree(NSDefaultMallocZone(), numbersOfFragments);
+                } else {
+                    status = SKNCopyReassembledFragments([path fileSystemRepresentation], [uniqueValue UTF8String], [suffix UTF8String], numberOfFragments, MAX_XATTR_LENGTH, (SKNCodec)codec, follow, &bytes, &length);
                 }
-                if (nil == subdata) {
-                    NSLog(@"failed to find subattribute %@ of %lu for attribute named %@. %@", name, (long)numberOfFragments, attr, [tmpError localizedDescription]);
+                if (status == SKNFragmentsOK) {
+                    attribute = [[NSData alloc] initWithBytesNoCopy:bytes length:length];
+                } else if (status == SKNFragmentsMissing) {
+                    if (chunks)
+                        NSLog(@"failed to find subattributes of %lu chunks for attribute named %@. %@", (long)([chunks length] / CHUNK_ENTRY_LENGTH), attr, [[self xattrError:errno forPath:path] localizedDescription]);
+                    else
+                        NSLog(@"failed to find subattributes %@ of %lu for attribute named %@. %@", uniqueValue, (long)numberOfFragments, attr, [[self xattrError:errno forPath:path] localizedDescription]);
                     success = NO;
-                } else {
-                    [buffer appendData:subdata];
-                    [subdata release];
                 }
-                [name release];
             }
             
-            [attribute release];
-            attribute = success ? [[self bunzipData:buffer] retain] : nil;
-            
             if (success == NO && NULL != error)
                 *error = [NSError errorWithDomain:SKNSkimNotesErrorDomain code:SKNReassembleAttributeFailedError userInfo:[NSDictionary dictionaryWithObjectsAndKeys:path, NSFilePathErrorKey, SKNLocalizedString(@"Failed to reassemble attribute value.", @"Error description"), NSLocalizedDescriptionKey, nil]];
             else if (attribute == nil && NULL != error)
@@ -342,6 +379,11 @@ static id sharedNoSplitManager = nil;
 }
 
 - (BOOL)setExtendedAttributeNamed:(NSString *)attr toValue:(NSData *)value atPath:(NSString *)path options:(SKNXattrFlags)options error:(NSError **)error;
+{
+    return [self setExtendedAttributeNamed:attr toValue:value atPath:path options:options codec:kSKNXattrCodecDefault error:error];
+}
+
+- (BOOL)setExtendedAttributeNamed:(NSString *)attr toValue:(NSData *)value atPath:(NSString *)path options:(SKNXattrFlags)options codec:(SKNXattrCodec)codec error:(NSError **)error;
 {
     
     if((options & kSKNXattrSyncable) && NSFoundationVersionNumber >= NSFoundationVersionNumber10_10 && [attr rangeOfString:@"#"].location == NSNotFound){
@@ -365,48 +407,32 @@ static id sharedNoSplitManager = nil;
     if ((options & kSKNXattrNoSplitData) == 0 && namePrefix && [value length] > MAX_XATTR_LENGTH) {
                     
         // compress to save space, and so we don't identify this as a plist when reading it (in case it really is plist data)
-        value = [self bzipData:value];
+        if (codec == kSKNXattrCodecDefault)
+            codec = SKNDefaultCodec();
+        else if (codec < kSKNXattrCodecBzip2 || codec > kSKNXattrCodecLZFSE || SKNCodecIsAvailable((SKNCodec)codec) == 0)
+            codec = kSKNXattrCodecBzip2;
         
-        // this will be a unique identifier for the set of keys we're about to write (appending a counter to the UUID)
-        NSString *uniqueValue = [self uniqueName];
-        NSUInteger numberOfFragments = ([value length] / MAX_XATTR_LENGTH) + ([value length] % MAX_XATTR_LENGTH ? 1 : 0);
-        NSDictionary *wrapper = [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithBool:YES], wrapperKey, uniqueValue, uniqueKey, [NSNumber numberWithUnsignedInteger:numberOfFragments], fragmentsKey, nil];
-        NSData *wrapperData = [NSPropertyListSerialization dataWithPropertyList:wrapper format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
-        NSParameterAssert([wrapperData length] < MAX_XATTR_LENGTH && [wrapperData length] > 0);
-        
-        // we don't want to split this dictionary (or compress it)
-        if (setxattr(fsPath, attrName, [wrapperData bytes], [wrapperData length], 0, xopts))
-            success = NO;
+        if (options & kSKNXattrChunkData)
+            success = [self setChunksOfValue:value forAttributeNamed:attr atPath:path options:xopts codec:codec error:error];
         else
-            success = YES;
-        
-        // now split the original data value into multiple segments
-        NSString *name;
-        NSUInteger i;
-        const char *valuePtr = [value bytes];
+            success = [self setFragmentsOfValue:value forAttributeNamed:attr atPath:path options:xopts codec:codec error:error];
         
+    } else {
+        // a split value we replace leaves its fragments behind, so find them first
+        NSDictionary *oldChunks = nil;
+        NSString *oldUniqueValue = nil;
+        NSUInteger oldNumberOfFragments = 0;
         NSUInteger j = [attr rangeOfString:@"#"].location;
         NSString *suffix = j == NSNotFound || j == [attr length] - 1 ? @"" : [attr substringFromIndex:j];
+        if (namePrefix)
+            oldChunks = [self chunksOfAttributeNamed:attr atPath:path suffix:suffix traverseLink:(xopts & XATTR_NOFOLLOW) == 0 uniqueValue:&oldUniqueValue numberOfFragments:&oldNumberOfFragments];
         
-        for (i = 0; success && i < numberOfFragments; i++) {
-            name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
-            
-            char *subdataPtr = (char *)&valuePtr[i * MAX_XATTR_LENGTH];
-            size_t subdataLen = i == numberOfFragments - 1 ? ([value length] - i * MAX_XATTR_LENGTH) : MAX_XATTR_LENGTH;
-            
-            // could recurse here, but it's more efficient to use the variables we already have
-            if (setxattr(fsPath, [name UTF8String], subdataPtr, subdataLen, 0, xopts)) {
-                NSLog(@"full data length of note named %@ was %lu, subdata length was %lu (failed on pass %lu)", name, (long)[value length], (long)subdataLen, (long)i);
-            }
-            [name release];
-        }
-        
-    } else {
         int status = setxattr(fsPath, attrName, [value bytes], [value length], 0, xopts);
         if(status == -1){
             if(error) *error = [self xattrError:errno forPath:path];
             success = NO;
         } else {
+            [self removeChunks:oldChunks notIn:nil uniqueValue:oldUniqueValue numberOfFragments:oldNumberOfFragments suffix:suffix atPath:fsPath options:xopts & XATTR_NOFOLLOW];
             success = YES;
         }
     }
@@ -481,29 +507,36 @@ static id sharedNoSplitManager = nil;
             if (plist && [plist respondsToSelector:@selector(objectForKey:)] && [[plist objectForKey:wrapperKey] boolValue]) {
                 
                 NSString *uniqueValue = [plist objectForKey:uniqueKey];
-                NSUInteger i, numberOfFragments = [[plist objectForKey:fragmentsKey] unsignedIntegerValue];
-                NSString *name;
+                NSUInteger numberOfFragments = [[plist objectForKey:fragmentsKey] unsignedIntegerValue];
+                NSData *chunkList = [plist objectForKey:chunkListKey];
                 
                 NSUInteger j = [attr rangeOfString:@"#"].location;
                 NSString *suffix = j == NSNotFound || j == [attr length] - 1 ? @"" : [attr substringFromIndex:j];
                 
+                NSData *chunks = [self chunksFromWrapper:plist atPath:path suffix:suffix traverseLink:follow];
+                
                 // remove the sub attributes
-                for (i = 0; i < numberOfFragments; i++) {
-                    name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
-                    const char *subAttrName = [name UTF8String];
-                    status = removexattr(fsPath, subAttrName, xopts);
-                    if (status == -1 && i == 0 && errno == ENOATTR && [suffix length] > 0) {
-                        NSString *oldName = [[NSString alloc] initWithFormat:@"%@%@%lu", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i];
-                        subAttrName = [oldName UTF8String];
-                        status = removexattr(fsPath, subAttrName, xopts);
-                        if (status != -1)
-                            suffix = @"";
-                        [oldName release];
+                if (chunks) {
+                    NSArray *numbers = nil;
+                    NSArray *names = [self chunkNamesFromData:chunks numbersOfFragments:&numbers];
+                    NSUInteger i, count = [names count];
+                    NSMutableSet *removed = [NSMutableSet set];
+                    if ([chunkList isKindOfClass:[NSData class]] && [chunkList length] == CHUNK_ENTRY_LENGTH) {
+                        // also remove the chunk with the list of chunks
+                        NSArray *listNumbers = nil;
+                        names = [names arrayByAddingObjectsFromArray:[self chunkNamesFromData:chunkList numbersOfFragments:&listNumbers]];
+                        numbers = [numbers arrayByAddingObjectsFromArray:listNumbers];
+                        count++;
                     }
-                    if (status == -1) {
-                        NSLog(@"failed to remove subattribute %@ of attribute named %@", name, attr);
+                    for (i = 0; i < count; i++) {
+                        NSString *name = [names objectAtIndex:i];
+                        if ([removed containsObject:name] == NO) {
+                            [removed addObject:name];
+                            [self removeFragmentsNamed:name count:[[numbers objectAtIndex:i] unsignedIntegerValue] suffix:suffix atPath:fsPath options:xopts];
+                        }
                     }
-                    [name release];
+                } else if (uniqueValue) {
+                    [self removeFragmentsNamed:uniqueValue count:numberOfFragments suffix:suffix atPath:fsPath options:xopts];
                 }
             }
             
@@ -565,6 +598,312 @@ static id sharedNoSplitManager = nil;
     return uniqueName;
 }
 
+- (NSString *)chunkNameForDigest:(const unsigned char *)digest;
+{
+    NSMutableString *name = [NSMutableString stringWithString:namePrefix];
+    NSUInteger i;
+    for (i = 0; i < SKN_CHUNK_DIGEST_LENGTH; i++)
+        [name appendFormat:@"%02x", digest[i]];
+    return name;
+}
+
+- (NSArray *)chunkNamesFromData:(NSData *)data numbersOfFragments:(NSArray **)numbers;
+{
+    const unsigned char *entry = [data bytes];
+    NSUInteger i, count = [data length] / CHUNK_ENTRY_LENGTH;
+    NSMutableArray *names = [NSMutableArray arrayWithCapacity:count];
+    NSMutableArray *counts = [NSMutableArray arrayWithCapacity:count];
+    for (i = 0; i < count; i++, entry += CHUNK_ENTRY_LENGTH) {
+        [names addObject:[self chunkNameForDigest:entry]];
+        [counts addObject:[NSNumber numberWithUnsignedInteger:((NSUInteger)entry[SKN_CHUNK_DIGEST_LENGTH] << 8) | entry[SKN_CHUNK_DIGEST_LENGTH + 1]]];
+    }
+    if (numbers)
+        *numbers = counts;
+    return names;
+}
+
+- (NSData *)chunksFromWrapper:(NSDictionary *)wrapper atPath:(NSString *)path suffix:(NSString *)suffix traverseLink:(BOOL)follow;
+{
+    NSData *chunks = [wrapper objectForKey:chunksKey];
+    NSData *chunkList = [wrapper objectForKey:chunkListKey];
+    NSInteger codec = [self codecFromWrapper:wrapper];
+    
+    if (chunkList) {
+        chunks = nil;
+        if ([chunkList isKindOfClass:[NSData class]] && [chunkList length] == CHUNK_ENTRY_LENGTH && codec != -1) {
+            NSArray *numbers = nil;
+            const char *uniqueName = [[[self chunkNamesFromData:chunkList numbersOfFragments:&numbers] lastObject] UTF8String];
+            size_t numberOfFragments = [[numbers lastObject] unsignedIntegerValue];
+            void *bytes = NULL;
+            size_t length = 0;
+            if (SKNCopyReassembledChunks([path fileSystemRepresentation], &uniqueName, &numberOfFragments, 1, [suffix UTF8String], MAX_XATTR_LENGTH, (SKNCodec)codec, follow, &bytes, &length) == SKNFragmentsOK)
+                chunks = [[[NSData alloc] initWithBytesNoCopy:bytes length:length] autorelease];
+        }
+    }
+    
+    if ([chunks isKindOfClass:[NSData class]] && [chunks length] % CHUNK_ENTRY_LENGTH == 0)
+        return chunks;
+    return nil;
+}
+
+- (int)writeChunkNamed:(NSString *)chunkName bytes:(const char *)bytes length:(size_t)length suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts codec:(SKNXattrCodec)codec numberOfFragments:(NSUInteger *)numberOfFragments;
+{
+    size_t compressedLength = 0;
+    char *compressed = SKNCopyCompressedBytes((SKNCodec)codec, bytes, length, &compressedLength);
+    NSUInteger i, count = (compressedLength / MAX_XATTR_LENGTH) + (compressedLength % MAX_XATTR_LENGTH ? 1 : 0);
+    int err = 0;
+    
+    *numberOfFragments = 0;
+    if (compressed == NULL)
+        return errno;
+    if (count > 0xFFFF) {
+        free(compressed);
+        return EFBIG;
+    }
+    
+    *numberOfFragments = count;
+    for (i = 0; err == 0 && i < count; i++) {
+        NSString *name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", chunkName, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
+        size_t subdataLen = i == count - 1 ? (compressedLength - i * MAX_XATTR_LENGTH) : MAX_XATTR_LENGTH;
+        if (setxattr(fsPath, [name UTF8String], compressed + i * MAX_XATTR_LENGTH, subdataLen, 0, xopts)) {
+            err = errno;
+            NSLog(@"full data length of note named %@ was %lu, subdata length was %lu (failed on pass %lu)", name, (long)compressedLength, (long)subdataLen, (long)i);
+        }
+        [name release];
+    }
+    free(compressed);
+    return err;
+}
+
+- (BOOL)setFragmentsOfValue:(NSData *)value forAttributeNamed:(NSString *)attr atPath:(NSString *)path options:(int)xopts codec:(SKNXattrCodec)codec error:(NSError **)error;
+{
+    const char *fsPath = [path fileSystemRepresentation];
+    
+    NSUInteger j = [attr rangeOfString:@"#"].location;
+    NSString *suffix = j == NSNotFound || j == [attr length] - 1 ? @"" : [attr substringFromIndex:j];
+    
+    // find the fragments of the current value, they are removed when the new value is written
+    NSString *oldUniqueValue = nil;
+    NSUInteger oldNumberOfFragments = 0;
+    NSDictionary *oldChunks = [self chunksOfAttributeNamed:attr atPath:path suffix:suffix traverseLink:(xopts & XATTR_NOFOLLOW) == 0 uniqueValue:&oldUniqueValue numberOfFragments:&oldNumberOfFragments];
+    
+    size_t length = 0;
+    void *bytes = SKNCopyCompressedBytes((SKNCodec)codec, [value bytes], [value length], &length);
+    if (bytes == NULL && codec != kSKNXattrCodecBzip2) {
+        codec = kSKNXattrCodecBzip2;
+        bytes = SKNCopyCompressedBytes((SKNCodec)codec, [value bytes], [value length], &length);
+    }
+    if (bytes == NULL) {
+        if(error) *error = [self xattrError:errno forPath:path];
+        return NO;
+    }
+    value = [NSData dataWithBytesNoCopy:bytes length:length];
+    
+    // this will be a unique identifier for the set of keys we're about to write (appending a counter to the UUID)
+    NSString *uniqueValue = [self uniqueName];
+    NSUInteger numberOfFragments = ([value length] / MAX_XATTR_LENGTH) + ([value length] % MAX_XATTR_LENGTH ? 1 : 0);
+    NSMutableDictionary *wrapper = [NSMutableDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithBool:YES], wrapperKey, uniqueValue, uniqueKey, [NSNumber numberWithUnsignedInteger:numberOfFragments], fragmentsKey, nil];
+    // leave out bzip2, so older versions can still read it
+    if (codec != kSKNXattrCodecBzip2)
+        [wrapper setObject:codecNames[codec] forKey:codecKey];
+    NSData *wrapperData = [NSPropertyListSerialization dataWithPropertyList:wrapper format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
+    NSParameterAssert([wrapperData length] < MAX_XATTR_LENGTH && [wrapperData length] > 0);
+    
+    // we don't want to split this dictionary (or compress it)
+    if (setxattr(fsPath, [attr UTF8String], [wrapperData bytes], [wrapperData length], 0, xopts)) {
+        if(error) *error = [self xattrError:errno forPath:path];
+        return NO;
+    }
+    
+    // now split the original data value into multiple segments
+    NSString *name;
+    NSUInteger i;
+    const char *valuePtr = [value bytes];
+    
+    for (i = 0; i < numberOfFragments; i++) {
+        name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", uniqueValue, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
+        
+        char *subdataPtr = (char *)&valuePtr[i * MAX_XATTR_LENGTH];
+        size_t subdataLen = i == numberOfFragments - 1 ? ([value length] - i * MAX_XATTR_LENGTH) : MAX_XATTR_LENGTH;
+        
+        // could recurse here, but it's more efficient to use the variables we already have
+        if (setxattr(fsPath, [name UTF8String], subdataPtr, subdataLen, 0, xopts & XATTR_NOFOLLOW)) {
+            NSLog(@"full data length of note named %@ was %lu, subdata length was %lu (failed on pass %lu)", name, (long)[value length], (long)subdataLen, (long)i);
+        }
+        [name release];
+    }
+    
+    // the fragments of the old value are no longer used
+    [self removeChunks:oldChunks notIn:nil uniqueValue:oldUniqueValue numberOfFragments:oldNumberOfFragments suffix:suffix atPath:fsPath options:xopts & XATTR_NOFOLLOW];
+    
+    return YES;
+}
+
+- (BOOL)setChunksOfValue:(NSData *)value forAttributeNamed:(NSString *)attr atPath:(NSString *)path options:(int)xopts codec:(SKNXattrCodec)codec error:(NSError **)error;
+{
+    const char *fsPath = [path fileSystemRepresentation];
+    // the fragments are new or unchanged, so creating or replacing only applies to the wrapper
+    int fragmentOptions = xopts & XATTR_NOFOLLOW;
+    BOOL follow = (xopts & XATTR_NOFOLLOW) == 0;
+    
+    NSUInteger j = [attr rangeOfString:@"#"].location;
+    NSString *suffix = j == NSNotFound || j == [attr length] - 1 ? @"" : [attr substringFromIndex:j];
+    NSString *baseName = j == NSNotFound ? attr : [attr substringToIndex:j];
+    
+    // find the fragments of the current value, the chunks that did not change are reused
+    NSString *oldUniqueValue = nil;
+    NSUInteger oldNumberOfFragments = 0;
+    NSDictionary *oldChunks = [self chunksOfAttributeNamed:attr atPath:path suffix:suffix traverseLink:follow uniqueValue:&oldUniqueValue numberOfFragments:&oldNumberOfFragments];
+    
+    // cut the data where the content says so, using larger chunks for very large data
+    const char *valuePtr = [value bytes];
+    uint64_t seed = SKNChunkSeed([baseName UTF8String], (SKNCodec)codec);
+    size_t averageLength = MIN_AVERAGE_CHUNK_LENGTH, count = 0;
+    SKNChunk *chunks = NULL;
+    while (averageLength < [value length] / (MAX_NUMBER_OF_CHUNKS / 2))
+        averageLength *= 2;
+    do {
+        free(chunks);
+        chunks = SKNCopyContentDefinedChunks(valuePtr, [value length], averageLength, seed, &count);
+        averageLength *= 2;
+    } while (chunks != NULL && count > MAX_NUMBER_OF_CHUNKS);
+    if (chunks == NULL) {
+        if(error) *error = [self xattrError:errno forPath:path];
+        return NO;
+    }
+    
+    NSMutableData *chunksData = [NSMutableData dataWithLength:count * CHUNK_ENTRY_LENGTH];
+    unsigned char *entry = [chunksData mutableBytes];
+    NSMutableDictionary *newChunks = [NSMutableDictionary dictionary];
+    NSMutableArray *writtenChunks = [NSMutableArray array];
+    NSUInteger i, numberOfFragments;
+    int err = 0;
+    
+    // write only the chunks we don't have yet
+    for (i = 0; err == 0 && i < count; i++, entry += CHUNK_ENTRY_LENGTH) {
+        NSString *chunkName = [self chunkNameForDigest:chunks[i].digest];
+        NSNumber *number = [newChunks objectForKey:chunkName] ?: [oldChunks objectForKey:chunkName];
+        if (number == nil) {
+            err = [self writeChunkNamed:chunkName bytes:valuePtr + chunks[i].offset length:chunks[i].length suffix:suffix atPath:fsPath options:fragmentOptions codec:codec numberOfFragments:&numberOfFragments];
+            number = [NSNumber numberWithUnsignedInteger:numberOfFragments];
+            [writtenChunks addObject:chunkName];
+        }
+        [newChunks setObject:number forKey:chunkName];
+        memcpy(entry, chunks[i].digest, SKN_CHUNK_DIGEST_LENGTH);
+        entry[SKN_CHUNK_DIGEST_LENGTH] = (unsigned char)([number unsignedIntegerValue] >> 8);
+        entry[SKN_CHUNK_DIGEST_LENGTH + 1] = (unsigned char)([number unsignedIntegerValue] & 0xFF);
+    }
+    free(chunks);
+    
+    NSMutableDictionary *wrapper = [NSMutableDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithBool:YES], wrapperKey, nil];
+    if (codec != kSKNXattrCodecBzip2)
+        [wrapper setObject:codecNames[codec] forKey:codecKey];
+    
+    if (err == 0 && count > MAX_INLINE_CHUNKS) {
+        // the list of chunks is too long for the wrapper, so it is saved as a chunk itself
+        NSMutableData *chunkList = [NSMutableData dataWithLength:CHUNK_ENTRY_LENGTH];
+        entry = [chunkList mutableBytes];
+        SKNChunkDigest([chunksData bytes], [chunksData length], seed, entry);
+        NSString *chunkName = [self chunkNameForDigest:entry];
+        NSNumber *number = [oldChunks objectForKey:chunkName];
+        if (number == nil) {
+            err = [self writeChunkNamed:chunkName bytes:[chunksData bytes] length:[chunksData length] suffix:suffix atPath:fsPath options:fragmentOptions codec:codec numberOfFragments:&numberOfFragments];
+            number = [NSNumber numberWithUnsignedInteger:numberOfFragments];
+            [writtenChunks addObject:chunkName];
+        }
+        [newChunks setObject:number forKey:chunkName];
+        entry[SKN_CHUNK_DIGEST_LENGTH] = (unsigned char)([number unsignedIntegerValue] >> 8);
+        entry[SKN_CHUNK_DIGEST_LENGTH + 1] = (unsigned char)([number unsignedIntegerValue] & 0xFF);
+        [wrapper setObject:chunkList forKey:chunkListKey];
+    } else {
+        [wrapper setObject:chunksData forKey:chunksKey];
+    }
+    
+    // only point to the new chunks when they are all there
+    if (err == 0) {
+        NSData *wrapperData = [NSPropertyListSerialization dataWithPropertyList:wrapper format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
+        NSParameterAssert([wrapperData length] < MAX_XATTR_LENGTH && [wrapperData length] > 0);
+        
+        // we don't want to split this dictionary (or compress it)
+        if (setxattr(fsPath, [attr UTF8String], [wrapperData bytes], [wrapperData length], 0, xopts))
+            err = errno;
+    }
+    
+    if (err != 0) {
+        for (NSString *chunkName in writtenChunks)
+            [self removeFragmentsNamed:chunkName count:[[newChunks objectForKey:chunkName] unsignedIntegerValue] suffix:suffix atPath:fsPath options:fragmentOptions];
+        if(error) *error = [self xattrError:err forPath:path];
+        return NO;
+    }
+    
+    // remove the fragments the new value does not share with the old one
+    [self removeChunks:oldChunks notIn:newChunks uniqueValue:oldUniqueValue numberOfFragments:oldNumberOfFragments suffix:suffix atPath:fsPath options:fragmentOptions];
+    
+    return YES;
+}
+
+- (NSDictionary *)chunksOfAttributeNamed:(NSString *)attr atPath:(NSString *)path suffix:(NSString *)suffix traverseLink:(BOOL)follow uniqueValue:(NSString **)uniqueValue numberOfFragments:(NSUInteger *)numberOfFragments;
+{
+    // the chunks of a wrapper, including the one with the list of chunks, mapped to their numbers of fragments
+    NSMutableDictionary *oldChunks = [NSMutableDictionary dictionary];
+    NSData *oldAttribute = [self copyRawExtendedAttributeNamed:attr atPath:path traverseLink:follow error:NULL];
+    *uniqueValue = nil;
+    *numberOfFragments = 0;
+    if ([self isPlistData:oldAttribute]) {
+        id plist = [NSPropertyListSerialization propertyListWithData:oldAttribute options:NSPropertyListImmutable format:NULL error:NULL];
+        if (plist && [plist respondsToSelector:@selector(objectForKey:)] && [[plist objectForKey:wrapperKey] boolValue]) {
+            NSData *chunks = [self chunksFromWrapper:plist atPath:path suffix:suffix traverseLink:follow];
+            NSData *chunkList = [plist objectForKey:chunkListKey];
+            if (chunks) {
+                NSArray *numbers = nil;
+                NSArray *names = [self chunkNamesFromData:chunks numbersOfFragments:&numbers];
+                [oldChunks addEntriesFromDictionary:[NSDictionary dictionaryWithObjects:numbers forKeys:names]];
+                if ([chunkList isKindOfClass:[NSData class]] && [chunkList length] == CHUNK_ENTRY_LENGTH) {
+                    names = [self chunkNamesFromData:chunkList numbersOfFragments:&numbers];
+                    [oldChunks addEntriesFromDictionary:[NSDictionary dictionaryWithObjects:numbers forKeys:names]];
+                }
+            } else if ([[plist objectForKey:uniqueKey] isKindOfClass:[NSString class]]) {
+                *uniqueValue = [plist objectForKey:uniqueKey];
+                *numberOfFragments = [[plist objectForKey:fragmentsKey] unsignedIntegerValue];
+            }
+        }
+    }
+    [oldAttribute release];
+    return oldChunks;
+}
+
+- (void)removeChunks:(NSDictionary *)oldChunks notIn:(NSDictionary *)newChunks uniqueValue:(NSString *)uniqueValue numberOfFragments:(NSUInteger)numberOfFragments suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts;
+{
+    for (NSString *chunkName in oldChunks) {
+        if ([newChunks objectForKey:chunkName] == nil)
+            [self removeFragmentsNamed:chunkName count:[[oldChunks objectForKey:chunkName] unsignedIntegerValue] suffix:suffix atPath:fsPath options:xopts];
+    }
+    if (uniqueValue)
+        [self removeFragmentsNamed:uniqueValue count:numberOfFragments suffix:suffix atPath:fsPath options:xopts];
+}
+
+- (void)removeFragmentsNamed:(NSString *)uniqueName count:(NSUInteger)numberOfFragments suffix:(NSString *)suffix atPath:(const char *)fsPath options:(int)xopts;
+{
+    NSUInteger i;
+    for (i = 0; i < numberOfFragments; i++) {
+        NSString *name = [[NSString alloc] initWithFormat:@"%@%@%lu%@", uniqueName, FRAGMENT_NAME_SEPARATOR, (long)i, suffix];
+        const char *subAttrName = [name UTF8String];
+        int status = removexattr(fsPath, subAttrName, xopts);
+        if (status == -1 && i == 0 && errno == ENOATTR && [suffix length] > 0) {
+            NSString *oldName = [[NSString alloc] initWithFormat:@"%@%@%lu", uniqueName, FRAGMENT_NAME_SEPARATOR, (long)i];
+            subAttrName = [oldName UTF8String];
+            status = removexattr(fsPath, subAttrName, xopts);
+            if (status != -1)
+                suffix = @"";
+            [oldName release];
+        }
+        if (status == -1) {
+            NSLog(@"failed to remove subattribute %@", name);
+        }
+        [name release];
+    }
+}
+
 // guaranteed to return non-nil
 - (NSError *)xattrError:(NSInteger)err forPath:(NSString *)path;
 {
@@ -711,6 +1050,21 @@ static id sharedNoSplitManager = nil;
     return [data length] >= bzipHeaderDataLength && [bzipHeaderData isEqual:[data subdataWithRange:NSMakeRange(0, bzipHeaderDataLength)]];
 }
 
+- (NSInteger)codecFromWrapper:(NSDictionary *)wrapper;
+{
+    id name = [wrapper objectForKey:codecKey];
+    if (name == nil)
+        return kSKNXattrCodecBzip2;
+    if ([name isKindOfClass:[NSString class]]) {
+        NSInteger codec;
+        for (codec = kSKNXattrCodecBzip2; codec <= kSKNXattrCodecLZFSE; codec++) {
+            if ([name isEqualToString:codecNames[codec]])
+                return SKNCodecIsAvailable((SKNCodec)codec) ? codec : -1;
+        }
+    }
+    return -1;
+}
+
 - (BOOL)isPlistData:(NSData *)data;
 {
     static NSData *plistHeaderData = nil;
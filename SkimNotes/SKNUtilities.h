@@ -52,6 +52,11 @@
 
 extern NSString *SKNSkimTextNotes(NSArray *noteDicts);
 extern NSData *SKNSkimRTFNotes(NSArray *noteDicts);
+extern BOOL SKNSkimTextAndRTFNotesFromData(NSData *data, NSString **textNotes, NSData **rtfNotes);
 
 extern NSArray *SKNSkimNotesFromData(NSData *data);
 extern NSData *SKNDataFromSkimNotes(NSArray *noteDicts, BOOL asPlist);
+
+extern NSData *SKNCompactDataFromSkimNotes(NSArray *noteDicts);
+extern NSArray *SKNSkimNotesFromDataInPageRange(NSData *data, NSRange pageRange);
+extern NSUInteger SKNNumberOfSkimNotesInData(NSData *data, NSRange pageRange);
@@ -37,6 +37,7 @@
  */
 
 #import "SKNUtilities.h"
+#import "SKNExtendedAttributeFragments.h"
 
 #if (defined(TARGET_OS_SIMULATOR) && TARGET_OS_SIMULATOR) || (defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE)
 
@@ -75,28 +76,31 @@
 
 #define NOTE_WIDGET_TYPE @"Widget"
 
-NSString *SKNSkimTextNotes(NSArray *noteDicts) {
-    NSMutableString *textString = [NSMutableString string];
-    NSEnumerator *dictEnum = [noteDicts objectEnumerator];
-    NSDictionary *dict;
+static BOOL SKNIsCompactData(NSData *data);
+static NSArray *SKNSkimNotesFromCompactData(NSData *data, NSRange pageRange, BOOL allPages, BOOL convert);
+
+static void SKNAppendSkimNote(NSDictionary *dict, NSMutableString *textString, NSMutableAttributedString *attrString) {
+    NSString *type = [dict objectForKey:NOTE_TYPE_KEY];
     
-    while (dict = [dictEnum nextObject]) {
-        NSString *type = [dict objectForKey:NOTE_TYPE_KEY];
-        
-        if ([type isEqualToString:NOTE_WIDGET_TYPE])
-            continue;
-        
-        NSUInteger pageIndex = [[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue];
-        NSString *string = [dict objectForKey:NOTE_CONTENTS_KEY];
-        NSAttributedString *text = [dict objectForKey:NOTE_TEXT_KEY];
-        
-        if (pageIndex == NSNotFound || pageIndex == INT_MAX)
-            pageIndex = 0;
-        
-        if ([text isKindOfClass:[NSData class]])
-            text = [[[NSAttributedString alloc] initWithData:(NSData *)text options:[NSDictionary dictionary] documentAttributes:NULL error:NULL] autorelease];
-        
-        [textString appendFormat:@"* %@, page %lu\n\n", type, (long)pageIndex + 1];
+    if ([type isEqualToString:NOTE_WIDGET_TYPE])
+        return;
+    
+    NSUInteger pageIndex = [[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue];
+    NSString *string = [dict objectForKey:NOTE_CONTENTS_KEY];
+    NSAttributedString *text = [dict objectForKey:NOTE_TEXT_KEY];
+    
+    if (pageIndex == NSNotFound || pageIndex == INT_MAX)
+        pageIndex = 0;
+    
+    if ([text isKindOfClass:[NSData class]])
+        text = [[[NSAttributedString alloc] initWithData:(NSData *)text options:[NSDictionary dictionary] documentAttributes:NULL error:NULL] autorelease];
+    else if ([text isKindOfClass:[NSAttributedString class]] == NO)
+        text = nil;
+    
+    NSString *header = [NSString stringWithFormat:@"* %@, page %lu\n\n", type, (long)pageIndex + 1];
+    
+    if (textString) {
+        [textString appendString:header];
         if ([string length]) {
             [textString appendString:string];
             [textString appendString:@" \n\n"];
@@ -106,31 +110,8 @@ NSString *SKNSkimTextNotes(NSArray *noteDicts) {
             [textString appendString:@" \n\n"];
         }
     }
-    return textString;
-}
-
-NSData *SKNSkimRTFNotes(NSArray *noteDicts) {
-    NSMutableAttributedString *attrString = [[[NSMutableAttributedString alloc] init] autorelease];
-    NSEnumerator *dictEnum = [noteDicts objectEnumerator];
-    NSDictionary *dict;
-    
-    while (dict = [dictEnum nextObject]) {
-        NSString *type = [dict objectForKey:NOTE_TYPE_KEY];
-        
-        if ([type isEqualToString:NOTE_WIDGET_TYPE])
-            continue;
-        
-        NSUInteger pageIndex = [[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue];
-        NSString *string = [dict objectForKey:NOTE_CONTENTS_KEY];
-        NSAttributedString *text = [dict objectForKey:NOTE_TEXT_KEY];
-        
-        if (pageIndex == NSNotFound || pageIndex == INT_MAX)
-            pageIndex = 0;
-        
-        if ([text isKindOfClass:[NSData class]])
-            text = [[[NSAttributedString alloc] initWithData:(NSData *)text options:[NSDictionary dictionary] documentAttributes:NULL error:NULL] autorelease];
-        
-        [attrString replaceCharactersInRange:NSMakeRange([attrString length], 0) withString:[NSString stringWithFormat:@"* %@, page %lu\n\n", type, (long)pageIndex + 1]];
+    if (attrString) {
+        [attrString replaceCharactersInRange:NSMakeRange([attrString length], 0) withString:header];
         if ([string length]) {
             [attrString replaceCharactersInRange:NSMakeRange([attrString length], 0) withString:string];
             [attrString replaceCharactersInRange:NSMakeRange([attrString length], 0) withString:@" \n\n"];
@@ -138,13 +119,153 @@ NSData *SKNSkimRTFNotes(NSArray *noteDicts) {
         if ([text length]) {
             [attrString appendAttributedString:text];
             [attrString replaceCharactersInRange:NSMakeRange([attrString length], 0) withString:@" \n\n"];
-            
         }
     }
+}
+
+static NSData *SKNRTFDataFromAttributedString(NSMutableAttributedString *attrString) {
     [attrString fixAttributesInRange:NSMakeRange(0, [attrString length])];
     return [attrString dataFromRange:NSMakeRange(0, [attrString length]) documentAttributes:[NSDictionary dictionaryWithObjectsAndKeys:NSRTFTextDocumentType, NSDocumentTypeDocumentAttribute, nil] error:NULL];
 }
 
+NSString *SKNSkimTextNotes(NSArray *noteDicts) {
+    NSMutableString *textString = [NSMutableString string];
+    
+    for (NSDictionary *dict in noteDicts)
+        SKNAppendSkimNote(dict, textString, nil);
+    return textString;
+}
+
+NSData *SKNSkimRTFNotes(NSArray *noteDicts) {
+    NSMutableAttributedString *attrString = [[[NSMutableAttributedString alloc] init] autorelease];
+    
+    for (NSDictionary *dict in noteDicts)
+        SKNAppendSkimNote(dict, nil, attrString);
+    return SKNRTFDataFromAttributedString(attrString);
+}
+
+#pragma mark -
+
+// Stands in for images in keyed archives, so we don't decode image data we never look at
+@interface SKNSkippedImage : NSObject <NSCoding>
+@end
+
+@implementation SKNSkippedImage
+- (id)initWithCoder:(NSCoder *)decoder { return [super init]; }
+- (void)encodeWithCoder:(NSCoder *)coder {}
+@end
+
+#define TEXT_RENDITION  't'
+#define RTF_RENDITION   'r'
+
+static NSCache *SKNRenditionCache(void) {
+    static NSCache *cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [[NSCache alloc] init];
+        [cache setCountLimit:16];
+    });
+    return cache;
+}
+
+// the digest only finds the entry, it is a hit only when the data it was rendered from is equal
+static NSArray *SKNCachedRendition(NSCache *cache, NSData *key, NSData *data) {
+    NSArray *cached = [cache objectForKey:key];
+    if (cached && [[cached objectAtIndex:0] isEqualToData:data])
+        return cached;
+    return nil;
+}
+
+static NSArray *SKNNoteRecordsFromData(NSData *data) {
+    NSArray *noteDicts = nil;
+    
+    if (SKNIsCompactData(data)) {
+        noteDicts = SKNSkimNotesFromCompactData(data, NSMakeRange(0, 0), YES, NO);
+    } else if ([data length] > 0) {
+        unsigned char ch = 0;
+        if ([data length] > 8)
+            [data getBytes:&ch range:NSMakeRange(8, 1)];
+        ch >>= 4;
+        if (ch == 0xD) {
+            NSKeyedUnarchiver *unarchiver = nil;
+            @try {
+                unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
+                [unarchiver setClass:[SKNSkippedImage class] forClassName:@"NSImage"];
+                noteDicts = [unarchiver decodeObjectForKey:NSKeyedArchiveRootObjectKey];
+            }
+            @catch (id e) {}
+            [unarchiver finishDecoding];
+            [unarchiver release];
+        } else {
+            // immutable containers, and colors, fonts and images are left as plist values
+            noteDicts = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+        }
+        if ([noteDicts isKindOfClass:[NSArray class]] == NO)
+            noteDicts = nil;
+    } else if (data) {
+        noteDicts = [NSArray array];
+    }
+    return noteDicts;
+}
+
+BOOL SKNSkimTextAndRTFNotesFromData(NSData *data, NSString **textNotes, NSData **rtfNotes) {
+    NSCache *cache = SKNRenditionCache();
+    unsigned char key[SKN_CHUNK_DIGEST_LENGTH + 1];
+    NSData *textKey = nil, *rtfKey = nil;
+    NSData *cachedData = data ? [[data copy] autorelease] : [NSData data];
+    NSArray *cached;
+    NSString *textString = nil;
+    NSData *rtfData = nil;
+    BOOL hasNotes = NO;
+    
+    SKNChunkDigest([data bytes], [data length], 0, key);
+    if (textNotes) {
+        key[SKN_CHUNK_DIGEST_LENGTH] = TEXT_RENDITION;
+        textKey = [NSData dataWithBytes:key length:sizeof(key)];
+        if ((cached = SKNCachedRendition(cache, textKey, cachedData))) {
+            textString = [cached objectAtIndex:1];
+            hasNotes = [[cached lastObject] boolValue];
+        }
+    }
+    if (rtfNotes) {
+        key[SKN_CHUNK_DIGEST_LENGTH] = RTF_RENDITION;
+        rtfKey = [NSData dataWithBytes:key length:sizeof(key)];
+        if ((cached = SKNCachedRendition(cache, rtfKey, cachedData))) {
+            rtfData = [cached objectAtIndex:1];
+            hasNotes = [[cached lastObject] boolValue];
+        }
+    }
+    
+    if ((textNotes && textString == nil) || (rtfNotes && rtfData == nil)) {
+        NSMutableString *generatedString = (textNotes && textString == nil) ? [NSMutableString string] : nil;
+        NSMutableAttributedString *generatedAttrString = (rtfNotes && rtfData == nil) ? [[[NSMutableAttributedString alloc] init] autorelease] : nil;
+        NSArray *noteDicts = SKNNoteRecordsFromData(data);
+        
+        hasNotes = [noteDicts count] > 0;
+        for (NSDictionary *dict in noteDicts) {
+            NSAutoreleasePool *pool = [NSAutoreleasePool new];
+            if ([dict isKindOfClass:[NSDictionary class]])
+                SKNAppendSkimNote(dict, generatedString, generatedAttrString);
+            [pool release];
+        }
+        
+        if (generatedString) {
+            textString = [[generatedString copy] autorelease];
+            [cache setObject:[NSArray arrayWithObjects:cachedData, textString, [NSNumber numberWithBool:hasNotes], nil] forKey:textKey];
+        }
+        if (generatedAttrString) {
+            rtfData = SKNRTFDataFromAttributedString(generatedAttrString) ?: [NSData data];
+            [cache setObject:[NSArray arrayWithObjects:cachedData, rtfData, [NSNumber numberWithBool:hasNotes], nil] forKey:rtfKey];
+        }
+    }
+    
+    if (textNotes)
+        *textNotes = textString;
+    if (rtfNotes)
+        *rtfNotes = rtfData;
+    return hasNotes;
+}
+
 #pragma mark -
 
 static inline BOOL SKNIsNumberArray(id array) {
@@ -213,7 +334,7 @@ static SKNColor *SKNColorFromArray(NSArray *array) {
         if ([array count] > 2) {
             CGFloat c[4] = {0.0, 0.0, 0.0, 1.0};
             NSUInteger i;
-            for (i = 0; i < MAX([array count], 4); i++)
+            for (i = 0; i < MIN([array count], 4); i++)
                 c[i] = [[array objectAtIndex:i] doubleValue];
 #if defined(SKIMNOTES_PLATFORM_IOS)
             return [UIColor colorWithRed:c[0] green:c[1] blue:c[2] alpha:c[3]];
@@ -245,10 +366,133 @@ static SKNColor *SKNColorFromArray(NSArray *array) {
     }
 }
 
+static void SKNConvertPropertyListToNote(NSMutableDictionary *dict) {
+    id value;
+    if ((value = [dict objectForKey:NOTE_COLOR_KEY])) {
+        if ((value = SKNColorFromArray(value)))
+            [dict setObject:value forKey:NOTE_COLOR_KEY];
+        else
+            [dict removeObjectForKey:NOTE_COLOR_KEY];
+    }
+    if ((value = [dict objectForKey:NOTE_INTERIOR_COLOR_KEY])) {
+        if ((value = SKNColorFromArray(value)))
+            [dict setObject:value forKey:NOTE_INTERIOR_COLOR_KEY];
+        else
+            [dict removeObjectForKey:NOTE_INTERIOR_COLOR_KEY];
+    }
+    if ((value = [dict objectForKey:NOTE_FONT_COLOR_KEY])) {
+        if ((value = SKNColorFromArray(value)))
+            [dict setObject:value forKey:NOTE_FONT_COLOR_KEY];
+        else
+            [dict removeObjectForKey:NOTE_FONT_COLOR_KEY];
+    }
+    if ((value = [dict objectForKey:NOTE_FONT_NAME_KEY])) {
+        NSNumber *fontSize = [dict objectForKey:NOTE_FONT_SIZE_KEY];
+        if ([value isKindOfClass:[NSString class]]) {
+            CGFloat pointSize = [fontSize isKindOfClass:[NSNumber class]] ? [fontSize doubleValue] : 0.0;
+            value = [SKNFont fontWithName:value size:pointSize] ?: [SKNFont fontWithName:@"Helvetica" size:pointSize];
+            [dict setObject:value forKey:NOTE_FONT_KEY];
+        }
+        [dict removeObjectForKey:NOTE_FONT_NAME_KEY];
+        [dict removeObjectForKey:NOTE_FONT_SIZE_KEY];
+    }
+    if ((value = [dict objectForKey:NOTE_TEXT_KEY])) {
+        if ([value isKindOfClass:[NSData class]]) {
+            value = [[NSAttributedString alloc] initWithData:value options:[NSDictionary dictionary] documentAttributes:NULL error:NULL];
+            if (value) {
+                [dict setObject:value forKey:NOTE_TEXT_KEY];
+                [value release];
+            } else {
+                [dict removeObjectForKey:NOTE_TEXT_KEY];
+            }
+        } else if ([value isKindOfClass:[NSAttributedString class]] == NO) {
+            [dict removeObjectForKey:NOTE_TEXT_KEY];
+        }
+    }
+    if ((value = [dict objectForKey:NOTE_IMAGE_KEY])) {
+        if ([value isKindOfClass:[NSData class]]) {
+            value = [[SKNImage alloc] initWithData:value];
+            if (value) {
+                [dict setObject:value forKey:NOTE_IMAGE_KEY];
+                [value release];
+            } else {
+                [dict removeObjectForKey:NOTE_IMAGE_KEY];
+            }
+        } else if ([value isKindOfClass:[SKNImage class]] == NO) {
+            [dict removeObjectForKey:NOTE_IMAGE_KEY];
+        }
+    }
+}
+
+static NSMutableDictionary *SKNCreatePropertyListFromNote(NSDictionary *noteDict, NSMapTable **colors, NSMutableSet **arrays) {
+    NSMutableDictionary *dict = [noteDict mutableCopy];
+    id value;
+    if ((value = [dict objectForKey:NOTE_COLOR_KEY])) {
+        value = SKNCreateArrayFromColor(value, colors, arrays);
+        [dict setObject:value forKey:NOTE_COLOR_KEY];
+        [value release];
+    }
+    if ((value = [dict objectForKey:NOTE_INTERIOR_COLOR_KEY])) {
+        value = SKNCreateArrayFromColor(value, colors, arrays);
+        [dict setObject:value forKey:NOTE_INTERIOR_COLOR_KEY];
+        [value release];
+    }
+    if ((value = [dict objectForKey:NOTE_FONT_COLOR_KEY])) {
+        value = SKNCreateArrayFromColor(value, colors, arrays);
+        [dict setObject:value forKey:NOTE_FONT_COLOR_KEY];
+        [value release];
+    }
+    if ((value = [dict objectForKey:NOTE_FONT_KEY])) {
+        if ([value isKindOfClass:[SKNFont class]]) {
+            [dict setObject:[value fontName] forKey:NOTE_FONT_NAME_KEY];
+            [dict setObject:[NSNumber numberWithDouble:[value pointSize]] forKey:NOTE_FONT_SIZE_KEY];
+        }
+        [dict removeObjectForKey:NOTE_FONT_KEY];
+    }
+    if ((value = [dict objectForKey:NOTE_TEXT_KEY])) {
+        if ([value isKindOfClass:[NSAttributedString class]]) {
+#if !defined(PDFKIT_PLATFORM_IOS) && (!defined(MAC_OS_X_VERSION_10_11) || MAC_OS_X_VERSION_MIN_REQUIRED < MAC_OS_X_VERSION_10_11)
+            if ([value containsAttachments]) {
+#else
+            if ([value containsAttachmentsInRange:NSMakeRange(0, [value length])]) {
+#endif
+                value = [value dataFromRange:NSMakeRange(0, [value length]) documentAttributes:[NSDictionary dictionaryWithObjectsAndKeys:NSRTFDTextDocumentType, NSDocumentTypeDocumentAttribute, nil] error:NULL];
+            } else {
+                value = [value dataFromRange:NSMakeRange(0, [value length]) documentAttributes:[NSDictionary dictionaryWithObjectsAndKeys:NSRTFTextDocumentType, NSDocumentTypeDocumentAttribute, nil] error:NULL];
+            }
+            [dict setObject:value forKey:NOTE_TEXT_KEY];
+        } else if ([value isKindOfClass:[NSData class]] == NO) {
+            [dict removeObjectForKey:NOTE_TEXT_KEY];
+        }
+    }
+    if ((value = [dict objectForKey:NOTE_IMAGE_KEY])) {
+        if ([value isKindOfClass:[SKNImage class]]) {
+#if defined(SKIMNOTES_PLATFORM_IOS)
+            value = UIImagePNGRepresentation(value);
+#else
+            id imageRep = [[value representations] count] == 1 ? [[value representations] objectAtIndex:0] : nil;
+            if ([imageRep isKindOfClass:[NSPDFImageRep class]]) {
+                value = [imageRep PDFRepresentation];
+            } else if ([imageRep isKindOfClass:[NSEPSImageRep class]]) {
+                value = [imageRep EPSRepresentation];
+            } else {
+                value = [value TIFFRepresentation];
+            }
+#endif
+            [dict setObject:value forKey:NOTE_IMAGE_KEY];
+        } else if ([value isKindOfClass:[NSData class]] == NO) {
+            [dict removeObjectForKey:NOTE_IMAGE_KEY];
+        }
+    }
+    return dict;
+}
+
 NSArray *SKNSkimNotesFromData(NSData *data) {
     NSArray *noteDicts = nil;
     
-    if ([data length] > 0) {
+    if (SKNIsCompactData(data)) {
+        noteDicts = SKNSkimNotesFromCompactData(data, NSMakeRange(0, 0), YES, YES);
+    } else if ([data length] > 0) {
         unsigned char ch = 0;
         if ([data length] > 8)
             [data getBytes:&ch range:NSMakeRange(8, 1)];
@@ -259,53 +503,8 @@ NSArray *SKNSkimNotesFromData(NSData *data) {
         } else {
             noteDicts = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListMutableContainers format:NULL error:NULL];
             if ([noteDicts isKindOfClass:[NSArray class]]) {
-                for (NSMutableDictionary *dict in noteDicts) {
-                    id value;
-                    if ((value = [dict objectForKey:NOTE_COLOR_KEY])) {
-                        value = SKNColorFromArray(value);
-                        [dict setObject:value forKey:NOTE_COLOR_KEY];
-                    }
-                    if ((value = [dict objectForKey:NOTE_INTERIOR_COLOR_KEY])) {
-                        value = SKNColorFromArray(value);
-                        [dict setObject:value forKey:NOTE_INTERIOR_COLOR_KEY];
-                    }
-                    if ((value = [dict objectForKey:NOTE_FONT_COLOR_KEY])) {
-                        value = SKNColorFromArray(value);
-                        [dict setObject:value forKey:NOTE_FONT_COLOR_KEY];
-                    }
-                    if ((value = [dict objectForKey:NOTE_FONT_NAME_KEY])) {
-                        NSNumber *fontSize = [dict objectForKey:NOTE_FONT_SIZE_KEY];
-                        if ([value isKindOfClass:[NSString class]]) {
-                            CGFloat pointSize = [fontSize isKindOfClass:[NSNumber class]] ? [fontSize doubleValue] : 0.0;
-                            value = [SKNFont fontWithName:value size:pointSize] ?: [SKNFont fontWithName:@"Helvetica" size:pointSize];
-                            [dict setObject:value forKey:NOTE_FONT_KEY];
-                        }
-                        [dict removeObjectForKey:NOTE_FONT_NAME_KEY];
-                        [dict removeObjectForKey:NOTE_FONT_SIZE_KEY];
-                    }
-                    if ((value = [dict objectForKey:NOTE_TEXT_KEY])) {
-                        if ([value isKindOfClass:[NSData class]]) {
-                            value = [[NSAttributedString alloc] initWithData:value options:[NSDictionary dictionary] documentAttributes:NULL error:NULL];
-                            if (value) {
-                                [dict setObject:value forKey:NOTE_TEXT_KEY];
-                                [value release];
-                            } else {
-                                [dict removeObjectForKey:NOTE_TEXT_KEY];
-                            }
-                        } else if ([value isKindOfClass:[NSAttributedString class]] == NO) {
-                            [dict removeObjectForKey:NOTE_TEXT_KEY];
-                        }
-                    }
-                    if ((value = [dict objectForKey:NOTE_IMAGE_KEY])) {
-                        if ([value isKindOfClass:[NSData class]]) {
-                            value = [[SKNImage alloc] initWithData:value];
-                            [dict setObject:value forKey:NOTE_IMAGE_KEY];
-                            [value release];
-                        } else if ([value isKindOfClass:[SKNImage class]] == NO) {
-                            [dict removeObjectForKey:NOTE_IMAGE_KEY];
-                        }
-                    }
-                }
+                for (NSMutableDictionary *dict in noteDicts)
+                    SKNConvertPropertyListToNote(dict);
             }
         }
         if ([noteDicts isKindOfClass:[NSArray class]] == NO) {
@@ -328,65 +527,7 @@ NSData *SKNDataFromSkimNotes(NSArray *noteDicts, BOOL asPlist) {
             NSMapTable *colors = nil;
             NSMutableSet *arrays = nil;
             for (NSDictionary *noteDict in noteDicts) {
-                NSMutableDictionary *dict = [noteDict mutableCopy];
-                id value;
-                if ((value = [dict objectForKey:NOTE_COLOR_KEY])) {
-                    value = SKNCreateArrayFromColor(value, &colors, &arrays);
-                    [dict setObject:value forKey:NOTE_COLOR_KEY];
-                    [value release];
-                }
-                if ((value = [dict objectForKey:NOTE_INTERIOR_COLOR_KEY])) {
-                    value = SKNCreateArrayFromColor(value, &colors, &arrays);
-                    [dict setObject:value forKey:NOTE_INTERIOR_COLOR_KEY];
-                    [value release];
-                }
-                if ((value = [dict objectForKey:NOTE_FONT_COLOR_KEY])) {
-                    value = SKNCreateArrayFromColor(value, &colors, &arrays);
-                    [dict setObject:value forKey:NOTE_FONT_COLOR_KEY];
-                    [value release];
-                }
-                if ((value = [dict objectForKey:NOTE_FONT_KEY])) {
-                    if ([value isKindOfClass:[SKNFont class]]) {
-                        [dict setObject:[value fontName] forKey:NOTE_FONT_NAME_KEY];
-                        [dict setObject:[NSNumber numberWithDouble:[value pointSize]] forKey:NOTE_FONT_SIZE_KEY];
-                    }
-                    [dict removeObjectForKey:NOTE_FONT_KEY];
-                }
-                if ((value = [dict objectForKey:NOTE_TEXT_KEY])) {
-                    if ([value isKindOfClass:[NSAttributedString class]]) {
-#if !defined(PDFKIT_PLATFORM_IOS) && (!defined(MAC_OS_X_VERSION_10_11) || MAC_OS_X_VERSION_MIN_REQUIRED < MAC_OS_X_VERSION_10_11)
-                        if ([value containsAttachments]) {
-#else
-                        if ([value containsAttachmentsInRange:NSMakeRange(0, [value length])]) {
-#endif
-                            value = [value dataFromRange:NSMakeRange(0, [value length]) documentAttributes:[NSDictionary dictionaryWithObjectsAndKeys:NSRTFDTextDocumentType, NSDocumentTypeDocumentAttribute, nil] error:NULL];
-                        } else {
-                            value = [value dataFromRange:NSMakeRange(0, [value length]) documentAttributes:[NSDictionary dictionaryWithObjectsAndKeys:NSRTFTextDocumentType, NSDocumentTypeDocumentAttribute, nil] error:NULL];
-                        }
-                        [dict setObject:value forKey:NOTE_TEXT_KEY];
-                    } else if ([value isKindOfClass:[NSData class]] == NO) {
-                        [dict removeObjectForKey:NOTE_TEXT_KEY];
-                    }
-                }
-                if ((value = [dict objectForKey:NOTE_IMAGE_KEY])) {
-                    if ([value isKindOfClass:[SKNImage class]]) {
-#if defined(SKIMNOTES_PLATFORM_IOS)
-                        value = UIImagePNGRepresentation(value);
-#else
-                        id imageRep = [[value representations] count] == 1 ? [[value representations] objectAtIndex:0] : nil;
-                        if ([imageRep isKindOfClass:[NSPDFImageRep class]]) {
-                            value = [imageRep PDFRepresentation];
-                        } else if ([imageRep isKindOfClass:[NSEPSImageRep class]]) {
-                            value = [imageRep EPSRepresentation];
-                        } else {
-                            value = [value TIFFRepresentation];
-                        }
-#endif
-                        [dict setObject:value forKey:NOTE_IMAGE_KEY];
-                    } else if ([value isKindOfClass:[NSData class]] == NO) {
-                        [dict removeObjectForKey:NOTE_IMAGE_KEY];
-                    }
-                }
+                NSMutableDictionary *dict = SKNCreatePropertyListFromNote(noteDict, &colors, &arrays);
                 [array addObject:dict];
                 [dict release];
             }
@@ -400,3 +541,638 @@ NSData *SKNDataFromSkimNotes(NSArray *noteDicts, BOOL asPlist) {
     }
     return data;
 }
+
+#pragma mark Compact format
+
+/*
+ The compact format is little endian, and all offsets are from the start of the data.
+ 
+ header     magic "SKNBIN", uint16 version, uint32 flags, uint32 number of notes, pages, strings, and colors,
+            uint32 offsets of the TOC, strings, colors, and records, and uint32 total length
+ TOC        per page: uint32 page index, first position in the order table, and number of notes, sorted by page index
+ order      per note: uint32 record index, grouped by page as in the TOC
+ strings    uint32 offset of each string and of the end, relative to the end of the offsets, followed by the UTF-8 bytes
+ colors     per color: uint32 number of components, followed by 4 float64 components
+ records    per note: uint32 offset of its record, followed by the records
+ 
+ A record is the plist representation of a note, encoded as a tagged value.  Counts, lengths, and indexes
+ are varints.  Dictionary keys and repeated strings refer to the shared strings, colors to the shared colors.
+ */
+
+#define COMPACT_MAGIC           "SKNBIN"
+#define COMPACT_MAGIC_LENGTH    6
+#define COMPACT_VERSION         1
+#define COMPACT_HEADER_LENGTH   48
+#define TOC_ENTRY_LENGTH        12
+#define COLOR_ENTRY_LENGTH      36
+#define MAX_COMPACT_DEPTH       32
+
+enum {
+    SKNCompactString        = 'S',
+    SKNCompactInlineString  = 's',
+    SKNCompactInteger       = 'I',
+    SKNCompactReal          = 'D',
+    SKNCompactTrue          = 'T',
+    SKNCompactFalse         = 'F',
+    SKNCompactDate          = 'd',
+    SKNCompactData          = 'B',
+    SKNCompactArray         = 'A',
+    SKNCompactDictionary    = 'M',
+    SKNCompactColor         = 'C'
+};
+
+static inline uint32_t SKNReadUInt32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline double SKNReadDouble(const unsigned char *p) {
+    uint64_t u = (uint64_t)SKNReadUInt32(p) | ((uint64_t)SKNReadUInt32(p + 4) << 32);
+    double d;
+    memcpy(&d, &u, sizeof(double));
+    return d;
+}
+
+static inline BOOL SKNReadVarint(const unsigned char *bytes, size_t length, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+    unsigned int shift = 0;
+    while (*pos < length && shift < 64) {
+        unsigned char b = bytes[(*pos)++];
+        result |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            *value = result;
+            return YES;
+        }
+        shift += 7;
+    }
+    return NO;
+}
+
+static inline void SKNWriteUInt32(unsigned char *p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static inline void SKNAppendUInt32(NSMutableData *data, uint32_t value) {
+    unsigned char bytes[4];
+    SKNWriteUInt32(bytes, value);
+    [data appendBytes:bytes length:4];
+}
+
+static inline void SKNAppendDouble(NSMutableData *data, double value) {
+    uint64_t u;
+    memcpy(&u, &value, sizeof(double));
+    SKNAppendUInt32(data, (uint32_t)u);
+    SKNAppendUInt32(data, (uint32_t)(u >> 32));
+}
+
+static inline void SKNAppendVarint(NSMutableData *data, uint64_t value) {
+    unsigned char bytes[10];
+    NSUInteger n = 0;
+    while (value >= 0x80) {
+        bytes[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    bytes[n++] = (unsigned char)value;
+    [data appendBytes:bytes length:n];
+}
+
+static inline void SKNAppendTag(NSMutableData *data, unsigned char tag) {
+    [data appendBytes:&tag length:1];
+}
+
+static inline BOOL SKNIsColorKey(NSString *key) {
+    return [key isEqualToString:NOTE_COLOR_KEY] || [key isEqualToString:NOTE_INTERIOR_COLOR_KEY] || [key isEqualToString:NOTE_FONT_COLOR_KEY];
+}
+
+static BOOL SKNIsCompactData(NSData *data) {
+    return [data length] >= COMPACT_HEADER_LENGTH && memcmp([data bytes], COMPACT_MAGIC, COMPACT_MAGIC_LENGTH) == 0;
+}
+
+typedef struct _SKNCompactWriter {
+    NSMutableData *records;
+    NSCountedSet *stringCounts;
+    NSMutableArray *strings;
+    NSMutableDictionary *stringIndexes;
+    NSMutableArray *colors;
+    NSMutableDictionary *colorIndexes;
+} SKNCompactWriter;
+
+typedef struct _SKNCompactPageEntry {
+    uint32_t pageIndex;
+    uint32_t recordIndex;
+} SKNCompactPageEntry;
+
+static uint32_t SKNCompactIndex(id object, NSMutableArray *objects, NSMutableDictionary *indexes) {
+    NSNumber *number = [indexes objectForKey:object];
+    if (number == nil) {
+        number = [NSNumber numberWithUnsignedInt:(uint32_t)[objects count]];
+        [objects addObject:object];
+        [indexes setObject:number forKey:object];
+    }
+    return [number unsignedIntValue];
+}
+
+static void SKNCountCompactStrings(id value, NSCountedSet *counts, NSUInteger depth) {
+    if (depth > MAX_COMPACT_DEPTH) {
+    } else if ([value isKindOfClass:[NSString class]]) {
+        [counts addObject:value];
+    } else if ([value isKindOfClass:[NSArray class]]) {
+        for (id object in value)
+            SKNCountCompactStrings(object, counts, depth + 1);
+    } else if ([value isKindOfClass:[NSDictionary class]]) {
+        for (NSString *key in value) {
+            // keys are always shared
+            if ([key isKindOfClass:[NSString class]]) {
+                [counts addObject:key];
+                [counts addObject:key];
+            }
+            SKNCountCompactStrings([value objectForKey:key], counts, depth + 1);
+        }
+    }
+}
+
+static BOOL SKNAppendCompactValue(SKNCompactWriter *writer, id value, BOOL isColor, NSUInteger depth) {
+    NSMutableData *data = writer->records;
+    
+    if (depth > MAX_COMPACT_DEPTH) {
+        return NO;
+    } else if ([value isKindOfClass:[NSString class]]) {
+        if ([writer->stringCounts countForObject:value] > 1) {
+            SKNAppendTag(data, SKNCompactString);
+            SKNAppendVarint(data, SKNCompactIndex(value, writer->strings, writer->stringIndexes));
+        } else {
+            NSData *utf8 = [value dataUsingEncoding:NSUTF8StringEncoding];
+            if (utf8 == nil)
+                return NO;
+            SKNAppendTag(data, SKNCompactInlineString);
+            SKNAppendVarint(data, [utf8 length]);
+            [data appendData:utf8];
+        }
+    } else if ([value isKindOfClass:[NSNumber class]]) {
+        if (CFGetTypeID((CFTypeRef)value) == CFBooleanGetTypeID()) {
+            SKNAppendTag(data, [value boolValue] ? SKNCompactTrue : SKNCompactFalse);
+        } else if (CFNumberIsFloatType((CFNumberRef)value)) {
+            SKNAppendTag(data, SKNCompactReal);
+            SKNAppendDouble(data, [value doubleValue]);
+        } else {
+            int64_t i = [value longLongValue];
+            SKNAppendTag(data, SKNCompactInteger);
+            SKNAppendVarint(data, ((uint64_t)i << 1) ^ (uint64_t)(i >> 63));
+        }
+    } else if ([value isKindOfClass:[NSDate class]]) {
+        SKNAppendTag(data, SKNCompactDate);
+        SKNAppendDouble(data, [value timeIntervalSinceReferenceDate]);
+    } else if ([value isKindOfClass:[NSData class]]) {
+        SKNAppendTag(data, SKNCompactData);
+        SKNAppendVarint(data, [value length]);
+        [data appendData:value];
+    } else if (isColor && SKNIsNumberArray(value) && [value count] > 0 && [value count] <= 4) {
+        SKNAppendTag(data, SKNCompactColor);
+        SKNAppendVarint(data, SKNCompactIndex(value, writer->colors, writer->colorIndexes));
+    } else if ([value isKindOfClass:[NSArray class]]) {
+        SKNAppendTag(data, SKNCompactArray);
+        SKNAppendVarint(data, [value count]);
+        for (id object in value) {
+            if (SKNAppendCompactValue(writer, object, NO, depth + 1) == NO)
+                return NO;
+        }
+    } else if ([value isKindOfClass:[NSDictionary class]]) {
+        // collect the entries first, as we skip values we cannot represent rather than the whole dictionary
+        NSMutableData *entries = [[NSMutableData alloc] init];
+        NSUInteger count = 0;
+        writer->records = entries;
+        for (NSString *key in value) {
+            NSUInteger length = [entries length];
+            if ([key isKindOfClass:[NSString class]] == NO)
+                continue;
+            SKNAppendVarint(entries, SKNCompactIndex(key, writer->strings, writer->stringIndexes));
+            if (SKNAppendCompactValue(writer, [value objectForKey:key], SKNIsColorKey(key), depth + 1))
+                count++;
+            else
+                [entries setLength:length];
+        }
+        writer->records = data;
+        SKNAppendTag(data, SKNCompactDictionary);
+        SKNAppendVarint(data, count);
+        [data appendData:entries];
+        [entries release];
+    } else {
+        return NO;
+    }
+    return YES;
+}
+
+static int SKNComparePageEntries(const void *a, const void *b) {
+    const SKNCompactPageEntry *entry1 = a, *entry2 = b;
+    if (entry1->pageIndex != entry2->pageIndex)
+        return entry1->pageIndex < entry2->pageIndex ? -1 : 1;
+    return entry1->recordIndex < entry2->recordIndex ? -1 : entry1->recordIndex > entry2->recordIndex ? 1 : 0;
+}
+
+NSData *SKNCompactDataFromSkimNotes(NSArray *noteDicts) {
+    if (noteDicts == nil || [noteDicts count] >= UINT32_MAX)
+        return nil;
+    
+    NSUInteger i, count = [noteDicts count], pageCount = 0;
+    NSMutableArray *dicts = [[NSMutableArray alloc] initWithCapacity:count];
+    SKNCompactPageEntry *entries = (SKNCompactPageEntry *)NSZoneMalloc(NULL, MAX(count, 1) * sizeof(SKNCompactPageEntry));
+    uint32_t *recordOffsets = (uint32_t *)NSZoneMalloc(NULL, MAX(count, 1) * sizeof(uint32_t));
+    SKNCompactWriter writer;
+    NSMapTable *colors = nil;
+    NSMutableSet *arrays = nil;
+    NSMutableData *data = nil;
+    
+    writer.records = [[NSMutableData alloc] init];
+    writer.stringCounts = [[NSCountedSet alloc] init];
+    writer.strings = [[NSMutableArray alloc] init];
+    writer.stringIndexes = [[NSMutableDictionary alloc] init];
+    writer.colors = [[NSMutableArray alloc] init];
+    writer.colorIndexes = [[NSMutableDictionary alloc] init];
+    
+    // first find the strings we should share
+    for (NSDictionary *noteDict in noteDicts) {
+        NSMutableDictionary *dict = SKNCreatePropertyListFromNote(noteDict, &colors, &arrays);
+        SKNCountCompactStrings(dict, writer.stringCounts, 0);
+        [dicts addObject:dict];
+        [dict release];
+    }
+    
+    for (i = 0; i < count; i++) {
+        NSDictionary *dict = [dicts objectAtIndex:i];
+        NSUInteger pageIndex = [[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue];
+        recordOffsets[i] = (uint32_t)MIN([writer.records length], (NSUInteger)UINT32_MAX);
+        entries[i].pageIndex = (uint32_t)MIN(pageIndex, (NSUInteger)UINT32_MAX);
+        entries[i].recordIndex = (uint32_t)i;
+        SKNAppendCompactValue(&writer, dict, NO, 0);
+    }
+    
+    qsort(entries, count, sizeof(SKNCompactPageEntry), SKNComparePageEntries);
+    for (i = 0; i < count; i++) {
+        if (i == 0 || entries[i].pageIndex != entries[i - 1].pageIndex)
+            pageCount++;
+    }
+    
+    NSMutableArray *stringData = [NSMutableArray arrayWithCapacity:[writer.strings count]];
+    uint64_t stringLength = 0;
+    for (NSString *string in writer.strings) {
+        NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+        [stringData addObject:utf8];
+        stringLength += [utf8 length];
+    }
+    
+    uint64_t tocOffset = COMPACT_HEADER_LENGTH;
+    uint64_t stringsOffset = tocOffset + TOC_ENTRY_LENGTH * pageCount + 4 * count;
+    uint64_t colorsOffset = (stringsOffset + 4 * ([stringData count] + 1) + stringLength + 3) & ~(uint64_t)3;
+    uint64_t recordsOffset = colorsOffset + COLOR_ENTRY_LENGTH * [writer.colors count];
+    uint64_t recordDataOffset = recordsOffset + 4 * count;
+    uint64_t length = recordDataOffset + [writer.records length];
+    
+    if (length <= UINT32_MAX) {
+        unsigned char header[COMPACT_HEADER_LENGTH] = {0};
+        uint32_t offset = 0;
+        NSUInteger first = 0;
+        
+        memcpy(header, COMPACT_MAGIC, COMPACT_MAGIC_LENGTH);
+        header[6] = COMPACT_VERSION & 0xFF;
+        header[7] = (COMPACT_VERSION >> 8) & 0xFF;
+        SKNWriteUInt32(header + 12, (uint32_t)count);
+        SKNWriteUInt32(header + 16, (uint32_t)pageCount);
+        SKNWriteUInt32(header + 20, (uint32_t)[stringData count]);
+        SKNWriteUInt32(header + 24, (uint32_t)[writer.colors count]);
+        SKNWriteUInt32(header + 28, (uint32_t)tocOffset);
+        SKNWriteUInt32(header + 32, (uint32_t)stringsOffset);
+        SKNWriteUInt32(header + 36, (uint32_t)colorsOffset);
+        SKNWriteUInt32(header + 40, (uint32_t)recordsOffset);
+        SKNWriteUInt32(header + 44, (uint32_t)length);
+        
+        data = [NSMutableData dataWithCapacity:(NSUInteger)length];
+        [data appendBytes:header length:COMPACT_HEADER_LENGTH];
+        
+        for (i = 1; i <= count; i++) {
+            if (i == count || entries[i].pageIndex != entries[first].pageIndex) {
+                SKNAppendUInt32(data, entries[first].pageIndex);
+                SKNAppendUInt32(data, (uint32_t)first);
+                SKNAppendUInt32(data, (uint32_t)(i - first));
+                first = i;
+            }
+        }
+        for (i = 0; i < count; i++)
+            SKNAppendUInt32(data, entries[i].recordIndex);
+        
+        for (NSData *utf8 in stringData) {
+            SKNAppendUInt32(data, offset);
+            offset += (uint32_t)[utf8 length];
+        }
+        SKNAppendUInt32(data, offset);
+        for (NSData *utf8 in stringData)
+            [data appendData:utf8];
+        [data setLength:(NSUInteger)colorsOffset];
+        
+        for (NSArray *color in writer.colors) {
+            NSUInteger j, n = [color count];
+            SKNAppendUInt32(data, (uint32_t)n);
+            for (j = 0; j < 4; j++)
+                SKNAppendDouble(data, j < n ? [[color objectAtIndex:j] doubleValue] : 0.0);
+        }
+        
+        for (i = 0; i < count; i++)
+            SKNAppendUInt32(data, (uint32_t)(recordDataOffset + recordOffsets[i]));
+        [data appendData:writer.records];
+    }
+    
+    [dicts release];
+    [writer.records release];
+    [writer.stringCounts release];
+    [writer.strings release];
+    [writer.stringIndexes release];
+    [writer.colors release];
+    [writer.colorIndexes release];
+    [colors release];
+    [arrays release];
+    NSZoneFree(NULL, entries);
+    NSZoneFree(NULL, recordOffsets);
+    
+    return data;
+}
+
+typedef struct _SKNCompactReader {
+    const unsigned char *bytes;
+    size_t length;
+    uint32_t noteCount;
+    uint32_t pageCount;
+    uint32_t stringCount;
+    uint32_t colorCount;
+    uint32_t tocOffset;
+    uint32_t stringsOffset;
+    uint32_t colorsOffset;
+    uint32_t recordsOffset;
+    id *strings;
+    id *colors;
+} SKNCompactReader;
+
+static BOOL SKNOpenCompactReader(SKNCompactReader *reader, NSData *data) {
+    const unsigned char *bytes = [data bytes];
+    size_t length = [data length];
+    
+    if (SKNIsCompactData(data) == NO || (bytes[6] | (bytes[7] << 8)) != COMPACT_VERSION || SKNReadUInt32(bytes + 44) != length)
+        return NO;
+    
+    reader->bytes = bytes;
+    reader->length = length;
+    reader->noteCount = SKNReadUInt32(bytes + 12);
+    reader->pageCount = SKNReadUInt32(bytes + 16);
+    reader->stringCount = SKNReadUInt32(bytes + 20);
+    reader->colorCount = SKNReadUInt32(bytes + 24);
+    reader->tocOffset = SKNReadUInt32(bytes + 28);
+    reader->stringsOffset = SKNReadUInt32(bytes + 32);
+    reader->colorsOffset = SKNReadUInt32(bytes + 36);
+    reader->recordsOffset = SKNReadUInt32(bytes + 40);
+    
+    if ((uint64_t)reader->tocOffset + (uint64_t)TOC_ENTRY_LENGTH * reader->pageCount + 4 * (uint64_t)reader->noteCount > length ||
+        (uint64_t)reader->stringsOffset + 4 * ((uint64_t)reader->stringCount + 1) > length ||
+        (uint64_t)reader->colorsOffset + (uint64_t)COLOR_ENTRY_LENGTH * reader->colorCount > length ||
+        (uint64_t)reader->recordsOffset + 4 * (uint64_t)reader->noteCount > length)
+        return NO;
+    
+    reader->strings = (id *)NSZoneCalloc(NULL, MAX(reader->stringCount, 1), sizeof(id));
+    reader->colors = (id *)NSZoneCalloc(NULL, MAX(reader->colorCount, 1), sizeof(id));
+    return YES;
+}
+
+static void SKNCloseCompactReader(SKNCompactReader *reader) {
+    uint32_t i;
+    for (i = 0; i < reader->stringCount; i++)
+        [reader->strings[i] release];
+    for (i = 0; i < reader->colorCount; i++)
+        [reader->colors[i] release];
+    NSZoneFree(NULL, reader->strings);
+    NSZoneFree(NULL, reader->colors);
+}
+
+static NSString *SKNCompactString(SKNCompactReader *reader, uint64_t idx) {
+    if (idx >= reader->stringCount)
+        return nil;
+    if (reader->strings[idx] == nil) {
+        const unsigned char *offsets = reader->bytes + reader->stringsOffset;
+        uint64_t start = SKNReadUInt32(offsets + 4 * idx), end = SKNReadUInt32(offsets + 4 * (idx + 1));
+        uint64_t base = (uint64_t)reader->stringsOffset + 4 * ((uint64_t)reader->stringCount + 1);
+        if (start > end || base + end > reader->length)
+            return nil;
+        reader->strings[idx] = [[NSString alloc] initWithBytes:reader->bytes + base + start length:(NSUInteger)(end - start) encoding:NSUTF8StringEncoding];
+    }
+    return reader->strings[idx];
+}
+
+static NSArray *SKNCompactColor(SKNCompactReader *reader, uint64_t idx) {
+    if (idx >= reader->colorCount)
+        return nil;
+    if (reader->colors[idx] == nil) {
+        const unsigned char *entry = reader->bytes + reader->colorsOffset + COLOR_ENTRY_LENGTH * idx;
+        uint32_t i, n = SKNReadUInt32(entry);
+        NSNumber *components[4];
+        if (n == 0 || n > 4)
+            return nil;
+        for (i = 0; i < n; i++)
+            components[i] = [NSNumber numberWithDouble:SKNReadDouble(entry + 4 + 8 * i)];
+        reader->colors[idx] = [[NSArray alloc] initWithObjects:components count:n];
+    }
+    return reader->colors[idx];
+}
+
+static id SKNCopyCompactValue(SKNCompactReader *reader, size_t *offset, NSUInteger depth) {
+    const unsigned char *bytes = reader->bytes;
+    size_t length = reader->length, pos = *offset;
+    uint64_t i, n;
+    id value = nil;
+    
+    if (pos >= length || depth > MAX_COMPACT_DEPTH)
+        return nil;
+    
+    switch (bytes[pos++]) {
+        case SKNCompactString:
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO)
+                return nil;
+            value = [SKNCompactString(reader, n) retain];
+            break;
+        case SKNCompactInlineString:
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO || n > length - pos)
+                return nil;
+            value = [[NSString alloc] initWithBytes:bytes + pos length:(NSUInteger)n encoding:NSUTF8StringEncoding];
+            pos += n;
+            break;
+        case SKNCompactInteger:
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO)
+                return nil;
+            value = [[NSNumber alloc] initWithLongLong:(long long)((n >> 1) ^ (~(n & 1) + 1))];
+            break;
+        case SKNCompactReal:
+            if (length - pos < 8)
+                return nil;
+            value = [[NSNumber alloc] initWithDouble:SKNReadDouble(bytes + pos)];
+            pos += 8;
+            break;
+        case SKNCompactTrue:
+            value = [[NSNumber alloc] initWithBool:YES];
+            break;
+        case SKNCompactFalse:
+            value = [[NSNumber alloc] initWithBool:NO];
+            break;
+        case SKNCompactDate:
+            if (length - pos < 8)
+                return nil;
+            value = [[NSDate alloc] initWithTimeIntervalSinceReferenceDate:SKNReadDouble(bytes + pos)];
+            pos += 8;
+            break;
+        case SKNCompactData:
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO || n > length - pos)
+                return nil;
+            value = [[NSData alloc] initWithBytes:bytes + pos length:(NSUInteger)n];
+            pos += n;
+            break;
+        case SKNCompactColor:
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO)
+                return nil;
+            value = [SKNCompactColor(reader, n) retain];
+            break;
+        case SKNCompactArray:
+            // every value takes at least one byte
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO || n > length - pos)
+                return nil;
+            value = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)n];
+            for (i = 0; i < n; i++) {
+                id object = SKNCopyCompactValue(reader, &pos, depth + 1);
+                if (object == nil) {
+                    [value release];
+                    return nil;
+                }
+                [value addObject:object];
+                [object release];
+            }
+            break;
+        case SKNCompactDictionary:
+            // every entry takes at least two bytes
+            if (SKNReadVarint(bytes, length, &pos, &n) == NO || n > (length - pos) / 2)
+                return nil;
+            value = [[NSMutableDictionary alloc] initWithCapacity:(NSUInteger)n];
+            for (i = 0; i < n; i++) {
+                uint64_t keyIndex;
+                NSString *key = SKNReadVarint(bytes, length, &pos, &keyIndex) ? SKNCompactString(reader, keyIndex) : nil;
+                id object = key ? SKNCopyCompactValue(reader, &pos, depth + 1) : nil;
+                if (object == nil) {
+                    [value release];
+                    return nil;
+                }
+                [value setObject:object forKey:key];
+                [object release];
+            }
+            break;
+        default:
+            return nil;
+    }
+    
+    if (value)
+        *offset = pos;
+    return value;
+}
+
+static NSArray *SKNSkimNotesFromCompactData(NSData *data, NSRange pageRange, BOOL allPages, BOOL convert) {
+    SKNCompactReader reader;
+    NSMutableArray *noteDicts = nil;
+    NSIndexSet *recordIndexes = nil;
+    
+    if (SKNOpenCompactReader(&reader, data) == NO)
+        return nil;
+    
+    if (allPages) {
+        recordIndexes = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, reader.noteCount)];
+    } else {
+        // collect the notes on the pages in the range from the TOC, in their original order
+        const unsigned char *toc = reader.bytes + reader.tocOffset;
+        const unsigned char *order = toc + TOC_ENTRY_LENGTH * reader.pageCount;
+        NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+        uint32_t lo = 0, hi = reader.pageCount;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (SKNReadUInt32(toc + TOC_ENTRY_LENGTH * mid) < pageRange.location)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (; lo < reader.pageCount; lo++) {
+            const unsigned char *entry = toc + TOC_ENTRY_LENGTH * lo;
+            uint32_t i, first = SKNReadUInt32(entry + 4), n = SKNReadUInt32(entry + 8);
+            if (NSLocationInRange(SKNReadUInt32(entry), pageRange) == NO)
+                break;
+            if ((uint64_t)first + n > reader.noteCount) {
+                indexes = nil;
+                break;
+            }
+            for (i = 0; i < n; i++)
+                [indexes addIndex:SKNReadUInt32(order + 4 * (first + i))];
+        }
+        recordIndexes = indexes;
+    }
+    
+    if (recordIndexes && ([recordIndexes count] == 0 || [recordIndexes lastIndex] < reader.noteCount)) {
+        NSUInteger i = [recordIndexes firstIndex];
+        noteDicts = [NSMutableArray arrayWithCapacity:[recordIndexes count]];
+        while (i != NSNotFound) {
+            size_t offset = SKNReadUInt32(reader.bytes + reader.recordsOffset + 4 * i);
+            NSMutableDictionary *dict = SKNCopyCompactValue(&reader, &offset, 0);
+            if ([dict isKindOfClass:[NSMutableDictionary class]] == NO) {
+                [dict release];
+                noteDicts = nil;
+                break;
+            }
+            if (convert)
+                SKNConvertPropertyListToNote(dict);
+            [noteDicts addObject:dict];
+            [dict release];
+            i = [recordIndexes indexGreaterThanIndex:i];
+        }
+    }
+    
+    SKNCloseCompactReader(&reader);
+    
+    return noteDicts;
+}
+
+NSArray *SKNSkimNotesFromDataInPageRange(NSData *data, NSRange pageRange) {
+    if (SKNIsCompactData(data))
+        return SKNSkimNotesFromCompactData(data, pageRange, NO, YES);
+    
+    NSArray *noteDicts = SKNSkimNotesFromData(data);
+    NSMutableArray *filteredNoteDicts = nil;
+    if (noteDicts) {
+        filteredNoteDicts = [NSMutableArray array];
+        for (NSDictionary *dict in noteDicts) {
+            if (NSLocationInRange([[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue], pageRange))
+                [filteredNoteDicts addObject:dict];
+        }
+    }
+    return filteredNoteDicts;
+}
+
+NSUInteger SKNNumberOfSkimNotesInData(NSData *data, NSRange pageRange) {
+    SKNCompactReader reader;
+    NSUInteger count = 0;
+    
+    if (SKNOpenCompactReader(&reader, data)) {
+        // only the TOC is needed to count the notes
+        const unsigned char *toc = reader.bytes + reader.tocOffset;
+        uint32_t i;
+        for (i = 0; i < reader.pageCount; i++) {
+            if (NSLocationInRange(SKNReadUInt32(toc + TOC_ENTRY_LENGTH * i), pageRange))
+                count += SKNReadUInt32(toc + TOC_ENTRY_LENGTH * i + 8);
+        }
+        SKNCloseCompactReader(&reader);
+    } else {
+        for (NSDictionary *dict in SKNNoteRecordsFromData(data)) {
+            if ([dict isKindOfClass:[NSDictionary class]] && NSLocationInRange([[dict objectForKey:NOTE_PAGE_INDEX_KEY] unsignedIntegerValue], pageRange))
+                count++;
+        }
+    }
+    return count;
+}
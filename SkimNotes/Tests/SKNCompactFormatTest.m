@@ -0,0 +1,236 @@
+//
+//  SKNCompactFormatTest.m
+//  SkimNotes
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Writes generated notes as keyed archive, plist, and compact data through the SkimNotes functions, checks that all
+// notes and the notes on some pages are read back unchanged, that truncated compact data is rejected, and that
+// mutated compact data is read without raising, and writes the size of each format and the time to read it.
+// Needs AppKit, see run_tests.sh.
+
+#import <AppKit/AppKit.h>
+#import "SKNUtilities.h"
+
+#define TEST_NUMBER_OF_NOTES    5000
+#define TEST_NUMBER_OF_READS    5
+#define TEST_NUMBER_OF_MUTATIONS 20000
+
+#define TEST_CHECK(condition, msg) do { if ((condition) == NO) { fprintf(stderr, "FAIL: %s\n", msg); failures++; } } while (0)
+
+static NSArray *SKNTestNotes(NSUInteger count) {
+    NSArray *colors = [NSArray arrayWithObjects:[NSColor colorWithCalibratedRed:1.0 green:1.0 blue:0.5 alpha:1.0], [NSColor colorWithCalibratedRed:0.2 green:0.6 blue:0.3 alpha:0.5], [NSColor colorWithCalibratedWhite:0.25 alpha:1.0], nil];
+    NSFont *font = [NSFont fontWithName:@"Helvetica" size:12.0];
+    NSDate *date = [NSDate dateWithTimeIntervalSinceReferenceDate:600000000.0];
+    NSUInteger pageCount = MAX(1, count / 10);
+    NSMutableArray *notes = [NSMutableArray arrayWithCapacity:count];
+    NSUInteger i;
+    
+    for (i = 0; i < count; i++) {
+        // spread the notes over the pages out of order, so the index has to group them
+        NSUInteger pageIndex = (i * 13) % pageCount;
+        NSRect bounds = NSMakeRect(50.0 + (i % 40) * 10.0, 700.0 - (i % 60) * 10.0, 120.0 + (i % 7), 30.0 + (i % 5));
+        NSColor *color = [colors objectAtIndex:i % [colors count]];
+        NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+        [dict setObject:NSStringFromRect(bounds) forKey:@"bounds"];
+        [dict setObject:[NSNumber numberWithUnsignedInteger:pageIndex] forKey:@"pageIndex"];
+        [dict setObject:[NSString stringWithFormat:@"Note %lu on page %lu", (unsigned long)i, (unsigned long)pageIndex] forKey:@"contents"];
+        [dict setObject:color forKey:@"color"];
+        [dict setObject:date forKey:@"modificationDate"];
+        [dict setObject:@"Skim" forKey:@"userName"];
+        switch (i % 4) {
+            case 0:
+                [dict setObject:@"FreeText" forKey:@"type"];
+                [dict setObject:font forKey:@"font"];
+                [dict setObject:[colors objectAtIndex:2] forKey:@"fontColor"];
+                [dict setObject:[NSNumber numberWithInteger:0] forKey:@"alignment"];
+                break;
+            case 1:
+            {
+                NSAttributedString *text = [[NSAttributedString alloc] initWithString:[NSString stringWithFormat:@"Text of note %lu\nwith a second line", (unsigned long)i] attributes:[NSDictionary dictionaryWithObjectsAndKeys:font, NSFontAttributeName, nil]];
+                [dict setObject:@"Note" forKey:@"type"];
+                [dict setObject:text forKey:@"text"];
+                [dict setObject:[NSNumber numberWithInteger:i % 7] forKey:@"iconType"];
+                [text release];
+                break;
+            }
+            case 2:
+                [dict setObject:@"Circle" forKey:@"type"];
+                [dict setObject:[colors objectAtIndex:1] forKey:@"interiorColor"];
+                [dict setObject:[NSNumber numberWithDouble:1.5] forKey:@"lineWidth"];
+                [dict setObject:[NSArray arrayWithObjects:[NSNumber numberWithDouble:3.0], [NSNumber numberWithDouble:1.0], nil] forKey:@"dashPattern"];
+                break;
+            default:
+                [dict setObject:@"Highlight" forKey:@"type"];
+                [dict setObject:[NSArray arrayWithObjects:NSStringFromPoint(NSMakePoint(NSMinX(bounds), NSMaxY(bounds))), NSStringFromPoint(NSMakePoint(NSMaxX(bounds), NSMaxY(bounds))), NSStringFromPoint(NSMakePoint(NSMinX(bounds), NSMinY(bounds))), NSStringFromPoint(NSMakePoint(NSMaxX(bounds), NSMinY(bounds))), nil] forKey:@"quadrilateralPoints"];
+                break;
+        }
+        [notes addObject:dict];
+    }
+    return notes;
+}
+
+// notes are compared through their plist representation, as colors, fonts, and text do not compare well
+static id SKNTestPropertyList(NSArray *notes) {
+    NSData *data = SKNDataFromSkimNotes(notes, YES);
+    return data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL] : nil;
+}
+
+static NSArray *SKNTestNotesInPageRange(NSArray *notes, NSRange pageRange) {
+    NSMutableArray *filteredNotes = [NSMutableArray array];
+    for (NSDictionary *dict in notes) {
+        if (NSLocationInRange([[dict objectForKey:@"pageIndex"] unsignedIntegerValue], pageRange))
+            [filteredNotes addObject:dict];
+    }
+    return filteredNotes;
+}
+
+static NSTimeInterval SKNTestReadTime(NSData *data, NSRange pageRange, BOOL allPages) {
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    NSUInteger i;
+    for (i = 0; i < TEST_NUMBER_OF_READS; i++) {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        if (allPages)
+            SKNSkimNotesFromData(data);
+        else
+            SKNSkimNotesFromDataInPageRange(data, pageRange);
+        [pool release];
+    }
+    return ([NSDate timeIntervalSinceReferenceDate] - startTime) / TEST_NUMBER_OF_READS;
+}
+
+static BOOL SKNPerformTest(NSUInteger count) {
+    NSUInteger failures = 0;
+    NSArray *notes = SKNTestNotes(count);
+    NSData *archiveData = SKNDataFromSkimNotes(notes, NO);
+    NSData *plistData = SKNDataFromSkimNotes(notes, YES);
+    NSData *compactData = SKNCompactDataFromSkimNotes(notes);
+    NSUInteger pageCount = MAX(1, count / 10);
+    NSRange pageRange = NSMakeRange(pageCount / 3, MAX(1, pageCount / 20));
+    NSUInteger i;
+    
+    TEST_CHECK(archiveData && plistData && compactData, "writing notes data");
+    if (failures)
+        return NO;
+    
+    // archives keep the original objects, the text and colors of plist and compact data are recreated
+    // from the same plist values, so compare those with the notes after reading the plist data once
+    NSArray *readNotes = SKNSkimNotesFromData(plistData);
+    id expected = SKNTestPropertyList(readNotes);
+    id expectedInRange = SKNTestPropertyList(SKNTestNotesInPageRange(readNotes, pageRange));
+    NSUInteger countInRange = [SKNTestNotesInPageRange(notes, pageRange) count];
+    
+    TEST_CHECK([readNotes count] == count, "reading plist data");
+    TEST_CHECK([SKNTestPropertyList(SKNSkimNotesFromData(archiveData)) isEqual:SKNTestPropertyList(notes)], "reading archive data");
+    TEST_CHECK([SKNTestPropertyList(SKNSkimNotesFromData(compactData)) isEqual:expected], "reading compact data");
+    TEST_CHECK([SKNTestPropertyList(SKNSkimNotesFromDataInPageRange(compactData, pageRange)) isEqual:expectedInRange], "reading compact data in a page range");
+    TEST_CHECK([SKNTestPropertyList(SKNSkimNotesFromDataInPageRange(archiveData, pageRange)) isEqual:SKNTestPropertyList(SKNTestNotesInPageRange(notes, pageRange))], "reading archive data in a page range");
+    TEST_CHECK(SKNNumberOfSkimNotesInData(compactData, pageRange) == countInRange, "counting notes in compact data");
+    TEST_CHECK(SKNNumberOfSkimNotesInData(archiveData, pageRange) == countInRange, "counting notes in archive data");
+    TEST_CHECK(SKNNumberOfSkimNotesInData(compactData, NSMakeRange(0, NSUIntegerMax)) == count, "counting all notes in compact data");
+    TEST_CHECK([SKNSkimNotesFromDataInPageRange(compactData, NSMakeRange(pageCount, 10)) count] == 0, "reading compact data beyond the last page");
+    TEST_CHECK([SKNSkimNotesFromData(SKNCompactDataFromSkimNotes([NSArray array])) isEqual:[NSArray array]], "reading compact data without notes");
+    
+    // a truncated header or body no longer matches the length in the header
+    NSUInteger length = [compactData length];
+    NSUInteger step = MAX(1, length / 1000);
+    for (i = 1; i < length; i += (i < 64 ? 1 : step)) {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSData *truncatedData = [compactData subdataWithRange:NSMakeRange(0, i)];
+        if (SKNSkimNotesFromData(truncatedData) != nil || SKNSkimNotesFromDataInPageRange(truncatedData, pageRange) != nil || SKNNumberOfSkimNotesInData(truncatedData, NSMakeRange(0, NSUIntegerMax)) != 0) {
+            fprintf(stderr, "FAIL: truncated compact data of length %lu is read\n", (unsigned long)i);
+            failures++;
+            [pool release];
+            break;
+        }
+        [pool release];
+    }
+    
+    // corrupt data may still be read, but should never fail or return anything else than note dictionaries,
+    // use fewer notes as every mutation reads all of them
+    NSMutableData *corruptData = [SKNCompactDataFromSkimNotes([notes subarrayWithRange:NSMakeRange(0, MIN(count, 64))]) mutableCopy];
+    unsigned char *bytes = [corruptData mutableBytes];
+    length = [corruptData length];
+    srandom(19);
+    for (i = 0; i < TEST_NUMBER_OF_MUTATIONS && length > 0; i++) {
+        NSAutoreleasePool *pool = [NSAutoreleasePool new];
+        NSUInteger j, n = 1 + random() % 4;
+        size_t positions[4];
+        unsigned char values[4];
+        for (j = 0; j < n; j++) {
+            // target the header and tables more often than the records, they hold the offsets and counts
+            positions[j] = (random() % 2) ? random() % MIN(length, 4096) : random() % length;
+            values[j] = bytes[positions[j]];
+            bytes[positions[j]] = (random() % 3) ? (unsigned char)random() : values[j] ^ (1 << (random() % 8));
+        }
+        @try {
+            NSArray *corruptNotes = SKNSkimNotesFromData(corruptData);
+            for (id dict in corruptNotes) {
+                if ([dict isKindOfClass:[NSDictionary class]] == NO) {
+                    fprintf(stderr, "FAIL: corrupt compact data returns a %s\n", [NSStringFromClass([dict class]) UTF8String]);
+                    failures++;
+                    break;
+                }
+            }
+            SKNSkimNotesFromDataInPageRange(corruptData, pageRange);
+            SKNNumberOfSkimNotesInData(corruptData, pageRange);
+        }
+        @catch (id e) {
+            fprintf(stderr, "FAIL: corrupt compact data raises %s\n", [[e description] UTF8String]);
+            failures++;
+        }
+        while (j-- > 0)
+            bytes[positions[j]] = values[j];
+        [pool release];
+    }
+    [corruptData release];
+    
+    fprintf(stdout, "%lu notes on %lu pages, %lu notes on pages %lu-%lu\n", (unsigned long)count, (unsigned long)pageCount, (unsigned long)countInRange, (unsigned long)pageRange.location, (unsigned long)NSMaxRange(pageRange) - 1);
+    fprintf(stdout, "format\tsize\tread all\tread pages\n");
+    fprintf(stdout, "archive\t%lu\t%.3f ms\t%.3f ms\n", (unsigned long)[archiveData length], 1000.0 * SKNTestReadTime(archiveData, pageRange, YES), 1000.0 * SKNTestReadTime(archiveData, pageRange, NO));
+    fprintf(stdout, "plist\t%lu\t%.3f ms\t%.3f ms\n", (unsigned long)[plistData length], 1000.0 * SKNTestReadTime(plistData, pageRange, YES), 1000.0 * SKNTestReadTime(plistData, pageRange, NO));
+    fprintf(stdout, "compact\t%lu\t%.3f ms\t%.3f ms\n", (unsigned long)[compactData length], 1000.0 * SKNTestReadTime(compactData, pageRange, YES), 1000.0 * SKNTestReadTime(compactData, pageRange, NO));
+    fprintf(stdout, "%lu failures\n", (unsigned long)failures);
+    
+    return failures == 0;
+}
+
+int main(int argc, const char *argv[]) {
+    NSAutoreleasePool *pool = [NSAutoreleasePool new];
+    NSUInteger count = argc > 1 ? (NSUInteger)MAX(0, atol(argv[1])) : TEST_NUMBER_OF_NOTES;
+    BOOL success = SKNPerformTest(count);
+    [pool release];
+    return success ? 0 : 1;
+}
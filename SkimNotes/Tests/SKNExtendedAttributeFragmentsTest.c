@@ -0,0 +1,386 @@
+//
+//  SKNExtendedAttributeFragmentsTest.c
+//  SkimNotes
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Writes split attributes the way SKNExtendedAttributeManager does to a file in TEST_DIR, default /dev/shm when
+// it exists and /tmp otherwise, and checks that SKNExtendedAttributeFragments reads them back, or reports missing,
+// truncated, corrupt, and oversized fragments. Then compares the time to read a large value with the reader
+// and with two calls per fragment and decompressing at the end, as the manager did before.
+// The filesystem must allow many extended attributes on one file, which rules out ext4 on Linux.
+// Usage: SKNExtendedAttributeFragmentsTest [NUMBER_OF_NOTES], smaller numbers are raised to MIN_NUMBER_OF_NOTES.
+
+#include "SKNExtendedAttributeFragments.h"
+#include <sys/types.h>
+#include <sys/xattr.h>
+#include <bzlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// the same as in SKNExtendedAttributeManager
+#define MAX_XATTR_LENGTH 2048
+#define SYNCABLE_SUFFIX "#S"
+// enough for several fragments and chunks with any codec
+#define MIN_NUMBER_OF_NOTES 1000
+
+#if defined(__APPLE__)
+#define NAME_PREFIX ""
+#define setAttribute(path, name, value, size) setxattr(path, name, value, size, 0, 0)
+#define getAttribute(path, name, value, size) getxattr(path, name, value, size, 0, 0)
+#define removeAttribute(path, name) removexattr(path, name, 0)
+#else
+// other systems only allow arbitrary attributes in the user namespace
+#define NAME_PREFIX "user."
+#define setAttribute(path, name, value, size) setxattr(path, name, value, size, 0)
+#define getAttribute(path, name, value, size) getxattr(path, name, value, size)
+#define removeAttribute(path, name) removexattr(path, name)
+#ifndef ENOATTR
+#define ENOATTR ENODATA
+#endif
+#endif
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { if ((condition) == 0) { fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); failures++; } } while (0)
+
+static char path[1024];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// something like the XML plist of notes, so it compresses like real notes
+static char *copyNotesData(size_t numberOfNotes, size_t *length) {
+    size_t capacity = 400 * numberOfNotes + 256, used = 0, i;
+    char *data = malloc(capacity);
+    used += snprintf(data + used, capacity - used, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<plist version=\"1.0\">\n<array>\n");
+    for (i = 0; i < numberOfNotes; i++) {
+        used += snprintf(data + used, capacity - used,
+                         "\t<dict>\n\t\t<key>bounds</key>\n\t\t<string>{{%d, %d}, {%d, 14}}</string>\n"
+                         "\t\t<key>color</key>\n\t\t<array><real>1</real><real>%.3f</real><real>0.5</real><real>1</real></array>\n"
+                         "\t\t<key>contents</key>\n\t\t<string>Note %lu about section %d</string>\n"
+                         "\t\t<key>pageIndex</key>\n\t\t<integer>%lu</integer>\n\t\t<key>type</key>\n\t\t<string>%s</string>\n\t</dict>\n",
+                         rand() % 500, rand() % 700, 20 + rand() % 300, (rand() % 1000) / 1000.0, (unsigned long)i, rand() % 40, (unsigned long)(i / 10), (i % 3) ? "Highlight" : "Note");
+    }
+    used += snprintf(data + used, capacity - used, "</array>\n</plist>\n");
+    *length = used;
+    return data;
+}
+
+static size_t writeFragments(const char *uniqueName, const char *suffix, const char *bytes, size_t length, size_t fragmentLength) {
+    char name[256];
+    size_t i, n = (length + fragmentLength - 1) / fragmentLength;
+    for (i = 0; i < n; i++) {
+        size_t fragment = length - i * fragmentLength < fragmentLength ? length - i * fragmentLength : fragmentLength;
+        snprintf(name, sizeof(name), "%s-%lu%s", uniqueName, (unsigned long)i, suffix);
+        if (setAttribute(path, name, bytes + i * fragmentLength, fragment) == -1) {
+            fprintf(stderr, "cannot write %s to %s: %s\n", name, path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return n;
+}
+
+static void removeFragments(const char *uniqueName, const char *suffix, size_t n) {
+    char name[256];
+    size_t i;
+    for (i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "%s-%lu%s", uniqueName, (unsigned long)i, suffix);
+        removeAttribute(path, name);
+    }
+}
+
+static SKNFragmentsStatus readFragments(const char *uniqueName, const char *suffix, size_t n, SKNCodec codec, void **bytes, size_t *length) {
+    *bytes = NULL;
+    *length = 0;
+    return SKNCopyReassembledFragments(path, uniqueName, suffix, n, MAX_XATTR_LENGTH, codec, 1, bytes, length);
+}
+
+static int readsBack(const char *uniqueName, const char *suffix, size_t n, SKNCodec codec, const char *data, size_t length) {
+    void *bytes;
+    size_t readLength;
+    SKNFragmentsStatus status = readFragments(uniqueName, suffix, n, codec, &bytes, &readLength);
+    int equal = status == SKNFragmentsOK && readLength == length && memcmp(bytes, data, length) == 0;
+    free(bytes);
+    return equal;
+}
+
+static void testFragments(SKNCodec codec, const char *data, size_t length) {
+    const char *uniqueName = codec == SKNCodecBzip2 ? NAME_PREFIX "skn-test-bzip2" : NAME_PREFIX "skn-test-zlib";
+    size_t compressedLength, n;
+    char *compressed = SKNCopyCompressedBytes(codec, data, length, &compressedLength);
+    void *bytes;
+    size_t readLength;
+    char name[256];
+
+    CHECK(compressed != NULL, "compressing with codec %d", codec);
+    if (compressed == NULL)
+        return;
+
+    // suffixed fragments, and fragments written before the suffix was used
+    n = writeFragments(uniqueName, SYNCABLE_SUFFIX, compressed, compressedLength, MAX_XATTR_LENGTH);
+    CHECK(n > 2, "number of fragments %lu", (unsigned long)n);
+    CHECK(readsBack(uniqueName, SYNCABLE_SUFFIX, n, codec, data, length), "reading %lu suffixed fragments with codec %d", (unsigned long)n, codec);
+    removeFragments(uniqueName, SYNCABLE_SUFFIX, n);
+    writeFragments(uniqueName, "", compressed, compressedLength, MAX_XATTR_LENGTH);
+    CHECK(readsBack(uniqueName, SYNCABLE_SUFFIX, n, codec, data, length), "reading fragments without the suffix with codec %d", codec);
+    CHECK(readsBack(uniqueName, "", n, codec, data, length), "reading fragments without a suffix with codec %d", codec);
+
+    // a missing fragment is found from the listed names
+    snprintf(name, sizeof(name), "%s-%lu", uniqueName, (unsigned long)(n / 2));
+    removeAttribute(path, name);
+    errno = 0;
+    CHECK(readFragments(uniqueName, "", n, codec, &bytes, &readLength) == SKNFragmentsMissing && errno == ENOATTR, "missing fragment, errno %d", errno);
+    CHECK(readFragments(uniqueName, "", n + 1, codec, &bytes, &readLength) == SKNFragmentsMissing, "more fragments than written");
+    removeFragments(uniqueName, "", n);
+
+    // a truncated value, or fewer fragments than written, cut less than the last fragment so the number of fragments stays the same
+    writeFragments(uniqueName, "", compressed, compressedLength - (compressedLength - 1) % MAX_XATTR_LENGTH / 2 - 1, MAX_XATTR_LENGTH);
+    CHECK(readFragments(uniqueName, "", n, codec, &bytes, &readLength) == SKNFragmentsInvalidData, "truncated last fragment");
+    removeFragments(uniqueName, "", n);
+    writeFragments(uniqueName, "", compressed, compressedLength, MAX_XATTR_LENGTH);
+    CHECK(readFragments(uniqueName, "", n - 1, codec, &bytes, &readLength) == SKNFragmentsInvalidData, "too few fragments");
+    snprintf(name, sizeof(name), "%s-%lu", uniqueName, (unsigned long)1);
+    setAttribute(path, name, compressed + MAX_XATTR_LENGTH, 100);
+    CHECK(readFragments(uniqueName, "", n, codec, &bytes, &readLength) == SKNFragmentsInvalidData, "truncated middle fragment");
+    removeFragments(uniqueName, "", n);
+
+    // corrupt data is caught by the checksum of the codec
+    compressed[compressedLength / 2] ^= 0x55;
+    writeFragments(uniqueName, "", compressed, compressedLength, MAX_XATTR_LENGTH);
+    CHECK(readFragments(uniqueName, "", n, codec, &bytes, &readLength) == SKNFragmentsInvalidData, "corrupt fragment");
+    removeFragments(uniqueName, "", n);
+    compressed[compressedLength / 2] ^= 0x55;
+
+    // fragments longer than expected, written by someone else
+    n = writeFragments(uniqueName, "", compressed, compressedLength, 3 * MAX_XATTR_LENGTH / 2);
+    CHECK(readsBack(uniqueName, "", n, codec, data, length), "reading oversized fragments with codec %d", codec);
+    removeFragments(uniqueName, "", n);
+
+    free(compressed);
+
+    // an empty value
+    compressed = SKNCopyCompressedBytes(codec, "", 0, &compressedLength);
+    CHECK(compressed != NULL, "compressing an empty value with codec %d", codec);
+    if (compressed) {
+        n = writeFragments(uniqueName, SYNCABLE_SUFFIX, compressed, compressedLength, MAX_XATTR_LENGTH);
+        CHECK(readsBack(uniqueName, SYNCABLE_SUFFIX, n, codec, "", 0), "reading an empty value with codec %d", codec);
+        removeFragments(uniqueName, SYNCABLE_SUFFIX, n);
+        free(compressed);
+    }
+
+    CHECK(readFragments(uniqueName, "", 0, codec, &bytes, &readLength) == SKNFragmentsMissing && errno == EINVAL, "no fragments");
+}
+
+static void testChunks(const char *data, size_t length) {
+    SKNCodec codec = SKNCodecBzip2;
+    uint64_t seed = SKNChunkSeed(NAME_PREFIX "net_sourceforge_skim-app_notes", codec);
+    size_t count, editedCount, shared = 0, i, j;
+    SKNChunk *chunks = SKNCopyContentDefinedChunks(data, length, 16 * MAX_XATTR_LENGTH, seed, &count);
+    char **names;
+    size_t *numbers;
+    void *bytes;
+    size_t readLength;
+
+    CHECK(chunks != NULL && count > 1, "chunking %lu bytes", (unsigned long)length);
+    if (chunks == NULL)
+        return;
+    for (i = 0, j = 0; i < count; i++) {
+        CHECK(chunks[i].offset == j && chunks[i].length > 0, "chunk %lu at %lu", (unsigned long)i, (unsigned long)chunks[i].offset);
+        j += chunks[i].length;
+    }
+    CHECK(j == length, "chunks cover %lu of %lu bytes", (unsigned long)j, (unsigned long)length);
+
+    // an edit in the middle only changes the chunks around it
+    char *edited = malloc(length + 5);
+    memcpy(edited, data, length / 2);
+    memcpy(edited + length / 2, "edit!", 5);
+    memcpy(edited + length / 2 + 5, data + length / 2, length - length / 2);
+    SKNChunk *editedChunks = SKNCopyContentDefinedChunks(edited, length + 5, 16 * MAX_XATTR_LENGTH, seed, &editedCount);
+    for (i = 0; i < editedCount; i++) {
+        for (j = 0; j < count; j++) {
+            if (memcmp(editedChunks[i].digest, chunks[j].digest, SKN_CHUNK_DIGEST_LENGTH) == 0) {
+                shared++;
+                break;
+            }
+        }
+    }
+    CHECK(shared + 3 >= count, "%lu of %lu chunks unchanged after an edit", (unsigned long)shared, (unsigned long)count);
+    free(editedChunks);
+    free(edited);
+
+    // each chunk is compressed separately and written as fragments named after its digest
+    names = calloc(count, sizeof(char *));
+    numbers = calloc(count, sizeof(size_t));
+    for (i = 0; i < count; i++) {
+        size_t compressedLength;
+        char *compressed = SKNCopyCompressedBytes(codec, data + chunks[i].offset, chunks[i].length, &compressedLength);
+        names[i] = malloc(64);
+        j = (size_t)snprintf(names[i], 64, "%snet_sourceforge_skim-app_", NAME_PREFIX);
+        for (size_t k = 0; k < SKN_CHUNK_DIGEST_LENGTH; k++)
+            j += (size_t)snprintf(names[i] + j, 64 - j, "%02x", chunks[i].digest[k]);
+        numbers[i] = writeFragments(names[i], SYNCABLE_SUFFIX, compressed, compressedLength, MAX_XATTR_LENGTH);
+        free(compressed);
+    }
+    CHECK(SKNCopyReassembledChunks(path, (const char * const *)names, numbers, count, SYNCABLE_SUFFIX, MAX_XATTR_LENGTH, codec, 1, &bytes, &readLength) == SKNFragmentsOK && readLength == length && memcmp(bytes, data, length) == 0, "reading %lu chunks", (unsigned long)count);
+    free(bytes);
+    removeFragments(names[count / 2], SYNCABLE_SUFFIX, 1);
+    CHECK(SKNCopyReassembledChunks(path, (const char * const *)names, numbers, count, SYNCABLE_SUFFIX, MAX_XATTR_LENGTH, codec, 1, &bytes, &readLength) == SKNFragmentsMissing, "missing chunk fragment");
+    for (i = 0; i < count; i++) {
+        removeFragments(names[i], SYNCABLE_SUFFIX, numbers[i]);
+        free(names[i]);
+    }
+    free(names);
+    free(numbers);
+    free(chunks);
+}
+
+static void testSingleAttribute(const char *data) {
+    const char *name = NAME_PREFIX "skn-test-single";
+    void *bytes;
+    size_t length;
+
+    setAttribute(path, name, data, 100);
+    bytes = SKNCopyExtendedAttribute(path, name, 1, MAX_XATTR_LENGTH, &length);
+    CHECK(bytes && length == 100 && memcmp(bytes, data, 100) == 0, "reading a short attribute");
+    free(bytes);
+    // longer than expected
+    setAttribute(path, name, data, 3000);
+    bytes = SKNCopyExtendedAttribute(path, name, 1, MAX_XATTR_LENGTH, &length);
+    CHECK(bytes && length == 3000 && memcmp(bytes, data, 3000) == 0, "reading a long attribute");
+    free(bytes);
+    setAttribute(path, name, "", 0);
+    bytes = SKNCopyExtendedAttribute(path, name, 1, MAX_XATTR_LENGTH, &length);
+    CHECK(bytes && length == 0, "reading an empty attribute");
+    free(bytes);
+    removeAttribute(path, name);
+    errno = 0;
+    CHECK(SKNCopyExtendedAttribute(path, name, 1, MAX_XATTR_LENGTH, &length) == NULL && errno == ENOATTR, "reading a missing attribute");
+}
+
+// how the fragments were read before: a size query and a read for each fragment, then decompressing everything
+static char *copyFragmentsTwoCallsEach(const char *uniqueName, size_t n, size_t *length) {
+    char name[256];
+    size_t used = 0, i;
+    char *input = NULL, *output;
+    unsigned int outputLength;
+    for (i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "%s-%lu", uniqueName, (unsigned long)i);
+        ssize_t size = getAttribute(path, name, NULL, 0);
+        input = realloc(input, used + (size_t)size);
+        used += (size_t)getAttribute(path, name, input + used, (size_t)size);
+    }
+    outputLength = (unsigned int)(40 * used);
+    output = malloc(outputLength);
+    if (BZ2_bzBuffToBuffDecompress(output, &outputLength, input, (unsigned int)used, 0, 0) != BZ_OK) {
+        free(output);
+        output = NULL;
+    }
+    free(input);
+    *length = outputLength;
+    return output;
+}
+
+static void benchmark(const char *data, size_t length, size_t numberOfNotes) {
+    const char *uniqueName = NAME_PREFIX "skn-test-benchmark";
+    size_t compressedLength, n, readLength, i;
+    char *compressed = SKNCopyCompressedBytes(SKNCodecBzip2, data, length, &compressedLength);
+    double start, fragmentsTime, oldTime;
+    int repeats = 20;
+    void *bytes;
+
+    n = writeFragments(uniqueName, "", compressed, compressedLength, MAX_XATTR_LENGTH);
+    free(compressed);
+
+    start = now();
+    for (i = 0; i < (size_t)repeats; i++) {
+        bytes = copyFragmentsTwoCallsEach(uniqueName, n, &readLength);
+        CHECK(bytes && readLength == length, "reading with two calls per fragment");
+        free(bytes);
+    }
+    oldTime = (now() - start) / repeats;
+    start = now();
+    for (i = 0; i < (size_t)repeats; i++) {
+        CHECK(readFragments(uniqueName, "", n, SKNCodecBzip2, &bytes, &readLength) == SKNFragmentsOK && readLength == length, "reading with one call per fragment");
+        free(bytes);
+    }
+    fragmentsTime = (now() - start) / repeats;
+
+    removeFragments(uniqueName, "", n);
+    printf("%lu notes, %lu bytes in %lu bzip2 fragments: %.2f ms with one call per fragment, %.2f ms with two calls per fragment\n", (unsigned long)numberOfNotes, (unsigned long)length, (unsigned long)n, 1000.0 * fragmentsTime, 1000.0 * oldTime);
+}
+
+int main(int argc, const char *argv[]) {
+    size_t numberOfNotes = argc > 1 ? (size_t)atol(argv[1]) : 5000;
+    const char *dir = getenv("TEST_DIR");
+    size_t length;
+    char *data;
+    int fd;
+
+    if (dir == NULL)
+        dir = access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp";
+    snprintf(path, sizeof(path), "%s/SKNExtendedAttributeFragmentsTest.XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd < 0) {
+        fprintf(stderr, "cannot create a file in %s\n", dir);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    if (numberOfNotes < MIN_NUMBER_OF_NOTES)
+        numberOfNotes = MIN_NUMBER_OF_NOTES;
+    srand(15);
+    data = copyNotesData(numberOfNotes, &length);
+
+    testSingleAttribute(data);
+    testFragments(SKNCodecBzip2, data, length);
+    testFragments(SKNCodecZlib, data, length);
+    testChunks(data, length);
+    benchmark(data, length, numberOfNotes);
+
+    free(data);
+    unlink(path);
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
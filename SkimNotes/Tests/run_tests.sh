@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# Builds and runs the tests of the plain C parts of SkimNotes, which also build on Linux,
+# and on macOS the test of the notes data formats, which needs AppKit.
+# Usage: Tests/run_tests.sh [NUMBER_OF_NOTES]
+# Set CC and CFLAGS to use another compiler or sanitizers, e.g. CFLAGS="-g -fsanitize=address,undefined",
+# and TEST_DIR to a directory on a filesystem that allows many extended attributes on one file.
+
+set -e
+
+TESTS_DIR=$(cd "$(dirname "$0")" && pwd)
+SOURCE_DIR=$(dirname "$TESTS_DIR")
+BUILD_DIR=${BUILD_DIR:-$(mktemp -d)}
+
+: ${CC:=cc}
+: ${CFLAGS:=-O2}
+
+$CC $CFLAGS -std=c99 -D_DEFAULT_SOURCE -D_DARWIN_C_SOURCE -Wall -I"$SOURCE_DIR" -o "$BUILD_DIR/SKNExtendedAttributeFragmentsTest" "$TESTS_DIR/SKNExtendedAttributeFragmentsTest.c" "$SOURCE_DIR/SKNExtendedAttributeFragments.c" -lbz2 -lz
+"$BUILD_DIR/SKNExtendedAttributeFragmentsTest" "$@"
+
+if [ "$(uname)" = "Darwin" ]; then
+    $CC $CFLAGS -Wall -I"$SOURCE_DIR" -o "$BUILD_DIR/SKNCompactFormatTest" "$TESTS_DIR/SKNCompactFormatTest.m" "$SOURCE_DIR/SKNUtilities.m" "$SOURCE_DIR/SKNExtendedAttributeFragments.c" -framework AppKit -weak_framework Compression -lbz2 -lz
+    "$BUILD_DIR/SKNCompactFormatTest" "$@"
+fi
@@ -42,13 +42,14 @@
 #import "SKNUtilities.h"
 
 static char *usageStr = "Usage:\n"
-                        " skimnotes get [-format skim|archive|plist|text|rtf] PDF_FILE [NOTES_FILE|-]\n"
+                        " skimnotes get [-format skim|archive|plist|compact|text|rtf] PDF_FILE [NOTES_FILE|-]\n"
                         " skimnotes set [-s|-n] PDF_FILE [SKIM_FILE|-] [TEXT_FILE] [RTF_FILE]\n"
                         " skimnotes remove PDF_FILE\n"
                         " skimnotes test [-s|-n] PDF_FILE\n"
                         " skimnotes convert [-s|-n] IN_PDF_FILE [OUT_PDF_FILE]\n"
-                        " skimnotes format archive|plist|text|rtf IN_SKIM_FILE|- [OUT_FILE|-]\n"
+                        " skimnotes format archive|plist|compact|text|rtf IN_SKIM_FILE|- [OUT_FILE|-]\n"
                         " skimnotes offset DX DY IN_SKIM_FILE|- [OUT_SKIM_FILE|-]\n"
+                        " skimnotes batch [-j JOBS] [-0] [-ordered] VERB [OPTIONS] [LIST_FILE|-]\n"
                         " skimnotes agent [SERVER_NAME]\n"
                         " skimnotes protocol\n"
                         " skimnotes help [VERB]\n"
@@ -56,7 +57,7 @@ static char *usageStr = "Usage:\n"
 static char *versionStr = "SkimNotes command-line client, version 2.9.3";
 
 static char *getHelpStr = "skimnotes get: read Skim notes from a PDF\n"
-                          "Usage: skimnotes get [-format skim|archive|plist|text|rtf] PDF_FILE [NOTES_FILE|-]\n\n"
+                          "Usage: skimnotes get [-format skim|archive|plist|compact|text|rtf] PDF_FILE [NOTES_FILE|-]\n\n"
                           "Reads Skim, Text, or RTF notes from extended attributes of PDF_FILE or the contents of PDF bundle PDF_FILE and writes to NOTES_FILE or standard output.\n"
                           "Uses notes file with same base name as PDF_FILE if SKIM_FILE is not provided.\n"
                           "Reads Skim notes when no format is provided.";
@@ -78,15 +79,22 @@ static char *convertHelpStr = "skimnotes convert: convert between a PDF file and
                               "Converts a PDF file IN_PDF_FILE to a PDF bundle OUT_PDF_FILE or a PDF bundle IN_PDF_FILE to a PDF file OUT_PDF_FILE, or changes the syncability of the notes.\n"
                               "Uses a file with same base name but different extension as IN_PDF_FILE if OUT_PDF_FILE is not provided.\n"
                               "Writes (non) syncable notes when the -s (-n) option is provided, defaults to syncable.";
-static char *formatHelpStr = "skimnotes format: formats Skim notes data as archive, plist, text, or RTF data"
-                             "Usage: skimnotes format archive|plist|text|rtf IN_SKIM_FILE|- [OUT_FILE|-]\n\n"
-                             "Format the notes data IN_SKIM_FILE or standard input to archive, plist, text, or RTF format and writes the result to OUT_FILE or standard output.\n"
+static char *formatHelpStr = "skimnotes format: formats Skim notes data as archive, plist, compact, text, or RTF data"
+                             "Usage: skimnotes format archive|plist|compact|text|rtf IN_SKIM_FILE|- [OUT_FILE|-]\n\n"
+                             "Format the notes data IN_SKIM_FILE or standard input to archive, plist, compact, text, or RTF format and writes the result to OUT_FILE or standard output.\n"
                              "Writes back to a file with the same base name as IN_SKIM_FILE (or standard output) if OUT_FILE is not provided."
-                             "Archive and plist data can be used as the format for .skim files or attached to PDFs";
+                             "Archive and plist data can be used as the format for .skim files or attached to PDFs.\n"
+                             "Compact data is smaller and can be read a page at a time, but older versions cannot read it.";
 static char *offsetHelpStr = "skimnotes offsets: offsets all notes in a SKIM file by a fixed amount\n"
                              "Usage: skimnotes offset DX DY IN_SKIM_FILE|- [OUT_SKIM_FILE|-]\n\n"
                              "Offsets all notes in IN_SKIM_FILE or standard input by an amount (DX, DY) and writes the result to OUT_SKIM_FILE or standard output.\n"
                              "Writes back to IN_SKIM_FILE (or standard output) if OUT_SKIM_FILE is not provided.";
+static char *batchHelpStr = "skimnotes batch: run a verb for many files\n"
+                            "Usage: skimnotes batch [-j JOBS] [-0] [-ordered] VERB [OPTIONS] [LIST_FILE|-]\n\n"
+                            "Runs VERB, which is one of get, set, remove, test, convert, format, or offset, with OPTIONS for each entry in LIST_FILE or standard input, processing up to JOBS files at the same time, defaults to the number of processors.\n"
+                            "Entries are separated by newlines, or by NUL characters when the -0 option is provided. Each entry is a file path, optionally followed by tab separated paths for the other file arguments of VERB. Standard input and output cannot be used in an entry.\n"
+                            "Writes the status (ok or error, yes or no for test), the path, and an error message for each entry to standard output as soon as it is finished, or in the order of the entries when the -ordered option is provided.\n"
+                            "Writes the number of files and the throughput to standard error, and returns a zero exit status when all entries succeed.";
 static char *agentHelpStr = "skimnotes agent: run the Skim Notes agent\n"
                             "Usage: skimnotes agent [SERVER_NAME]\n\n"
                             "Runs a Skim Notes agent server with server name SERVER_NAME, to which a Cocoa application can connect using DO.\n"
@@ -96,6 +104,9 @@ static char *agentHelpStr = "skimnotes agent: run the Skim Notes agent\n"
                             "- (bycopy NSData *)SkimNotesAtPath:(in bycopy NSString *)aFile;\n"
                             "- (bycopy NSData *)RTFNotesAtPath:(in bycopy NSString *)aFile;\n"
                             "- (bycopy NSData *)textNotesAtPath:(in bycopy NSString *)aFile encoding:(NSStringEncoding)encoding;\n"
+                            "- (bycopy NSArray *)SkimNotesAtPaths:(in bycopy NSArray *)files;\n"
+                            "- (bycopy NSArray *)RTFNotesAtPaths:(in bycopy NSArray *)files;\n"
+                            "- (bycopy NSArray *)textNotesAtPaths:(in bycopy NSArray *)files encoding:(NSStringEncoding)encoding;\n"
                             "@end";
 static char *protocolHelpStr = "skimnotes protocol: write the DO server protocol to standard output\n"
                                "Usage: skimnotes protocol\n\n"
@@ -111,6 +122,9 @@ static char *protocolStr = "@protocol SKNAgentListenerProtocol\n"
                            "- (bycopy NSData *)SkimNotesAtPath:(in bycopy NSString *)aFile;\n"
                            "- (bycopy NSData *)RTFNotesAtPath:(in bycopy NSString *)aFile;\n"
                            "- (bycopy NSData *)textNotesAtPath:(in bycopy NSString *)aFile encoding:(NSStringEncoding)encoding;\n"
+                           "- (bycopy NSArray *)SkimNotesAtPaths:(in bycopy NSArray *)files;\n"
+                           "- (bycopy NSArray *)RTFNotesAtPaths:(in bycopy NSArray *)files;\n"
+                           "- (bycopy NSArray *)textNotesAtPaths:(in bycopy NSArray *)files encoding:(NSStringEncoding)encoding;\n"
                            "@end";
 
 #define ACTION_GET_STRING       @"get"
@@ -120,6 +134,7 @@ static char *protocolStr = "@protocol SKNAgentListenerProtocol\n"
 #define ACTION_CONVERT_STRING   @"convert"
 #define ACTION_FORMAT_STRING    @"format"
 #define ACTION_OFFSET_STRING    @"offset"
+#define ACTION_BATCH_STRING     @"batch"
 #define ACTION_AGENT_STRING     @"agent"
 #define ACTION_PROTOCOL_STRING  @"protocol"
 #define ACTION_VERSION_STRING   @"version"
@@ -128,6 +143,9 @@ static char *protocolStr = "@protocol SKNAgentListenerProtocol\n"
 #define FORMAT_OPTION_STRING        @"-format"
 #define SYNCABLE_OPTION_STRING      @"-s"
 #define NONSYNCABLE_OPTION_STRING   @"-n"
+#define JOBS_OPTION_STRING          @"-j"
+#define NUL_OPTION_STRING           @"-0"
+#define ORDERED_OPTION_STRING       @"-ordered"
 
 #define FORMAT_SKIM_STRING      @"skim"
 #define FORMAT_TEXT_STRING      @"text"
@@ -135,11 +153,13 @@ static char *protocolStr = "@protocol SKNAgentListenerProtocol\n"
 #define FORMAT_RTF_STRING       @"rtf"
 #define FORMAT_ARCHIVE_STRING   @"archive"
 #define FORMAT_PLIST_STRING     @"plist"
+#define FORMAT_COMPACT_STRING   @"compact"
 #define FORMAT_S_STRING         @"s"
 #define FORMAT_T_STRING         @"t"
 #define FORMAT_R_STRING         @"r"
 #define FORMAT_A_STRING         @"a"
 #define FORMAT_P_STRING         @"p"
+#define FORMAT_C_STRING         @"c"
 
 #define STD_IN_OUT_FILE @"-"
 
@@ -156,6 +176,7 @@ enum {
     SKNActionConvert,
     SKNActionFormat,
     SKNActionOffset,
+    SKNActionBatch,
     SKNActionAgent,
     SKNActionProtocol,
     SKNActionVersion,
@@ -168,7 +189,8 @@ enum {
     SKNFormatText,
     SKNFormatRTF,
     SKNFormatArchive,
-    SKNFormatPlist
+    SKNFormatPlist,
+    SKNFormatCompact
 };
 
 static NSInteger SKNActionForName(NSString *actionString) {
@@ -186,6 +208,8 @@ static NSInteger SKNActionForName(NSString *actionString) {
         return SKNActionOffset;
     else if ([actionString caseInsensitiveCompare:ACTION_TEST_STRING] == NSOrderedSame)
         return SKNActionTest;
+    else if ([actionString caseInsensitiveCompare:ACTION_BATCH_STRING] == NSOrderedSame)
+        return SKNActionBatch;
     else if ([actionString caseInsensitiveCompare:ACTION_AGENT_STRING] == NSOrderedSame)
         return SKNActionAgent;
     else if ([actionString caseInsensitiveCompare:ACTION_PROTOCOL_STRING] == NSOrderedSame)
@@ -203,6 +227,8 @@ static NSInteger SKNFormatForString(NSString *formatString) {
         return SKNFormatArchive;
     else if ([formatString caseInsensitiveCompare:FORMAT_PLIST_STRING] == NSOrderedSame || [formatString caseInsensitiveCompare:FORMAT_P_STRING] == NSOrderedSame)
         return SKNFormatPlist;
+    else if ([formatString caseInsensitiveCompare:FORMAT_COMPACT_STRING] == NSOrderedSame || [formatString caseInsensitiveCompare:FORMAT_C_STRING] == NSOrderedSame)
+        return SKNFormatCompact;
     else if ([formatString caseInsensitiveCompare:FORMAT_SKIM_STRING] == NSOrderedSame || [formatString caseInsensitiveCompare:FORMAT_S_STRING] == NSOrderedSame)
         return SKNFormatSkim;
     else if ([formatString caseInsensitiveCompare:FORMAT_TEXT_STRING] == NSOrderedSame || [formatString caseInsensitiveCompare:FORMAT_TXT_STRING] == NSOrderedSame || [formatString caseInsensitiveCompare:FORMAT_T_STRING] == NSOrderedSame)
@@ -225,6 +251,450 @@ static inline NSString *SKNNormalizedPath(NSString *path) {
     return path;
 }
 
+// performs a file action for one set of (normalized) file arguments, the first of which is the input file
+static BOOL SKNPerformAction(NSInteger action, NSInteger format, SKNSyncability syncable, CGFloat dx, CGFloat dy, NSArray *files, NSError **outError) {
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSString *inPath = [files objectAtIndex:0];
+    NSString *outPath = [files count] < 2 ? nil : [files objectAtIndex:1];
+    BOOL isBundle = NO;
+    BOOL isDir = NO;
+    BOOL isStdIn = NO;
+    BOOL success = NO;
+    NSError *error = nil;
+    
+    if (action == SKNActionOffset || action == SKNActionFormat) {
+        if ([inPath isEqualToString:STD_IN_OUT_FILE])
+            isStdIn = YES;
+        else if ([[inPath pathExtension] caseInsensitiveCompare:SKIM_EXTENSION] != NSOrderedSame)
+            inPath = [[inPath stringByDeletingPathExtension] stringByAppendingPathExtension:SKIM_EXTENSION];
+    } else if ([[inPath pathExtension] caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame) {
+        isBundle = YES;
+    } else if ([[inPath pathExtension] caseInsensitiveCompare:PDF_EXTENSION] != NSOrderedSame) {
+        inPath = [[inPath stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION];
+    }
+    
+    if (action != SKNActionRemove && action != SKNActionTest && outPath == nil) {
+        outPath = [inPath stringByDeletingPathExtension];
+        if (action == SKNActionConvert)
+            outPath = [outPath stringByAppendingPathExtension:isBundle ? PDF_EXTENSION : PDFD_EXTENSION];
+        else if (action == SKNActionOffset)
+            outPath = inPath;
+        else if ([outPath isEqualToString:STD_IN_OUT_FILE] == NO)
+            outPath = [outPath stringByAppendingPathExtension:format == SKNFormatText ? TXT_EXTENSION : format == SKNFormatRTF ? RTF_EXTENSION : SKIM_EXTENSION];
+    }
+    
+    if (((action != SKNActionOffset && action != SKNActionFormat) || isStdIn == NO) && ([fm fileExistsAtPath:inPath isDirectory:&isDir] == NO || isBundle != isDir)) {
+        
+        error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOENT userInfo:[NSDictionary dictionaryWithObjectsAndKeys:(action == SKNActionOffset || action == SKNActionFormat) ? @"Skim file does not exist" : isBundle ? @"PDF bundle does not exist" : @"PDF file does not exist", NSLocalizedDescriptionKey, nil]];
+        
+    } else if (action == SKNActionGet) {
+        
+        NSData *data = nil;
+        if (format == SKNFormatAuto) {
+            NSString *extension = [outPath pathExtension];
+            if ([extension caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
+                format = SKNFormatRTF;
+            else if ([extension caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [extension caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
+                format = SKNFormatText;
+            else
+                format = SKNFormatSkim;
+        }
+        if (format == SKNFormatSkim) {
+            data = [fm SkimNotesAtPath:inPath error:&error];
+        } else if (format == SKNFormatText) {
+            data = [[fm SkimTextNotesAtPath:inPath error:&error] dataUsingEncoding:NSUTF8StringEncoding];
+        } else if (format == SKNFormatRTF) {
+            data = [fm SkimRTFNotesAtPath:inPath error:&error];
+        } else if (format == SKNFormatArchive || format == SKNFormatPlist) {
+            data = [fm SkimNotesAtPath:inPath error:&error];
+            BOOL hasEncoding = NO;
+            if ([data length] > 8) {
+                char bytes[100];
+                [data getBytes:bytes range:NSMakeRange(0, format == SKNFormatPlist ? 9 : MIN(100, [data length]))];
+                if (strncmp(bytes, "bplist00", 8) != 0) {
+                    unsigned char marker = (unsigned char)bytes[8] >> 4;
+                    hasEncoding = format == SKNFormatPlist ? (marker == 0xA) : (marker == 0xD && strstr(bytes, "$archiver") != NULL);
+                }
+            }
+            if (hasEncoding == NO)
+                data = SKNDataFromSkimNotes(SKNSkimNotesFromData(data), format == SKNFormatPlist);
+        } else if (format == SKNFormatCompact) {
+            data = [fm SkimNotesAtPath:inPath error:&error];
+            if (data)
+                data = SKNCompactDataFromSkimNotes(SKNSkimNotesFromData(data));
+        }
+        if (data) {
+            if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
+                if ([data length])
+                    [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
+                success = YES;
+            } else {
+                if ([data length]) {
+                    success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
+                } else if ([fm fileExistsAtPath:outPath isDirectory:&isDir] && isDir == NO) {
+                    success = [fm removeItemAtPath:outPath error:NULL];
+                    if (success == NO)
+                        error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EACCES userInfo:[NSDictionary dictionaryWithObjectsAndKeys:@"Unable to remove file", NSLocalizedDescriptionKey, nil]];
+                } else {
+                    success = YES;
+                }
+            }
+        }
+        
+    } else if (action == SKNActionSet) {
+        
+        if (outPath && ([outPath isEqualToString:STD_IN_OUT_FILE] || ([fm fileExistsAtPath:outPath isDirectory:&isDir] && isDir == NO))) {
+            NSData *data = nil;
+            NSString *textString = nil;
+            NSData *rtfData = nil;
+            if ([outPath isEqualToString:STD_IN_OUT_FILE])
+                data = [[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
+            else
+                data = [NSData dataWithContentsOfFile:outPath];
+            if ([files count] > 2) {
+                NSString *outPath2 = [files objectAtIndex:2];
+                NSString *outPath3 = [files count] < 4 ? nil : [files objectAtIndex:3];
+                if ([[outPath2 pathExtension] caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [[outPath2 pathExtension] caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
+                    textString = [NSString stringWithContentsOfFile:outPath2 encoding:NSUTF8StringEncoding error:NULL];
+                else if ([[outPath3 pathExtension] caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [[outPath3 pathExtension] caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
+                    textString = [NSString stringWithContentsOfFile:outPath3 encoding:NSUTF8StringEncoding error:NULL];
+                if ([[outPath3 pathExtension] caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
+                    rtfData = [NSData dataWithContentsOfFile:outPath3];
+                else if ([[outPath2 pathExtension] caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
+                    rtfData = [NSData dataWithContentsOfFile:outPath2];
+            }
+            if ([data length])
+                success = [fm writeSkimNotes:data textNotes:textString RTFNotes:rtfData atPath:inPath syncable:syncable != SKNNonSyncable error:&error];
+            else if (data)
+                success = [fm removeSkimNotesAtPath:inPath error:&error];
+        } else {
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOENT userInfo:[NSDictionary dictionaryWithObjectsAndKeys:@"Notes file does not exist", NSLocalizedDescriptionKey, nil]];
+        }
+        
+    } else if (action == SKNActionRemove) {
+        
+        success = [fm removeSkimNotesAtPath:inPath error:&error];
+        
+    } else if (action == SKNActionTest) {
+        
+        success = [fm hasSkimNotesAtPath:inPath syncable:syncable];
+        
+    } else if (action == SKNActionConvert) {
+        
+        if (isBundle) {
+            NSString *pdfFilePath = nil;
+            NSArray *subpaths = [fm subpathsAtPath:inPath];
+            NSString *filename = [[[inPath lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION];
+            if ([subpaths containsObject:filename] == NO) {
+                NSUInteger idx = [[subpaths valueForKeyPath:@"pathExtension.lowercaseString"] indexOfObject:PDF_EXTENSION];
+                filename = idx == NSNotFound ? nil : [subpaths objectAtIndex:idx];
+            }
+            if (filename)
+                pdfFilePath = [inPath stringByAppendingPathComponent:filename];
+            success = [fm copyItemAtPath:pdfFilePath toPath:outPath error:NULL];
+        } else if ([[outPath pathExtension] caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame) {
+            success = [fm createDirectoryAtPath:outPath withIntermediateDirectories:NO attributes:nil error:NULL];
+            if (success) {
+                NSString *pdfFilePath = [outPath stringByAppendingPathComponent:[[[outPath lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION]];
+                success = [[NSData dataWithContentsOfFile:inPath options:0 error:&error] writeToFile:pdfFilePath options:0 error:&error];
+            }
+        } else if ([inPath isEqualToString:outPath]) {
+            success = YES;
+        } else {
+            success = [fm copyItemAtPath:inPath toPath:outPath error:NULL];
+        }
+        if (success) {
+            NSData *notesData = [fm SkimNotesAtPath:inPath error:&error];
+            NSString *textNotes = [fm SkimTextNotesAtPath:inPath error:&error];
+            NSData *rtfNotesData = [fm SkimRTFNotesAtPath:inPath error:&error];
+            if (notesData)
+                success = [fm writeSkimNotes:notesData textNotes:textNotes RTFNotes:rtfNotesData atPath:outPath syncable:syncable != SKNNonSyncable error:&error];
+        }
+        
+    } else if (action == SKNActionFormat) {
+        
+        NSData *data;
+        if (isStdIn)
+            data = [(NSFileHandle *)[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
+        else
+            data = [NSData dataWithContentsOfFile:inPath];
+        if (format == SKNFormatText) {
+            NSString *textNotes = nil;
+            SKNSkimTextAndRTFNotesFromData(data, &textNotes, NULL);
+            data = [textNotes dataUsingEncoding:NSUTF8StringEncoding];
+        } else if (format == SKNFormatRTF) {
+            NSData *rtfNotesData = nil;
+            SKNSkimTextAndRTFNotesFromData(data, NULL, &rtfNotesData);
+            data = rtfNotesData;
+        } else if (format == SKNFormatArchive || format == SKNFormatPlist) {
+            BOOL hasEncoding = NO;
+            if ([data length] > 8) {
+                char bytes[100];
+                [data getBytes:bytes range:NSMakeRange(0, format == SKNFormatPlist ? 9 : MIN(100, [data length]))];
+                if (strncmp(bytes, "bplist00", 8) != 0) {
+                    unsigned char marker = (unsigned char)bytes[8] >> 4;
+                    hasEncoding = format == SKNFormatPlist ? (marker == 0xA) : (marker == 0xD && strstr(bytes, "$archiver") != NULL);
+                }
+            }
+            if (hasEncoding == NO)
+                data = SKNDataFromSkimNotes(SKNSkimNotesFromData(data), format == SKNFormatPlist);
+        } else if (format == SKNFormatCompact) {
+            data = SKNCompactDataFromSkimNotes(SKNSkimNotesFromData(data));
+        }
+        if (data) {
+            if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
+                [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
+                success = YES;
+            } else {
+                success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
+            }
+        }
+        
+    } else if (action == SKNActionOffset) {
+        
+        NSData *data;
+        if (isStdIn)
+            data = [(NSFileHandle *)[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
+        else
+            data = [NSData dataWithContentsOfFile:inPath];
+        if (data) {
+            NSArray *inNotes = nil;
+            BOOL isPlist = NO;
+            @try { inNotes = [NSKeyedUnarchiver unarchiveObjectWithData:data]; }
+            @catch (id e) {}
+            if (inNotes == nil) {
+                inNotes = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+                isPlist = YES;
+            }
+            if ([inNotes isKindOfClass:[NSArray class]]) {
+                NSMutableArray *outNotes = [NSMutableArray array];
+                for (NSDictionary *inNote in inNotes) {
+                    if ([inNote isKindOfClass:[NSDictionary class]]) {
+                        NSMutableDictionary *outNote = [inNote mutableCopy];
+                        NSString *boundsString = [inNote objectForKey:@"bounds"];
+                        if ([boundsString isKindOfClass:[NSString class]]) {
+                            NSRect bounds = NSRectFromString(boundsString);
+                            bounds = NSOffsetRect(bounds, dx, dy);
+                            [outNote setObject:NSStringFromRect(bounds) forKey:@"bounds"];
+                        }
+                        [outNotes addObject:outNote];
+                    } else {
+                        [outNotes addObject:inNote];
+                    }
+                }
+                if (isPlist)
+                    data = [NSPropertyListSerialization dataWithPropertyList:outNotes format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
+                else
+                    data = [NSKeyedArchiver archivedDataWithRootObject:outNotes];
+                if (data) {
+                    if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
+                        [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
+                        success = YES;
+                    } else {
+                        success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
+                    }
+                }
+            }
+        }
+        
+    }
+    
+    if (success == NO && outError)
+        *outError = error;
+    
+    return success;
+}
+
+// returns the index of the first file argument, or NSNotFound when there are fewer than minFiles file arguments
+static NSUInteger SKNParseActionOptions(NSArray *args, NSUInteger offset, NSUInteger minFiles, NSInteger action, NSInteger *format, SKNSyncability *syncable, CGFloat *dx, CGFloat *dy) {
+    NSUInteger argc = [args count];
+    NSString *option = argc > offset ? [args objectAtIndex:offset] : nil;
+    
+    if (action == SKNActionGet && [option isEqualToString:FORMAT_OPTION_STRING]) {
+        if (argc < offset + 2)
+            return NSNotFound;
+        *format = SKNFormatForString([args objectAtIndex:offset + 1]);
+        offset += 2;
+    } else if ((action == SKNActionSet || action == SKNActionConvert || action == SKNActionTest) && ([option isEqualToString:SYNCABLE_OPTION_STRING] || [option isEqualToString:NONSYNCABLE_OPTION_STRING])) {
+        *syncable = [option isEqualToString:SYNCABLE_OPTION_STRING] ? SKNSyncable : SKNNonSyncable;
+        offset += 1;
+    } else if (action == SKNActionFormat) {
+        if (option == nil)
+            return NSNotFound;
+        *format = SKNFormatForString(option);
+        offset += 1;
+    } else if (action == SKNActionOffset) {
+        if (argc < offset + 2)
+            return NSNotFound;
+        *dx = [[args objectAtIndex:offset] doubleValue];
+        *dy = [[args objectAtIndex:offset + 1] doubleValue];
+        offset += 2;
+    }
+    
+    return argc < offset + minFiles ? NSNotFound : offset;
+}
+
+// each entry is an array of normalized file arguments, given as tab separated paths
+static NSArray *SKNBatchEntriesFromData(NSData *data, BOOL nulSeparated) {
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSMutableArray *entries = [NSMutableArray array];
+    const char *bytes = [data bytes];
+    NSUInteger length = [data length], start = 0, end, i;
+    char separator = nulSeparated ? '\0' : '\n';
+    
+    for (i = 0; i <= length; i++) {
+        if (i < length && bytes[i] != separator)
+            continue;
+        end = i;
+        if (nulSeparated == NO && end > start && bytes[end - 1] == '\r')
+            end--;
+        if (end > start) {
+            NSString *entry = [fm stringWithFileSystemRepresentation:bytes + start length:end - start];
+            NSMutableArray *files = [NSMutableArray array];
+            for (NSString *file in [entry componentsSeparatedByString:@"\t"]) {
+                if ([file length])
+                    [files addObject:SKNNormalizedPath(file)];
+            }
+            if ([files count])
+                [entries addObject:files];
+        }
+        start = i + 1;
+    }
+    
+    return entries;
+}
+
+static BOOL SKNPerformBatch(NSArray *args) {
+    NSUInteger argc = [args count];
+    NSUInteger offset = 2;
+    NSInteger jobs = [[NSProcessInfo processInfo] activeProcessorCount];
+    BOOL nulSeparated = NO;
+    BOOL ordered = NO;
+    
+    while (offset < argc) {
+        NSString *option = [args objectAtIndex:offset];
+        if ([option isEqualToString:JOBS_OPTION_STRING] && offset + 1 < argc) {
+            jobs = MAX(1, [[args objectAtIndex:offset + 1] integerValue]);
+            offset += 2;
+        } else if ([option isEqualToString:NUL_OPTION_STRING]) {
+            nulSeparated = YES;
+            offset += 1;
+        } else if ([option isEqualToString:ORDERED_OPTION_STRING]) {
+            ordered = YES;
+            offset += 1;
+        } else {
+            break;
+        }
+    }
+    
+    NSString *actionName = offset < argc ? [args objectAtIndex:offset++] : nil;
+    NSInteger action = SKNActionForName(actionName);
+    NSInteger format = SKNFormatAuto;
+    CGFloat dx = 0.0, dy = 0.0;
+    SKNSyncability syncable = SKNAnySyncable;
+    
+    if (action < SKNActionGet || action > SKNActionOffset)
+        offset = NSNotFound;
+    else
+        offset = SKNParseActionOptions(args, offset, 0, action, &format, &syncable, &dx, &dy);
+    if (offset == NSNotFound || offset + 1 < argc) {
+        WRITE_ERROR;
+        return NO;
+    }
+    
+    NSString *listPath = offset < argc ? SKNNormalizedPath([args objectAtIndex:offset]) : STD_IN_OUT_FILE;
+    NSData *listData = nil;
+    if ([listPath isEqualToString:STD_IN_OUT_FILE])
+        listData = [[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
+    else
+        listData = [NSData dataWithContentsOfFile:listPath];
+    if (listData == nil) {
+        fprintf(stderr, "File list does not exist\n");
+        return NO;
+    }
+    
+    NSArray *entries = SKNBatchEntriesFromData(listData, nulSeparated);
+    NSUInteger count = [entries count];
+    NSString **results = ordered ? (NSString **)NSZoneCalloc(NULL, MAX(count, 1), sizeof(NSString *)) : NULL;
+    __block NSUInteger numberOfSucceeded = 0;
+    __block NSUInteger nextResult = 0;
+    NSFileHandle *output = [NSFileHandle fileHandleWithStandardOutput];
+    char separator = nulSeparated ? '\0' : '\n';
+    NSData *terminator = [NSData dataWithBytes:&separator length:1];
+    // the semaphore bounds the number of files in flight, results are written from a serial queue
+    dispatch_semaphore_t slots = dispatch_semaphore_create(jobs);
+    dispatch_queue_t workQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+    dispatch_queue_t resultQueue = dispatch_queue_create("net.sourceforge.skim-app.skimnotes.batch", DISPATCH_QUEUE_SERIAL);
+    dispatch_group_t group = dispatch_group_create();
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    NSUInteger i;
+    
+    for (i = 0; i < count; i++) {
+        NSArray *files = [entries objectAtIndex:i];
+        dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+        dispatch_group_async(group, workQueue, ^{
+            NSAutoreleasePool *pool = [NSAutoreleasePool new];
+            NSString *file = [files objectAtIndex:0];
+            NSError *error = nil;
+            BOOL didSucceed = NO;
+            
+            if ([files containsObject:STD_IN_OUT_FILE]) {
+                error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EINVAL userInfo:[NSDictionary dictionaryWithObjectsAndKeys:@"Standard input and output cannot be used in batch mode", NSLocalizedDescriptionKey, nil]];
+            } else {
+                @try {
+                    didSucceed = SKNPerformAction(action, format, syncable, dx, dy, files, &error);
+                }
+                @catch (id e) {
+                    error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[e description], NSLocalizedDescriptionKey, nil]];
+                }
+            }
+            
+            NSString *status = action == SKNActionTest ? (didSucceed ? @"yes" : @"no") : (didSucceed ? @"ok" : @"error");
+            NSString *result;
+            if (error && didSucceed == NO)
+                result = [[NSString alloc] initWithFormat:@"%@\t%@\t%@", status, file, [error localizedDescription]];
+            else
+                result = [[NSString alloc] initWithFormat:@"%@\t%@", status, file];
+            
+            [pool release];
+            
+            dispatch_async(resultQueue, ^{
+                if (didSucceed)
+                    numberOfSucceeded++;
+                if (ordered) {
+                    results[i] = result;
+                    while (nextResult < count && results[nextResult]) {
+                        [output writeData:[results[nextResult] dataUsingEncoding:NSUTF8StringEncoding]];
+                        [output writeData:terminator];
+                        [results[nextResult] release];
+                        results[nextResult++] = nil;
+                    }
+                } else {
+                    [output writeData:[result dataUsingEncoding:NSUTF8StringEncoding]];
+                    [output writeData:terminator];
+                    [result release];
+                }
+            });
+            
+            dispatch_semaphore_signal(slots);
+        });
+    }
+    
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_sync(resultQueue, ^{});
+    
+    NSTimeInterval duration = [NSDate timeIntervalSinceReferenceDate] - startTime;
+    fprintf(stderr, "skimnotes batch %s: %lu files, %lu %s, %lu %s in %.3f s (%.1f files/s, %ld jobs)\n", [[actionName lowercaseString] UTF8String], (unsigned long)count, (unsigned long)numberOfSucceeded, action == SKNActionTest ? "with notes" : "succeeded", (unsigned long)(count - numberOfSucceeded), action == SKNActionTest ? "without notes" : "failed", duration, duration > 0.0 ? count / duration : 0.0, (long)jobs);
+    
+    dispatch_release(group);
+    dispatch_release(resultQueue);
+    dispatch_release(slots);
+    if (results)
+        NSZoneFree(NULL, results);
+    
+    return numberOfSucceeded == count;
+}
+
 int main (int argc, const char * argv[]) {
     NSAutoreleasePool *pool = [NSAutoreleasePool new];
  
@@ -297,6 +767,9 @@ int main (int argc, const char * argv[]) {
             case SKNActionOffset:
                 WRITE_OUT(offsetHelpStr);
                 break;
+            case SKNActionBatch:
+                WRITE_OUT(batchHelpStr);
+                break;
             case SKNActionAgent:
                 WRITE_OUT(agentHelpStr);
                 break;
@@ -316,288 +789,30 @@ int main (int argc, const char * argv[]) {
         
         WRITE_OUT(versionStr);
         
-    } else {
+    } else if (action == SKNActionBatch) {
         
-        if (argc < 3) {
-            WRITE_ERROR;
-            [pool release];
-            exit(EXIT_FAILURE);
-        }
+        success = SKNPerformBatch(args);
+        
+    } else {
         
         NSInteger format = SKNFormatAuto;
         CGFloat dx = 0.0, dy = 0.0;
         SKNSyncability syncable = SKNAnySyncable;
-        int offset = 2;
+        NSUInteger offset = SKNParseActionOptions(args, 2, 1, action, &format, &syncable, &dx, &dy);
         
-        if (action == SKNActionGet && [[args objectAtIndex:2] isEqualToString:FORMAT_OPTION_STRING]) {
-            if (argc < 5) {
-                WRITE_ERROR;
-                [pool release];
-                exit(EXIT_FAILURE);
-            }
-            offset = 4;
-            format = SKNFormatForString([args objectAtIndex:3]);
-        } else if ((action == SKNActionSet || action == SKNActionConvert || action == SKNActionTest) && ([[args objectAtIndex:2] isEqualToString:SYNCABLE_OPTION_STRING] || [[args objectAtIndex:2] isEqualToString:NONSYNCABLE_OPTION_STRING])) {
-            if (argc < 4) {
-                WRITE_ERROR;
-                [pool release];
-                exit(EXIT_FAILURE);
-            }
-            syncable = [[args objectAtIndex:2] isEqualToString:SYNCABLE_OPTION_STRING] ? SKNSyncable : SKNNonSyncable;
-            offset = 3;
-        } else if (action == SKNActionFormat) {
-            if (argc < 4) {
-                WRITE_ERROR;
-                [pool release];
-                exit(EXIT_FAILURE);
-            }
-            offset = 3;
-            format = SKNFormatForString([args objectAtIndex:2]);
-        } else if (action == SKNActionOffset) {
-            if (argc < 5) {
-                WRITE_ERROR;
-                [pool release];
-                exit(EXIT_FAILURE);
-            }
-            offset = 4;
-            dx = [[args objectAtIndex:2] doubleValue];
-            dy = [[args objectAtIndex:3] doubleValue];
+        if (offset == NSNotFound) {
+            WRITE_ERROR;
+            [pool release];
+            exit(EXIT_FAILURE);
         }
         
-        NSFileManager *fm = [NSFileManager defaultManager];
-        NSString *inPath = SKNNormalizedPath([args objectAtIndex:offset]);
-        NSString *outPath = argc < offset + 2 ? nil : SKNNormalizedPath([args objectAtIndex:offset + 1]);
-        BOOL isBundle = NO;
-        BOOL isDir = NO;
-        BOOL isStdIn = NO;
+        NSMutableArray *files = [NSMutableArray array];
         NSError *error = nil;
         
-        if (action == SKNActionOffset || action == SKNActionFormat) {
-            if ([inPath isEqualToString:STD_IN_OUT_FILE])
-                isStdIn = YES;
-            else if ([[inPath pathExtension] caseInsensitiveCompare:SKIM_EXTENSION] != NSOrderedSame)
-                inPath = [[inPath stringByDeletingPathExtension] stringByAppendingPathExtension:SKIM_EXTENSION];
-        } else if ([[inPath pathExtension] caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame) {
-            isBundle = YES;
-        } else if ([[inPath pathExtension] caseInsensitiveCompare:PDF_EXTENSION] != NSOrderedSame) {
-            inPath = [[inPath stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION];
-        }
-        
-        if (action != SKNActionRemove && action != SKNActionTest && outPath == nil) {
-            outPath = [inPath stringByDeletingPathExtension];
-            if (action == SKNActionConvert)
-                outPath = [outPath stringByAppendingPathExtension:isBundle ? PDF_EXTENSION : PDFD_EXTENSION];
-            else if (action == SKNActionOffset)
-                outPath = inPath;
-            else if ([outPath isEqualToString:STD_IN_OUT_FILE] == NO)
-                outPath = [outPath stringByAppendingPathExtension:format == SKNFormatText ? TXT_EXTENSION : format == SKNFormatRTF ? RTF_EXTENSION : SKIM_EXTENSION];
-        }
+        for (NSString *file in [args subarrayWithRange:NSMakeRange(offset, [args count] - offset)])
+            [files addObject:SKNNormalizedPath(file)];
         
-        if (((action != SKNActionOffset && action != SKNActionFormat) || isStdIn == NO) && ([fm fileExistsAtPath:inPath isDirectory:&isDir] == NO || isBundle != isDir)) {
-            
-            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOENT userInfo:[NSDictionary dictionaryWithObjectsAndKeys:(action == SKNActionOffset || action == SKNActionFormat) ? @"Skim file does not exist" : isBundle ? @"PDF bundle does not exist" : @"PDF file does not exist", NSLocalizedDescriptionKey, nil]];
-            
-        } else if (action == SKNActionGet) {
-            
-            NSData *data = nil;
-            if (format == SKNFormatAuto) {
-                NSString *extension = [outPath pathExtension];
-                if ([extension caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
-                    format = SKNFormatRTF;
-                else if ([extension caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [extension caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
-                    format = SKNFormatText;
-                else
-                    format = SKNFormatSkim;
-            }
-            if (format == SKNFormatSkim) {
-                data = [fm SkimNotesAtPath:inPath error:&error];
-            } else if (format == SKNFormatText) {
-                data = [[fm SkimTextNotesAtPath:inPath error:&error] dataUsingEncoding:NSUTF8StringEncoding];
-            } else if (format == SKNFormatRTF) {
-                data = [fm SkimRTFNotesAtPath:inPath error:&error];
-            } else if (format == SKNFormatArchive || format == SKNFormatPlist) {
-                data = [fm SkimNotesAtPath:inPath error:&error];
-                BOOL hasEncoding = NO;
-                if ([data length] > 8) {
-                    char bytes[100];
-                    [data getBytes:bytes range:NSMakeRange(0, format == SKNFormatPlist ? 9 : MIN(100, [data length]))];
-                    if (strncmp(bytes, "bplist00", 8) != 0) {
-                        unsigned char marker = (unsigned char)bytes[8] >> 4;
-                        hasEncoding = format == SKNFormatPlist ? (marker == 0xA) : (marker == 0xD && strstr(bytes, "$archiver") != NULL);
-                    }
-                }
-                if (hasEncoding == NO)
-                    data = SKNDataFromSkimNotes(SKNSkimNotesFromData(data), format == SKNFormatPlist);
-            }
-            if (data) {
-                if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
-                    if ([data length])
-                        [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
-                    success = YES;
-                } else {
-                    if ([data length]) {
-                        success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
-                    } else if ([fm fileExistsAtPath:outPath isDirectory:&isDir] && isDir == NO) {
-                        success = [fm removeItemAtPath:outPath error:NULL];
-                        if (success == NO)
-                            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:EACCES userInfo:[NSDictionary dictionaryWithObjectsAndKeys:@"Unable to remove file", NSLocalizedDescriptionKey, nil]];
-                    } else {
-                        success = YES;
-                    }
-                }
-            }
-            
-        } else if (action == SKNActionSet) {
-            
-            if (outPath && ([outPath isEqualToString:STD_IN_OUT_FILE] || ([fm fileExistsAtPath:outPath isDirectory:&isDir] && isDir == NO))) {
-                NSData *data = nil;
-                NSString *textString = nil;
-                NSData *rtfData = nil;
-                if ([outPath isEqualToString:STD_IN_OUT_FILE])
-                    data = [[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
-                else
-                    data = [NSData dataWithContentsOfFile:outPath];
-                if (argc > offset + 2) {
-                    NSString *outPath2 = SKNNormalizedPath([args objectAtIndex:offset + 2]);
-                    NSString *outPath3 = argc < offset + 4 ? nil : SKNNormalizedPath([args objectAtIndex:offset + 3]);
-                    if ([[outPath2 pathExtension] caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [[outPath2 pathExtension] caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
-                        textString = [NSString stringWithContentsOfFile:outPath2 encoding:NSUTF8StringEncoding error:NULL];
-                    else if ([[outPath3 pathExtension] caseInsensitiveCompare:TXT_EXTENSION] == NSOrderedSame || [[outPath3 pathExtension] caseInsensitiveCompare:TEXT_EXTENSION] == NSOrderedSame)
-                        textString = [NSString stringWithContentsOfFile:outPath3 encoding:NSUTF8StringEncoding error:NULL];
-                    if ([[outPath3 pathExtension] caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
-                        rtfData = [NSData dataWithContentsOfFile:outPath3];
-                    else if ([[outPath2 pathExtension] caseInsensitiveCompare:RTF_EXTENSION] == NSOrderedSame)
-                        rtfData = [NSData dataWithContentsOfFile:outPath2];
-                }
-                if ([data length])
-                    success = [fm writeSkimNotes:data textNotes:textString RTFNotes:rtfData atPath:inPath syncable:syncable != SKNNonSyncable error:&error];
-                else if (data)
-                    success = [fm removeSkimNotesAtPath:inPath error:&error];
-            } else {
-                error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENOENT userInfo:[NSDictionary dictionaryWithObjectsAndKeys:@"Notes file does not exist", NSLocalizedDescriptionKey, nil]];
-            }
-            
-        } else if (action == SKNActionRemove) {
-            
-            success = [fm removeSkimNotesAtPath:inPath error:&error];
-            
-        } else if (action == SKNActionTest) {
-            
-            success = [fm hasSkimNotesAtPath:inPath syncable:syncable];
-            
-        } else if (action == SKNActionConvert) {
-            
-            if (isBundle) {
-                NSString *pdfFilePath = nil;
-                NSArray *files = [fm subpathsAtPath:inPath];
-                NSString *filename = [[[inPath lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION];
-                if ([files containsObject:filename] == NO) {
-                    NSUInteger idx = [[files valueForKeyPath:@"pathExtension.lowercaseString"] indexOfObject:PDF_EXTENSION];
-                    filename = idx == NSNotFound ? nil : [files objectAtIndex:idx];
-                }
-                if (filename)
-                    pdfFilePath = [inPath stringByAppendingPathComponent:filename];
-                success = [fm copyItemAtPath:pdfFilePath toPath:outPath error:NULL];
-            } else if ([[outPath pathExtension] caseInsensitiveCompare:PDFD_EXTENSION] == NSOrderedSame) {
-                success = [fm createDirectoryAtPath:outPath withIntermediateDirectories:NO attributes:nil error:NULL];
-                if (success) {
-                    NSString *pdfFilePath = [outPath stringByAppendingPathComponent:[[[outPath lastPathComponent] stringByDeletingPathExtension] stringByAppendingPathExtension:PDF_EXTENSION]];
-                    success = [[NSData dataWithContentsOfFile:inPath options:0 error:&error] writeToFile:pdfFilePath options:0 error:&error];
-                }
-            } else if ([inPath isEqualToString:outPath]) {
-                success = YES;
-            } else {
-                success = [fm copyItemAtPath:inPath toPath:outPath error:NULL];
-            }
-            if (success) {
-                NSData *notesData = [fm SkimNotesAtPath:inPath error:&error];
-                NSString *textNotes = [fm SkimTextNotesAtPath:inPath error:&error];
-                NSData *rtfNotesData = [fm SkimRTFNotesAtPath:inPath error:&error];
-                if (notesData)
-                    success = [fm writeSkimNotes:notesData textNotes:textNotes RTFNotes:rtfNotesData atPath:outPath syncable:syncable != SKNNonSyncable error:&error];
-            }
-            
-        } else if (action == SKNActionFormat) {
-            
-            NSData *data;
-            if (isStdIn)
-                data = [(NSFileHandle *)[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
-            else
-                data = [NSData dataWithContentsOfFile:inPath];
-            if (format == SKNFormatText) {
-                data = [SKNSkimTextNotes(SKNSkimNotesFromData(data)) dataUsingEncoding:NSUTF8StringEncoding];
-            } else if (format == SKNFormatRTF) {
-                data = SKNSkimRTFNotes(SKNSkimNotesFromData(data));
-            } else if (format == SKNFormatArchive || format == SKNFormatPlist) {
-                BOOL hasEncoding = NO;
-                if ([data length] > 8) {
-                    char bytes[100];
-                    [data getBytes:bytes range:NSMakeRange(0, format == SKNFormatPlist ? 9 : MIN(100, [data length]))];
-                    if (strncmp(bytes, "bplist00", 8) != 0) {
-                        unsigned char marker = (unsigned char)bytes[8] >> 4;
-                        hasEncoding = format == SKNFormatPlist ? (marker == 0xA) : (marker == 0xD && strstr(bytes, "$archiver") != NULL);
-                    }
-                }
-                if (hasEncoding == NO)
-                    data = SKNDataFromSkimNotes(SKNSkimNotesFromData(data), format == SKNFormatPlist);
-            }
-            if (data) {
-                if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
-                    [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
-                    success = YES;
-                } else {
-                    success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
-                }
-            }
-            
-        } else if (action == SKNActionOffset) {
-            
-            NSData *data;
-            if (isStdIn)
-                data = [(NSFileHandle *)[NSFileHandle fileHandleWithStandardInput] readDataToEndOfFile];
-            else
-                data = [NSData dataWithContentsOfFile:inPath];
-            if (data) {
-                NSArray *inNotes = nil;
-                BOOL isPlist = NO;
-                @try { inNotes = [NSKeyedUnarchiver unarchiveObjectWithData:data]; }
-                @catch (id e) {}
-                if (inNotes == nil) {
-                    inNotes = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
-                    isPlist = YES;
-                }
-                if ([inNotes isKindOfClass:[NSArray class]]) {
-                    NSMutableArray *outNotes = [NSMutableArray array];
-                    for (NSDictionary *inNote in inNotes) {
-                        if ([inNote isKindOfClass:[NSDictionary class]]) {
-                            NSMutableDictionary *outNote = [inNote mutableCopy];
-                            NSString *boundsString = [inNote objectForKey:@"bounds"];
-                            if ([boundsString isKindOfClass:[NSString class]]) {
-                                NSRect bounds = NSRectFromString(boundsString);
-                                bounds = NSOffsetRect(bounds, dx, dy);
-                                [outNote setObject:NSStringFromRect(bounds) forKey:@"bounds"];
-                            }
-                            [outNotes addObject:outNote];
-                        } else {
-                            [outNotes addObject:inNote];
-                        }
-                    }
-                    if (isPlist)
-                        data = [NSPropertyListSerialization dataWithPropertyList:outNotes format:NSPropertyListBinaryFormat_v1_0 options:0 error:NULL];
-                    else
-                        data = [NSKeyedArchiver archivedDataWithRootObject:outNotes];
-                    if (data) {
-                        if ([outPath isEqualToString:STD_IN_OUT_FILE]) {
-                            [(NSFileHandle *)[NSFileHandle fileHandleWithStandardOutput] writeData:data];
-                            success = YES;
-                        } else {
-                            success = [data writeToFile:outPath options:NSAtomicWrite error:&error];
-                        }
-                    }
-                }
-            }
-            
-        }
+        success = SKNPerformAction(action, format, syncable, dx, dy, files, &error);
         
         if (success == NO && error)
             [(NSFileHandle *)[NSFileHandle fileHandleWithStandardError] writeData:[[[error localizedDescription] stringByAppendingString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding]];
@@ -0,0 +1,248 @@
+//
+//  SKPDFSyncParserTest.c
+//  Skim
+//
+//  Created by agent on 10/17/26.
+/*
+ This software is Copyright (c) 2026
+ Christiaan Hofman. All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+ - Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.
+
+ - Neither the name of Christiaan Hofman nor the names of any
+    contributors may be used to endorse or promote products derived
+    from this software without specific prior written permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks SKPDFSyncParser against small pdfsync files with known records, and against a generated
+// file with the given number of line/point record pairs, default 1000000, reporting the throughput.
+// Usage: SKPDFSyncParserTest [NUMBER_OF_RECORDS]
+
+#include "SKPDFSyncParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_RECORDS 16
+
+typedef struct {
+    SKPDFSyncParserRecord records[MAX_RECORDS];
+    char files[MAX_RECORDS][64];
+    int count;
+    int stopAfter;
+} SKCollector;
+
+typedef struct {
+    long counts[5];
+    long recordIndexSum;
+    long lineSum;
+    long pageSum;
+    double xSum;
+    double ySum;
+} SKSums;
+
+static int failures = 0;
+
+#define CHECK(condition, ...) do { if ((condition) == false) { fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); failures++; } } while (0)
+
+static bool collect(const SKPDFSyncParserRecord *record, void *context) {
+    SKCollector *collector = context;
+    if (collector->count < MAX_RECORDS) {
+        collector->records[collector->count] = *record;
+        if (record->file) {
+            size_t length = record->fileLength < 63 ? record->fileLength : 63;
+            memcpy(collector->files[collector->count], record->file, length);
+            collector->files[collector->count][length] = '\0';
+        }
+    }
+    collector->count++;
+    return collector->stopAfter == 0 || collector->count < collector->stopAfter;
+}
+
+static bool sum(const SKPDFSyncParserRecord *record, void *context) {
+    SKSums *sums = context;
+    sums->counts[record->type]++;
+    if (record->type == SKPDFSyncRecordTypeLine) {
+        sums->recordIndexSum += record->recordIndex;
+        sums->lineSum += record->line;
+    } else if (record->type == SKPDFSyncRecordTypePage) {
+        sums->pageSum += record->line;
+    } else if (record->type == SKPDFSyncRecordTypePoint) {
+        sums->recordIndexSum += record->recordIndex;
+        sums->xSum += record->x;
+        sums->ySum += record->y;
+    }
+    return true;
+}
+
+static bool parse(const char *string, SKCollector *collector, int stopAfter) {
+    memset(collector, 0, sizeof(SKCollector));
+    collector->stopAfter = stopAfter;
+    return SKPDFSyncParseBytes(string, strlen(string), collect, collector);
+}
+
+static void testRecords(void) {
+    SKCollector c;
+
+    CHECK(parse("main.tex\nversion 1\nl 1 10 3\np 1 100 200\ns 2\n(chapter.tex\np* 2 1.5 -2.25\np+ 3 +4 7\n)\n", &c, 0), "parsing all record types");
+    CHECK(c.count == 8, "number of records %d", c.count);
+    CHECK(c.records[0].type == SKPDFSyncRecordTypeOpenFile && strcmp(c.files[0], "main.tex") == 0, "main file %s", c.files[0]);
+    CHECK(c.records[1].type == SKPDFSyncRecordTypeLine && c.records[1].recordIndex == 1 && c.records[1].line == 10, "line record");
+    CHECK(c.records[2].type == SKPDFSyncRecordTypePoint && c.records[2].recordIndex == 1 && c.records[2].x == 100.0 && c.records[2].y == 200.0, "point record");
+    CHECK(c.records[3].type == SKPDFSyncRecordTypePage && c.records[3].line == 2, "page record");
+    CHECK(c.records[4].type == SKPDFSyncRecordTypeOpenFile && strcmp(c.files[4], "chapter.tex") == 0, "input file %s", c.files[4]);
+    CHECK(c.records[5].type == SKPDFSyncRecordTypePoint && c.records[5].recordIndex == 2 && c.records[5].x == 1.5 && c.records[5].y == -2.25, "point* record %g %g", c.records[5].x, c.records[5].y);
+    CHECK(c.records[6].type == SKPDFSyncRecordTypePoint && c.records[6].recordIndex == 3 && c.records[6].x == 4.0 && c.records[6].y == 7.0, "point+ record");
+    CHECK(c.records[7].type == SKPDFSyncRecordTypeCloseFile, "close record");
+
+    // NSScanner accepts exponents, and stops before an exponent without digits, so the last record has no y
+    CHECK(parse("main.tex\nversion 1\np 0 1 -2.25e3\np 1 5E-2 .5e+1\np 2 3e 4\n", &c, 0) && c.count == 3, "parsing exponents, got %d", c.count);
+    CHECK(c.records[1].x == 1.0 && c.records[1].y == -2250.0, "exponent %g", c.records[1].y);
+    CHECK(c.records[2].x == 0.05 && c.records[2].y == 5.0, "negative and positive exponents %g %g", c.records[2].x, c.records[2].y);
+
+    CHECK(parse("main.tex\nversion 1\np 0 123456789012345678901234 0.000000000000000000001\n", &c, 0) && c.count == 2, "parsing long numbers");
+    CHECK(fabs(c.records[1].x / 123456789012345678901234.0 - 1.0) < 1e-15, "long integer part %.17g", c.records[1].x);
+    CHECK(fabs(c.records[1].y / 1e-21 - 1.0) < 1e-15, "long fraction %.17g", c.records[1].y);
+
+    CHECK(parse("  main.tex\r\n  VERSION 1\r\n\r\n  l 5 6\r\n\ts\n", &c, 0) && c.count == 3, "parsing spaces, CRLF and case");
+    CHECK(c.records[1].type == SKPDFSyncRecordTypeLine && c.records[1].recordIndex == 5 && c.records[1].line == 6, "line without column");
+    CHECK(c.records[2].type == SKPDFSyncRecordTypePage && c.records[2].line == SKPDFSyncNoPageNumber, "page without number");
+
+    CHECK(parse("main.tex\nversion 1\nl x 1\np 1 2\nq 1 2 3\nl 1 99999999999999999999999\n", &c, 0) && c.count == 2, "skipping bad records, got %d", c.count);
+    CHECK(c.records[1].line == LONG_MAX, "saturated integer %ld", c.records[1].line);
+
+    CHECK(parse("main.tex\nl 1 2\n", &c, 0) == false, "missing version");
+    CHECK(parse("main.tex", &c, 0) == false, "missing second line");
+    CHECK(parse("", &c, 0) == false, "empty file");
+
+    CHECK(parse("main.tex\nversion 1\nl 1 2\nl 2 3\nl 3 4\n", &c, 2) == false && c.count == 2, "stopping from the callback");
+
+    // truncated anywhere, the parser should never read beyond the end
+    const char *full = "main.tex\nversion 1\nl 12 34 5\np* 12 -1.5e2 3.25\ns 7\n(sub.tex\n)\n";
+    size_t i, length = strlen(full);
+    for (i = 0; i <= length; i++) {
+        char *bytes = malloc(i ? i : 1);
+        memcpy(bytes, full, i);
+        SKPDFSyncParseBytes(bytes, i, collect, &c);
+        free(bytes);
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void testGeneratedFile(long numberOfRecords) {
+    char path[] = "/tmp/SKPDFSyncParserTest.XXXXXX";
+    int fd = mkstemp(path);
+    FILE *file = fd < 0 ? NULL : fdopen(fd, "w");
+    SKSums expected, sums;
+    long i, page = 0;
+
+    if (file == NULL) {
+        CHECK(false, "creating %s", path);
+        return;
+    }
+
+    memset(&expected, 0, sizeof(SKSums));
+    memset(&sums, 0, sizeof(SKSums));
+    srand(11);
+
+    fprintf(file, "main\nversion 1\n");
+    expected.counts[SKPDFSyncRecordTypeOpenFile]++;
+    for (i = 0; i < numberOfRecords; i++) {
+        if (i % 2000 == 0) {
+            fprintf(file, "s %ld\n", ++page);
+            expected.counts[SKPDFSyncRecordTypePage]++;
+            expected.pageSum += page;
+        }
+        if (i % 50000 == 0) {
+            fprintf(file, "(chapter%ld.tex\n", i / 50000);
+            expected.counts[SKPDFSyncRecordTypeOpenFile]++;
+        }
+        long line = rand() % 5000, x = rand() % 40000000, y = rand() % 50000000;
+        fprintf(file, "l %ld %ld %d\n", i, line, rand() % 80);
+        expected.counts[SKPDFSyncRecordTypeLine]++;
+        expected.lineSum += line;
+        switch (rand() % 3) {
+            case 0:
+                fprintf(file, "p %ld %ld %ld\n", i, x, y);
+                expected.xSum += x;
+                expected.ySum += y;
+                break;
+            case 1:
+                fprintf(file, "p* %ld %ld.5 %ld\n", i, x, y);
+                expected.xSum += x + 0.5;
+                expected.ySum += y;
+                break;
+            default:
+                fprintf(file, "p+ %ld %ld %ld.25\n", i, x, y);
+                expected.xSum += x;
+                expected.ySum += y + 0.25;
+                break;
+        }
+        expected.counts[SKPDFSyncRecordTypePoint]++;
+        expected.recordIndexSum += 2 * i;
+        if (i % 50000 == 49999) {
+            fprintf(file, ")\n");
+            expected.counts[SKPDFSyncRecordTypeCloseFile]++;
+        }
+    }
+    long size = ftell(file);
+    fclose(file);
+
+    double start = now();
+    bool success = SKPDFSyncParseFile(path, sum, &sums);
+    double duration = now() - start;
+    unlink(path);
+
+    CHECK(success, "parsing the generated file");
+    for (i = 0; i < 5; i++)
+        CHECK(sums.counts[i] == expected.counts[i], "number of records of type %ld: %ld, expected %ld", i, sums.counts[i], expected.counts[i]);
+    CHECK(sums.recordIndexSum == expected.recordIndexSum, "record indexes");
+    CHECK(sums.lineSum == expected.lineSum, "lines");
+    CHECK(sums.pageSum == expected.pageSum, "pages");
+    CHECK(sums.xSum == expected.xSum && sums.ySum == expected.ySum, "points %.2f %.2f, expected %.2f %.2f", sums.xSum, sums.ySum, expected.xSum, expected.ySum);
+
+    long records = 0;
+    for (i = 0; i < 5; i++)
+        records += sums.counts[i];
+    printf("parsed %ld records, %.1f MB, in %.3f s: %.1f MB/s, %.2f M records/s\n", records, size / 1e6, duration, size / 1e6 / duration, records / 1e6 / duration);
+}
+
+int main(int argc, const char *argv[]) {
+    long numberOfRecords = argc > 1 ? atol(argv[1]) : 1000000;
+
+    testRecords();
+    testGeneratedFile(numberOfRecords);
+
+    printf("%d failures\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+#
+# Builds and runs the tests of the plain C parts of Skim, which also build on Linux.
+# Usage: Tests/run_tests.sh [NUMBER_OF_RECORDS]
+# Set CC and CFLAGS to use another compiler or sanitizers, e.g. CFLAGS="-g -fsanitize=address,undefined".
+
+set -e
+
+TESTS_DIR=$(cd "$(dirname "$0")" && pwd)
+SOURCE_DIR=$(dirname "$TESTS_DIR")
+BUILD_DIR=${BUILD_DIR:-$(mktemp -d)}
+
+: ${CC:=cc}
+: ${CFLAGS:=-O2}
+
+$CC $CFLAGS -std=c99 -D_DEFAULT_SOURCE -D_DARWIN_C_SOURCE -Wall -I"$SOURCE_DIR" -o "$BUILD_DIR/SKPDFSyncParserTest" "$TESTS_DIR/SKPDFSyncParserTest.c" "$SOURCE_DIR/SKPDFSyncParser.c" -lm
+"$BUILD_DIR/SKPDFSyncParserTest" "$@"
@@ -17,12 +17,17 @@
 
 #include "AppKitPrevention.h"
 
-static BOOL applyBinaryDeltaToFile(xar_t x, xar_file_t file, NSString *sourceFilePath, NSString *destinationFilePath)
+static void reportPatchProgress(void *context, double progress)
+{
+    void (^progressBlock)(double) = (__bridge void (^)(double))context;
+    progressBlock(progress);
+}
+
+static BOOL applyBinaryDeltaToFile(xar_t x, xar_file_t file, NSString *sourceFilePath, NSString *destinationFilePath, void (^progressBlock)(double progress))
 {
     NSString *patchFile = temporaryFilename(@"apply-binary-delta");
     xar_extract_tofile(x, file, [patchFile fileSystemRepresentation]);
-    const char *argv[] = { "/usr/bin/bspatch", [sourceFilePath fileSystemRepresentation], [destinationFilePath fileSystemRepresentation], [patchFile fileSystemRepresentation] };
-    BOOL success = (bspatch(4, argv) == 0);
+    BOOL success = (bspatch_file([sourceFilePath fileSystemRepresentation], [destinationFilePath fileSystemRepresentation], [patchFile fileSystemRepresentation], reportPatchProgress, (__bridge void *)progressBlock) == 0);
     unlink([patchFile fileSystemRepresentation]);
     return success;
 }
@@ -177,7 +182,27 @@ BOOL applyBinaryDelta(NSString *source, NSString *destination, NSString *patchFi
     NSFileManager *fileManager = [[NSFileManager alloc] init];
     xar_file_t file;
     xar_iter_t iter = xar_iter_new();
+
+    // Patching goes from 4/6 to 5/6, split evenly between the files in the delta
+    NSUInteger fileCount = 0;
     for (file = xar_file_first(x, iter); file; file = xar_file_next(iter)) {
+        fileCount++;
+    }
+    xar_iter_free(iter);
+    iter = xar_iter_new();
+
+    __block NSUInteger fileIndex = 0;
+    __block double lastPatchProgress = 4/6.0;
+    void (^patchProgressCallback)(double) = ^(double fileProgress) {
+        double progress = (4 + ((double)fileIndex + fileProgress) / (double)fileCount) / 6.0;
+        // Large files report progress often, don't pass every step on
+        if (progress - lastPatchProgress >= 0.001) {
+            lastPatchProgress = progress;
+            progressCallback(progress);
+        }
+    };
+
+    for (file = xar_file_first(x, iter); file; file = xar_file_next(iter), fileIndex++) {
         NSString *path = @(xar_get_path(file));
         NSString *sourceFilePath = [source stringByAppendingPathComponent:path];
         NSString *destinationFilePath = [destination stringByAppendingPathComponent:path];
@@ -208,7 +233,7 @@ BOOL applyBinaryDelta(NSString *source, NSString *destination, NSString *patchFi
         }
 
         if (!xar_prop_get(file, BINARY_DELTA_KEY, &value)) {
-            if (!applyBinaryDeltaToFile(x, file, sourceFilePath, destinationFilePath)) {
+            if (!applyBinaryDeltaToFile(x, file, sourceFilePath, destinationFilePath, patchProgressCallback)) {
                 if (verbose) {
                     fprintf(stderr, "\n");
                 }
@@ -21,9 +21,11 @@
 #include <sys/xattr.h>
 #include <xar/xar.h>
 
+#include "bsdiff.h"
+
 #include "AppKitPrevention.h"
 
-extern int bsdiff(int argc, const char **argv);
+#define MAX_CONCURRENT_DELTA_OPERATIONS 4
 
 @interface CreateBinaryDeltaOperation : NSOperation
 @property (copy) NSString *relativePath;
@@ -32,6 +34,7 @@ extern int bsdiff(int argc, const char **argv);
 @property (strong) NSNumber *permissions;
 @property (strong) NSString *_fromPath;
 @property (strong) NSString *_toPath;
+@property (assign) int numberOfThreads;
 - (id)initWithRelativePath:(NSString *)relativePath oldTree:(NSString *)oldTree newTree:(NSString *)newTree oldPermissions:(NSNumber *)oldPermissions newPermissions:(NSNumber *)permissions;
 @end
 
@@ -42,6 +45,7 @@ extern int bsdiff(int argc, const char **argv);
 @synthesize permissions = _permissions;
 @synthesize _fromPath = _fromPath;
 @synthesize _toPath = _toPath;
+@synthesize numberOfThreads = _numberOfThreads;
 
 - (id)initWithRelativePath:(NSString *)relativePath oldTree:(NSString *)oldTree newTree:(NSString *)newTree oldPermissions:(NSNumber *)oldPermissions newPermissions:(NSNumber *)permissions
 {
@@ -51,6 +55,7 @@ extern int bsdiff(int argc, const char **argv);
         self.permissions = permissions;
         self._fromPath = [oldTree stringByAppendingPathComponent:relativePath];
         self._toPath = [newTree stringByAppendingPathComponent:relativePath];
+        self.numberOfThreads = 1;
     }
     return self;
 }
@@ -58,10 +63,20 @@ extern int bsdiff(int argc, const char **argv);
 - (void)main
 {
     NSString *temporaryFile = temporaryFilename(@"BinaryDelta");
-    const char *argv[] = { "/usr/bin/bsdiff", [self._fromPath fileSystemRepresentation], [self._toPath fileSystemRepresentation], [temporaryFile fileSystemRepresentation] };
-    int result = bsdiff(4, argv);
-    if (!result)
-        self.resultPath = temporaryFile;
+    NSData *fromData = [NSData dataWithContentsOfFile:self._fromPath options:NSDataReadingMappedIfSafe error:NULL];
+    NSData *toData = [NSData dataWithContentsOfFile:self._toPath options:NSDataReadingMappedIfSafe error:NULL];
+    if (fromData == nil || toData == nil)
+        return;
+
+    // Large files are matched on several threads; small ones get a single chunk anyway
+    u_char *patch = NULL;
+    off_t patchSize = 0;
+    int result = bsdiff_buffer(fromData.bytes, (off_t)fromData.length, toData.bytes, (off_t)toData.length, self.numberOfThreads, &patch, &patchSize);
+    if (!result) {
+        NSData *patchData = [NSData dataWithBytesNoCopy:patch length:(NSUInteger)patchSize freeWhenDone:YES];
+        if ([patchData writeToFile:temporaryFile atomically:NO])
+            self.resultPath = temporaryFile;
+    }
 }
 
 @end
@@ -476,7 +491,12 @@ BOOL createBinaryDelta(NSString *source, NSString *destination, NSString *patchF
     xar_subdoc_prop_set(attributes, beforeHashKey, [beforeHash UTF8String]);
     xar_subdoc_prop_set(attributes, afterHashKey, [afterHash UTF8String]);
 
+    // Each delta holds both files, the suffix array of the old one and the patch in memory, and matches on
+    // several threads, so only run a few at a time and share the processors between them
+    NSUInteger processorCount = MAX([[NSProcessInfo processInfo] activeProcessorCount], (NSUInteger)1);
+    NSUInteger concurrentDeltaCount = MIN(processorCount, (NSUInteger)MAX_CONCURRENT_DELTA_OPERATIONS);
     NSOperationQueue *deltaQueue = [[NSOperationQueue alloc] init];
+    deltaQueue.maxConcurrentOperationCount = (NSInteger)concurrentDeltaCount;
     NSMutableArray *deltaOperations = [NSMutableArray array];
 
     // Sort the keys by preferring the ones from the original tree to appear first
@@ -547,6 +567,7 @@ BOOL createBinaryDelta(NSString *source, NSString *destination, NSString *patchF
                 newInfo[INFO_PERMISSIONS_KEY] :
                 nil;
             CreateBinaryDeltaOperation *operation = [[CreateBinaryDeltaOperation alloc] initWithRelativePath:key oldTree:source newTree:destination oldPermissions:originalInfo[INFO_PERMISSIONS_KEY] newPermissions:permissions];
+            operation.numberOfThreads = (int)(processorCount / concurrentDeltaCount);
             [deltaQueue addOperation:operation];
             [deltaOperations addObject:operation];
         }
@@ -13,6 +13,12 @@
 #import "SUBinaryDeltaApply.h"
 #import <sys/stat.h>
 #include <sys/xattr.h>
+#include <sys/resource.h>
+#include "bsdiff.h"
+#include "bspatch.h"
+#include "sais.h"
+#include "bscodecs.h"
+#include "bskernels.h"
 
 @interface SUBinaryDeltaTest : XCTestCase
 
@@ -334,6 +340,337 @@ typedef void (^SUDeltaHandler)(NSFileManager *fileManager, NSString *sourceDirec
     }];
 }
 
+// Copies runs of up to 64KB of data, with a few bytes changed, dropped or inserted between them
+- (NSData *)editedDataFromData:(NSData *)data
+{
+    NSMutableData *result = [NSMutableData dataWithCapacity:data.length + data.length / 4096];
+    const uint8_t *bytes = data.bytes;
+    NSUInteger index = 0;
+    
+    while (index < data.length) {
+        NSUInteger length = MIN(data.length - index, (NSUInteger)arc4random_uniform(65536));
+        [result appendBytes:bytes + index length:length];
+        index += length;
+        
+        uint8_t edit[16];
+        arc4random_buf(edit, sizeof(edit));
+        [result appendBytes:edit length:arc4random_uniform(sizeof(edit))];
+        index += arc4random_uniform(sizeof(edit));
+    }
+    
+    return result;
+}
+
+- (BOOL)applyPatch:(NSData *)patchData toFile:(NSString *)sourceFile equals:(NSData *)expectedData
+{
+    NSString *patchFile = temporaryFilename(@"Sparkle_bsdiff_patch");
+    NSString *destinationFile = temporaryFilename(@"Sparkle_bsdiff_new");
+    
+    XCTAssertTrue([patchData writeToFile:patchFile atomically:NO]);
+    
+    const char *argv[] = { "/usr/bin/bspatch", [sourceFile fileSystemRepresentation], [destinationFile fileSystemRepresentation], [patchFile fileSystemRepresentation] };
+    BOOL success = (bspatch(4, argv) == 0) && [[NSData dataWithContentsOfFile:destinationFile] isEqualToData:expectedData];
+    
+    [[NSFileManager defaultManager] removeItemAtPath:patchFile error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:destinationFile error:nil];
+    
+    return success;
+}
+
+- (void)testParallelBinaryDiff
+{
+    // Large enough to be split into 4 chunks
+    NSMutableData *sourceData = [NSMutableData dataWithLength:20 << 20];
+    arc4random_buf(sourceData.mutableBytes, sourceData.length);
+    NSData *destinationData = [self editedDataFromData:sourceData];
+    
+    NSString *sourceFile = temporaryFilename(@"Sparkle_bsdiff_old");
+    XCTAssertTrue([sourceData writeToFile:sourceFile atomically:NO]);
+    
+    for (int threadCount = 1; threadCount <= 4; threadCount *= 2) {
+        u_char *patch = NULL;
+        off_t patchSize = 0;
+        XCTAssertEqual(bsdiff_buffer(sourceData.bytes, (off_t)sourceData.length, destinationData.bytes, (off_t)destinationData.length, threadCount, &patch, &patchSize), 0);
+        
+        NSData *patchData = [NSData dataWithBytesNoCopy:patch length:(NSUInteger)patchSize freeWhenDone:YES];
+        XCTAssertTrue([self applyPatch:patchData toFile:sourceFile equals:destinationData]);
+        
+        u_char *emptyPatch = NULL;
+        off_t emptyPatchSize = 0;
+        XCTAssertEqual(bsdiff_buffer(sourceData.bytes, (off_t)sourceData.length, NULL, 0, threadCount, &emptyPatch, &emptyPatchSize), 0);
+        XCTAssertEqual(emptyPatchSize, 32);
+        free(emptyPatch);
+    }
+    
+    XCTAssertTrue([[NSFileManager defaultManager] removeItemAtPath:sourceFile error:nil]);
+}
+
+static void recordPatchProgress(void *context, double progress)
+{
+    [(__bridge NSMutableArray *)context addObject:@(progress)];
+}
+
+- (void)testPatchProgress
+{
+    // Several times the size of bspatch's buffers
+    NSMutableData *sourceData = [NSMutableData dataWithLength:6 << 20];
+    arc4random_buf(sourceData.mutableBytes, sourceData.length);
+    NSData *destinationData = [self editedDataFromData:sourceData];
+    
+    u_char *patch = NULL;
+    off_t patchSize = 0;
+    XCTAssertEqual(bsdiff_buffer(sourceData.bytes, (off_t)sourceData.length, destinationData.bytes, (off_t)destinationData.length, 1, &patch, &patchSize), 0);
+    NSData *patchData = [NSData dataWithBytesNoCopy:patch length:(NSUInteger)patchSize freeWhenDone:YES];
+    
+    NSString *sourceFile = temporaryFilename(@"Sparkle_bsdiff_old");
+    NSString *destinationFile = temporaryFilename(@"Sparkle_bsdiff_new");
+    NSString *patchFile = temporaryFilename(@"Sparkle_bsdiff_patch");
+    XCTAssertTrue([sourceData writeToFile:sourceFile atomically:NO]);
+    XCTAssertTrue([patchData writeToFile:patchFile atomically:NO]);
+    
+    NSMutableArray *progressValues = [NSMutableArray array];
+    XCTAssertEqual(bspatch_file([sourceFile fileSystemRepresentation], [destinationFile fileSystemRepresentation], [patchFile fileSystemRepresentation], recordPatchProgress, (__bridge void *)progressValues), 0);
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:destinationFile], destinationData);
+    
+    XCTAssertGreaterThan(progressValues.count, 1u);
+    XCTAssertEqualObjects(progressValues.lastObject, @1.0);
+    double lastProgress = 0;
+    for (NSNumber *progress in progressValues) {
+        XCTAssertGreaterThanOrEqual(progress.doubleValue, lastProgress);
+        lastProgress = progress.doubleValue;
+    }
+    
+    // A patch missing the end of its extra section fails without leaving a partial file behind
+    XCTAssertTrue([[NSFileManager defaultManager] removeItemAtPath:destinationFile error:nil]);
+    XCTAssertTrue([[patchData subdataWithRange:NSMakeRange(0, patchData.length - 1)] writeToFile:patchFile atomically:NO]);
+    XCTAssertNotEqual(bspatch_file([sourceFile fileSystemRepresentation], [destinationFile fileSystemRepresentation], [patchFile fileSystemRepresentation], NULL, NULL), 0);
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:destinationFile]);
+    
+    [[NSFileManager defaultManager] removeItemAtPath:sourceFile error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:patchFile error:nil];
+}
+
+- (void)testCompressedPatchCodecs
+{
+    // Several times the size of bspatch's decoding buffers
+    NSMutableData *sourceData = [NSMutableData dataWithLength:6 << 20];
+    arc4random_buf(sourceData.mutableBytes, sourceData.length);
+    NSData *destinationData = [self editedDataFromData:sourceData];
+    
+    u_char *patch = NULL;
+    off_t patchSize = 0;
+    XCTAssertEqual(bsdiff_buffer(sourceData.bytes, (off_t)sourceData.length, destinationData.bytes, (off_t)destinationData.length, 1, &patch, &patchSize), 0);
+    
+    NSString *sourceFile = temporaryFilename(@"Sparkle_bsdiff_old");
+    XCTAssertTrue([sourceData writeToFile:sourceFile atomically:NO]);
+    
+    // Every available codec for all three blocks, then each block raw in turn
+    for (int codec = 0; codec < BSCODEC_COUNT + 3; codec++) {
+        int codecs[3] = { codec, codec, codec };
+        if (codec >= BSCODEC_COUNT) {
+            codecs[0] = codecs[1] = codecs[2] = BSCODEC_BZIP2;
+            codecs[codec - BSCODEC_COUNT] = BSCODEC_RAW;
+        }
+        
+        u_char *compressedPatch = NULL;
+        off_t compressedPatchSize = 0;
+        if (!bscodec_available(codecs[1])) {
+            XCTAssertNotEqual(bsdiff_compress(patch, patchSize, codecs, &compressedPatch, &compressedPatchSize), 0);
+            continue;
+        }
+        XCTAssertEqual(bsdiff_compress(patch, patchSize, codecs, &compressedPatch, &compressedPatchSize), 0, @"codec %d", codec);
+        NSData *compressedPatchData = [NSData dataWithBytesNoCopy:compressedPatch length:(NSUInteger)compressedPatchSize freeWhenDone:YES];
+        XCTAssertTrue([self applyPatch:compressedPatchData toFile:sourceFile equals:destinationData], @"codec %d", codec);
+        
+        // Codecs this patch format doesn't know are rejected
+        NSMutableData *unknownCodecData = [compressedPatchData mutableCopy];
+        ((u_char *)unknownCodecData.mutableBytes)[33] = BSCODEC_COUNT;
+        XCTAssertFalse([self applyPatch:unknownCodecData toFile:sourceFile equals:destinationData]);
+    }
+    
+    free(patch);
+    XCTAssertTrue([[NSFileManager defaultManager] removeItemAtPath:sourceFile error:nil]);
+}
+
+// Compares the single-threaded and parallel paths on real files, set SPARKLE_BSDIFF_BENCHMARK_OLD and SPARKLE_BSDIFF_BENCHMARK_NEW to run it
+- (void)testParallelBinaryDiffBenchmark
+{
+    NSDictionary *environment = [[NSProcessInfo processInfo] environment];
+    NSString *sourceFile = environment[@"SPARKLE_BSDIFF_BENCHMARK_OLD"];
+    NSString *destinationFile = environment[@"SPARKLE_BSDIFF_BENCHMARK_NEW"];
+    if (sourceFile == nil || destinationFile == nil) {
+        return;
+    }
+    
+    NSData *sourceData = [NSData dataWithContentsOfFile:sourceFile options:NSDataReadingMappedIfSafe error:NULL];
+    NSData *destinationData = [NSData dataWithContentsOfFile:destinationFile options:NSDataReadingMappedIfSafe error:NULL];
+    XCTAssertNotNil(sourceData);
+    XCTAssertNotNil(destinationData);
+    
+    for (int threadCount = 1; threadCount >= 0; threadCount--) {
+        u_char *patch = NULL;
+        off_t patchSize = 0;
+        NSDate *startDate = [NSDate date];
+        XCTAssertEqual(bsdiff_buffer(sourceData.bytes, (off_t)sourceData.length, destinationData.bytes, (off_t)destinationData.length, threadCount, &patch, &patchSize), 0);
+        NSTimeInterval duration = -[startDate timeIntervalSinceNow];
+        
+        NSData *patchData = [NSData dataWithBytesNoCopy:patch length:(NSUInteger)patchSize freeWhenDone:YES];
+        NSLog(@"bsdiff %@: %.2f s, patch size %llu bytes", threadCount == 1 ? @"single-threaded" : @"parallel", duration, (unsigned long long)patchSize);
+        XCTAssertTrue([self applyPatch:patchData toFile:sourceFile equals:destinationData]);
+    }
+}
+
+- (void)testSuffixSort
+{
+    // Repetitive enough to recurse, and large enough to take the parallel path when SAIS_MAXTHREADS allows it
+    NSMutableData *data = [NSMutableData dataWithLength:4 << 20];
+    arc4random_buf(data.mutableBytes, 64 << 10);
+    for (NSUInteger offset = 64 << 10; offset < data.length; offset += 64 << 10) {
+        u_char *bytes = (u_char *)data.mutableBytes + offset;
+        memcpy(bytes, data.bytes, 64 << 10);
+        bytes[arc4random_uniform(64 << 10)] ^= 0xff;
+    }
+    
+    int32_t n = (int32_t)data.length;
+    NSMutableData *sortData32 = [NSMutableData dataWithLength:(NSUInteger)n * sizeof(int32_t)];
+    NSMutableData *sortData64 = [NSMutableData dataWithLength:(NSUInteger)n * sizeof(off_t)];
+    int32_t *sort32 = sortData32.mutableBytes;
+    off_t *sort64 = sortData64.mutableBytes;
+    XCTAssertEqual(sais32(data.bytes, sort32, n, 4), 0);
+    XCTAssertEqual(sais64(data.bytes, sort64, n, 4), 0);
+    
+    const u_char *bytes = data.bytes;
+    for (int32_t i = 0; i < n; i++) {
+        if (sort32[i] != sort64[i]) {
+            XCTFail(@"Suffix sorts differ at %d", i);
+            break;
+        }
+        if (i > 0 && i % 1024 == 0) {
+            int32_t a = sort32[i - 1], b = sort32[i];
+            int result = memcmp(bytes + a, bytes + b, (size_t)MIN(n - a, n - b));
+            if (result > 0 || (result == 0 && a < b)) {
+                XCTFail(@"Suffixes out of order at %d", i);
+                break;
+            }
+        }
+    }
+}
+
+// Times the suffix sorts on a real file, set SPARKLE_SAIS_BENCHMARK_FILE to run it
+- (void)testSuffixSortBenchmark
+{
+    NSString *file = [[NSProcessInfo processInfo] environment][@"SPARKLE_SAIS_BENCHMARK_FILE"];
+    if (file == nil) {
+        return;
+    }
+    
+    NSData *data = [NSData dataWithContentsOfFile:file options:NSDataReadingMappedIfSafe error:NULL];
+    XCTAssertNotNil(data);
+    
+    int threadCount = (int)[[NSProcessInfo processInfo] activeProcessorCount];
+    
+    // The 32-bit sort goes first, as the peak resident size only grows
+    for (int bits = 32; bits <= 64; bits += 32) {
+        if (bits == 32 && data.length >= INT32_MAX) {
+            continue;
+        }
+        size_t indexSize = (bits == 32) ? sizeof(int32_t) : sizeof(off_t);
+        void *sort = malloc(data.length * indexSize);
+        XCTAssertTrue(sort != NULL);
+        
+        NSDate *startDate = [NSDate date];
+        if (bits == 32) {
+            XCTAssertEqual(sais32(data.bytes, sort, (int32_t)data.length, threadCount), 0);
+        } else {
+            XCTAssertEqual(sais64(data.bytes, sort, (off_t)data.length, threadCount), 0);
+        }
+        NSTimeInterval duration = -[startDate timeIntervalSinceNow];
+        free(sort);
+        
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        NSLog(@"sais %d-bit on %d threads: %.2f s for %llu bytes, peak resident size %ld MB", bits, threadCount, duration, (unsigned long long)data.length, usage.ru_maxrss >> 20);
+    }
+}
+
+- (void)testByteKernels
+{
+    const bskernels_t * const *kernels = bskernels_all();
+    const bskernels_t *scalar = kernels[0];
+    
+    // Varying match densities, lengths and alignments
+    u_char a[2048], b[2048], c[2048], dst1[2048], dst2[2048];
+    for (int iteration = 0; iteration < 2000; iteration++) {
+        uint32_t density = arc4random_uniform(101);
+        arc4random_buf(a, sizeof(a));
+        arc4random_buf(b, sizeof(b));
+        arc4random_buf(c, sizeof(c));
+        
+        off_t n = arc4random_uniform(1024);
+        off_t offset = arc4random_uniform(64);
+        u_char *pa = a + offset, *pb = b + 64 + arc4random_uniform(64), *pc = c + offset;
+        memcpy(pb, pa, (size_t)n);
+        for (off_t i = 0; i < n; i++) {
+            if (arc4random_uniform(100) >= density) {
+                pb[i] ^= 1;
+            }
+        }
+        
+        for (int k = 1; kernels[k] != NULL; k++) {
+            const bskernels_t *K = kernels[k];
+            XCTAssertEqual(K->matchlen(pa, pb, n), scalar->matchlen(pa, pb, n), @"%s", K->name);
+            XCTAssertEqual(K->count_equal(pa, pb, n), scalar->count_equal(pa, pb, n), @"%s", K->name);
+            XCTAssertEqual(K->extend_forward(pa, pb, n), scalar->extend_forward(pa, pb, n), @"%s", K->name);
+            XCTAssertEqual(K->extend_backward(pa + n, pb + n, n), scalar->extend_backward(pa + n, pb + n, n), @"%s", K->name);
+            XCTAssertEqual(K->split(pb, pa, pc, pa, n), scalar->split(pb, pa, pc, pa, n), @"%s", K->name);
+            
+            K->sub(dst1, pb, pa, n);
+            scalar->sub(dst2, pb, pa, n);
+            XCTAssertEqual(memcmp(dst1, dst2, (size_t)n), 0, @"%s", K->name);
+            K->add(dst1, pa, n);
+            scalar->add(dst2, pa, n);
+            XCTAssertEqual(memcmp(dst1, dst2, (size_t)n), 0, @"%s", K->name);
+        }
+    }
+}
+
+// Times each of the byte kernels, set SPARKLE_BSDIFF_KERNEL_BENCHMARK to run it
+- (void)testByteKernelsBenchmark
+{
+    if ([[NSProcessInfo processInfo] environment][@"SPARKLE_BSDIFF_KERNEL_BENCHMARK"] == nil) {
+        return;
+    }
+    
+    // 90% of the bytes match, about what the extensions see in practice
+    const off_t size = 64 << 20;
+    NSMutableData *aData = [NSMutableData dataWithLength:(NSUInteger)size];
+    NSMutableData *bData = [NSMutableData dataWithLength:(NSUInteger)size];
+    u_char *a = aData.mutableBytes, *b = bData.mutableBytes;
+    arc4random_buf(a, (size_t)size);
+    for (off_t i = 0; i < size; i++) {
+        b[i] = (arc4random_uniform(10) == 0) ? (u_char)arc4random() : a[i];
+    }
+    
+    const bskernels_t * const *kernels = bskernels_all();
+    for (int k = 0; kernels[k] != NULL; k++) {
+        const bskernels_t *K = kernels[k];
+        NSDate *startDate = [NSDate date];
+        volatile off_t sink = K->count_equal(a, b, size);
+        NSTimeInterval countDuration = -[startDate timeIntervalSinceNow];
+        
+        startDate = [NSDate date];
+        sink = K->extend_forward(a, b, size);
+        NSTimeInterval extendDuration = -[startDate timeIntervalSinceNow];
+        
+        startDate = [NSDate date];
+        K->add(b, a, size);
+        NSTimeInterval addDuration = -[startDate timeIntervalSinceNow];
+        (void)sink;
+        
+        NSLog(@"%s: count_equal %.0f MB/s, extend_forward %.0f MB/s, add %.0f MB/s", K->name, (size >> 20) / countDuration, (size >> 20) / extendDuration, (size >> 20) / addDuration);
+    }
+}
+
 - (void)testRegularFileAdded
 {
     [self createAndApplyPatchWithHandler:^(NSFileManager *__unused fileManager, NSString *sourceDirectory, NSString *destinationDirectory) {
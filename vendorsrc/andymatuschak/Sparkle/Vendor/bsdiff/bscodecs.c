@@ -0,0 +1,533 @@
+/*
+ *  bscodecs.c
+ *  Sparkle
+ */
+
+#include "bscodecs.h"
+#include <bzlib.h>
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <compression.h>
+#define BS_LZMA_COMPRESSION 1
+#define BS_COMPRESSION_API __attribute__((availability(macos, introduced=10.11)))
+#elif BS_HAVE_LZMA
+#include <lzma.h>
+#define BS_LZMA_LIBLZMA 1
+#endif
+
+#if BS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define MIN(x, y) (((x)<(y)) ? (x) : (y))
+
+#ifndef BS_BZIP2_LEVEL
+#define BS_BZIP2_LEVEL 9
+#endif
+
+#ifndef BS_LZMA_PRESET /* liblzma only, the Compression framework has a fixed level */
+#define BS_LZMA_PRESET 6
+#endif
+
+#ifndef BS_ZSTD_LEVEL
+#define BS_ZSTD_LEVEL 19
+#endif
+
+#ifndef BS_ZSTD_WINDOWLOG /* how far back long distance matches reach, which bounds the decoder's memory */
+#define BS_ZSTD_WINDOWLOG 27
+#endif
+
+/* Most bytes handed to bzip2 at once, as it counts them in 'unsigned int' */
+#define BZIP2_STEP ((size_t)1 << 30)
+
+static const char *codec_names[BSCODEC_COUNT] = {
+    "raw",
+    "bzip2",
+    "lzma",
+    "zstd"
+};
+
+const char *bscodec_name(int codec)
+{
+    return (codec >= 0 && codec < BSCODEC_COUNT) ? codec_names[codec] : NULL;
+}
+
+int bscodec_named(const char *name)
+{
+    int codec;
+
+    for (codec = 0; codec < BSCODEC_COUNT; codec++) {
+        if (strcmp(name, codec_names[codec]) == 0)
+            return codec;
+    }
+
+    return -1;
+}
+
+int bscodec_available(int codec)
+{
+    switch (codec) {
+        case BSCODEC_RAW:
+        case BSCODEC_BZIP2:
+            return 1;
+        case BSCODEC_LZMA:
+#if BS_LZMA_COMPRESSION
+            if (__builtin_available(macOS 10.11, *))
+                return 1;
+            return 0;
+#elif BS_LZMA_LIBLZMA
+            return 1;
+#else
+            return 0;
+#endif
+        case BSCODEC_ZSTD:
+#if BS_HAVE_ZSTD
+            return 1;
+#else
+            return 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/* The output of an encoder, grown as it is written */
+typedef struct
+{
+    u_char *buf;
+    size_t len, size;
+} outbuf_t;
+
+/* outbuf_reserve(o, n)
+ *
+ * Makes room for at least 'n' more bytes in 'o'. Returns 0 on success, -1 if
+ * out of memory. */
+static int outbuf_reserve(outbuf_t *o, size_t n)
+{
+    size_t size;
+    u_char *buf;
+
+    if (o->size - o->len >= n)
+        return 0;
+
+    size = o->size * 2;
+    if (size < o->len + n)
+        size = o->len + n;
+    if ((buf = realloc(o->buf, size)) == NULL) {
+        warn("Failed to allocate memory for compressed block");
+        return -1;
+    }
+    o->buf = buf;
+    o->size = size;
+
+    return 0;
+}
+
+static int bzip2_compress(const u_char *in, size_t inlen, outbuf_t *o)
+{
+    bz_stream bz;
+    unsigned int avail;
+    size_t n;
+    int bzerr, action;
+
+    memset(&bz, 0, sizeof(bz));
+    if ((bzerr = BZ2_bzCompressInit(&bz, BS_BZIP2_LEVEL, 0, 0)) != BZ_OK) {
+        warnx("BZ2_bzCompressInit, bz2err = %d", bzerr);
+        return -1;
+    }
+
+    do {
+        if (bz.avail_in == 0 && inlen > 0) {
+            n = MIN(inlen, BZIP2_STEP);
+            bz.next_in = (char *)(uintptr_t)in;
+            bz.avail_in = (unsigned int)n;
+            in += n;
+            inlen -= n;
+        }
+        action = (inlen == 0) ? BZ_FINISH : BZ_RUN;
+        if (outbuf_reserve(o, 64 << 10) != 0) {
+            bzerr = BZ_MEM_ERROR;
+            break;
+        }
+        bz.next_out = (char *)o->buf + o->len;
+        bz.avail_out = avail = (unsigned int)MIN(o->size - o->len, BZIP2_STEP);
+        bzerr = BZ2_bzCompress(&bz, action);
+        o->len += avail - bz.avail_out;
+    } while (bzerr == BZ_RUN_OK || bzerr == BZ_FINISH_OK);
+
+    BZ2_bzCompressEnd(&bz);
+    if (bzerr != BZ_STREAM_END) {
+        warnx("BZ2_bzCompress, bz2err = %d", bzerr);
+        return -1;
+    }
+
+    return 0;
+}
+
+#if BS_LZMA_COMPRESSION
+
+BS_COMPRESSION_API static int lzma_compress(const u_char *in, size_t inlen, outbuf_t *o)
+{
+    compression_stream s;
+    compression_status status;
+
+    if (compression_stream_init(&s, COMPRESSION_STREAM_ENCODE, COMPRESSION_LZMA) != COMPRESSION_STATUS_OK) {
+        warnx("compression_stream_init");
+        return -1;
+    }
+
+    s.src_ptr = in;
+    s.src_size = inlen;
+    do {
+        if (outbuf_reserve(o, 64 << 10) != 0) {
+            status = COMPRESSION_STATUS_ERROR;
+            break;
+        }
+        s.dst_ptr = o->buf + o->len;
+        s.dst_size = o->size - o->len;
+        status = compression_stream_process(&s, COMPRESSION_STREAM_FINALIZE);
+        o->len = (size_t)(s.dst_ptr - o->buf);
+    } while (status == COMPRESSION_STATUS_OK);
+
+    compression_stream_destroy(&s);
+    if (status != COMPRESSION_STATUS_END) {
+        warnx("compression_stream_process");
+        return -1;
+    }
+
+    return 0;
+}
+
+#elif BS_LZMA_LIBLZMA
+
+static int lzma_compress(const u_char *in, size_t inlen, outbuf_t *o)
+{
+    lzma_stream s = LZMA_STREAM_INIT;
+    lzma_ret ret;
+
+    if ((ret = lzma_easy_encoder(&s, BS_LZMA_PRESET, LZMA_CHECK_CRC64)) != LZMA_OK) {
+        warnx("lzma_easy_encoder, ret = %d", ret);
+        return -1;
+    }
+
+    s.next_in = in;
+    s.avail_in = inlen;
+    do {
+        if (outbuf_reserve(o, 64 << 10) != 0) {
+            ret = LZMA_MEM_ERROR;
+            break;
+        }
+        s.next_out = o->buf + o->len;
+        s.avail_out = o->size - o->len;
+        ret = lzma_code(&s, LZMA_FINISH);
+        o->len = (size_t)(s.next_out - o->buf);
+    } while (ret == LZMA_OK);
+
+    lzma_end(&s);
+    if (ret != LZMA_STREAM_END) {
+        warnx("lzma_code, ret = %d", ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
+
+#if BS_HAVE_ZSTD
+
+static int zstd_compress(const u_char *in, size_t inlen, outbuf_t *o)
+{
+    ZSTD_CCtx *cctx;
+    size_t ret;
+
+    if ((cctx = ZSTD_createCCtx()) == NULL) {
+        warnx("ZSTD_createCCtx");
+        return -1;
+    }
+
+    /* The diff block repeats itself across the whole file, which only long
+     * distance matching over a wide window finds */
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, BS_ZSTD_LEVEL);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, BS_ZSTD_WINDOWLOG);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, 1);
+
+    ret = (size_t)-1;
+    if (outbuf_reserve(o, ZSTD_compressBound(inlen)) == 0) {
+        ret = ZSTD_compress2(cctx, o->buf + o->len, o->size - o->len, in, inlen);
+        if (ZSTD_isError(ret))
+            warnx("ZSTD_compress2: %s", ZSTD_getErrorName(ret));
+        else
+            o->len += ret;
+    }
+
+    ZSTD_freeCCtx(cctx);
+    return ZSTD_isError(ret) ? -1 : 0;
+}
+
+#endif
+
+int bscodec_compress(int codec, const u_char *in, off_t inlen, u_char **out, off_t *outlen)
+{
+    outbuf_t o = { NULL, 0, 0 };
+    int result = -1;
+
+    if (!bscodec_available(codec)) {
+        warnx("Codec %d is not available", codec);
+        return -1;
+    }
+
+    /* Compressed blocks are rarely smaller than a tenth of their input */
+    if (outbuf_reserve(&o, (size_t)inlen / 8 + 1) != 0)
+        return -1;
+
+    switch (codec) {
+        case BSCODEC_RAW:
+            if (outbuf_reserve(&o, (size_t)inlen) == 0) {
+                memcpy(o.buf, in, (size_t)inlen);
+                o.len = (size_t)inlen;
+                result = 0;
+            }
+            break;
+        case BSCODEC_BZIP2:
+            result = bzip2_compress(in, (size_t)inlen, &o);
+            break;
+#if BS_LZMA_COMPRESSION
+        case BSCODEC_LZMA:
+            if (__builtin_available(macOS 10.11, *))
+                result = lzma_compress(in, (size_t)inlen, &o);
+            break;
+#elif BS_LZMA_LIBLZMA
+        case BSCODEC_LZMA:
+            result = lzma_compress(in, (size_t)inlen, &o);
+            break;
+#endif
+#if BS_HAVE_ZSTD
+        case BSCODEC_ZSTD:
+            result = zstd_compress(in, (size_t)inlen, &o);
+            break;
+#endif
+    }
+
+    if (result != 0) {
+        free(o.buf);
+        return -1;
+    }
+
+    *out = o.buf;
+    *outlen = (off_t)o.len;
+    return 0;
+}
+
+struct bsdecoder
+{
+    int codec;
+    union {
+        bz_stream bz;
+#if BS_LZMA_COMPRESSION
+        compression_stream cs;
+#elif BS_LZMA_LIBLZMA
+        lzma_stream lzma;
+#endif
+#if BS_HAVE_ZSTD
+        ZSTD_DStream *zstd;
+#endif
+    } u;
+};
+
+#if BS_LZMA_COMPRESSION
+
+BS_COMPRESSION_API static int lzma_decoder_init(bsdecoder_t *d)
+{
+    return (compression_stream_init(&d->u.cs, COMPRESSION_STREAM_DECODE, COMPRESSION_LZMA) == COMPRESSION_STATUS_OK) ? 0 : -1;
+}
+
+BS_COMPRESSION_API static int lzma_decode(bsdecoder_t *d, const u_char **in, size_t *inlen, u_char **out, size_t *outlen)
+{
+    compression_status status;
+
+    d->u.cs.src_ptr = *in;
+    d->u.cs.src_size = *inlen;
+    d->u.cs.dst_ptr = *out;
+    d->u.cs.dst_size = *outlen;
+    status = compression_stream_process(&d->u.cs, 0);
+    *in = d->u.cs.src_ptr;
+    *inlen = d->u.cs.src_size;
+    *out = d->u.cs.dst_ptr;
+    *outlen = d->u.cs.dst_size;
+
+    return (status == COMPRESSION_STATUS_END) ? 1 : (status == COMPRESSION_STATUS_OK) ? 0 : -1;
+}
+
+BS_COMPRESSION_API static void lzma_decoder_end(bsdecoder_t *d)
+{
+    compression_stream_destroy(&d->u.cs);
+}
+
+#elif BS_LZMA_LIBLZMA
+
+static int lzma_decoder_init(bsdecoder_t *d)
+{
+    lzma_stream init = LZMA_STREAM_INIT;
+
+    d->u.lzma = init;
+    return (lzma_stream_decoder(&d->u.lzma, UINT64_MAX, 0) == LZMA_OK) ? 0 : -1;
+}
+
+static int lzma_decode(bsdecoder_t *d, const u_char **in, size_t *inlen, u_char **out, size_t *outlen)
+{
+    lzma_ret ret;
+
+    d->u.lzma.next_in = *in;
+    d->u.lzma.avail_in = *inlen;
+    d->u.lzma.next_out = *out;
+    d->u.lzma.avail_out = *outlen;
+    ret = lzma_code(&d->u.lzma, LZMA_RUN);
+    *in = d->u.lzma.next_in;
+    *inlen = d->u.lzma.avail_in;
+    *out = d->u.lzma.next_out;
+    *outlen = d->u.lzma.avail_out;
+
+    /* LZMA_BUF_ERROR only means no progress could be made */
+    return (ret == LZMA_STREAM_END) ? 1 : (ret == LZMA_OK || ret == LZMA_BUF_ERROR) ? 0 : -1;
+}
+
+static void lzma_decoder_end(bsdecoder_t *d)
+{
+    lzma_end(&d->u.lzma);
+}
+
+#endif
+
+bsdecoder_t *bsdecoder_create(int codec)
+{
+    bsdecoder_t *d;
+    int result = -1;
+
+    if (!bscodec_available(codec))
+        return NULL;
+    if ((d = calloc(1, sizeof(bsdecoder_t))) == NULL)
+        return NULL;
+    d->codec = codec;
+
+    switch (codec) {
+        case BSCODEC_RAW:
+            result = 0;
+            break;
+        case BSCODEC_BZIP2:
+            result = (BZ2_bzDecompressInit(&d->u.bz, 0, 0) == BZ_OK) ? 0 : -1;
+            break;
+#if BS_LZMA_COMPRESSION
+        case BSCODEC_LZMA:
+            if (__builtin_available(macOS 10.11, *))
+                result = lzma_decoder_init(d);
+            break;
+#elif BS_LZMA_LIBLZMA
+        case BSCODEC_LZMA:
+            result = lzma_decoder_init(d);
+            break;
+#endif
+#if BS_HAVE_ZSTD
+        case BSCODEC_ZSTD:
+            if ((d->u.zstd = ZSTD_createDStream()) != NULL) {
+                ZSTD_DCtx_setParameter(d->u.zstd, ZSTD_d_windowLogMax, BS_ZSTD_WINDOWLOG);
+                result = 0;
+            }
+            break;
+#endif
+    }
+
+    if (result != 0) {
+        warnx("Failed to create %s decoder", bscodec_name(codec));
+        free(d);
+        return NULL;
+    }
+
+    return d;
+}
+
+int bsdecoder_decode(bsdecoder_t *d, const u_char **in, size_t *inlen, u_char **out, size_t *outlen)
+{
+    size_t n;
+    int bzerr;
+
+    switch (d->codec) {
+        case BSCODEC_RAW:
+            n = MIN(*inlen, *outlen);
+            memcpy(*out, *in, n);
+            *in += n;
+            *inlen -= n;
+            *out += n;
+            *outlen -= n;
+            return 0;
+        case BSCODEC_BZIP2:
+            d->u.bz.next_in = (char *)(uintptr_t)*in;
+            d->u.bz.avail_in = (unsigned int)MIN(*inlen, BZIP2_STEP);
+            d->u.bz.next_out = (char *)*out;
+            d->u.bz.avail_out = (unsigned int)MIN(*outlen, BZIP2_STEP);
+            bzerr = BZ2_bzDecompress(&d->u.bz);
+            n = (size_t)((const u_char *)d->u.bz.next_in - *in);
+            *in += n;
+            *inlen -= n;
+            n = (size_t)((u_char *)d->u.bz.next_out - *out);
+            *out += n;
+            *outlen -= n;
+            return (bzerr == BZ_STREAM_END) ? 1 : (bzerr == BZ_OK) ? 0 : -1;
+#if BS_LZMA_COMPRESSION
+        case BSCODEC_LZMA:
+            if (__builtin_available(macOS 10.11, *))
+                return lzma_decode(d, in, inlen, out, outlen);
+            return -1;
+#elif BS_LZMA_LIBLZMA
+        case BSCODEC_LZMA:
+            return lzma_decode(d, in, inlen, out, outlen);
+#endif
+#if BS_HAVE_ZSTD
+        case BSCODEC_ZSTD: {
+            ZSTD_inBuffer input = { *in, *inlen, 0 };
+            ZSTD_outBuffer output = { *out, *outlen, 0 };
+            size_t ret = ZSTD_decompressStream(d->u.zstd, &output, &input);
+            *in += input.pos;
+            *inlen -= input.pos;
+            *out += output.pos;
+            *outlen -= output.pos;
+            return ZSTD_isError(ret) ? -1 : (ret == 0) ? 1 : 0;
+        }
+#endif
+        default:
+            return -1;
+    }
+}
+
+void bsdecoder_destroy(bsdecoder_t *d)
+{
+    if (d == NULL)
+        return;
+
+    switch (d->codec) {
+        case BSCODEC_BZIP2:
+            BZ2_bzDecompressEnd(&d->u.bz);
+            break;
+#if BS_LZMA_COMPRESSION
+        case BSCODEC_LZMA:
+            if (__builtin_available(macOS 10.11, *))
+                lzma_decoder_end(d);
+            break;
+#elif BS_LZMA_LIBLZMA
+        case BSCODEC_LZMA:
+            lzma_decoder_end(d);
+            break;
+#endif
+#if BS_HAVE_ZSTD
+        case BSCODEC_ZSTD:
+            ZSTD_freeDStream(d->u.zstd);
+            break;
+#endif
+    }
+
+    free(d);
+}
@@ -0,0 +1,56 @@
+/*
+ *  bscodecs.h
+ *  Sparkle
+ */
+
+#ifndef BS_CODECS_H
+#define BS_CODECS_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+/* The codecs the blocks of a BSDIFC40 patch can be compressed with. The values
+ * are stored in patches and must not change. */
+typedef enum
+{
+    BSCODEC_RAW = 0,
+    BSCODEC_BZIP2 = 1,
+    BSCODEC_LZMA = 2,   /* xz container */
+    BSCODEC_ZSTD = 3,   /* with long distance matching */
+    BSCODEC_COUNT
+} bscodec_t;
+
+/* Returns the name of 'codec', or NULL if it is not one. */
+const char *bscodec_name(int codec);
+
+/* Returns the codec called 'name', or -1 if there is none. */
+int bscodec_named(const char *name);
+
+/* Returns whether 'codec' can be used in this build and on this system. Raw and
+ * bzip2 always can; lzma needs the Compression framework on macOS or liblzma
+ * (BS_HAVE_LZMA) elsewhere, and zstd needs libzstd (BS_HAVE_ZSTD). */
+int bscodec_available(int codec);
+
+/* bscodec_compress(codec, in, inlen, out, outlen)
+ *
+ * Compresses the 'inlen' bytes of 'in' with 'codec'. On success, returns 0 and
+ * stores the malloc'ed result in '*out' and its length in '*outlen', otherwise
+ * returns -1. */
+int bscodec_compress(int codec, const u_char *in, off_t inlen, u_char **out, off_t *outlen);
+
+typedef struct bsdecoder bsdecoder_t;
+
+/* Returns a decoder for a stream compressed with 'codec', or NULL. */
+bsdecoder_t *bsdecoder_create(int codec);
+
+/* bsdecoder_decode(d, in, inlen, out, outlen)
+ *
+ * Decodes from the '*inlen' bytes at '*in' into the '*outlen' bytes at '*out',
+ * advancing both past the bytes consumed and produced. Returns 1 at the end of
+ * the stream, 0 when it needs more input or output space, and -1 if the stream
+ * is corrupt. */
+int bsdecoder_decode(bsdecoder_t *d, const u_char **in, size_t *inlen, u_char **out, size_t *outlen);
+
+void bsdecoder_destroy(bsdecoder_t *d);
+
+#endif
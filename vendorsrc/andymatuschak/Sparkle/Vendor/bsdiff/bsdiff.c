@@ -29,65 +29,85 @@ __FBSDID("$FreeBSD: src/usr.bin/bsdiff/bsdiff/bsdiff.c, v 1.1 2005/08/06 01:59:0
 #endif
 
 #include <sys/types.h>
+#include "bsdiff.h"
 #include "sais.h"
 
 #include <err.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "bscodecs.h"
 #include "bscommon.h"
+#include "bskernels.h"
 
 #define MIN(x, y) (((x)<(y)) ? (x) : (y))
+#define MAX(x, y) (((x)>(y)) ? (x) : (y))
 
-/* matchlen(old, oldsize, new, newsize)
+/* Parts of the new file smaller than this are not split across threads, as
+ * every chunk boundary costs a little in patch size. */
+#define MIN_CHUNK_SIZE (4 << 20)
+
+/* matchlen(K, old, oldsize, new, newsize)
  *
  * Returns the length of the longest common prefix between 'old' and 'new'. */
-static off_t matchlen(u_char *old, off_t oldsize, u_char *new, off_t newsize)
+static off_t matchlen(const bskernels_t *K, const u_char *old, off_t oldsize, const u_char *new, off_t newsize)
 {
-    off_t i;
+    return K->matchlen(old, new, MIN(oldsize, newsize));
+}
 
-    for (i = 0; (i < oldsize) && (i < newsize); i++)
-    {
-        if (old[i] != new[i])
-            break;
-    }
+/* The suffix sort of the old file. Files shorter than 2GB are sorted with
+ * 32-bit indices in 'I32', which takes half the memory of 'I64'. */
+struct sufsort {
+    const int32_t *I32;
+    const off_t *I64;
+};
 
-    return i;
+/* sufpos(I, i)
+ *
+ * Returns the offset in the old file of the 'i'th suffix in the sort 'I'. */
+static inline off_t sufpos(const struct sufsort *I, off_t i)
+{
+    return (I->I32 != NULL) ? I->I32[i] : I->I64[i];
 }
 
-/* search(I, old, oldsize, new, newsize, st, en, pos)
+/* search(K, I, old, oldsize, new, newsize, st, en, pos)
  *
  * Searches for the longest prefix of 'new' that occurs in 'old', stores its
  * offset in '*pos', and returns its length. 'I' should be the suffix sort of
  * 'old', and 'st' and 'en' are the lowest and highest indices in the suffix
  * sort to consider. If you're searching all suffixes, 'st = 0' and 'en =
  * oldsize - 1'. */
-static off_t search(off_t *I, u_char *old, off_t oldsize,
-        u_char *new, off_t newsize, off_t st, off_t en, off_t *pos)
+static off_t search(const bskernels_t *K, const struct sufsort *I, const u_char *old, off_t oldsize,
+        const u_char *new, off_t newsize, off_t st, off_t en, off_t *pos)
 {
-    off_t x, y;
+    off_t x, y, p;
 
     if (en - st < 2) {
-        x = matchlen(old + I[st], oldsize - I[st], new, newsize);
-        y = matchlen(old + I[en], oldsize - I[en], new, newsize);
+        p = sufpos(I, st);
+        x = matchlen(K, old + p, oldsize - p, new, newsize);
+        p = sufpos(I, en);
+        y = matchlen(K, old + p, oldsize - p, new, newsize);
 
         if (x > y) {
-            *pos = I[st];
+            *pos = sufpos(I, st);
             return x;
         } else {
-            *pos = I[en];
+            *pos = p;
             return y;
         }
     }
 
     x = st + (en - st)/2;
-    if (memcmp(old + I[x], new, (size_t)(MIN(oldsize - I[x], newsize))) < 0) {
-        return search(I, old, oldsize, new, newsize, x, en, pos);
+    p = sufpos(I, x);
+    if (memcmp(old + p, new, (size_t)(MIN(oldsize - p, newsize))) < 0) {
+        return search(K, I, old, oldsize, new, newsize, x, en, pos);
     } else {
-        return search(I, old, oldsize, new, newsize, st, x, pos);
+        return search(K, I, old, oldsize, new, newsize, st, x, pos);
     };
 }
 
@@ -117,13 +137,73 @@ static void offtout(off_t x, u_char *buf)
         buf[7] |= 0x80;
 }
 
-int bsdiff(int argc, char *argv[]); // Added by AMM: suppresses a warning about the following not having a prototype.
+/* offtin(buf)
+ *
+ * Reads an off_t written by offtout from 'buf'. */
+static off_t offtin(const u_char *buf)
+{
+    off_t y;
+
+    y = buf[7] & 0x7F;
+    y = y * 256; y += buf[6];
+    y = y * 256; y += buf[5];
+    y = y * 256; y += buf[4];
+    y = y * 256; y += buf[3];
+    y = y * 256; y += buf[2];
+    y = y * 256; y += buf[1];
+    y = y * 256; y += buf[0];
+
+    if (buf[7] & 0x80)
+        y = -y;
+
+    return y;
+}
+
+/* A contiguous part of the new file, diffed against the whole old file as if
+ * it were a complete new file of its own. */
+struct chunk {
+    const u_char *old;      /* contents of old file */
+    off_t oldsize;          /* length of old file */
+    const struct sufsort *I; /* suffix sort of old file */
+    const bskernels_t *K;   /* byte loops for this processor */
+    const u_char *new;      /* contents of this part of the new file */
+    off_t newsize;          /* length of this part of the new file */
+    off_t *ctrl;            /* ctrl triples */
+    off_t ctrllen, ctrlcap; /* number of ctrl values used, allocated */
+    u_char *db, *eb;        /* contents of diff, extra sections */
+    off_t dblen, eblen;     /* length of diff, extra sections */
+    off_t endpos;           /* position in the old file after the last triple */
+    int status;
+};
+
+/* addctrl(c, x)
+ *
+ * Appends the value 'x' to the ctrl section of 'c'. */
+static int addctrl(struct chunk *c, off_t x)
+{
+    if (c->ctrllen == c->ctrlcap) {
+        off_t cap = c->ctrlcap ? 2 * c->ctrlcap : 3 * 1024;
+        off_t *ctrl = realloc(c->ctrl, (size_t)cap * sizeof(off_t));
+        if (ctrl == NULL)
+            return -1;
+        c->ctrl = ctrl;
+        c->ctrlcap = cap;
+    }
+    c->ctrl[c->ctrllen++] = x;
+    return 0;
+}
 
-int bsdiff(int argc, char *argv[])
+/* diffchunk(c)
+ *
+ * Computes the ctrl triples and the diff and extra sections for 'c'. This is
+ * the original bsdiff loop, with the patch sections written to memory. */
+static void *diffchunk(void *arg)
 {
-    u_char *old = NULL,*new = NULL;           /* contents of old, new files */
-    off_t oldsize = 0, newsize = 0;     /* length of old, new files */
-    off_t *I = NULL,*V = NULL;                /* arrays used for suffix sort; I is ordering */
+    struct chunk *c = arg;
+    const u_char *old = c->old, *new = c->new;
+    const struct sufsort *I = c->I;
+    const bskernels_t *K = c->K;
+    off_t oldsize = c->oldsize, newsize = c->newsize;
     off_t scan = 0;                 /* position of current match in old file */
     off_t pos = 0;              /* position of current match in new file */
     off_t len = 0;                  /* length of current match */
@@ -131,85 +211,23 @@ int bsdiff(int argc, char *argv[])
     off_t lastpos = 0;              /* position of previous match in new file */
     off_t lastoffset = 0;           /* lastpos - lastscan */
     off_t oldscore = 0, scsc = 0;       /* temp variables in match search */
-    off_t s = 0, Sf = 0, lenf = 0, Sb = 0, lenb = 0;    /* temp vars in match extension */
-    off_t overlap = 0, Ss = 0, lens = 0;
+    off_t lenf = 0, lenb = 0;       /* lengths of match extensions */
+    off_t overlap = 0, lens = 0;
     off_t i = 0;
     off_t dblen = 0, eblen = 0;         /* length of diff, extra sections */
     u_char *db = NULL,*eb = NULL;             /* contents of diff, extra sections */
-    u_char buf[8] = {0};
-    u_char header[32] = {0};
-    FILE * pf = NULL;
-    int exitstatus = -1;
-
-    if (argc != 4) {
-        warnx("usage: %s oldfile newfile patchfile\n", argv[0]);
-        goto cleanup;
-    }
-
-    old = readfile(argv[1], &oldsize);
-    if (old == NULL) {
-        warn("old file error: %s", argv[1]);
-        goto cleanup;
-    }
-
-    if (((I = malloc(((size_t)oldsize + 1) * sizeof(off_t))) == NULL) ||
-        ((V = malloc(((size_t)oldsize + 1) * sizeof(off_t))) == NULL)) {
-        warn("Failed to allocate memory for I or V");
-        goto cleanup;
-    }
 
-    /* Do a suffix sort on the old file. */
-    I[0] = oldsize;
-    sais(old, I+1, (int)oldsize);
-
-    free(V);
-    V = NULL;
-    
-    new = readfile(argv[2], &newsize);
-    if (new == NULL) {
-        warn("new file error: %s", argv[2]);
-        goto cleanup;
-    }
+    c->status = -1;
 
     if (((db = malloc((size_t)newsize + 1)) == NULL) ||
         ((eb = malloc((size_t)newsize + 1)) == NULL)) {
         warn("Failed to allocate memory for db or eb");
         goto cleanup;
     }
-    dblen = 0;
-    eblen = 0;
-
-    /* Create the patch file */
-    if ((pf = fopen(argv[3], "w")) == NULL) {
-        warn("%s", argv[3]);
-        goto cleanup;
-    }
-
-    /* Header is
-        0    8     "BSDIFN40"
-        8    8    length of ctrl block
-        16    8    length of diff block
-        24    8    length of new file */
-    /* File is
-        0    32    Header
-        32    ??    ctrl block
-        ??    ??    diff block
-        ??    ??    extra block */
-    memcpy(header, "BSDIFN40", 8);
-    offtout(0, header + 8);
-    offtout(0, header + 16);
-    offtout(newsize, header + 24);
-    if (fwrite(header, 32, 1, pf) != 1) {
-        warn("fwrite(%s)", argv[3]);
-        goto cleanup;
-    }
+    c->db = db;
+    c->eb = eb;
 
     /* Compute the differences, writing ctrl as we go */
-    scan = 0;
-    len = 0;
-    lastscan = 0;
-    lastpos = 0;
-    lastoffset = 0;
     while (scan < newsize) {
         oldscore = 0;
 
@@ -217,15 +235,16 @@ int bsdiff(int argc, char *argv[])
             /* 'oldscore' is the number of characters that match between the
              * substrings 'old[lastoffset + scan:lastoffset + scsc]' and
              * 'new[scan:scsc]'. */
-            len = search(I, old, oldsize, new + scan, newsize - scan,
+            len = search(K, I, old, oldsize, new + scan, newsize - scan,
                     0, oldsize, &pos);
 
             /* If this match extends further than the last one, add any new
              * matching characters to 'oldscore'. */
-            for (; scsc < scan + len; scsc++) {
-                if ((scsc + lastoffset < oldsize) &&
-                    (old[scsc + lastoffset] == new[scsc]))
-                    oldscore++;
+            if (scsc < scan + len) {
+                i = MIN(scan + len, oldsize - lastoffset);
+                if (scsc < i)
+                    oldscore += K->count_equal(old + scsc + lastoffset, new + scsc, i - scsc);
+                scsc = scan + len;
             }
 
             /* Choose this as our match if it contains more than eight
@@ -247,65 +266,35 @@ int bsdiff(int argc, char *argv[])
         if ((len != oldscore) || (scan == newsize)) {
             /* Figure out how far forward the previous match should be
              * extended... */
-            s = 0;
-            Sf = 0;
-            lenf = 0;
-            for (i = 0; (lastscan + i < scan) && (lastpos + i < oldsize);) {
-                if (old[lastpos + i] == new[lastscan + i])
-                    s++;
-                i++;
-                if (s * 2 - i > Sf * 2 - lenf) {
-                    Sf = s;
-                    lenf = i;
-                }
-            }
+            lenf = K->extend_forward(old + lastpos, new + lastscan,
+                    MIN(scan - lastscan, oldsize - lastpos));
 
             /* ... and how far backwards the next match should be extended. */
             lenb = 0;
-            if (scan < newsize) {
-                s = 0;
-                Sb = 0;
-                for (i = 1; (scan >= lastscan + i) && (pos >= i); i++) {
-                    if (old[pos - i] == new[scan - i])
-                        s++;
-                    if (s * 2 - i > Sb * 2 - lenb) {
-                        Sb = s;
-                        lenb = i;
-                    }
-                }
-            }
+            if (scan < newsize)
+                lenb = K->extend_backward(old + pos, new + scan,
+                        MIN(scan - lastscan, pos));
 
             /* If there is an overlap between the extensions, find the best
              * dividing point in the middle and reset 'lenf' and 'lenb'
              * accordingly. */
             if (lastscan + lenf > scan - lenb) {
                 overlap = (lastscan + lenf) - (scan - lenb);
-                s = 0;
-                Ss = 0;
-                lens = 0;
-                for (i = 0; i < overlap; i++) {
-                    if (new[lastscan + lenf - overlap + i] ==
-                        old[lastpos + lenf - overlap + i])
-                        s++;
-                    if (new[scan - lenb + i] == old[pos - lenb + i])
-                        s--;
-                    if (s > Ss) {
-                        Ss = s;
-                        lens = i + 1;
-                    }
-                }
+                lens = K->split(new + lastscan + lenf - overlap,
+                        old + lastpos + lenf - overlap,
+                        new + scan - lenb, old + pos - lenb, overlap);
 
                 lenf += lens - overlap;
                 lenb -= lens;
             }
 
             /* Write the diff data for the last match to the diff section... */
-            for (i = 0; i < lenf; i++)
-                db[dblen + i] = new[lastscan + i] - old[lastpos + i];
+            K->sub(db + dblen, new + lastscan, old + lastpos, lenf);
             /* ... and, if there's a gap between the extensions just
              * calculated, write the data in that gap to the extra section. */
-            for (i = 0; i< (scan - lenb) - (lastscan + lenf); i++)
-                eb[eblen + i] = new[lastscan + lenf + i];
+            if ((scan - lenb) - (lastscan + lenf) > 0)
+                memcpy(eb + eblen, new + lastscan + lenf,
+                        (size_t)((scan - lenb) - (lastscan + lenf)));
 
             /* Update the diff and extra section lengths accordingly. */
             dblen += lenf;
@@ -317,21 +306,10 @@ int bsdiff(int argc, char *argv[])
              *  - offset between the end of the diff and the start of the next
              *      diff, in the old file
              */
-            offtout(lenf, buf);
-            if (fwrite(buf, 8, 1, pf) != 1) {
-                warnx("fwrite");
-                goto cleanup;
-            }
-
-            offtout((scan - lenb) - (lastscan + lenf), buf);
-            if (fwrite(buf, 8, 1, pf) != 1) {
-                warn("fwrite");
-                goto cleanup;
-            }
-
-            offtout((pos - lenb) - (lastpos + lenf), buf);
-            if (fwrite(buf, 8, 1, pf) != 1) {
-                warn("fwrite");
+            if (addctrl(c, lenf) ||
+                addctrl(c, (scan - lenb) - (lastscan + lenf)) ||
+                addctrl(c, (pos - lenb) - (lastpos + lenf))) {
+                warn("Failed to allocate memory for ctrl");
                 goto cleanup;
             }
 
@@ -345,38 +323,336 @@ int bsdiff(int argc, char *argv[])
         }
     }
 
-    /* Compute size of compressed ctrl data */
-    if ((len = ftello(pf)) == -1) {
-        warn("ftello");
+    c->dblen = dblen;
+    c->eblen = eblen;
+    c->endpos = lastpos;
+    c->status = 0;
+cleanup:
+
+    return NULL;
+}
+
+int bsdiff_buffer(const u_char *old, off_t oldsize, const u_char *new, off_t newsize, int nthreads, u_char **patch, off_t *patchsize)
+{
+    static const u_char empty[1] = {0};
+    int32_t *I32 = NULL;                      /* suffix sort of files shorter than 2GB */
+    off_t *I64 = NULL;                        /* suffix sort of larger files */
+    struct sufsort I = { NULL, NULL };
+    struct chunk *chunks = NULL;
+    pthread_t *threads = NULL;
+    int nchunks = 0, nstarted = 0, k = 0;
+    off_t chunksize = 0, start = 0;
+    off_t ctrllen = 0, dblen = 0, eblen = 0;  /* length of ctrl, diff, extra sections */
+    u_char *p = NULL, *out = NULL;
+    off_t i = 0;
+    int exitstatus = -1;
+
+    if (old == NULL)
+        old = empty;
+    if (new == NULL)
+        new = empty;
+
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+
+    /* Do a suffix sort on the old file, with the same threads as the matching. */
+    if (oldsize < INT32_MAX) {
+        if ((I32 = malloc(((size_t)oldsize + 1) * sizeof(int32_t))) == NULL) {
+            warn("Failed to allocate memory for I");
+            goto cleanup;
+        }
+        I32[0] = (int32_t)oldsize;
+        if (sais32(old, I32 + 1, (int32_t)oldsize, nthreads) < 0) {
+            warnx("Failed to sort old file");
+            goto cleanup;
+        }
+        I.I32 = I32;
+    } else {
+        if ((I64 = malloc(((size_t)oldsize + 1) * sizeof(off_t))) == NULL) {
+            warn("Failed to allocate memory for I");
+            goto cleanup;
+        }
+        I64[0] = oldsize;
+        if (sais64(old, I64 + 1, oldsize, nthreads) < 0) {
+            warnx("Failed to sort old file");
+            goto cleanup;
+        }
+        I.I64 = I64;
+    }
+
+    /* Split the new file into chunks of at least MIN_CHUNK_SIZE bytes */
+    nchunks = (int)MIN((off_t)nthreads, newsize / MIN_CHUNK_SIZE);
+    if (nchunks < 1)
+        nchunks = 1;
+    chunksize = newsize / nchunks;
+
+    if (((chunks = calloc((size_t)nchunks, sizeof(struct chunk))) == NULL) ||
+        ((threads = calloc((size_t)nchunks, sizeof(pthread_t))) == NULL)) {
+        warn("Failed to allocate memory for chunks");
         goto cleanup;
     }
-    offtout(len - 32, header + 8);
 
-    /* Write diff data */
-    if (dblen && fwrite(db, (size_t)dblen, 1, pf) != 1) {
-        warn("fwrite");
+    for (k = 0; k < nchunks; k++) {
+        chunks[k].old = old;
+        chunks[k].oldsize = oldsize;
+        chunks[k].I = &I;
+        chunks[k].K = bskernels();
+        chunks[k].new = new + start;
+        chunks[k].newsize = (k == nchunks - 1) ? newsize - start : chunksize;
+        start += chunks[k].newsize;
+    }
+
+    /* Diff the first chunk on this thread and the others concurrently */
+    for (nstarted = 1; nstarted < nchunks; nstarted++) {
+        if (pthread_create(&threads[nstarted], NULL, diffchunk, &chunks[nstarted]) != 0) {
+            warnx("pthread_create");
+            break;
+        }
+    }
+    diffchunk(&chunks[0]);
+    for (k = 1; k < nstarted; k++)
+        pthread_join(threads[k], NULL);
+    for (k = nstarted; k < nchunks; k++)
+        diffchunk(&chunks[k]);
+
+    for (k = 0; k < nchunks; k++) {
+        if (chunks[k].status != 0)
+            goto cleanup;
+        ctrllen += chunks[k].ctrllen * 8;
+        dblen += chunks[k].dblen;
+        eblen += chunks[k].eblen;
+    }
+
+    if ((out = malloc((size_t)(32 + ctrllen + dblen + eblen))) == NULL) {
+        warn("Failed to allocate memory for patch");
+        goto cleanup;
+    }
+
+    /* Header is
+        0    8     "BSDIFN40"
+        8    8    length of ctrl block
+        16    8    length of diff block
+        24    8    length of new file */
+    /* File is
+        0    32    Header
+        32    ??    ctrl block
+        ??    ??    diff block
+        ??    ??    extra block */
+    memcpy(out, "BSDIFN40", 8);
+    offtout(ctrllen, out + 8);
+    offtout(dblen, out + 16);
+    offtout(newsize, out + 24);
+
+    /* Every chunk starts diffing at the beginning of the old file, so the
+     * last seek of a chunk goes back there rather than to the end of its
+     * last match. */
+    p = out + 32;
+    for (k = 0; k < nchunks; k++) {
+        if (k < nchunks - 1 && chunks[k].ctrllen > 0)
+            chunks[k].ctrl[chunks[k].ctrllen - 1] -= chunks[k].endpos;
+        for (i = 0; i < chunks[k].ctrllen; i++, p += 8)
+            offtout(chunks[k].ctrl[i], p);
+    }
+    for (k = 0; k < nchunks; k++) {
+        if (chunks[k].dblen)
+            memcpy(p, chunks[k].db, (size_t)chunks[k].dblen);
+        p += chunks[k].dblen;
+    }
+    for (k = 0; k < nchunks; k++) {
+        if (chunks[k].eblen)
+            memcpy(p, chunks[k].eb, (size_t)chunks[k].eblen);
+        p += chunks[k].eblen;
+    }
+
+    *patch = out;
+    *patchsize = 32 + ctrllen + dblen + eblen;
+    out = NULL;
+
+    exitstatus = 0;
+cleanup:
+
+    /* Free the memory we used */
+    if (chunks != NULL) {
+        for (k = 0; k < nchunks; k++) {
+            free(chunks[k].ctrl);
+            free(chunks[k].db);
+            free(chunks[k].eb);
+        }
+    }
+    free(chunks);
+    free(threads);
+    free(out);
+    free(I32);
+    free(I64);
+
+    return exitstatus;
+}
+
+/* A block of a patch, compressed on a thread of its own */
+struct block {
+    int codec;
+    const u_char *data;     /* uncompressed contents */
+    off_t len;              /* uncompressed length */
+    u_char *out;            /* compressed contents */
+    off_t outlen;           /* compressed length */
+    int status;
+};
+
+static void *compressblock(void *arg)
+{
+    struct block *b = arg;
+
+    b->status = bscodec_compress(b->codec, b->data, b->len, &b->out, &b->outlen);
+    return NULL;
+}
+
+int bsdiff_compress(const u_char *patch, off_t patchsize, const int codecs[3], u_char **out, off_t *outsize)
+{
+    struct block blocks[3];
+    pthread_t threads[3];
+    int started[3] = {0};
+    off_t ctrllen = 0, dblen = 0, newsize = 0;
+    u_char *p = NULL;
+    off_t len = 0;
+    int k = 0;
+    int exitstatus = -1;
+
+    memset(blocks, 0, sizeof(blocks));
+
+    if (patchsize < 32 || memcmp(patch, "BSDIFN40", 8) != 0) {
+        warnx("Not a BSDIFN40 patch");
+        return -1;
+    }
+    ctrllen = offtin(patch + 8);
+    dblen = offtin(patch + 16);
+    newsize = offtin(patch + 24);
+    if (ctrllen < 0 || dblen < 0 || newsize < 0 || ctrllen > patchsize - 32 || dblen > patchsize - 32 - ctrllen) {
+        warnx("Corrupt patch");
+        return -1;
+    }
+
+    blocks[0].data = patch + 32;
+    blocks[0].len = ctrllen;
+    blocks[1].data = patch + 32 + ctrllen;
+    blocks[1].len = dblen;
+    blocks[2].data = patch + 32 + ctrllen + dblen;
+    blocks[2].len = patchsize - 32 - ctrllen - dblen;
+    for (k = 0; k < 3; k++) {
+        blocks[k].codec = codecs[k];
+        blocks[k].status = -1;
+        if (!bscodec_available(codecs[k])) {
+            warnx("Codec %d is not available", codecs[k]);
+            return -1;
+        }
+    }
+
+    /* The diff block is by far the largest, compress it on this thread and
+     * the other two concurrently */
+    for (k = 0; k < 3; k += 2)
+        started[k] = (pthread_create(&threads[k], NULL, compressblock, &blocks[k]) == 0);
+    compressblock(&blocks[1]);
+    for (k = 0; k < 3; k += 2) {
+        if (started[k])
+            pthread_join(threads[k], NULL);
+        else
+            compressblock(&blocks[k]);
+    }
+    for (k = 0; k < 3; k++) {
+        if (blocks[k].status != 0)
+            goto cleanup;
+    }
+
+    if ((p = malloc((size_t)(40 + blocks[0].outlen + blocks[1].outlen + blocks[2].outlen))) == NULL) {
+        warn("Failed to allocate memory for patch");
         goto cleanup;
     }
 
-    /* Compute size of compressed diff data */
-    if ((newsize = ftello(pf)) == -1) {
-        warn("ftello");
+    /* Header is
+        0    8     "BSDIFC40"
+        8    8    length of compressed ctrl block
+        16    8    length of compressed diff block
+        24    8    length of new file
+        32    3    codecs of ctrl, diff and extra blocks
+        35    5    zero */
+    memcpy(p, "BSDIFC40", 8);
+    offtout(blocks[0].outlen, p + 8);
+    offtout(blocks[1].outlen, p + 16);
+    offtout(newsize, p + 24);
+    memset(p + 32, 0, 8);
+    len = 40;
+    for (k = 0; k < 3; k++) {
+        p[32 + k] = (u_char)codecs[k];
+        memcpy(p + len, blocks[k].out, (size_t)blocks[k].outlen);
+        len += blocks[k].outlen;
+    }
+
+    *out = p;
+    *outsize = len;
+    exitstatus = 0;
+cleanup:
+
+    for (k = 0; k < 3; k++)
+        free(blocks[k].out);
+
+    return exitstatus;
+}
+
+int bsdiff(int argc, const char *argv[])
+{
+    u_char *old = NULL,*new = NULL;           /* contents of old, new files */
+    off_t oldsize = 0, newsize = 0;     /* length of old, new files */
+    u_char *patch = NULL;               /* contents of patch file */
+    off_t patchsize = 0;                /* length of patch file */
+    u_char *compressed = NULL;          /* contents of compressed patch file */
+    int codecs[3] = { BSCODEC_RAW, BSCODEC_RAW, BSCODEC_RAW };
+    FILE * pf = NULL;
+    int exitstatus = -1;
+
+    if (argc != 4 && argc != 5) {
+        warnx("usage: %s oldfile newfile patchfile [codec]\n", argv[0]);
         goto cleanup;
     }
-    offtout(newsize - len, header + 16);
 
-    /* Write extra data */
-    if (eblen && fwrite(eb, (size_t)eblen, 1, pf) != 1) {
-        warn("fwrite");
+    /* Without a codec the patch is written raw, as BSDIFN40 */
+    if (argc == 5) {
+        codecs[0] = codecs[1] = codecs[2] = bscodec_named(argv[4]);
+        if (!bscodec_available(codecs[0])) {
+            warnx("codec %s is not available", argv[4]);
+            goto cleanup;
+        }
+    }
+
+    old = readfile(argv[1], &oldsize);
+    if (old == NULL) {
+        warn("old file error: %s", argv[1]);
         goto cleanup;
     }
 
-    /* Seek to the beginning, write the header, and close the file */
-    if (fseeko(pf, 0, SEEK_SET)) {
-        warn("fseeko");
+    new = readfile(argv[2], &newsize);
+    if (new == NULL) {
+        warn("new file error: %s", argv[2]);
+        goto cleanup;
+    }
+
+    if (bsdiff_buffer(old, oldsize, new, newsize, 1, &patch, &patchsize) != 0)
+        goto cleanup;
+
+    if (argc == 5) {
+        if (bsdiff_compress(patch, patchsize, codecs, &compressed, &patchsize) != 0)
+            goto cleanup;
+        free(patch);
+        patch = compressed;
+        compressed = NULL;
+    }
+
+    /* Create the patch file */
+    if ((pf = fopen(argv[3], "w")) == NULL) {
+        warn("%s", argv[3]);
         goto cleanup;
     }
-    if (fwrite(header, 32, 1, pf) != 1) {
+    if (fwrite(patch, (size_t)patchsize, 1, pf) != 1) {
         warn("fwrite(%s)", argv[3]);
         goto cleanup;
     }
@@ -395,10 +671,7 @@ cleanup:
     }
     
     /* Free the memory we used */
-    free(db);
-    free(eb);
-    free(I);
-    free(V);
+    free(patch);
     free(old);
     free(new);
 
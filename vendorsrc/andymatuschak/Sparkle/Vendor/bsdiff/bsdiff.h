@@ -0,0 +1,33 @@
+/*
+ *  bsdiff.h
+ *  Sparkle
+ */
+
+#ifndef BSDIFF_H
+#define BSDIFF_H
+
+#include <sys/types.h>
+
+int bsdiff(int argc, const char *argv[]);
+
+/* bsdiff_buffer(old, oldsize, new, newsize, nthreads, patch, patchsize)
+ *
+ * Creates a BSDIFN40 patch from 'old' to 'new' in memory, which can be applied
+ * with bspatch. The suffix sort of 'old' uses up to 'nthreads' threads, and
+ * the new data is split into up to 'nthreads' chunks which are matched
+ * concurrently against it; pass 0 to use one thread per processor, or 1 to
+ * get the same patch as bsdiff. On success,
+ * returns 0 and stores a malloc'ed patch in '*patch' and its length in
+ * '*patchsize', otherwise returns -1. */
+int bsdiff_buffer(const u_char *old, off_t oldsize, const u_char *new, off_t newsize, int nthreads, u_char **patch, off_t *patchsize);
+
+/* bsdiff_compress(patch, patchsize, codecs, out, outsize)
+ *
+ * Converts the BSDIFN40 'patch' to a BSDIFC40 patch, which compresses its
+ * ctrl, diff and extra blocks with the bscodec_t values in 'codecs', in that
+ * order. The three blocks are compressed concurrently. On success, returns 0
+ * and stores the malloc'ed patch in '*out' and its length in '*outsize',
+ * otherwise returns -1. */
+int bsdiff_compress(const u_char *patch, off_t patchsize, const int codecs[3], u_char **out, off_t *outsize);
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ *  bskernels.c
+ *  Sparkle
+ */
+
+#include "bskernels.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define BS_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#define BS_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Scalar kernels, these are the original bsdiff and bspatch loops */
+
+static off_t scalar_matchlen(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i;
+
+    for (i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            break;
+    }
+
+    return i;
+}
+
+static off_t scalar_count_equal(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, s = 0;
+
+    for (i = 0; i < n; i++) {
+        if (a[i] == b[i])
+            s++;
+    }
+
+    return s;
+}
+
+static off_t scalar_extend_forward(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, s = 0, Sf = 0, lenf = 0;
+
+    for (i = 0; i < n;) {
+        if (a[i] == b[i])
+            s++;
+        i++;
+        if (s * 2 - i > Sf * 2 - lenf) {
+            Sf = s;
+            lenf = i;
+        }
+    }
+
+    return lenf;
+}
+
+static off_t scalar_extend_backward(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, s = 0, Sb = 0, lenb = 0;
+
+    for (i = 1; i <= n; i++) {
+        if (a[-i] == b[-i])
+            s++;
+        if (s * 2 - i > Sb * 2 - lenb) {
+            Sb = s;
+            lenb = i;
+        }
+    }
+
+    return lenb;
+}
+
+static off_t scalar_split(const u_char *new1, const u_char *old1, const u_char *new2, const u_char *old2, off_t n)
+{
+    off_t i, s = 0, Ss = 0, lens = 0;
+
+    for (i = 0; i < n; i++) {
+        if (new1[i] == old1[i])
+            s++;
+        if (new2[i] == old2[i])
+            s--;
+        if (s > Ss) {
+            Ss = s;
+            lens = i + 1;
+        }
+    }
+
+    return lens;
+}
+
+static void scalar_sub(u_char *dst, const u_char *a, const u_char *b, off_t n)
+{
+    off_t i;
+
+    for (i = 0; i < n; i++)
+        dst[i] = a[i] - b[i];
+}
+
+static void scalar_add(u_char *dst, const u_char *src, off_t n)
+{
+    off_t i;
+
+    for (i = 0; i < n; i++)
+        dst[i] += src[i];
+}
+
+static const bskernels_t scalar_kernels = {
+    "scalar",
+    scalar_matchlen,
+    scalar_count_equal,
+    scalar_extend_forward,
+    scalar_extend_backward,
+    scalar_split,
+    scalar_sub,
+    scalar_add
+};
+
+/* For each 8-bit equality mask, the change in the extension score over its 8
+ * bytes, the highest score reached after any of them and after how many bytes
+ * it is first reached. 'extsteps_reversed' is for masks with the first byte in
+ * the highest bit. */
+struct extstep
+{
+    signed char delta, best, len;
+};
+
+static struct extstep extsteps[256], extsteps_reversed[256];
+
+static void init_extsteps(void)
+{
+    int m, k, score;
+
+    for (m = 0; m < 256; m++) {
+        score = 0;
+        extsteps[m].best = -9;
+        for (k = 0; k < 8; k++) {
+            score += ((m >> k) & 1) ? 1 : -1;
+            if (score > extsteps[m].best) {
+                extsteps[m].best = (signed char)score;
+                extsteps[m].len = (signed char)(k + 1);
+            }
+        }
+        extsteps[m].delta = (signed char)score;
+    }
+
+    for (m = 0; m < 256; m++) {
+        for (k = 0, score = 0; k < 8; k++)
+            score |= ((m >> k) & 1) << (7 - k);
+        extsteps_reversed[m] = extsteps[score];
+    }
+}
+
+#if BS_KERNELS_X86
+
+/* SSE2, which every x86_64 processor has */
+
+static inline uint32_t sse2_eqmask(const u_char *a, const u_char *b)
+{
+    __m128i va = _mm_loadu_si128((const __m128i *)a);
+    __m128i vb = _mm_loadu_si128((const __m128i *)b);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+}
+
+static inline void sse2_subblock(u_char *dst, const u_char *a, const u_char *b)
+{
+    __m128i va = _mm_loadu_si128((const __m128i *)a);
+    __m128i vb = _mm_loadu_si128((const __m128i *)b);
+    _mm_storeu_si128((__m128i *)dst, _mm_sub_epi8(va, vb));
+}
+
+static inline void sse2_addblock(u_char *dst, const u_char *src)
+{
+    __m128i vd = _mm_loadu_si128((const __m128i *)dst);
+    __m128i vs = _mm_loadu_si128((const __m128i *)src);
+    _mm_storeu_si128((__m128i *)dst, _mm_add_epi8(vd, vs));
+}
+
+#define KERNEL_FN(_name) sse2_##_name
+#define KERNEL_NAME "sse2"
+#define KERNEL_WIDTH 16
+#define KERNEL_ATTR
+#include "bskernels_template.h"
+#undef KERNEL_FN
+#undef KERNEL_NAME
+#undef KERNEL_WIDTH
+#undef KERNEL_ATTR
+
+/* AVX2, used when the processor supports it */
+
+#define BS_AVX2 __attribute__((target("avx2,popcnt")))
+
+BS_AVX2 static inline uint32_t avx2_eqmask(const u_char *a, const u_char *b)
+{
+    __m256i va = _mm256_loadu_si256((const __m256i *)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i *)b);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+}
+
+BS_AVX2 static inline void avx2_subblock(u_char *dst, const u_char *a, const u_char *b)
+{
+    __m256i va = _mm256_loadu_si256((const __m256i *)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i *)b);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_sub_epi8(va, vb));
+}
+
+BS_AVX2 static inline void avx2_addblock(u_char *dst, const u_char *src)
+{
+    __m256i vd = _mm256_loadu_si256((const __m256i *)dst);
+    __m256i vs = _mm256_loadu_si256((const __m256i *)src);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_add_epi8(vd, vs));
+}
+
+#define KERNEL_FN(_name) avx2_##_name
+#define KERNEL_NAME "avx2"
+#define KERNEL_WIDTH 32
+#define KERNEL_ATTR BS_AVX2
+#include "bskernels_template.h"
+#undef KERNEL_FN
+#undef KERNEL_NAME
+#undef KERNEL_WIDTH
+#undef KERNEL_ATTR
+
+#elif BS_KERNELS_NEON
+
+/* NEON, which every arm64 processor has */
+
+static inline uint32_t neon_eqmask(const u_char *a, const u_char *b)
+{
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t m = vandq_u8(vceqq_u8(vld1q_u8(a), vld1q_u8(b)), vld1q_u8(bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(m)) | ((uint32_t)vaddv_u8(vget_high_u8(m)) << 8);
+}
+
+static inline void neon_subblock(u_char *dst, const u_char *a, const u_char *b)
+{
+    vst1q_u8(dst, vsubq_u8(vld1q_u8(a), vld1q_u8(b)));
+}
+
+static inline void neon_addblock(u_char *dst, const u_char *src)
+{
+    vst1q_u8(dst, vaddq_u8(vld1q_u8(dst), vld1q_u8(src)));
+}
+
+#define KERNEL_FN(_name) neon_##_name
+#define KERNEL_NAME "neon"
+#define KERNEL_WIDTH 16
+#define KERNEL_ATTR
+#include "bskernels_template.h"
+#undef KERNEL_FN
+#undef KERNEL_NAME
+#undef KERNEL_WIDTH
+#undef KERNEL_ATTR
+
+#endif
+
+static const bskernels_t *all_kernels[4];
+static pthread_once_t all_kernels_once = PTHREAD_ONCE_INIT;
+
+static void find_kernels(void)
+{
+    int n = 0;
+
+    init_extsteps();
+    all_kernels[n++] = &scalar_kernels;
+#if BS_KERNELS_X86
+    all_kernels[n++] = &sse2_kernels;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        all_kernels[n++] = &avx2_kernels;
+#elif BS_KERNELS_NEON
+    all_kernels[n++] = &neon_kernels;
+#endif
+    all_kernels[n] = NULL;
+}
+
+const bskernels_t * const *bskernels_all(void)
+{
+    pthread_once(&all_kernels_once, find_kernels);
+    return all_kernels;
+}
+
+const bskernels_t *bskernels(void)
+{
+    const bskernels_t * const *kernels = bskernels_all();
+    int n = 0;
+
+    while (kernels[n + 1] != NULL)
+        n++;
+
+    return kernels[n];
+}
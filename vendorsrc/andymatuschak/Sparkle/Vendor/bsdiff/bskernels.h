@@ -0,0 +1,51 @@
+/*
+ *  bskernels.h
+ *  Sparkle
+ */
+
+#ifndef BS_KERNELS_H
+#define BS_KERNELS_H
+
+#include <sys/types.h>
+
+/* The byte loops of bsdiff and bspatch. Every implementation gives exactly the
+ * same results as the scalar one; they only differ in speed. */
+typedef struct
+{
+    const char *name;
+
+    /* Returns the number of leading bytes that 'a' and 'b' have in common,
+     * looking at no more than 'n'. */
+    off_t (*matchlen)(const u_char *a, const u_char *b, off_t n);
+
+    /* Returns the number of 'i < n' for which 'a[i] == b[i]'. */
+    off_t (*count_equal)(const u_char *a, const u_char *b, off_t n);
+
+    /* Returns the length 'l <= n' maximising twice the number of equal bytes
+     * in 'a[0..l)' and 'b[0..l)' minus 'l', the shortest one on ties. */
+    off_t (*extend_forward)(const u_char *a, const u_char *b, off_t n);
+
+    /* Same as extend_forward, for the 'n' bytes before 'a' and 'b' going
+     * backwards from them. */
+    off_t (*extend_backward)(const u_char *a, const u_char *b, off_t n);
+
+    /* Returns the length 'l <= n' maximising the number of equal bytes in
+     * 'new1[0..l)' and 'old1[0..l)' minus those in 'new2[0..l)' and
+     * 'old2[0..l)', the shortest one on ties. */
+    off_t (*split)(const u_char *new1, const u_char *old1, const u_char *new2, const u_char *old2, off_t n);
+
+    /* Sets 'dst[i]' to 'a[i] - b[i]' for 'i < n'. */
+    void (*sub)(u_char *dst, const u_char *a, const u_char *b, off_t n);
+
+    /* Adds 'src[i]' to 'dst[i]' for 'i < n'. */
+    void (*add)(u_char *dst, const u_char *src, off_t n);
+} bskernels_t;
+
+/* Returns the fastest kernels this processor supports. */
+const bskernels_t *bskernels(void);
+
+/* Returns all the kernels this processor supports, scalar first, followed by
+ * NULL. Used to check them against each other. */
+const bskernels_t * const *bskernels_all(void);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ *  bskernels_template.h
+ *  Sparkle
+ */
+
+/* The vector kernels, included by bskernels.c once per instruction set. The
+ * includer defines KERNEL_FN() to name the functions, KERNEL_NAME, KERNEL_WIDTH
+ * as the number of bytes in a vector, KERNEL_ATTR for any target attributes, and the
+ * functions KERNEL_FN(eqmask), which returns a mask with bit 'k' set when
+ * 'a[k] == b[k]', KERNEL_FN(subblock) and KERNEL_FN(addblock), which work on
+ * one vector of bytes.
+ *
+ * The scoring loops skip vectors that cannot improve the best score with a
+ * population count, and step through the others 8 bytes at a time with the
+ * tables in bskernels.c, which keeps them exact. */
+
+#define KERNEL_FULLMASK ((uint32_t)(((uint64_t)1 << KERNEL_WIDTH) - 1))
+
+KERNEL_ATTR static off_t KERNEL_FN(matchlen)(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i;
+    uint32_t m;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH) {
+        m = KERNEL_FN(eqmask)(a + i, b + i);
+        if (m != KERNEL_FULLMASK)
+            return i + __builtin_ctz(~m);
+    }
+    for (; i < n; i++) {
+        if (a[i] != b[i])
+            break;
+    }
+
+    return i;
+}
+
+KERNEL_ATTR static off_t KERNEL_FN(count_equal)(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, s = 0;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH)
+        s += __builtin_popcount(KERNEL_FN(eqmask)(a + i, b + i));
+    for (; i < n; i++) {
+        if (a[i] == b[i])
+            s++;
+    }
+
+    return s;
+}
+
+/* The extension score is twice the number of equal bytes minus the number of
+ * bytes, kept in 'score' rather than recomputed from the count. */
+
+KERNEL_ATTR static off_t KERNEL_FN(extend_forward)(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, k, score = 0, best = 0, len = 0;
+    const struct extstep *step;
+    uint32_t m;
+    int e;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH) {
+        m = KERNEL_FN(eqmask)(a + i, b + i);
+        e = __builtin_popcount(m);
+        /* The score can rise by at most 'e' within this vector */
+        if (score + e > best) {
+            for (k = 0; k < KERNEL_WIDTH; k += 8) {
+                step = &extsteps[(m >> k) & 0xff];
+                if (score + step->best > best) {
+                    best = score + step->best;
+                    len = i + k + step->len;
+                }
+                score += step->delta;
+            }
+        } else {
+            score += 2 * e - KERNEL_WIDTH;
+        }
+    }
+    for (; i < n; i++) {
+        score += (a[i] == b[i]) ? 1 : -1;
+        if (score > best) {
+            best = score;
+            len = i + 1;
+        }
+    }
+
+    return len;
+}
+
+KERNEL_ATTR static off_t KERNEL_FN(extend_backward)(const u_char *a, const u_char *b, off_t n)
+{
+    off_t i, k, score = 0, best = 0, len = 0;
+    const struct extstep *step;
+    uint32_t m;
+    int e;
+
+    /* 'i' bytes have been looked at; the vector holds the 'KERNEL_WIDTH' before
+     * them, with the one nearest to 'a' in the highest bit */
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH) {
+        m = KERNEL_FN(eqmask)(a - i - KERNEL_WIDTH, b - i - KERNEL_WIDTH);
+        e = __builtin_popcount(m);
+        if (score + e > best) {
+            for (k = 0; k < KERNEL_WIDTH; k += 8) {
+                step = &extsteps_reversed[(m >> (KERNEL_WIDTH - 8 - k)) & 0xff];
+                if (score + step->best > best) {
+                    best = score + step->best;
+                    len = i + k + step->len;
+                }
+                score += step->delta;
+            }
+        } else {
+            score += 2 * e - KERNEL_WIDTH;
+        }
+    }
+    for (; i < n; i++) {
+        score += (a[-i - 1] == b[-i - 1]) ? 1 : -1;
+        if (score > best) {
+            best = score;
+            len = i + 1;
+        }
+    }
+
+    return len;
+}
+
+KERNEL_ATTR static off_t KERNEL_FN(split)(const u_char *new1, const u_char *old1, const u_char *new2, const u_char *old2, off_t n)
+{
+    off_t i, k, s = 0, best = 0, len = 0;
+    uint32_t m1, m2;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH) {
+        m1 = KERNEL_FN(eqmask)(new1 + i, old1 + i);
+        m2 = KERNEL_FN(eqmask)(new2 + i, old2 + i);
+        /* The score can only rise where the first pair matches and the second doesn't */
+        if (s + __builtin_popcount(m1 & ~m2) <= best) {
+            s += __builtin_popcount(m1) - __builtin_popcount(m2);
+            continue;
+        }
+        for (k = 0; k < KERNEL_WIDTH; k++) {
+            s += (m1 >> k) & 1;
+            s -= (m2 >> k) & 1;
+            if (s > best) {
+                best = s;
+                len = i + k + 1;
+            }
+        }
+    }
+    for (; i < n; i++) {
+        if (new1[i] == old1[i])
+            s++;
+        if (new2[i] == old2[i])
+            s--;
+        if (s > best) {
+            best = s;
+            len = i + 1;
+        }
+    }
+
+    return len;
+}
+
+KERNEL_ATTR static void KERNEL_FN(sub)(u_char *dst, const u_char *a, const u_char *b, off_t n)
+{
+    off_t i;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH)
+        KERNEL_FN(subblock)(dst + i, a + i, b + i);
+    for (; i < n; i++)
+        dst[i] = a[i] - b[i];
+}
+
+KERNEL_ATTR static void KERNEL_FN(add)(u_char *dst, const u_char *src, off_t n)
+{
+    off_t i;
+
+    for (i = 0; i + KERNEL_WIDTH <= n; i += KERNEL_WIDTH)
+        KERNEL_FN(addblock)(dst + i, src + i);
+    for (; i < n; i++)
+        dst[i] += src[i];
+}
+
+static const bskernels_t KERNEL_FN(kernels) = {
+    KERNEL_NAME,
+    KERNEL_FN(matchlen),
+    KERNEL_FN(count_equal),
+    KERNEL_FN(extend_forward),
+    KERNEL_FN(extend_backward),
+    KERNEL_FN(split),
+    KERNEL_FN(sub),
+    KERNEL_FN(add)
+};
+
+#undef KERNEL_FULLMASK
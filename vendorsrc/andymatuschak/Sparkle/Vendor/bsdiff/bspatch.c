@@ -29,86 +29,294 @@ __FBSDID("$FreeBSD: src/usr.bin/bsdiff/bspatch/bspatch.c,v 1.1 2005/08/06 01:59:
 #endif
 
 #include "bspatch.h"
-#include <bzlib.h>
+#include "bscodecs.h"
+#include "bskernels.h"
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <err.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
-#include "bscommon.h"
+#ifndef u_char
+typedef unsigned char u_char;
+#endif
 
-/* Compatibility layer for reading either the old BSDIFF40 or the new BSDIFN40
-   patch formats: */
+#define MIN(x, y) (((x)<(y)) ? (x) : (y))
+#define MAX(x, y) (((x)>(y)) ? (x) : (y))
 
-typedef void* stream_t;
+/* Size of the buffers the new file is assembled in and the old file is read
+   into. Together with the section buffers and bzip2's state, these bound the
+   memory used by bspatch regardless of the size of the files. */
+#define BUFFER_SIZE (1 << 20)
 
-typedef struct
-{
-    stream_t (*open)(FILE*);
-    void (*close)(stream_t);
-    off_t (*read)(stream_t, void*, off_t);
-} io_funcs_t;
+/* Size of the buffer each section of the patch is read into */
+#define SECTION_BUFFER_SIZE (64 << 10)
 
-static stream_t BSDIFF40_open(FILE *f)
+/* Size of each of the two buffers a compressed section is decoded ahead into */
+#define DECODE_AHEAD_SIZE (256 << 10)
+
+/* How much of the old file to read past the bytes a triple needs. The triples
+   jump around the old file, so reading further ahead mostly reads bytes that
+   are never used. */
+#define OLD_READAHEAD 4096
+
+/* preadall(fd, buf, len, offset)
+ *
+ * Reads 'len' bytes at 'offset' of 'fd' into 'buf', retrying short reads.
+ * Returns the number of bytes read, which is less than 'len' only at the end
+ * of the file, or -1 on error. */
+static ssize_t preadall(int fd, void *buf, size_t len, off_t offset)
 {
-    int bzerr = 0;
-    BZFILE *s = NULL;
-    if ((s = BZ2_bzReadOpen(&bzerr, f, 0, 0, NULL, 0)) == NULL) {
-        warnx("BZ2_bzReadOpen, bz2err = %d", bzerr);
+    size_t total = 0;
+    ssize_t n;
+
+    while (total < len) {
+        n = pread(fd, (u_char *)buf + total, len - total, offset + (off_t)total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        total += (size_t)n;
     }
-    return s;
+
+    return (ssize_t)total;
 }
 
-static void BSDIFF40_close(stream_t s)
+/* Compatibility layer for reading the old BSDIFF40 (bzip2), the BSDIFN40 (raw)
+   and the BSDIFC40 (a codec per section) patch formats. Each section is read
+   with pread from its own offset, so the patch file only needs to be opened
+   once. Compressed sections are decoded ahead on a thread of their own, so the
+   three sections are decompressed concurrently with each other and with the
+   patching: */
+
+typedef struct
+{
+    int fd;
+    off_t offset;                   /* position of the next byte to read */
+    off_t end;                      /* end of the section in the patch */
+    off_t bufpos, buflen;           /* unread part of 'buf' */
+    bsdecoder_t *dec;               /* decompressor reading 'buf', NULL if raw */
+    int decend;
+
+    /* The decoding thread fills the two 'ahead' buffers in turn, the reader
+       empties them in the same order */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int threadstarted, stop;
+    u_char *ahead[2];
+    off_t aheadlen[2];              /* bytes decoded, or -1 on error */
+    int full[2];
+    int cur, acquired;              /* buffer being read and whether it is full */
+    off_t aheadpos;                 /* position in 'ahead[cur]' */
+
+    u_char buf[SECTION_BUFFER_SIZE];
+} stream_t;
+
+/* rawread(s, buf, len)
+ *
+ * Reads up to 'len' bytes of the raw section 's' into 'buf'. */
+static off_t rawread(stream_t *s, void *buf, off_t len)
 {
-    int bzerr;
-    BZ2_bzReadClose(&bzerr, (BZFILE*)s);
+    off_t total = 0, n = 0;
+
+    while (total < len) {
+        if (s->bufpos == s->buflen) {
+            n = preadall(s->fd, s->buf, (size_t)MIN((off_t)sizeof(s->buf), s->end - s->offset), s->offset);
+            if (n < 0) {
+                warn("pread");
+                return -1;
+            }
+            if (n == 0)
+                break;
+            s->offset += n;
+            s->bufpos = 0;
+            s->buflen = n;
+        }
+        n = MIN(len - total, s->buflen - s->bufpos);
+        memcpy((u_char *)buf + total, s->buf + s->bufpos, (size_t)n);
+        s->bufpos += n;
+        total += n;
+    }
+    return total;
 }
 
-static off_t BSDIFF40_read(stream_t s, void *buf, off_t len)
+/* decoderead(s, buf, len)
+ *
+ * Decompresses up to 'len' bytes of the section 's' into 'buf'. */
+static off_t decoderead(stream_t *s, void *buf, off_t len)
 {
-    int bzerr = 0, lenread = 0;
-    lenread = BZ2_bzRead(&bzerr, (BZFILE*)s, buf, (int)len);
-    if (bzerr != BZ_OK && bzerr != BZ_STREAM_END) {
-        warnx("Corrupt patch\n");
-        lenread = -1;
+    u_char *out = buf;
+    size_t outlen = (size_t)len, avail = 0, inlen = 0;
+    const u_char *in = NULL;
+    ssize_t n = 0;
+    int status = 0;
+
+    while (outlen > 0 && !s->decend) {
+        if (s->bufpos == s->buflen && s->offset < s->end) {
+            n = preadall(s->fd, s->buf, (size_t)MIN((off_t)sizeof(s->buf), s->end - s->offset), s->offset);
+            if (n <= 0) {
+                warnx("Corrupt patch\n");
+                return -1;
+            }
+            s->offset += n;
+            s->bufpos = 0;
+            s->buflen = n;
+        }
+        in = s->buf + s->bufpos;
+        inlen = (size_t)(s->buflen - s->bufpos);
+        avail = outlen;
+        status = bsdecoder_decode(s->dec, &in, &inlen, &out, &outlen);
+        s->bufpos = s->buflen - (off_t)inlen;
+        if (status < 0) {
+            warnx("Corrupt patch\n");
+            return -1;
+        } else if (status > 0) {
+            s->decend = 1;
+        } else if (inlen == 0 && s->offset >= s->end && outlen == avail) {
+            /* Truncated section */
+            break;
+        }
     }
-    return lenread;
+    return len - (off_t)outlen;
 }
 
-static io_funcs_t BSDIFF40_funcs = {
-    BSDIFF40_open,
-    BSDIFF40_close,
-    BSDIFF40_read
-};
+static void *decodeahead(void *arg)
+{
+    stream_t *s = arg;
+    off_t n = 0;
+    int k = 0, stop = 0;
 
+    for (k = 0; ; k ^= 1) {
+        pthread_mutex_lock(&s->lock);
+        while (s->full[k] && !s->stop)
+            pthread_cond_wait(&s->cond, &s->lock);
+        stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+        if (stop)
+            break;
 
-static stream_t BSDIFN40_open(FILE *f)
-{
-    return f;
+        n = decoderead(s, s->ahead[k], DECODE_AHEAD_SIZE);
+
+        pthread_mutex_lock(&s->lock);
+        s->aheadlen[k] = n;
+        s->full[k] = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+
+        /* A short buffer ends the section */
+        if (n < DECODE_AHEAD_SIZE)
+            break;
+    }
+
+    return NULL;
 }
 
-static void BSDIFN40_close(stream_t __unused s)
+/* aheadread(s, buf, len)
+ *
+ * Reads up to 'len' bytes of the section 's' from its decoding thread. */
+static off_t aheadread(stream_t *s, void *buf, off_t len)
 {
+    off_t total = 0, n = 0;
+
+    while (total < len) {
+        if (!s->acquired) {
+            pthread_mutex_lock(&s->lock);
+            while (!s->full[s->cur])
+                pthread_cond_wait(&s->cond, &s->lock);
+            pthread_mutex_unlock(&s->lock);
+            s->acquired = 1;
+            s->aheadpos = 0;
+        }
+        if (s->aheadlen[s->cur] < 0)
+            return -1;
+
+        n = MIN(len - total, s->aheadlen[s->cur] - s->aheadpos);
+        memcpy((u_char *)buf + total, s->ahead[s->cur] + s->aheadpos, (size_t)n);
+        s->aheadpos += n;
+        total += n;
+
+        if (s->aheadpos == s->aheadlen[s->cur]) {
+            if (s->aheadlen[s->cur] < DECODE_AHEAD_SIZE)
+                break;
+            pthread_mutex_lock(&s->lock);
+            s->full[s->cur] = 0;
+            pthread_cond_broadcast(&s->cond);
+            pthread_mutex_unlock(&s->lock);
+            s->cur ^= 1;
+            s->acquired = 0;
+        }
+    }
+    return total;
 }
 
-static off_t BSDIFN40_read(stream_t s, void *buf, off_t len)
+/* stream_open(s, fd, offset, end, codec)
+ *
+ * Opens the section of 'fd' from 'offset' to 'end', compressed with 'codec'. */
+static int stream_open(stream_t *s, int fd, off_t offset, off_t end, int codec)
 {
-    return (off_t)fread(buf, 1, (size_t)len, (FILE*)s);
+    s->fd = fd;
+    s->offset = offset;
+    s->end = end;
+    if (codec == BSCODEC_RAW)
+        return 0;
+
+    if ((s->dec = bsdecoder_create(codec)) == NULL)
+        return -1;
+
+    /* Without a thread, the section is decoded as it is read */
+    if (((s->ahead[0] = malloc(DECODE_AHEAD_SIZE)) == NULL) ||
+        ((s->ahead[1] = malloc(DECODE_AHEAD_SIZE)) == NULL))
+        return 0;
+    if (pthread_mutex_init(&s->lock, NULL) != 0)
+        return 0;
+    if (pthread_cond_init(&s->cond, NULL) != 0) {
+        pthread_mutex_destroy(&s->lock);
+        return 0;
+    }
+    if (pthread_create(&s->thread, NULL, decodeahead, s) != 0) {
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+        return 0;
+    }
+    s->threadstarted = 1;
+    return 0;
 }
 
-static io_funcs_t BSDIFN40_funcs = {
-    BSDIFN40_open,
-    BSDIFN40_close,
-    BSDIFN40_read
-};
+static void stream_close(stream_t *s)
+{
+    if (s->threadstarted) {
+        pthread_mutex_lock(&s->lock);
+        s->stop = 1;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        pthread_join(s->thread, NULL);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+        s->threadstarted = 0;
+    }
+    free(s->ahead[0]);
+    free(s->ahead[1]);
+    s->ahead[0] = s->ahead[1] = NULL;
+    bsdecoder_destroy(s->dec);
+    s->dec = NULL;
+}
 
+static off_t stream_read(stream_t *s, void *buf, off_t len)
+{
+    if (s->dec == NULL)
+        return rawread(s, buf, len);
+    if (s->threadstarted)
+        return aheadread(s, buf, len);
+    return decoderead(s, buf, len);
+}
 
-#ifndef u_char
-typedef unsigned char u_char;
-#endif
 
 static off_t offtin(u_char *buf)
 {
@@ -128,35 +336,106 @@ static off_t offtin(u_char *buf)
     return y;
 }
 
-int bspatch(int argc,const char * const argv[])
+/* The part of the old file around the position the triples refer to */
+typedef struct
+{
+    int fd;
+    off_t size;                     /* length of old file */
+    off_t start, len;               /* offset in old file and length of 'buf' */
+    u_char *buf;
+} oldfile_t;
+
+/* addold(K, o, pos, new, len)
+ *
+ * Adds the 'len' bytes of the old file at 'pos' to 'new', reading them into
+ * the buffer of 'o' when they are not in it. Bytes outside of the old file
+ * are left as they are. */
+static int addold(const bskernels_t *K, oldfile_t *o, off_t pos, u_char *new, off_t len)
+{
+    off_t start = MAX(pos, 0), end = MIN(pos + len, o->size);
+    off_t n;
+    ssize_t lenread;
+
+    while (start < end) {
+        if (start < o->start || start >= o->start + o->len) {
+            n = MIN(MAX(end - start, (off_t)OLD_READAHEAD), MIN((off_t)BUFFER_SIZE, o->size - start));
+            lenread = preadall(o->fd, o->buf, (size_t)n, start);
+            if (lenread <= 0) {
+                warnx("Failed to read old file");
+                return -1;
+            }
+            o->start = start;
+            o->len = lenread;
+        }
+
+        n = MIN(end, o->start + o->len) - start;
+        K->add(new + (start - pos), o->buf + (start - o->start), n);
+        start += n;
+    }
+
+    return 0;
+}
+
+/* flushnew(fd, buf, buffered, written, newsize, progress, context)
+ *
+ * Writes the '*buffered' bytes of 'buf' to the new file, adds them to
+ * '*written' and reports the progress. */
+static int flushnew(int fd, const u_char *buf, off_t *buffered, off_t *written, off_t newsize, bspatch_progress_t progress, void *context)
 {
-    FILE * f = NULL, * cpf = NULL, * dpf = NULL, * epf = NULL;
-    stream_t cstream = NULL, dstream = NULL, estream = NULL;
-    ssize_t oldsize = 0,newsize = 0;
-    ssize_t bzctrllen = 0,bzdatalen = 0;
-    u_char header[32] = {0},buf[8] = {0};
-    u_char *old = NULL, *new = NULL;
-    off_t oldpos = 0,newpos = 0;
+    off_t total = 0;
+    ssize_t n;
+
+    while (total < *buffered) {
+        n = write(fd, buf + total, (size_t)(*buffered - total));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        total += n;
+    }
+    *written += *buffered;
+    *buffered = 0;
+
+    if (progress != NULL)
+        progress(context, (newsize > 0) ? (double)*written / (double)newsize : 1.0);
+    return 0;
+}
+
+int bspatch_file(const char *oldfile, const char *newfile, const char *patchfile, bspatch_progress_t progress, void *context)
+{
+    int pfd = -1, newfd = -1;
+    stream_t *streams = NULL;
+    struct stat sb, newsb;
+    oldfile_t old = { -1, 0, 0, 0, NULL };
+    const bskernels_t *K = bskernels();
+    off_t newsize = 0, patchsize = 0;
+    off_t bzctrllen = 0, bzdatalen = 0;
+    u_char header[40] = {0}, buf[8] = {0};
+    off_t headerlen = 32;
+    int codecs[3] = {0};
+    u_char *new = NULL;
+    off_t oldpos = 0, newpos = 0, oldend = 0;
+    off_t buffered = 0, written = 0;
     off_t ctrl[3] = {0};
-    off_t lenread = 0;
+    off_t lenread = 0, len = 0;
     off_t i = 0;
-    io_funcs_t * io = NULL;
+    int k = 0, created = 0;
     int exitstatus = -1;
 
-    if(argc!=4) {
-        warnx("usage: %s oldfile newfile patchfile\n",argv[0]);
+    /* Open patch file */
+    if ((pfd = open(patchfile, O_RDONLY)) < 0) {
+        warn("open(%s)", patchfile);
         goto cleanup;
     }
-
-    /* Open patch file */
-    if ((f = fopen(argv[3], "r")) == NULL) {
-        warn("fopen(%s)", argv[3]);
+    if (fstat(pfd, &sb) != 0) {
+        warn("fstat(%s)", patchfile);
         goto cleanup;
     }
+    patchsize = sb.st_size;
 
     /*
     File format:
-        0   8   "BSDIFF40" (bzip2) or "BSDIFN40" (raw)
+        0   8   "BSDIFF40" (bzip2), "BSDIFN40" (raw) or "BSDIFC40"
         8   8   X
         16  8   Y
         24  8   sizeof(newfile)
@@ -165,25 +444,47 @@ int bspatch(int argc,const char * const argv[])
         32+X+Y  ??? bzip2(extra block)
     with control block a set of triples (x,y,z) meaning "add x bytes
     from oldfile to x bytes from the diff block; copy y bytes from the
-    extra block; seek forwards in oldfile by z bytes".
+    extra block; seek forwards in oldfile by z bytes". BSDIFC40 patches
+    have 8 more bytes of header at 32, the bscodec_t of the control, diff
+    and extra blocks followed by zeros, and their blocks start at 40.
     */
 
     /* Read header */
-    if (fread(header, 1, 32, f) < 32) {
-        if (feof(f)) {
+    lenread = preadall(pfd, header, 40, 0);
+    if (lenread < 32) {
+        if (lenread >= 0) {
             warnx("Corrupt patch\n");
         } else {
-            warn("fread(%s)", argv[3]);
+            warn("pread(%s)", patchfile);
         }
         goto cleanup;
     }
 
     /* Check for appropriate magic */
-    if (memcmp(header, "BSDIFF40", 8) == 0)
-        io = &BSDIFF40_funcs;
-    else if (memcmp(header, "BSDIFN40", 8) == 0)
-        io = &BSDIFN40_funcs;
-    else {
+    if (memcmp(header, "BSDIFF40", 8) == 0) {
+        codecs[0] = codecs[1] = codecs[2] = BSCODEC_BZIP2;
+    } else if (memcmp(header, "BSDIFN40", 8) == 0) {
+        codecs[0] = codecs[1] = codecs[2] = BSCODEC_RAW;
+    } else if (memcmp(header, "BSDIFC40", 8) == 0 && lenread == 40) {
+        headerlen = 40;
+        for (k = 0; k < 3; k++) {
+            codecs[k] = header[32 + k];
+            if (bscodec_name(codecs[k]) == NULL) {
+                warnx("Corrupt patch\n");
+                goto cleanup;
+            }
+            if (!bscodec_available(codecs[k])) {
+                warnx("Patch uses the %s codec, which is not available", bscodec_name(codecs[k]));
+                goto cleanup;
+            }
+        }
+        for (k = 35; k < 40; k++) {
+            if (header[k] != 0) {
+                warnx("Corrupt patch\n");
+                goto cleanup;
+            }
+        }
+    } else {
         warnx("Corrupt patch\n");
         goto cleanup;
     }
@@ -192,80 +493,54 @@ int bspatch(int argc,const char * const argv[])
     bzctrllen=offtin(header+8);
     bzdatalen=offtin(header+16);
     newsize=offtin(header+24);
-    if((bzctrllen<0) || (bzdatalen<0) || (newsize<0)) {
+    if((bzctrllen<0) || (bzdatalen<0) || (newsize<0) ||
+        (bzctrllen > patchsize - headerlen) || (bzdatalen > patchsize - headerlen - bzctrllen)) {
         warnx("Corrupt patch\n");
         goto cleanup;
     }
 
-    /* Close patch file and re-open it via libbzip2 at the right places */
-    if (fclose(f)) {
-        warn("fclose(%s)", argv[3]);
-        f = NULL;
-        goto cleanup;
-    }
-    f = NULL;
-    
-    if ((cpf = fopen(argv[3], "r")) == NULL) {
-        warn("fopen(%s)", argv[3]);
-        goto cleanup;
-    }
-    if (fseeko(cpf, 32, SEEK_SET)) {
-        warn("fseeko(%s, %lld)", argv[3],
-            (long long)32);
-        goto cleanup;
-    }
-    cstream = io->open(cpf);
-    if (cstream == NULL) {
-        warn("cstream open");
-        goto cleanup;
-    }
-    if ((dpf = fopen(argv[3], "r")) == NULL) {
-        warn("fopen(%s)", argv[3]);
-        goto cleanup;
-    }
-    if (fseeko(dpf, 32 + bzctrllen, SEEK_SET)) {
-        warn("fseeko(%s, %lld)", argv[3],
-            (long long)(32 + bzctrllen));
-        goto cleanup;
-    }
-    dstream = io->open(dpf);
-    if (dstream == NULL) {
-        warn("dstream open");
+    /* Read the control, diff and extra sections from their offsets */
+    if ((streams = calloc(3, sizeof(stream_t))) == NULL) {
+        warn("Failed to allocate memory for streams");
         goto cleanup;
     }
-    if ((epf = fopen(argv[3], "r")) == NULL) {
-        warn("fopen(%s)", argv[3]);
+    if ((stream_open(&streams[0], pfd, headerlen, headerlen + bzctrllen, codecs[0]) != 0) ||
+        (stream_open(&streams[1], pfd, headerlen + bzctrllen, headerlen + bzctrllen + bzdatalen, codecs[1]) != 0) ||
+        (stream_open(&streams[2], pfd, headerlen + bzctrllen + bzdatalen, patchsize, codecs[2]) != 0)) {
+        warnx("Failed to open patch sections");
         goto cleanup;
     }
-    if (fseeko(epf, 32 + bzctrllen + bzdatalen, SEEK_SET)) {
-        warn("fseeko(%s, %lld)", argv[3],
-            (long long)(32 + bzctrllen + bzdatalen));
+
+    /* Open the old file, which is read in place as the triples refer to it */
+    if ((old.fd = open(oldfile, O_RDONLY)) < 0 || fstat(old.fd, &sb) != 0) {
+        warn("old file: %s", oldfile);
         goto cleanup;
     }
-    estream = io->open(epf);
-    if (estream == NULL) {
-        warn("estream open");
+    old.size = sb.st_size;
+
+    /* Writing the new file over the old one would clobber data still to be read */
+    if (stat(newfile, &newsb) == 0 && newsb.st_dev == sb.st_dev && newsb.st_ino == sb.st_ino) {
+        warnx("new file %s is the old file", newfile);
         goto cleanup;
     }
-    off_t size = 0;
-    old = readfile(argv[1], &size);
-    if (old == NULL) {
-        warn("old file: %s", argv[1]);
+
+    if (((old.buf = malloc(BUFFER_SIZE)) == NULL) ||
+        ((new = malloc(BUFFER_SIZE)) == NULL)) {
+        warn("Failed to allocate memory for old or new");
         goto cleanup;
     }
-    
-    oldsize = size;
-    
-    if((new=malloc((size_t)newsize+1))==NULL) {
-        warn("Failed to allocate memory for new");
+
+    if ((newfd = open(newfile, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+        warn("failed to write new file: %s", newfile);
         goto cleanup;
     }
+    created = 1;
 
     oldpos=0;newpos=0;
     while(newpos<newsize) {
         /* Read control data */
         for(i=0;i<=2;i++) {
-            lenread = io->read(cstream, buf, 8);
+            lenread = stream_read(&streams[0], buf, 8);
             if (lenread < 8) {
                 warnx("Corrupt patch\n");
                 goto cleanup;
@@ -274,23 +549,28 @@ int bspatch(int argc,const char * const argv[])
         };
 
         /* Sanity-check */
-        if(newpos+ctrl[0]>newsize) {
+        if((ctrl[0]<0) || (ctrl[1]<0) || (newpos+ctrl[0]>newsize)) {
             warnx("Corrupt patch\n");
             goto cleanup;
         }
 
-        /* Read diff string */
-        lenread = io->read(dstream, new + newpos, ctrl[0]);
-        if (lenread < 0 || lenread < ctrl[0]) {
-            warnx("Corrupt patch\n");
-            goto cleanup;
+        /* Read diff string and add old data to it, a buffer at a time */
+        for (i = 0; i < ctrl[0]; i += len) {
+            len = MIN(ctrl[0] - i, BUFFER_SIZE - buffered);
+            lenread = stream_read(&streams[1], new + buffered, len);
+            if (lenread < 0 || lenread < len) {
+                warnx("Corrupt patch\n");
+                goto cleanup;
+            }
+            if (addold(K, &old, oldpos + i, new + buffered, len) != 0)
+                goto cleanup;
+            buffered += len;
+            if (buffered == BUFFER_SIZE && flushnew(newfd, new, &buffered, &written, newsize, progress, context) != 0) {
+                warn("failed to write to new file: %s", newfile);
+                goto cleanup;
+            }
         }
 
-        /* Add old data to diff string */
-        for(i=0;i<ctrl[0];i++)
-            if((oldpos+i>=0) && (oldpos+i<oldsize))
-                new[newpos+i]+=old[oldpos+i];
-
         /* Adjust pointers */
         newpos+=ctrl[0];
         oldpos+=ctrl[0];
@@ -301,98 +581,80 @@ int bspatch(int argc,const char * const argv[])
             goto cleanup;
         }
 
-        /* Read extra string */
-        lenread = io->read(estream, new + newpos, ctrl[1]);
-        if (lenread < 0 || lenread < ctrl[1]) {
-            warnx("Corrupt patch\n");
-            goto cleanup;
+        /* Read extra string, a buffer at a time */
+        for (i = 0; i < ctrl[1]; i += len) {
+            len = MIN(ctrl[1] - i, BUFFER_SIZE - buffered);
+            lenread = stream_read(&streams[2], new + buffered, len);
+            if (lenread < 0 || lenread < len) {
+                warnx("Corrupt patch\n");
+                goto cleanup;
+            }
+            buffered += len;
+            if (buffered == BUFFER_SIZE && flushnew(newfd, new, &buffered, &written, newsize, progress, context) != 0) {
+                warn("failed to write to new file: %s", newfile);
+                goto cleanup;
+            }
         }
 
-        /* Adjust pointers */
+        /* Adjust pointers, a corrupt seek could overflow the old position */
         newpos+=ctrl[1];
-        oldpos+=ctrl[2];
+        if (__builtin_add_overflow(oldpos, ctrl[2], &oldpos) || __builtin_add_overflow(oldpos, newsize, &oldend)) {
+            warnx("Corrupt patch\n");
+            goto cleanup;
+        }
     };
 
-    /* Clean up the bzip2 reads */
-    io->close(cstream);
-    cstream = NULL;
-    io->close(dstream);
-    dstream = NULL;
-    io->close(estream);
-    estream = NULL;
-    
-    if (fclose(cpf) != 0) {
-        warn("fclose cpf(%s)", argv[3]);
-        cpf = NULL;
+    /* Write the rest of the new file */
+    if (flushnew(newfd, new, &buffered, &written, newsize, progress, context) != 0) {
+        warn("failed to write to new file: %s", newfile);
         goto cleanup;
     }
-    cpf = NULL;
-    
-    if (fclose(dpf) != 0) {
-        warn("fclose dpf(%s)", argv[3]);
-        dpf = NULL;
-        goto cleanup;
-    }
-    dpf = NULL;
-    
-    if (fclose(epf) != 0) {
-        warn("fclose epf(%s)", argv[3]);
-        epf = NULL;
-        goto cleanup;
-    }
-    epf = NULL;
 
-    /* Write the new file */
-    f = fopen(argv[2], "w");
-    if (f == NULL) {
-        warn("failed to write new file: %s", argv[2]);
-        goto cleanup;
-    }
-    
-    if (fwrite(new, 1, (size_t)newsize, f) < (size_t)newsize) {
-        warn("failed to write to new file: %s", argv[2]);
-        goto cleanup;
-    }
-    
-    if (fclose(f) != 0) {
-        warn("failed to close new file: %s", argv[2]);
-        f = NULL;
+    if (close(newfd) != 0) {
+        warn("failed to close new file: %s", newfile);
+        newfd = -1;
         goto cleanup;
     }
-    f = NULL;
-    
+    newfd = -1;
+
     exitstatus = 0;
 cleanup:
     free(new);
-    free(old);
-    
-    if (f != NULL) {
-        fclose(f);
-    }
-    
-    if (estream != NULL) {
-        io->close(estream);
-    }
-    
-    if (epf != NULL) {
-        fclose(epf);
+    free(old.buf);
+
+    if (newfd >= 0) {
+        close(newfd);
     }
-    
-    if (dstream != NULL) {
-        io->close(dstream);
+
+    /* Don't leave a partial new file behind */
+    if (exitstatus != 0 && created) {
+        unlink(newfile);
     }
-    
-    if (dpf != NULL) {
-        fclose(dpf);
+
+    if (old.fd >= 0) {
+        close(old.fd);
     }
-    
-    if (cstream != NULL) {
-        io->close(cstream);
+
+    if (streams != NULL) {
+        for (k = 0; k < 3; k++) {
+            stream_close(&streams[k]);
+        }
+        free(streams);
     }
-    
-    if (cpf != NULL) {
-        fclose(cpf);
+
+    if (pfd >= 0) {
+        close(pfd);
     }
 
     return exitstatus;
 }
+
+int bspatch(int argc,const char * const argv[])
+{
+    if(argc!=4) {
+        warnx("usage: %s oldfile newfile patchfile\n",argv[0]);
+        return -1;
+    }
+
+    return bspatch_file(argv[1], argv[2], argv[3], NULL, NULL);
+}
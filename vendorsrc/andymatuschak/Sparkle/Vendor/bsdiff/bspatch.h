@@ -10,3 +10,13 @@
 // So that we can use this method in SUBinaryDeltaApply.m.
 // Silences the GCC warning that the prototype doesn't exist.
 int bspatch(int argc, const char * const argv[]);
+
+// Called by bspatch_file with the fraction (0..1) of the new file written so far.
+typedef void (*bspatch_progress_t)(void *context, double progress);
+
+// Applies 'patchfile' to 'oldfile' and writes the result to 'newfile'. The old
+// file and the patch are read in place and the new file is written in fixed-size
+// chunks, so memory use does not grow with the size of the files, except for
+// zstd blocks whose decoder keeps a window of up to 2^BS_ZSTD_WINDOWLOG bytes.
+// 'progress' may be NULL. Returns 0 on success, -1 otherwise.
+int bspatch_file(const char *oldfile, const char *newfile, const char *patchfile, bspatch_progress_t progress, void *context);
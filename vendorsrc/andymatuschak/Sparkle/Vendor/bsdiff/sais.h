@@ -32,13 +32,24 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <sys/types.h>
+#include <stdint.h>
 
 #define sais_index_type off_t
 
 /* find the suffix array SA of T[0..n-1]
    use a working space (excluding T and SA) of at most 2n+O(lg n) */
 sais_index_type
-sais(const unsigned char *T, sais_index_type *SA, int n);
+sais(const unsigned char *T, sais_index_type *SA, sais_index_type n);
+
+/* same as sais, inputs of SAIS_PARALLEL_MIN bytes or more are induced
+   using up to nthreads threads when built with SAIS_MAXTHREADS above 1 */
+sais_index_type
+sais64(const unsigned char *T, sais_index_type *SA, sais_index_type n, int nthreads);
+
+/* same as sais64, with 32-bit indices for inputs shorter than 2GB
+   halving the size of SA and of the working space */
+int32_t
+sais32(const unsigned char *T, int32_t *SA, int32_t n, int nthreads);
 
 /* find the suffix array SA of T[0..n-1] in {0..k-1}^n
    use a working space (excluding T and SA) of at most MAX(4k,2n) */
@@ -137,6 +137,64 @@ extern "C" {
      */
     synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner);
     
+    /**
+     *  Options that tune how the scanner parses the synctex file.
+     *  - synctex_parse_option_mapped: big uncompressed synctex files
+     *      are memory mapped and their sheets are parsed concurrently.
+     *      The resulting scanner answers queries exactly like
+     *      a serially parsed one.
+     *  - synctex_parse_option_lazy: only the inputs and the forms
+     *      are parsed at first, each sheet is parsed the first time
+     *      an edit query needs its page or a display query needs its lines.
+     *      The content is kept in memory meanwhile.
+     *      It takes precedence over synctex_parse_option_mapped,
+     *      which is used when the lazy parser does not apply.
+     *  - synctex_parse_option_threaded_inflate: compressed synctex files
+     *      are inflated by other threads while the parser reads them,
+     *      the members of a multi member gzip file are inflated concurrently.
+     */
+    typedef enum {
+        synctex_parse_option_none = 0,
+        synctex_parse_option_mapped = 1 << 0,
+        synctex_parse_option_lazy = 1 << 1,
+        synctex_parse_option_threaded_inflate = 1 << 2,
+    } synctex_parse_option_t;
+    
+    /**
+     *  Set the parse options, a combination of synctex_parse_option_t values.
+     *  Use synctex_scanner_new_with_output_file with parse 0,
+     *  then set the options before sending synctex_scanner_parse.
+     *  - returns: the previous options.
+     */
+    int synctex_scanner_set_parse_options(synctex_scanner_p scanner, int options);
+    
+    /**
+     *  Set the directory where the scanner caches its parsed nodes.
+     *  When the cache is up to date with the synctex file,
+     *  synctex_scanner_parse creates the nodes from the cache,
+     *  without decompressing nor parsing the synctex file.
+     *  Otherwise the whole synctex file is parsed, ignoring
+     *  synctex_parse_option_lazy, and the cache is updated.
+     *  The cache file is named after the synctex path.
+     *  Set it before sending synctex_scanner_parse.
+     *  - returns: 0 on success, -1 when caching is not available.
+     */
+    int synctex_scanner_set_cache_directory(synctex_scanner_p scanner, const char * directory);
+    
+    /**
+     *  Reuse the sheets already parsed by a previous scanner,
+     *  typically for the same output after the document was typeset again.
+     *  Each sheet with the same content as a previous one, up to its page number,
+     *  is taken from previous instead of being parsed,
+     *  such that only the sheets that changed are parsed again.
+     *  Only a lazy previous scanner has sheets to reuse,
+     *  and only the lazy parser of scanner reuses them.
+     *  previous is freed in any case and must not be used anymore.
+     *  Set it before sending synctex_scanner_parse.
+     *  - returns: 0 on success, -1 when there is nothing to reuse.
+     */
+    int synctex_scanner_set_previous(synctex_scanner_p scanner, synctex_scanner_p previous);
+    
     /*  synctex_node_p is the type for all synctex nodes.
      *  Its implementation is considered private.
      *  The synctex file is parsed into a tree of nodes, either sheet, form, boxes, math nodes... */
@@ -200,6 +258,9 @@ extern "C" {
      *  when in doubt. Using pdf forms may lead to ambiguities.
      */
     synctex_status_t synctex_display_query(synctex_scanner_p scanner,const char *  name,int line,int column, int page_hint);
+    /*  Same as synctex_display_query, for the input with the given tag,
+     *  for clients that resolve file names themselves, see synctex_scanner_get_tag. */
+    synctex_status_t synctex_display_query_tag(synctex_scanner_p scanner,int tag,int line,int column, int page_hint);
     synctex_status_t synctex_edit_query(synctex_scanner_p scanner,int page,float h,float v);
     synctex_node_p synctex_scanner_next_result(synctex_scanner_p scanner);
     synctex_status_t synctex_scanner_reset_result(synctex_scanner_p scanner);
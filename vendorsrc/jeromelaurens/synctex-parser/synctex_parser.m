@@ -111,6 +111,68 @@
 #include <locale.h>
 #endif
 
+/*  Uncompressed synctex files can be memory mapped and parsed concurrently,
+ *  see synctex_parse_option_mapped. Define SYNCTEX_NO_MAPPED_PARSE to opt out. */
+#if !defined(_WIN32) && !defined(SYNCTEX_NO_MAPPED_PARSE)
+#   define SYNCTEX_USE_MAPPED_PARSE 1
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <pthread.h>
+#endif
+
+/*  Compressed synctex files can be inflated by other threads, see synctex_parse_option_threaded_inflate.
+ *  Define SYNCTEX_NO_THREADED_INFLATE to opt out. */
+#if defined(SYNCTEX_USE_MAPPED_PARSE) && !defined(SYNCTEX_NO_THREADED_INFLATE)
+#   define SYNCTEX_USE_THREADED_INFLATE 1
+#endif
+
+/*  The sheets can be visited concurrently by a batch of display queries, see synctex_display_batch_new.
+ *  Define SYNCTEX_NO_THREADED_DISPLAY_BATCH to opt out. */
+#if defined(SYNCTEX_USE_MAPPED_PARSE) && !defined(SYNCTEX_NO_THREADED_DISPLAY_BATCH)
+#   define SYNCTEX_USE_THREADED_DISPLAY_BATCH 1
+#endif
+
+/*  The parsed nodes can be cached on disk, see synctex_scanner_set_cache_directory.
+ *  Define SYNCTEX_NO_CACHE to opt out. */
+#if !defined(_WIN32) && !defined(SYNCTEX_NO_CACHE)
+#   define SYNCTEX_USE_CACHE 1
+#   include <stddef.h>
+#   include <stdint.h>
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+/*  Nodes are allocated in memory mapped blocks, see the arenas.
+ *  Define SYNCTEX_NO_MAPPED_ARENA to use malloc'ed blocks instead. */
+#if !defined(_WIN32) && !defined(SYNCTEX_NO_MAPPED_ARENA)
+#   define SYNCTEX_USE_MAPPED_ARENA 1
+#   include <sys/mman.h>
+#endif
+
+/*  The tokenizer scans the buffer several bytes at a time, with SSE2, AVX2 or NEON when available,
+ *  see the Tokenizer section. Define SYNCTEX_NO_SIMD to scan one byte at a time. */
+#if !defined(SYNCTEX_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) \
+    && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define SYNCTEX_USE_SWAR 1
+#   include <stdint.h>
+#   if defined(__SSE2__)
+#       define SYNCTEX_USE_SSE2 1
+#       include <immintrin.h>
+#       if defined(__x86_64__) || defined(__i386__)
+#           define SYNCTEX_USE_AVX2 1
+#       endif
+#   elif defined(__ARM_NEON)
+#       define SYNCTEX_USE_NEON 1
+#       include <arm_neon.h>
+#   endif
+#endif
+
 /* Mark unused parameters, so that there will be no compile warnings. */
 #ifdef __DARWIN_UNIX03
 #   define SYNCTEX_UNUSED(x) SYNCTEX_PRAGMA(unused(x))
@@ -296,6 +358,7 @@ static void synctex_node_free(synctex_node_p node) {
 #       endif
 #   endif
 SYNCTEX_INLINE static synctex_node_p _synctex_new_handle_with_target(synctex_node_p target);
+SYNCTEX_INLINE static synctex_node_p _synctex_new_node_handle_with_target(synctex_node_p target);
 #   if defined(SYNCTEX_USE_HANDLE)
 #       define SYNCTEX_SCANNER_FREE_HANDLE(SCANR) \
 __synctex_scanner_free_handle(SCANR)
@@ -536,8 +599,10 @@ DEFINE_SYNCTEX_TREE_GETSETRESET(target)
 #   error BAD BUFFER SIZE(2)
 #endif
 
+typedef struct synctex_inflater_t * synctex_inflater_p;
 typedef struct synctex_reader_t {
     gzFile file;    /*  The (possibly compressed) file */
+    synctex_inflater_p inflater; /*  When not NULL, file is read through the inflater */
     char * output;
     char * synctex;
     char * current; /*  current location in the buffer */
@@ -548,6 +613,7 @@ typedef struct synctex_reader_t {
     int lastv;
     int line_number;
     SYNCTEX_DECLARE_CHAR_OFFSET
+    char * stop;    /*  end of the chunk in the mapped parser */
 } synctex_reader_s;
 
 typedef synctex_reader_s * synctex_reader_p;
@@ -733,12 +799,446 @@ static synctex_open_s _synctex_open_v2(const char * output, const char * build_d
     } /* if (build_directory...) */
     return open;
 }
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Inflater
+#   endif
+
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+/*  The inflater decompresses a gzip synctex file in a decoder thread, concurrently with the parser.
+ *  The compressed file is memory mapped. The decoder fills a ring of large slots,
+ *  it waits when all the slots are full, the reader waits when all the slots are read.
+ *  The reader keeps the slot before the one it reads, such that it can seek back a little,
+ *  see _synctex_match_string.
+ *  When the file has several gzip members, the following members are inflated concurrently
+ *  by other threads, the decoder then only copies them into the ring, in order.
+ *  As the member boundaries are only known after inflation, these threads start
+ *  at every place that looks like a gzip header, and the false starts are discarded. */
+#       define SYNCTEX_INFLATER_NUMBER_OF_SLOTS 6
+#       define SYNCTEX_INFLATER_SLOT_SIZE (1<<20)
+#       define SYNCTEX_INFLATER_MAX_MEMBER_THREADS 8
+
+typedef struct {
+    char * bytes;
+    size_t size;
+    z_off_t offset; /*  The offset of bytes in the inflated file */
+} synctex_inflater_slot_s;
+
+typedef struct synctex_inflater_member_t {
+    struct synctex_inflater_t * inflater;
+    size_t start;   /*  The offset of the gzip header in the compressed file */
+    size_t end;     /*  The offset following the gzip trailer */
+    char * bytes;   /*  The inflated member */
+    size_t size;
+    int status;     /*  Z_STREAM_END on success */
+    pthread_t thread;
+} synctex_inflater_member_s;
+
+struct synctex_inflater_t {
+    const unsigned char * deflated;
+    size_t deflated_size;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t filled;
+    pthread_cond_t emptied;
+    synctex_inflater_slot_s slots[SYNCTEX_INFLATER_NUMBER_OF_SLOTS];
+    /*  The slots in [consumed, produced) belong to the reader, the others to the decoder. */
+    unsigned long produced;
+    unsigned long consumed;
+    synctex_bool_t done;
+    synctex_bool_t cancelled;
+    int error;
+    /*  Decoder side */
+    z_off_t inflated_size;
+    int number_of_members;
+    int number_of_concurrent_members;
+    /*  Reader side */
+    unsigned long current;
+    size_t position;
+    z_off_t offset;
+};
+typedef struct synctex_inflater_t synctex_inflater_s;
+
+static synctex_bool_t _synctex_inflater_is_cancelled(synctex_inflater_p inflater) {
+    synctex_bool_t cancelled;
+    pthread_mutex_lock(&inflater->mutex);
+    cancelled = inflater->cancelled;
+    pthread_mutex_unlock(&inflater->mutex);
+    return cancelled;
+}
+/*  The slot to fill, waiting for the reader to release one if necessary.
+ *  - returns: NULL when the inflater is cancelled. */
+static synctex_inflater_slot_s * _synctex_inflater_slot(synctex_inflater_p inflater) {
+    synctex_inflater_slot_s * slot = NULL;
+    pthread_mutex_lock(&inflater->mutex);
+    while (!inflater->cancelled
+           && inflater->produced-inflater->consumed>=SYNCTEX_INFLATER_NUMBER_OF_SLOTS) {
+        pthread_cond_wait(&inflater->emptied,&inflater->mutex);
+    }
+    if (!inflater->cancelled) {
+        slot = inflater->slots+inflater->produced%SYNCTEX_INFLATER_NUMBER_OF_SLOTS;
+        slot->size = 0;
+    }
+    pthread_mutex_unlock(&inflater->mutex);
+    return slot;
+}
+/*  Hand the slot being filled to the reader. */
+static void _synctex_inflater_publish(synctex_inflater_p inflater, synctex_inflater_slot_s * slot) {
+    if (slot->size) {
+        pthread_mutex_lock(&inflater->mutex);
+        slot->offset = inflater->inflated_size;
+        inflater->inflated_size += slot->size;
+        ++inflater->produced;
+        pthread_cond_signal(&inflater->filled);
+        pthread_mutex_unlock(&inflater->mutex);
+    }
+}
+/*  Copy the given bytes to the ring. */
+static synctex_inflater_slot_s * _synctex_inflater_push(synctex_inflater_p inflater, synctex_inflater_slot_s * slot, const char * bytes, size_t size) {
+    while (size) {
+        size_t n;
+        if (NULL == slot && NULL == (slot = _synctex_inflater_slot(inflater))) {
+            return NULL;
+        }
+        if ((n = SYNCTEX_INFLATER_SLOT_SIZE-slot->size)>size) {
+            n = size;
+        }
+        memcpy(slot->bytes+slot->size,bytes,n);
+        slot->size += n;
+        bytes += n;
+        size -= n;
+        if (slot->size == SYNCTEX_INFLATER_SLOT_SIZE) {
+            _synctex_inflater_publish(inflater,slot);
+            slot = NULL;
+        }
+    }
+    return slot;
+}
+/*  Whether a gzip header may start at the given offset. */
+static synctex_bool_t _synctex_inflater_is_member(synctex_inflater_p inflater, size_t offset) {
+    const unsigned char * header = inflater->deflated+offset;
+    return offset+18<=inflater->deflated_size
+        && header[0] == 0x1f && header[1] == 0x8b && header[2] == Z_DEFLATED && (header[3]&0xE0) == 0;
+}
+/*  The next offset after the given one where a gzip header may start, deflated_size if none. */
+static size_t _synctex_inflater_next_member(synctex_inflater_p inflater, size_t offset) {
+    while (++offset<inflater->deflated_size) {
+        const unsigned char * next = memchr(inflater->deflated+offset,0x1f,inflater->deflated_size-offset);
+        if (NULL == next) {
+            break;
+        }
+        offset = next-inflater->deflated;
+        if (_synctex_inflater_is_member(inflater,offset)) {
+            return offset;
+        }
+    }
+    return inflater->deflated_size;
+}
+/*  Inflate the member starting at member->start, either in the ring with backpressure
+ *  when slot_ref is not NULL, or in member->bytes otherwise. */
+static void _synctex_inflater_inflate(synctex_inflater_member_s * member, synctex_inflater_slot_s ** slot_ref) {
+    synctex_inflater_p inflater = member->inflater;
+    size_t capacity = 0;
+    z_stream stream;
+    memset(&stream,0,sizeof(stream));
+    member->end = member->start;
+    if ((member->status = inflateInit2(&stream,16+MAX_WBITS)) != Z_OK) {
+        return;
+    }
+    stream.next_in = (Bytef *)inflater->deflated+member->start;
+    stream.avail_in = (uInt)(inflater->deflated_size-member->start);
+    do {
+        if (slot_ref) {
+            if (NULL == *slot_ref && NULL == (*slot_ref = _synctex_inflater_slot(inflater))) {
+                member->status = Z_STREAM_ERROR;
+                break;
+            }
+            stream.next_out = (Bytef *)(*slot_ref)->bytes+(*slot_ref)->size;
+            stream.avail_out = (uInt)(SYNCTEX_INFLATER_SLOT_SIZE-(*slot_ref)->size);
+        } else {
+            if (member->size == capacity) {
+                char * bytes = (char *)realloc(member->bytes,capacity = capacity? 2*capacity: SYNCTEX_INFLATER_SLOT_SIZE);
+                if (NULL == bytes) {
+                    member->status = Z_MEM_ERROR;
+                    break;
+                }
+                member->bytes = bytes;
+            }
+            if (_synctex_inflater_is_cancelled(inflater)) {
+                member->status = Z_STREAM_ERROR;
+                break;
+            }
+            stream.next_out = (Bytef *)member->bytes+member->size;
+            stream.avail_out = (uInt)(capacity-member->size);
+        }
+        member->status = inflate(&stream,Z_NO_FLUSH);
+        if (slot_ref) {
+            (*slot_ref)->size = SYNCTEX_INFLATER_SLOT_SIZE-stream.avail_out;
+            if ((*slot_ref)->size == SYNCTEX_INFLATER_SLOT_SIZE) {
+                _synctex_inflater_publish(inflater,*slot_ref);
+                *slot_ref = NULL;
+            }
+        } else {
+            member->size = capacity-stream.avail_out;
+        }
+    } while (member->status == Z_OK);
+    member->end = stream.next_in-inflater->deflated;
+    inflateEnd(&stream);
+}
+static void * _synctex_inflater_member_main(void * arg) {
+    _synctex_inflater_inflate((synctex_inflater_member_s *)arg,NULL);
+    return NULL;
+}
+static void * _synctex_inflater_main(void * arg) {
+    synctex_inflater_p inflater = (synctex_inflater_p)arg;
+    synctex_inflater_member_s members[SYNCTEX_INFLATER_MAX_MEMBER_THREADS];
+    synctex_inflater_slot_s * slot = NULL;
+    long number_of_threads = sysconf(_SC_NPROCESSORS_ONLN)-1;
+    size_t offset = 0, next = 0;
+    int first = 0, last = 0;
+    if (number_of_threads>SYNCTEX_INFLATER_MAX_MEMBER_THREADS) {
+        number_of_threads = SYNCTEX_INFLATER_MAX_MEMBER_THREADS;
+    }
+    /*  members[first%MAX...last%MAX] are being inflated by other threads, in increasing start order. */
+    while (offset<inflater->deflated_size && (offset == 0 || _synctex_inflater_is_member(inflater,offset))) {
+        synctex_inflater_member_s member = {inflater,offset,offset,NULL,0,Z_OK,0};
+        /*  Start the following possible members. */
+        if (next<=offset) {
+            next = offset;
+        }
+        while (last-first<number_of_threads
+               && (next = _synctex_inflater_next_member(inflater,next))<inflater->deflated_size) {
+            synctex_inflater_member_s * m = members+last%SYNCTEX_INFLATER_MAX_MEMBER_THREADS;
+            *m = (synctex_inflater_member_s){inflater,next,next,NULL,0,Z_OK,0};
+            if (pthread_create(&m->thread,NULL,_synctex_inflater_member_main,m)) {
+                break;
+            }
+            ++last;
+        }
+        /*  Discard the false starts before offset, then take the member at offset if any. */
+        while (first<last && members[first%SYNCTEX_INFLATER_MAX_MEMBER_THREADS].start<=offset) {
+            synctex_inflater_member_s * m = members+first%SYNCTEX_INFLATER_MAX_MEMBER_THREADS;
+            pthread_join(m->thread,NULL);
+            if (m->start == offset && m->status == Z_STREAM_END) {
+                member = *m;
+            } else {
+                free(m->bytes);
+            }
+            ++first;
+        }
+        if (member.status == Z_STREAM_END) {
+            slot = _synctex_inflater_push(inflater,slot,member.bytes,member.size);
+            free(member.bytes);
+            ++inflater->number_of_concurrent_members;
+        } else {
+            _synctex_inflater_inflate(&member,&slot);
+            if (member.status != Z_STREAM_END) {
+                /*  A truncated file is not an error, like with gzread. */
+                if (member.status != Z_BUF_ERROR) {
+                    inflater->error = member.status;
+                }
+                break;
+            }
+        }
+        ++inflater->number_of_members;
+        offset = member.end;
+        if (_synctex_inflater_is_cancelled(inflater)) {
+            break;
+        }
+    }
+    while (first<last) {
+        synctex_inflater_member_s * m = members+first++%SYNCTEX_INFLATER_MAX_MEMBER_THREADS;
+        pthread_join(m->thread,NULL);
+        free(m->bytes);
+    }
+    if (slot) {
+        _synctex_inflater_publish(inflater,slot);
+    }
+    pthread_mutex_lock(&inflater->mutex);
+    inflater->done = synctex_YES;
+    pthread_cond_signal(&inflater->filled);
+    pthread_mutex_unlock(&inflater->mutex);
+    return NULL;
+}
+static void _synctex_inflater_free(synctex_inflater_p inflater) {
+    if (inflater) {
+        int i;
+        pthread_mutex_lock(&inflater->mutex);
+        inflater->cancelled = synctex_YES;
+        pthread_cond_signal(&inflater->emptied);
+        pthread_mutex_unlock(&inflater->mutex);
+        pthread_join(inflater->thread,NULL);
+        pthread_cond_destroy(&inflater->emptied);
+        pthread_cond_destroy(&inflater->filled);
+        pthread_mutex_destroy(&inflater->mutex);
+        for (i=0;i<SYNCTEX_INFLATER_NUMBER_OF_SLOTS;++i) {
+            free(inflater->slots[i].bytes);
+        }
+        munmap((void *)inflater->deflated,inflater->deflated_size);
+        _synctex_free(inflater);
+    }
+}
+/**
+ *  Start inflating the given gzip file.
+ *  - returns: NULL on failure, the file must then be read as usual.
+ */
+static synctex_inflater_p _synctex_inflater_new(const char * path) {
+    synctex_inflater_p inflater = NULL;
+    struct stat st;
+    void * map = MAP_FAILED;
+    int fd = open(path,O_RDONLY);
+    int i;
+    if (fd<0) {
+        return NULL;
+    }
+    if (!fstat(fd,&st) && st.st_size>0 && (unsigned long long)st.st_size<UINT_MAX) {
+        map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    }
+    close(fd);
+    if (MAP_FAILED == map) {
+        return NULL;
+    }
+    if (NULL == (inflater = (synctex_inflater_p)_synctex_malloc(sizeof(synctex_inflater_s)))) {
+        munmap(map,(size_t)st.st_size);
+        return NULL;
+    }
+    inflater->deflated = (const unsigned char *)map;
+    inflater->deflated_size = (size_t)st.st_size;
+    for (i=0;i<SYNCTEX_INFLATER_NUMBER_OF_SLOTS;++i) {
+        if (NULL == (inflater->slots[i].bytes = (char *)malloc(SYNCTEX_INFLATER_SLOT_SIZE))) {
+            goto bail;
+        }
+    }
+    if (!_synctex_inflater_is_member(inflater,0)) {
+        goto bail;
+    }
+    pthread_mutex_init(&inflater->mutex,NULL);
+    pthread_cond_init(&inflater->filled,NULL);
+    pthread_cond_init(&inflater->emptied,NULL);
+    if (pthread_create(&inflater->thread,NULL,_synctex_inflater_main,inflater)) {
+        pthread_cond_destroy(&inflater->emptied);
+        pthread_cond_destroy(&inflater->filled);
+        pthread_mutex_destroy(&inflater->mutex);
+        goto bail;
+    }
+    return inflater;
+bail:
+    for (i=0;i<SYNCTEX_INFLATER_NUMBER_OF_SLOTS;++i) {
+        free(inflater->slots[i].bytes);
+    }
+    munmap(map,(size_t)st.st_size);
+    _synctex_free(inflater);
+    return NULL;
+}
+/*  Like gzread. */
+static int _synctex_inflater_read(synctex_inflater_p inflater, char * buffer, unsigned size) {
+    unsigned already_read = 0;
+    while (already_read<size) {
+        synctex_inflater_slot_s * slot;
+        size_t n;
+        pthread_mutex_lock(&inflater->mutex);
+        while (inflater->current>=inflater->produced && !inflater->done) {
+            pthread_cond_wait(&inflater->filled,&inflater->mutex);
+        }
+        if (inflater->current>=inflater->produced) {
+            pthread_mutex_unlock(&inflater->mutex);
+            if (inflater->error && 0 == already_read) {
+                return -1;
+            }
+            break;
+        }
+        pthread_mutex_unlock(&inflater->mutex);
+        slot = inflater->slots+inflater->current%SYNCTEX_INFLATER_NUMBER_OF_SLOTS;
+        if ((n = slot->size-inflater->position)>size-already_read) {
+            n = size-already_read;
+        }
+        memcpy(buffer+already_read,slot->bytes+inflater->position,n);
+        already_read += n;
+        inflater->position += n;
+        inflater->offset += n;
+        if (inflater->position == slot->size) {
+            /*  Next slot, the previous one is released. */
+            ++inflater->current;
+            inflater->position = 0;
+            pthread_mutex_lock(&inflater->mutex);
+            if (inflater->consumed+1<inflater->current) {
+                inflater->consumed = inflater->current-1;
+                pthread_cond_signal(&inflater->emptied);
+            }
+            pthread_mutex_unlock(&inflater->mutex);
+        }
+    }
+    return (int)already_read;
+}
+/*  Like gzseek, but only in the slots not yet released. */
+static z_off_t _synctex_inflater_seek(synctex_inflater_p inflater, z_off_t offset) {
+    unsigned long i;
+    pthread_mutex_lock(&inflater->mutex);
+    for (i = inflater->consumed; i<inflater->produced && i<=inflater->current; ++i) {
+        synctex_inflater_slot_s * slot = inflater->slots+i%SYNCTEX_INFLATER_NUMBER_OF_SLOTS;
+        if (slot->offset<=offset && offset<=slot->offset+(z_off_t)slot->size) {
+            inflater->current = i;
+            inflater->position = (size_t)(offset-slot->offset);
+            inflater->offset = offset;
+            pthread_mutex_unlock(&inflater->mutex);
+            return offset;
+        }
+    }
+    pthread_mutex_unlock(&inflater->mutex);
+    return -1;
+}
+#   endif
+/*  Read the file through the inflater if any, like gzread. */
+static int _synctex_reader_read(synctex_reader_p reader, char * buffer, unsigned size) {
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+    if (reader->inflater) {
+        return _synctex_inflater_read(reader->inflater,buffer,size);
+    }
+#   endif
+    return gzread(reader->file,buffer,size);
+}
+static z_off_t _synctex_reader_tell(synctex_reader_p reader) {
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+    if (reader->inflater) {
+        return reader->inflater->offset;
+    }
+#   endif
+    return gztell(reader->file);
+}
+static z_off_t _synctex_reader_seek(synctex_reader_p reader, z_off_t offset) {
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+    if (reader->inflater) {
+        return _synctex_inflater_seek(reader->inflater,offset);
+    }
+#   endif
+    return gzseek(reader->file,offset,SEEK_SET);
+}
+/*  Start the inflater if the file is compressed and was not read yet. */
+static void _synctex_reader_start_inflater(synctex_reader_p reader) {
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+    if (reader->file && NULL == reader->inflater && !gzdirect(reader->file) && gztell(reader->file) == 0) {
+        reader->inflater = _synctex_inflater_new(reader->synctex);
+    }
+#   else
+    SYNCTEX_UNUSED(reader)
+#   endif
+}
+static void _synctex_reader_close(synctex_reader_p reader) {
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+    _synctex_inflater_free(reader->inflater);
+    reader->inflater = NULL;
+#   endif
+    if (reader->file) {
+        gzclose(reader->file);
+        reader->file = NULL;
+    }
+}
 static void synctex_reader_free(synctex_reader_p reader) {
     if (reader) {
         _synctex_free(reader->output);
         _synctex_free(reader->synctex);
         _synctex_free(reader->start);
-        gzclose(reader->file);
+        _synctex_reader_close(reader);
         _synctex_free(reader);
     }
 }
@@ -798,6 +1298,141 @@ static synctex_reader_p synctex_reader_init_with_output_file(synctex_reader_p re
 #       define SYNCTEX_DECLARE_HANDLE
 #   endif
 
+#   ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark ARENAS
+#   endif
+/**
+ *  Nodes are not allocated one by one, they live in the arena of their scanner,
+ *  a list of large blocks that are only released by synctex_scanner_free.
+ *  Freeing a node only unregisters it, the memory is not reused.
+ *  Handles for query results live in a separate arena, owned by the query iterator
+ *  and recycled when the iterator is freed.
+ *  Blocks are zero filled like _synctex_malloc, their size doubles up to SYNCTEX_ARENA_MAX_BLOCK_SIZE.
+ */
+#   if !defined(SYNCTEX_ARENA_MIN_BLOCK_SIZE)
+#       define SYNCTEX_ARENA_MIN_BLOCK_SIZE (64*1024)
+#   endif
+#   if !defined(SYNCTEX_ARENA_MAX_BLOCK_SIZE)
+#       define SYNCTEX_ARENA_MAX_BLOCK_SIZE (4*1024*1024)
+#   endif
+#   define SYNCTEX_ARENA_ALIGN(SIZE) (((SIZE)+15)&~(size_t)15)
+
+typedef struct synctex_arena_block_t * synctex_arena_block_p;
+struct synctex_arena_block_t {
+    synctex_arena_block_p next; /*  the previous block of the arena */
+    size_t size;                /*  including this header */
+};
+typedef struct synctex_arena_t synctex_arena_s;
+typedef synctex_arena_s * synctex_arena_p;
+struct synctex_arena_t {
+    synctex_arena_block_p block;    /*  the current block */
+    char * ptr;                     /*  the free space of the current block */
+    char * end;
+    size_t number_of_allocations;   /*  statistics */
+    size_t number_of_blocks;
+    size_t size;
+    synctex_arena_p next;           /*  for spare query arenas */
+};
+
+static synctex_arena_block_p _synctex_arena_new_block(size_t size) {
+    synctex_arena_block_p block = NULL;
+#   if defined(SYNCTEX_USE_MAPPED_ARENA)
+    void * map = mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANON,-1,0);
+    if (map != MAP_FAILED) {
+        block = (synctex_arena_block_p)map;
+    }
+#   else
+    block = (synctex_arena_block_p)_synctex_malloc(size);
+#   endif
+    if (block) {
+        block->size = size;
+    }
+    return block;
+}
+static void _synctex_arena_free_block(synctex_arena_block_p block) {
+#   if defined(SYNCTEX_USE_MAPPED_ARENA)
+    munmap(block,block->size);
+#   else
+    _synctex_free(block);
+#   endif
+}
+/*  Releases all the blocks, the arena can be used again. */
+static void _synctex_arena_free(synctex_arena_p arena) {
+    synctex_arena_block_p block = arena->block;
+    while (block) {
+        synctex_arena_block_p next = block->next;
+        _synctex_arena_free_block(block);
+        block = next;
+    }
+    arena->block = NULL;
+    arena->ptr = arena->end = NULL;
+}
+/*  Zero filled memory of the given size, NULL on memory problems. */
+static void * _synctex_arena_malloc(synctex_arena_p arena, size_t size) {
+    char * result = NULL;
+    size = SYNCTEX_ARENA_ALIGN(size);
+    if (arena->ptr+size > arena->end || !arena->ptr) {
+        size_t header = SYNCTEX_ARENA_ALIGN(sizeof(struct synctex_arena_block_t));
+        size_t block_size = arena->block? 2*arena->block->size: SYNCTEX_ARENA_MIN_BLOCK_SIZE;
+        synctex_arena_block_p block;
+        if (block_size > SYNCTEX_ARENA_MAX_BLOCK_SIZE) {
+            block_size = SYNCTEX_ARENA_MAX_BLOCK_SIZE;
+        }
+        if (block_size < header+size) {
+            block_size = header+size;
+        }
+        if (!(block = _synctex_arena_new_block(block_size))) {
+            _synctex_error("!  _synctex_arena_malloc: Memory problem.");
+            return NULL;
+        }
+        block->next = arena->block;
+        arena->block = block;
+        arena->ptr = (char *)block+header;
+        arena->end = (char *)block+block_size;
+        ++arena->number_of_blocks;
+        arena->size += block_size;
+    }
+    result = arena->ptr;
+    arena->ptr += size;
+    ++arena->number_of_allocations;
+    return result;
+}
+/*  Keep the current block only, zero filled again. */
+static void _synctex_arena_reset(synctex_arena_p arena) {
+    synctex_arena_block_p block = arena->block;
+    if (block) {
+        size_t header = SYNCTEX_ARENA_ALIGN(sizeof(struct synctex_arena_block_t));
+        _synctex_arena_free(&(synctex_arena_s){block->next,NULL,NULL,0,0,0,NULL});
+        block->next = NULL;
+        memset((char *)block+header,0,arena->ptr-((char *)block+header));
+        arena->ptr = (char *)block+header;
+    }
+}
+/*  Move all the blocks of other to arena, other is left empty. */
+static void _synctex_arena_adopt(synctex_arena_p arena, synctex_arena_p other) {
+    synctex_arena_block_p block = other->block;
+    if (block) {
+        while (block->next) {
+            block = block->next;
+        }
+        if (arena->block) {
+            /*  other's blocks come after the current block, which is not full */
+            block->next = arena->block->next;
+            arena->block->next = other->block;
+        } else {
+            arena->block = other->block;
+            arena->ptr = other->ptr;
+            arena->end = other->end;
+        }
+        arena->number_of_allocations += other->number_of_allocations;
+        arena->number_of_blocks += other->number_of_blocks;
+        arena->size += other->size;
+        other->block = NULL;
+        other->ptr = other->end = NULL;
+    }
+}
+
 #   ifdef SYNCTEX_NOTHING
 #       pragma mark -
 #       pragma mark SCANNER
@@ -807,6 +1442,15 @@ static synctex_reader_p synctex_reader_init_with_output_file(synctex_reader_p re
  *  Is is initialized with the contents of a text file or a gzipped file.
  *  The buffer_.* are first used to parse the text.
  */
+typedef struct synctex_lazy_t * synctex_lazy_p;
+typedef struct synctex_edit_index_t * synctex_edit_index_p;
+typedef struct synctex_display_index_t * synctex_display_index_p;
+typedef struct synctex_reload_t * synctex_reload_p;
+typedef struct {
+    synctex_node_p * by_tag;/*  The first input with each tag, or NULL */
+    int size;               /*  The number of entries of by_tag */
+    synctex_node_p last;    /*  The last input, what the linear lookup answers for an unknown tag */
+} synctex_input_table_s;
 struct synctex_scanner_t {
     synctex_reader_p reader;
     SYNCTEX_DECLARE_NODE_COUNT
@@ -817,8 +1461,22 @@ struct synctex_scanner_t {
     struct {
         unsigned has_parsed:1;		/*  Whether the scanner has parsed its underlying synctex file. */
         unsigned postamble:1;		/*  Whether the scanner has parsed its underlying synctex file. */
-        unsigned reserved:sizeof(unsigned)-2;	/*  alignment */
+        unsigned chunk:1;		/*  Whether the scanner only parses a chunk of the content, see the mapped parser. */
+        unsigned lost_lastv:1;		/*  Whether a chunk used the '=' v shortcut before any v field was scanned. */
+        unsigned new_friends:1;		/*  Whether friends were registered since the display index was updated. */
+        unsigned new_inputs:1;		/*  Whether the input list changed since the input table was updated. */
+        unsigned reserved:8*sizeof(unsigned)-6;	/*  alignment */
     } flags;
+    int parse_options;      /*  see synctex_scanner_set_parse_options */
+    char * cache_directory; /*  see synctex_scanner_set_cache_directory */
+    synctex_lazy_p lazy;    /*  The sheets not yet parsed, see the lazy parser */
+    synctex_reload_p reload;/*  The sheets of a previous scanner, see synctex_scanner_set_previous */
+    synctex_edit_index_p * edit_indexes;    /*  The edit query grids, by page, see the edit index */
+    int number_of_edit_indexes;
+    synctex_display_index_p display_index;  /*  The friends by tag and line, see the display index */
+    synctex_arena_s arena;          /*  The memory of the nodes, see the arenas */
+    synctex_arena_p query_arena;    /*  The memory of the handles of the current query */
+    synctex_arena_p spare_arenas;   /*  Query arenas to be reused */
     int pre_magnification;  /*  magnification from the synctex preamble */
     int pre_unit;           /*  unit from the synctex preamble */
     int pre_x_offset;       /*  X offset from the synctex preamble */
@@ -828,6 +1486,7 @@ struct synctex_scanner_t {
     float x_offset;         /*  X offset, from synctex preamble or post scriptum */
     float y_offset;         /*  Y Offset, from synctex preamble or post scriptum */
     synctex_node_p input;   /*  The first input node, its siblings are the other input nodes */
+    synctex_input_table_s input_table;  /*  The input nodes by tag, see synctex_scanner_input_with_tag */
     synctex_node_p sheet;   /*  The first sheet node, its siblings are the other sheet nodes */
     synctex_node_p form;    /*  The first form, its siblings are the other forms */
     synctex_node_p ref_in_sheet; /*  The first form ref node in sheet, its friends are the other form ref nodes */
@@ -874,7 +1533,7 @@ SYNCTEX_INLINE static void __synctex_scanner_remove_handle_to(synctex_node_p nod
     }
 }
 SYNCTEX_INLINE static void __synctex_scanner_register_handle_to(synctex_node_p  node) {
-    synctex_node_p NNN = _synctex_new_handle_with_target(node);
+    synctex_node_p NNN = _synctex_new_node_handle_with_target(node);
     __synctex_tree_set_sibling(NNN,node->class_->scanner->handle);
     node->class_->scanner->handle = NNN;
 }
@@ -900,6 +1559,7 @@ SYNCTEX_INLINE static void _synctex_will_free(synctex_node_p node) {
  *  - note: a node is meant to own its child and sibling.
  *  It is not owned by its parent, unless it is its first child.
  *  This destructor is for all nodes with children.
+ *  The memory belongs to the arena of the scanner and is only released with it.
  */
 static void _synctex_free_node(synctex_node_p node) {
     if (node) {
@@ -907,7 +1567,6 @@ static void _synctex_free_node(synctex_node_p node) {
         SYNCTEX_WILL_FREE(node);
         synctex_node_free(__synctex_tree_sibling(node));
         synctex_node_free(_synctex_tree_child(node));
-        _synctex_free(node);
     }
     return;
 }
@@ -928,30 +1587,12 @@ static void _synctex_free_handle_old(synctex_node_p handle) {
   return;
 }
  */
+/*  Handles live in the arena of the query or the parser that created them,
+ *  or in the arena of the scanner for the handle registry.
+ *  There is nothing to free individually. */
 static void _synctex_free_handle(synctex_node_p handle) {
-  if (handle) {
-    synctex_node_p n = handle;
-    synctex_node_p nn;
-    __synctex_tree_set_parent(n, NULL);
-  down:
-    while ((nn = _synctex_tree_child(n))) {
-      n = nn;
-    };
-  right:
-    nn = __synctex_tree_sibling(n);
-    if (nn) {
-      _synctex_free(n);
-      n = nn;
-      goto down;
-    }
-    nn = __synctex_tree_parent(n);
-    _synctex_free(n);
-    if (nn) {
-      n = nn;
-      goto right;
-    }
-  }
-  return;
+    SYNCTEX_UNUSED(handle)
+    return;
 }
 
 /**
@@ -966,7 +1607,6 @@ static void _synctex_free_leaf(synctex_node_p node) {
         SYNCTEX_SCANNER_REMOVE_HANDLE_TO(node);
         SYNCTEX_WILL_FREE(node);
         synctex_node_free(__synctex_tree_sibling(node));
-        _synctex_free(node);
     }
     return;
 }
@@ -1215,7 +1855,7 @@ typedef struct {
 
 static synctex_node_p _synctex_new_input(synctex_scanner_p scanner) {
     if (scanner) {
-        synctex_node_p node = _synctex_malloc(sizeof(synctex_input_s));
+        synctex_node_p node = _synctex_arena_malloc(&scanner->arena,sizeof(synctex_input_s));
         if (node) {
             node->class_ = scanner->class_+synctex_node_type_input;
             SYNCTEX_DID_NEW(node);
@@ -1233,7 +1873,6 @@ static void _synctex_free_input(synctex_node_p node){
         SYNCTEX_WILL_FREE(node);
         synctex_node_free(__synctex_tree_sibling(node));
         _synctex_free(_synctex_data_name(node));
-        _synctex_free(node);
     }
 }
 
@@ -1266,7 +1905,7 @@ typedef struct {
 static synctex_node_p _synctex_new_##NAME(synctex_scanner_p scanner) {\
     if (scanner) {\
         ++SYNCTEX_CUR;\
-        synctex_node_p node = _synctex_malloc(sizeof(synctex_node_##NAME##_s));\
+        synctex_node_p node = _synctex_arena_malloc(&scanner->arena,sizeof(synctex_node_##NAME##_s));\
         if (node) {\
             node->class_ = scanner->class_+synctex_node_type_##NAME;\
             SYNCTEX_DID_NEW(node); \
@@ -1998,7 +2637,7 @@ typedef struct {
 #define DEFINE_synctex_new_unscanned_NODE(NAME)\
 SYNCTEX_INLINE static synctex_node_p _synctex_new_##NAME(synctex_scanner_p scanner) {\
     if (scanner) {\
-        synctex_node_p node = _synctex_malloc(sizeof(synctex_node_##NAME##_s));\
+        synctex_node_p node = _synctex_arena_malloc(&scanner->arena,sizeof(synctex_node_##NAME##_s));\
         if (node) {\
             node->class_ = scanner->class_+synctex_node_type_##NAME;\
             SYNCTEX_DID_NEW(node); \
@@ -2400,8 +3039,23 @@ typedef struct {
     synctex_data_u data[synctex_tree_spct_handle_max+synctex_data_handle_w_max];
 } synctex_node_handle_s;
 
-/*  handle node creator */
-DEFINE_synctex_new_unscanned_NODE(handle)
+/*  handle node creators
+ *  Query results and the parser use the current query arena,
+ *  the handle registry uses the arena of the nodes. */
+SYNCTEX_INLINE static synctex_node_p __synctex_new_handle(synctex_scanner_p scanner, synctex_arena_p arena) {
+    synctex_node_p node = _synctex_arena_malloc(arena,sizeof(synctex_node_handle_s));
+    if (node) {
+        node->class_ = scanner->class_+synctex_node_type_handle;
+        SYNCTEX_DID_NEW(node);
+    }
+    return node;
+}
+SYNCTEX_INLINE static synctex_node_p _synctex_new_handle(synctex_scanner_p scanner) {
+    if (scanner) {
+        return __synctex_new_handle(scanner,scanner->query_arena? scanner->query_arena: &scanner->arena);
+    }
+    return NULL;
+}
 
 static void _synctex_log_handle(synctex_node_p node);
 static char * _synctex_abstract_handle(synctex_node_p node);
@@ -2432,6 +3086,17 @@ SYNCTEX_INLINE static synctex_node_p _synctex_new_handle_with_target(synctex_nod
     }
     return NULL;
 }
+SYNCTEX_INLINE static synctex_node_p _synctex_new_node_handle_with_target(synctex_node_p target) {
+    if (target) {
+        synctex_scanner_p scanner = target->class_->scanner;
+        synctex_node_p result = __synctex_new_handle(scanner,&scanner->arena);
+        if (result) {
+            _synctex_tree_set_target(result,target);
+            return result;
+        }
+    }
+    return NULL;
+}
 SYNCTEX_INLINE static synctex_node_p _synctex_new_handle_with_child(synctex_node_p child) {
     if (child) {
         synctex_node_p result = _synctex_new_handle(child->class_->scanner);
@@ -3835,6 +4500,201 @@ int synctex_scanner_pre_x_offset(synctex_scanner_p scanner);
 int synctex_scanner_pre_y_offset(synctex_scanner_p scanner);
 const char * synctex_scanner_get_output_fmt(synctex_scanner_p scanner);
 
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Tokenizer
+#   endif
+
+/*  The hot loops of the parser look for the next '\n' and decode the decimal integers
+ *  between the ':' and ',' separators of a record.
+ *  Instead of testing one byte at a time, the tokenizer compares 8 bytes at a time in a 64 bits register,
+ *  16 bytes with SSE2 or NEON, 32 and 64 bytes with AVX2 when the processor supports it.
+ *  An integer of at most 9 digits is decoded without branching on its digits.
+ *  The byte by byte version is kept as a reference, and for the tests and benchmarks.
+ *  All the versions give the same results, they never read beyond the given end. */
+typedef enum {
+    synctex_tokenizer_auto = -1,
+    synctex_tokenizer_bytes,
+    synctex_tokenizer_swar,
+    synctex_tokenizer_simd128,
+    synctex_tokenizer_simd256,
+} synctex_tokenizer_t;
+
+/*  synctex_tokenizer_auto selects the best version available. Only the tests change this. */
+static synctex_tokenizer_t _synctex_tokenizer = synctex_tokenizer_auto;
+
+static synctex_tokenizer_t _synctex_tokenizer_best(void) {
+#   if defined(SYNCTEX_USE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return synctex_tokenizer_simd256;
+    }
+#   endif
+#   if defined(SYNCTEX_USE_SSE2) || defined(SYNCTEX_USE_NEON)
+    return synctex_tokenizer_simd128;
+#   elif defined(SYNCTEX_USE_SWAR)
+    return synctex_tokenizer_swar;
+#   else
+    return synctex_tokenizer_bytes;
+#   endif
+}
+SYNCTEX_INLINE static synctex_tokenizer_t _synctex_tokenizer_get(void) {
+    return _synctex_tokenizer == synctex_tokenizer_auto? _synctex_tokenizer_best(): _synctex_tokenizer;
+}
+static const char * _synctex_tokenizer_newline_bytes(const char * ptr, const char * end) {
+    while (ptr<end) {
+        if (*ptr == '\n') {
+            return ptr;
+        }
+        ++ptr;
+    }
+    return NULL;
+}
+#   if defined(SYNCTEX_USE_SWAR)
+#       define SYNCTEX_SWAR_ONES  0x0101010101010101ULL
+#       define SYNCTEX_SWAR_HIGHS 0x8080808080808080ULL
+SYNCTEX_INLINE static uint64_t _synctex_swar_load(const char * ptr) {
+    uint64_t word;
+    memcpy(&word,ptr,sizeof(word));
+    return word;
+}
+static const char * _synctex_tokenizer_newline_swar(const char * ptr, const char * end) {
+    while (end-ptr>=8) {
+        /*  The lowest byte equal to '\n' is the lowest byte with its high bit set. */
+        uint64_t word = _synctex_swar_load(ptr)^('\n'*SYNCTEX_SWAR_ONES);
+        uint64_t found = (word-SYNCTEX_SWAR_ONES)&~word&SYNCTEX_SWAR_HIGHS;
+        if (found) {
+            return ptr+(__builtin_ctzll(found)>>3);
+        }
+        ptr += 8;
+    }
+    return _synctex_tokenizer_newline_bytes(ptr,end);
+}
+/*  The number of leading decimal digits of the 8 bytes at ptr. */
+SYNCTEX_INLINE static int _synctex_tokenizer_digits_swar(const char * ptr) {
+    uint64_t word = _synctex_swar_load(ptr);
+    /*  The high bit of a byte is set when the byte is below '0' or above '9'.
+     *  Carries and borrows may spoil the bytes after the first non digit, not before. */
+    uint64_t others = ((word+0x46*SYNCTEX_SWAR_ONES)|(word-'0'*SYNCTEX_SWAR_ONES))&SYNCTEX_SWAR_HIGHS;
+    return others? __builtin_ctzll(others)>>3: 8;
+}
+/*  The value of the given number of decimal digits at ptr, 0<number_of_digits<=8. */
+SYNCTEX_INLINE static int _synctex_tokenizer_value_swar(const char * ptr, int number_of_digits) {
+    /*  The first digit is the lowest byte, the missing digits become leading zeros. */
+    uint64_t word = _synctex_swar_load(ptr)<<(8*(8-number_of_digits));
+    word = ((word&0x0F0F0F0F0F0F0F0FULL)*2561)>>8;
+    word = ((word&0x00FF00FF00FF00FFULL)*6553601)>>16;
+    return (int)(((word&0x0000FFFF0000FFFFULL)*42949672960001ULL)>>32);
+}
+#   endif
+#   if defined(SYNCTEX_USE_SSE2)
+static const char * _synctex_tokenizer_newline_simd128(const char * ptr, const char * end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end-ptr>=16) {
+        int found = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ptr),newline));
+        if (found) {
+            return ptr+__builtin_ctz(found);
+        }
+        ptr += 16;
+    }
+    return _synctex_tokenizer_newline_swar(ptr,end);
+}
+/*  The number of leading decimal digits of the 16 bytes at ptr. */
+SYNCTEX_INLINE static int _synctex_tokenizer_digits_simd128(const char * ptr) {
+    __m128i bytes = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)ptr),_mm_set1_epi8('0'));
+    /*  bytes-'0' is a digit value if and only if it is not changed by min(.,9) */
+    int others = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes,_mm_set1_epi8(9)),bytes));
+    return __builtin_ctz(others|0x10000);
+}
+#   elif defined(SYNCTEX_USE_NEON)
+static const char * _synctex_tokenizer_newline_simd128(const char * ptr, const char * end) {
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    while (end-ptr>=16) {
+        /*  Narrow the comparison to 4 bits per byte. */
+        uint8x16_t equal = vceqq_u8(vld1q_u8((const uint8_t *)ptr),newline);
+        uint64_t found = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(equal),4)),0);
+        if (found) {
+            return ptr+(__builtin_ctzll(found)>>2);
+        }
+        ptr += 16;
+    }
+    return _synctex_tokenizer_newline_swar(ptr,end);
+}
+#   endif
+#   if defined(SYNCTEX_USE_AVX2)
+__attribute__((target("avx2")))
+static const char * _synctex_tokenizer_newline_simd256(const char * ptr, const char * end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (end-ptr>=64) {
+        uint64_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)ptr),newline));
+        found |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(ptr+32)),newline))<<32;
+        if (found) {
+            return ptr+__builtin_ctzll(found);
+        }
+        ptr += 64;
+    }
+    return _synctex_tokenizer_newline_simd128(ptr,end);
+}
+#   endif
+/**
+ *  The first '\n' character between ptr included and end excluded.
+ *  - returns: NULL if there is no such character.
+ */
+static const char * _synctex_tokenizer_newline(const char * ptr, const char * end) {
+    switch (_synctex_tokenizer_get()) {
+#   if defined(SYNCTEX_USE_AVX2)
+        case synctex_tokenizer_simd256:
+            return _synctex_tokenizer_newline_simd256(ptr,end);
+#   endif
+#   if defined(SYNCTEX_USE_SSE2) || defined(SYNCTEX_USE_NEON)
+        case synctex_tokenizer_simd128:
+            return _synctex_tokenizer_newline_simd128(ptr,end);
+#   endif
+#   if defined(SYNCTEX_USE_SWAR)
+        case synctex_tokenizer_swar:
+            return _synctex_tokenizer_newline_swar(ptr,end);
+#   endif
+        default:
+            return _synctex_tokenizer_newline_bytes(ptr,end);
+    }
+}
+/**
+ *  Decode the decimal integer at ptr, like strtol does.
+ *  The integer must be followed by some non digit character before end,
+ *  for example the '\0' terminating the buffer or a '\n'.
+ *  - parameter value_ref: on return, the value of the integer, 0 if there is no integer.
+ *  - returns: the character following the integer, ptr if there is no integer.
+ */
+static char * _synctex_tokenizer_int(const char * ptr, const char * end, int * value_ref) {
+    char * next = NULL;
+#   if defined(SYNCTEX_USE_SWAR)
+    synctex_tokenizer_t tokenizer = _synctex_tokenizer_get();
+    /*  Strictly more than 16 bytes, such that the 16 bytes following the optional sign are readable. */
+    if (tokenizer>synctex_tokenizer_bytes && end-ptr>16) {
+        const char * digits = ptr+(*ptr == '-');
+        int number_of_digits;
+#       if defined(SYNCTEX_USE_SSE2)
+        if (tokenizer>=synctex_tokenizer_simd128) {
+            number_of_digits = _synctex_tokenizer_digits_simd128(digits);
+        } else
+#       endif
+        if ((number_of_digits = _synctex_tokenizer_digits_swar(digits)) == 8) {
+            number_of_digits += _synctex_tokenizer_digits_swar(digits+8);
+        }
+        /*  At most 9 digits fit in an int, longer integers and other syntaxes are left to strtol. */
+        if (number_of_digits>0 && number_of_digits<=9) {
+            int value = number_of_digits<=8? _synctex_tokenizer_value_swar(digits,number_of_digits):
+                10*_synctex_tokenizer_value_swar(digits,8)+digits[8]-'0';
+            * value_ref = digits>ptr? -value: value;
+            return (char *)digits+number_of_digits;
+        }
+    }
+#   else
+    SYNCTEX_UNUSED(end)
+#   endif
+    * value_ref = (int)strtol(ptr, &next, 10);
+    return next;
+}
+
 #	ifdef SYNCTEX_NOTHING
 #       pragma mark -
 #       pragma mark SCANNER UTILITIES
@@ -3880,7 +4740,7 @@ static synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanner
         }
         SYNCTEX_CUR = SYNCTEX_START + size; /*  the next character after the move, will change. */
         /*  Fill the buffer up to its end */
-        already_read = gzread(SYNCTEX_FILE,(void *)SYNCTEX_CUR,(int)(SYNCTEX_BUFFER_SIZE - size));
+        already_read = _synctex_reader_read(scanner->reader,SYNCTEX_CUR,(unsigned)(SYNCTEX_BUFFER_SIZE - size));
         if (already_read>0) {
             /*  We assume that 0<already_read<=SYNCTEX_BUFFER_SIZE - size, such that
              *  SYNCTEX_CUR + already_read = SYNCTEX_START + size  + already_read <= SYNCTEX_START + SYNCTEX_BUFFER_SIZE */
@@ -3895,7 +4755,14 @@ static synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanner
         } else if (0>already_read) {
             /*  There is a possible error in reading the file */
             int errnum = 0;
-            const char * error_string = gzerror(SYNCTEX_FILE, &errnum);
+            const char * error_string = NULL;
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+            if (scanner->reader->inflater) {
+                _synctex_error("inflate error (%i)",scanner->reader->inflater->error);
+                return (synctex_zs_s){0,SYNCTEX_STATUS_ERROR};
+            }
+#   endif
+            error_string = gzerror(SYNCTEX_FILE, &errnum);
             if (Z_ERRNO == errnum) {
                 /*  There is an error in zlib caused by the file system */
                 _synctex_error("gzread error from the file system (%i)",errno);
@@ -3906,8 +4773,7 @@ static synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanner
             }
         }
         /*  Nothing was read, we are at the end of the file. */
-        gzclose(SYNCTEX_FILE);
-        SYNCTEX_FILE = NULL;
+        _synctex_reader_close(scanner->reader);
         SYNCTEX_END = SYNCTEX_CUR;
         SYNCTEX_CUR = SYNCTEX_START;
         * SYNCTEX_END = '\0';/*  Terminate the string properly.*/
@@ -3933,13 +4799,14 @@ static synctex_status_t _synctex_next_line(synctex_scanner_p scanner) {
         return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
 infinite_loop:
-    while(SYNCTEX_CUR<SYNCTEX_END) {
-        if (*SYNCTEX_CUR == '\n') {
-            ++SYNCTEX_CUR;
+    if (SYNCTEX_CUR<SYNCTEX_END) {
+        const char * eol = _synctex_tokenizer_newline(SYNCTEX_CUR,SYNCTEX_END);
+        if (eol) {
+            SYNCTEX_CUR = (char *)eol+1;
             ++scanner->reader->line_number;
             return _synctex_buffer_get_available_size(scanner, 1).status;
         }
-        ++SYNCTEX_CUR;
+        SYNCTEX_CUR = SYNCTEX_END;
     }
     /*  Here, we have SYNCTEX_CUR == SYNCTEX_END, such that the next call to _synctex_buffer_get_available_size
      *  will read another bunch of synctex file. Little by little, we advance to the end of the file. */
@@ -4010,7 +4877,7 @@ static synctex_status_t _synctex_match_string(synctex_scanner_p scanner, const c
          *  In fact, the states of the buffer before and after this function are in general different
          *  but they are totally equivalent as long as the values of the buffer before SYNCTEX_CUR
          *  can be safely discarded.  */
-        offset = gztell(SYNCTEX_FILE);
+        offset = _synctex_reader_tell(scanner->reader);
         /*  offset now corresponds to the first character of the file that was not buffered. */
         /*  SYNCTEX_CUR - SYNCTEX_START is the number of chars that where already buffered and
          *  that match the head of the_string. If in fine the_string does not match, all these chars must be recovered
@@ -4029,7 +4896,7 @@ static synctex_status_t _synctex_match_string(synctex_scanner_p scanner, const c
         if (zs.size==0) {
             /*  Missing characters: recover the initial state of the file and return. */
         return_NOT_OK:
-            if (offset != gzseek(SYNCTEX_FILE,offset,SEEK_SET)) {
+            if (offset != _synctex_reader_seek(scanner->reader,offset)) {
                 /*  This is a critical error, we could not recover the previous state. */
                 _synctex_error("Can't seek file");
                 return SYNCTEX_STATUS_ERROR;
@@ -4099,7 +4966,7 @@ static synctex_is_s _synctex_decode_int(synctex_scanner_p scanner) {
             return (synctex_is_s){0,SYNCTEX_STATUS_NOT_OK};
         }
     }
-    result = (int)strtol(ptr, &end, 10);
+    end = _synctex_tokenizer_int(ptr, SYNCTEX_END, &result);
     if (end>ptr) {
         SYNCTEX_CUR = end;
         return (synctex_is_s){result,SYNCTEX_STATUS_OK};
@@ -4129,7 +4996,7 @@ static synctex_is_s _synctex_decode_int_opt(synctex_scanner_p scanner, int defau
         if (zs.size==0) {
             return (synctex_is_s){default_value,SYNCTEX_STATUS_NOT_OK};
         }
-        result = (int)strtol(ptr, &end, 10);
+        end = _synctex_tokenizer_int(ptr, SYNCTEX_END, &result);
         if (end>ptr) {
             SYNCTEX_CUR = end;
             return (synctex_is_s){result,SYNCTEX_STATUS_OK};
@@ -4155,6 +5022,10 @@ static synctex_is_s _synctex_decode_int_v(synctex_scanner_p scanner) {
     if (is.status<SYNCTEX_STATUS_OK) {
         return is;
     }
+    if (scanner->reader->lastv == INT_MIN) {
+        /*  The last v field belongs to a previous chunk, see the mapped parser. */
+        scanner->flags.lost_lastv = 1;
+    }
     is.integer = scanner->reader->lastv;
     return is;
 }
@@ -4199,10 +5070,9 @@ more_characters:
     /*  Now we are sure that there is at least one available character, either because
      *  SYNCTEX_CUR was already < SYNCTEX_END, or because the buffer has been properly filled. */
     /*  end will point to the next unparsed '\n' character in the file, when mapped to the buffer. */
-    end = SYNCTEX_CUR;
     /*  We scan all the characters up to the next '\n' */
-    while (end<SYNCTEX_END && *end != '\n') {
-        ++end;
+    if (NULL == (end = (char *)_synctex_tokenizer_newline(SYNCTEX_CUR,SYNCTEX_END))) {
+        end = SYNCTEX_END;
     }
     /*  OK, we found where to stop:
      *      either end == SYNCTEX_END
@@ -4284,6 +5154,7 @@ static synctex_ns_s __synctex_parse_new_input(synctex_scanner_p scanner) {
     /*  Prepend this input node to the input linked list of the scanner */
     __synctex_tree_set_sibling(input,scanner->input);/* input has no parent */
     scanner->input = input;
+    scanner->flags.new_inputs = 1;
 #   if SYNCTEX_VERBOSE
     synctex_node_log(input);
 #   endif
@@ -5097,8 +5968,14 @@ static synctex_status_t __synctex_parse_sfi(synctex_scanner_p scanner) {
      *  We keep track of these leading x nodes in a handle tree.
      */
     synctex_node_p x_handle = NULL;
+    /*  The handles only live during the parsing, in their own arena,
+     *  the parser may be called from within a query. */
+    synctex_arena_p query_arena = scanner->query_arena;
+    synctex_arena_s handle_arena;
 #   define SYNCTEX_RETURN(STATUS) \
         synctex_node_free(x_handle);\
+        scanner->query_arena = query_arena;\
+        _synctex_arena_free(&handle_arena);\
         return STATUS
     synctex_node_p last_k = NULL;
     synctex_node_p last_g = NULL;
@@ -5106,6 +5983,8 @@ static synctex_status_t __synctex_parse_sfi(synctex_scanner_p scanner) {
     int form_depth = 0;
     int ignored_form_depth = 0;
     synctex_bool_t try_input = synctex_YES;
+    memset(&handle_arena,0,sizeof(handle_arena));
+    scanner->query_arena = &handle_arena;
     if (!(x_handle = _synctex_new_handle(scanner))) {
         SYNCTEX_RETURN(SYNCTEX_STATUS_ERROR);
     }
@@ -5115,6 +5994,10 @@ static synctex_status_t __synctex_parse_sfi(synctex_scanner_p scanner) {
 main_loop:
     status = SYNCTEX_STATUS_OK;
     sheet = form = parent = child = NULL;
+    if (scanner->flags.chunk && SYNCTEX_CUR >= scanner->reader->stop) {
+        /*  The next sheet belongs to another chunk, see the mapped parser. */
+        SYNCTEX_RETURN(SYNCTEX_STATUS_OK);
+    }
 #   define SYNCTEX_START_SCAN(WHAT)\
 (*SYNCTEX_CUR == SYNCTEX_CHAR_##WHAT)
     if (SYNCTEX_CUR<SYNCTEX_END) {
@@ -5970,6 +6853,8 @@ SYNCTEX_INLINE static synctex_status_t _synctex_post_process(synctex_scanner_p s
     if (ns.status<status) {
         status = ns.status;
     }
+    /*  The display index catches up with the new friends at the next display query. */
+    scanner->flags.new_friends = 1;
 #if SYNCTEX_DEBUG>500
     printf("!  exiting _synctex_post_process.\n");
     synctex_node_display(scanner->sheet);
@@ -5980,3000 +6865,7428 @@ SYNCTEX_INLINE static synctex_status_t _synctex_post_process(synctex_scanner_p s
 #endif
     return status;
 }
-/*  Used when parsing the synctex file
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Chunks
+#   endif
+/*  A chunk is a part of the content made of complete sheets and forms,
+ *  in memory. It is parsed by a private scanner,
+ *  then the owning scanner adopts the private node trees.
+ *  The "Input:" lines are parsed beforehand by the owning scanner,
+ *  such that the private scanners know all the input tags.
  */
-static synctex_status_t _synctex_scan_content(synctex_scanner_p scanner) {
+typedef struct {
+    synctex_scanner_p scanner;  /*  the private scanner */
+    char * start;       /*  the first character of the chunk */
+    char * stop;        /*  the first character of the next chunk */
+    char * end;         /*  the end of the "Postamble:" line */
+    size_t offset;      /*  the offset of start in the file */
+    int line_number;    /*  the line number of start */
+    int lastv;          /*  the last v field scanned before start, INT_MIN if unknown */
+    synctex_status_t status;
+} synctex_chunk_s;
+
+typedef synctex_chunk_s * synctex_chunk_p;
+/**
+ *  Parse the given chunk with a new private scanner.
+ *  - parameter owner: the scanner of the whole file,
+ *      its inputs are copied such that the private scanner
+ *      can register the line numbers. It is not modified.
+ *  - returns: SYNCTEX_STATUS_OK on success.
+ *  - note: on return, chunk->scanner must be freed.
+ */
+static synctex_status_t _synctex_chunk_parse(synctex_scanner_p owner, synctex_chunk_p chunk) {
+    synctex_scanner_p scanner = chunk->scanner = synctex_scanner_new();
+    synctex_node_p input = NULL;
+    synctex_node_p last = NULL;
+    synctex_status_t status = SYNCTEX_STATUS_OK;
     if (NULL == scanner) {
-        return SYNCTEX_STATUS_BAD_ARGUMENT;
-    }
-    scanner->reader->lastv = -1;
-    synctex_status_t status = 0;
-    /*  Find where this section starts */
-content_not_found:
-    status = _synctex_match_string(scanner,"Content:");
-    if (status<SYNCTEX_STATUS_EOF) {
-        return status;
-    }
-    if (_synctex_next_line(scanner)<SYNCTEX_STATUS_OK) {
-        _synctex_error("Incomplete Content.");
+        _synctex_error("!  _synctex_chunk_parse: Memory problem.");
         return SYNCTEX_STATUS_ERROR;
     }
-    if (status == SYNCTEX_STATUS_NOT_OK) {
-        goto content_not_found;
-    }
+    scanner->flags.has_parsed = 1;
+    scanner->flags.chunk = 1;
+    /*  Copy the inputs, keeping the order. */
+    for (input = owner->input; input; input = __synctex_tree_sibling(input)) {
+        synctex_node_p copy = _synctex_new_input(scanner);
+        if (NULL == copy) {
+            return SYNCTEX_STATUS_ERROR;
+        }
+        _synctex_data_set_tag(copy,_synctex_data_tag(input));
+        if (last) {
+            __synctex_tree_set_sibling(last,copy);
+        } else {
+            scanner->input = copy;
+        }
+        scanner->flags.new_inputs = 1;
+        last = copy;
+    }
+    /*  The reader has no file: everything is already in the buffer. */
+    scanner->reader->start = scanner->reader->current = chunk->start;
+    scanner->reader->stop = chunk->stop;
+    scanner->reader->end = chunk->end;
+    scanner->reader->min_size = SYNCTEX_BUFFER_MIN_SIZE;
+    scanner->reader->size = SYNCTEX_BUFFER_SIZE;
+    scanner->reader->lastv = chunk->lastv;
+    scanner->reader->line_number = chunk->line_number;
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    scanner->reader->charindex_offset = chunk->offset;
+#   endif
     status = __synctex_parse_sfi(scanner);
-    if (status == SYNCTEX_STATUS_OK) {
-        status = _synctex_post_process(scanner);
-    }
+    /*  The reader does not own the mapped memory. */
+    scanner->reader->start = scanner->reader->current = NULL;
+    scanner->reader->stop = scanner->reader->end = NULL;
     return status;
 }
-synctex_scanner_p synctex_scanner_new() {
-    synctex_scanner_p scanner =(synctex_scanner_p)_synctex_malloc(sizeof(synctex_scanner_s));
-    if (scanner) {
-        if (!(scanner->reader = _synctex_malloc(sizeof(synctex_reader_s)))) {
-            _synctex_free(scanner);
-            return NULL;
-        }
-#	ifdef SYNCTEX_NOTHING
-#       pragma mark -
-#   endif
-#   define DEFINE_synctex_scanner_class(NAME)\
-    scanner->class_[synctex_node_type_##NAME] = synctex_class_##NAME;\
-(scanner->class_[synctex_node_type_##NAME]).scanner = scanner
-        DEFINE_synctex_scanner_class(input);
-        DEFINE_synctex_scanner_class(sheet);
-        DEFINE_synctex_scanner_class(form);
-        DEFINE_synctex_scanner_class(hbox);
-        DEFINE_synctex_scanner_class(void_hbox);
-        DEFINE_synctex_scanner_class(vbox);
-        DEFINE_synctex_scanner_class(void_vbox);
-        DEFINE_synctex_scanner_class(kern);
-        DEFINE_synctex_scanner_class(glue);
-        DEFINE_synctex_scanner_class(rule);
-        DEFINE_synctex_scanner_class(math);
-        DEFINE_synctex_scanner_class(boundary);
-        DEFINE_synctex_scanner_class(box_bdry);
-        DEFINE_synctex_scanner_class(ref);
-        DEFINE_synctex_scanner_class(proxy_hbox);
-        DEFINE_synctex_scanner_class(proxy_vbox);
-        DEFINE_synctex_scanner_class(proxy);
-        DEFINE_synctex_scanner_class(proxy_last);
-        DEFINE_synctex_scanner_class(handle);
-        /*  set up the lists of friends */
-        scanner->number_of_lists = 1024;
-        scanner->lists_of_friends = (synctex_node_r)_synctex_malloc(scanner->number_of_lists*sizeof(synctex_node_p));
-        if (NULL == scanner->lists_of_friends) {
-            synctex_scanner_free(scanner);
-            _synctex_error("malloc:2");
-            return NULL;
+/**
+ *  Make scanner the owner of the tree hierarchy rooted at node and its siblings.
+ */
+static void _synctex_tree_adopt(synctex_node_p node, synctex_scanner_p scanner) {
+    while (node) {
+        synctex_node_p next;
+        node->class_ = scanner->class_+synctex_node_type(node);
+        if ((next = _synctex_tree_child(node))) {
+            node = next;
+            continue;
         }
-        scanner->display_switcher = 100;
-        scanner->display_prompt = (char *)_synctex_display_prompt+strlen(_synctex_display_prompt)-1;
+        while (!(next = __synctex_tree_sibling(node))
+               && (node = _synctex_tree_parent(node))) {}
+        node = next;
     }
-    return scanner;
 }
-/*  Where the synctex scanner is created. */
-synctex_scanner_p synctex_scanner_new_with_output_file(const char * output, const char * build_directory, int parse) {
-    synctex_scanner_p scanner = synctex_scanner_new();
-    if (NULL == scanner) {
-        _synctex_error("malloc problem");
-        return NULL;
+/**
+ *  Prepend the friends list starting at first to the given list.
+ *  - returns: the new list.
+ */
+SYNCTEX_INLINE static synctex_node_p _synctex_friends_prepend(synctex_node_p first, synctex_node_p list) {
+    synctex_node_p last = first;
+    synctex_node_p next = NULL;
+    if (NULL == first) {
+        return list;
     }
-    if ((scanner->reader = synctex_reader_init_with_output_file(scanner->reader, output, build_directory))) {
-        return parse? synctex_scanner_parse(scanner):scanner;
+    while ((next = _synctex_tree_friend(last))) {
+        last = next;
     }
-    _synctex_error("No file?");
-    return NULL;
+    _synctex_tree_set_friend(last,list);
+    return first;
 }
-
-/*  The scanner destructor
+/**
+ *  Append the siblings list starting at first to the given list.
+ *  - returns: the new list.
  */
-int synctex_scanner_free(synctex_scanner_p scanner) {
-    int node_count = 0;
-    if (scanner) {
-        if (SYNCTEX_FILE) {
-            gzclose(SYNCTEX_FILE);
-            SYNCTEX_FILE = NULL;
-        }
-        synctex_node_free(scanner->sheet);
-        synctex_node_free(scanner->form);
-        synctex_node_free(scanner->input);
-        synctex_reader_free(scanner->reader);
-        SYNCTEX_SCANNER_FREE_HANDLE(scanner);
-        synctex_iterator_free(scanner->iterator);
-        free(scanner->output_fmt);
-        free(scanner->lists_of_friends);
-#if SYNCTEX_USE_NODE_COUNT>0
-        node_count = scanner->node_count;
-#endif
-        free(scanner);
+SYNCTEX_INLINE static synctex_node_p _synctex_siblings_append(synctex_node_p list, synctex_node_p first) {
+    synctex_node_p last = list;
+    synctex_node_p next = NULL;
+    if (NULL == list) {
+        return first;
     }
-    return node_count;
+    while ((next = __synctex_tree_sibling(last))) {
+        last = next;
+    }
+    __synctex_tree_set_sibling(last,first);
+    return list;
 }
-
-/*  Where the synctex scanner parses the contents of the file. */
-synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner) {
-    synctex_status_t status = 0;
-    if (!scanner || scanner->flags.has_parsed) {
-        return scanner;
+/**
+ *  Move the nodes of the private scanner of a chunk to the owning scanner.
+ *  Friends are prepended and forms are appended, like in __synctex_parse_sfi,
+ *  such that chunks must be adopted in the file order,
+ *  except in lazy mode where the friends order does not matter.
+ *  - parameter after: the sheet after which the sheets of the chunk are inserted,
+ *      NULL to insert them first.
+ *  - returns: the last sheet adopted, after if none.
+ */
+static synctex_node_p _synctex_scanner_adopt_chunk(synctex_scanner_p scanner, synctex_scanner_p chunk, synctex_node_p after) {
+    synctex_node_p node = NULL;
+    synctex_node_p input = scanner->input;
+    int i;
+    /*  The inputs are only used to register line numbers.
+     *  They are copies of the inputs of scanner in the same order,
+     *  only look for the ones added by the chunk. */
+    for (node = chunk->input; node; node = __synctex_tree_sibling(node)) {
+        if (NULL == input || _synctex_data_tag(input) != _synctex_data_tag(node)) {
+            input = synctex_scanner_input_with_tag(scanner,_synctex_data_tag(node));
+        }
+        if (input) {
+            if (_synctex_data_line(node)>_synctex_data_line(input)) {
+                _synctex_data_set_line(input,_synctex_data_line(node));
+            }
+            input = __synctex_tree_sibling(input);
+        }
     }
-    scanner->flags.has_parsed=1;
-    scanner->pre_magnification = 1000;
-    scanner->pre_unit = 8192;
-    scanner->pre_x_offset = scanner->pre_y_offset = 578;
-    /*  initialize the offset with a fake improbable value,
-     *  If there is a post scriptum section, this value will be overridden by the real life value */
-    scanner->x_offset = scanner->y_offset = 6.027e23f;
-    scanner->reader->line_number = 1;
-    
-    SYNCTEX_START = (char *)malloc(SYNCTEX_BUFFER_SIZE+1); /*  one more character for null termination */
-    if (NULL == SYNCTEX_START) {
-        _synctex_error("!  malloc error in synctex_scanner_parse.");
-    bailey:
-#ifdef SYNCTEX_DEBUG
-        return scanner;
-#else
-        synctex_scanner_free(scanner);
-        return NULL;
-#endif
+    synctex_node_free(chunk->input);
+    chunk->input = NULL;
+    _synctex_tree_adopt(chunk->sheet,scanner);
+    _synctex_tree_adopt(chunk->form,scanner);
+    if (chunk->sheet) {
+        synctex_node_p last = chunk->sheet;
+        while ((node = __synctex_tree_sibling(last))) {
+            last = node;
+        }
+        if (after) {
+            __synctex_tree_set_sibling(last,__synctex_tree_sibling(after));
+            __synctex_tree_set_sibling(after,chunk->sheet);
+        } else {
+            __synctex_tree_set_sibling(last,scanner->sheet);
+            scanner->sheet = chunk->sheet;
+        }
+        after = last;
     }
-    synctex_scanner_set_display_switcher(scanner, 1000);
-    SYNCTEX_END = SYNCTEX_START+SYNCTEX_BUFFER_SIZE;
-    /*  SYNCTEX_END always points to a null terminating character.
-     *  Maybe there is another null terminating character between SYNCTEX_CUR and SYNCTEX_END-1.
-     *  At least, we are sure that SYNCTEX_CUR points to a string covering a valid part of the memory. */
-    *SYNCTEX_END = '\0';
-    SYNCTEX_CUR = SYNCTEX_END;
+    scanner->form = _synctex_siblings_append(scanner->form,chunk->form);
+    chunk->sheet = chunk->form = NULL;
+    for (i=0;i<scanner->number_of_lists;++i) {
+        scanner->lists_of_friends[i] = _synctex_friends_prepend(chunk->lists_of_friends[i],scanner->lists_of_friends[i]);
+        chunk->lists_of_friends[i] = NULL;
+    }
+    scanner->ref_in_sheet = _synctex_friends_prepend(chunk->ref_in_sheet,scanner->ref_in_sheet);
+    scanner->ref_in_form = _synctex_friends_prepend(chunk->ref_in_form,scanner->ref_in_form);
+    chunk->ref_in_sheet = chunk->ref_in_form = NULL;
+#   if defined(SYNCTEX_USE_HANDLE)
+    if (chunk->handle) {
+        synctex_node_p last = NULL;
+        for (node = chunk->handle; node; node = __synctex_tree_sibling(node)) {
+            node->class_ = scanner->class_+synctex_node_type_handle;
+            last = node;
+        }
+        __synctex_tree_set_sibling(last,scanner->handle);
+        scanner->handle = chunk->handle;
+        chunk->handle = NULL;
+    }
+#   endif
+#if SYNCTEX_USE_NODE_COUNT>0
+    scanner->node_count += chunk->node_count;
+    chunk->node_count = 0;
+#endif
+    _synctex_arena_adopt(&scanner->arena,&chunk->arena);
+    return after;
+}
+/**
+ *  Parse the "Input:" line between start and end
+ *  with a temporary reader.
+ */
+static void _synctex_scanner_parse_input_line(synctex_scanner_p scanner, char * start, char * end, size_t offset, int line_number) {
+    synctex_reader_p reader = scanner->reader;
+    synctex_reader_s line_reader;
+    memset(&line_reader,0,sizeof(line_reader));
+    line_reader.start = line_reader.current = start;
+    line_reader.end = end;
+    line_reader.min_size = SYNCTEX_BUFFER_MIN_SIZE;
+    line_reader.size = SYNCTEX_BUFFER_SIZE;
+    line_reader.line_number = line_number;
 #   if defined(SYNCTEX_USE_CHARINDEX)
-    scanner->reader->charindex_offset = -SYNCTEX_BUFFER_SIZE;
+    line_reader.charindex_offset = offset;
+#   else
+    SYNCTEX_UNUSED(offset)
 #   endif
-    status = _synctex_scan_preamble(scanner);
-    if (status<SYNCTEX_STATUS_OK) {
-        _synctex_error("Bad preamble\n");
-        goto bailey;
-    }
-    status = _synctex_scan_content(scanner);
-    if (status<SYNCTEX_STATUS_OK) {
-        _synctex_error("Bad content\n");
-        goto bailey;
+    scanner->reader = &line_reader;
+    __synctex_parse_new_input(scanner);
+    scanner->reader = reader;
+}
+/**
+ *  Remove the inputs prepended before the given one.
+ */
+static void _synctex_scanner_remove_inputs_before(synctex_scanner_p scanner, synctex_node_p input) {
+    synctex_node_p node = scanner->input;
+    if (node != input) {
+        while (__synctex_tree_sibling(node) != input) {
+            node = __synctex_tree_sibling(node);
+        }
+        __synctex_tree_reset_sibling(node);
+        synctex_node_free(scanner->input);
+        scanner->input = input;
+        scanner->flags.new_inputs = 1;
     }
-    status = _synctex_scan_postamble(scanner);
-    if (status<SYNCTEX_STATUS_OK) {
-        _synctex_error("Bad postamble. Ignored\n");
+}
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Mapped parser
+#   endif
+#   if defined(SYNCTEX_USE_MAPPED_PARSE)
+/*  The content of an uncompressed synctex file is memory mapped
+ *  and split into chunks at sheet boundaries.
+ *  Each chunk is parsed on a worker thread,
+ *  then the owning scanner adopts the chunks in the file order,
+ *  such that the nodes are linked like after a serial parse.
+ */
+#       if !defined(SYNCTEX_MAPPED_MIN_SIZE)
+#           if defined(SYNCTEX_TESTING)
+#               define SYNCTEX_MAPPED_MIN_SIZE 0
+#           else
+#               define SYNCTEX_MAPPED_MIN_SIZE (1<<20)
+#           endif
+#       endif
+#       if !defined(SYNCTEX_MAPPED_MAX_THREADS)
+#           define SYNCTEX_MAPPED_MAX_THREADS 16
+#       endif
+/*  More chunks than threads for a better load balancing. */
+#       define SYNCTEX_MAPPED_CHUNKS_PER_THREAD 4
+typedef struct {
+    synctex_scanner_p owner;
+    synctex_chunk_p chunks;
+    int count;
+    int capacity;
+    int next;           /*  the next chunk to be parsed */
+    pthread_mutex_t mutex;
+} synctex_chunk_pool_s;
+
+/**
+ *  Append a new chunk to the pool.
+ *  - returns: no on memory problem.
+ */
+static synctex_bool_t _synctex_chunk_pool_add(synctex_chunk_pool_s * pool, char * start, size_t offset, int line_number) {
+    if (pool->count == pool->capacity) {
+        int capacity = pool->capacity? 2*pool->capacity: 64;
+        synctex_chunk_p chunks = (synctex_chunk_p)realloc(pool->chunks,capacity*sizeof(synctex_chunk_s));
+        if (NULL == chunks) {
+            _synctex_error("!  _synctex_chunk_pool_add: Memory problem.");
+            return synctex_NO;
+        }
+        pool->chunks = chunks;
+        pool->capacity = capacity;
+    }
+    memset(pool->chunks+pool->count,0,sizeof(synctex_chunk_s));
+    pool->chunks[pool->count].start = start;
+    pool->chunks[pool->count].offset = offset;
+    pool->chunks[pool->count].line_number = line_number;
+    ++pool->count;
+    return synctex_YES;
+}
+static void * _synctex_chunk_worker(void * arg) {
+    synctex_chunk_pool_s * pool = (synctex_chunk_pool_s *)arg;
+    for (;;) {
+        int i;
+        pthread_mutex_lock(&pool->mutex);
+        i = pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+        if (i >= pool->count) {
+            return NULL;
+        }
+        pool->chunks[i].status = _synctex_chunk_parse(pool->owner,pool->chunks+i);
     }
-#if SYNCTEX_DEBUG>500
-    synctex_scanner_set_display_switcher(scanner, 100);
-    synctex_node_display(scanner->sheet);
-    synctex_node_display(scanner->form);
-#endif
-    synctex_scanner_set_display_switcher(scanner, 1000);
-    /*  Everything is finished, free the buffer, close the file */
-    free((void *)SYNCTEX_START);
-    SYNCTEX_START = SYNCTEX_CUR = SYNCTEX_END = NULL;
-    gzclose(SYNCTEX_FILE);
-    SYNCTEX_FILE = NULL;
-    /*  Final tuning: set the default values for various parameters */
-    /*  1 pre_unit = (scanner->pre_unit)/65536 pt = (scanner->pre_unit)/65781.76 bp
-     * 1 pt = 65536 sp */
-    if (scanner->pre_unit<=0) {
-        scanner->pre_unit = 8192;
+}
+/**
+ *  Parse the content of an uncompressed synctex file concurrently.
+ *  Called just after the "Content:" line was scanned.
+ *  - returns: SYNCTEX_STATUS_NOT_OK when the mapped parser does not apply,
+ *      the scanner is then unchanged and the content must be parsed serially.
+ *      Otherwise the content is parsed and post processed,
+ *      the reader is ready to scan the postamble.
+ */
+static synctex_status_t _synctex_scan_content_mapped(synctex_scanner_p scanner) {
+    synctex_node_p input = scanner->input;
+    synctex_node_p last = NULL;
+    synctex_chunk_pool_s pool;
+    pthread_t threads[SYNCTEX_MAPPED_MAX_THREADS];
+    struct stat st;
+    char * map = NULL;
+    char * content = NULL;
+    char * end = NULL;
+    char * ptr = NULL;
+    char * postamble = NULL;
+    size_t target = 0;
+    z_off_t offset = 0;
+    long number_of_cpus = 0;
+    int number_of_threads = 0;
+    int number_of_workers = 0;
+    int line_number = 0;
+    int postamble_line_number = 0;
+    int lastv = 0;
+    int fd = -1;
+    int i;
+    if (!(scanner->parse_options & synctex_parse_option_mapped)
+        || NULL == SYNCTEX_FILE
+        || !gzdirect(SYNCTEX_FILE)
+        || (offset = gztell(SYNCTEX_FILE))<0) {
+        return SYNCTEX_STATUS_NOT_OK;
     }
-    if (scanner->pre_magnification<=0) {
-        scanner->pre_magnification = 1000;
+    /*  The file offset of the first content line. */
+    offset -= SYNCTEX_END-SYNCTEX_CUR;
+    if ((fd = open(scanner->reader->synctex,O_RDONLY))<0) {
+        return SYNCTEX_STATUS_NOT_OK;
     }
-    if (scanner->unit <= 0) {
-        /*  no post magnification */
-        scanner->unit = scanner->pre_unit / 65781.76;/*  65781.76 or 65536.0*/
-    } else {
-        /*  post magnification */
-        scanner->unit *= scanner->pre_unit / 65781.76;
+    if (fstat(fd,&st)
+        || st.st_size<SYNCTEX_MAPPED_MIN_SIZE
+        || st.st_size<=offset
+        || MAP_FAILED == (map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0))) {
+        close(fd);
+        return SYNCTEX_STATUS_NOT_OK;
     }
-    scanner->unit *= scanner->pre_magnification / 1000.0;
-    if (scanner->x_offset > 6e23) {
-        /*  no post offset */
-        scanner->x_offset = scanner->pre_x_offset * (scanner->pre_unit / 65781.76);
-        scanner->y_offset = scanner->pre_y_offset * (scanner->pre_unit / 65781.76);
-    } else {
-        /*  post offset */
-        scanner->x_offset /= 65781.76f;
-        scanner->y_offset /= 65781.76f;
+    close(fd);
+    number_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    number_of_threads = number_of_cpus<1? 1:
+        (number_of_cpus>SYNCTEX_MAPPED_MAX_THREADS? SYNCTEX_MAPPED_MAX_THREADS: (int)number_of_cpus);
+    content = map+offset;
+    end = map+st.st_size;
+    target = (end-content)/(number_of_threads*SYNCTEX_MAPPED_CHUNKS_PER_THREAD)+1;
+    memset(&pool,0,sizeof(pool));
+    pool.owner = scanner;
+    line_number = scanner->reader->line_number;
+    if (!_synctex_chunk_pool_add(&pool,content,offset,line_number)) {
+        goto bail;
+    }
+    /*  Split the content at sheet boundaries, parse the inputs and find the postamble. */
+    for (ptr = content; ptr<end && !postamble; ++line_number) {
+        char * next = memchr(ptr,'\n',end-ptr);
+        next = next? next+1: end;
+        switch (*ptr) {
+            case SYNCTEX_CHAR_BEGIN_SHEET:
+                if ((size_t)(ptr-pool.chunks[pool.count-1].start)>=target
+                    && !_synctex_chunk_pool_add(&pool,ptr,ptr-map,line_number)) {
+                    goto bail;
+                }
+                break;
+            case 'I':
+                _synctex_scanner_parse_input_line(scanner,ptr,next,ptr-map,line_number);
+                break;
+            case 'P':
+                if (next-ptr>=10 && !strncmp(ptr,"Postamble:",10)) {
+                    postamble = ptr;
+                    postamble_line_number = line_number;
+                    end = next;
+                }
+                break;
+        }
+        ptr = next;
+    }
+    if (NULL == postamble || pool.count<2) {
+        /*  Let the serial parser do the job. */
+        goto bail;
+    }
+    for (i=0;i<pool.count;++i) {
+        pool.chunks[i].stop = i+1<pool.count? pool.chunks[i+1].start: postamble;
+        pool.chunks[i].end = end;
+        pool.chunks[i].lastv = i? INT_MIN: scanner->reader->lastv;
+    }
+    /*  The current thread is also a worker. */
+    pthread_mutex_init(&pool.mutex,NULL);
+    while (number_of_workers<number_of_threads-1 && number_of_workers<pool.count-1
+           && !pthread_create(threads+number_of_workers,NULL,&_synctex_chunk_worker,&pool)) {
+        ++number_of_workers;
+    }
+    _synctex_chunk_worker(&pool);
+    for (i=0;i<number_of_workers;++i) {
+        pthread_join(threads[i],NULL);
+    }
+    pthread_mutex_destroy(&pool.mutex);
+    /*  A chunk that used the ',=' shortcut before its first v field
+     *  is parsed again with the last v field of the previous chunks. */
+    lastv = scanner->reader->lastv;
+    for (i=0;i<pool.count;++i) {
+        synctex_chunk_p chunk = pool.chunks+i;
+        if (chunk->status == SYNCTEX_STATUS_OK && chunk->scanner->flags.lost_lastv) {
+            synctex_scanner_free(chunk->scanner);
+            chunk->lastv = lastv;
+            chunk->status = _synctex_chunk_parse(scanner,chunk);
+        }
+        if (chunk->status != SYNCTEX_STATUS_OK) {
+            goto bail;
+        }
+        if (chunk->scanner->reader->lastv != INT_MIN) {
+            lastv = chunk->scanner->reader->lastv;
+        }
+    }
+    for (i=0;i<pool.count;++i) {
+        last = _synctex_scanner_adopt_chunk(scanner,pool.chunks[i].scanner,last);
+        synctex_scanner_free(pool.chunks[i].scanner);
+    }
+    free(pool.chunks);
+    offset = postamble-map;
+    munmap(map,(size_t)st.st_size);
+    /*  The reader goes on with the postamble. */
+    if (offset != gzseek(SYNCTEX_FILE,offset,SEEK_SET)) {
+        _synctex_error("Can't seek file");
+        return SYNCTEX_STATUS_ERROR;
     }
-    return scanner;
-#undef SYNCTEX_FILE
+    SYNCTEX_CUR = SYNCTEX_END;
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    scanner->reader->charindex_offset = offset-(SYNCTEX_END-SYNCTEX_START);
+#   endif
+    scanner->reader->line_number = postamble_line_number;
+    scanner->reader->lastv = lastv;
+    return _synctex_post_process(scanner);
+bail:
+    for (i=0;i<pool.count;++i) {
+        synctex_scanner_free(pool.chunks[i].scanner);
+    }
+    free(pool.chunks);
+    munmap(map,(size_t)st.st_size);
+    _synctex_scanner_remove_inputs_before(scanner,input);
+    return SYNCTEX_STATUS_NOT_OK;
 }
+#   endif
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Lazy parser
+#   endif
+/*  In lazy mode, the content is kept in memory,
+ *  either mapped for an uncompressed file or inflated otherwise.
+ *  A quick pass over the lines records where each sheet starts and stops,
+ *  together with the line ranges of each input tag inside the sheet.
+ *  The inputs and the forms are parsed at once,
+ *  a sheet is only parsed when a query needs it.
+ */
+typedef struct {
+    int tag;
+    int min;
+    int max;
+    int sheet;              /*  the index of the sheet, -1 for forms */
+} synctex_lazy_range_s;
 
-/*  Scanner accessors.
+typedef struct {
+    synctex_node_p node;    /*  the sheet node, NULL until parsed */
+    char * start;           /*  the "{" line */
+    char * stop;            /*  the line following the "}" line */
+    int page;
+    int line_number;        /*  the line number of start */
+    synctex_bool_t has_ref; /*  whether the sheet refers to forms */
+    synctex_bool_t failed;  /*  whether the sheet could not be parsed */
+    /*  Set when the sheet is parsed, to be reused by a later scanner */
+    unsigned long long hash;        /*  the hash of the content, see _synctex_lazy_sheet_hash */
+    int lastv;                      /*  the last v field before the sheet */
+    size_t number_of_allocations;   /*  the arena allocations of the sheet */
+} synctex_lazy_sheet_s;
+
+struct synctex_lazy_t {
+    char * text;            /*  the mapped file or the inflated content */
+    size_t size;
+    size_t offset;          /*  the file offset of text */
+    synctex_bool_t is_mapped;
+    char * content;         /*  the first content line */
+    char * postamble;       /*  the "Postamble:" line */
+    char * end;             /*  the end of the "Postamble:" line */
+    int postamble_line_number;
+    synctex_lazy_sheet_s * sheets;
+    int number_of_sheets;
+    int number_of_parsed_sheets;    /*  including the ones that failed */
+    int capacity_of_sheets;
+    synctex_lazy_range_s * ranges;      /*  sorted by tag, then by sheet */
+    int number_of_ranges;
+    int capacity_of_ranges;
+    synctex_lazy_range_s * form_ranges;
+    int number_of_form_ranges;
+    int capacity_of_form_ranges;
+};
+
+static void _synctex_lazy_free(synctex_lazy_p lazy) {
+    if (lazy) {
+#   if defined(SYNCTEX_USE_MAPPED_PARSE)
+        if (lazy->is_mapped) {
+            munmap(lazy->text,lazy->size);
+        } else
+#   endif
+        free(lazy->text);
+        free(lazy->sheets);
+        free(lazy->ranges);
+        free(lazy->form_ranges);
+        free(lazy);
+    }
+}
+/**
+ *  Make room for one more item.
+ *  - returns: no on memory problem.
  */
-int synctex_scanner_pre_x_offset(synctex_scanner_p scanner){
-    return scanner?scanner->pre_x_offset:0;
+static synctex_bool_t _synctex_lazy_grow(void ** items, int * capacity, int count, size_t size) {
+    if (count == *capacity) {
+        int new_capacity = *capacity? 2**capacity: 64;
+        void * new_items = realloc(*items,new_capacity*size);
+        if (NULL == new_items) {
+            _synctex_error("!  _synctex_lazy_grow: Memory problem.");
+            return synctex_NO;
+        }
+        *items = new_items;
+        *capacity = new_capacity;
+    }
+    return synctex_YES;
 }
-int synctex_scanner_pre_y_offset(synctex_scanner_p scanner){
-    return scanner?scanner->pre_y_offset:0;
+/**
+ *  Extend the range of the given tag to line,
+ *  ranges before first are not considered.
+ */
+static synctex_bool_t _synctex_lazy_ranges_add(synctex_lazy_range_s ** ranges, int * count, int * capacity, int first, int sheet, int tag, int line) {
+    int i;
+    for (i=*count;i-->first;) {
+        synctex_lazy_range_s * range = *ranges+i;
+        if (range->tag == tag) {
+            if (line<range->min) {
+                range->min = line;
+            } else if (line>range->max) {
+                range->max = line;
+            }
+            return synctex_YES;
+        }
+    }
+    if (!_synctex_lazy_grow((void **)ranges,capacity,*count,sizeof(synctex_lazy_range_s))) {
+        return synctex_NO;
+    }
+    (*ranges)[*count] = (synctex_lazy_range_s){tag,line,line,sheet};
+    ++*count;
+    return synctex_YES;
 }
-int synctex_scanner_x_offset(synctex_scanner_p scanner){
-    return scanner?scanner->x_offset:0;
+static int _synctex_lazy_range_compare(const void * lhs, const void * rhs) {
+    const synctex_lazy_range_s * l = (const synctex_lazy_range_s *)lhs;
+    const synctex_lazy_range_s * r = (const synctex_lazy_range_s *)rhs;
+    if (l->tag != r->tag) {
+        return l->tag<r->tag? -1: 1;
+    }
+    return l->sheet<r->sheet? -1: (l->sheet>r->sheet? 1: 0);
 }
-int synctex_scanner_y_offset(synctex_scanner_p scanner){
-    return scanner?scanner->y_offset:0;
+/**
+ *  Decode the tag and line fields of a record line.
+ *  - returns: no when the line has no such fields.
+ */
+SYNCTEX_INLINE static synctex_bool_t _synctex_lazy_decode_tag_line(char * ptr, int * tag, int * line, char ** end) {
+    char * e = NULL;
+    switch (*ptr) {
+        case SYNCTEX_CHAR_BEGIN_VBOX:
+        case SYNCTEX_CHAR_BEGIN_HBOX:
+        case SYNCTEX_CHAR_VOID_VBOX:
+        case SYNCTEX_CHAR_VOID_HBOX:
+        case SYNCTEX_CHAR_KERN:
+        case SYNCTEX_CHAR_GLUE:
+        case SYNCTEX_CHAR_RULE:
+        case SYNCTEX_CHAR_MATH:
+        case SYNCTEX_CHAR_BOUNDARY:
+            *tag = (int)strtol(ptr+1,&e,10);
+            if (e>ptr+1 && *e == ',') {
+                ptr = e+1;
+                *line = (int)strtol(ptr,&e,10);
+                if (e>ptr) {
+                    *end = e;
+                    return synctex_YES;
+                }
+            }
+    }
+    return synctex_NO;
 }
-float synctex_scanner_magnification(synctex_scanner_p scanner){
-    return scanner?scanner->unit:1;
+/**
+ *  Decode the v field of a record line, unless it is the ',=' shortcut.
+ *  - returns: no when the line has no explicit v field.
+ */
+SYNCTEX_INLINE static synctex_bool_t _synctex_lazy_decode_v(char * ptr, int * v) {
+    char * e = NULL;
+    int tag, line;
+    if (*ptr == SYNCTEX_CHAR_FORM_REF) {
+        strtol(ptr+1,&e,10);
+        if (e == ptr+1) {
+            return synctex_NO;
+        }
+    } else if (!_synctex_lazy_decode_tag_line(ptr,&tag,&line,&e)) {
+        return synctex_NO;
+    } else if (*e == ',') {
+        /*  The optional column. */
+        strtol(e+1,&e,10);
+    }
+    if (*e != ':') {
+        return synctex_NO;
+    }
+    ptr = e+1;
+    strtol(ptr,&e,10);
+    if (e == ptr || *e != ',' || e[1] == '=') {
+        return synctex_NO;
+    }
+    ptr = e+1;
+    *v = (int)strtol(ptr,&e,10);
+    return e>ptr;
 }
-void synctex_scanner_display(synctex_scanner_p scanner) {
-    if (NULL == scanner) {
-        return;
+/**
+ *  The last v field before the given line,
+ *  what the reader would have recorded after a serial parse up to there.
+ */
+static int _synctex_lazy_lastv(synctex_lazy_p lazy, char * ptr) {
+    int v = -1;
+    while (ptr>lazy->content) {
+        char * line = ptr-1;
+        while (line>lazy->content && line[-1] != '\n') {
+            --line;
+        }
+        if (_synctex_lazy_decode_v(line,&v)) {
+            return v;
+        }
+        ptr = line;
     }
-    printf("The scanner:\noutput:%s\noutput_fmt:%s\nversion:%i\n",scanner->reader->output,scanner->output_fmt,scanner->version);
-    printf("pre_unit:%i\nx_offset:%i\ny_offset:%i\n",scanner->pre_unit,scanner->pre_x_offset,scanner->pre_y_offset);
-    printf("count:%i\npost_magnification:%f\npost_x_offset:%f\npost_y_offset:%f\n",
-           scanner->count,scanner->unit,scanner->x_offset,scanner->y_offset);
-    printf("The input:\n");
-    synctex_node_display(scanner->input);
-    if (scanner->count<1000) {
-        printf("The sheets:\n");
-        synctex_node_display(scanner->sheet);
-        printf("The friends:\n");
-        if (scanner->lists_of_friends) {
-            int i = scanner->number_of_lists;
-            synctex_node_p node;
-            while(i--) {
-                printf("Friend index:%i\n",i);
-                node = (scanner->lists_of_friends)[i];
-                while(node) {
-                    printf("%s:%i,%i\n",
-                           synctex_node_isa(node),
-                           _synctex_data_tag(node),
-                           _synctex_data_line(node)
-                           );
-                    node = _synctex_tree_friend(node);
+    return -1;
+}
+/**
+ *  Parse the form between start and stop with the main scanner,
+ *  using a temporary reader.
+ */
+static synctex_status_t _synctex_lazy_parse_form(synctex_scanner_p scanner, synctex_lazy_p lazy, char * start, char * stop, int line_number) {
+    synctex_reader_p reader = scanner->reader;
+    synctex_reader_s form_reader;
+    synctex_status_t status;
+    memset(&form_reader,0,sizeof(form_reader));
+    form_reader.start = form_reader.current = start;
+    form_reader.stop = stop;
+    form_reader.end = lazy->text+lazy->size;
+    form_reader.min_size = SYNCTEX_BUFFER_MIN_SIZE;
+    form_reader.size = SYNCTEX_BUFFER_SIZE;
+    form_reader.line_number = line_number;
+    form_reader.lastv = _synctex_lazy_lastv(lazy,start);
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    form_reader.charindex_offset = lazy->offset+(start-lazy->text);
+#   endif
+    scanner->reader = &form_reader;
+    scanner->flags.chunk = 1;
+    status = __synctex_parse_sfi(scanner);
+    scanner->flags.chunk = 0;
+    scanner->reader = reader;
+    return status;
+}
+/**
+ *  The quick pass over the content lines.
+ *  Record the sheets and the line ranges, parse the inputs and the forms,
+ *  find the postamble.
+ *  - returns: SYNCTEX_STATUS_OK on success.
+ */
+static synctex_status_t _synctex_lazy_index(synctex_scanner_p scanner, synctex_lazy_p lazy, int line_number) {
+    synctex_lazy_sheet_s * sheet = NULL;
+    synctex_node_p input = NULL;
+    char * end = lazy->text+lazy->size;
+    char * ptr = lazy->content;
+    char * form = NULL;
+    int form_line_number = 0;
+    int form_depth = 0;
+    int first_range = 0;
+    int tag = 0;
+    int line = 0;
+    char * e = NULL;
+    for (; ptr<end; ++line_number) {
+        char * next = memchr(ptr,'\n',end-ptr);
+        next = next? next+1: end;
+        switch (*ptr) {
+            case SYNCTEX_CHAR_BEGIN_SHEET:
+                if (sheet || form_depth
+                    || !_synctex_lazy_grow((void **)&lazy->sheets,&lazy->capacity_of_sheets,lazy->number_of_sheets,sizeof(synctex_lazy_sheet_s))) {
+                    return SYNCTEX_STATUS_NOT_OK;
                 }
-            }
+                sheet = lazy->sheets+lazy->number_of_sheets++;
+                memset(sheet,0,sizeof(synctex_lazy_sheet_s));
+                sheet->start = ptr;
+                sheet->page = (int)strtol(ptr+1,NULL,10);
+                sheet->line_number = line_number;
+                first_range = lazy->number_of_ranges;
+                break;
+            case SYNCTEX_CHAR_END_SHEET:
+                if (sheet && !form_depth) {
+                    sheet->stop = next;
+                    sheet = NULL;
+                }
+                break;
+            case SYNCTEX_CHAR_BEGIN_FORM:
+                if (0 == form_depth++) {
+                    form = ptr;
+                    form_line_number = line_number;
+                }
+                break;
+            case SYNCTEX_CHAR_END_FORM:
+                if (form_depth && 0 == --form_depth
+                    && _synctex_lazy_parse_form(scanner,lazy,form,next,form_line_number) != SYNCTEX_STATUS_OK) {
+                    return SYNCTEX_STATUS_NOT_OK;
+                }
+                break;
+            case SYNCTEX_CHAR_FORM_REF:
+                if (sheet && !form_depth) {
+                    sheet->has_ref = synctex_YES;
+                }
+                break;
+            case 'I':
+                if (!sheet && !form_depth) {
+                    _synctex_scanner_parse_input_line(scanner,ptr,next,lazy->offset+(ptr-lazy->text),line_number);
+                }
+                break;
+            case 'P':
+                if (!sheet && !form_depth && next-ptr>=10 && !strncmp(ptr,"Postamble:",10)) {
+                    lazy->postamble = ptr;
+                    lazy->postamble_line_number = line_number;
+                    lazy->end = next;
+                    qsort(lazy->ranges,lazy->number_of_ranges,sizeof(synctex_lazy_range_s),&_synctex_lazy_range_compare);
+                    return SYNCTEX_STATUS_OK;
+                }
+                break;
+            default:
+                if (_synctex_lazy_decode_tag_line(ptr,&tag,&line,&e)) {
+                    if (form_depth) {
+                        if (!_synctex_lazy_ranges_add(&lazy->form_ranges,&lazy->number_of_form_ranges,&lazy->capacity_of_form_ranges,0,-1,tag,line)) {
+                            return SYNCTEX_STATUS_NOT_OK;
+                        }
+                    } else if (sheet) {
+                        if (!_synctex_lazy_ranges_add(&lazy->ranges,&lazy->number_of_ranges,&lazy->capacity_of_ranges,first_range,(int)(sheet-lazy->sheets),tag,line)) {
+                            return SYNCTEX_STATUS_NOT_OK;
+                        }
+                    }
+                    /*  Like _synctex_input_register_line. */
+                    if (NULL == input || _synctex_data_tag(input) != tag) {
+                        input = synctex_scanner_input_with_tag(scanner,tag);
+                    }
+                    if (input && line>_synctex_data_line(input)) {
+                        _synctex_data_set_line(input,line);
+                    }
+                }
+        }
+        ptr = next;
+    }
+    return SYNCTEX_STATUS_NOT_OK;
+}
+/**
+ *  The hash of the content of a sheet, except the "{" and "}" lines
+ *  which contain the page number.
+ *  A sheet that did not change after the document was typeset again has the same hash,
+ *  even if its page number changed.
+ */
+static unsigned long long _synctex_lazy_sheet_hash(synctex_lazy_sheet_s * sheet) {
+    unsigned long long hash = 14695981039346656037ULL; /*  FNV-1a */
+    char * stop = sheet->stop;
+    char * ptr = memchr(sheet->start,'\n',stop-sheet->start);
+    if (stop>sheet->start && stop[-1] == '\n') {
+        --stop;
+    }
+    while (stop>sheet->start && stop[-1] != '\n') {
+        --stop;
+    }
+    for (ptr = ptr? ptr+1: stop; ptr<stop; ++ptr) {
+        hash = (hash^(unsigned char)*ptr)*1099511628211ULL;
+    }
+    return hash;
+}
+static synctex_node_p _synctex_reload_sheet(synctex_scanner_p scanner, synctex_lazy_sheet_s * sheet, size_t offset);
+/**
+ *  Parse the sheet at the given index of the lazy index, if not already done.
+ *  An unchanged sheet of a previous scanner is reused instead.
+ *  - returns: the sheet node, NULL on failure.
+ */
+static synctex_node_p _synctex_lazy_parse_sheet(synctex_scanner_p scanner, int i) {
+    synctex_lazy_p lazy = scanner->lazy;
+    synctex_lazy_sheet_s * sheet = lazy->sheets+i;
+    synctex_node_p after = NULL;
+    synctex_node_p node = NULL;
+    synctex_chunk_s chunk;
+    if (sheet->node || sheet->failed) {
+        return sheet->node;
+    }
+    memset(&chunk,0,sizeof(chunk));
+    chunk.start = sheet->start;
+    chunk.stop = sheet->stop;
+    chunk.end = lazy->end;
+    chunk.offset = lazy->offset+(sheet->start-lazy->text);
+    chunk.line_number = sheet->line_number;
+    chunk.lastv = sheet->lastv = _synctex_lazy_lastv(lazy,sheet->start);
+    if (sheet->stop) {
+        sheet->hash = _synctex_lazy_sheet_hash(sheet);
+    }
+    /*  Keep the sheets in the file order. */
+    while (i-->0) {
+        if ((after = lazy->sheets[i].node)) {
+            break;
+        }
+    }
+    if ((node = _synctex_reload_sheet(scanner,sheet,chunk.offset))) {
+        if (after) {
+            __synctex_tree_set_sibling(node,__synctex_tree_sibling(after));
+            __synctex_tree_set_sibling(after,node);
+        } else {
+            __synctex_tree_set_sibling(node,scanner->sheet);
+            scanner->sheet = node;
+        }
+        sheet->node = node;
+        _synctex_post_process(scanner);
+    } else if (_synctex_chunk_parse(scanner,&chunk) == SYNCTEX_STATUS_OK && chunk.scanner->sheet) {
+        /*  The forms were already parsed by the scanner,
+         *  the references in forms are freed with their forms. */
+        synctex_node_free(chunk.scanner->form);
+        chunk.scanner->form = chunk.scanner->ref_in_form = NULL;
+        sheet->node = chunk.scanner->sheet;
+        sheet->number_of_allocations = chunk.scanner->arena.number_of_allocations;
+        _synctex_scanner_adopt_chunk(scanner,chunk.scanner,after);
+        if (_synctex_post_process(scanner) != SYNCTEX_STATUS_OK) {
+            _synctex_error("!  _synctex_lazy_parse_sheet: Post processing error.");
         }
     } else {
-        printf("SyncTeX Warning: Too many objects\n");
+        _synctex_error("!  _synctex_lazy_parse_sheet: Error at line %i.",sheet->line_number);
+        sheet->failed = synctex_YES;
     }
+    ++lazy->number_of_parsed_sheets;
+    synctex_scanner_free(chunk.scanner);
+    return sheet->node;
 }
-/*  Public */
-const char * synctex_scanner_get_name(synctex_scanner_p scanner,int tag) {
-    synctex_node_p input = NULL;
-    if (NULL == scanner) {
-        return NULL;
+/**
+ *  The sheet with the given page, parsed on demand.
+ *  Same semantics as synctex_sheet.
+ */
+static synctex_node_p _synctex_lazy_sheet(synctex_scanner_p scanner, int page) {
+    synctex_lazy_p lazy = scanner->lazy;
+    int i;
+    for (i=0;i<lazy->number_of_sheets;++i) {
+        if (page == lazy->sheets[i].page) {
+            return _synctex_lazy_parse_sheet(scanner,i);
+        }
     }
-    if ((input = scanner->input)) {;
-        do {
-            if (tag == _synctex_data_tag(input)) {
-                return (_synctex_data_name(input));
-            }
-        } while((input = __synctex_tree_sibling(input)));
+    if (page == 0 && lazy->number_of_sheets) {
+        _synctex_lazy_parse_sheet(scanner,0);
+        return scanner->sheet;
     }
     return NULL;
 }
-const char * synctex_node_get_name(synctex_node_p node) {
-    if (node) {
-        return synctex_scanner_get_name(node->class_->scanner,_synctex_data_tag(node));
+/**
+ *  Parse all the sheets that may contain a node with the given tag and line,
+ *  any line of the input when line is 0.
+ *  When the line belongs to a form, the sheets that refer to forms are parsed too.
+ */
+static void _synctex_lazy_parse_line(synctex_scanner_p scanner, int tag, int line) {
+    synctex_lazy_p lazy = scanner->lazy;
+    int lo = 0, hi = lazy->number_of_ranges;
+    int i;
+    if (lazy->number_of_parsed_sheets == lazy->number_of_sheets) {
+        return;
+    }
+    for (i=0;i<lazy->number_of_form_ranges;++i) {
+        synctex_lazy_range_s * range = lazy->form_ranges+i;
+        if (range->tag == tag && (line == 0 || (range->min<=line && line<=range->max))) {
+            for (i=0;i<lazy->number_of_sheets;++i) {
+                if (lazy->sheets[i].has_ref) {
+                    _synctex_lazy_parse_sheet(scanner,i);
+                }
+            }
+            break;
+        }
+    }
+    /*  The first range with the given tag. */
+    while (lo<hi) {
+        int mid = lo+(hi-lo)/2;
+        if (lazy->ranges[mid].tag<tag) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (i=lo;i<lazy->number_of_ranges && lazy->ranges[i].tag == tag;++i) {
+        synctex_lazy_range_s * range = lazy->ranges+i;
+        if (line == 0 || (range->min<=line && line<=range->max)) {
+            _synctex_lazy_parse_sheet(scanner,range->sheet);
+        }
     }
-    return NULL;
 }
-
-static int _synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name);
-static int _synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name) {
-    synctex_node_p input = NULL;
-    if (NULL == scanner) {
-        return 0;
+/**
+ *  Index the content of a synctex file without parsing the sheets.
+ *  Called just after the "Content:" line was scanned.
+ *  - returns: SYNCTEX_STATUS_NOT_OK when the lazy parser does not apply,
+ *      the content must then be parsed as usual.
+ *      Otherwise the reader is ready to scan the postamble.
+ */
+static synctex_status_t _synctex_scan_content_lazy(synctex_scanner_p scanner) {
+    synctex_node_p input = scanner->input;
+    synctex_lazy_p lazy = NULL;
+    z_off_t offset = 0;
+    int line_number = scanner->reader->line_number;
+    size_t size = 0;
+    if (!(scanner->parse_options & synctex_parse_option_lazy)
+        || scanner->cache_directory
+        || NULL == SYNCTEX_FILE
+        || (offset = _synctex_reader_tell(scanner->reader))<0
+        || NULL == (lazy = (synctex_lazy_p)_synctex_malloc(sizeof(struct synctex_lazy_t)))) {
+        return SYNCTEX_STATUS_NOT_OK;
     }
-    if ((input = scanner->input)) {
-        do {
-            if (_synctex_is_equivalent_file_name(name,(_synctex_data_name(input)))) {
-                return _synctex_data_tag(input);
+    /*  The file offset of the first content line. */
+    offset -= SYNCTEX_END-SYNCTEX_CUR;
+#   if defined(SYNCTEX_USE_MAPPED_PARSE)
+    if (gzdirect(SYNCTEX_FILE)) {
+        struct stat st;
+        int fd = open(scanner->reader->synctex,O_RDONLY);
+        if (fd>=0) {
+            char * map = NULL;
+            if (!fstat(fd,&st) && st.st_size>offset
+                && MAP_FAILED != (map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0))) {
+                lazy->text = map;
+                lazy->size = (size_t)st.st_size;
+                lazy->is_mapped = synctex_YES;
+                lazy->content = map+offset;
             }
-        } while((input = __synctex_tree_sibling(input)));
+            close(fd);
+        }
     }
-    //  2011 version
-    name = _synctex_base_name(name);
-    if ((input = scanner->input)) {
-        do {
-            if (_synctex_is_equivalent_file_name(name,_synctex_base_name(_synctex_data_name(input)))) {
-                synctex_node_p other_input = input;
-                while((other_input = __synctex_tree_sibling(other_input))) {
-                    if (_synctex_is_equivalent_file_name(name,_synctex_base_name(_synctex_data_name(other_input)))
-                        && (strlen(_synctex_data_name(input))!=strlen(_synctex_data_name(other_input))
-                            || strncmp(_synctex_data_name(other_input),_synctex_data_name(input),strlen(_synctex_data_name(input))))) {
-                            // There is a second possible candidate
-                            return 0;
-                        }
+#   endif
+    if (NULL == lazy->text) {
+        /*  Inflate the remaining content in memory, null terminated. */
+        size_t capacity = 4*SYNCTEX_BUFFER_SIZE;
+        int read = 0;
+        size = SYNCTEX_END-SYNCTEX_CUR;
+        if (NULL == (lazy->text = (char *)malloc(capacity+1))) {
+            goto bail;
+        }
+        memcpy(lazy->text,SYNCTEX_CUR,size);
+        SYNCTEX_CUR = SYNCTEX_END;
+        while ((read = _synctex_reader_read(scanner->reader,lazy->text+size,(unsigned)(capacity-size)))>0) {
+            size += read;
+            if (size == capacity) {
+                char * text = (char *)realloc(lazy->text,2*capacity+1);
+                if (NULL == text) {
+                    goto bail;
                 }
-                return _synctex_data_tag(input);
+                lazy->text = text;
+                capacity *= 2;
             }
-        } while((input = __synctex_tree_sibling(input)));
+        }
+        if (read<0) {
+            goto bail;
+        }
+        lazy->text[size] = '\0';
+        lazy->size = size;
+        lazy->offset = offset;
+        lazy->content = lazy->text;
     }
-    return 0;
+    if (_synctex_lazy_index(scanner,lazy,line_number) != SYNCTEX_STATUS_OK
+        || _synctex_post_process(scanner) != SYNCTEX_STATUS_OK) {
+        goto bail;
+    }
+    scanner->lazy = lazy;
+    /*  The reader goes on with the postamble, already in memory. */
+    size = lazy->text+lazy->size-lazy->postamble;
+    if (size>SYNCTEX_BUFFER_SIZE) {
+        size = SYNCTEX_BUFFER_SIZE;
+    }
+    memcpy(SYNCTEX_START,lazy->postamble,size);
+    SYNCTEX_CUR = SYNCTEX_START;
+    SYNCTEX_END = SYNCTEX_START+size;
+    *SYNCTEX_END = '\0';
+    _synctex_reader_close(scanner->reader);
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    scanner->reader->charindex_offset = lazy->offset+(lazy->postamble-lazy->text);
+#   endif
+    scanner->reader->line_number = lazy->postamble_line_number;
+    return SYNCTEX_STATUS_OK;
+bail:
+    /*  Forget what the quick pass did. */
+    synctex_node_free(scanner->form);
+    scanner->form = scanner->ref_in_form = NULL;
+    _synctex_scanner_remove_inputs_before(scanner,input);
+    scanner->reader->line_number = line_number;
+    if (lazy->is_mapped || NULL == lazy->content) {
+        _synctex_lazy_free(lazy);
+        if (offset != _synctex_reader_seek(scanner->reader,offset)) {
+            _synctex_error("Can't seek file");
+            return SYNCTEX_STATUS_ERROR;
+        }
+        SYNCTEX_CUR = SYNCTEX_END;
+#   if defined(SYNCTEX_USE_CHARINDEX)
+        scanner->reader->charindex_offset = offset-(SYNCTEX_END-SYNCTEX_START);
+#   endif
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    /*  The reader takes the inflated content. */
+    free(SYNCTEX_START);
+    SYNCTEX_START = SYNCTEX_CUR = lazy->text;
+    SYNCTEX_END = lazy->text+lazy->size;
+    lazy->text = NULL;
+    _synctex_lazy_free(lazy);
+    _synctex_reader_close(scanner->reader);
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    scanner->reader->charindex_offset = offset;
+#   endif
+    return SYNCTEX_STATUS_NOT_OK;
 }
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Reload
+#   endif
+/*  When the document is typeset again, most sheets of the new synctex file
+ *  are the same as before, up to their page number.
+ *  A new lazy scanner takes over the sheets already parsed by the previous scanner,
+ *  with their memory, and each time it would parse a sheet
+ *  with the same content hash, it reuses the previous one instead.
+ *  A reused sheet is made of the very nodes a parse would have created,
+ *  the friends are registered again in the same order.
+ *  Sheets that refer to forms are not reused, forms are always parsed again.
+ */
+typedef struct {
+    synctex_node_p node;        /*  the previous sheet, NULL once reused */
+    synctex_node_p * friends;   /*  in the order of the previous friend lists */
+    int number_of_friends;
+    int capacity_of_friends;
+    unsigned long long hash;
+    int lastv;
+    size_t offset;              /*  the previous file offset of the sheet */
+    int line_number;            /*  the previous line number of the sheet */
+    size_t number_of_allocations;
+} synctex_reload_sheet_s;
+
+struct synctex_reload_t {
+    synctex_reload_sheet_s * sheets;    /*  sorted by node */
+    int number_of_sheets;
+    int number_of_reused_sheets;
+};
 
-int synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name) {
-    size_t char_index = strlen(name);
-    if ((scanner = synctex_scanner_parse(scanner)) && (0 < char_index)) {
-        /*  the name is not void */
-        char_index -= 1;
-        if (!SYNCTEX_IS_PATH_SEPARATOR(name[char_index])) {
-            /*  the last character of name is not a path separator */
-            int result = _synctex_scanner_get_tag(scanner,name);
-            if (result) {
-                return result;
-            } else {
-                /*  the given name was not the one known by TeX
-                 *  try a name relative to the enclosing directory of the scanner->output file */
-                const char * relative = name;
-                const char * ptr = scanner->reader->output;
-                while((strlen(relative) > 0) && (strlen(ptr) > 0) && (*relative == *ptr))
-                {
-                    relative += 1;
-                    ptr += 1;
-                }
-                /*  Find the last path separator before relative */
-                while(relative > name) {
-                    if (SYNCTEX_IS_PATH_SEPARATOR(*(relative-1))) {
-                        break;
-                    }
-                    relative -= 1;
-                }
-                if ((relative > name) && (result = _synctex_scanner_get_tag(scanner,relative))) {
-                    return result;
+static void _synctex_reload_free(synctex_reload_p reload) {
+    if (reload) {
+        int i;
+        for (i=0;i<reload->number_of_sheets;++i) {
+            free(reload->sheets[i].friends);
+        }
+        free(reload->sheets);
+        free(reload);
+    }
+}
+static int _synctex_reload_sheet_compare(const void * lhs, const void * rhs) {
+    synctex_node_p l = ((const synctex_reload_sheet_s *)lhs)->node;
+    synctex_node_p r = ((const synctex_reload_sheet_s *)rhs)->node;
+    return l<r? -1: (l>r? 1: 0);
+}
+/**
+ *  Record the friends of the previous sheets.
+ *  - returns: no on memory problem.
+ */
+static synctex_bool_t _synctex_reload_collect_friends(synctex_reload_p reload, synctex_scanner_p previous) {
+    int i;
+    for (i=0;i<previous->number_of_lists;++i) {
+        synctex_node_p node;
+        for (node = previous->lists_of_friends[i]; node; node = _synctex_tree_friend(node)) {
+            synctex_reload_sheet_s key;
+            synctex_reload_sheet_s * sheet;
+            synctex_node_p parent;
+            key.node = node;
+            while ((parent = _synctex_tree_parent(key.node))) {
+                key.node = parent;
+            }
+            sheet = bsearch(&key,reload->sheets,reload->number_of_sheets,sizeof(synctex_reload_sheet_s),&_synctex_reload_sheet_compare);
+            if (sheet) {
+                if (!_synctex_lazy_grow((void **)&sheet->friends,&sheet->capacity_of_friends,sheet->number_of_friends,sizeof(synctex_node_p))) {
+                    return synctex_NO;
                 }
-                if (SYNCTEX_IS_PATH_SEPARATOR(name[0])) {
-                    /*  No tag found for the given absolute name,
-                     *  Try each relative path starting from the shortest one */
-                    while(0<char_index) {
-                        char_index -= 1;
-                        if (SYNCTEX_IS_PATH_SEPARATOR(name[char_index])
-                            && (result = _synctex_scanner_get_tag(scanner,name+char_index+1))) {
-                            return result;
-                        }
-                    }
+                sheet->friends[sheet->number_of_friends++] = node;
+            }
+        }
+    }
+    return synctex_YES;
+}
+/*  The previous scanner memory is taken over as a whole,
+ *  it is not worth it when more than half of it is not used by the sheets to reuse,
+ *  for example after many reloads. */
+#   if !defined(SYNCTEX_RELOAD_MAX_WASTE)
+#       define SYNCTEX_RELOAD_MAX_WASTE 2
+#   endif
+int synctex_scanner_set_previous(synctex_scanner_p scanner, synctex_scanner_p previous) {
+    synctex_lazy_p lazy = previous && previous != scanner? previous->lazy: NULL;
+    synctex_reload_p reload = NULL;
+    synctex_node_p last = NULL;
+    size_t allocations = 0;
+    int i, j = 0;
+    if (NULL == scanner || NULL == lazy || scanner->flags.has_parsed || scanner->reload) {
+        goto bail;
+    }
+    for (i=0;i<lazy->number_of_sheets;++i) {
+        if (lazy->sheets[i].node) {
+            allocations += lazy->sheets[i].number_of_allocations;
+            if (!lazy->sheets[i].has_ref) {
+                ++j;
+            }
+        }
+    }
+    if (0 == j || previous->arena.number_of_allocations>SYNCTEX_RELOAD_MAX_WASTE*allocations
+        || NULL == (reload = (synctex_reload_p)_synctex_malloc(sizeof(struct synctex_reload_t)))
+        || NULL == (reload->sheets = (synctex_reload_sheet_s *)_synctex_malloc(j*sizeof(synctex_reload_sheet_s)))) {
+        goto bail;
+    }
+    /*  Detach the sheets to reuse, the others stay with the previous scanner. */
+    previous->sheet = NULL;
+    for (i=0;i<lazy->number_of_sheets;++i) {
+        synctex_lazy_sheet_s * sheet = lazy->sheets+i;
+        if (sheet->node) {
+            __synctex_tree_reset_sibling(sheet->node);
+            if (sheet->has_ref) {
+                if (last) {
+                    __synctex_tree_set_sibling(last,sheet->node);
+                } else {
+                    previous->sheet = sheet->node;
                 }
+                last = sheet->node;
+            } else {
+                /*  The classes of previous will not survive. */
+                _synctex_tree_adopt(sheet->node,scanner);
+                reload->sheets[reload->number_of_sheets++] = (synctex_reload_sheet_s){
+                    sheet->node,NULL,0,0,sheet->hash,sheet->lastv,
+                    lazy->offset+(sheet->start-lazy->text),sheet->line_number,sheet->number_of_allocations
+                };
             }
-            return result;
         }
     }
+    qsort(reload->sheets,reload->number_of_sheets,sizeof(synctex_reload_sheet_s),&_synctex_reload_sheet_compare);
+    if (!_synctex_reload_collect_friends(reload,previous)) {
+        /*  The detached sheets are not freed, the arena will do. */
+        goto bail;
+    }
+    _synctex_arena_adopt(&scanner->arena,&previous->arena);
+    scanner->reload = reload;
+    synctex_scanner_free(previous);
     return 0;
+bail:
+    _synctex_reload_free(reload);
+    if (previous != scanner) {
+        synctex_scanner_free(previous);
+    }
+    return -1;
 }
-synctex_node_p synctex_scanner_input(synctex_scanner_p scanner) {
-    return scanner?scanner->input:NULL;
-}
-synctex_node_p synctex_scanner_input_with_tag(synctex_scanner_p scanner, int tag) {
-    synctex_node_p input = scanner?scanner->input:NULL;
-    while (_synctex_data_tag(input)!=tag) {
-        if ((input = __synctex_tree_sibling(input))) {
+#   if defined(SYNCTEX_USE_CHARINDEX)
+/**
+ *  Shift the char and line indexes of the given previous sheet
+ *  to the new location of the sheet.
+ */
+static void _synctex_reload_shift(synctex_node_p node, long offset, int lines) {
+    while (node) {
+        synctex_node_p next;
+        node->char_index += offset;
+        node->line_index += lines;
+        if ((next = _synctex_tree_child(node))) {
+            node = next;
             continue;
         }
-        break;
+        while (!(next = __synctex_tree_sibling(node))
+               && (node = _synctex_tree_parent(node))) {}
+        node = next;
     }
-    return input;
-}
-const char * synctex_scanner_get_output_fmt(synctex_scanner_p scanner) {
-    return NULL != scanner && scanner->output_fmt?scanner->output_fmt:"";
-}
-const char * synctex_scanner_get_output(synctex_scanner_p scanner) {
-    return NULL != scanner && scanner->reader->output?scanner->reader->output:"";
 }
-const char * synctex_scanner_get_synctex(synctex_scanner_p scanner) {
-    return NULL != scanner && scanner->reader->synctex?scanner->reader->synctex:"";
+#   endif
+/**
+ *  The previous sheet with the same content as the given sheet of the lazy index.
+ *  - parameter offset: the file offset of the sheet.
+ *  - returns: the previous sheet, now owned by scanner with its friends registered,
+ *      NULL if there is none.
+ */
+static synctex_node_p _synctex_reload_sheet(synctex_scanner_p scanner, synctex_lazy_sheet_s * sheet, size_t offset) {
+    synctex_reload_p reload = scanner->reload;
+    int i, j;
+    if (NULL == reload || NULL == sheet->stop || sheet->has_ref) {
+        return NULL;
+    }
+    for (i=0;i<reload->number_of_sheets;++i) {
+        synctex_reload_sheet_s * previous = reload->sheets+i;
+        if (previous->node && previous->hash == sheet->hash && previous->lastv == sheet->lastv) {
+            synctex_node_p node = previous->node;
+            previous->node = NULL;
+#   if defined(SYNCTEX_USE_CHARINDEX)
+            _synctex_reload_shift(node,(long)offset-(long)previous->offset,sheet->line_number-previous->line_number);
+#   else
+            SYNCTEX_UNUSED(offset)
+#   endif
+            _synctex_data_set_page(node,sheet->page);
+            /*  Friends are prepended: restore the previous order. */
+            for (j=previous->number_of_friends;j-->0;) {
+                __synctex_node_make_friend_tlc(previous->friends[j]);
+            }
+            free(previous->friends);
+            previous->friends = NULL;
+            previous->number_of_friends = previous->capacity_of_friends = 0;
+            sheet->number_of_allocations = previous->number_of_allocations;
+            ++reload->number_of_reused_sheets;
+            return node;
+        }
+    }
+    return NULL;
 }
 #	ifdef SYNCTEX_NOTHING
 #       pragma mark -
-#       pragma mark Public node attributes
+#       pragma mark Cache
 #   endif
+#   if defined(SYNCTEX_USE_CACHE)
+/*  The nodes of a parsed scanner are saved in a cache file
+ *  as flat records of 32 bits integers, where tree links are node indices.
+ *  The cache file is memory mapped when loading, such that the nodes
+ *  are created without decompressing nor parsing the synctex file.
+ *  The cache is keyed by the synctex path, size, modification date and content hash.
+ *  A node record is made of:
+ *  the type, the char and line indices when available,
+ *  the tree links, -1 for none,
+ *  the data, where the name of an input is an offset in the string table.
+ */
+#       define SYNCTEX_CACHE_MAGIC "SyncTeXC"
+#       define SYNCTEX_CACHE_VERSION 1
+#       define SYNCTEX_CACHE_FLAG_CHARINDEX 1
+#       define SYNCTEX_CACHE_EXTENSION ".synctexcache"
 
-#   define SYNCTEX_DEFINE_NODE_HVWHD(WHAT) \
-int synctex_node_##WHAT(synctex_node_p node) { \
-    return (node && node->class_->inspector->WHAT)? \
-        node->class_->inspector->WHAT(node): 0; \
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t flags;
+    int64_t size;           /*  the size of the synctex file */
+    int64_t mtime;          /*  the modification date of the synctex file */
+    uint64_t hash;          /*  the hash of the synctex file content */
+    int32_t path_size;      /*  the synctex path, null terminated and padded */
+    int32_t output_fmt_size;/*  the output format, null terminated and padded */
+    int32_t number_of_lists;
+    int32_t number_of_nodes;
+    int32_t number_of_ints; /*  the size of the node records */
+    int32_t strings_size;
+    int32_t input;          /*  the first nodes, -1 for none */
+    int32_t sheet;
+    int32_t form;
+    int32_t synctex_version;
+    int32_t pre_magnification;
+    int32_t pre_unit;
+    int32_t pre_x_offset;
+    int32_t pre_y_offset;
+    int32_t count;
+    float unit;
+    float x_offset;
+    float y_offset;
+} synctex_cache_header_s;
+
+#       define SYNCTEX_CACHE_PAD(SIZE) (((SIZE)+3)&~3)
+#       define SYNCTEX_CACHE_FNV_OFFSET 14695981039346656037ULL
+#       define SYNCTEX_CACHE_FNV_PRIME 1099511628211ULL
+
+SYNCTEX_INLINE static uint64_t _synctex_cache_hash_bytes(uint64_t hash, const unsigned char * bytes, size_t size) {
+    while (size--) {
+        hash ^= *bytes++;
+        hash *= SYNCTEX_CACHE_FNV_PRIME;
+    }
+    return hash;
 }
-#   define SYNCTEX_DEFINE_PROXY_HV(WHAT) \
-static int _synctex_proxy_##WHAT(synctex_proxy_p proxy) { \
-    synctex_node_p target = _synctex_tree_target(proxy); \
-    if (target) { \
-        return _synctex_data_##WHAT(proxy)+synctex_node_##WHAT(target); \
-    } else { \
-        return proxy? _synctex_data_##WHAT(proxy): 0; \
-    } \
-}
-#define SYNCTEX_DEFINE_PROXY_TLCWVD(WHAT) \
-static int _synctex_proxy_##WHAT(synctex_proxy_p proxy) { \
-    synctex_node_p target = _synctex_tree_target(proxy); \
-    return target? synctex_node_##WHAT(target): 0; \
-}
-
-/**
- *  The horizontal location of the node.
- *  Idem for v, width, height and depth.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - requires: every proxy node has a target.
- *  - note: recursive call if the parameter has a proxy.
- *  - author: JL
- */
-SYNCTEX_DEFINE_NODE_HVWHD(h)
-SYNCTEX_DEFINE_NODE_HVWHD(v)
-SYNCTEX_DEFINE_NODE_HVWHD(width)
-SYNCTEX_DEFINE_NODE_HVWHD(height)
-SYNCTEX_DEFINE_NODE_HVWHD(depth)
-SYNCTEX_DEFINE_PROXY_TLCWVD(tag)
-SYNCTEX_DEFINE_PROXY_TLCWVD(line)
-SYNCTEX_DEFINE_PROXY_TLCWVD(column)
-SYNCTEX_DEFINE_PROXY_HV(h)
-SYNCTEX_DEFINE_PROXY_HV(v)
-SYNCTEX_DEFINE_PROXY_TLCWVD(width)
-SYNCTEX_DEFINE_PROXY_TLCWVD(height)
-SYNCTEX_DEFINE_PROXY_TLCWVD(depth)
-
-/**
- *  Whether the argument is a box,
- *  either vertical or horizontal,
- *  either void or not,
- *  or a proxy to such a box.
- *  - parameter NODE: of type synctex_node_p
- *  - returns: yorn
- */
-
-SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_box(synctex_node_p node) {
-    return node &&
-    (node->class_->type == synctex_node_type_hbox
-     || node->class_->type == synctex_node_type_void_hbox
-     || node->class_->type == synctex_node_type_vbox
-     || node->class_->type == synctex_node_type_void_vbox
-     || _synctex_node_is_box(_synctex_tree_target(node)));
-}
-
 /**
- *  Whether the argument is a handle.
- *  Handles are similar to proxies because they have a target.
- *  They are used for query results.
- *  - parameter NODE: of type synctex_node_p
- *  - returns: yorn
- */
-
-SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_handle(synctex_node_p node) {
-    return node &&
-    (node->class_->type == synctex_node_type_handle);
+ *  Fill the key part of the header from the synctex file.
+ *  - returns: no when the file cannot be read.
+ */
+static synctex_bool_t _synctex_cache_key(const char * synctex, synctex_cache_header_s * header) {
+    unsigned char buffer[65536];
+    uint64_t hash = SYNCTEX_CACHE_FNV_OFFSET;
+    struct stat st;
+    ssize_t size;
+    int fd = open(synctex,O_RDONLY);
+    if (fd<0) {
+        return synctex_NO;
+    }
+    if (fstat(fd,&st)) {
+        close(fd);
+        return synctex_NO;
+    }
+    while ((size = read(fd,buffer,sizeof(buffer)))>0) {
+        hash = _synctex_cache_hash_bytes(hash,buffer,(size_t)size);
+    }
+    close(fd);
+    if (size<0) {
+        return synctex_NO;
+    }
+    memcpy(header->magic,SYNCTEX_CACHE_MAGIC,sizeof(header->magic));
+    header->version = SYNCTEX_CACHE_VERSION;
+#       if defined(SYNCTEX_USE_CHARINDEX)
+    header->flags = SYNCTEX_CACHE_FLAG_CHARINDEX;
+#       endif
+    header->size = (int64_t)st.st_size;
+    header->mtime = (int64_t)st.st_mtime;
+    header->hash = hash;
+    header->path_size = SYNCTEX_CACHE_PAD((int32_t)strlen(synctex)+1);
+    return synctex_YES;
 }
-
 /**
- *  Resolves handle indirection.
- *  - parameter node: of type synctex_node_p
- *  - returns: node if it is not a handle,
- *  its target otherwise.
+ *  The cache file of the given synctex file,
+ *  named after the hash of its path.
+ *  - returns: a string to be freed by the caller.
  */
-
-SYNCTEX_INLINE static synctex_node_p _synctex_node_or_handle_target(synctex_node_p node) {
-    return _synctex_node_is_handle(node)?
-    _synctex_tree_target(node):node;
+static char * _synctex_cache_path(synctex_scanner_p scanner) {
+    const char * synctex = scanner->reader->synctex;
+    uint64_t hash = _synctex_cache_hash_bytes(SYNCTEX_CACHE_FNV_OFFSET,(const unsigned char *)synctex,strlen(synctex));
+    size_t size = strlen(scanner->cache_directory)+1+16+strlen(SYNCTEX_CACHE_EXTENSION)+1;
+    char * path = (char *)_synctex_malloc(size);
+    if (path) {
+        snprintf(path,size,"%s/%016llx%s",scanner->cache_directory,(unsigned long long)hash,SYNCTEX_CACHE_EXTENSION);
+    }
+    return path;
 }
+/*  Maps node pointers to their index in the cache. */
+typedef struct {
+    synctex_node_p * nodes;     /*  the nodes in index order */
+    int number_of_nodes;
+    int capacity;
+    int32_t * table;            /*  open addressing, -1 for empty slots */
+    size_t mask;
+} synctex_cache_index_s;
 
-/**
- *  Whether the argument is an hbox.
- *  - parameter NODE: of type synctex_node_p
- *  - returns: yorn
- */
-
-SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_hbox(synctex_node_p node) {
-    return node &&
-    (node->class_->type == synctex_node_type_hbox
-     || node->class_->type == synctex_node_type_void_hbox
-     || _synctex_node_is_hbox(_synctex_tree_target(node)));
+SYNCTEX_INLINE static size_t _synctex_cache_index_slot(synctex_cache_index_s * index, synctex_node_p node) {
+    size_t slot = (((size_t)node)>>4)*SYNCTEX_CACHE_FNV_PRIME;
+    return (slot^(slot>>29))&index->mask;
 }
-
 /**
- *  The horizontal location of the first box enclosing node.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - author: JL
+ *  Collect the nodes of the tree rooted at node and its siblings.
  */
-int synctex_node_box_h(synctex_node_p node) {
-    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
-        return synctex_node_h(node);
+static synctex_bool_t _synctex_cache_index_collect(synctex_cache_index_s * index, synctex_node_p node) {
+    while (node) {
+        synctex_node_p next;
+        if (index->number_of_nodes == index->capacity) {
+            int capacity = index->capacity? 2*index->capacity: 1024;
+            synctex_node_p * nodes = (synctex_node_p *)realloc(index->nodes,capacity*sizeof(synctex_node_p));
+            if (NULL == nodes) {
+                return synctex_NO;
+            }
+            index->nodes = nodes;
+            index->capacity = capacity;
+        }
+        index->nodes[index->number_of_nodes++] = node;
+        if ((next = _synctex_tree_child(node))) {
+            node = next;
+            continue;
+        }
+        while (!(next = __synctex_tree_sibling(node))
+               && (node = _synctex_tree_parent(node))) {}
+        node = next;
     }
-    return 0;
+    return synctex_YES;
 }
-/**
- *  The vertical location of the first box enclosing node.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - author: JL
- */
-int synctex_node_box_v(synctex_node_p node) {
-    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
-        return synctex_node_v(node);
+static synctex_bool_t _synctex_cache_index_build(synctex_cache_index_s * index) {
+    size_t size = 2;
+    int i;
+    while (size<2*(size_t)index->number_of_nodes) {
+        size *= 2;
     }
-    return 0;
-}
-/**
- *  The width of the first box enclosing node.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - author: JL
- */
-int synctex_node_box_width(synctex_node_p node) {
-    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
-        return synctex_node_width(node);
+    if (NULL == (index->table = (int32_t *)malloc(size*sizeof(int32_t)))) {
+        return synctex_NO;
     }
-    return 0;
+    memset(index->table,0xFF,size*sizeof(int32_t));
+    index->mask = size-1;
+    for (i=0;i<index->number_of_nodes;++i) {
+        size_t slot = _synctex_cache_index_slot(index,index->nodes[i]);
+        while (index->table[slot]>=0) {
+            slot = (slot+1)&index->mask;
+        }
+        index->table[slot] = i;
+    }
+    return synctex_YES;
 }
 /**
- *  The height of the first box enclosing node.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - author: JL
+ *  - returns: the index of node, -1 for NULL, -2 when unknown.
  */
-int synctex_node_box_height(synctex_node_p node) {
-    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
-        return synctex_node_height(node);
+static int32_t _synctex_cache_index_of(synctex_cache_index_s * index, synctex_node_p node) {
+    size_t slot;
+    if (NULL == node) {
+        return -1;
     }
-    return 0;
+    slot = _synctex_cache_index_slot(index,node);
+    while (index->table[slot]>=0) {
+        if (index->nodes[index->table[slot]] == node) {
+            return index->table[slot];
+        }
+        slot = (slot+1)&index->mask;
+    }
+    return -2;
 }
 /**
- *  The depth of the first box enclosing node.
- *  - parameter node: a node with geometrical information.
- *  - returns: an integer.
- *  - author: JL
+ *  The number of integers in the record of a node of the given class.
  */
-int synctex_node_box_depth(synctex_node_p node) {
-    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
-        return synctex_node_depth(node);
-    }
-    return 0;
+SYNCTEX_INLINE static int _synctex_cache_record_size(synctex_class_p class_) {
+#       if defined(SYNCTEX_USE_CHARINDEX)
+    return 3+class_->navigator->size+class_->modelator->size;
+#       else
+    return 1+class_->navigator->size+class_->modelator->size;
+#       endif
 }
 /**
- *  The horizontal location of an hbox, corrected with contents.
- *  - parameter node: an hbox node.
- *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
- *  - note: recursive call when node is an hbox proxy.
- *  - author: JL
+ *  Write a null terminated string padded with zeros to the given size.
  */
-int synctex_node_hbox_h(synctex_node_p node) {
-    switch(synctex_node_type(node)) {
-        case synctex_node_type_hbox:
-            return _synctex_data_h_V(node);
-        case synctex_node_type_proxy_hbox:
-            return _synctex_data_h(node)+synctex_node_hbox_h(_synctex_tree_target(node));
-        default:
-            return 0;
+static synctex_bool_t _synctex_cache_write_string(FILE * file, const char * string, int32_t size) {
+    static const char zeros[4] = {0,0,0,0};
+    size_t length = string? strlen(string): 0;
+    if (length && 1 != fwrite(string,length,1,file)) {
+        return synctex_NO;
     }
+    return size-(int32_t)length<=0 || 1 == fwrite(zeros,size-length,1,file);
 }
 /**
- *  The vertical location of an hbox, corrected with contents.
- *  - parameter node: an hbox node.
- *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
- *  - note: recursive call when node is an hbox proxy.
- *  - author: JL
+ *  Create a node of the given type with no links and no data.
+ *  The creator of the class is not used because it may scan.
  */
-int synctex_node_hbox_v(synctex_node_p node) {
-    switch(synctex_node_type(node)) {
-        case synctex_node_type_hbox:
-            return _synctex_data_v_V(node);
-        case synctex_node_type_proxy_hbox:
-            return _synctex_data_v(node)+synctex_node_hbox_v(_synctex_tree_target(node));
-        default:
-            return 0;
+SYNCTEX_INLINE static synctex_node_p _synctex_cache_new_node(synctex_scanner_p scanner, int type) {
+    synctex_class_p class_ = scanner->class_+type;
+    synctex_node_p node = (synctex_node_p)_synctex_arena_malloc(&scanner->arena,offsetof(struct synctex_node_t,data)
+                                                          +(class_->navigator->size+class_->modelator->size)*sizeof(synctex_data_u));
+    if (node) {
+        node->class_ = class_;
+        SYNCTEX_DID_NEW(node);
     }
+    return node;
 }
 /**
- *  The width of an hbox, corrected with contents.
- *  - parameter node: an hbox node, 0 if node is not an hbox or an hbox proxy.
- *  - returns: an integer.
- *  - author: JL
- */
-int synctex_node_hbox_width(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    if (target) {
-        node = target;
+ *  Save the nodes of the scanner in the cache directory.
+ *  The cache file is replaced atomically.
+ *  - returns: SYNCTEX_STATUS_OK on success.
+ */
+static synctex_status_t _synctex_scanner_write_cache(synctex_scanner_p scanner) {
+    synctex_cache_header_s header;
+    synctex_cache_index_s index;
+    synctex_status_t status = SYNCTEX_STATUS_ERROR;
+    int32_t record[64];
+    int32_t strings_offset = 0;
+    char * path = NULL;
+    char * tmp = NULL;
+    FILE * file = NULL;
+    int fd = -1;
+    int i, j, k;
+    memset(&header,0,sizeof(header));
+    memset(&index,0,sizeof(index));
+    if (!_synctex_cache_key(scanner->reader->synctex,&header)
+        || NULL == (path = _synctex_cache_path(scanner))) {
+        goto bail;
+    }
+    if (!_synctex_cache_index_collect(&index,scanner->input)
+        || !_synctex_cache_index_collect(&index,scanner->sheet)
+        || !_synctex_cache_index_collect(&index,scanner->form)
+        || !_synctex_cache_index_build(&index)) {
+        _synctex_error("!  _synctex_scanner_write_cache: Memory problem.");
+        goto bail;
+    }
+    header.output_fmt_size = SYNCTEX_CACHE_PAD(scanner->output_fmt? (int32_t)strlen(scanner->output_fmt)+1: 0);
+    header.number_of_lists = scanner->number_of_lists;
+    header.number_of_nodes = index.number_of_nodes;
+    for (i=0;i<index.number_of_nodes;++i) {
+        synctex_node_p node = index.nodes[i];
+        header.number_of_ints += _synctex_cache_record_size(node->class_);
+        if (_synctex_data_has_name(node) && _synctex_data_name(node)) {
+            header.strings_size += (int32_t)strlen(_synctex_data_name(node))+1;
+        }
+    }
+    header.input = _synctex_cache_index_of(&index,scanner->input);
+    header.sheet = _synctex_cache_index_of(&index,scanner->sheet);
+    header.form = _synctex_cache_index_of(&index,scanner->form);
+    header.synctex_version = scanner->version;
+    header.pre_magnification = scanner->pre_magnification;
+    header.pre_unit = scanner->pre_unit;
+    header.pre_x_offset = scanner->pre_x_offset;
+    header.pre_y_offset = scanner->pre_y_offset;
+    header.count = scanner->count;
+    header.unit = scanner->unit;
+    header.x_offset = scanner->x_offset;
+    header.y_offset = scanner->y_offset;
+    if (NULL == (tmp = (char *)_synctex_malloc(strlen(path)+8))) {
+        goto bail;
+    }
+    sprintf(tmp,"%s.XXXXXX",path);
+    if ((fd = mkstemp(tmp))<0 || NULL == (file = fdopen(fd,"wb"))) {
+        _synctex_error("!  _synctex_scanner_write_cache: Can't create %s.",tmp);
+        goto bail;
+    }
+    fd = -1;
+    if (1 != fwrite(&header,sizeof(header),1,file)
+        || !_synctex_cache_write_string(file,scanner->reader->synctex,header.path_size)
+        || !_synctex_cache_write_string(file,scanner->output_fmt,header.output_fmt_size)) {
+        goto bail;
+    }
+    for (i=0;i<scanner->number_of_lists;++i) {
+        int32_t friend = _synctex_cache_index_of(&index,scanner->lists_of_friends[i]);
+        if (friend<-1 || 1 != fwrite(&friend,sizeof(friend),1,file)) {
+            goto bail;
+        }
+    }
+    for (i=0;i<index.number_of_nodes;++i) {
+        synctex_node_p node = index.nodes[i];
+        synctex_tree_model_p navigator = node->class_->navigator;
+        synctex_data_model_p modelator = node->class_->modelator;
+        k = 0;
+        record[k++] = synctex_node_type(node);
+#       if defined(SYNCTEX_USE_CHARINDEX)
+        record[k++] = (int32_t)node->char_index;
+        record[k++] = (int32_t)node->line_index;
+#       endif
+        for (j=0;j<navigator->size;++j) {
+            if ((record[k++] = _synctex_cache_index_of(&index,node->data[j].as_node))<-1) {
+                _synctex_error("!  _synctex_scanner_write_cache: Unknown node.");
+                goto bail;
+            }
+        }
+        for (j=0;j<modelator->size;++j) {
+            if (j == modelator->name) {
+                char * name = __synctex_data(node)[j].as_string;
+                record[k++] = name? strings_offset: -1;
+                strings_offset += name? (int32_t)strlen(name)+1: 0;
+            } else {
+                record[k++] = __synctex_data(node)[j].as_integer;
+            }
+        }
+        if (1 != fwrite(record,k*sizeof(int32_t),1,file)) {
+            goto bail;
+        }
     }
-    return synctex_node_type(node) == synctex_node_type_hbox?
-    _synctex_data_width_V(node): 0;
+    for (i=0;i<index.number_of_nodes;++i) {
+        synctex_node_p node = index.nodes[i];
+        if (_synctex_data_has_name(node) && _synctex_data_name(node)
+            && 1 != fwrite(_synctex_data_name(node),strlen(_synctex_data_name(node))+1,1,file)) {
+            goto bail;
+        }
+    }
+    if (0 == fclose(file)) {
+        file = NULL;
+        if (0 == rename(tmp,path)) {
+            status = SYNCTEX_STATUS_OK;
+        }
+    }
+bail:
+    if (file) {
+        fclose(file);
+    }
+    if (fd>=0) {
+        close(fd);
+    }
+    if (tmp && status != SYNCTEX_STATUS_OK) {
+        unlink(tmp);
+    }
+    free(tmp);
+    free(path);
+    free(index.nodes);
+    free(index.table);
+    return status;
 }
 /**
- *  The height of an hbox, corrected with contents.
- *  - parameter node: an hbox node.
- *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
- *  - author: JL
- */
-int synctex_node_hbox_height(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    if (target) {
-        node = target;
+ *  Create the nodes of the scanner from its cache file, if up to date.
+ *  - returns: SYNCTEX_STATUS_OK on success,
+ *      otherwise the scanner is unchanged.
+ */
+static synctex_status_t _synctex_scanner_load_cache(synctex_scanner_p scanner) {
+    synctex_cache_header_s key;
+    const synctex_cache_header_s * header = NULL;
+    synctex_node_p * nodes = NULL;
+    synctex_status_t status = SYNCTEX_STATUS_NOT_OK;
+    struct stat st;
+    char * path = NULL;
+    char * map = NULL;
+    const char * strings = NULL;
+    const int32_t * lists = NULL;
+    const int32_t * records = NULL;
+    const int32_t * record = NULL;
+    size_t size = 0;
+    int fd = -1;
+    int i, j;
+    memset(&key,0,sizeof(key));
+    if (NULL == (path = _synctex_cache_path(scanner))) {
+        return SYNCTEX_STATUS_ERROR;
     }
-    return synctex_node_type(node) == synctex_node_type_hbox?
-    _synctex_data_height_V(node): 0;
+    fd = open(path,O_RDONLY);
+    free(path);
+    if (fd<0) {
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    if (fstat(fd,&st) || st.st_size<(off_t)sizeof(synctex_cache_header_s)
+        || MAP_FAILED == (map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0))) {
+        close(fd);
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    close(fd);
+    size = (size_t)st.st_size;
+    header = (const synctex_cache_header_s *)map;
+    /*  Check the version, the layout and the key. */
+    if (memcmp(header->magic,SYNCTEX_CACHE_MAGIC,sizeof(header->magic))
+        || header->version != SYNCTEX_CACHE_VERSION
+        || !_synctex_cache_key(scanner->reader->synctex,&key)
+        || header->flags != key.flags
+        || header->size != key.size
+        || header->mtime != key.mtime
+        || header->hash != key.hash
+        || header->path_size != key.path_size
+        || header->output_fmt_size<0 || header->output_fmt_size%4
+        || header->number_of_lists != scanner->number_of_lists
+        || header->number_of_nodes<0 || header->number_of_ints<0 || header->strings_size<0
+        || sizeof(synctex_cache_header_s)+(size_t)header->path_size+header->output_fmt_size
+            +sizeof(int32_t)*((size_t)header->number_of_lists+header->number_of_ints)
+            +header->strings_size != size
+        || strncmp(map+sizeof(synctex_cache_header_s),scanner->reader->synctex,header->path_size)) {
+        goto bail;
+    }
+    lists = (const int32_t *)(map+sizeof(synctex_cache_header_s)+header->path_size+header->output_fmt_size);
+    records = lists+header->number_of_lists;
+    strings = (const char *)(records+header->number_of_ints);
+    if (header->strings_size && strings[header->strings_size-1]) {
+        goto bail;
+    }
+    if (NULL == (nodes = (synctex_node_p *)_synctex_malloc((header->number_of_nodes+1)*sizeof(synctex_node_p)))) {
+        status = SYNCTEX_STATUS_ERROR;
+        goto bail;
+    }
+    /*  First create the nodes and check the records, then link them. */
+    for (i=0,record=records;i<header->number_of_nodes;++i) {
+        synctex_class_p class_ = NULL;
+        int type = 0;
+        if (record>=records+header->number_of_ints
+            || (type = *record)<=synctex_node_type_none || type>=synctex_node_type_handle
+            || record+_synctex_cache_record_size(class_ = scanner->class_+type)>records+header->number_of_ints
+            || NULL == (nodes[i] = _synctex_cache_new_node(scanner,type))) {
+            goto bail;
+        }
+#       if defined(SYNCTEX_USE_CHARINDEX)
+        record += 3;
+#       else
+        record += 1;
+#       endif
+        for (j=0;j<class_->navigator->size;++j,++record) {
+            if (*record<-1 || *record>=header->number_of_nodes) {
+                goto bail;
+            }
+        }
+        for (j=0;j<class_->modelator->size;++j,++record) {
+            if (j == class_->modelator->name && (*record<-1 || *record>=header->strings_size)) {
+                goto bail;
+            }
+        }
+    }
+    if (record != records+header->number_of_ints
+        || header->input<-1 || header->input>=header->number_of_nodes
+        || header->sheet<-1 || header->sheet>=header->number_of_nodes
+        || header->form<-1 || header->form>=header->number_of_nodes) {
+        goto bail;
+    }
+    for (i=0;i<header->number_of_lists;++i) {
+        if (lists[i]<-1 || lists[i]>=header->number_of_nodes) {
+            goto bail;
+        }
+    }
+    for (i=0,record=records;i<header->number_of_nodes;++i) {
+        synctex_node_p node = nodes[i];
+        synctex_tree_model_p navigator = node->class_->navigator;
+        synctex_data_model_p modelator = node->class_->modelator;
+        ++record;
+#       if defined(SYNCTEX_USE_CHARINDEX)
+        node->char_index = (synctex_charindex_t)*record++;
+        node->line_index = (synctex_lineindex_t)*record++;
+#       endif
+        for (j=0;j<navigator->size;++j,++record) {
+            node->data[j].as_node = *record<0? NULL: nodes[*record];
+        }
+        for (j=0;j<modelator->size;++j,++record) {
+            if (j == modelator->name) {
+                char * name = NULL;
+                if (*record>=0) {
+                    size_t length = strlen(strings+*record);
+                    if ((name = (char *)_synctex_malloc(length+1))) {
+                        memcpy(name,strings+*record,length+1);
+                    } else {
+                        status = SYNCTEX_STATUS_ERROR;
+                    }
+                }
+                __synctex_data(node)[j].as_string = name;
+            } else {
+                __synctex_data(node)[j].as_integer = *record;
+            }
+        }
+    }
+    scanner->input = header->input<0? NULL: nodes[header->input];
+    scanner->flags.new_inputs = 1;
+    scanner->sheet = header->sheet<0? NULL: nodes[header->sheet];
+    scanner->form = header->form<0? NULL: nodes[header->form];
+    for (i=0;i<header->number_of_lists;++i) {
+        scanner->lists_of_friends[i] = lists[i]<0? NULL: nodes[lists[i]];
+    }
+    free(nodes);
+    nodes = NULL;
+    if (status == SYNCTEX_STATUS_ERROR) {
+        _synctex_error("!  _synctex_scanner_load_cache: Memory problem.");
+        synctex_node_free(scanner->sheet);
+        synctex_node_free(scanner->form);
+        synctex_node_free(scanner->input);
+        scanner->sheet = scanner->form = scanner->input = NULL;
+        scanner->flags.new_inputs = 1;
+        memset(scanner->lists_of_friends,0,scanner->number_of_lists*sizeof(synctex_node_p));
+        goto bail;
+    }
+    if (header->output_fmt_size) {
+        const char * output_fmt = map+sizeof(synctex_cache_header_s)+header->path_size;
+        size_t length = strnlen(output_fmt,header->output_fmt_size);
+        if ((scanner->output_fmt = (char *)_synctex_malloc(length+1))) {
+            memcpy(scanner->output_fmt,output_fmt,length);
+        }
+    }
+    scanner->version = header->synctex_version;
+    scanner->pre_magnification = header->pre_magnification;
+    scanner->pre_unit = header->pre_unit;
+    scanner->pre_x_offset = header->pre_x_offset;
+    scanner->pre_y_offset = header->pre_y_offset;
+    scanner->count = header->count;
+    scanner->unit = header->unit;
+    scanner->x_offset = header->x_offset;
+    scanner->y_offset = header->y_offset;
+    scanner->flags.postamble = 1;
+    status = SYNCTEX_STATUS_OK;
+bail:
+    if (nodes) {
+        /*  The nodes are not linked yet. */
+        for (i=0;i<header->number_of_nodes && nodes[i];++i) {
+            synctex_node_free(nodes[i]);
+        }
+        free(nodes);
+    }
+    munmap(map,size);
+    return status;
 }
-/**
- *  The depth of an hbox, corrected with contents.
- *  - parameter node: an hbox node.
- *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
- *  - note: recursive call when node is an hbox proxy.
- *  - author: JL
+#   endif
+/*  Used when parsing the synctex file
  */
-int synctex_node_hbox_depth(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    if (target) {
-        node = target;
+static synctex_status_t _synctex_scan_content(synctex_scanner_p scanner) {
+    if (NULL == scanner) {
+        return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
-    return synctex_node_type(node) == synctex_node_type_hbox?
-    _synctex_data_depth_V(node): 0;
+    scanner->reader->lastv = -1;
+    synctex_status_t status = 0;
+    /*  Find where this section starts */
+content_not_found:
+    status = _synctex_match_string(scanner,"Content:");
+    if (status<SYNCTEX_STATUS_EOF) {
+        return status;
+    }
+    if (_synctex_next_line(scanner)<SYNCTEX_STATUS_OK) {
+        _synctex_error("Incomplete Content.");
+        return SYNCTEX_STATUS_ERROR;
+    }
+    if (status == SYNCTEX_STATUS_NOT_OK) {
+        goto content_not_found;
+    }
+    if ((status = _synctex_scan_content_lazy(scanner)) != SYNCTEX_STATUS_NOT_OK) {
+        return status;
+    }
+#   if defined(SYNCTEX_USE_MAPPED_PARSE)
+    if ((status = _synctex_scan_content_mapped(scanner)) != SYNCTEX_STATUS_NOT_OK) {
+        return status;
+    }
+#   endif
+    status = __synctex_parse_sfi(scanner);
+    if (status == SYNCTEX_STATUS_OK) {
+        status = _synctex_post_process(scanner);
+    }
+    return status;
 }
+synctex_scanner_p synctex_scanner_new() {
+    synctex_scanner_p scanner =(synctex_scanner_p)_synctex_malloc(sizeof(synctex_scanner_s));
+    if (scanner) {
+        if (!(scanner->reader = _synctex_malloc(sizeof(synctex_reader_s)))) {
+            _synctex_free(scanner);
+            return NULL;
+        }
 #	ifdef SYNCTEX_NOTHING
 #       pragma mark -
-#       pragma mark Public node visible attributes
 #   endif
-
-#define SYNCTEX_VISIBLE_SIZE(node,s) \
-(s)*node->class_->scanner->unit
-#define SYNCTEX_VISIBLE_DISTANCE_h(node,d) \
-((d)*node->class_->scanner->unit+node->class_->scanner->x_offset)
-#define SYNCTEX_VISIBLE_DISTANCE_v(node,d) \
-((d)*node->class_->scanner->unit+node->class_->scanner->y_offset)
-static float __synctex_node_visible_h(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_h(node,synctex_node_h(node));
+#   define DEFINE_synctex_scanner_class(NAME)\
+    scanner->class_[synctex_node_type_##NAME] = synctex_class_##NAME;\
+(scanner->class_[synctex_node_type_##NAME]).scanner = scanner
+        DEFINE_synctex_scanner_class(input);
+        DEFINE_synctex_scanner_class(sheet);
+        DEFINE_synctex_scanner_class(form);
+        DEFINE_synctex_scanner_class(hbox);
+        DEFINE_synctex_scanner_class(void_hbox);
+        DEFINE_synctex_scanner_class(vbox);
+        DEFINE_synctex_scanner_class(void_vbox);
+        DEFINE_synctex_scanner_class(kern);
+        DEFINE_synctex_scanner_class(glue);
+        DEFINE_synctex_scanner_class(rule);
+        DEFINE_synctex_scanner_class(math);
+        DEFINE_synctex_scanner_class(boundary);
+        DEFINE_synctex_scanner_class(box_bdry);
+        DEFINE_synctex_scanner_class(ref);
+        DEFINE_synctex_scanner_class(proxy_hbox);
+        DEFINE_synctex_scanner_class(proxy_vbox);
+        DEFINE_synctex_scanner_class(proxy);
+        DEFINE_synctex_scanner_class(proxy_last);
+        DEFINE_synctex_scanner_class(handle);
+        /*  set up the lists of friends */
+        scanner->number_of_lists = 1024;
+        scanner->lists_of_friends = (synctex_node_r)_synctex_malloc(scanner->number_of_lists*sizeof(synctex_node_p));
+        if (NULL == scanner->lists_of_friends) {
+            synctex_scanner_free(scanner);
+            _synctex_error("malloc:2");
+            return NULL;
+        }
+        scanner->display_switcher = 100;
+        scanner->display_prompt = (char *)_synctex_display_prompt+strlen(_synctex_display_prompt)-1;
+    }
+    return scanner;
 }
-static float __synctex_node_visible_v(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_v(node,synctex_node_v(node));
+/*  Where the synctex scanner is created. */
+synctex_scanner_p synctex_scanner_new_with_output_file(const char * output, const char * build_directory, int parse) {
+    synctex_scanner_p scanner = synctex_scanner_new();
+    if (NULL == scanner) {
+        _synctex_error("malloc problem");
+        return NULL;
+    }
+    if ((scanner->reader = synctex_reader_init_with_output_file(scanner->reader, output, build_directory))) {
+        return parse? synctex_scanner_parse(scanner):scanner;
+    }
+    _synctex_error("No file?");
+    return NULL;
 }
-static float __synctex_node_visible_width(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_width(node));
+
+/*  The scanner destructor
+ */
+static void _synctex_scanner_free_edit_indexes(synctex_scanner_p scanner);
+static void _synctex_display_index_free(synctex_display_index_p index);
+int synctex_scanner_free(synctex_scanner_p scanner) {
+    int node_count = 0;
+    if (scanner) {
+        if (scanner->reader) {
+            _synctex_reader_close(scanner->reader);
+        }
+        /*  The nodes belong to the arena,
+         *  they are only visited when they are counted. */
+#if SYNCTEX_USE_NODE_COUNT>10
+        synctex_node_free(scanner->sheet);
+        synctex_node_free(scanner->form);
+#endif
+        /*  The inputs own their names. */
+        synctex_node_free(scanner->input);
+        _synctex_free(scanner->input_table.by_tag);
+        synctex_reader_free(scanner->reader);
+        _synctex_lazy_free(scanner->lazy);
+        _synctex_reload_free(scanner->reload);
+        _synctex_scanner_free_edit_indexes(scanner);
+        _synctex_display_index_free(scanner->display_index);
+        SYNCTEX_SCANNER_FREE_HANDLE(scanner);
+        synctex_iterator_free(scanner->iterator);
+        while (scanner->spare_arenas) {
+            synctex_arena_p arena = scanner->spare_arenas;
+            scanner->spare_arenas = arena->next;
+            _synctex_arena_free(arena);
+            _synctex_free(arena);
+        }
+        _synctex_arena_free(&scanner->arena);
+        free(scanner->output_fmt);
+        free(scanner->cache_directory);
+        free(scanner->lists_of_friends);
+#if SYNCTEX_USE_NODE_COUNT>0
+        node_count = scanner->node_count;
+#endif
+        free(scanner);
+    }
+    return node_count;
 }
-static float __synctex_node_visible_height(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_height(node));
+
+/*  Where the synctex scanner parses the contents of the file. */
+synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner) {
+    synctex_status_t status = 0;
+    if (!scanner || scanner->flags.has_parsed) {
+        return scanner;
+    }
+    scanner->flags.has_parsed=1;
+    scanner->pre_magnification = 1000;
+    scanner->pre_unit = 8192;
+    scanner->pre_x_offset = scanner->pre_y_offset = 578;
+    /*  initialize the offset with a fake improbable value,
+     *  If there is a post scriptum section, this value will be overridden by the real life value */
+    scanner->x_offset = scanner->y_offset = 6.027e23f;
+    scanner->reader->line_number = 1;
+#   if defined(SYNCTEX_USE_CACHE)
+    if (scanner->cache_directory && _synctex_scanner_load_cache(scanner) == SYNCTEX_STATUS_OK) {
+        _synctex_reader_close(scanner->reader);
+        return scanner;
+    }
+#   endif
+    if (scanner->parse_options & synctex_parse_option_threaded_inflate) {
+        _synctex_reader_start_inflater(scanner->reader);
+    }
+    
+    SYNCTEX_START = (char *)malloc(SYNCTEX_BUFFER_SIZE+1); /*  one more character for null termination */
+    if (NULL == SYNCTEX_START) {
+        _synctex_error("!  malloc error in synctex_scanner_parse.");
+    bailey:
+#ifdef SYNCTEX_DEBUG
+        return scanner;
+#else
+        synctex_scanner_free(scanner);
+        return NULL;
+#endif
+    }
+    synctex_scanner_set_display_switcher(scanner, 1000);
+    SYNCTEX_END = SYNCTEX_START+SYNCTEX_BUFFER_SIZE;
+    /*  SYNCTEX_END always points to a null terminating character.
+     *  Maybe there is another null terminating character between SYNCTEX_CUR and SYNCTEX_END-1.
+     *  At least, we are sure that SYNCTEX_CUR points to a string covering a valid part of the memory. */
+    *SYNCTEX_END = '\0';
+    SYNCTEX_CUR = SYNCTEX_END;
+#   if defined(SYNCTEX_USE_CHARINDEX)
+    scanner->reader->charindex_offset = -SYNCTEX_BUFFER_SIZE;
+#   endif
+    status = _synctex_scan_preamble(scanner);
+    if (status<SYNCTEX_STATUS_OK) {
+        _synctex_error("Bad preamble\n");
+        goto bailey;
+    }
+    status = _synctex_scan_content(scanner);
+    if (status<SYNCTEX_STATUS_OK) {
+        _synctex_error("Bad content\n");
+        goto bailey;
+    }
+    status = _synctex_scan_postamble(scanner);
+    if (status<SYNCTEX_STATUS_OK) {
+        _synctex_error("Bad postamble. Ignored\n");
+    }
+#if SYNCTEX_DEBUG>500
+    synctex_scanner_set_display_switcher(scanner, 100);
+    synctex_node_display(scanner->sheet);
+    synctex_node_display(scanner->form);
+#endif
+    synctex_scanner_set_display_switcher(scanner, 1000);
+    /*  Everything is finished, free the buffer, close the file */
+    free((void *)SYNCTEX_START);
+    SYNCTEX_START = SYNCTEX_CUR = SYNCTEX_END = NULL;
+    _synctex_reader_close(scanner->reader);
+    /*  Final tuning: set the default values for various parameters */
+    /*  1 pre_unit = (scanner->pre_unit)/65536 pt = (scanner->pre_unit)/65781.76 bp
+     * 1 pt = 65536 sp */
+    if (scanner->pre_unit<=0) {
+        scanner->pre_unit = 8192;
+    }
+    if (scanner->pre_magnification<=0) {
+        scanner->pre_magnification = 1000;
+    }
+    if (scanner->unit <= 0) {
+        /*  no post magnification */
+        scanner->unit = scanner->pre_unit / 65781.76;/*  65781.76 or 65536.0*/
+    } else {
+        /*  post magnification */
+        scanner->unit *= scanner->pre_unit / 65781.76;
+    }
+    scanner->unit *= scanner->pre_magnification / 1000.0;
+    if (scanner->x_offset > 6e23) {
+        /*  no post offset */
+        scanner->x_offset = scanner->pre_x_offset * (scanner->pre_unit / 65781.76);
+        scanner->y_offset = scanner->pre_y_offset * (scanner->pre_unit / 65781.76);
+    } else {
+        /*  post offset */
+        scanner->x_offset /= 65781.76f;
+        scanner->y_offset /= 65781.76f;
+    }
+#   if defined(SYNCTEX_USE_CACHE)
+    if (scanner->cache_directory && NULL == scanner->lazy) {
+        _synctex_scanner_write_cache(scanner);
+    }
+#   endif
+    return scanner;
+#undef SYNCTEX_FILE
 }
-static float __synctex_node_visible_depth(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_depth(node));
+
+/*  Parse options, set before the scanner parses.
+ */
+int synctex_scanner_set_parse_options(synctex_scanner_p scanner, int options) {
+    int old_options = 0;
+    if (scanner) {
+        old_options = scanner->parse_options;
+        scanner->parse_options = options;
+    }
+    return old_options;
 }
-static float __synctex_proxy_visible_h(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_h(node,synctex_node_h(node));
+
+/*  Cache directory, set before the scanner parses.
+ */
+int synctex_scanner_set_cache_directory(synctex_scanner_p scanner, const char * directory) {
+#   if defined(SYNCTEX_USE_CACHE)
+    if (scanner && !scanner->flags.has_parsed) {
+        free(scanner->cache_directory);
+        scanner->cache_directory = NULL;
+        if (directory) {
+            if (NULL == (scanner->cache_directory = (char *)_synctex_malloc(strlen(directory)+1))) {
+                _synctex_error("!  synctex_scanner_set_cache_directory: Memory problem.");
+                return -1;
+            }
+            strcpy(scanner->cache_directory,directory);
+        }
+        return 0;
+    }
+#   else
+    SYNCTEX_UNUSED(scanner)
+    SYNCTEX_UNUSED(directory)
+#   endif
+    return -1;
 }
-static float __synctex_proxy_visible_v(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_v(node,synctex_node_v(node));
+
+/*  Scanner accessors.
+ */
+int synctex_scanner_pre_x_offset(synctex_scanner_p scanner){
+    return scanner?scanner->pre_x_offset:0;
 }
-static float __synctex_proxy_visible_width(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    return __synctex_node_visible_width(target);
+int synctex_scanner_pre_y_offset(synctex_scanner_p scanner){
+    return scanner?scanner->pre_y_offset:0;
 }
-static float __synctex_proxy_visible_height(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    return __synctex_node_visible_height(target);
+int synctex_scanner_x_offset(synctex_scanner_p scanner){
+    return scanner?scanner->x_offset:0;
 }
-static float __synctex_proxy_visible_depth(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    return __synctex_node_visible_depth(target);
+int synctex_scanner_y_offset(synctex_scanner_p scanner){
+    return scanner?scanner->y_offset:0;
 }
-static float __synctex_kern_visible_h(synctex_noxy_p noxy) {
-    int h = _synctex_data_h(noxy);
-    int width = _synctex_data_width(noxy);
-    return SYNCTEX_VISIBLE_DISTANCE_h(noxy, width>0?h-width:h);
+float synctex_scanner_magnification(synctex_scanner_p scanner){
+    return scanner?scanner->unit:1;
 }
-static float __synctex_kern_visible_width(synctex_noxy_p noxy) {
-    int width = _synctex_data_width(noxy);
-    return SYNCTEX_VISIBLE_SIZE(noxy, width>0?width:-width);
+void synctex_scanner_display(synctex_scanner_p scanner) {
+    if (NULL == scanner) {
+        return;
+    }
+    printf("The scanner:\noutput:%s\noutput_fmt:%s\nversion:%i\n",scanner->reader->output,scanner->output_fmt,scanner->version);
+    printf("pre_unit:%i\nx_offset:%i\ny_offset:%i\n",scanner->pre_unit,scanner->pre_x_offset,scanner->pre_y_offset);
+    printf("count:%i\npost_magnification:%f\npost_x_offset:%f\npost_y_offset:%f\n",
+           scanner->count,scanner->unit,scanner->x_offset,scanner->y_offset);
+    printf("The input:\n");
+    synctex_node_display(scanner->input);
+    if (scanner->count<1000) {
+        printf("The sheets:\n");
+        synctex_node_display(scanner->sheet);
+        printf("The friends:\n");
+        if (scanner->lists_of_friends) {
+            int i = scanner->number_of_lists;
+            synctex_node_p node;
+            while(i--) {
+                printf("Friend index:%i\n",i);
+                node = (scanner->lists_of_friends)[i];
+                while(node) {
+                    printf("%s:%i,%i\n",
+                           synctex_node_isa(node),
+                           _synctex_data_tag(node),
+                           _synctex_data_line(node)
+                           );
+                    node = _synctex_tree_friend(node);
+                }
+            }
+        }
+    } else {
+        printf("SyncTeX Warning: Too many objects\n");
+    }
 }
-static float __synctex_rule_visible_h(synctex_noxy_p noxy) {
-    int h = _synctex_data_h(noxy);
-    int width = _synctex_data_width(noxy);
-    return SYNCTEX_VISIBLE_DISTANCE_h(noxy, width>0?h:h-width);
+/*  Public */
+const char * synctex_scanner_get_name(synctex_scanner_p scanner,int tag) {
+    synctex_node_p input = NULL;
+    if (NULL == scanner) {
+        return NULL;
+    }
+    if ((input = scanner->input)) {;
+        do {
+            if (tag == _synctex_data_tag(input)) {
+                return (_synctex_data_name(input));
+            }
+        } while((input = __synctex_tree_sibling(input)));
+    }
+    return NULL;
 }
-static float __synctex_rule_visible_width(synctex_noxy_p noxy) {
-    int width = _synctex_data_width(noxy);
-    return SYNCTEX_VISIBLE_SIZE(noxy, width>0?width:-width);
+const char * synctex_node_get_name(synctex_node_p node) {
+    if (node) {
+        return synctex_scanner_get_name(node->class_->scanner,_synctex_data_tag(node));
+    }
+    return NULL;
 }
-static float __synctex_rule_visible_v(synctex_noxy_p noxy) {
-    return __synctex_node_visible_v(noxy);
+
+static int _synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name);
+static int _synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name) {
+    synctex_node_p input = NULL;
+    if (NULL == scanner) {
+        return 0;
+    }
+    if ((input = scanner->input)) {
+        do {
+            if (_synctex_is_equivalent_file_name(name,(_synctex_data_name(input)))) {
+                return _synctex_data_tag(input);
+            }
+        } while((input = __synctex_tree_sibling(input)));
+    }
+    //  2011 version
+    name = _synctex_base_name(name);
+    if ((input = scanner->input)) {
+        do {
+            if (_synctex_is_equivalent_file_name(name,_synctex_base_name(_synctex_data_name(input)))) {
+                synctex_node_p other_input = input;
+                while((other_input = __synctex_tree_sibling(other_input))) {
+                    if (_synctex_is_equivalent_file_name(name,_synctex_base_name(_synctex_data_name(other_input)))
+                        && (strlen(_synctex_data_name(input))!=strlen(_synctex_data_name(other_input))
+                            || strncmp(_synctex_data_name(other_input),_synctex_data_name(input),strlen(_synctex_data_name(input))))) {
+                            // There is a second possible candidate
+                            return 0;
+                        }
+                }
+                return _synctex_data_tag(input);
+            }
+        } while((input = __synctex_tree_sibling(input)));
+    }
+    return 0;
 }
-static float __synctex_rule_visible_height(synctex_noxy_p noxy) {
-    return __synctex_node_visible_height(noxy);
+
+int synctex_scanner_get_tag(synctex_scanner_p scanner,const char * name) {
+    size_t char_index = strlen(name);
+    if ((scanner = synctex_scanner_parse(scanner)) && (0 < char_index)) {
+        /*  the name is not void */
+        char_index -= 1;
+        if (!SYNCTEX_IS_PATH_SEPARATOR(name[char_index])) {
+            /*  the last character of name is not a path separator */
+            int result = _synctex_scanner_get_tag(scanner,name);
+            if (result) {
+                return result;
+            } else {
+                /*  the given name was not the one known by TeX
+                 *  try a name relative to the enclosing directory of the scanner->output file */
+                const char * relative = name;
+                const char * ptr = scanner->reader->output;
+                while((strlen(relative) > 0) && (strlen(ptr) > 0) && (*relative == *ptr))
+                {
+                    relative += 1;
+                    ptr += 1;
+                }
+                /*  Find the last path separator before relative */
+                while(relative > name) {
+                    if (SYNCTEX_IS_PATH_SEPARATOR(*(relative-1))) {
+                        break;
+                    }
+                    relative -= 1;
+                }
+                if ((relative > name) && (result = _synctex_scanner_get_tag(scanner,relative))) {
+                    return result;
+                }
+                if (SYNCTEX_IS_PATH_SEPARATOR(name[0])) {
+                    /*  No tag found for the given absolute name,
+                     *  Try each relative path starting from the shortest one */
+                    while(0<char_index) {
+                        char_index -= 1;
+                        if (SYNCTEX_IS_PATH_SEPARATOR(name[char_index])
+                            && (result = _synctex_scanner_get_tag(scanner,name+char_index+1))) {
+                            return result;
+                        }
+                    }
+                }
+            }
+            return result;
+        }
+    }
+    return 0;
 }
-static float __synctex_rule_visible_depth(synctex_noxy_p noxy) {
-    return __synctex_node_visible_depth(noxy);
+synctex_node_p synctex_scanner_input(synctex_scanner_p scanner) {
+    return scanner?scanner->input:NULL;
 }
-
-/**
- *  The horizontal location of node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
- */
-float synctex_node_visible_h(synctex_node_p node){
-    return node? node->class_->vispector->h(node): 0;
+/*  Tags are small positive integers, one per input, the table is a plain array indexed by tag.
+ *  It is rebuilt whenever the input list changed, which happens while parsing the preamble
+ *  and for each input record in the content, so that lookups while parsing stay O(1). */
+#   if !defined(SYNCTEX_INPUT_TABLE_MAX_TAG)
+#       define SYNCTEX_INPUT_TABLE_MAX_TAG (1<<20)
+#   endif
+static synctex_bool_t _synctex_scanner_update_input_table(synctex_scanner_p scanner) {
+    synctex_input_table_s * table = &scanner->input_table;
+    synctex_node_p input;
+    int max_tag = 0;
+    if (table->by_tag && !scanner->flags.new_inputs) {
+        return synctex_YES;
+    }
+    table->last = NULL;
+    for (input = scanner->input;input;input = __synctex_tree_sibling(input)) {
+        int tag = _synctex_data_tag(input);
+        if (tag<0 || tag>SYNCTEX_INPUT_TABLE_MAX_TAG) {
+            /*  Unexpected tags, use the linear lookup */
+            return synctex_NO;
+        }
+        if (tag>max_tag) {
+            max_tag = tag;
+        }
+        table->last = input;
+    }
+    if (max_tag>=table->size || !table->by_tag) {
+        int size = 2*max_tag+16;
+        synctex_node_p * by_tag = (synctex_node_p *)realloc(table->by_tag,size*sizeof(synctex_node_p));
+        if (!by_tag) {
+            return synctex_NO;
+        }
+        table->by_tag = by_tag;
+        table->size = size;
+    }
+    memset(table->by_tag,0,table->size*sizeof(synctex_node_p));
+    for (input = scanner->input;input;input = __synctex_tree_sibling(input)) {
+        int tag = _synctex_data_tag(input);
+        if (!table->by_tag[tag]) {
+            table->by_tag[tag] = input;
+        }
+    }
+    scanner->flags.new_inputs = 0;
+    return synctex_YES;
 }
-/**
- *  The vertical location of node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
- */
-float synctex_node_visible_v(synctex_node_p node){
-    return node? node->class_->vispector->v(node): 0;
+synctex_node_p synctex_scanner_input_with_tag(synctex_scanner_p scanner, int tag) {
+    synctex_node_p input = scanner?scanner->input:NULL;
+    if (input && _synctex_scanner_update_input_table(scanner)) {
+        synctex_input_table_s * table = &scanner->input_table;
+        if (tag>=0 && tag<table->size && table->by_tag[tag]) {
+            return table->by_tag[tag];
+        }
+        return table->last;
+    }
+    while (_synctex_data_tag(input)!=tag) {
+        if ((input = __synctex_tree_sibling(input))) {
+            continue;
+        }
+        break;
+    }
+    return input;
 }
-/**
- *  The width of node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
- */
-float synctex_node_visible_width(synctex_node_p node){
-    return node? node->class_->vispector->width(node): 0;
+const char * synctex_scanner_get_output_fmt(synctex_scanner_p scanner) {
+    return NULL != scanner && scanner->output_fmt?scanner->output_fmt:"";
 }
-/**
- *  The height of node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
- */
-float synctex_node_visible_height(synctex_node_p node){
-    return node? node->class_->vispector->height(node): 0;
+const char * synctex_scanner_get_output(synctex_scanner_p scanner) {
+    return NULL != scanner && scanner->reader->output?scanner->reader->output:"";
 }
-/**
- *  The depth of node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
- */
-float synctex_node_visible_depth(synctex_node_p node){
-    return node? node->class_->vispector->depth(node): 0;
+const char * synctex_scanner_get_synctex(synctex_scanner_p scanner) {
+    return NULL != scanner && scanner->reader->synctex?scanner->reader->synctex:"";
 }
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Public node attributes
+#   endif
 
-/**
- *  The V variant of geometrical information.
- *  - parameter node: a node.
- *  - returns: an integer.
- *  - author: JL
- */
-#define SYNCTEX_DEFINE_V(WHAT)\
-SYNCTEX_INLINE static int _synctex_node_##WHAT##_V(synctex_node_p node) { \
-    synctex_node_p target = _synctex_tree_target(node); \
+#   define SYNCTEX_DEFINE_NODE_HVWHD(WHAT) \
+int synctex_node_##WHAT(synctex_node_p node) { \
+    return (node && node->class_->inspector->WHAT)? \
+        node->class_->inspector->WHAT(node): 0; \
+}
+#   define SYNCTEX_DEFINE_PROXY_HV(WHAT) \
+static int _synctex_proxy_##WHAT(synctex_proxy_p proxy) { \
+    synctex_node_p target = _synctex_tree_target(proxy); \
     if (target) { \
-        return _synctex_data_##WHAT(node)+_synctex_node_##WHAT##_V(target); \
-    } else if (_synctex_data_has_##WHAT##_V(node)) { \
-        return _synctex_data_##WHAT##_V(node); \
+        return _synctex_data_##WHAT(proxy)+synctex_node_##WHAT(target); \
     } else { \
-        return _synctex_data_##WHAT(node); \
+        return proxy? _synctex_data_##WHAT(proxy): 0; \
     } \
 }
-SYNCTEX_DEFINE_V(h)
-SYNCTEX_DEFINE_V(v)
-SYNCTEX_DEFINE_V(width)
-SYNCTEX_DEFINE_V(height)
-SYNCTEX_DEFINE_V(depth)
-
-SYNCTEX_INLINE static synctex_point_s _synctex_data_point(synctex_node_p node) {
-    return (synctex_point_s){synctex_node_h(node),synctex_node_v(node)};
-}
-SYNCTEX_INLINE static synctex_point_s _synctex_data_point_V(synctex_node_p node) {
-    return (synctex_point_s){_synctex_node_h_V(node),_synctex_node_v_V(node)};
-}
-SYNCTEX_INLINE static synctex_point_s _synctex_data_set_point(synctex_node_p node, synctex_point_s point) {
-    synctex_point_s old = _synctex_data_point(node);
-    _synctex_data_set_h(node,point.h);
-    _synctex_data_set_v(node,point.v);
-    return old;
-}
-SYNCTEX_INLINE static synctex_box_s _synctex_data_box(synctex_node_p node) {
-    synctex_box_s box = {{0,0},{0,0}};
-    int n;
-    n = synctex_node_width(node);
-    if (n<0) {
-        box.max.h = synctex_node_h(node);
-        box.min.h = box.max.h + n;
-    } else {
-        box.min.h = synctex_node_h(node);
-        box.max.h = box.min.h + n;
-    }
-    n = synctex_node_v(node);
-    box.min.v = n - synctex_node_height(node);
-    box.max.v = n + synctex_node_depth(node);
-    return box;
-}
-SYNCTEX_INLINE static synctex_box_s _synctex_data_xob(synctex_node_p node) {
-    synctex_box_s box = {{0,0},{0,0}};
-    int n;
-    n = synctex_node_width(node);
-    if (n>0) {
-        box.max.h = synctex_node_h(node);
-        box.min.h = box.max.h - n;
-    } else {
-        box.min.h = synctex_node_h(node);
-        box.max.h = box.min.h - n;
-    }
-    n = synctex_node_v(node);
-    box.min.v = n - synctex_node_height(node);
-    box.max.v = n + synctex_node_depth(node);
-    return box;
-}
-SYNCTEX_INLINE static synctex_box_s _synctex_data_box_V(synctex_node_p node) {
-    synctex_box_s box = {{0,0},{0,0}};
-    int n;
-    n = _synctex_node_width_V(node);
-    if (n<0) {
-        box.max.h = _synctex_node_h_V(node);
-        box.min.h = box.max.h + n;
-    } else {
-        box.min.h = _synctex_node_h_V(node);
-        box.max.h = box.min.h + n;
-    }
-    n = _synctex_node_v_V(node);
-    box.min.v = n - _synctex_node_height_V(node);
-    box.max.v = n + _synctex_node_depth_V(node);
-    return box;
+#define SYNCTEX_DEFINE_PROXY_TLCWVD(WHAT) \
+static int _synctex_proxy_##WHAT(synctex_proxy_p proxy) { \
+    synctex_node_p target = _synctex_tree_target(proxy); \
+    return target? synctex_node_##WHAT(target): 0; \
 }
 
 /**
- *  The higher box node in the parent hierarchy which
- *  mean line number is the one of node ±1.
- *  This enclosing box is computed as follows
- *  1) get the first hbox in the parent linked list
- *  starting at node.
- *  If there is none, simply return the parent of node.
- *  2) compute the mean line number
- *  3) scans up the tree for the higher hbox with
- *  the same mean line number, ±1 eventually
-*  - parameter node: a node.
- *  - returns: a (proxy to a) box node.
+ *  The horizontal location of the node.
+ *  Idem for v, width, height and depth.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
+ *  - requires: every proxy node has a target.
+ *  - note: recursive call if the parameter has a proxy.
  *  - author: JL
  */
-static synctex_node_p _synctex_node_box_visible(synctex_node_p node) {
-    if ((node = _synctex_node_or_handle_target(node))) {
-        int mean = 0;
-        int bound = 1500000/(node->class_->scanner->pre_magnification/1000.0);
-        synctex_node_p parent = NULL;
-        /*  get the first enclosing parent
-         *  then get the highest enclosing parent with the same mean line ±1 */
-        node = _synctex_node_or_handle_target(node);
-        if (!_synctex_node_is_box(node)) {
-            if ((parent = _synctex_tree_parent(node))) {
-                node = parent;
-            } else if ((node = _synctex_tree_target(node))) {
-                if (!_synctex_node_is_box(node)) {
-                    if ((parent = _synctex_tree_parent(node))) {
-                        node = parent;
-                    } else {
-                        return NULL;
-                    }
-                }
-            }
-        }
-        parent = node;
-        mean = synctex_node_mean_line(node);
-        while ((parent = _synctex_tree_parent(parent))) {
-            if (_synctex_node_is_hbox(parent)) {
-                if (_synctex_abs(mean-synctex_node_mean_line(parent))>1) {
-                    return node;
-                } else if (synctex_node_width(parent)>bound) {
-                    return parent;
-                } else if (synctex_node_height(parent)+synctex_node_depth(parent)>bound) {
-                    return parent;
-                }
-                node = parent;
-            }
-        }
-    }
-    return node;
+SYNCTEX_DEFINE_NODE_HVWHD(h)
+SYNCTEX_DEFINE_NODE_HVWHD(v)
+SYNCTEX_DEFINE_NODE_HVWHD(width)
+SYNCTEX_DEFINE_NODE_HVWHD(height)
+SYNCTEX_DEFINE_NODE_HVWHD(depth)
+SYNCTEX_DEFINE_PROXY_TLCWVD(tag)
+SYNCTEX_DEFINE_PROXY_TLCWVD(line)
+SYNCTEX_DEFINE_PROXY_TLCWVD(column)
+SYNCTEX_DEFINE_PROXY_HV(h)
+SYNCTEX_DEFINE_PROXY_HV(v)
+SYNCTEX_DEFINE_PROXY_TLCWVD(width)
+SYNCTEX_DEFINE_PROXY_TLCWVD(height)
+SYNCTEX_DEFINE_PROXY_TLCWVD(depth)
+
+/**
+ *  Whether the argument is a box,
+ *  either vertical or horizontal,
+ *  either void or not,
+ *  or a proxy to such a box.
+ *  - parameter NODE: of type synctex_node_p
+ *  - returns: yorn
+ */
+
+SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_box(synctex_node_p node) {
+    return node &&
+    (node->class_->type == synctex_node_type_hbox
+     || node->class_->type == synctex_node_type_void_hbox
+     || node->class_->type == synctex_node_type_vbox
+     || node->class_->type == synctex_node_type_void_vbox
+     || _synctex_node_is_box(_synctex_tree_target(node)));
 }
+
 /**
- *  The horizontal location of the first box enclosing node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
+ *  Whether the argument is a handle.
+ *  Handles are similar to proxies because they have a target.
+ *  They are used for query results.
+ *  - parameter NODE: of type synctex_node_p
+ *  - returns: yorn
  */
-float synctex_node_box_visible_h(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_h(node,_synctex_node_h_V(_synctex_node_box_visible(node)));
+
+SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_handle(synctex_node_p node) {
+    return node &&
+    (node->class_->type == synctex_node_type_handle);
 }
+
 /**
- *  The vertical location of the first box enclosing node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
+ *  Resolves handle indirection.
+ *  - parameter node: of type synctex_node_p
+ *  - returns: node if it is not a handle,
+ *  its target otherwise.
  */
-float synctex_node_box_visible_v(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_DISTANCE_v(node,_synctex_node_v_V(_synctex_node_box_visible(node)));
+
+SYNCTEX_INLINE static synctex_node_p _synctex_node_or_handle_target(synctex_node_p node) {
+    return _synctex_node_is_handle(node)?
+    _synctex_tree_target(node):node;
 }
+
 /**
- *  The width of the first box enclosing node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
- *  - author: JL
+ *  Whether the argument is an hbox.
+ *  - parameter NODE: of type synctex_node_p
+ *  - returns: yorn
  */
-float synctex_node_box_visible_width(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_width_V(_synctex_node_box_visible(node)));
+
+SYNCTEX_INLINE static synctex_bool_t _synctex_node_is_hbox(synctex_node_p node) {
+    return node &&
+    (node->class_->type == synctex_node_type_hbox
+     || node->class_->type == synctex_node_type_void_hbox
+     || _synctex_node_is_hbox(_synctex_tree_target(node)));
 }
+
 /**
- *  The height of the first box enclosing node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
+ *  The horizontal location of the first box enclosing node.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
  *  - author: JL
  */
-float synctex_node_box_visible_height(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_height_V(_synctex_node_box_visible(node)));
+int synctex_node_box_h(synctex_node_p node) {
+    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
+        return synctex_node_h(node);
+    }
+    return 0;
 }
 /**
- *  The depth of the first box enclosing node, in page coordinates.
- *  - parameter node: a node.
- *  - returns: a float.
+ *  The vertical location of the first box enclosing node.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
  *  - author: JL
  */
-float synctex_node_box_visible_depth(synctex_node_p node) {
-    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_depth_V(_synctex_node_box_visible(node)));
+int synctex_node_box_v(synctex_node_p node) {
+    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
+        return synctex_node_v(node);
+    }
+    return 0;
 }
-#	ifdef SYNCTEX_NOTHING
-#       pragma mark -
-#       pragma mark Other public node attributes
-#   endif
-
 /**
- *  The page number of the sheet enclosing node.
- *  - parameter node: a node.
- *  - returns: the page number or -1 if node does not belong to a sheet tree.
- *  - note: a proxy target does not belong to a sheet
- *      but a form, its page number is always -1.
- *  - note: a handles does not belong to a sheet not a form.
- *      its page number is -1.
+ *  The width of the first box enclosing node.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
  *  - author: JL
  */
-int synctex_node_page(synctex_node_p node){
-    synctex_node_p parent = NULL;
-    while((parent = _synctex_tree_parent(node))) {
-        node = parent;
-    }
-    if (synctex_node_type(node) == synctex_node_type_sheet) {
-        return _synctex_data_page(node);
+int synctex_node_box_width(synctex_node_p node) {
+    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
+        return synctex_node_width(node);
     }
-    return -1;
+    return 0;
 }
 /**
- *  The page number of the target.
+ *  The height of the first box enclosing node.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
  *  - author: JL
  */
-SYNCTEX_INLINE static int _synctex_node_target_page(synctex_node_p node){
-    return synctex_node_page(_synctex_tree_target(node));
-}
-
-#if defined (SYNCTEX_USE_CHARINDEX)
-synctex_charindex_t synctex_node_charindex(synctex_node_p node) {
-    synctex_node_p target = _synctex_tree_target(node);
-    return target? SYNCTEX_CHARINDEX(target):(node?SYNCTEX_CHARINDEX(node):0);
+int synctex_node_box_height(synctex_node_p node) {
+    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
+        return synctex_node_height(node);
+    }
+    return 0;
 }
-#endif
-
 /**
- *  The tag of the node.
- *  - parameter node: a node.
- *  - returns: the tag or -1 if node is NULL.
+ *  The depth of the first box enclosing node.
+ *  - parameter node: a node with geometrical information.
+ *  - returns: an integer.
  *  - author: JL
  */
-int synctex_node_tag(synctex_node_p node) {
-    return node? node->class_->tlcpector->tag(node): -1;
+int synctex_node_box_depth(synctex_node_p node) {
+    if (_synctex_node_is_box(node) || (node = _synctex_tree_parent(node))) {
+        return synctex_node_depth(node);
+    }
+    return 0;
 }
 /**
- *  The line of the node.
- *  - parameter node: a node.
- *  - returns: the line or -1 if node is NULL.
+ *  The horizontal location of an hbox, corrected with contents.
+ *  - parameter node: an hbox node.
+ *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
+ *  - note: recursive call when node is an hbox proxy.
  *  - author: JL
  */
-int synctex_node_line(synctex_node_p node) {
-    return node? node->class_->tlcpector->line(node): -1;
+int synctex_node_hbox_h(synctex_node_p node) {
+    switch(synctex_node_type(node)) {
+        case synctex_node_type_hbox:
+            return _synctex_data_h_V(node);
+        case synctex_node_type_proxy_hbox:
+            return _synctex_data_h(node)+synctex_node_hbox_h(_synctex_tree_target(node));
+        default:
+            return 0;
+    }
 }
 /**
- *  The column of the node.
- *  - parameter node: a node.
- *  - returns: the column or -1 if node is NULL.
+ *  The vertical location of an hbox, corrected with contents.
+ *  - parameter node: an hbox node.
+ *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
+ *  - note: recursive call when node is an hbox proxy.
  *  - author: JL
  */
-int synctex_node_column(synctex_node_p node) {
-    return node? node->class_->tlcpector->column(node): -1;
+int synctex_node_hbox_v(synctex_node_p node) {
+    switch(synctex_node_type(node)) {
+        case synctex_node_type_hbox:
+            return _synctex_data_v_V(node);
+        case synctex_node_type_proxy_hbox:
+            return _synctex_data_v(node)+synctex_node_hbox_v(_synctex_tree_target(node));
+        default:
+            return 0;
+    }
 }
 /**
- *  The mean line number of the node.
- *  - parameter node: a node.
- *  - returns: the mean line or -1 if node is NULL.
+ *  The width of an hbox, corrected with contents.
+ *  - parameter node: an hbox node, 0 if node is not an hbox or an hbox proxy.
+ *  - returns: an integer.
  *  - author: JL
  */
-int synctex_node_mean_line(synctex_node_p node) {
-    synctex_node_p other = _synctex_tree_target(node);
-    if (other) {
-        node = other;
-    }
-    if (_synctex_data_has_mean_line(node)) {
-        return _synctex_data_mean_line(node);
-    }
-    if ((other = synctex_node_parent(node))) {
-        if (_synctex_data_has_mean_line(other)) {
-            return _synctex_data_mean_line(other);
-        }
+int synctex_node_hbox_width(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    if (target) {
+        node = target;
     }
-    return synctex_node_line(node);
+    return synctex_node_type(node) == synctex_node_type_hbox?
+    _synctex_data_width_V(node): 0;
 }
 /**
- *  The weight of the node.
- *  - parameter node: a node.
- *  - returns: the weight or -1 if node is NULL.
+ *  The height of an hbox, corrected with contents.
+ *  - parameter node: an hbox node.
+ *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
  *  - author: JL
  */
-int synctex_node_weight(synctex_node_p node) {
+int synctex_node_hbox_height(synctex_node_p node) {
     synctex_node_p target = _synctex_tree_target(node);
     if (target) {
         node = target;
     }
-    return node?(synctex_node_type(node)==synctex_node_type_hbox?_synctex_data_weight(node):0):-1;
+    return synctex_node_type(node) == synctex_node_type_hbox?
+    _synctex_data_height_V(node): 0;
 }
 /**
- *  The number of children of the node.
- *  - parameter node: a node.
- *  - returns: the count or -1 if node is NULL.
+ *  The depth of an hbox, corrected with contents.
+ *  - parameter node: an hbox node.
+ *  - returns: an integer, 0 if node is not an hbox or an hbox proxy.
+ *  - note: recursive call when node is an hbox proxy.
  *  - author: JL
  */
-int synctex_node_child_count(synctex_node_p node) {
+int synctex_node_hbox_depth(synctex_node_p node) {
     synctex_node_p target = _synctex_tree_target(node);
     if (target) {
         node = target;
     }
-    return node?(synctex_node_type(node)==synctex_node_type_hbox?_synctex_data_weight(node):0):-1;
+    return synctex_node_type(node) == synctex_node_type_hbox?
+    _synctex_data_depth_V(node): 0;
 }
 #	ifdef SYNCTEX_NOTHING
 #       pragma mark -
-#       pragma mark Sheet & Form
+#       pragma mark Public node visible attributes
 #   endif
 
+#define SYNCTEX_VISIBLE_SIZE(node,s) \
+(s)*node->class_->scanner->unit
+#define SYNCTEX_VISIBLE_DISTANCE_h(node,d) \
+((d)*node->class_->scanner->unit+node->class_->scanner->x_offset)
+#define SYNCTEX_VISIBLE_DISTANCE_v(node,d) \
+((d)*node->class_->scanner->unit+node->class_->scanner->y_offset)
+static float __synctex_node_visible_h(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_h(node,synctex_node_h(node));
+}
+static float __synctex_node_visible_v(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_v(node,synctex_node_v(node));
+}
+static float __synctex_node_visible_width(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_width(node));
+}
+static float __synctex_node_visible_height(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_height(node));
+}
+static float __synctex_node_visible_depth(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,synctex_node_depth(node));
+}
+static float __synctex_proxy_visible_h(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_h(node,synctex_node_h(node));
+}
+static float __synctex_proxy_visible_v(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_v(node,synctex_node_v(node));
+}
+static float __synctex_proxy_visible_width(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    return __synctex_node_visible_width(target);
+}
+static float __synctex_proxy_visible_height(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    return __synctex_node_visible_height(target);
+}
+static float __synctex_proxy_visible_depth(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    return __synctex_node_visible_depth(target);
+}
+static float __synctex_kern_visible_h(synctex_noxy_p noxy) {
+    int h = _synctex_data_h(noxy);
+    int width = _synctex_data_width(noxy);
+    return SYNCTEX_VISIBLE_DISTANCE_h(noxy, width>0?h-width:h);
+}
+static float __synctex_kern_visible_width(synctex_noxy_p noxy) {
+    int width = _synctex_data_width(noxy);
+    return SYNCTEX_VISIBLE_SIZE(noxy, width>0?width:-width);
+}
+static float __synctex_rule_visible_h(synctex_noxy_p noxy) {
+    int h = _synctex_data_h(noxy);
+    int width = _synctex_data_width(noxy);
+    return SYNCTEX_VISIBLE_DISTANCE_h(noxy, width>0?h:h-width);
+}
+static float __synctex_rule_visible_width(synctex_noxy_p noxy) {
+    int width = _synctex_data_width(noxy);
+    return SYNCTEX_VISIBLE_SIZE(noxy, width>0?width:-width);
+}
+static float __synctex_rule_visible_v(synctex_noxy_p noxy) {
+    return __synctex_node_visible_v(noxy);
+}
+static float __synctex_rule_visible_height(synctex_noxy_p noxy) {
+    return __synctex_node_visible_height(noxy);
+}
+static float __synctex_rule_visible_depth(synctex_noxy_p noxy) {
+    return __synctex_node_visible_depth(noxy);
+}
+
 /**
- *  The sheet of the scanner with a given page number.
- *  - parameter scanner: a scanner.
- *  - parameter page: a 1 based page number.
- *      If page == 0, returns the first sheet.
- *  - returns: a sheet or NULL.
+ *  The horizontal location of node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
  *  - author: JL
  */
-synctex_node_p synctex_sheet(synctex_scanner_p scanner,int page) {
-    if (scanner) {
-        synctex_node_p sheet = scanner->sheet;
-        while(sheet) {
-            if (page == _synctex_data_page(sheet)) {
-                return sheet;
-            }
-            sheet = __synctex_tree_sibling(sheet);
-        }
-        if (page == 0) {
-            return scanner->sheet;
-        }
-    }
-    return NULL;
+float synctex_node_visible_h(synctex_node_p node){
+    return node? node->class_->vispector->h(node): 0;
 }
 /**
- *  The form of the scanner with a given tag.
- *  - parameter scanner: a scanner.
- *  - parameter tag: an integer identifier.
- *      If tag == 0, returns the first form.
- *  - returns: a form.
+ *  The vertical location of node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
  *  - author: JL
  */
-synctex_node_p synctex_form(synctex_scanner_p scanner,int tag) {
-    if (scanner) {
-        synctex_node_p form = scanner->form;
-        while(form) {
-            if (tag == _synctex_data_tag(form)) {
-                return form;
-            }
-            form = __synctex_tree_sibling(form);
-        }
-        if (tag == 0) {
-            return scanner->form;
-        }
-    }
-    return NULL;
+float synctex_node_visible_v(synctex_node_p node){
+    return node? node->class_->vispector->v(node): 0;
 }
-
 /**
- *  The content of the sheet with given page number.
- *  - parameter scanner: a scanner.
- *  - parameter page: a 1 based page number.
- *  - returns: a (vertical) box node.
+ *  The width of node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
  *  - author: JL
  */
-synctex_node_p synctex_sheet_content(synctex_scanner_p scanner,int page) {
-    if (scanner) {
-        return _synctex_tree_child(synctex_sheet(scanner,page));
-    }
-    return NULL;
+float synctex_node_visible_width(synctex_node_p node){
+    return node? node->class_->vispector->width(node): 0;
 }
-
 /**
- *  The content of the sheet with given page number.
- *  - parameter scanner: a scanner.
- *  - parameter tag: an integer identifier.
- *  - returns: a box node.
+ *  The height of node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
  *  - author: JL
  */
-synctex_node_p synctex_form_content(synctex_scanner_p scanner,int tag) {
-    if (scanner) {
-        return _synctex_tree_child(synctex_form(scanner,tag));
-    }
-    return NULL;
-}
-
-SYNCTEX_INLINE static synctex_node_p _synctex_scanner_friend(synctex_scanner_p scanner,int i) {
-    if (i>=0) {
-        i = _synctex_abs(i)%(scanner->number_of_lists);
-        return (scanner->lists_of_friends)[i];
-    }
-    return NULL;
-}
-SYNCTEX_INLINE static synctex_bool_t _synctex_nodes_are_friend(synctex_node_p left, synctex_node_p right) {
-    return synctex_node_tag(left) == synctex_node_tag(right) && synctex_node_line(left) == synctex_node_line(right);
+float synctex_node_visible_height(synctex_node_p node){
+    return node? node->class_->vispector->height(node): 0;
 }
 /**
- *  The sibling argument is a parent/child list of nodes of the same page.
+ *  The depth of node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
  */
-typedef struct {
-    int count;
-    synctex_node_p node;
-} synctex_counted_node_s;
-
-SYNCTEX_INLINE static synctex_counted_node_s _synctex_vertically_sorted_v2(synctex_node_p sibling) {
-    /* Clean the weights of the parents */
-    synctex_counted_node_s result = {0, NULL};
-    synctex_node_p h = NULL;
-    synctex_node_p next_h = NULL;
-    synctex_node_p parent = NULL;
-    int weight = 0;
-    synctex_node_p N = NULL;
-    h = sibling;
-    do {
-        N = _synctex_tree_target(h);
-        parent = _synctex_tree_parent(N);
-        _synctex_data_set_weight(parent, 0);
-    } while((h = _synctex_tree_child(h)));
-    /* Compute the weights of the nodes */
-    h = sibling;
-    do {
-        N = _synctex_tree_target(h);
-        parent = _synctex_tree_parent(N);
-        weight = _synctex_data_weight(parent);
-        if (weight==0) {
-            N = _synctex_tree_child(parent);
-            do {
-                if (_synctex_nodes_are_friend(N,sibling)) {
-                    ++ weight;
-                }
-            } while ((N = __synctex_tree_sibling(N)));
-            _synctex_data_set_weight(h,weight);
-            _synctex_data_set_weight(parent,weight);
-        }
-    } while((h = _synctex_tree_child(h)));
-    /* Order handle nodes according to the weight */
-    h = _synctex_tree_reset_child(sibling);
-    result.node = sibling;
-    weight = 0;
-    while((h)) {
-        N = result.node;
-        if (_synctex_data_weight(h)>_synctex_data_weight(N)) {
-            next_h = _synctex_tree_set_child(h,N);
-            result.node = h;
-        } else if (_synctex_data_weight(h) == 0) {
-            ++ weight;
-            next_h = _synctex_tree_reset_child(h);
-            synctex_node_free(h);
-        } else {
-            synctex_node_p next_N = NULL;
-            while((next_N = _synctex_tree_child(N))) {
-                N = next_N;
-                if (_synctex_data_weight(h)<_synctex_data_weight(next_N)) {
-                    continue;
-                }
-                break;
-            }
-            next_h = _synctex_tree_set_child(h,_synctex_tree_set_child(N,h));
-        }
-        h = next_h;
-    };
-    h = result.node;
-    weight = 0;
-    do {
-        ++weight;
-    } while((h = _synctex_tree_child(h)));
-    result.count = 1;
-    h = result.node;
-    while((next_h = _synctex_tree_child(h))) {
-        if (_synctex_data_weight(next_h)==0) {
-            _synctex_tree_reset_child(h);
-            weight = 1;
-            h = next_h;
-            while((h = _synctex_tree_child(h))) {
-                ++weight;
-            }
-            synctex_node_free(next_h);
-            break;
-        }
-        ++result.count;
-        h = next_h;
-    }
-    return result;
+float synctex_node_visible_depth(synctex_node_p node){
+    return node? node->class_->vispector->depth(node): 0;
 }
 
-SYNCTEX_INLINE static synctex_bool_t _synctex_point_in_box_v2(synctex_point_p hitP, synctex_node_p node);
-
-/*  This struct records distances, the left one is non negative and the right one is non positive.
- *  When comparing the locations of 2 different graphical objects on the page, we will have to also record the
- *  horizontal distance as signed to keep track of the typesetting order.*/
-
-typedef struct {
-    synctex_node_p node;
-    int distance;
-} synctex_nd_s;
-
-#define SYNCTEX_ND_0 (synctex_nd_s){NULL,INT_MAX}
-
-typedef synctex_nd_s * synctex_nd_p;
-
-typedef struct {
-    synctex_nd_s l;
-    synctex_nd_s r;
-} synctex_nd_lr_s;
-
-/*  The best container is the deeper box that contains the hit point (H,V).
- *  _synctex_eq_deepest_container_v2 starts with node whereas
- *  _synctex_box_child_deepest starts with node's children, if any
- *  if node is not a box, or a void box, NULL is returned.
- *  We traverse the node tree in a deep first manner and stop as soon as a result is found. */
-static synctex_node_p _synctex_eq_deepest_container_v2(synctex_point_p hitP, synctex_node_p node);
-
-SYNCTEX_INLINE static synctex_nd_lr_s _synctex_eq_get_closest_children_in_box_v2(synctex_point_p hitP, synctex_node_p node);
-
-/*  Closest child, recursive.  */
-static synctex_nd_s __synctex_closest_deep_child_v2(synctex_point_p hitP, synctex_node_p node);
-
-/*  The smallest container between two has the smallest width or height.
- *  This comparison is used when there are 2 overlapping boxes that contain the hit point.
- *  For ConTeXt, the problem appears at each page.
- *  The chosen box is the one with the smallest height, then the smallest width. */
-SYNCTEX_INLINE static synctex_node_p _synctex_smallest_container_v2(synctex_node_p node, synctex_node_p other_node);
-
-/*  Returns the distance between the hit point hit point=(H,V) and the given node. */
-
-static int _synctex_point_node_distance_v2(synctex_point_p hitP, synctex_node_p node);
-
-/*  The closest container is the box that is the one closest to the given point.
- *  The "visible" version takes into account the visible dimensions instead of the real ones given by TeX. */
-static synctex_nd_s _synctex_eq_closest_child_v2(synctex_point_p hitP, synctex_node_p node);
-
-#	ifdef SYNCTEX_NOTHING
-#       pragma mark -
-#       pragma mark Queries
-#   endif
-
 /**
- *  iterator for a deep first tree traversal.
+ *  The V variant of geometrical information.
+ *  - parameter node: a node.
+ *  - returns: an integer.
+ *  - author: JL
  */
-struct synctex_iterator_t {
-    synctex_node_p seed;
-    synctex_node_p top;
-    synctex_node_p next;
-    int count0;
-    int count;
-};
-
-SYNCTEX_INLINE static synctex_iterator_p _synctex_iterator_new(synctex_node_p result, int count) {
-    synctex_iterator_p iterator;
-    if ((iterator = _synctex_malloc(sizeof(synctex_iterator_s)))) {
-        iterator->seed = iterator->top = iterator->next = result;
-        iterator->count0 = iterator->count = count;
-    }
-    return iterator;
-};
+#define SYNCTEX_DEFINE_V(WHAT)\
+SYNCTEX_INLINE static int _synctex_node_##WHAT##_V(synctex_node_p node) { \
+    synctex_node_p target = _synctex_tree_target(node); \
+    if (target) { \
+        return _synctex_data_##WHAT(node)+_synctex_node_##WHAT##_V(target); \
+    } else if (_synctex_data_has_##WHAT##_V(node)) { \
+        return _synctex_data_##WHAT##_V(node); \
+    } else { \
+        return _synctex_data_##WHAT(node); \
+    } \
+}
+SYNCTEX_DEFINE_V(h)
+SYNCTEX_DEFINE_V(v)
+SYNCTEX_DEFINE_V(width)
+SYNCTEX_DEFINE_V(height)
+SYNCTEX_DEFINE_V(depth)
 
-void synctex_iterator_free(synctex_iterator_p iterator) {
-    if (iterator) {
-        synctex_node_free(iterator->seed);
-        _synctex_free(iterator);
-    }
+SYNCTEX_INLINE static synctex_point_s _synctex_data_point(synctex_node_p node) {
+    return (synctex_point_s){synctex_node_h(node),synctex_node_v(node)};
 }
-synctex_bool_t synctex_iterator_has_next(synctex_iterator_p iterator) {
-    return iterator?iterator->count>0:0;
+SYNCTEX_INLINE static synctex_point_s _synctex_data_point_V(synctex_node_p node) {
+    return (synctex_point_s){_synctex_node_h_V(node),_synctex_node_v_V(node)};
 }
-int synctex_iterator_count(synctex_iterator_p iterator) {
-    return iterator? iterator->count: 0;
+SYNCTEX_INLINE static synctex_point_s _synctex_data_set_point(synctex_node_p node, synctex_point_s point) {
+    synctex_point_s old = _synctex_data_point(node);
+    _synctex_data_set_h(node,point.h);
+    _synctex_data_set_v(node,point.v);
+    return old;
 }
-
-/**
- *  The next result of the iterator.
- *  Internally, the iterator stores handles to nodes.
- *  Externally, it returns the targets,
- *  such that the caller only sees nodes.
- */
-synctex_node_p synctex_iterator_next_result(synctex_iterator_p iterator) {
-    if (iterator && iterator->count>0) {
-        synctex_node_p N = iterator->next;
-        if(!(iterator->next = _synctex_tree_child(N))) {
-            iterator->next = iterator->top = __synctex_tree_sibling(iterator->top);
-        }
-        --iterator->count;
-        return _synctex_tree_target(N);
+SYNCTEX_INLINE static synctex_box_s _synctex_data_box(synctex_node_p node) {
+    synctex_box_s box = {{0,0},{0,0}};
+    int n;
+    n = synctex_node_width(node);
+    if (n<0) {
+        box.max.h = synctex_node_h(node);
+        box.min.h = box.max.h + n;
+    } else {
+        box.min.h = synctex_node_h(node);
+        box.max.h = box.min.h + n;
     }
-    return NULL;
+    n = synctex_node_v(node);
+    box.min.v = n - synctex_node_height(node);
+    box.max.v = n + synctex_node_depth(node);
+    return box;
 }
-int synctex_iterator_reset(synctex_iterator_p iterator) {
-    if (iterator) {
-        iterator->next = iterator->top = iterator->seed;
-        return iterator->count = iterator->count0;
+SYNCTEX_INLINE static synctex_box_s _synctex_data_xob(synctex_node_p node) {
+    synctex_box_s box = {{0,0},{0,0}};
+    int n;
+    n = synctex_node_width(node);
+    if (n>0) {
+        box.max.h = synctex_node_h(node);
+        box.min.h = box.max.h - n;
+    } else {
+        box.min.h = synctex_node_h(node);
+        box.max.h = box.min.h - n;
     }
-    return 0;
-}
-
-synctex_iterator_p synctex_iterator_new_edit(synctex_scanner_p scanner,int page,float h,float v){
-    if (scanner) {
-        synctex_node_p sheet = NULL;
-        synctex_point_s hit;
-        synctex_node_p node = NULL;
-        synctex_nd_lr_s nds = {{NULL,0},{NULL,0}};
-        if (NULL == (scanner = synctex_scanner_parse(scanner)) || 0 >= scanner->unit) {/*  scanner->unit must be >0 */
-            return NULL;
-        }
-        /*  Find the proper sheet */
-        sheet = synctex_sheet(scanner,page);
-        if (NULL == sheet) {
-            return NULL;
-        }
-        /*  Now sheet points to the sheet node with proper page number. */
-        /*  Now that scanner has been initialized, we can convert
-         *  the given point to scanner integer coordinates */
-        hit = (synctex_point_s)
-        {(h-scanner->x_offset)/scanner->unit,
-            (v-scanner->y_offset)/scanner->unit};
-        /*  At first, we browse all the horizontal boxes of the sheet
-         *  until we find one containing the hit point. */
-        if ((node = _synctex_tree_next_hbox(sheet))) {
-            do {
-                if (_synctex_point_in_box_v2(&hit,node)) {
-                    /*  Maybe the hit point belongs to a contained vertical box.
-                     *  This is the most likely situation.
-                     */
-                    synctex_node_p next = node;
-#if defined(SYNCTEX_DEBUG)
-                    printf("--- We are lucky\n");
-#endif
-                    /*  This trick is for catching overlapping boxes */
-                    while ((next = _synctex_tree_next_hbox(next))) {
-                        if (_synctex_point_in_box_v2(&hit,next)) {
-                            node = _synctex_smallest_container_v2(next,node);
-                        }
-                    }
-                    /*  node is the smallest horizontal box that contains hit,
-                     *  unless there is no hbox at all.
-                     */
-                    node = _synctex_eq_deepest_container_v2(&hit, node);
-                    nds = _synctex_eq_get_closest_children_in_box_v2(&hit, node);
-                end:
-                    if (nds.r.node && nds.l.node) {
-                        if ((_synctex_data_tag(nds.r.node)!=_synctex_data_tag(nds.l.node))
-                            || (_synctex_data_line(nds.r.node)!=_synctex_data_line(nds.l.node))
-                            || (_synctex_data_column(nds.r.node)!=_synctex_data_column(nds.l.node))) {
-                            if (_synctex_data_line(nds.r.node)<_synctex_data_line(nds.l.node)) {
-                                node = nds.r.node;
-                                nds.r.node = nds.l.node;
-                                nds.l.node = node;
-                            } else if (_synctex_data_line(nds.r.node)==_synctex_data_line(nds.l.node)) {
-                                if (nds.l.distance>nds.r.distance) {
-                                    node = nds.r.node;
-                                    nds.r.node = nds.l.node;
-                                    nds.l.node = node;
-                                }
-                            }
-                            if((node = _synctex_new_handle_with_target(nds.l.node))) {
-                                synctex_node_p other_handle;
-                                if((other_handle = _synctex_new_handle_with_target(nds.r.node))) {
-                                    _synctex_tree_set_sibling(node,other_handle);
-                                    return _synctex_iterator_new(node,2);
-                                }
-                                return _synctex_iterator_new(node,1);
-                            }
-                            return NULL;
-                        }
-                        /*  both nodes have the same input coordinates
-                         *  We choose the one closest to the hit point  */
-                        if (nds.l.distance>nds.r.distance) {
-                            nds.l.node = nds.r.node;
-                        }
-                        nds.r.node = NULL;
-                    } else if (nds.r.node) {
-                        nds.l = nds.r;
-                    } else if (!nds.l.node) {
-                        nds.l.node = node;
-                    }
-                    if((node = _synctex_new_handle_with_target(nds.l.node))) {
-                        return _synctex_iterator_new(node,1);
-                    }
-                    return 0;
-                }
-            } while ((node = _synctex_tree_next_hbox(node)));
-            /*  All the horizontal boxes have been tested,
-             *  None of them contains the hit point.
-             */
-        }
-        /*  We are not lucky,
-         *  we test absolutely all the node
-         *  to find the closest... */
-        if ((node = _synctex_tree_child(sheet))) {
-#if defined(SYNCTEX_DEBUG)
-            printf("--- We are not lucky\n");
-#endif
-            nds.l = __synctex_closest_deep_child_v2(&hit, node);
-#if defined(SYNCTEX_DEBUG)
-            printf("Edit query best: %i\n", nds.l.distance);
-#endif
-            goto end;
-        }
+    n = synctex_node_v(node);
+    box.min.v = n - synctex_node_height(node);
+    box.max.v = n + synctex_node_depth(node);
+    return box;
+}
+SYNCTEX_INLINE static synctex_box_s _synctex_data_box_V(synctex_node_p node) {
+    synctex_box_s box = {{0,0},{0,0}};
+    int n;
+    n = _synctex_node_width_V(node);
+    if (n<0) {
+        box.max.h = _synctex_node_h_V(node);
+        box.min.h = box.max.h + n;
+    } else {
+        box.min.h = _synctex_node_h_V(node);
+        box.max.h = box.min.h + n;
     }
-    return NULL;
+    n = _synctex_node_v_V(node);
+    box.min.v = n - _synctex_node_height_V(node);
+    box.max.v = n + _synctex_node_depth_V(node);
+    return box;
 }
 
 /**
- *  Loop the candidate friendly list to find the ones with the proper
- *  tag and line.
- *  Returns a tree of results targeting the found candidates.
- *  At the top level each sibling has its own page number.
- *  All the results with the same page number are linked by child/parent entry.
- *  - parameter candidate: a friendly list of candidates
+ *  The higher box node in the parent hierarchy which
+ *  mean line number is the one of node ±1.
+ *  This enclosing box is computed as follows
+ *  1) get the first hbox in the parent linked list
+ *  starting at node.
+ *  If there is none, simply return the parent of node.
+ *  2) compute the mean line number
+ *  3) scans up the tree for the higher hbox with
+ *  the same mean line number, ±1 eventually
+*  - parameter node: a node.
+ *  - returns: a (proxy to a) box node.
+ *  - author: JL
  */
-static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag, int line, synctex_bool_t exclude_box) {
-    synctex_node_p first_handle = NULL;
-    /*  Search the first match */
-    if (target == NULL) {
-        return first_handle;
-    }
-    do {
-        int page;
-        if ((exclude_box
-             && _synctex_node_is_box(target))
-            || (tag != synctex_node_tag(target))
-            || (line != synctex_node_line(target))) {
-            continue;
-        }
-        /*  We found a first match, create
-         *  a result handle targeting that candidate. */
-        first_handle = _synctex_new_handle_with_target(target);
-        if (first_handle == NULL) {
-            return first_handle;
-        }
-        /*  target is either a node,
-         *  or a proxy to some node, in which case,
-         *  the target's target belongs to a form,
-         *  not a sheet. */
-        page = synctex_node_page(target);
-        /*  Now create all the other results  */
-        while ((target = _synctex_tree_friend(target))) {
-            synctex_node_p result = NULL;
-            if ((exclude_box
-                 && _synctex_node_is_box(target))
-                || (tag != synctex_node_tag(target))
-                || (line != synctex_node_line(target))) {
-                continue;
-            }
-            /*  Another match, same page number ? */
-            result = _synctex_new_handle_with_target(target);
-            if (NULL == result ) {
-                return first_handle;
-            }
-            /*  is it the same page number ? */
-            if (synctex_node_page(target) == page) {
-                __synctex_tree_set_child(result, first_handle);
-                first_handle = result;
-            } else {
-                /*  We have 2 page numbers involved */
-                __synctex_tree_set_sibling(first_handle, result);
-                while ((target = _synctex_tree_friend(target))) {
-                    synctex_node_p same_page_node;
-                    if ((exclude_box
-                         && _synctex_node_is_box(target))
-                        || (tag != synctex_node_tag(target))
-                        || (line != synctex_node_line(target))) {
-                        continue;
-                    }
-                    /*  New match found, which page? */
-                    result = _synctex_new_handle_with_target(target);
-                    if (NULL == result) {
-                        return first_handle;
+static synctex_node_p _synctex_node_box_visible(synctex_node_p node) {
+    if ((node = _synctex_node_or_handle_target(node))) {
+        int mean = 0;
+        int bound = 1500000/(node->class_->scanner->pre_magnification/1000.0);
+        synctex_node_p parent = NULL;
+        /*  get the first enclosing parent
+         *  then get the highest enclosing parent with the same mean line ±1 */
+        node = _synctex_node_or_handle_target(node);
+        if (!_synctex_node_is_box(node)) {
+            if ((parent = _synctex_tree_parent(node))) {
+                node = parent;
+            } else if ((node = _synctex_tree_target(node))) {
+                if (!_synctex_node_is_box(node)) {
+                    if ((parent = _synctex_tree_parent(node))) {
+                        node = parent;
+                    } else {
+                        return NULL;
                     }
-                    same_page_node = first_handle;
-                    page = synctex_node_page(target);
-                    /*  Find a result with the same page number */;
-                    do {
-                        if (_synctex_node_target_page(same_page_node) == page) {
-                            /* Insert result between same_page_node and its child */
-                            _synctex_tree_set_child(result,_synctex_tree_set_child(same_page_node,result));
-                        } else if ((same_page_node = __synctex_tree_sibling(same_page_node))) {
-                            continue;
-                        } else {
-                            /*  This is a new page number */
-                            __synctex_tree_set_sibling(result,first_handle);
-                            first_handle = result;
-                        }
-                        break;
-                    } while (synctex_YES);
                 }
-                return first_handle;
             }
         }
-    } while ((target = _synctex_tree_friend(target)));
-    return first_handle;
-}
-synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner,const char * name,int line,int column, int page_hint) {
-    SYNCTEX_UNUSED(column)
-    if (scanner) {
-        int tag = synctex_scanner_get_tag(scanner,name);/* parse if necessary */
-        int max_line = 0;
-        int line_offset = 1;
-        int try_count = 100;
-        synctex_node_p node = NULL;
-        synctex_node_p result = NULL;
-        if (tag == 0) {
-            printf("SyncTeX Warning: No tag for %s\n",name);
-            return NULL;
-        }
-        node = synctex_scanner_input_with_tag(scanner, tag);
-        max_line = _synctex_data_line(node);
-        /*  node = NULL; */
-        if (line>max_line) {
-            line = max_line;
-        }
-        while(try_count--) {
-            if (line<=max_line) {
-                /*  This loop will only be performed once for advanced viewers */
-                synctex_node_p friend = _synctex_scanner_friend(scanner,tag+line);
-                if ((node = friend)) {
-                    result = _synctex_display_query_v2(node,tag,line,synctex_YES);
-                    if (!result) {
-                        /*  We did not find any matching boundary, retry including boxes */
-                        node = friend;/*  no need to test it again, already done */
-                        result = _synctex_display_query_v2(node,tag,line,synctex_NO);
-                    }
-                    /*  Now reverse the order to have nodes in display order, and then keep just a few nodes.
-                     *  Order first the best node. */
-                    /*  The result is a tree. At the root level, all nodes
-                     *  correspond to different page numbers.
-                     *  Each node has a child which corresponds to the same
-                     *  page number if relevant.
-                     *  Then reorder the nodes to put first the one which fits best.
-                     *  The idea is to count the number of nodes
-                     *  with the same tag and line number in the parents
-                     *  and choose the ones with the biggest count.
-                     */
-                    if (result) {
-                        /*  navigate through siblings, then children   */
-                        synctex_node_p next_sibling = __synctex_tree_reset_sibling(result);
-                        int best_match = abs(page_hint-_synctex_node_target_page(result));
-                        synctex_node_p sibling;
-                        int match;
-                        synctex_counted_node_s cn = _synctex_vertically_sorted_v2(result);
-                        int count = cn.count;
-                        result = cn.node;
-                        while((sibling = next_sibling)) {
-                            /* What is next? Do not miss that step! */
-                            next_sibling = __synctex_tree_reset_sibling(sibling);
-                            cn = _synctex_vertically_sorted_v2(sibling);
-                            count += cn.count;
-                            sibling = cn.node;
-                            match = abs(page_hint-_synctex_node_target_page(sibling));
-                            if (match<best_match) {
-                                /*  Order this node first */
-                                __synctex_tree_set_sibling(sibling,result);
-                                result = sibling;
-                                best_match = match;
-                            } else /*if (match>=best_match)*/ {
-                                __synctex_tree_set_sibling(sibling,__synctex_tree_sibling(result));
-                                __synctex_tree_set_sibling(result,sibling);
-                            }
-                        }
-                        return _synctex_iterator_new(result,count);
-                    }
-                }
-#       if defined(__SYNCTEX_STRONG_DISPLAY_QUERY__)
-                break;
-#       else
-                line += line_offset;
-                line_offset=line_offset<0?-(line_offset-1):-(line_offset+1);
-                if (line <= 0) {
-                    line += line_offset;
-                    line_offset=line_offset<0?-(line_offset-1):-(line_offset+1);
+        parent = node;
+        mean = synctex_node_mean_line(node);
+        while ((parent = _synctex_tree_parent(parent))) {
+            if (_synctex_node_is_hbox(parent)) {
+                if (_synctex_abs(mean-synctex_node_mean_line(parent))>1) {
+                    return node;
+                } else if (synctex_node_width(parent)>bound) {
+                    return parent;
+                } else if (synctex_node_height(parent)+synctex_node_depth(parent)>bound) {
+                    return parent;
                 }
-#       endif
+                node = parent;
             }
         }
     }
-    return NULL;
-}
-synctex_status_t synctex_display_query(synctex_scanner_p scanner,const char *  name,int line,int column, int page_hint) {
-    if (scanner) {
-        synctex_iterator_free(scanner->iterator);
-        scanner->iterator = synctex_iterator_new_display(scanner, name,line,column, page_hint);
-        return synctex_iterator_count(scanner->iterator);
-    }
-    return SYNCTEX_STATUS_ERROR;
-}
-synctex_status_t synctex_edit_query(synctex_scanner_p scanner,int page,float h,float v) {
-    if (scanner) {
-        synctex_iterator_free(scanner->iterator);
-        scanner->iterator = synctex_iterator_new_edit(scanner, page, h, v);
-        return synctex_iterator_count(scanner->iterator);
-    }
-    return SYNCTEX_STATUS_ERROR;
+    return node;
 }
 /**
- *  The next result of a query.
+ *  The horizontal location of the first box enclosing node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
  */
-synctex_node_p synctex_scanner_next_result(synctex_scanner_p scanner) {
-    return scanner? synctex_iterator_next_result(scanner->iterator): NULL;
+float synctex_node_box_visible_h(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_h(node,_synctex_node_h_V(_synctex_node_box_visible(node)));
 }
-synctex_status_t synctex_scanner_reset_result(synctex_scanner_p scanner) {
-    return scanner? synctex_iterator_reset(scanner->iterator): SYNCTEX_STATUS_ERROR;
+/**
+ *  The vertical location of the first box enclosing node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
+ */
+float synctex_node_box_visible_v(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_DISTANCE_v(node,_synctex_node_v_V(_synctex_node_box_visible(node)));
 }
-
-synctex_node_p synctex_node_target(synctex_node_p node) {
-    return _synctex_tree_target(node);
+/**
+ *  The width of the first box enclosing node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
+ */
+float synctex_node_box_visible_width(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_width_V(_synctex_node_box_visible(node)));
+}
+/**
+ *  The height of the first box enclosing node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
+ */
+float synctex_node_box_visible_height(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_height_V(_synctex_node_box_visible(node)));
+}
+/**
+ *  The depth of the first box enclosing node, in page coordinates.
+ *  - parameter node: a node.
+ *  - returns: a float.
+ *  - author: JL
+ */
+float synctex_node_box_visible_depth(synctex_node_p node) {
+    return SYNCTEX_VISIBLE_SIZE(node,_synctex_node_depth_V(_synctex_node_box_visible(node)));
 }
-
 #	ifdef SYNCTEX_NOTHING
 #       pragma mark -
-#       pragma mark Geometric utilities
+#       pragma mark Other public node attributes
 #   endif
 
-/** Rougly speaking, this is:
- *  node's h coordinate - hit point's h coordinate.
- *  If node is to the right of the hit point, then this distance is positive,
- *  if node is to the left of the hit point, this distance is negative.
- *  If the argument is a pdf form reference, then the child is used and returned instead.
- *  Last Revision: Mon Apr 24 07:05:27 UTC 2017
+/**
+ *  The page number of the sheet enclosing node.
+ *  - parameter node: a node.
+ *  - returns: the page number or -1 if node does not belong to a sheet tree.
+ *  - note: a proxy target does not belong to a sheet
+ *      but a form, its page number is always -1.
+ *  - note: a handles does not belong to a sheet not a form.
+ *      its page number is -1.
+ *  - author: JL
  */
-static synctex_nd_s _synctex_point_h_ordered_distance_v2
-(synctex_point_p hit, synctex_node_p node) {
-    synctex_nd_s nd = {node,INT_MAX};
-    if (node) {
-        int min,med,max,width;
-        switch(synctex_node_type(node)) {
-                /*  The distance between a point and a box is special.
-                 *  It is not the euclidian distance, nor something similar.
-                 *  We have to take into account the particular layout,
-                 *  and the box hierarchy.
-                 *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
-                 *  The origin being at the top left corner of the page,
-                 *  we also give names to the vertices of the box.
-                 *
-                 *   1 | 2 | 3
-                 *  ---A---B--->
-                 *   4 | 5 | 6
-                 *  ---C---D--->
-                 *   7 | 8 | 9
-                 *     v   v
-                 */
-            case synctex_node_type_vbox:
-            case synctex_node_type_void_vbox:
-            case synctex_node_type_void_hbox:
-                /*  getting the box bounds, taking into account negative width, height and depth. */
-                width = _synctex_data_width(node);
-                min = _synctex_data_h(node);
-                max = min + (width>0?width:-width);
-                /*  We always have min <= max */
-                if (hit->h<min) {
-                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
-                } else if (hit->h>max) {
-                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
-                } else {
-                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
-                }
-                break;
-            case synctex_node_type_proxy_vbox:
-                /*  getting the box bounds, taking into account negative width, height and depth. */
-                width = synctex_node_width(node);
-                min = synctex_node_h(node);
-                max = min + (width>0?width:-width);
-                /*  We always have min <= max */
-                if (hit->h<min) {
-                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
-                } else if (hit->h>max) {
-                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
-                } else {
-                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
-                }
-                break;
-            case synctex_node_type_hbox:
-            case synctex_node_type_proxy_hbox:
-                /*  getting the box bounds, taking into account negative width, height and depth. */
-                width = synctex_node_hbox_width(node);
-                min = synctex_node_hbox_h(node);
-                max = min + (width>0?width:-width);
-                /*  We always have min <= max */
-                if (hit->h<min) {
-                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
-                } else if (hit->h>max) {
-                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
-                } else {
-                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
-                }
-                break;
-            case synctex_node_type_kern:
-                /*  IMPORTANT NOTICE: the location of the kern is recorded AFTER the move.
-                 *  The distance to the kern is very special,
-                 *  in general, there is no text material in the kern,
-                 *  this is why we compute the offset relative to the closest edge of the kern.*/
-                max = _synctex_data_width(node);
-                if (max<0) {
-                    min = _synctex_data_h(node);
-                    max = min - max;
-                } else {
-                    min = -max;
-                    max = _synctex_data_h(node);
-                    min += max;
-                }
-                med = (min+max)/2;
-                /*  positive kern: '.' means text, '>' means kern offset
-                 *      .............
-                 *                   min>>>>med>>>>max
-                 *                                    ...............
-                 *  negative kern: '.' means text, '<' means kern offset
-                 *      ............................
-                 *                 min<<<<med<<<<max
-                 *                 .................................
-                 *  Actually, we do not take into account negative widths.
-                 *  There is a problem for such situation when there is effectively overlapping text.
-                 *  But this should be extremely rare. I guess that in that case, many different choices
-                 *  could be made, one being in contradiction with the other.
-                 *  It means that the best choice should be made according to the situation that occurs
-                 *  most frequently.
-                 */
-                if (hit->h<min) {
-                    nd.distance = min - hit->h + 1; /*  penalty to ensure other nodes are chosen first in case of overlapping ones */
-                } else if (hit->h>max) {
-                    nd.distance = max - hit->h - 1; /*  same kind of penalty */
-                } else if (hit->h>med) {
-                    /*  do things like if the node had 0 width and was placed at the max edge + 1*/
-                    nd.distance = max - hit->h + 1; /*  positive, the kern is to the right of the hit point */
-                } else {
-                    nd.distance = min - hit->h - 1; /*  negative, the kern is to the left of the hit point */
-                }
-                break;
-            case synctex_node_type_rule:/* to do: special management */
-            case synctex_node_type_glue:
-            case synctex_node_type_math:
-            case synctex_node_type_boundary:
-            case synctex_node_type_box_bdry:
-                nd.distance = _synctex_data_h(node) - hit->h;
-                break;
-            case synctex_node_type_ref:
-                nd.node = synctex_node_child(node);
-                nd = _synctex_point_h_ordered_distance_v2(hit,nd.node);
-                break;
-            case synctex_node_type_proxy:
-            case synctex_node_type_proxy_last:
-            {
-                /* shift the hit point to be relative to the proxy origin,
-                 *  then compute the distance to the target
-                 */
-                synctex_point_s otherHit = *hit;
-                otherHit.h -= _synctex_data_h(node);
-                otherHit.v -= _synctex_data_v(node);
-                nd.node = _synctex_tree_target(node);
-                nd = _synctex_point_h_ordered_distance_v2(&otherHit,nd.node);
-                nd.node = node;
-            }
-            default:
-                break;
-        }
+int synctex_node_page(synctex_node_p node){
+    synctex_node_p parent = NULL;
+    while((parent = _synctex_tree_parent(node))) {
+        node = parent;
     }
-    return nd;
+    if (synctex_node_type(node) == synctex_node_type_sheet) {
+        return _synctex_data_page(node);
+    }
+    return -1;
 }
-/** Rougly speaking, this is:
- *  node's v coordinate - hit point's v coordinate.
- *  If node is at the top of the hit point, then this distance is positive,
- *  if node is at the bottom of the hit point, this distance is negative.
+/**
+ *  The page number of the target.
+ *  - author: JL
  */
-static synctex_nd_s _synctex_point_v_ordered_distance_v2
-(synctex_point_p hit, synctex_node_p node) {
-    synctex_nd_s nd = {node, INT_MAX};
-    int min,max,depth,height;
-    switch(synctex_node_type(node)) {
-            /*  The distance between a point and a box is special.
-             *  It is not the euclidian distance, nor something similar.
-             *  We have to take into account the particular layout,
-             *  and the box hierarchy.
-             *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
-             *  The origin being at the top left corner of the page,
-             *  we also give names to the vertices of the box.
-             *
-             *   1 | 2 | 3
-             *  ---A---B--->
-             *   4 | 5 | 6
-             *  ---C---D--->
-             *   7 | 8 | 9
-             *     v   v
-             */
-        case synctex_node_type_vbox:
-        case synctex_node_type_void_vbox:
-        case synctex_node_type_void_hbox:
-            /*  getting the box bounds, taking into account negative width, height and depth. */
-            min = synctex_node_v(node);
-            max = min + _synctex_abs(_synctex_data_depth(node));
-            min -= _synctex_abs(_synctex_data_height(node));
-            /*  We always have min <= max */
-            if (hit->v<min) {
-                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
-            } else if (hit->v>max) {
-                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
-            } else {
-                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
-            }
-            break;
-        case synctex_node_type_proxy_vbox:
-            /*  getting the box bounds, taking into account negative width, height and depth. */
-            min = synctex_node_v(node);
-            max = min + _synctex_abs(synctex_node_depth(node));
-            min -= _synctex_abs(synctex_node_height(node));
-            /*  We always have min <= max */
-            if (hit->v<min) {
-                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
-            } else if (hit->v>max) {
-                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
-            } else {
-                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
-            }
-            break;
-        case synctex_node_type_hbox:
-        case synctex_node_type_proxy_hbox:
-            /*  getting the box bounds, taking into account negative height and depth. */
-            min = synctex_node_hbox_v(node);
-            depth = synctex_node_hbox_depth(node);
-            max = min + (depth>0?depth:-depth);
-            height = synctex_node_hbox_height(node);
-            min -= (height>0?height:-height);
-            /*  We always have min <= max */
-            if (hit->v<min) {
-                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
-            } else if (hit->v>max) {
-                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
-            } else {
-                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
-            }
-            break;
-        case synctex_node_type_rule:/* to do: special management */
-        case synctex_node_type_kern:
-        case synctex_node_type_glue:
-        case synctex_node_type_math:
-            min = _synctex_data_v(node);
-            max = min + _synctex_abs(_synctex_data_depth(_synctex_tree_parent(node)));
-            min -= _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
-            /*  We always have min <= max */
-            if (hit->v<min) {
-                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
-            } else if (hit->v>max) {
-                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
-            } else {
-                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
-            }
-            break;
-        case synctex_node_type_ref:
-            nd.node = synctex_node_child(node);
-            nd = _synctex_point_v_ordered_distance_v2(hit,nd.node);
-            break;
-        case synctex_node_type_proxy:
-        case synctex_node_type_proxy_last:
-        {
-            synctex_point_s otherHit = *hit;
-            otherHit.h -= _synctex_data_h(node);
-            otherHit.v -= _synctex_data_v(node);
-            nd.node = _synctex_tree_target(node);
-            nd = _synctex_point_v_ordered_distance_v2(&otherHit,nd.node);
-            nd.node = node;
-        }
-        default: break;
-    }
-    return nd;
+SYNCTEX_INLINE static int _synctex_node_target_page(synctex_node_p node){
+    return synctex_node_page(_synctex_tree_target(node));
+}
+
+#if defined (SYNCTEX_USE_CHARINDEX)
+synctex_charindex_t synctex_node_charindex(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    return target? SYNCTEX_CHARINDEX(target):(node?SYNCTEX_CHARINDEX(node):0);
 }
+#endif
+
 /**
- *  The best is the one with the smallest area.
- *  The area is width*height where width and height may be big.
- *  So there is a real risk of overflow if we stick with ints.
+ *  The tag of the node.
+ *  - parameter node: a node.
+ *  - returns: the tag or -1 if node is NULL.
+ *  - author: JL
  */
-SYNCTEX_INLINE static synctex_node_p _synctex_smallest_container_v2(synctex_node_p node, synctex_node_p other_node) {
-    long total_height, other_total_height;
-    unsigned long area, other_area;
-    long width = synctex_node_hbox_width(node);
-    long other_width = synctex_node_hbox_width(other_node);
-    if (width<0) {
-        width = -width;
+int synctex_node_tag(synctex_node_p node) {
+    return node? node->class_->tlcpector->tag(node): -1;
+}
+/**
+ *  The line of the node.
+ *  - parameter node: a node.
+ *  - returns: the line or -1 if node is NULL.
+ *  - author: JL
+ */
+int synctex_node_line(synctex_node_p node) {
+    return node? node->class_->tlcpector->line(node): -1;
+}
+/**
+ *  The column of the node.
+ *  - parameter node: a node.
+ *  - returns: the column or -1 if node is NULL.
+ *  - author: JL
+ */
+int synctex_node_column(synctex_node_p node) {
+    return node? node->class_->tlcpector->column(node): -1;
+}
+/**
+ *  The mean line number of the node.
+ *  - parameter node: a node.
+ *  - returns: the mean line or -1 if node is NULL.
+ *  - author: JL
+ */
+int synctex_node_mean_line(synctex_node_p node) {
+    synctex_node_p other = _synctex_tree_target(node);
+    if (other) {
+        node = other;
     }
-    if (other_width<0) {
-        other_width = -other_width;
+    if (_synctex_data_has_mean_line(node)) {
+        return _synctex_data_mean_line(node);
     }
-    total_height = _synctex_abs(synctex_node_hbox_depth(node)) + _synctex_abs(synctex_node_hbox_height(node));
-    other_total_height = _synctex_abs(synctex_node_hbox_depth(other_node)) + _synctex_abs(synctex_node_hbox_height(other_node));
-    area = total_height*width;
-    other_area = other_total_height*other_width;
-    if (area<other_area) {
-        return node;
+    if ((other = synctex_node_parent(node))) {
+        if (_synctex_data_has_mean_line(other)) {
+            return _synctex_data_mean_line(other);
+        }
     }
-    if (area>other_area) {
-        return other_node;
+    return synctex_node_line(node);
+}
+/**
+ *  The weight of the node.
+ *  - parameter node: a node.
+ *  - returns: the weight or -1 if node is NULL.
+ *  - author: JL
+ */
+int synctex_node_weight(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    if (target) {
+        node = target;
     }
-    if (_synctex_abs(_synctex_data_width(node))>_synctex_abs(_synctex_data_width(other_node))) {
-        return node;
+    return node?(synctex_node_type(node)==synctex_node_type_hbox?_synctex_data_weight(node):0):-1;
+}
+/**
+ *  The number of children of the node.
+ *  - parameter node: a node.
+ *  - returns: the count or -1 if node is NULL.
+ *  - author: JL
+ */
+int synctex_node_child_count(synctex_node_p node) {
+    synctex_node_p target = _synctex_tree_target(node);
+    if (target) {
+        node = target;
     }
-    if (_synctex_abs(_synctex_data_width(node))<_synctex_abs(_synctex_data_width(other_node))) {
-        return other_node;
+    return node?(synctex_node_type(node)==synctex_node_type_hbox?_synctex_data_weight(node):0):-1;
+}
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Sheet & Form
+#   endif
+
+/**
+ *  The sheet of the scanner with a given page number.
+ *  - parameter scanner: a scanner.
+ *  - parameter page: a 1 based page number.
+ *      If page == 0, returns the first sheet.
+ *  - returns: a sheet or NULL.
+ *  - author: JL
+ */
+synctex_node_p synctex_sheet(synctex_scanner_p scanner,int page) {
+    if (scanner) {
+        synctex_node_p sheet = scanner->sheet;
+        if (scanner->lazy) {
+            return _synctex_lazy_sheet(scanner,page);
+        }
+        while(sheet) {
+            if (page == _synctex_data_page(sheet)) {
+                return sheet;
+            }
+            sheet = __synctex_tree_sibling(sheet);
+        }
+        if (page == 0) {
+            return scanner->sheet;
+        }
     }
-    if (total_height<other_total_height) {
-        return node;
+    return NULL;
+}
+/**
+ *  The form of the scanner with a given tag.
+ *  - parameter scanner: a scanner.
+ *  - parameter tag: an integer identifier.
+ *      If tag == 0, returns the first form.
+ *  - returns: a form.
+ *  - author: JL
+ */
+synctex_node_p synctex_form(synctex_scanner_p scanner,int tag) {
+    if (scanner) {
+        synctex_node_p form = scanner->form;
+        while(form) {
+            if (tag == _synctex_data_tag(form)) {
+                return form;
+            }
+            form = __synctex_tree_sibling(form);
+        }
+        if (tag == 0) {
+            return scanner->form;
+        }
     }
-    if (total_height>other_total_height) {
-        return other_node;
+    return NULL;
+}
+
+/**
+ *  The content of the sheet with given page number.
+ *  - parameter scanner: a scanner.
+ *  - parameter page: a 1 based page number.
+ *  - returns: a (vertical) box node.
+ *  - author: JL
+ */
+synctex_node_p synctex_sheet_content(synctex_scanner_p scanner,int page) {
+    if (scanner) {
+        return _synctex_tree_child(synctex_sheet(scanner,page));
     }
-    return node;
+    return NULL;
 }
 
-SYNCTEX_INLINE static synctex_bool_t _synctex_point_in_box_v2(synctex_point_p hit, synctex_node_p node) {
-    if (node) {
-        if (0 == _synctex_point_h_ordered_distance_v2(hit,node).distance
-            && 0 == _synctex_point_v_ordered_distance_v2(hit,node).distance) {
-            return synctex_YES;
-        }
+/**
+ *  The content of the sheet with given page number.
+ *  - parameter scanner: a scanner.
+ *  - parameter tag: an integer identifier.
+ *  - returns: a box node.
+ *  - author: JL
+ */
+synctex_node_p synctex_form_content(synctex_scanner_p scanner,int tag) {
+    if (scanner) {
+        return _synctex_tree_child(synctex_form(scanner,tag));
     }
-    return synctex_NO;
+    return NULL;
 }
 
-static int _synctex_distance_to_box_v2(synctex_point_p hit,synctex_box_p box) {
-    /*  The distance between a point and a box is special.
-     *  It is not the euclidian distance, nor something similar.
-     *  We have to take into account the particular layout,
-     *  and the box hierarchy.
-     *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
-     *  The origin being at the top left corner of the page,
-     *  we also give names to the vertices of the box.
-     *
-     *   1 | 2 | 3
-     *  ---A---B--->
-     *   4 | 5 | 6
-     *  ---C---D--->
-     *   7 | 8 | 9
-     *     v   v
-     *  In each region, there is a different formula.
-     *  In the end we have a continuous distance which may not be a mathematical distance but who cares. */
-    if (hit->v<box->min.v) {
-        /*  Regions 1, 2 or 3 */
-        if (hit->h<box->min.h) {
-            /*  This is region 1. The distance to the box is the L1 distance PA. */
-            return box->min.v - hit->v + box->min.h - hit->h;/*  Integer overflow? probability epsilon */
-        } else if (hit->h<=box->max.h) {
-            /*  This is region 2. The distance to the box is the geometrical distance to the top edge.  */
-            return box->min.v - hit->v;
-        } else {
-            /*  This is region 3. The distance to the box is the L1 distance PB. */
-            return box->min.v - hit->v + hit->h - box->max.h;
-        }
-    } else if (hit->v<=box->max.v) {
-        /*  Regions 4, 5 or 6 */
-        if (hit->h<box->min.h) {
-            /*  This is region 4. The distance to the box is the geometrical distance to the left edge.  */
-            return box->min.h - hit->h;
-        } else if (hit->h<=box->max.h) {
-            /*  This is region 5. We are inside the box.  */
-            return 0;
+SYNCTEX_INLINE static synctex_node_p _synctex_scanner_friend(synctex_scanner_p scanner,int i) {
+    if (i>=0) {
+        i = _synctex_abs(i)%(scanner->number_of_lists);
+        return (scanner->lists_of_friends)[i];
+    }
+    return NULL;
+}
+SYNCTEX_INLINE static synctex_bool_t _synctex_nodes_are_friend(synctex_node_p left, synctex_node_p right) {
+    return synctex_node_tag(left) == synctex_node_tag(right) && synctex_node_line(left) == synctex_node_line(right);
+}
+/**
+ *  The sibling argument is a parent/child list of nodes of the same page.
+ */
+typedef struct {
+    int count;
+    synctex_node_p node;
+} synctex_counted_node_s;
+
+SYNCTEX_INLINE static synctex_counted_node_s _synctex_vertically_sorted_v2(synctex_node_p sibling) {
+    /* Clean the weights of the parents */
+    synctex_counted_node_s result = {0, NULL};
+    synctex_node_p h = NULL;
+    synctex_node_p next_h = NULL;
+    synctex_node_p parent = NULL;
+    int weight = 0;
+    synctex_node_p N = NULL;
+    h = sibling;
+    do {
+        N = _synctex_tree_target(h);
+        parent = _synctex_tree_parent(N);
+        _synctex_data_set_weight(parent, 0);
+    } while((h = _synctex_tree_child(h)));
+    /* Compute the weights of the nodes */
+    h = sibling;
+    do {
+        N = _synctex_tree_target(h);
+        parent = _synctex_tree_parent(N);
+        weight = _synctex_data_weight(parent);
+        if (weight==0) {
+            N = _synctex_tree_child(parent);
+            do {
+                if (_synctex_nodes_are_friend(N,sibling)) {
+                    ++ weight;
+                }
+            } while ((N = __synctex_tree_sibling(N)));
+            _synctex_data_set_weight(h,weight);
+            _synctex_data_set_weight(parent,weight);
+        }
+    } while((h = _synctex_tree_child(h)));
+    /* Order handle nodes according to the weight */
+    h = _synctex_tree_reset_child(sibling);
+    result.node = sibling;
+    weight = 0;
+    while((h)) {
+        N = result.node;
+        if (_synctex_data_weight(h)>_synctex_data_weight(N)) {
+            next_h = _synctex_tree_set_child(h,N);
+            result.node = h;
+        } else if (_synctex_data_weight(h) == 0) {
+            ++ weight;
+            next_h = _synctex_tree_reset_child(h);
+            synctex_node_free(h);
         } else {
-            /*  This is region 6. The distance to the box is the geometrical distance to the right edge.  */
-            return hit->h - box->max.h;
+            synctex_node_p next_N = NULL;
+            while((next_N = _synctex_tree_child(N))) {
+                N = next_N;
+                if (_synctex_data_weight(h)<_synctex_data_weight(next_N)) {
+                    continue;
+                }
+                break;
+            }
+            next_h = _synctex_tree_set_child(h,_synctex_tree_set_child(N,h));
+        }
+        h = next_h;
+    };
+    h = result.node;
+    weight = 0;
+    do {
+        ++weight;
+    } while((h = _synctex_tree_child(h)));
+    result.count = 1;
+    h = result.node;
+    while((next_h = _synctex_tree_child(h))) {
+        if (_synctex_data_weight(next_h)==0) {
+            _synctex_tree_reset_child(h);
+            weight = 1;
+            h = next_h;
+            while((h = _synctex_tree_child(h))) {
+                ++weight;
+            }
+            synctex_node_free(next_h);
+            break;
+        }
+        ++result.count;
+        h = next_h;
+    }
+    return result;
+}
+
+SYNCTEX_INLINE static synctex_bool_t _synctex_point_in_box_v2(synctex_point_p hitP, synctex_node_p node);
+
+/*  This struct records distances, the left one is non negative and the right one is non positive.
+ *  When comparing the locations of 2 different graphical objects on the page, we will have to also record the
+ *  horizontal distance as signed to keep track of the typesetting order.*/
+
+typedef struct {
+    synctex_node_p node;
+    int distance;
+} synctex_nd_s;
+
+#define SYNCTEX_ND_0 (synctex_nd_s){NULL,INT_MAX}
+
+typedef synctex_nd_s * synctex_nd_p;
+
+typedef struct {
+    synctex_nd_s l;
+    synctex_nd_s r;
+} synctex_nd_lr_s;
+
+/*  The best container is the deeper box that contains the hit point (H,V).
+ *  _synctex_eq_deepest_container_v2 starts with node whereas
+ *  _synctex_box_child_deepest starts with node's children, if any
+ *  if node is not a box, or a void box, NULL is returned.
+ *  We traverse the node tree in a deep first manner and stop as soon as a result is found. */
+static synctex_node_p _synctex_eq_deepest_container_v2(synctex_point_p hitP, synctex_node_p node);
+
+SYNCTEX_INLINE static synctex_nd_lr_s _synctex_eq_get_closest_children_in_box_v2(synctex_point_p hitP, synctex_node_p node);
+
+/*  Closest child, recursive.  */
+static synctex_nd_s __synctex_closest_deep_child_v2(synctex_point_p hitP, synctex_node_p node);
+
+/*  The smallest container between two has the smallest width or height.
+ *  This comparison is used when there are 2 overlapping boxes that contain the hit point.
+ *  For ConTeXt, the problem appears at each page.
+ *  The chosen box is the one with the smallest height, then the smallest width. */
+SYNCTEX_INLINE static synctex_node_p _synctex_smallest_container_v2(synctex_node_p node, synctex_node_p other_node);
+
+/*  Returns the distance between the hit point hit point=(H,V) and the given node. */
+
+static int _synctex_point_node_distance_v2(synctex_point_p hitP, synctex_node_p node);
+
+/*  The closest container is the box that is the one closest to the given point.
+ *  The "visible" version takes into account the visible dimensions instead of the real ones given by TeX. */
+static synctex_nd_s _synctex_eq_closest_child_v2(synctex_point_p hitP, synctex_node_p node);
+
+/*  The distance between the hit point and the given box. */
+static int _synctex_distance_to_box_v2(synctex_point_p hitP,synctex_box_p box);
+
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Edit index
+#   endif
+
+/*  An edit query browses all the horizontal boxes of the sheet
+ *  to find the ones containing the hit point, and all the nodes of the sheet
+ *  when there is none. This is linear in the size of the page.
+ *  The edit index is a uniform grid built once per sheet, at the first edit query.
+ *  Each cell lists the hboxes and the leaf nodes with a bounding box meeting the cell,
+ *  in the order of the hbox list, respectively of the tree traversal.
+ *  The queries only test the nodes listed in the cells around the hit point,
+ *  and they give the same result as the full traversal:
+ *  - the bounding box of an hbox is exactly the one of _synctex_point_in_box_v2,
+ *  - the distance to a leaf is the L1 distance to a box,
+ *      never less than the L1 distance to its bounding box,
+ *      hence never less than the one to any cell it meets.
+ */
+#   if !defined(SYNCTEX_EDIT_INDEX_CELL_LOAD)
+#       define SYNCTEX_EDIT_INDEX_CELL_LOAD 8
+#   endif
+#   if !defined(SYNCTEX_EDIT_INDEX_MAX_CELLS)
+#       define SYNCTEX_EDIT_INDEX_MAX_CELLS 128
+#   endif
+
+typedef struct {
+    synctex_node_p * nodes; /*  hboxes or leaves, in traversal order */
+    synctex_box_s * boxes;  /*  their bounding boxes */
+    int number;
+    int capacity;
+    int * offsets;  /*  cell i lists cells[offsets[i]] to cells[offsets[i+1]-1] */
+    int * cells;    /*  indices in nodes */
+} synctex_edit_list_s;
+
+struct synctex_edit_index_t {
+    synctex_node_p sheet;
+    synctex_box_s extent;   /*  the union of all the bounding boxes */
+    int number_h;           /*  the number of columns, 0 when the index is unusable */
+    int number_v;           /*  the number of rows */
+    int cell_h;             /*  the width of the cells */
+    int cell_v;             /*  the height of the cells */
+    synctex_edit_list_s hboxes;
+    synctex_edit_list_s leaves;
+};
+
+static void _synctex_edit_list_free(synctex_edit_list_s * list) {
+    free(list->nodes);
+    free(list->boxes);
+    free(list->offsets);
+    free(list->cells);
+}
+static void _synctex_edit_index_free(synctex_edit_index_p index) {
+    if (index) {
+        _synctex_edit_list_free(&index->hboxes);
+        _synctex_edit_list_free(&index->leaves);
+        _synctex_free(index);
+    }
+}
+static void _synctex_scanner_free_edit_indexes(synctex_scanner_p scanner) {
+    int i = scanner->number_of_edit_indexes;
+    while (i--) {
+        _synctex_edit_index_free(scanner->edit_indexes[i]);
+    }
+    free(scanner->edit_indexes);
+    scanner->edit_indexes = NULL;
+    scanner->number_of_edit_indexes = 0;
+}
+static synctex_bool_t _synctex_edit_list_add(synctex_edit_list_s * list, synctex_node_p node, synctex_box_s box) {
+    if (list->number == list->capacity) {
+        int capacity = list->capacity? 2*list->capacity: 64;
+        synctex_node_p * nodes = realloc(list->nodes, capacity*sizeof(synctex_node_p));
+        synctex_box_s * boxes;
+        if (!nodes) {
+            return synctex_NO;
+        }
+        list->nodes = nodes;
+        if (!(boxes = realloc(list->boxes, capacity*sizeof(synctex_box_s)))) {
+            return synctex_NO;
+        }
+        list->boxes = boxes;
+        list->capacity = capacity;
+    }
+    list->nodes[list->number] = node;
+    list->boxes[list->number] = box;
+    ++list->number;
+    return synctex_YES;
+}
+/*  The box where _synctex_point_in_box_v2 answers yes. */
+static synctex_bool_t _synctex_edit_hbox_box(synctex_node_p node, synctex_box_p box) {
+    switch(synctex_node_type(node)) {
+        case synctex_node_type_hbox:
+        case synctex_node_type_proxy_hbox:
+            box->min.h = synctex_node_hbox_h(node);
+            box->max.h = box->min.h + _synctex_abs(synctex_node_hbox_width(node));
+            box->min.v = synctex_node_hbox_v(node);
+            box->max.v = box->min.v + _synctex_abs(synctex_node_hbox_depth(node));
+            box->min.v -= _synctex_abs(synctex_node_hbox_height(node));
+            return synctex_YES;
+        default:
+            return synctex_NO;
+    }
+}
+/*  The bounding box of the boxes used by _synctex_point_node_distance_v2.
+ *  Nodes with no such box are always at distance INT_MAX. */
+static synctex_bool_t _synctex_edit_leaf_box(synctex_node_p node, synctex_box_p box) {
+    int h, width;
+    switch(synctex_node_type(node)) {
+        case synctex_node_type_kern:
+            box->max.v = _synctex_data_v(node);
+            box->min.v = box->max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
+            h = _synctex_data_h(node);
+            width = _synctex_data_width(node);
+            box->min.h = width>0? h - width: h;
+            box->max.h = width>0? h: h - width;
+            return synctex_YES;
+        case synctex_node_type_glue:
+        case synctex_node_type_math:
+        case synctex_node_type_boundary:
+        case synctex_node_type_box_bdry:
+            box->min.h = box->max.h = _synctex_data_h(node);
+            box->max.v = _synctex_data_v(node);
+            box->min.v = box->max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
+            return synctex_YES;
+        case synctex_node_type_proxy:
+        case synctex_node_type_proxy_last:
+            if (_synctex_edit_leaf_box(_synctex_tree_target(node),box)) {
+                h = _synctex_data_h(node);
+                box->min.h += h;
+                box->max.h += h;
+                h = _synctex_data_v(node);
+                box->min.v += h;
+                box->max.v += h;
+                return synctex_YES;
+            }
+            return synctex_NO;
+        default:
+            return synctex_NO;
+    }
+}
+/*  Same traversal as __synctex_closest_deep_child_v2. */
+static synctex_bool_t _synctex_edit_index_collect(synctex_edit_index_p index, synctex_node_p node) {
+    synctex_node_p child = NULL;
+    synctex_box_s box;
+    if ((child = synctex_node_child(node))) {
+        do {
+            if (_synctex_node_is_box(child)) {
+                if (!_synctex_edit_index_collect(index,child)) {
+                    return synctex_NO;
+                }
+            } else if (_synctex_edit_leaf_box(child,&box)
+                       && !_synctex_edit_list_add(&index->leaves,child,box)) {
+                return synctex_NO;
+            }
+        } while((child = synctex_node_sibling(child)));
+    }
+    return synctex_YES;
+}
+SYNCTEX_INLINE static int _synctex_edit_index_cell(int x, int min, int size, int number) {
+    long long i = ((long long)x - min)/size;
+    return i<0? 0: (i<number? (int)i: number-1);
+}
+static synctex_bool_t _synctex_edit_index_fill(synctex_edit_index_p index, synctex_edit_list_s * list) {
+    int number_of_cells = index->number_h*index->number_v;
+    int * cursor = NULL;
+    int i, j, k, n;
+    if (!(list->offsets = calloc(number_of_cells+1,sizeof(int)))) {
+        return synctex_NO;
+    }
+    /*  count, then list, the nodes of each cell */
+    for (n = 0; n < list->number; ++n) {
+        synctex_box_p box = list->boxes + n;
+        int i_max = _synctex_edit_index_cell(box->max.h,index->extent.min.h,index->cell_h,index->number_h);
+        int j_max = _synctex_edit_index_cell(box->max.v,index->extent.min.v,index->cell_v,index->number_v);
+        for (j = _synctex_edit_index_cell(box->min.v,index->extent.min.v,index->cell_v,index->number_v); j <= j_max; ++j) {
+            for (i = _synctex_edit_index_cell(box->min.h,index->extent.min.h,index->cell_h,index->number_h); i <= i_max; ++i) {
+                ++list->offsets[j*index->number_h+i+1];
+            }
+        }
+    }
+    for (k = 0; k < number_of_cells; ++k) {
+        list->offsets[k+1] += list->offsets[k];
+    }
+    if (!(list->cells = malloc((list->offsets[number_of_cells]+1)*sizeof(int)))
+        || !(cursor = malloc(number_of_cells*sizeof(int)))) {
+        return synctex_NO;
+    }
+    memcpy(cursor,list->offsets,number_of_cells*sizeof(int));
+    for (n = 0; n < list->number; ++n) {
+        synctex_box_p box = list->boxes + n;
+        int i_max = _synctex_edit_index_cell(box->max.h,index->extent.min.h,index->cell_h,index->number_h);
+        int j_max = _synctex_edit_index_cell(box->max.v,index->extent.min.v,index->cell_v,index->number_v);
+        for (j = _synctex_edit_index_cell(box->min.v,index->extent.min.v,index->cell_v,index->number_v); j <= j_max; ++j) {
+            for (i = _synctex_edit_index_cell(box->min.h,index->extent.min.h,index->cell_h,index->number_h); i <= i_max; ++i) {
+                list->cells[cursor[j*index->number_h+i]++] = n;
+            }
+        }
+    }
+    free(cursor);
+    return synctex_YES;
+}
+SYNCTEX_INLINE static void _synctex_edit_index_extend(synctex_edit_index_p index, synctex_edit_list_s * list) {
+    int n;
+    for (n = 0; n < list->number; ++n) {
+        synctex_box_p box = list->boxes + n;
+        if (index->number_h) {
+            if (box->min.h < index->extent.min.h) index->extent.min.h = box->min.h;
+            if (box->max.h > index->extent.max.h) index->extent.max.h = box->max.h;
+            if (box->min.v < index->extent.min.v) index->extent.min.v = box->min.v;
+            if (box->max.v > index->extent.max.v) index->extent.max.v = box->max.v;
+        } else {
+            index->extent = *box;
+            index->number_h = 1;
+        }
+    }
+}
+/*  The returned index is unusable when number_h is 0,
+ *  the edit query then falls back to the full traversal. */
+static synctex_edit_index_p _synctex_edit_index_new(synctex_node_p sheet) {
+    synctex_edit_index_p index = (synctex_edit_index_p)_synctex_malloc(sizeof(struct synctex_edit_index_t));
+    synctex_node_p node = sheet;
+    synctex_box_s box;
+    long long width, height;
+    int number;
+    if (!index) {
+        return NULL;
+    }
+    index->sheet = sheet;
+    while ((node = _synctex_tree_next_hbox(node))) {
+        if (!_synctex_edit_hbox_box(node,&box)
+            || !_synctex_edit_list_add(&index->hboxes,node,box)) {
+            return index;
+        }
+    }
+    if (!_synctex_edit_index_collect(index,sheet)) {
+        return index;
+    }
+    _synctex_edit_index_extend(index,&index->hboxes);
+    _synctex_edit_index_extend(index,&index->leaves);
+    width = (long long)index->extent.max.h - index->extent.min.h;
+    height = (long long)index->extent.max.v - index->extent.min.v;
+    if (width > INT_MAX/2 || height > INT_MAX/2) {
+        index->number_h = 0;
+        return index;
+    }
+    /*  Roughly SYNCTEX_EDIT_INDEX_CELL_LOAD nodes per cell */
+    for (number = 1; number < SYNCTEX_EDIT_INDEX_MAX_CELLS
+         && (number+1)*(number+1)*SYNCTEX_EDIT_INDEX_CELL_LOAD <= index->hboxes.number+index->leaves.number; ++number);
+    index->number_h = index->number_v = number;
+    index->cell_h = (int)(width/number)+1;
+    index->cell_v = (int)(height/number)+1;
+    if (!_synctex_edit_index_fill(index,&index->hboxes)
+        || !_synctex_edit_index_fill(index,&index->leaves)) {
+        index->number_h = 0;
+    }
+    return index;
+}
+/*  The index of the given sheet, built if necessary. */
+static synctex_edit_index_p _synctex_scanner_edit_index(synctex_scanner_p scanner, synctex_node_p sheet) {
+    int page = synctex_node_page(sheet);
+    synctex_edit_index_p index = NULL;
+    if (page < 0) {
+        return NULL;
+    }
+    if (page >= scanner->number_of_edit_indexes) {
+        int number = page < 2*scanner->number_of_edit_indexes? 2*scanner->number_of_edit_indexes: page+1;
+        synctex_edit_index_p * indexes = realloc(scanner->edit_indexes,number*sizeof(synctex_edit_index_p));
+        if (!indexes) {
+            return NULL;
+        }
+        memset(indexes+scanner->number_of_edit_indexes,0,(number-scanner->number_of_edit_indexes)*sizeof(synctex_edit_index_p));
+        scanner->edit_indexes = indexes;
+        scanner->number_of_edit_indexes = number;
+    }
+    if (!(index = scanner->edit_indexes[page]) || index->sheet != sheet) {
+        _synctex_edit_index_free(index);
+        index = scanner->edit_indexes[page] = _synctex_edit_index_new(sheet);
+    }
+    return index && index->number_h? index: NULL;
+}
+/*  Same result as the loop over the hbox list in synctex_iterator_new_edit:
+ *  the smallest hbox containing the hit point, NULL if none. */
+static synctex_node_p _synctex_edit_index_container(synctex_edit_index_p index, synctex_point_p hitP) {
+    synctex_node_p node = NULL;
+    int cell = _synctex_edit_index_cell(hitP->v,index->extent.min.v,index->cell_v,index->number_v)*index->number_h
+        + _synctex_edit_index_cell(hitP->h,index->extent.min.h,index->cell_h,index->number_h);
+    int k;
+    for (k = index->hboxes.offsets[cell]; k < index->hboxes.offsets[cell+1]; ++k) {
+        synctex_node_p next = index->hboxes.nodes[index->hboxes.cells[k]];
+        if (_synctex_point_in_box_v2(hitP,next)) {
+            node = node? _synctex_smallest_container_v2(next,node): next;
+        }
+    }
+    return node;
+}
+/*  Same result as __synctex_closest_deep_child_v2 on the sheet:
+ *  among the closest leaves, the last one which is not a kern,
+ *  otherwise the first kern.
+ *  The cells are visited by rings around the hit point,
+ *  the cells of ring r are at least at distance (r-1)*min(cell_h,cell_v).
+ *  SYNCTEX_ND_0 is returned when all the leaves are at distance INT_MAX. */
+static synctex_nd_s _synctex_edit_index_closest(synctex_edit_index_p index, synctex_point_p hitP) {
+    int ci = _synctex_edit_index_cell(hitP->h,index->extent.min.h,index->cell_h,index->number_h);
+    int cj = _synctex_edit_index_cell(hitP->v,index->extent.min.v,index->cell_v,index->number_v);
+    int step = index->cell_h<index->cell_v? index->cell_h: index->cell_v;
+    int r_max = ci;
+    int distance = INT_MAX;
+    int first_kern = INT_MAX;
+    int last_other = -1;
+    int r, i, j, k;
+    if (r_max < index->number_h-1-ci) r_max = index->number_h-1-ci;
+    if (r_max < cj) r_max = cj;
+    if (r_max < index->number_v-1-cj) r_max = index->number_v-1-cj;
+    for (r = 0; r <= r_max && (r == 0 || (long long)(r-1)*step <= distance); ++r) {
+        for (j = cj-r; j <= cj+r; ++j) {
+            /*  only the first and last rows are full */
+            int di = (j == cj-r || j == cj+r)? 1: 2*r;
+            if (j < 0 || j >= index->number_v) {
+                continue;
+            }
+            for (i = ci-r; i <= ci+r; i += di) {
+                synctex_box_s box;
+                int cell = j*index->number_h+i;
+                if (i < 0 || i >= index->number_h) {
+                    continue;
+                }
+                box.min.h = index->extent.min.h + i*index->cell_h;
+                box.max.h = box.min.h + index->cell_h - 1;
+                box.min.v = index->extent.min.v + j*index->cell_v;
+                box.max.v = box.min.v + index->cell_v - 1;
+                if (_synctex_distance_to_box_v2(hitP,&box) > distance) {
+                    continue;
+                }
+                for (k = index->leaves.offsets[cell]; k < index->leaves.offsets[cell+1]; ++k) {
+                    int n = index->leaves.cells[k];
+                    int d;
+                    if (_synctex_distance_to_box_v2(hitP,index->leaves.boxes+n) > distance) {
+                        continue;
+                    }
+                    if ((d = _synctex_point_node_distance_v2(hitP,index->leaves.nodes[n])) < distance) {
+                        distance = d;
+                        first_kern = INT_MAX;
+                        last_other = -1;
+                    }
+                    if (d == distance && d < INT_MAX) {
+                        if (synctex_node_type(index->leaves.nodes[n]) == synctex_node_type_kern) {
+                            if (n < first_kern) first_kern = n;
+                        } else if (n > last_other) {
+                            last_other = n;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    if (last_other >= 0) {
+        return (synctex_nd_s){index->leaves.nodes[last_other],distance};
+    } else if (first_kern < INT_MAX) {
+        return (synctex_nd_s){index->leaves.nodes[first_kern],distance};
+    }
+    return SYNCTEX_ND_0;
+}
+
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Queries
+#   endif
+
+/**
+ *  iterator for a deep first tree traversal.
+ */
+struct synctex_iterator_t {
+    synctex_node_p seed;
+    synctex_node_p top;
+    synctex_node_p next;
+    int count0;
+    int count;
+    synctex_scanner_p scanner;
+    synctex_arena_p arena;  /*  The query arena owning the handles and the iterator */
+};
+
+/*  The iterator lives in the query arena of the result handles, if any. */
+SYNCTEX_INLINE static synctex_iterator_p _synctex_iterator_new(synctex_node_p result, int count) {
+    synctex_iterator_p iterator;
+    synctex_arena_p arena = result? result->class_->scanner->query_arena: NULL;
+    if ((iterator = arena? _synctex_arena_malloc(arena,sizeof(synctex_iterator_s)): _synctex_malloc(sizeof(synctex_iterator_s)))) {
+        iterator->seed = iterator->top = iterator->next = result;
+        iterator->count0 = iterator->count = count;
+        iterator->arena = arena;
+    }
+    return iterator;
+};
+
+/*  Each query allocates its handles in a query arena,
+ *  which is either recycled at the end of the query when there is no result,
+ *  or owned by the iterator and recycled when the iterator is freed.
+ *  Iterators must be freed before their scanner. */
+static synctex_arena_p _synctex_scanner_begin_query(synctex_scanner_p scanner) {
+    synctex_arena_p arena = scanner->spare_arenas;
+    if (arena) {
+        scanner->spare_arenas = arena->next;
+        arena->next = NULL;
+    } else if (!(arena = (synctex_arena_p)_synctex_malloc(sizeof(synctex_arena_s)))) {
+        return NULL;
+    }
+    return scanner->query_arena = arena;
+}
+static void _synctex_scanner_recycle_arena(synctex_scanner_p scanner, synctex_arena_p arena) {
+    _synctex_arena_reset(arena);
+    arena->next = scanner->spare_arenas;
+    scanner->spare_arenas = arena;
+}
+static synctex_iterator_p _synctex_scanner_end_query(synctex_scanner_p scanner, synctex_iterator_p iterator) {
+    synctex_arena_p arena = scanner->query_arena;
+    scanner->query_arena = NULL;
+    if (iterator && iterator->arena == arena) {
+        iterator->scanner = scanner;
+    } else {
+        _synctex_scanner_recycle_arena(scanner,arena);
+    }
+    return iterator;
+}
+
+void synctex_iterator_free(synctex_iterator_p iterator) {
+    if (iterator) {
+        synctex_node_free(iterator->seed);
+        if (iterator->arena) {
+            /*  iterator itself is in the arena */
+            _synctex_scanner_recycle_arena(iterator->scanner,iterator->arena);
+        } else {
+            _synctex_free(iterator);
+        }
+    }
+}
+synctex_bool_t synctex_iterator_has_next(synctex_iterator_p iterator) {
+    return iterator?iterator->count>0:0;
+}
+int synctex_iterator_count(synctex_iterator_p iterator) {
+    return iterator? iterator->count: 0;
+}
+
+/**
+ *  The next result of the iterator.
+ *  Internally, the iterator stores handles to nodes.
+ *  Externally, it returns the targets,
+ *  such that the caller only sees nodes.
+ */
+synctex_node_p synctex_iterator_next_result(synctex_iterator_p iterator) {
+    if (iterator && iterator->count>0) {
+        synctex_node_p N = iterator->next;
+        if(!(iterator->next = _synctex_tree_child(N))) {
+            iterator->next = iterator->top = __synctex_tree_sibling(iterator->top);
+        }
+        --iterator->count;
+        return _synctex_tree_target(N);
+    }
+    return NULL;
+}
+int synctex_iterator_reset(synctex_iterator_p iterator) {
+    if (iterator) {
+        iterator->next = iterator->top = iterator->seed;
+        return iterator->count = iterator->count0;
+    }
+    return 0;
+}
+
+/*  When indexed is yes, the edit index of the sheet replaces the full traversal,
+ *  with the same result. */
+static synctex_iterator_p __synctex_iterator_new_edit(synctex_scanner_p scanner,int page,float h,float v,synctex_bool_t indexed){
+    if (scanner) {
+        synctex_node_p sheet = NULL;
+        synctex_point_s hit;
+        synctex_node_p node = NULL;
+        synctex_nd_lr_s nds = {{NULL,0},{NULL,0}};
+        synctex_edit_index_p index = NULL;
+        if (NULL == (scanner = synctex_scanner_parse(scanner)) || 0 >= scanner->unit) {/*  scanner->unit must be >0 */
+            return NULL;
+        }
+        /*  Find the proper sheet */
+        sheet = synctex_sheet(scanner,page);
+        if (NULL == sheet) {
+            return NULL;
+        }
+        /*  Now sheet points to the sheet node with proper page number. */
+        /*  Now that scanner has been initialized, we can convert
+         *  the given point to scanner integer coordinates */
+        hit = (synctex_point_s)
+        {(h-scanner->x_offset)/scanner->unit,
+            (v-scanner->y_offset)/scanner->unit};
+        if (indexed) {
+            index = _synctex_scanner_edit_index(scanner,sheet);
+        }
+        /*  At first, we browse all the horizontal boxes of the sheet
+         *  until we find one containing the hit point. */
+        if (index) {
+            node = _synctex_edit_index_container(index,&hit);
+        } else if ((node = _synctex_tree_next_hbox(sheet))) {
+            do {
+                if (_synctex_point_in_box_v2(&hit,node)) {
+                    /*  Maybe the hit point belongs to a contained vertical box.
+                     *  This is the most likely situation.
+                     */
+                    synctex_node_p next = node;
+                    /*  This trick is for catching overlapping boxes */
+                    while ((next = _synctex_tree_next_hbox(next))) {
+                        if (_synctex_point_in_box_v2(&hit,next)) {
+                            node = _synctex_smallest_container_v2(next,node);
+                        }
+                    }
+                    break;
+                }
+            } while ((node = _synctex_tree_next_hbox(node)));
+        }
+        if (node) {
+#if defined(SYNCTEX_DEBUG)
+            printf("--- We are lucky\n");
+#endif
+            /*  node is the smallest horizontal box that contains hit,
+             *  unless there is no hbox at all.
+             */
+            node = _synctex_eq_deepest_container_v2(&hit, node);
+            nds = _synctex_eq_get_closest_children_in_box_v2(&hit, node);
+        } else if ((node = _synctex_tree_child(sheet))) {
+            /*  All the horizontal boxes have been tested,
+             *  None of them contains the hit point.
+             *  We are not lucky,
+             *  we test absolutely all the node
+             *  to find the closest... */
+#if defined(SYNCTEX_DEBUG)
+            printf("--- We are not lucky\n");
+#endif
+            if (!index || !(nds.l = _synctex_edit_index_closest(index,&hit)).node) {
+                nds.l = __synctex_closest_deep_child_v2(&hit, node);
+            }
+#if defined(SYNCTEX_DEBUG)
+            printf("Edit query best: %i\n", nds.l.distance);
+#endif
+        } else {
+            return NULL;
+        }
+        if (nds.r.node && nds.l.node) {
+            if ((_synctex_data_tag(nds.r.node)!=_synctex_data_tag(nds.l.node))
+                || (_synctex_data_line(nds.r.node)!=_synctex_data_line(nds.l.node))
+                || (_synctex_data_column(nds.r.node)!=_synctex_data_column(nds.l.node))) {
+                if (_synctex_data_line(nds.r.node)<_synctex_data_line(nds.l.node)) {
+                    node = nds.r.node;
+                    nds.r.node = nds.l.node;
+                    nds.l.node = node;
+                } else if (_synctex_data_line(nds.r.node)==_synctex_data_line(nds.l.node)) {
+                    if (nds.l.distance>nds.r.distance) {
+                        node = nds.r.node;
+                        nds.r.node = nds.l.node;
+                        nds.l.node = node;
+                    }
+                }
+                if((node = _synctex_new_handle_with_target(nds.l.node))) {
+                    synctex_node_p other_handle;
+                    if((other_handle = _synctex_new_handle_with_target(nds.r.node))) {
+                        _synctex_tree_set_sibling(node,other_handle);
+                        return _synctex_iterator_new(node,2);
+                    }
+                    return _synctex_iterator_new(node,1);
+                }
+                return NULL;
+            }
+            /*  both nodes have the same input coordinates
+             *  We choose the one closest to the hit point  */
+            if (nds.l.distance>nds.r.distance) {
+                nds.l.node = nds.r.node;
+            }
+            nds.r.node = NULL;
+        } else if (nds.r.node) {
+            nds.l = nds.r;
+        } else if (!nds.l.node) {
+            nds.l.node = node;
+        }
+        if((node = _synctex_new_handle_with_target(nds.l.node))) {
+            return _synctex_iterator_new(node,1);
+        }
+        return 0;
+    }
+    return NULL;
+}
+static synctex_iterator_p _synctex_iterator_new_edit(synctex_scanner_p scanner,int page,float h,float v,synctex_bool_t indexed){
+    if ((scanner = synctex_scanner_parse(scanner)) && _synctex_scanner_begin_query(scanner)) {
+        return _synctex_scanner_end_query(scanner,__synctex_iterator_new_edit(scanner,page,h,v,indexed));
+    }
+    return NULL;
+}
+synctex_iterator_p synctex_iterator_new_edit(synctex_scanner_p scanner,int page,float h,float v){
+    return _synctex_iterator_new_edit(scanner,page,h,v,synctex_YES);
+}
+
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Display index
+#   endif
+
+/*  A display query used to browse the whole friend list of the tag and line,
+ *  which also contains the friends of all the other tag and line pairs with the same sum modulo number_of_lists.
+ *  The display index is a hash table from the tag and line to the friends with that tag and line,
+ *  in the friend list order, such that a display query is linear in the number of results.
+ *  It is built at the first display query after the post processing.
+ *  Friends are always registered at the head of the friend lists,
+ *  and a later post processing only registers new friends, for example for a lazily parsed sheet.
+ *  The index remembers the heads of the friend lists to only catch up with the new friends.
+ */
+typedef struct {
+    int tag;
+    int line;
+    int number;
+    int capacity;
+    synctex_node_p * nodes; /*  in reverse friend order, NULL for a free slot */
+} synctex_display_entry_s;
+
+typedef synctex_display_entry_s * synctex_display_entry_p;
+
+struct synctex_display_index_t {
+    synctex_display_entry_p entries;
+    int capacity;   /*  a power of 2 */
+    int number;
+    synctex_node_p * heads;     /*  The heads of the friend lists at the last update */
+    synctex_node_p * stack;     /*  temporary storage */
+    int stack_capacity;
+};
+
+static void _synctex_display_index_free(synctex_display_index_p index) {
+    if (index) {
+        int i = index->capacity;
+        while (i--) {
+            free(index->entries[i].nodes);
+        }
+        free(index->entries);
+        free(index->heads);
+        free(index->stack);
+        _synctex_free(index);
+    }
+}
+SYNCTEX_INLINE static unsigned _synctex_display_index_hash(int tag, int line) {
+    return (unsigned)line*2654435761u+(unsigned)tag*40503u;
+}
+static synctex_display_entry_p _synctex_display_index_find(synctex_display_index_p index, int tag, int line) {
+    unsigned mask = index->capacity-1;
+    unsigned i = _synctex_display_index_hash(tag,line)&mask;
+    synctex_display_entry_p entry;
+    if (!index->entries) {
+        return NULL;
+    }
+    while ((entry = index->entries+i)->nodes) {
+        if (entry->tag == tag && entry->line == line) {
+            return entry;
+        }
+        i = (i+1)&mask;
+    }
+    return NULL;
+}
+/*  The entry with the given tag and line, created if necessary. */
+static synctex_display_entry_p _synctex_display_index_entry(synctex_display_index_p index, int tag, int line) {
+    unsigned mask;
+    unsigned i;
+    synctex_display_entry_p entry;
+    if (2*(index->number+1) > index->capacity) {
+        /*  Keep the load factor below 1/2 */
+        int capacity = index->capacity? 2*index->capacity: 1024;
+        synctex_display_entry_p entries = (synctex_display_entry_p)_synctex_malloc(capacity*sizeof(synctex_display_entry_s));
+        synctex_display_entry_p old = index->entries;
+        int old_capacity = index->capacity;
+        if (!entries) {
+            return NULL;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+        mask = capacity-1;
+        while (old_capacity--) {
+            if ((entry = old+old_capacity)->nodes) {
+                i = _synctex_display_index_hash(entry->tag,entry->line)&mask;
+                while (entries[i].nodes) {
+                    i = (i+1)&mask;
+                }
+                entries[i] = *entry;
+            }
+        }
+        free(old);
+    }
+    mask = index->capacity-1;
+    i = _synctex_display_index_hash(tag,line)&mask;
+    while ((entry = index->entries+i)->nodes) {
+        if (entry->tag == tag && entry->line == line) {
+            return entry;
+        }
+        i = (i+1)&mask;
+    }
+    if (!(entry->nodes = (synctex_node_p *)malloc(4*sizeof(synctex_node_p)))) {
+        return NULL;
+    }
+    entry->tag = tag;
+    entry->line = line;
+    entry->number = 0;
+    entry->capacity = 4;
+    ++index->number;
+    return entry;
+}
+static synctex_bool_t _synctex_display_index_add(synctex_display_index_p index, synctex_node_p node) {
+    synctex_display_entry_p entry = _synctex_display_index_entry(index,synctex_node_tag(node),synctex_node_line(node));
+    if (!entry) {
+        return synctex_NO;
+    }
+    if (entry->number == entry->capacity) {
+        synctex_node_p * nodes = (synctex_node_p *)realloc(entry->nodes,2*entry->capacity*sizeof(synctex_node_p));
+        if (!nodes) {
+            return synctex_NO;
+        }
+        entry->nodes = nodes;
+        entry->capacity *= 2;
+    }
+    entry->nodes[entry->number++] = node;
+    return synctex_YES;
+}
+/*  Add the friends registered since the last update.
+ *  Only the friends a display query may find in the list are considered. */
+static synctex_bool_t _synctex_display_index_update(synctex_scanner_p scanner, synctex_display_index_p index) {
+    int i;
+    for (i = 0; i < scanner->number_of_lists; ++i) {
+        synctex_node_p node = scanner->lists_of_friends[i];
+        int number = 0;
+        while (node != index->heads[i]) {
+            if (!node) {
+                /*  The friend list was not only extended */
+                return synctex_NO;
+            }
+            if (number == index->stack_capacity) {
+                int capacity = index->stack_capacity? 2*index->stack_capacity: 256;
+                synctex_node_p * stack = (synctex_node_p *)realloc(index->stack,capacity*sizeof(synctex_node_p));
+                if (!stack) {
+                    return synctex_NO;
+                }
+                index->stack = stack;
+                index->stack_capacity = capacity;
+            }
+            index->stack[number++] = node;
+            node = _synctex_tree_friend(node);
+        }
+        while (number--) {
+            int tl = synctex_node_tag(index->stack[number])+synctex_node_line(index->stack[number]);
+            if (tl >= 0 && tl%scanner->number_of_lists == i
+                && !_synctex_display_index_add(index,index->stack[number])) {
+                return synctex_NO;
+            }
+        }
+        index->heads[i] = scanner->lists_of_friends[i];
+    }
+    free(index->stack);
+    index->stack = NULL;
+    index->stack_capacity = 0;
+    return synctex_YES;
+}
+/*  The up to date display index of the scanner, NULL on memory problems. */
+static synctex_display_index_p _synctex_scanner_display_index(synctex_scanner_p scanner) {
+    synctex_display_index_p index = scanner->display_index;
+    if (index && !scanner->flags.new_friends) {
+        return index;
+    }
+    scanner->flags.new_friends = 0;
+    if (!index) {
+        if (!(index = (synctex_display_index_p)_synctex_malloc(sizeof(struct synctex_display_index_t)))
+            || !(index->heads = (synctex_node_p *)_synctex_malloc(scanner->number_of_lists*sizeof(synctex_node_p)))) {
+            _synctex_display_index_free(index);
+            return NULL;
+        }
+        scanner->display_index = index;
+    }
+    if (!_synctex_display_index_update(scanner,index)) {
+        _synctex_error("!  _synctex_scanner_display_index: Can't index the friends.");
+        _synctex_display_index_free(index);
+        scanner->display_index = NULL;
+        /*  Try again from scratch at the next query */
+        scanner->flags.new_friends = 1;
+        return NULL;
+    }
+    return index;
+}
+/*  The candidates of a display query,
+ *  either a friend list or an entry of the display index. */
+typedef struct {
+    synctex_node_p friend;  /*  The next friend to test */
+    synctex_node_p * nodes; /*  The display index entry, read backwards */
+    int number;
+    int tag;
+    int line;
+    int column;             /*  only the given column when positive */
+    synctex_bool_t exclude_box;
+} synctex_display_candidates_s;
+
+typedef synctex_display_candidates_s * synctex_display_candidates_p;
+
+/*  The next candidate matching the query. */
+static synctex_node_p _synctex_display_candidates_next(synctex_display_candidates_p candidates) {
+    synctex_node_p target = NULL;
+    if (candidates->nodes) {
+        while (candidates->number>0) {
+            target = candidates->nodes[--candidates->number];
+            if ((candidates->exclude_box
+                 && _synctex_node_is_box(target))
+                || (candidates->column>0
+                    && candidates->column != synctex_node_column(target))) {
+                continue;
+            }
+            return target;
+        }
+        return NULL;
+    }
+    while ((target = candidates->friend)) {
+        candidates->friend = _synctex_tree_friend(target);
+        if ((candidates->exclude_box
+             && _synctex_node_is_box(target))
+            || (candidates->tag != synctex_node_tag(target))
+            || (candidates->line != synctex_node_line(target))
+            || (candidates->column>0
+                && candidates->column != synctex_node_column(target))) {
+            continue;
+        }
+        return target;
+    }
+    return NULL;
+}
+
+/**
+ *  Loop the candidates to find the ones with the proper
+ *  tag and line.
+ *  Returns a tree of results targeting the found candidates.
+ *  At the top level each sibling has its own page number.
+ *  All the results with the same page number are linked by child/parent entry.
+ *  - parameter candidates: a friendly list of candidates or a display index entry
+ */
+static synctex_node_p _synctex_display_query_v2(synctex_display_candidates_p candidates) {
+    synctex_node_p first_handle = NULL;
+    synctex_node_p target = NULL;
+    int page;
+    /*  Search the first match */
+    if (NULL == (target = _synctex_display_candidates_next(candidates))) {
+        return first_handle;
+    }
+    /*  We found a first match, create
+     *  a result handle targeting that candidate. */
+    first_handle = _synctex_new_handle_with_target(target);
+    if (first_handle == NULL) {
+        return first_handle;
+    }
+    /*  target is either a node,
+     *  or a proxy to some node, in which case,
+     *  the target's target belongs to a form,
+     *  not a sheet. */
+    page = synctex_node_page(target);
+    /*  Now create all the other results  */
+    while ((target = _synctex_display_candidates_next(candidates))) {
+        synctex_node_p result = NULL;
+        /*  Another match, same page number ? */
+        result = _synctex_new_handle_with_target(target);
+        if (NULL == result ) {
+            return first_handle;
+        }
+        /*  is it the same page number ? */
+        if (synctex_node_page(target) == page) {
+            __synctex_tree_set_child(result, first_handle);
+            first_handle = result;
+        } else {
+            /*  We have 2 page numbers involved */
+            __synctex_tree_set_sibling(first_handle, result);
+            while ((target = _synctex_display_candidates_next(candidates))) {
+                synctex_node_p same_page_node;
+                /*  New match found, which page? */
+                result = _synctex_new_handle_with_target(target);
+                if (NULL == result) {
+                    return first_handle;
+                }
+                same_page_node = first_handle;
+                page = synctex_node_page(target);
+                /*  Find a result with the same page number */;
+                do {
+                    if (_synctex_node_target_page(same_page_node) == page) {
+                        /* Insert result between same_page_node and its child */
+                        _synctex_tree_set_child(result,_synctex_tree_set_child(same_page_node,result));
+                    } else if ((same_page_node = __synctex_tree_sibling(same_page_node))) {
+                        continue;
+                    } else {
+                        /*  This is a new page number */
+                        __synctex_tree_set_sibling(result,first_handle);
+                        first_handle = result;
+                    }
+                    break;
+                } while (synctex_YES);
+            }
+            return first_handle;
+        }
+    }
+    return first_handle;
+}
+/*  When indexed is yes, the display index of the scanner replaces the friend lists,
+ *  with the same result. */
+static synctex_iterator_p __synctex_iterator_new_display_tag(synctex_scanner_p scanner,int tag,int line,int column, int page_hint, synctex_bool_t indexed) {
+    if (scanner && tag>0) {
+        int max_line = 0;
+        int line_offset = 1;
+        int try_count = 100;
+        synctex_node_p node = NULL;
+        synctex_node_p result = NULL;
+        node = synctex_scanner_input_with_tag(scanner, tag);
+        if (_synctex_data_tag(node) != tag) {
+            return NULL;
+        }
+        max_line = _synctex_data_line(node);
+        /*  node = NULL; */
+        if (line>max_line) {
+            line = max_line;
+        }
+        while(try_count--) {
+            if (line<=max_line) {
+                /*  This loop will only be performed once for advanced viewers */
+                synctex_display_candidates_s candidates = {NULL,NULL,0,tag,line,0,synctex_YES};
+                synctex_display_index_p index = NULL;
+                if (scanner->lazy) {
+                    _synctex_lazy_parse_line(scanner,tag,line);
+                }
+                if (indexed && (index = _synctex_scanner_display_index(scanner))) {
+                    synctex_display_entry_p entry = _synctex_display_index_find(index,tag,line);
+                    if (entry) {
+                        candidates.nodes = entry->nodes;
+                        candidates.number = entry->number;
+                    }
+                } else {
+                    candidates.friend = _synctex_scanner_friend(scanner,tag+line);
+                }
+                if (candidates.friend || candidates.nodes) {
+                    synctex_display_candidates_s all = candidates;
+                    if (column>0) {
+                        /*  Only the given column, if any */
+                        synctex_display_candidates_s probe = candidates;
+                        probe.exclude_box = synctex_NO;
+                        probe.column = column;
+                        if (_synctex_display_candidates_next(&probe)) {
+                            all.column = candidates.column = column;
+                        }
+                    }
+                    result = _synctex_display_query_v2(&candidates);
+                    if (!result) {
+                        /*  We did not find any matching boundary, retry including boxes */
+                        all.exclude_box = synctex_NO;
+                        result = _synctex_display_query_v2(&all);
+                    }
+                    /*  Now reverse the order to have nodes in display order, and then keep just a few nodes.
+                     *  Order first the best node. */
+                    /*  The result is a tree. At the root level, all nodes
+                     *  correspond to different page numbers.
+                     *  Each node has a child which corresponds to the same
+                     *  page number if relevant.
+                     *  Then reorder the nodes to put first the one which fits best.
+                     *  The idea is to count the number of nodes
+                     *  with the same tag and line number in the parents
+                     *  and choose the ones with the biggest count.
+                     */
+                    if (result) {
+                        /*  navigate through siblings, then children   */
+                        synctex_node_p next_sibling = __synctex_tree_reset_sibling(result);
+                        int best_match = abs(page_hint-_synctex_node_target_page(result));
+                        synctex_node_p sibling;
+                        int match;
+                        synctex_counted_node_s cn = _synctex_vertically_sorted_v2(result);
+                        int count = cn.count;
+                        result = cn.node;
+                        while((sibling = next_sibling)) {
+                            /* What is next? Do not miss that step! */
+                            next_sibling = __synctex_tree_reset_sibling(sibling);
+                            cn = _synctex_vertically_sorted_v2(sibling);
+                            count += cn.count;
+                            sibling = cn.node;
+                            match = abs(page_hint-_synctex_node_target_page(sibling));
+                            if (match<best_match) {
+                                /*  Order this node first */
+                                __synctex_tree_set_sibling(sibling,result);
+                                result = sibling;
+                                best_match = match;
+                            } else /*if (match>=best_match)*/ {
+                                __synctex_tree_set_sibling(sibling,__synctex_tree_sibling(result));
+                                __synctex_tree_set_sibling(result,sibling);
+                            }
+                        }
+                        return _synctex_iterator_new(result,count);
+                    }
+                }
+#       if defined(__SYNCTEX_STRONG_DISPLAY_QUERY__)
+                break;
+#       else
+                line += line_offset;
+                line_offset=line_offset<0?-(line_offset-1):-(line_offset+1);
+                if (line <= 0) {
+                    line += line_offset;
+                    line_offset=line_offset<0?-(line_offset-1):-(line_offset+1);
+                }
+#       endif
+            }
+        }
+    }
+    return NULL;
+}
+static synctex_iterator_p __synctex_iterator_new_display(synctex_scanner_p scanner,const char * name,int line,int column, int page_hint, synctex_bool_t indexed) {
+    if (scanner) {
+        int tag = synctex_scanner_get_tag(scanner,name);/* parse if necessary */
+        if (tag == 0) {
+            printf("SyncTeX Warning: No tag for %s\n",name);
+            return NULL;
+        }
+        return __synctex_iterator_new_display_tag(scanner,tag,line,column,page_hint,indexed);
+    }
+    return NULL;
+}
+static synctex_iterator_p _synctex_iterator_new_display(synctex_scanner_p scanner,const char * name,int line,int column, int page_hint, synctex_bool_t indexed) {
+    if ((scanner = synctex_scanner_parse(scanner)) && _synctex_scanner_begin_query(scanner)) {
+        return _synctex_scanner_end_query(scanner,__synctex_iterator_new_display(scanner,name,line,column,page_hint,indexed));
+    }
+    return NULL;
+}
+synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner,const char * name,int line,int column, int page_hint) {
+    return _synctex_iterator_new_display(scanner,name,line,column,page_hint,synctex_YES);
+}
+synctex_status_t synctex_display_query(synctex_scanner_p scanner,const char *  name,int line,int column, int page_hint) {
+    if (scanner) {
+        synctex_iterator_free(scanner->iterator);
+        scanner->iterator = synctex_iterator_new_display(scanner, name,line,column, page_hint);
+        return synctex_iterator_count(scanner->iterator);
+    }
+    return SYNCTEX_STATUS_ERROR;
+}
+synctex_iterator_p synctex_iterator_new_display_tag(synctex_scanner_p scanner,int tag,int line,int column, int page_hint) {
+    if ((scanner = synctex_scanner_parse(scanner)) && _synctex_scanner_begin_query(scanner)) {
+        return _synctex_scanner_end_query(scanner,__synctex_iterator_new_display_tag(scanner,tag,line,column,page_hint,synctex_YES));
+    }
+    return NULL;
+}
+synctex_status_t synctex_display_query_tag(synctex_scanner_p scanner,int tag,int line,int column, int page_hint) {
+    if (scanner) {
+        synctex_iterator_free(scanner->iterator);
+        scanner->iterator = synctex_iterator_new_display_tag(scanner,tag,line,column,page_hint);
+        return synctex_iterator_count(scanner->iterator);
+    }
+    return SYNCTEX_STATUS_ERROR;
+}
+synctex_status_t synctex_edit_query(synctex_scanner_p scanner,int page,float h,float v) {
+    if (scanner) {
+        synctex_iterator_free(scanner->iterator);
+        scanner->iterator = synctex_iterator_new_edit(scanner, page, h, v);
+        return synctex_iterator_count(scanner->iterator);
+    }
+    return SYNCTEX_STATUS_ERROR;
+}
+/**
+ *  The next result of a query.
+ */
+synctex_node_p synctex_scanner_next_result(synctex_scanner_p scanner) {
+    return scanner? synctex_iterator_next_result(scanner->iterator): NULL;
+}
+synctex_status_t synctex_scanner_reset_result(synctex_scanner_p scanner) {
+    return scanner? synctex_iterator_reset(scanner->iterator): SYNCTEX_STATUS_ERROR;
+}
+
+synctex_node_p synctex_node_target(synctex_node_p node) {
+    return _synctex_tree_target(node);
+}
+
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Batch display queries
+#   endif
+
+/*  A batch of display queries visits each sheet once instead of walking
+ *  the friend lists once per line. Each node with a requested tag and line
+ *  contributes its visible box, the boxes are merged by request, line and page. */
+#   if defined(SYNCTEX_USE_THREADED_DISPLAY_BATCH) && !defined(SYNCTEX_DISPLAY_BATCH_MAX_THREADS)
+#       define SYNCTEX_DISPLAY_BATCH_MAX_THREADS 8
+#   endif
+/*  A request sorted by tag and line. */
+typedef struct {
+    int tag;
+    int line;
+    int request;
+} synctex_batch_key_s;
+/*  The union of the visible boxes of the nodes of a request line in a page.
+ *  box is yes for boxes, which only count when the line has no other node,
+ *  like in a display query. */
+typedef struct {
+    int request;
+    int line;
+    int page;
+    synctex_bool_t box;
+    float left, top, right, bottom;
+} synctex_batch_hit_s;
+typedef struct {
+    synctex_node_p node;
+    synctex_batch_hit_s * hits;
+    int count;
+    int capacity;
+    synctex_bool_t failed;
+    synctex_bool_t deferred;    /*  some proxy children are not yet created */
+} synctex_batch_sheet_s;
+typedef struct {
+    synctex_batch_key_s * keys;
+    int number_of_keys;
+    synctex_batch_sheet_s * sheets;
+    int number_of_sheets;
+    int next;
+#   if defined(SYNCTEX_USE_THREADED_DISPLAY_BATCH)
+    pthread_mutex_t mutex;
+#   endif
+} synctex_batch_pool_s;
+struct synctex_display_batch_t {
+    synctex_display_result_s * results;
+    int count;
+};
+
+static int _synctex_batch_key_compare(const void * l, const void * r) {
+    const synctex_batch_key_s * L = (const synctex_batch_key_s *)l;
+    const synctex_batch_key_s * R = (const synctex_batch_key_s *)r;
+    if (L->tag != R->tag) {
+        return L->tag<R->tag? -1: 1;
+    }
+    if (L->line != R->line) {
+        return L->line<R->line? -1: 1;
+    }
+    return L->request<R->request? -1: L->request>R->request;
+}
+/*  By request, line and page, the other nodes before the boxes. */
+static int _synctex_batch_hit_compare(const void * l, const void * r) {
+    const synctex_batch_hit_s * L = (const synctex_batch_hit_s *)l;
+    const synctex_batch_hit_s * R = (const synctex_batch_hit_s *)r;
+    if (L->request != R->request) {
+        return L->request<R->request? -1: 1;
+    }
+    if (L->line != R->line) {
+        return L->line<R->line? -1: 1;
+    }
+    if (L->page != R->page) {
+        return L->page<R->page? -1: 1;
+    }
+    return (int)L->box-(int)R->box;
+}
+/*  The index of the first key with the given tag and line. */
+static int _synctex_batch_lower_bound(synctex_batch_pool_s * pool, int tag, int line) {
+    int lo = 0, hi = pool->number_of_keys;
+    while (lo<hi) {
+        int mid = lo+(hi-lo)/2;
+        synctex_batch_key_s * key = pool->keys+mid;
+        if (key->tag<tag || (key->tag == tag && key->line<line)) {
+            lo = mid+1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+/*  Merge the hits with the same request, line, page and box flag, in place.
+ *  - returns: the new number of hits. */
+static int _synctex_batch_coalesce(synctex_batch_hit_s * hits, int count) {
+    int i, n = 0;
+    if (count<2) {
+        return count;
+    }
+    qsort(hits,count,sizeof(synctex_batch_hit_s),&_synctex_batch_hit_compare);
+    for (i=1;i<count;++i) {
+        synctex_batch_hit_s * last = hits+n;
+        synctex_batch_hit_s * hit = hits+i;
+        if (hit->request == last->request && hit->line == last->line
+            && hit->page == last->page && hit->box == last->box) {
+            last->left = hit->left<last->left? hit->left: last->left;
+            last->top = hit->top<last->top? hit->top: last->top;
+            last->right = hit->right>last->right? hit->right: last->right;
+            last->bottom = hit->bottom>last->bottom? hit->bottom: last->bottom;
+        } else {
+            hits[++n] = *hit;
+        }
+    }
+    return n+1;
+}
+/*  Add a hit for each request matching the tag and line of node. */
+static synctex_bool_t _synctex_batch_add_node(synctex_batch_pool_s * pool, synctex_batch_sheet_s * sheet, synctex_node_p node, int page) {
+    int tag = synctex_node_tag(node);
+    int line = synctex_node_line(node);
+    synctex_batch_hit_s hit;
+    synctex_node_p box = NULL;
+    int j;
+    if (tag<=0 || line<0) {
+        return synctex_YES;
+    }
+    /*  Only the nodes a display query may find in the friend lists:
+     *  the box boundary stands for its h box and only void v boxes are friends. */
+    if ((synctex_node_type(node) == synctex_node_type_hbox
+         || synctex_node_type(node) == synctex_node_type_vbox)
+        && _synctex_tree_child(node)) {
+        return synctex_YES;
+    }
+    /*  The requests for this line, then the requests for all the lines. */
+    for (j=0;j<(line? 2: 1);++j) {
+        int probe = j? 0: line;
+        int i = _synctex_batch_lower_bound(pool,tag,probe);
+        for (;i<pool->number_of_keys && pool->keys[i].tag == tag && pool->keys[i].line == probe;++i) {
+            if (NULL == box) {
+                float h, v;
+                if (NULL == (box = _synctex_node_box_visible(node))) {
+                    return synctex_YES;
+                }
+                h = SYNCTEX_VISIBLE_DISTANCE_h(node,_synctex_node_h_V(box));
+                v = SYNCTEX_VISIBLE_DISTANCE_v(node,_synctex_node_v_V(box));
+                hit.line = line;
+                hit.page = page;
+                hit.box = _synctex_node_is_box(node);
+                hit.left = h;
+                hit.right = h+SYNCTEX_VISIBLE_SIZE(node,_synctex_node_width_V(box));
+                hit.top = v-SYNCTEX_VISIBLE_SIZE(node,_synctex_node_height_V(box));
+                hit.bottom = v+SYNCTEX_VISIBLE_SIZE(node,_synctex_node_depth_V(box));
+            }
+            if (sheet->count == sheet->capacity) {
+                int capacity = sheet->capacity? 2*sheet->capacity: 64;
+                synctex_batch_hit_s * hits = (synctex_batch_hit_s *)realloc(sheet->hits,capacity*sizeof(synctex_batch_hit_s));
+                if (NULL == hits) {
+                    return synctex_NO;
+                }
+                sheet->hits = hits;
+                sheet->capacity = capacity;
+            }
+            hit.request = pool->keys[i].request;
+            sheet->hits[sheet->count++] = hit;
+        }
+    }
+    return synctex_YES;
+}
+/*  Whether synctex_node_child would create the children of node. */
+static synctex_bool_t _synctex_batch_has_lazy_children(synctex_node_p node) {
+    if (_synctex_tree_child(node)) {
+        return synctex_NO;
+    }
+    while ((node = _synctex_tree_target(node))) {
+        if (_synctex_tree_child(node)) {
+            return synctex_YES;
+        }
+    }
+    return synctex_NO;
+}
+/*  Visit all the nodes of the sheet.
+ *  When not serial, the tree is left unchanged such that the sheets can be visited concurrently,
+ *  the sheet is deferred if some proxy children have not been created yet. */
+static void _synctex_batch_visit_sheet(synctex_batch_pool_s * pool, synctex_batch_sheet_s * sheet, synctex_bool_t serial) {
+    synctex_node_p node = _synctex_tree_child(sheet->node);
+    int page = _synctex_data_page(sheet->node);
+    sheet->count = 0;
+    while (node) {
+        synctex_node_p next = NULL;
+        if (!_synctex_batch_add_node(pool,sheet,node,page)) {
+            sheet->failed = synctex_YES;
+            return;
+        }
+        if (serial) {
+            next = synctex_node_child(node);
+        } else if (_synctex_batch_has_lazy_children(node)) {
+            sheet->deferred = synctex_YES;
+            return;
+        } else {
+            next = _synctex_tree_child(node);
+        }
+        if (NULL == next) {
+            while (NULL == (next = __synctex_tree_sibling(node))
+                   && (node = _synctex_tree_parent(node)) && node != sheet->node) {
+                /*  up to the first ancestor with a next sibling */
+            }
+        }
+        node = next;
+    }
+    sheet->count = _synctex_batch_coalesce(sheet->hits,sheet->count);
+}
+static void * _synctex_batch_worker(void * arg) {
+    synctex_batch_pool_s * pool = (synctex_batch_pool_s *)arg;
+    for (;;) {
+        int i;
+#   if defined(SYNCTEX_USE_THREADED_DISPLAY_BATCH)
+        pthread_mutex_lock(&pool->mutex);
+        i = pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+#   else
+        i = pool->next++;
+#   endif
+        if (i >= pool->number_of_sheets) {
+            return NULL;
+        }
+        _synctex_batch_visit_sheet(pool,pool->sheets+i,synctex_NO);
+    }
+}
+/*  Visit all the sheets, concurrently if possible, then the deferred ones serially. */
+static synctex_bool_t _synctex_batch_visit(synctex_batch_pool_s * pool) {
+    int i;
+#   if defined(SYNCTEX_USE_THREADED_DISPLAY_BATCH)
+    pthread_t threads[SYNCTEX_DISPLAY_BATCH_MAX_THREADS];
+    long number_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int number_of_threads = number_of_cpus<1? 1:
+        (number_of_cpus>SYNCTEX_DISPLAY_BATCH_MAX_THREADS? SYNCTEX_DISPLAY_BATCH_MAX_THREADS: (int)number_of_cpus);
+    int number_of_workers = 0;
+    /*  The current thread is also a worker. */
+    pthread_mutex_init(&pool->mutex,NULL);
+    while (number_of_workers<number_of_threads-1 && number_of_workers<pool->number_of_sheets-1
+           && !pthread_create(threads+number_of_workers,NULL,&_synctex_batch_worker,pool)) {
+        ++number_of_workers;
+    }
+    _synctex_batch_worker(pool);
+    for (i=0;i<number_of_workers;++i) {
+        pthread_join(threads[i],NULL);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+#   else
+    _synctex_batch_worker(pool);
+#   endif
+    for (i=0;i<pool->number_of_sheets;++i) {
+        synctex_batch_sheet_s * sheet = pool->sheets+i;
+        if (sheet->deferred && !sheet->failed) {
+            _synctex_batch_visit_sheet(pool,sheet,synctex_YES);
+        }
+        if (sheet->failed) {
+            return synctex_NO;
+        }
+    }
+    return synctex_YES;
+}
+/*  Gather the hits of all the sheets into the results of the batch.
+ *  The boxes of a request line are dropped when the line has other nodes. */
+static synctex_bool_t _synctex_batch_gather(synctex_batch_pool_s * pool, synctex_display_batch_p batch) {
+    synctex_batch_hit_s * hits = NULL;
+    int count = 0;
+    int i, j;
+    for (i=0;i<pool->number_of_sheets;++i) {
+        count += pool->sheets[i].count;
+    }
+    if (count == 0) {
+        return synctex_YES;
+    }
+    if (NULL == (hits = (synctex_batch_hit_s *)malloc(count*sizeof(synctex_batch_hit_s)))
+        || NULL == (batch->results = (synctex_display_result_s *)malloc(count*sizeof(synctex_display_result_s)))) {
+        free(hits);
+        return synctex_NO;
+    }
+    for (count=i=0;i<pool->number_of_sheets;++i) {
+        memcpy(hits+count,pool->sheets[i].hits,pool->sheets[i].count*sizeof(synctex_batch_hit_s));
+        count += pool->sheets[i].count;
+    }
+    qsort(hits,count,sizeof(synctex_batch_hit_s),&_synctex_batch_hit_compare);
+    for (i=0;i<count;i=j) {
+        synctex_bool_t only_boxes = synctex_YES;
+        for (j=i;j<count && hits[j].request == hits[i].request && hits[j].line == hits[i].line;++j) {
+            only_boxes = only_boxes && hits[j].box;
+        }
+        for (;i<j;++i) {
+            synctex_batch_hit_s * hit = hits+i;
+            if (only_boxes || !hit->box) {
+                batch->results[batch->count++] = (synctex_display_result_s){
+                    hit->request,hit->line,hit->page,
+                    hit->left,hit->top,hit->right-hit->left,hit->bottom-hit->top};
+            }
+        }
+    }
+    free(hits);
+    return synctex_YES;
+}
+synctex_display_batch_p synctex_display_batch_new(synctex_scanner_p scanner, const synctex_display_request_s * requests, int number_of_requests) {
+    synctex_display_batch_p batch = NULL;
+    synctex_batch_pool_s pool;
+    synctex_node_p sheet = NULL;
+    synctex_bool_t ok = synctex_NO;
+    int i;
+    if (NULL == (scanner = synctex_scanner_parse(scanner))
+        || number_of_requests<0 || (number_of_requests>0 && NULL == requests)
+        || NULL == (batch = (synctex_display_batch_p)_synctex_malloc(sizeof(struct synctex_display_batch_t)))) {
+        return NULL;
+    }
+    memset(&pool,0,sizeof(pool));
+    if (number_of_requests && NULL == (pool.keys = (synctex_batch_key_s *)malloc(number_of_requests*sizeof(synctex_batch_key_s)))) {
+        goto bail;
+    }
+    for (i=0;i<number_of_requests;++i) {
+        if (requests[i].tag>0 && requests[i].line>=0) {
+            pool.keys[pool.number_of_keys++] = (synctex_batch_key_s){requests[i].tag,requests[i].line,i};
+        }
+    }
+    if (pool.number_of_keys == 0) {
+        ok = synctex_YES;
+        goto bail;
+    }
+    qsort(pool.keys,pool.number_of_keys,sizeof(synctex_batch_key_s),&_synctex_batch_key_compare);
+    if (scanner->lazy) {
+        /*  The keys for all the lines of an input come first. */
+        for (i=0;i<pool.number_of_keys;++i) {
+            synctex_batch_key_s * key = pool.keys+i;
+            if (i == 0 || key->tag != key[-1].tag || (key[-1].line && key->line != key[-1].line)) {
+                _synctex_lazy_parse_line(scanner,key->tag,key->line);
+            }
+        }
+    }
+    for (sheet = scanner->sheet;sheet;sheet = __synctex_tree_sibling(sheet)) {
+        ++pool.number_of_sheets;
+    }
+    if (pool.number_of_sheets && NULL == (pool.sheets = (synctex_batch_sheet_s *)_synctex_malloc(pool.number_of_sheets*sizeof(synctex_batch_sheet_s)))) {
+        goto bail;
+    }
+    for (i=0,sheet = scanner->sheet;sheet;sheet = __synctex_tree_sibling(sheet)) {
+        pool.sheets[i++].node = sheet;
+    }
+    ok = _synctex_batch_visit(&pool) && _synctex_batch_gather(&pool,batch);
+bail:
+    for (i=0;i<pool.number_of_sheets;++i) {
+        free(pool.sheets[i].hits);
+    }
+    _synctex_free(pool.sheets);
+    free(pool.keys);
+    if (!ok) {
+        _synctex_error("!  synctex_display_batch_new: Memory problem.");
+        synctex_display_batch_free(batch);
+        return NULL;
+    }
+    return batch;
+}
+int synctex_display_batch_count(synctex_display_batch_p batch) {
+    return batch? batch->count: 0;
+}
+const synctex_display_result_s * synctex_display_batch_results(synctex_display_batch_p batch) {
+    return batch? batch->results: NULL;
+}
+void synctex_display_batch_free(synctex_display_batch_p batch) {
+    if (batch) {
+        free(batch->results);
+        _synctex_free(batch);
+    }
+}
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Geometric utilities
+#   endif
+
+/** Rougly speaking, this is:
+ *  node's h coordinate - hit point's h coordinate.
+ *  If node is to the right of the hit point, then this distance is positive,
+ *  if node is to the left of the hit point, this distance is negative.
+ *  If the argument is a pdf form reference, then the child is used and returned instead.
+ *  Last Revision: Mon Apr 24 07:05:27 UTC 2017
+ */
+static synctex_nd_s _synctex_point_h_ordered_distance_v2
+(synctex_point_p hit, synctex_node_p node) {
+    synctex_nd_s nd = {node,INT_MAX};
+    if (node) {
+        int min,med,max,width;
+        switch(synctex_node_type(node)) {
+                /*  The distance between a point and a box is special.
+                 *  It is not the euclidian distance, nor something similar.
+                 *  We have to take into account the particular layout,
+                 *  and the box hierarchy.
+                 *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
+                 *  The origin being at the top left corner of the page,
+                 *  we also give names to the vertices of the box.
+                 *
+                 *   1 | 2 | 3
+                 *  ---A---B--->
+                 *   4 | 5 | 6
+                 *  ---C---D--->
+                 *   7 | 8 | 9
+                 *     v   v
+                 */
+            case synctex_node_type_vbox:
+            case synctex_node_type_void_vbox:
+            case synctex_node_type_void_hbox:
+                /*  getting the box bounds, taking into account negative width, height and depth. */
+                width = _synctex_data_width(node);
+                min = _synctex_data_h(node);
+                max = min + (width>0?width:-width);
+                /*  We always have min <= max */
+                if (hit->h<min) {
+                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
+                } else if (hit->h>max) {
+                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
+                } else {
+                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
+                }
+                break;
+            case synctex_node_type_proxy_vbox:
+                /*  getting the box bounds, taking into account negative width, height and depth. */
+                width = synctex_node_width(node);
+                min = synctex_node_h(node);
+                max = min + (width>0?width:-width);
+                /*  We always have min <= max */
+                if (hit->h<min) {
+                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
+                } else if (hit->h>max) {
+                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
+                } else {
+                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
+                }
+                break;
+            case synctex_node_type_hbox:
+            case synctex_node_type_proxy_hbox:
+                /*  getting the box bounds, taking into account negative width, height and depth. */
+                width = synctex_node_hbox_width(node);
+                min = synctex_node_hbox_h(node);
+                max = min + (width>0?width:-width);
+                /*  We always have min <= max */
+                if (hit->h<min) {
+                    nd.distance = min - hit->h; /*  regions 1+4+7, result is > 0 */
+                } else if (hit->h>max) {
+                    nd.distance = max - hit->h; /*  regions 3+6+9, result is < 0 */
+                } else {
+                    nd.distance = 0; /*  regions 2+5+8, inside the box, except for vertical coordinates */
+                }
+                break;
+            case synctex_node_type_kern:
+                /*  IMPORTANT NOTICE: the location of the kern is recorded AFTER the move.
+                 *  The distance to the kern is very special,
+                 *  in general, there is no text material in the kern,
+                 *  this is why we compute the offset relative to the closest edge of the kern.*/
+                max = _synctex_data_width(node);
+                if (max<0) {
+                    min = _synctex_data_h(node);
+                    max = min - max;
+                } else {
+                    min = -max;
+                    max = _synctex_data_h(node);
+                    min += max;
+                }
+                med = (min+max)/2;
+                /*  positive kern: '.' means text, '>' means kern offset
+                 *      .............
+                 *                   min>>>>med>>>>max
+                 *                                    ...............
+                 *  negative kern: '.' means text, '<' means kern offset
+                 *      ............................
+                 *                 min<<<<med<<<<max
+                 *                 .................................
+                 *  Actually, we do not take into account negative widths.
+                 *  There is a problem for such situation when there is effectively overlapping text.
+                 *  But this should be extremely rare. I guess that in that case, many different choices
+                 *  could be made, one being in contradiction with the other.
+                 *  It means that the best choice should be made according to the situation that occurs
+                 *  most frequently.
+                 */
+                if (hit->h<min) {
+                    nd.distance = min - hit->h + 1; /*  penalty to ensure other nodes are chosen first in case of overlapping ones */
+                } else if (hit->h>max) {
+                    nd.distance = max - hit->h - 1; /*  same kind of penalty */
+                } else if (hit->h>med) {
+                    /*  do things like if the node had 0 width and was placed at the max edge + 1*/
+                    nd.distance = max - hit->h + 1; /*  positive, the kern is to the right of the hit point */
+                } else {
+                    nd.distance = min - hit->h - 1; /*  negative, the kern is to the left of the hit point */
+                }
+                break;
+            case synctex_node_type_rule:/* to do: special management */
+            case synctex_node_type_glue:
+            case synctex_node_type_math:
+            case synctex_node_type_boundary:
+            case synctex_node_type_box_bdry:
+                nd.distance = _synctex_data_h(node) - hit->h;
+                break;
+            case synctex_node_type_ref:
+                nd.node = synctex_node_child(node);
+                nd = _synctex_point_h_ordered_distance_v2(hit,nd.node);
+                break;
+            case synctex_node_type_proxy:
+            case synctex_node_type_proxy_last:
+            {
+                /* shift the hit point to be relative to the proxy origin,
+                 *  then compute the distance to the target
+                 */
+                synctex_point_s otherHit = *hit;
+                otherHit.h -= _synctex_data_h(node);
+                otherHit.v -= _synctex_data_v(node);
+                nd.node = _synctex_tree_target(node);
+                nd = _synctex_point_h_ordered_distance_v2(&otherHit,nd.node);
+                nd.node = node;
+            }
+            default:
+                break;
+        }
+    }
+    return nd;
+}
+/** Rougly speaking, this is:
+ *  node's v coordinate - hit point's v coordinate.
+ *  If node is at the top of the hit point, then this distance is positive,
+ *  if node is at the bottom of the hit point, this distance is negative.
+ */
+static synctex_nd_s _synctex_point_v_ordered_distance_v2
+(synctex_point_p hit, synctex_node_p node) {
+    synctex_nd_s nd = {node, INT_MAX};
+    int min,max,depth,height;
+    switch(synctex_node_type(node)) {
+            /*  The distance between a point and a box is special.
+             *  It is not the euclidian distance, nor something similar.
+             *  We have to take into account the particular layout,
+             *  and the box hierarchy.
+             *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
+             *  The origin being at the top left corner of the page,
+             *  we also give names to the vertices of the box.
+             *
+             *   1 | 2 | 3
+             *  ---A---B--->
+             *   4 | 5 | 6
+             *  ---C---D--->
+             *   7 | 8 | 9
+             *     v   v
+             */
+        case synctex_node_type_vbox:
+        case synctex_node_type_void_vbox:
+        case synctex_node_type_void_hbox:
+            /*  getting the box bounds, taking into account negative width, height and depth. */
+            min = synctex_node_v(node);
+            max = min + _synctex_abs(_synctex_data_depth(node));
+            min -= _synctex_abs(_synctex_data_height(node));
+            /*  We always have min <= max */
+            if (hit->v<min) {
+                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
+            } else if (hit->v>max) {
+                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
+            } else {
+                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
+            }
+            break;
+        case synctex_node_type_proxy_vbox:
+            /*  getting the box bounds, taking into account negative width, height and depth. */
+            min = synctex_node_v(node);
+            max = min + _synctex_abs(synctex_node_depth(node));
+            min -= _synctex_abs(synctex_node_height(node));
+            /*  We always have min <= max */
+            if (hit->v<min) {
+                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
+            } else if (hit->v>max) {
+                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
+            } else {
+                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
+            }
+            break;
+        case synctex_node_type_hbox:
+        case synctex_node_type_proxy_hbox:
+            /*  getting the box bounds, taking into account negative height and depth. */
+            min = synctex_node_hbox_v(node);
+            depth = synctex_node_hbox_depth(node);
+            max = min + (depth>0?depth:-depth);
+            height = synctex_node_hbox_height(node);
+            min -= (height>0?height:-height);
+            /*  We always have min <= max */
+            if (hit->v<min) {
+                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
+            } else if (hit->v>max) {
+                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
+            } else {
+                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
+            }
+            break;
+        case synctex_node_type_rule:/* to do: special management */
+        case synctex_node_type_kern:
+        case synctex_node_type_glue:
+        case synctex_node_type_math:
+            min = _synctex_data_v(node);
+            max = min + _synctex_abs(_synctex_data_depth(_synctex_tree_parent(node)));
+            min -= _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
+            /*  We always have min <= max */
+            if (hit->v<min) {
+                nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
+            } else if (hit->v>max) {
+                nd.distance = max - hit->v; /*  regions 7+8+9, result is < 0 */
+            } else {
+                nd.distance = 0; /*  regions 4.5.6, inside the box, except for horizontal coordinates */
+            }
+            break;
+        case synctex_node_type_ref:
+            nd.node = synctex_node_child(node);
+            nd = _synctex_point_v_ordered_distance_v2(hit,nd.node);
+            break;
+        case synctex_node_type_proxy:
+        case synctex_node_type_proxy_last:
+        {
+            synctex_point_s otherHit = *hit;
+            otherHit.h -= _synctex_data_h(node);
+            otherHit.v -= _synctex_data_v(node);
+            nd.node = _synctex_tree_target(node);
+            nd = _synctex_point_v_ordered_distance_v2(&otherHit,nd.node);
+            nd.node = node;
+        }
+        default: break;
+    }
+    return nd;
+}
+/**
+ *  The best is the one with the smallest area.
+ *  The area is width*height where width and height may be big.
+ *  So there is a real risk of overflow if we stick with ints.
+ */
+SYNCTEX_INLINE static synctex_node_p _synctex_smallest_container_v2(synctex_node_p node, synctex_node_p other_node) {
+    long total_height, other_total_height;
+    unsigned long area, other_area;
+    long width = synctex_node_hbox_width(node);
+    long other_width = synctex_node_hbox_width(other_node);
+    if (width<0) {
+        width = -width;
+    }
+    if (other_width<0) {
+        other_width = -other_width;
+    }
+    total_height = _synctex_abs(synctex_node_hbox_depth(node)) + _synctex_abs(synctex_node_hbox_height(node));
+    other_total_height = _synctex_abs(synctex_node_hbox_depth(other_node)) + _synctex_abs(synctex_node_hbox_height(other_node));
+    area = total_height*width;
+    other_area = other_total_height*other_width;
+    if (area<other_area) {
+        return node;
+    }
+    if (area>other_area) {
+        return other_node;
+    }
+    if (_synctex_abs(_synctex_data_width(node))>_synctex_abs(_synctex_data_width(other_node))) {
+        return node;
+    }
+    if (_synctex_abs(_synctex_data_width(node))<_synctex_abs(_synctex_data_width(other_node))) {
+        return other_node;
+    }
+    if (total_height<other_total_height) {
+        return node;
+    }
+    if (total_height>other_total_height) {
+        return other_node;
+    }
+    return node;
+}
+
+SYNCTEX_INLINE static synctex_bool_t _synctex_point_in_box_v2(synctex_point_p hit, synctex_node_p node) {
+    if (node) {
+        if (0 == _synctex_point_h_ordered_distance_v2(hit,node).distance
+            && 0 == _synctex_point_v_ordered_distance_v2(hit,node).distance) {
+            return synctex_YES;
+        }
+    }
+    return synctex_NO;
+}
+
+static int _synctex_distance_to_box_v2(synctex_point_p hit,synctex_box_p box) {
+    /*  The distance between a point and a box is special.
+     *  It is not the euclidian distance, nor something similar.
+     *  We have to take into account the particular layout,
+     *  and the box hierarchy.
+     *  Given a box, there are 9 regions delimited by the lines of the edges of the box.
+     *  The origin being at the top left corner of the page,
+     *  we also give names to the vertices of the box.
+     *
+     *   1 | 2 | 3
+     *  ---A---B--->
+     *   4 | 5 | 6
+     *  ---C---D--->
+     *   7 | 8 | 9
+     *     v   v
+     *  In each region, there is a different formula.
+     *  In the end we have a continuous distance which may not be a mathematical distance but who cares. */
+    if (hit->v<box->min.v) {
+        /*  Regions 1, 2 or 3 */
+        if (hit->h<box->min.h) {
+            /*  This is region 1. The distance to the box is the L1 distance PA. */
+            return box->min.v - hit->v + box->min.h - hit->h;/*  Integer overflow? probability epsilon */
+        } else if (hit->h<=box->max.h) {
+            /*  This is region 2. The distance to the box is the geometrical distance to the top edge.  */
+            return box->min.v - hit->v;
+        } else {
+            /*  This is region 3. The distance to the box is the L1 distance PB. */
+            return box->min.v - hit->v + hit->h - box->max.h;
+        }
+    } else if (hit->v<=box->max.v) {
+        /*  Regions 4, 5 or 6 */
+        if (hit->h<box->min.h) {
+            /*  This is region 4. The distance to the box is the geometrical distance to the left edge.  */
+            return box->min.h - hit->h;
+        } else if (hit->h<=box->max.h) {
+            /*  This is region 5. We are inside the box.  */
+            return 0;
+        } else {
+            /*  This is region 6. The distance to the box is the geometrical distance to the right edge.  */
+            return hit->h - box->max.h;
+        }
+    } else {
+        /*  Regions 7, 8 or 9 */
+        if (hit->h<box->min.h) {
+            /*  This is region 7. The distance to the box is the L1 distance PC. */
+            return hit->v - box->max.v + box->min.h - hit->h;
+        } else if (hit->h<=box->max.h) {
+            /*  This is region 8. The distance to the box is the geometrical distance to the top edge.  */
+            return hit->v - box->max.v;
+        } else {
+            /*  This is region 9. The distance to the box is the L1 distance PD. */
+            return hit->v - box->max.v + hit->h - box->max.h;
+        }
+    }
+}
+
+/**
+ *  The distance from the hit point to the node.
+ */
+static int _synctex_point_node_distance_v2(synctex_point_p hit, synctex_node_p node) {
+    int d = INT_MAX;
+    if (node) {
+        synctex_box_s box = {{0,0},{0,0}};
+        int dd = INT_MAX;
+        switch(synctex_node_type(node)) {
+            case synctex_node_type_vbox:
+                box.min.h = _synctex_data_h(node);
+                box.max.h = box.min.h + _synctex_abs(_synctex_data_width(node));
+                box.min.v = synctex_node_v(node);
+                box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
+                box.min.v -= _synctex_abs(_synctex_data_height(node));
+                return _synctex_distance_to_box_v2(hit,&box);
+            case synctex_node_type_proxy_vbox:
+                box.min.h = synctex_node_h(node);
+                box.max.h = box.min.h + _synctex_abs(synctex_node_width(node));
+                box.min.v = synctex_node_v(node);
+                box.max.v = box.min.v + _synctex_abs(synctex_node_depth(node));
+                box.min.v -= _synctex_abs(synctex_node_height(node));
+                return _synctex_distance_to_box_v2(hit,&box);
+            case synctex_node_type_hbox:
+            case synctex_node_type_proxy_hbox:
+                box.min.h = synctex_node_hbox_h(node);
+                box.max.h = box.min.h + _synctex_abs(synctex_node_hbox_width(node));
+                box.min.v = synctex_node_hbox_v(node);
+                box.max.v = box.min.v + _synctex_abs(synctex_node_hbox_depth(node));
+                box.min.v -= _synctex_abs(synctex_node_hbox_height(node));
+                return _synctex_distance_to_box_v2(hit,&box);
+            case synctex_node_type_void_vbox:
+            case synctex_node_type_void_hbox:
+                /*  best of distances from the left edge and right edge*/
+                box.min.h = _synctex_data_h(node);
+                box.max.h = box.min.h;
+                box.min.v = _synctex_data_v(node);
+                box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
+                box.min.v -= _synctex_abs(_synctex_data_height(node));
+                d = _synctex_distance_to_box_v2(hit,&box);
+                box.min.h = box.min.h + _synctex_abs(_synctex_data_width(node));
+                box.max.h = box.min.h;
+                dd = _synctex_distance_to_box_v2(hit,&box);
+                return d<dd ? d:dd;
+            case synctex_node_type_kern:
+                box.min.h = _synctex_data_h(node);
+                box.max.h = box.min.h;
+                box.max.v = _synctex_data_v(node);
+                box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
+                d = _synctex_distance_to_box_v2(hit,&box);
+                box.min.h -= _synctex_data_width(node);
+                box.max.h = box.min.h;
+                dd = _synctex_distance_to_box_v2(hit,&box);
+                return d<dd ? d:dd;
+            case synctex_node_type_glue:
+            case synctex_node_type_math:
+            case synctex_node_type_boundary:
+            case synctex_node_type_box_bdry:
+                box.min.h = _synctex_data_h(node);
+                box.max.h = box.min.h;
+                box.max.v = _synctex_data_v(node);
+                box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
+                return _synctex_distance_to_box_v2(hit,&box);
+            case synctex_node_type_proxy:
+            case synctex_node_type_proxy_last:
+            {
+                synctex_point_s otherHit = *hit;
+                otherHit.h -= _synctex_data_h(node);
+                otherHit.v -= _synctex_data_v(node);
+                return _synctex_point_node_distance_v2(&otherHit, _synctex_tree_target(node));
+            }
+            default: break;
+        }
+    }
+    return d;
+}
+static synctex_node_p _synctex_eq_deepest_container_v2(synctex_point_p hit, synctex_node_p node) {
+    if (node) {
+        /**/
+        synctex_node_p child;
+        if ((child = synctex_node_child(node))) {
+            /*  Non void hbox or vbox, form ref or proxy */
+            /*  We go deep first because some boxes have 0 dimensions
+             *  despite they do contain some black material.
+             */
+            do {
+                if ((_synctex_point_in_box_v2(hit,child))) {
+                    synctex_node_p deep = _synctex_eq_deepest_container_v2(hit,child);
+                    if (deep) {
+                        /*  One of the children contains the hit. */
+                        return deep;
+                    }
+                }
+            } while((child = synctex_node_sibling(child)));
+            /*  is the hit point inside the box? */
+            if (synctex_node_type(node) == synctex_node_type_vbox
+                || synctex_node_type(node) == synctex_node_type_proxy_vbox) {
+                /*  For vboxes we try to use some node inside.
+                 *  Walk through the list of siblings until we find the closest one.
+                 *  Only consider siblings with children inside. */
+                if ((child = _synctex_tree_child(node))) {
+                    synctex_nd_s best = SYNCTEX_ND_0;
+                    do {
+                        if (_synctex_tree_child(child)) {
+                            int d = _synctex_point_node_distance_v2(hit,child);
+                            if (d <= best.distance) {
+                                best = (synctex_nd_s){child, d};
+                            }
+                        }
+                    } while((child = __synctex_tree_sibling(child)));
+                    if (best.node) {
+                        return best.node;
+                    }
+                }
+            }
+            if (_synctex_point_in_box_v2(hit,node)) {
+                return node;
+            }
+        }
+    }
+    return NULL;
+}
+static synctex_nd_s _synctex_eq_deepest_container_v3(synctex_point_p hit, synctex_node_p node) {
+    if (node) {
+        synctex_node_p child = NULL;
+        if ((child = synctex_node_child(node))) {
+            /*  Non void hbox, vbox, box proxy or form ref */
+            /*  We go deep first because some boxes have 0 dimensions
+             *  despite they do contain some black material.
+             */
+            do {
+                synctex_nd_s deep = _synctex_eq_deepest_container_v3(hit, child);
+                if (deep.node) {
+                    /*  One of the children contains the hit-> */
+                    return deep;
+                }
+            } while((child = synctex_node_sibling(child)));
+            /*  For vboxes we try to use some node inside.
+             *  Walk through the list of siblings until we find the closest one.
+             *  Only consider siblings with children inside. */
+            if (synctex_node_type(node) == synctex_node_type_vbox
+                || synctex_node_type(node) == synctex_node_type_proxy_vbox) {
+                if ((child = synctex_node_child(node))) {
+                    synctex_nd_s best = SYNCTEX_ND_0;
+                    do {
+                        if (synctex_node_child(child)) {
+                            int d = _synctex_point_node_distance_v2(hit,child);
+                            if (d < best.distance) {
+                                best = (synctex_nd_s){child,d};
+                            }
+                        }
+                    } while((child = synctex_node_sibling(child)));
+                    if (best.node) {
+                        return best;
+                    }
+                }
+            }
+            /*  is the hit point inside the box? */
+            if (_synctex_point_in_box_v2(hit,node)) {
+                return (synctex_nd_s){node, 0};
+            }
+        }
+    }
+    return SYNCTEX_ND_0;
+}
+
+/*  Compares the locations of the hit point with the locations of
+ *  the various nodes contained in the box.
+ *  As it is an horizontal box, we only compare horizontal coordinates.
+ */
+SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_hbox_v2(synctex_point_p hitP, synctex_node_p node) {
+    synctex_nd_s childd = SYNCTEX_ND_0;
+    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
+    if ((childd.node = synctex_node_child(node))) {
+        synctex_nd_s nd = SYNCTEX_ND_0;
+        do {
+            childd = _synctex_point_h_ordered_distance_v2(hitP,childd.node);
+            if (childd.distance > 0) {
+                /*  node is to the right of the hit point.
+                 *  We compare node and the previously recorded one, through the recorded distance.
+                 *  If the nodes have the same tag, prefer the one with the smallest line number,
+                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
+                if (nds.r.distance > childd.distance) {
+                    nds.r = childd;
+                } else if (nds.r.distance == childd.distance && nds.r.node) {
+                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(childd.node)
+                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(childd.node)
+                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(childd.node)
+                                && _synctex_data_column(nds.r.node) > _synctex_data_column(childd.node)))) {
+                                nds.r = childd;
+                            }
+                }
+            } else if (childd.distance == 0) {
+                /*  hit point is inside node. */
+                if (_synctex_tree_child(childd.node)) {
+                    return _synctex_eq_get_closest_children_in_box_v2(hitP, childd.node);
+                }
+                nds.l = childd;
+            } else { /*  here childd.distance < 0, the hit point is to the right of node */
+                childd.distance = -childd.distance;
+                if (nds.l.distance > childd.distance) {
+                    nds.l = childd;
+                } else if (nds.l.distance == childd.distance && nds.l.node) {
+                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(childd.node)
+                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(childd.node)
+                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(childd.node)
+                                && _synctex_data_column(nds.l.node) > _synctex_data_column(childd.node)))) {
+                                nds.l = childd;
+                            }
+                }
+            }
+        } while((childd.node = synctex_node_sibling(childd.node)));
+        if (nds.l.node) {
+            /*  the left node is new, try to narrow the result */
+            if ((nd = _synctex_eq_deepest_container_v3(hitP,nds.l.node)).node) {
+                nds.l = nd;
+            }
+            if((nd = __synctex_closest_deep_child_v2(hitP,nds.l.node)).node) {
+                nds.l.node = nd.node;
+            }
+        }
+        if (nds.r.node) {
+            /*  the right node is new, try to narrow the result */
+            if ((nd = _synctex_eq_deepest_container_v3(hitP,nds.r.node)).node) {
+                nds.r = nd;
+            }
+            if((nd = __synctex_closest_deep_child_v2(hitP,nds.r.node)).node) {
+                nds.r.node = nd.node;
+            }
+        }
+    }
+    return nds;
+}
+
+#if 0
+SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_hbox_v3(synctex_point_p hitP, synctex_node_p nodeP) {
+    synctex_nd_s nd = SYNCTEX_ND_0;
+    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
+    if ((nd.node = _synctex_tree_child(nodeP))) {
+        do {
+            nd = _synctex_point_h_ordered_distance_v2(hitP,nd.node);
+            if (nd.distance > 0) {
+                /*  node is to the right of the hit point.
+                 *  We compare node and the previously recorded one, through the recorded distance.
+                 *  If the nodes have the same tag, prefer the one with the smallest line number,
+                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
+                if (nds.r.distance > nd.distance) {
+                    nds.r = nd;
+                } else if (nds.r.distance == nd.distance && nds.r.node) {
+                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(nd.node)
+                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(nd.node)
+                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(nd.node)
+                                && _synctex_data_column(nds.r.node) > _synctex_data_column(nd.node)))) {
+                                nds.r = nd;
+                            }
+                }
+            } else if (nd.distance == 0) {
+                /*  hit point is inside node. */
+                nds.l = nd;
+            } else { /*  here nd.d < 0, the hit point is to the right of node */
+                nd.distance = -nd.distance;
+                if (nds.l.distance > nd.distance) {
+                    nds.l = nd;
+                } else if (nds.l.distance == nd.distance && nds.l.node) {
+                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(nd.node)
+                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(nd.node)
+                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(nd.node)
+                                && _synctex_data_column(nds.l.node) > _synctex_data_column(nd.node)))) {
+                                nds.l = nd;
+                            }
+                }
+            }
+        } while((nd.node = __synctex_tree_sibling(nd.node)));
+        if (nds.l.node) {
+            /*  the left node is new, try to narrow the result */
+            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.l.node))) {
+                nds.l.node = nd.node;
+            }
+            if((nd = _synctex_eq_closest_child_v2(hitP,nds.l.node)).node) {
+                nds.l.node = nd.node;
+            }
+        }
+        if (nds.r.node) {
+            /*  the right node is new, try to narrow the result */
+            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.r.node))) {
+                nds.r.node = nd.node;
+            }
+            if((nd = _synctex_eq_closest_child_v2(hitP,nds.r.node)).node) {
+                nds.r.node = nd.node;
+            }
+        }
+    }
+    return nds;
+}
+#endif
+SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_vbox_v2(synctex_point_p hitP, synctex_node_p nodeP) {
+    SYNCTEX_UNUSED(nodeP)
+    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
+    synctex_nd_s nd = SYNCTEX_ND_0;
+    if ((nd.node = synctex_node_child(nd.node))) {
+        do {
+            nd = _synctex_point_v_ordered_distance_v2(hitP,nd.node);
+            /*  this is what makes the difference with the h version above */
+            if (nd.distance > 0) {
+                /*  node is to the top of the hit point (below because TeX is oriented from top to bottom.
+                 *  We compare node and the previously recorded one, through the recorded distance.
+                 *  If the nodes have the same tag, prefer the one with the smallest line number,
+                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
+                if (nds.r.distance > nd.distance) {
+                    nds.r = nd;
+                } else if (nds.r.distance == nd.distance && nds.r.node) {
+                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(nd.node)
+                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(nd.node)
+                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(nd.node)
+                                && _synctex_data_column(nds.r.node) > _synctex_data_column(nd.node)))) {
+                                nds.r = nd;
+                            }
+                }
+            } else if (nd.distance == 0) {
+                nds.l = nd;
+            } else { /*  here nd < 0 */
+                nd.distance = -nd.distance;
+                if (nds.l.distance > nd.distance) {
+                    nds.l = nd;
+                } else if (nds.l.distance == nd.distance && nds.l.node) {
+                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(nd.node)
+                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(nd.node)
+                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(nd.node)
+                                && _synctex_data_column(nds.l.node) > _synctex_data_column(nd.node)))) {
+                                nds.l = nd;
+                            }
+                }
+            }
+        } while((nd.node = synctex_node_sibling(nd.node)));
+        if (nds.l.node) {
+            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.l.node))) {
+                nds.l.node = nd.node;
+            }
+            if((nd = _synctex_eq_closest_child_v2(hitP,nds.l.node)).node) {
+                nds.l.node = nd.node;
+            }
+        }
+        if (nds.r.node) {
+            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.r.node))) {
+                nds.r.node = nd.node;
+            }
+            if((nd = _synctex_eq_closest_child_v2(hitP,nds.r.node)).node) {
+                nds.r.node = nd.node;
+            }
+        }
+    }
+    return nds;
+}
+
+/**
+ *  Get the child closest to the hit point.
+ *  - parameter: hit point
+ *  - parameter: containing node
+ *  - returns: the child and the distance to the hit point.
+ *      SYNCTEX_ND_0 if the parameter node has no children.
+ *  - note: recursive call.
+ */
+static synctex_nd_s __synctex_closest_deep_child_v2(synctex_point_p hitP, synctex_node_p node) {
+    synctex_nd_s best = SYNCTEX_ND_0;
+    synctex_node_p child = NULL;
+    if ((child = synctex_node_child(node))) {
+#if defined(SYNCTEX_DEBUG)
+        printf("Closest deep child on box at line %i\n",
+               SYNCTEX_LINEINDEX(node));
+#endif
+        do {
+#if SYNCTEX_DEBUG>500
+            synctex_node_display(child);
+#endif
+            synctex_nd_s nd = SYNCTEX_ND_0;
+            if (_synctex_node_is_box(child)) {
+                nd = __synctex_closest_deep_child_v2(hitP,child);
+            } else {
+                nd = (synctex_nd_s) {child, _synctex_point_node_distance_v2(hitP,child)};
+            }
+            if (nd.distance < best.distance ||(nd.distance == best.distance
+                                               && synctex_node_type(nd.node) != synctex_node_type_kern)) {
+#if defined(SYNCTEX_DEBUG)
+                if(nd.node) {
+                    printf("New best %i<=%i line %i\n",nd.distance,
+                           best.distance,SYNCTEX_LINEINDEX(nd.node));
+                }
+#endif
+                best = nd;
+            }
+        } while((child = synctex_node_sibling(child)));
+#if defined(SYNCTEX_DEBUG)
+        if(best.node) {
+            printf("Found new best %i line %i\n",best.distance,SYNCTEX_LINEINDEX(best.node));
+        }
+#endif
+    }
+    return best;
+}
+
+/**
+ *  Return the closest child.
+ *  - parameter: a pointer to the hit point,
+ *  - parameter: the container
+ *  - return: SYNCTEX_ND_0 if node has no child,
+ *      the __synctex_closest_deep_child_v2 otherwise.
+ */
+static synctex_nd_s _synctex_eq_closest_child_v2(synctex_point_p hitP, synctex_node_p node) {
+    synctex_nd_s nd = SYNCTEX_ND_0;
+    if (_synctex_node_is_box(node)) {
+        nd = __synctex_closest_deep_child_v2(hitP, node);
+        if (_synctex_node_is_box(nd.node)) {
+            synctex_node_p child = NULL;
+            if ((child = synctex_node_child(nd.node))) {
+                synctex_nd_s best = {child,_synctex_point_node_distance_v2(hitP,child)};
+                while((child = synctex_node_sibling(child))) {
+                    int d = _synctex_point_node_distance_v2(hitP,child);
+                    if (d < best.distance) {
+                        best = (synctex_nd_s){child,d};
+                    } else if (d == best.distance && synctex_node_type(child) != synctex_node_type_kern) {
+                        best.node = child;
+                    }
+                }
+                return best;
+            }
+        }
+        return nd;
+    }
+    return SYNCTEX_ND_0;
+}
+SYNCTEX_INLINE static synctex_nd_lr_s _synctex_eq_get_closest_children_in_box_v2(synctex_point_p hitP, synctex_node_p node) {
+    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
+    if(_synctex_tree_has_child(node)) { /* node != NULL */
+        if (node->class_->type==synctex_node_type_hbox ||
+            node->class_->type==synctex_node_type_proxy_hbox) {
+            return __synctex_eq_get_closest_children_in_hbox_v2(hitP,node);
+        } else {
+            return __synctex_eq_get_closest_children_in_vbox_v2(hitP,node);
+        }
+    }
+    return nds;
+}
+
+#ifndef SYNCTEX_NO_UPDATER
+
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Updater
+#   endif
+
+typedef int (*synctex_print_f)(synctex_updater_p, const char * , ...); /*  print formatted to either FILE *  or gzFile */
+typedef void (*synctex_close_f)(synctex_updater_p); /*  close FILE *  or gzFile */
+
+#   define SYNCTEX_BITS_PER_BYTE 8
+
+typedef union {
+    gzFile as_gzFile;
+    FILE * as_FILE_p;
+    void * as_ptr;
+} synctex_file_u;
+
+struct synctex_updater_t {
+    synctex_file_u file;
+    synctex_print_f print;
+    synctex_close_f close;
+    int length;             /*  the number of chars appended */
+};
+
+__attribute__((__format__ (__printf__, 2, 3)))
+static int _synctex_updater_print(synctex_updater_p updater, const char * format, ...) {
+    int result = 0;
+    if (updater) {
+        va_list va;
+        va_start(va, format);
+        result = vfprintf(updater->file.as_FILE_p,
+                           format,
+                           va);
+        va_end(va);
+    }
+    return result;
+}
+#if defined(_MSC_VER)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+static int vasprintf(char **ret,
+                     const char *format,
+                     va_list ap)
+{
+    int len;
+    len = _vsnprintf(NULL, 0, format, ap);
+    if (len < 0) return -1;
+    *ret = malloc(len + 1);
+    if (!*ret) return -1;
+    _vsnprintf(*ret, len+1, format, ap);
+    (*ret)[len] = '\0';
+    return len;
+}
+
+#endif
+
+/**
+ *  gzvprintf is not available until OSX 10.10
+ */
+__attribute__((__format__ (__printf__, 2, 3)))
+static int _synctex_updater_print_gz(synctex_updater_p updater, const char * format, ...) {
+    int result = 0;
+    if (updater) {
+        char * buffer;
+        va_list va;
+        va_start(va, format);
+        if (vasprintf(&buffer, format, va) < 0) {
+            _synctex_error("Out of memory...");
+        } else if ((result = (int)strlen(buffer))) {
+            result = gzwrite(updater->file.as_gzFile, buffer, (unsigned)result);
+        }
+        va_end(va);
+        free(buffer);
+    }
+    return result;
+}
+
+static void _synctex_updater_close(synctex_updater_p updater) {
+    if (updater) {
+        fclose(updater->file.as_FILE_p);
+    }
+}
+
+static void _synctex_updater_close_gz(synctex_updater_p updater) {
+    if (updater) {
+        gzclose(updater->file.as_gzFile);
+    }
+}
+
+synctex_updater_p synctex_updater_new_with_output_file(const char * output, const char * build_directory) {
+    synctex_updater_p updater = NULL;
+    const char * mode = NULL;
+    synctex_open_s open;
+    /*  prepare the updater, the memory is the only one dynamically allocated */
+    updater = (synctex_updater_p)_synctex_malloc(sizeof(synctex_updater_s));
+    if (NULL == updater) {
+        _synctex_error("!  synctex_updater_new_with_file: malloc problem");
+        return NULL;
+    }
+    open = _synctex_open_v2(output,build_directory,0,synctex_ADD_QUOTES);
+    if (open.status < SYNCTEX_STATUS_OK) {
+        open = _synctex_open_v2(output,build_directory,0,synctex_DONT_ADD_QUOTES);
+        if (open.status < SYNCTEX_STATUS_OK) {
+        return_on_error:
+            _synctex_free(updater);
+            return updater = NULL;
+        }
+    }
+    /*  OK, the file exists, we close it and reopen it with the correct mode.
+     *  The receiver is now the owner of the "synctex" variable. */
+    gzclose(open.file);
+    updater->file.as_ptr = NULL;
+    mode = _synctex_get_io_mode_name(open.io_mode|synctex_io_append_mask);/* either "a" or "ab", depending on the file extension */
+    if (open.io_mode&synctex_io_gz_mask) {
+        if (NULL == (updater->file.as_FILE_p = fopen(open.synctex,mode))) {
+        no_write_error:
+            _synctex_error("!  synctex_updater_new_with_file: Can't append to %s",open.synctex);
+            free(open.synctex);
+            goto return_on_error;
+        }
+        updater->print = &_synctex_updater_print;
+        updater->close = &_synctex_updater_close;
+    } else {
+        if (NULL == (updater->file.as_gzFile = gzopen(open.synctex,mode))) {
+            goto no_write_error;
+        }
+        updater->print = &_synctex_updater_print_gz;
+        updater->close = &_synctex_updater_close_gz;
+    }
+    printf("SyncTeX: updating %s...",open.synctex);
+    _synctex_free(open.synctex);
+    return updater;
+}
+
+void synctex_updater_append_magnification(synctex_updater_p updater, char * magnification){
+    if (NULL==updater) {
+        return;
+    }
+    if (magnification && strlen(magnification)) {
+        updater->length +=
+        updater->print(updater,"Magnification:%s\n",magnification);
+    }
+}
+
+void synctex_updater_append_x_offset(synctex_updater_p updater, char * x_offset){
+    if (NULL==updater) {
+        return;
+    }
+    if (x_offset && strlen(x_offset)) {
+        updater->length += updater->print(updater,"X Offset:%s\n",x_offset);
+    }
+}
+
+void synctex_updater_append_y_offset(synctex_updater_p updater, char * y_offset){
+    if (NULL==updater) {
+        return;
+    }
+    if (y_offset && strlen(y_offset)) {
+        updater->length += updater->print(updater,"Y Offset:%s\n",y_offset);
+    }
+}
+
+void synctex_updater_free(synctex_updater_p updater){
+    if (NULL==updater) {
+        return;
+    }
+    if (updater->length>0) {
+        updater->print(updater,"!%i\n",updater->length);
+    }
+    updater->close(updater);
+    _synctex_free(updater);
+    printf("... done.\n");
+    return;
+}
+#endif
+
+#if defined(SYNCTEX_TESTING)
+#	ifdef SYNCTEX_NOTHING
+#       pragma mark -
+#       pragma mark Testers
+#   endif
+/**
+ *  The next nodes corresponds to a deep first tree traversal.
+ *  Does not create child proxies as side effect contrary to
+ *  the synctex_node_next method above.
+ *  May loop infinitely many times if the tree
+ *  is not properly built (contains loops).
+ */
+static synctex_node_p _synctex_node_next(synctex_node_p node) {
+    synctex_node_p N = _synctex_tree_child(node);
+    if (N) {
+        return N;
+    }
+    return _synctex_node_sibling_or_parents(node);
+}
+static int _synctex_input_copy_name(synctex_node_p input, char * name) {
+    char * copy = _synctex_malloc(strlen(name)+1);
+    memcpy(copy,name,strlen(name)+1);
+    _synctex_data_set_name(input,copy);
+    return 0;
+}
+int synctex_test_setup_scanner_sheets_421(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p sheet = synctex_node_new(scanner,synctex_node_type_sheet);
+    _synctex_data_set_page(sheet,4);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==4,"");
+    synctex_node_free(scanner->sheet);
+    scanner->sheet = sheet;
+    sheet = synctex_node_new(scanner,synctex_node_type_sheet);
+    _synctex_data_set_page(sheet,2);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==2,"");
+    __synctex_tree_set_sibling(sheet, scanner->sheet);
+    scanner->sheet = sheet;
+    sheet = synctex_node_new(scanner,synctex_node_type_sheet);
+    _synctex_data_set_page(sheet,1);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==1,"");
+    __synctex_tree_set_sibling(sheet, scanner->sheet);
+    scanner->sheet = sheet;
+    return TC;
+}
+int synctex_test_input(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p input = synctex_node_new(scanner,synctex_node_type_input);
+    _synctex_data_set_tag(input,421);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==421,"");
+    _synctex_data_set_tag(input,124);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==124,"");
+    _synctex_data_set_line(input,421);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==421,"");
+    _synctex_data_set_line(input,214);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==214,"");
+    _synctex_data_set_line(input,214);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==214,"");
+    _synctex_input_copy_name(input,"214");
+    SYNCTEX_TEST_BODY(TC, 0==memcmp(_synctex_data_name(input),"214",4),"");
+    _synctex_input_copy_name(input,"421421");
+
+    SYNCTEX_TEST_BODY(TC,
+                      0==memcmp(_synctex_data_name(input),
+                                "421421",
+                                4),
+                      "");
+    synctex_node_free(input);
+    return TC;
+}
+int synctex_test_proxy(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p proxy = synctex_node_new(scanner,synctex_node_type_proxy);
+    synctex_node_p target = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_tree_set_target(proxy,target);
+    _synctex_data_set_tag(target,421);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==421,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==421,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(proxy)==421,"");
+    synctex_node_free(proxy);
+    synctex_node_free(target);
+    return TC;
+}
+int synctex_test_handle(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p handle = synctex_node_new(scanner,synctex_node_type_handle);
+    synctex_node_p proxy = synctex_node_new(scanner, synctex_node_type_proxy);
+    synctex_node_p target = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_tree_set_target(handle,target);
+    _synctex_data_set_tag(target,421);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==421,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==421,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(handle)==421,"");
+    _synctex_data_set_line(target,214);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(target)==214,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_line(target)==214,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_line(handle)==214,"");
+    _synctex_data_set_column(target,142);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_column(target)==142,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_column(target)==142,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_column(handle)==142,"");
+    _synctex_tree_set_target(proxy,target);
+    _synctex_tree_set_target(handle,proxy);
+    _synctex_data_set_tag(target,412);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==412,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==412,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_tag(handle)==412,"");
+    _synctex_data_set_line(target,124);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(target)==124,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_line(target)==124,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_line(handle)==124,"");
+    _synctex_data_set_column(target,241);
+    SYNCTEX_TEST_BODY(TC, _synctex_data_column(target)==241,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_column(target)==241,"");
+    SYNCTEX_TEST_BODY(TC, synctex_node_column(handle)==241,"");
+    synctex_node_free(handle);
+    synctex_node_free(proxy);
+    synctex_node_free(target);
+    return TC;
+}
+int synctex_test_setup_scanner_input(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p input = synctex_node_new(scanner,synctex_node_type_input);
+    _synctex_data_set_tag(input,4);
+    _synctex_input_copy_name(input,"21");
+    _synctex_data_set_line(input,421);
+    synctex_node_free(scanner->input);
+    scanner->input = input;
+    scanner->flags.new_inputs = 1;
+    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==4,"");
+    SYNCTEX_TEST_BODY(TC, strcmp(_synctex_data_name(input),"21")==0,"");
+    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==421,"");
+    return TC;
+}
+int synctex_test_setup_nodes(synctex_scanner_p scanner, synctex_node_r nodes) {
+    int TC = 0;
+    int n;
+    for (n=0;n<synctex_node_number_of_types;++n) {
+        nodes[n] = synctex_node_new(scanner,n);
+        SYNCTEX_TEST_BODY(TC, nodes[n]!=NULL,"");
+    }
+    return TC;
+}
+int synctex_test_teardown_nodes(synctex_scanner_p scanner, synctex_node_r nodes) {
+    int n;
+    for (n=0;n<synctex_node_number_of_types;++n) {
+        synctex_node_free(nodes[n]);
+        nodes[n]=NULL;
+    }
+    return 1;
+}
+int synctex_test_tree(synctex_scanner_p scanner) {
+    int TC = 0;
+    synctex_node_p nodes1[synctex_node_number_of_types];
+    synctex_node_p nodes2[synctex_node_number_of_types];
+    synctex_node_p nodes3[synctex_node_number_of_types];
+    int i,j;
+    TC += synctex_test_setup_nodes(scanner,nodes1);
+    TC += synctex_test_setup_nodes(scanner,nodes2);
+    TC += synctex_test_setup_nodes(scanner,nodes3);
+    /*  Every node has a sibling */
+    for (i=0;i<synctex_node_number_of_types;++i) {
+        for (j=0;j<synctex_node_number_of_types;++j) {
+            _synctex_tree_set_sibling(nodes1[i],nodes2[i]);
+            SYNCTEX_TEST_BODY(TC, nodes2[i]==synctex_node_sibling(nodes1[i]),"");
+        }
+    }
+    synctex_test_teardown_nodes(scanner,nodes3);
+    synctex_test_teardown_nodes(scanner,nodes2);
+    synctex_test_teardown_nodes(scanner,nodes1);
+    return TC;
+}
+int synctex_test_page(synctex_scanner_p scanner) {
+    int TC = synctex_test_setup_scanner_sheets_421(scanner);
+    synctex_node_p sheet = scanner->sheet;
+    synctex_node_p node = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_data_set_tag(node,4);
+    _synctex_data_set_line(node,21);
+    synctex_node_free(_synctex_node_set_child(sheet,node));
+    SYNCTEX_TEST_BODY(TC, synctex_node_page(node)==synctex_node_page(sheet),"");
+    return TC;
+}
+int synctex_test_display_query(synctex_scanner_p scanner) {
+    int TC = synctex_test_setup_scanner_sheets_421(scanner);
+    synctex_node_p sheet = scanner->sheet;
+    synctex_node_p node = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_data_set_tag(node,4);
+    _synctex_data_set_line(node,21);
+    synctex_node_free(_synctex_node_set_child(sheet,node));
+    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
+    __synctex_node_make_friend_tlc(node);
+    SYNCTEX_TEST_BODY(TC, _synctex_scanner_friend(scanner, 25)==node,"");
+    sheet = __synctex_tree_sibling(sheet);
+    node = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_data_set_tag(node,4);
+    _synctex_data_set_line(node,21);
+    synctex_node_free(_synctex_node_set_child(sheet,node));
+    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
+    __synctex_node_make_friend_tlc(node);
+    SYNCTEX_TEST_BODY(TC, _synctex_scanner_friend(scanner, 25)==node,"");
+    sheet = __synctex_tree_sibling(sheet);
+    node = synctex_node_new(scanner,synctex_node_type_rule);
+    _synctex_data_set_tag(node,4);
+    _synctex_data_set_line(node,21);
+    synctex_node_free(_synctex_node_set_child(sheet,node));
+    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
+    __synctex_node_make_friend_tlc(node);
+    SYNCTEX_TEST_BODY(TC, (_synctex_scanner_friend(scanner, 25)==node),"");
+    synctex_test_setup_scanner_input(scanner);
+    scanner->flags.has_parsed = synctex_YES;
+#if 1
+    SYNCTEX_TEST_BODY(TC, (synctex_display_query(scanner,"21",21,4,-1)==3),"");
+#endif
+    return TC;
+}
+typedef struct {
+    int s;      /* status */
+    char n[25]; /* name */
+} synctex_test_sn_s;
+
+synctex_test_sn_s synctex_test_tmp_sn(char * content) {
+    synctex_test_sn_s sn = {0, "/tmp/test.XXXXXX.synctex"};
+    FILE *sfp;
+    int fd = mkstemps(sn.n,8);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", sn.n, strerror(errno));
+        sn.s = -1;
+        return sn;
+    }
+    if ((sfp = fdopen(fd, "w+")) == NULL) {
+        unlink(sn.n);
+        close(fd);
+        fprintf(stderr, "%s: %s\n", sn.n, strerror(errno));
+        sn.s = -2;
+        return sn;
+    }
+    sn.s = fputs(content,sfp);
+    printf("temp:%s\n%i\n",sn.n,sn.s);
+    fclose(sfp);
+    if (sn.s==0) {
+        sn.s = -2;
+        unlink(sn.n);
+    }
+    return sn;
+}
+int synctex_test_sheet_1() {
+    int TC = 0;
+    char * content =
+    "SyncTeX Version:1  \n" /*00-19*/
+    "Input:1:./1.tex    \n" /*20-39*/
+    "Output:pdf         \n" /*40-59*/
+    "Magnification:100000000      \n" /*60-89*/
+    "Unit:1   \n"           /*90-99*/
+    "X Offset:0         \n" /*00-19*/
+    "Y Offset:0         \n" /*20-39*/
+    "Content: \n"           /*40-49*/
+    "{1       \n"           /*50-59*/
+    "[1,10:20,350:330,330,0       \n" /*60-89*/
+    "]        \n"           /*90-99*/
+    "}        \n"           /*00-09*/
+    "Postamble:\n";
+    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_node_p node = synctex_scanner_handle(scanner);
+        printf("Created nodes:\n");
+        while (node) {
+            printf("%s\n",_synctex_node_abstract(node));
+            node = synctex_node_next(node);
         }
+        synctex_scanner_free(scanner);
+        unlink(sn.n);
     } else {
-        /*  Regions 7, 8 or 9 */
-        if (hit->h<box->min.h) {
-            /*  This is region 7. The distance to the box is the L1 distance PC. */
-            return hit->v - box->max.v + box->min.h - hit->h;
-        } else if (hit->h<=box->max.h) {
-            /*  This is region 8. The distance to the box is the geometrical distance to the top edge.  */
-            return hit->v - box->max.v;
-        } else {
-            /*  This is region 9. The distance to the box is the L1 distance PD. */
-            return hit->v - box->max.v + hit->h - box->max.h;
-        }
+        ++TC;
     }
+    return TC;
 }
-
-/**
- *  The distance from the hit point to the node.
- */
-static int _synctex_point_node_distance_v2(synctex_point_p hit, synctex_node_p node) {
-    int d = INT_MAX;
-    if (node) {
-        synctex_box_s box = {{0,0},{0,0}};
-        int dd = INT_MAX;
-        switch(synctex_node_type(node)) {
-            case synctex_node_type_vbox:
-                box.min.h = _synctex_data_h(node);
-                box.max.h = box.min.h + _synctex_abs(_synctex_data_width(node));
-                box.min.v = synctex_node_v(node);
-                box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
-                box.min.v -= _synctex_abs(_synctex_data_height(node));
-                return _synctex_distance_to_box_v2(hit,&box);
-            case synctex_node_type_proxy_vbox:
-                box.min.h = synctex_node_h(node);
-                box.max.h = box.min.h + _synctex_abs(synctex_node_width(node));
-                box.min.v = synctex_node_v(node);
-                box.max.v = box.min.v + _synctex_abs(synctex_node_depth(node));
-                box.min.v -= _synctex_abs(synctex_node_height(node));
-                return _synctex_distance_to_box_v2(hit,&box);
-            case synctex_node_type_hbox:
-            case synctex_node_type_proxy_hbox:
-                box.min.h = synctex_node_hbox_h(node);
-                box.max.h = box.min.h + _synctex_abs(synctex_node_hbox_width(node));
-                box.min.v = synctex_node_hbox_v(node);
-                box.max.v = box.min.v + _synctex_abs(synctex_node_hbox_depth(node));
-                box.min.v -= _synctex_abs(synctex_node_hbox_height(node));
-                return _synctex_distance_to_box_v2(hit,&box);
-            case synctex_node_type_void_vbox:
-            case synctex_node_type_void_hbox:
-                /*  best of distances from the left edge and right edge*/
-                box.min.h = _synctex_data_h(node);
-                box.max.h = box.min.h;
-                box.min.v = _synctex_data_v(node);
-                box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
-                box.min.v -= _synctex_abs(_synctex_data_height(node));
-                d = _synctex_distance_to_box_v2(hit,&box);
-                box.min.h = box.min.h + _synctex_abs(_synctex_data_width(node));
-                box.max.h = box.min.h;
-                dd = _synctex_distance_to_box_v2(hit,&box);
-                return d<dd ? d:dd;
-            case synctex_node_type_kern:
-                box.min.h = _synctex_data_h(node);
-                box.max.h = box.min.h;
-                box.max.v = _synctex_data_v(node);
-                box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
-                d = _synctex_distance_to_box_v2(hit,&box);
-                box.min.h -= _synctex_data_width(node);
-                box.max.h = box.min.h;
-                dd = _synctex_distance_to_box_v2(hit,&box);
-                return d<dd ? d:dd;
-            case synctex_node_type_glue:
-            case synctex_node_type_math:
-            case synctex_node_type_boundary:
-            case synctex_node_type_box_bdry:
-                box.min.h = _synctex_data_h(node);
-                box.max.h = box.min.h;
-                box.max.v = _synctex_data_v(node);
-                box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
-                return _synctex_distance_to_box_v2(hit,&box);
-            case synctex_node_type_proxy:
-            case synctex_node_type_proxy_last:
-            {
-                synctex_point_s otherHit = *hit;
-                otherHit.h -= _synctex_data_h(node);
-                otherHit.v -= _synctex_data_v(node);
-                return _synctex_point_node_distance_v2(&otherHit, _synctex_tree_target(node));
-            }
-            default: break;
+int synctex_test_sheet_2() {
+    int TC = 0;
+    char * content =
+    "SyncTeX Version:1  \n" /*00-19*/
+    "Input:1:./1.tex    \n" /*20-39*/
+    "Output:pdf         \n" /*40-59*/
+    "Magnification:100000000      \n" /*60-89*/
+    "Unit:1   \n"           /*90-99*/
+    "X Offset:0         \n" /*00-19*/
+    "Y Offset:0         \n" /*20-39*/
+    "Content: \n"           /*40-49*/
+    "{1       \n"           /*50-59*/
+    "(1,10:20,350:330,330,0       \n" /*60-89*/
+    ")        \n"           /*90-99*/
+    "}        \n"           /*00-09*/
+    "Postamble:\n";
+    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_node_p node = synctex_scanner_handle(scanner);
+        printf("Created nodes:\n");
+        while (node) {
+            printf("%s\n",_synctex_node_abstract(node));
+            node = _synctex_node_next(node);
         }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return d;
+    return TC;
 }
-static synctex_node_p _synctex_eq_deepest_container_v2(synctex_point_p hit, synctex_node_p node) {
-    if (node) {
-        /**/
-        synctex_node_p child;
-        if ((child = synctex_node_child(node))) {
-            /*  Non void hbox or vbox, form ref or proxy */
-            /*  We go deep first because some boxes have 0 dimensions
-             *  despite they do contain some black material.
-             */
-            do {
-                if ((_synctex_point_in_box_v2(hit,child))) {
-                    synctex_node_p deep = _synctex_eq_deepest_container_v2(hit,child);
-                    if (deep) {
-                        /*  One of the children contains the hit. */
-                        return deep;
-                    }
-                }
-            } while((child = synctex_node_sibling(child)));
-            /*  is the hit point inside the box? */
-            if (synctex_node_type(node) == synctex_node_type_vbox
-                || synctex_node_type(node) == synctex_node_type_proxy_vbox) {
-                /*  For vboxes we try to use some node inside.
-                 *  Walk through the list of siblings until we find the closest one.
-                 *  Only consider siblings with children inside. */
-                if ((child = _synctex_tree_child(node))) {
-                    synctex_nd_s best = SYNCTEX_ND_0;
-                    do {
-                        if (_synctex_tree_child(child)) {
-                            int d = _synctex_point_node_distance_v2(hit,child);
-                            if (d <= best.distance) {
-                                best = (synctex_nd_s){child, d};
-                            }
-                        }
-                    } while((child = __synctex_tree_sibling(child)));
-                    if (best.node) {
-                        return best.node;
-                    }
-                }
-            }
-            if (_synctex_point_in_box_v2(hit,node)) {
-                return node;
-            }
+int synctex_test_charindex() {
+    int TC = 0;
+    char * content =
+    "SyncTeX Version:1  \n" /*00-19*/
+    "Input:1:./1.tex    \n" /*20-39*/
+    "Output:pdf         \n" /*40-59*/
+    "Magnification:100000000      \n" /*60-89*/
+    "Unit:1   \n"           /*90-99*/
+    "X Offset:0         \n" /*00-19*/
+    "Y Offset:0         \n" /*20-39*/
+    "Content: \n"           /*40-49*/
+    "{1       \n"           /*50-59*/
+    "[1,10:20,350:330,330,0       \n" /*60-89*/
+    "(1,58:20,100:250,10,5        \n" /*90-119*/
+    "f1000:50,100       \n" /*20-39*/
+    ")        \n"           /*40-49*/
+    "]        \n"           /*50-59*/
+    "}        \n"           /*60-69*/
+    "Postamble:\n";
+    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_node_p node = synctex_scanner_handle(scanner);
+        printf("Created nodes:\n");
+        while (node) {
+            printf("%s\n",_synctex_node_abstract(node));
+            node = synctex_node_next(node);
         }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return NULL;
+    return TC;
 }
-static synctex_nd_s _synctex_eq_deepest_container_v3(synctex_point_p hit, synctex_node_p node) {
-    if (node) {
-        synctex_node_p child = NULL;
-        if ((child = synctex_node_child(node))) {
-            /*  Non void hbox, vbox, box proxy or form ref */
-            /*  We go deep first because some boxes have 0 dimensions
-             *  despite they do contain some black material.
-             */
-            do {
-                synctex_nd_s deep = _synctex_eq_deepest_container_v3(hit, child);
-                if (deep.node) {
-                    /*  One of the children contains the hit-> */
-                    return deep;
-                }
-            } while((child = synctex_node_sibling(child)));
-            /*  For vboxes we try to use some node inside.
-             *  Walk through the list of siblings until we find the closest one.
-             *  Only consider siblings with children inside. */
-            if (synctex_node_type(node) == synctex_node_type_vbox
-                || synctex_node_type(node) == synctex_node_type_proxy_vbox) {
-                if ((child = synctex_node_child(node))) {
-                    synctex_nd_s best = SYNCTEX_ND_0;
-                    do {
-                        if (synctex_node_child(child)) {
-                            int d = _synctex_point_node_distance_v2(hit,child);
-                            if (d < best.distance) {
-                                best = (synctex_nd_s){child,d};
-                            }
-                        }
-                    } while((child = synctex_node_sibling(child)));
-                    if (best.node) {
-                        return best;
-                    }
-                }
-            }
-            /*  is the hit point inside the box? */
-            if (_synctex_point_in_box_v2(hit,node)) {
-                return (synctex_nd_s){node, 0};
-            }
+int synctex_test_form() {
+    int TC = 0;
+    char * content =
+    "SyncTeX Version:1  \n" /*00-19*/
+    "Input:1:./1.tex    \n" /*20-39*/
+    "Output:pdf         \n" /*40-59*/
+    "Magnification:100000000      \n" /*60-89*/
+    "Unit:1   \n"           /*90-99*/
+    "X Offset:0         \n" /*00-19*/
+    "Y Offset:0         \n" /*20-39*/
+    "Content: \n"           /*40-49*/
+    "{1       \n"           /*50-59*/
+    "[1,10:20,350:330,330,0       \n" /*60-89*/
+    "(1,58:20,100:250,10,5        \n" /*90-119*/
+    "f1000:50,100       \n" /*20-39*/
+    ")        \n"           /*40-49*/
+    "]        \n"           /*50-59*/
+    "}        \n"           /*60-69*/
+    "<1000    \n"           /*70-79*/
+    "(1,63:0,0:100,8,3  \n" /*80-99*/
+    ")        \n"           /*00-09*/
+    ">        \n"           /*10-19*/
+    "Postamble:\n";
+    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_node_p node = synctex_scanner_handle(scanner);
+        while (node) {
+            printf("%s\n",_synctex_node_abstract(node));
+            node = _synctex_node_next(node);
         }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return SYNCTEX_ND_0;
+    return TC;
 }
-
-/*  Compares the locations of the hit point with the locations of
- *  the various nodes contained in the box.
- *  As it is an horizontal box, we only compare horizontal coordinates.
+/*  Compare the query results of a serially parsed scanner
+ *  and a concurrently parsed one.
  */
-SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_hbox_v2(synctex_point_p hitP, synctex_node_p node) {
-    synctex_nd_s childd = SYNCTEX_ND_0;
-    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
-    if ((childd.node = synctex_node_child(node))) {
-        synctex_nd_s nd = SYNCTEX_ND_0;
-        do {
-            childd = _synctex_point_h_ordered_distance_v2(hitP,childd.node);
-            if (childd.distance > 0) {
-                /*  node is to the right of the hit point.
-                 *  We compare node and the previously recorded one, through the recorded distance.
-                 *  If the nodes have the same tag, prefer the one with the smallest line number,
-                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
-                if (nds.r.distance > childd.distance) {
-                    nds.r = childd;
-                } else if (nds.r.distance == childd.distance && nds.r.node) {
-                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(childd.node)
-                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(childd.node)
-                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(childd.node)
-                                && _synctex_data_column(nds.r.node) > _synctex_data_column(childd.node)))) {
-                                nds.r = childd;
-                            }
-                }
-            } else if (childd.distance == 0) {
-                /*  hit point is inside node. */
-                if (_synctex_tree_child(childd.node)) {
-                    return _synctex_eq_get_closest_children_in_box_v2(hitP, childd.node);
-                }
-                nds.l = childd;
-            } else { /*  here childd.distance < 0, the hit point is to the right of node */
-                childd.distance = -childd.distance;
-                if (nds.l.distance > childd.distance) {
-                    nds.l = childd;
-                } else if (nds.l.distance == childd.distance && nds.l.node) {
-                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(childd.node)
-                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(childd.node)
-                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(childd.node)
-                                && _synctex_data_column(nds.l.node) > _synctex_data_column(childd.node)))) {
-                                nds.l = childd;
-                            }
-                }
-            }
-        } while((childd.node = synctex_node_sibling(childd.node)));
-        if (nds.l.node) {
-            /*  the left node is new, try to narrow the result */
-            if ((nd = _synctex_eq_deepest_container_v3(hitP,nds.l.node)).node) {
-                nds.l = nd;
-            }
-            if((nd = __synctex_closest_deep_child_v2(hitP,nds.l.node)).node) {
-                nds.l.node = nd.node;
-            }
-        }
-        if (nds.r.node) {
-            /*  the right node is new, try to narrow the result */
-            if ((nd = _synctex_eq_deepest_container_v3(hitP,nds.r.node)).node) {
-                nds.r = nd;
-            }
-            if((nd = __synctex_closest_deep_child_v2(hitP,nds.r.node)).node) {
-                nds.r.node = nd.node;
+static int _synctex_test_compare_queries(synctex_scanner_p serial, synctex_scanner_p mapped) {
+    int TC = 0;
+    synctex_node_p input = synctex_scanner_input(serial);
+    int page, line;
+    float h, v;
+    SYNCTEX_TEST_BODY(TC, synctex_scanner_get_name(mapped,1) && synctex_scanner_get_name(mapped,2),"Missing input\n");
+    while (input) {
+        const char * name = synctex_scanner_get_name(serial,synctex_node_tag(input));
+        SYNCTEX_TEST_BODY(TC, synctex_node_line(input)
+                          == synctex_node_line(synctex_scanner_input_with_tag(mapped,synctex_node_tag(input))),
+                          "Bad max line for %s\n",name);
+        for (line = 1; line <= synctex_node_line(input)+1; ++line) {
+            synctex_iterator_p I1 = synctex_iterator_new_display(serial,name,line,0,-1);
+            synctex_iterator_p I2 = synctex_iterator_new_display(mapped,name,line,0,-1);
+            synctex_node_p N1, N2;
+            do {
+                N1 = synctex_iterator_next_result(I1);
+                N2 = synctex_iterator_next_result(I2);
+                SYNCTEX_TEST_BODY(TC, synctex_node_page(N1) == synctex_node_page(N2)
+                                  && synctex_node_h(N1) == synctex_node_h(N2)
+                                  && synctex_node_v(N1) == synctex_node_v(N2),
+                                  "Display query mismatch %s:%i\n",name,line);
+            } while (N1 && N2);
+            synctex_iterator_free(I1);
+            synctex_iterator_free(I2);
+        }
+        input = synctex_node_sibling(input);
+    }
+    for (page = 1; page <= 4; ++page) {
+        for (h = 0; h < 400; h += 13) {
+            for (v = 0; v < 400; v += 17) {
+                synctex_iterator_p I1 = synctex_iterator_new_edit(serial,page,h,v);
+                synctex_iterator_p I2 = synctex_iterator_new_edit(mapped,page,h,v);
+                synctex_node_p N1, N2;
+                do {
+                    N1 = synctex_iterator_next_result(I1);
+                    N2 = synctex_iterator_next_result(I2);
+                    SYNCTEX_TEST_BODY(TC, synctex_node_tag(N1) == synctex_node_tag(N2)
+                                      && synctex_node_line(N1) == synctex_node_line(N2)
+                                      && synctex_node_column(N1) == synctex_node_column(N2),
+                                      "Edit query mismatch %i:%f,%f\n",page,h,v);
+                } while (N1 && N2);
+                synctex_iterator_free(I1);
+                synctex_iterator_free(I2);
             }
         }
     }
-    return nds;
+    return TC;
 }
-
-#if 0
-SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_hbox_v3(synctex_point_p hitP, synctex_node_p nodeP) {
-    synctex_nd_s nd = SYNCTEX_ND_0;
-    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
-    if ((nd.node = _synctex_tree_child(nodeP))) {
-        do {
-            nd = _synctex_point_h_ordered_distance_v2(hitP,nd.node);
-            if (nd.distance > 0) {
-                /*  node is to the right of the hit point.
-                 *  We compare node and the previously recorded one, through the recorded distance.
-                 *  If the nodes have the same tag, prefer the one with the smallest line number,
-                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
-                if (nds.r.distance > nd.distance) {
-                    nds.r = nd;
-                } else if (nds.r.distance == nd.distance && nds.r.node) {
-                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(nd.node)
-                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(nd.node)
-                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(nd.node)
-                                && _synctex_data_column(nds.r.node) > _synctex_data_column(nd.node)))) {
-                                nds.r = nd;
-                            }
-                }
-            } else if (nd.distance == 0) {
-                /*  hit point is inside node. */
-                nds.l = nd;
-            } else { /*  here nd.d < 0, the hit point is to the right of node */
-                nd.distance = -nd.distance;
-                if (nds.l.distance > nd.distance) {
-                    nds.l = nd;
-                } else if (nds.l.distance == nd.distance && nds.l.node) {
-                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(nd.node)
-                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(nd.node)
-                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(nd.node)
-                                && _synctex_data_column(nds.l.node) > _synctex_data_column(nd.node)))) {
-                                nds.l = nd;
-                            }
-                }
-            }
-        } while((nd.node = __synctex_tree_sibling(nd.node)));
-        if (nds.l.node) {
-            /*  the left node is new, try to narrow the result */
-            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.l.node))) {
-                nds.l.node = nd.node;
-            }
-            if((nd = _synctex_eq_closest_child_v2(hitP,nds.l.node)).node) {
-                nds.l.node = nd.node;
-            }
-        }
-        if (nds.r.node) {
-            /*  the right node is new, try to narrow the result */
-            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.r.node))) {
-                nds.r.node = nd.node;
-            }
-            if((nd = _synctex_eq_closest_child_v2(hitP,nds.r.node)).node) {
-                nds.r.node = nd.node;
-            }
-        }
+/*  Sheets and forms with inputs in between, and the ',=' shortcut at sheet starts. */
+static char * _synctex_test_chunked_content =
+"SyncTeX Version:1\n"
+"Input:1:./1.tex\n"
+"Output:pdf\n"
+"Magnification:1000\n"
+"Unit:1\n"
+"X Offset:0\n"
+"Y Offset:0\n"
+"Content:\n"
+"<1000\n"
+"(1,63:0,0:100,8,3\n"
+")\n"
+">\n"
+"!100\n"
+"{1\n"
+"[1,10:20,350:330,330,0\n"
+"(1,11:20,100:250,10,5\n"
+"x1,11:20,=\n"
+"f1000:50,=\n"
+"g1,12:80,=\n"
+")\n"
+"]\n"
+"}1\n"
+"!200\n"
+"Input:2:./2.tex\n"
+"{2\n"
+"[2,1:20,=:330,330,0\n"
+"(2,2:20,100:250,10,5\n"
+"k2,2:30,=:10\n"
+"$2,3:60,=\n"
+")\n"
+"(1,13:20,120:250,10,5\n"
+"f1000:50,=\n"
+"r1,13:70,=:10,2,0\n"
+")\n"
+"]\n"
+"}2\n"
+"!300\n"
+"{3\n"
+"[1,20:20,350:330,330,0\n"
+"(2,5:20,150:250,10,5\n"
+"h2,5:30,=:10,8,2\n"
+")\n"
+"]\n"
+"}3\n"
+"!400\n"
+"{4\n"
+"[2,7:20,=:330,330,0\n"
+"(1,21:20,200:250,10,5\n"
+"g1,21:40,=\n"
+")\n"
+"]\n"
+"}4\n"
+"!500\n"
+"Postamble:\n"
+"Count:30\n"
+"!600\n"
+"Post scriptum:\n";
+int synctex_test_mapped() {
+    int TC = 0;
+    char * content = _synctex_test_chunked_content;
+    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    if (sn.s>0) {
+        synctex_scanner_p serial = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_p mapped = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_set_parse_options(mapped, synctex_parse_option_mapped);
+        serial = synctex_scanner_parse(serial);
+        mapped = synctex_scanner_parse(mapped);
+        SYNCTEX_TEST_BODY(TC, serial && mapped, "Parse failure\n");
+        if (serial && mapped) {
+            TC += _synctex_test_compare_queries(serial,mapped);
+            SYNCTEX_TEST_BODY(TC, serial->count == mapped->count, "Bad postamble\n");
+        }
+        TC += synctex_scanner_free(serial);
+        TC += synctex_scanner_free(mapped);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return nds;
+    return TC;
 }
-#endif
-SYNCTEX_INLINE static synctex_nd_lr_s __synctex_eq_get_closest_children_in_vbox_v2(synctex_point_p hitP, synctex_node_p nodeP) {
-    SYNCTEX_UNUSED(nodeP)
-    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
-    synctex_nd_s nd = SYNCTEX_ND_0;
-    if ((nd.node = synctex_node_child(nd.node))) {
-        do {
-            nd = _synctex_point_v_ordered_distance_v2(hitP,nd.node);
-            /*  this is what makes the difference with the h version above */
-            if (nd.distance > 0) {
-                /*  node is to the top of the hit point (below because TeX is oriented from top to bottom.
-                 *  We compare node and the previously recorded one, through the recorded distance.
-                 *  If the nodes have the same tag, prefer the one with the smallest line number,
-                 *  if the nodes also have the same line number, prefer the one with the smallest column. */
-                if (nds.r.distance > nd.distance) {
-                    nds.r = nd;
-                } else if (nds.r.distance == nd.distance && nds.r.node) {
-                    if (_synctex_data_tag(nds.r.node) == _synctex_data_tag(nd.node)
-                        && (_synctex_data_line(nds.r.node) > _synctex_data_line(nd.node)
-                            || (_synctex_data_line(nds.r.node) == _synctex_data_line(nd.node)
-                                && _synctex_data_column(nds.r.node) > _synctex_data_column(nd.node)))) {
-                                nds.r = nd;
-                            }
-                }
-            } else if (nd.distance == 0) {
-                nds.l = nd;
-            } else { /*  here nd < 0 */
-                nd.distance = -nd.distance;
-                if (nds.l.distance > nd.distance) {
-                    nds.l = nd;
-                } else if (nds.l.distance == nd.distance && nds.l.node) {
-                    if (_synctex_data_tag(nds.l.node) == _synctex_data_tag(nd.node)
-                        && (_synctex_data_line(nds.l.node) > _synctex_data_line(nd.node)
-                            || (_synctex_data_line(nds.l.node) == _synctex_data_line(nd.node)
-                                && _synctex_data_column(nds.l.node) > _synctex_data_column(nd.node)))) {
-                                nds.l = nd;
-                            }
-                }
-            }
-        } while((nd.node = synctex_node_sibling(nd.node)));
-        if (nds.l.node) {
-            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.l.node))) {
-                nds.l.node = nd.node;
-            }
-            if((nd = _synctex_eq_closest_child_v2(hitP,nds.l.node)).node) {
-                nds.l.node = nd.node;
-            }
-        }
-        if (nds.r.node) {
-            if ((nd.node = _synctex_eq_deepest_container_v2(hitP,nds.r.node))) {
-                nds.r.node = nd.node;
-            }
-            if((nd = _synctex_eq_closest_child_v2(hitP,nds.r.node)).node) {
-                nds.r.node = nd.node;
-            }
-        }
+int synctex_test_lazy() {
+    int TC = 0;
+    synctex_test_sn_s sn = synctex_test_tmp_sn(_synctex_test_chunked_content);
+    if (sn.s>0) {
+        synctex_scanner_p serial = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_p lazy = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_set_parse_options(lazy, synctex_parse_option_lazy);
+        serial = synctex_scanner_parse(serial);
+        lazy = synctex_scanner_parse(lazy);
+        SYNCTEX_TEST_BODY(TC, serial && lazy && lazy->lazy, "Parse failure\n");
+        if (serial && lazy && lazy->lazy) {
+            SYNCTEX_TEST_BODY(TC, lazy->lazy->number_of_sheets == 4
+                              && lazy->lazy->number_of_parsed_sheets == 0, "Bad lazy index\n");
+            SYNCTEX_TEST_BODY(TC, synctex_sheet(lazy,3) && lazy->lazy->number_of_parsed_sheets == 1,
+                              "Sheet 3 not parsed alone\n");
+            SYNCTEX_TEST_BODY(TC, serial->count == lazy->count, "Bad postamble\n");
+            TC += _synctex_test_compare_queries(serial,lazy);
+        }
+        TC += synctex_scanner_free(serial);
+        TC += synctex_scanner_free(lazy);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return nds;
+    return TC;
+}
+#   if !defined(_WIN32)
+#       include <sys/time.h>
+static double _synctex_test_now() {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec+tv.tv_usec*1e-6;
 }
-
 /**
- *  Get the child closest to the hit point.
- *  - parameter: hit point
- *  - parameter: containing node
- *  - returns: the child and the distance to the hit point.
- *      SYNCTEX_ND_0 if the parameter node has no children.
- *  - note: recursive call.
- */
-static synctex_nd_s __synctex_closest_deep_child_v2(synctex_point_p hitP, synctex_node_p node) {
-    synctex_nd_s best = SYNCTEX_ND_0;
-    synctex_node_p child = NULL;
-    if ((child = synctex_node_child(node))) {
-#if defined(SYNCTEX_DEBUG)
-        printf("Closest deep child on box at line %i\n",
-               SYNCTEX_LINEINDEX(node));
-#endif
-        do {
-#if SYNCTEX_DEBUG>500
-            synctex_node_display(child);
-#endif
-            synctex_nd_s nd = SYNCTEX_ND_0;
-            if (_synctex_node_is_box(child)) {
-                nd = __synctex_closest_deep_child_v2(hitP,child);
-            } else {
-                nd = (synctex_nd_s) {child, _synctex_point_node_distance_v2(hitP,child)};
-            }
-            if (nd.distance < best.distance ||(nd.distance == best.distance
-                                               && synctex_node_type(nd.node) != synctex_node_type_kern)) {
-#if defined(SYNCTEX_DEBUG)
-                if(nd.node) {
-                    printf("New best %i<=%i line %i\n",nd.distance,
-                           best.distance,SYNCTEX_LINEINDEX(nd.node));
+ *  A synthetic synctex content with the given number of pages,
+ *  each page has 40 lines of text made of the given number of nodes and a few form refs.
+ *  - returns: a string to be freed by the caller.
+ */
+static char * _synctex_test_dense_content(int number_of_pages, int number_of_nodes) {
+    size_t capacity = 1024+(size_t)number_of_pages*(2048+40*(64+(size_t)number_of_nodes*56));
+    char * content = (char *)malloc(capacity);
+    char * ptr = content;
+    unsigned seed = 1;
+    int page, line, i;
+    if (NULL == content) {
+        return NULL;
+    }
+#       define SYNCTEX_TEST_PRINT(...) ptr += snprintf(ptr,capacity-(ptr-content),__VA_ARGS__)
+    SYNCTEX_TEST_PRINT("SyncTeX Version:1\nInput:1:./main.tex\nInput:2:./chapter.tex\n"
+                       "Output:pdf\nMagnification:1000\nUnit:1\nX Offset:0\nY Offset:0\nContent:\n"
+                       "<1\n(1,1:0,0:1000000,800000,200000\ng1,1:0,0\n)\n>\n");
+    for (page = 1; page <= number_of_pages; ++page) {
+        SYNCTEX_TEST_PRINT("!%i\n{%i\n[1,%i:4736286,48497656:30000000,40000000,0\n",page,page,page);
+        for (line = 0; line < 40; ++line) {
+            int tag = 1+(line&1);
+            int l = 20*page+line/2;
+            int v = 4736286+line*1000000;
+            int h = 4736286;
+            SYNCTEX_TEST_PRINT("(%i,%i:%i,%i:30000000,650000,200000\n",tag,l,h,v);
+            for (i = 0; i < number_of_nodes; ++i) {
+                seed = seed*1103515245+12345;
+                h += (200000+(seed>>16)%2800000)*10/number_of_nodes;
+                switch ((seed>>8)%4) {
+                    case 0: SYNCTEX_TEST_PRINT("g%i,%i:%i,%i\n",tag,l,h,v); break;
+                    case 1: SYNCTEX_TEST_PRINT("k%i,%i:%i,%i:%i\n",tag,l,h,v,(seed>>4)%50000); break;
+                    case 2: SYNCTEX_TEST_PRINT("x%i,%i:%i,%i\n",tag,l,h,v); break;
+                    default: SYNCTEX_TEST_PRINT("$%i,%i:%i,%i\n",tag,l,h,v); break;
                 }
-#endif
-                best = nd;
             }
-        } while((child = synctex_node_sibling(child)));
-#if defined(SYNCTEX_DEBUG)
-        if(best.node) {
-            printf("Found new best %i line %i\n",best.distance,SYNCTEX_LINEINDEX(best.node));
+            if (line%10 == 0) {
+                SYNCTEX_TEST_PRINT("f1:%i,%i\n",h,v);
+            }
+            SYNCTEX_TEST_PRINT(")\n");
         }
-#endif
+        SYNCTEX_TEST_PRINT("]\n}%i\n",page);
     }
-    return best;
+    SYNCTEX_TEST_PRINT("!0\nPostamble:\nCount:%i\n!0\nPost scriptum:\n",number_of_pages*40*(number_of_nodes+1));
+#       undef SYNCTEX_TEST_PRINT
+    return content;
 }
-
+static char * _synctex_test_synthetic_content(int number_of_pages) {
+    return _synctex_test_dense_content(number_of_pages,10);
+}
+#   endif
+#   if defined(SYNCTEX_USE_CACHE)
 /**
- *  Return the closest child.
- *  - parameter: a pointer to the hit point,
- *  - parameter: the container
- *  - return: SYNCTEX_ND_0 if node has no child,
- *      the __synctex_closest_deep_child_v2 otherwise.
+ *  Remove the cache of the given scanner and the cache directory.
  */
-static synctex_nd_s _synctex_eq_closest_child_v2(synctex_point_p hitP, synctex_node_p node) {
-    synctex_nd_s nd = SYNCTEX_ND_0;
-    if (_synctex_node_is_box(node)) {
-        nd = __synctex_closest_deep_child_v2(hitP, node);
-        if (_synctex_node_is_box(nd.node)) {
-            synctex_node_p child = NULL;
-            if ((child = synctex_node_child(nd.node))) {
-                synctex_nd_s best = {child,_synctex_point_node_distance_v2(hitP,child)};
-                while((child = synctex_node_sibling(child))) {
-                    int d = _synctex_point_node_distance_v2(hitP,child);
-                    if (d < best.distance) {
-                        best = (synctex_nd_s){child,d};
-                    } else if (d == best.distance && synctex_node_type(child) != synctex_node_type_kern) {
-                        best.node = child;
+static void _synctex_test_remove_cache(synctex_scanner_p scanner, char * directory) {
+    char * path = _synctex_cache_path(scanner);
+    if (path) {
+        unlink(path);
+        free(path);
+    }
+    rmdir(directory);
+}
+int synctex_test_cache() {
+    int TC = 0;
+    char directory[] = "/tmp/synctex.XXXXXX";
+    synctex_test_sn_s sn = synctex_test_tmp_sn(_synctex_test_chunked_content);
+    if (sn.s>0 && mkdtemp(directory)) {
+        synctex_scanner_p serial = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_scanner_p writer = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_p cached = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        SYNCTEX_TEST_BODY(TC, 0 == synctex_scanner_set_cache_directory(writer, directory), "No cache\n");
+        writer = synctex_scanner_parse(writer);
+        synctex_scanner_set_cache_directory(cached, directory);
+        cached = synctex_scanner_parse(cached);
+        SYNCTEX_TEST_BODY(TC, serial && writer && cached, "Parse failure\n");
+        if (serial && writer && cached) {
+            char * path = _synctex_cache_path(cached);
+            SYNCTEX_TEST_BODY(TC, path && 0 == access(path, R_OK), "Missing cache\n");
+            free(path);
+            SYNCTEX_TEST_BODY(TC, serial->count == cached->count
+                              && serial->unit == cached->unit
+                              && serial->x_offset == cached->x_offset
+                              && serial->y_offset == cached->y_offset, "Bad scanner data\n");
+            TC += _synctex_test_compare_queries(serial,writer);
+            TC += _synctex_test_compare_queries(serial,cached);
+            _synctex_test_remove_cache(cached,directory);
+        }
+        TC += synctex_scanner_free(serial);
+        TC += synctex_scanner_free(writer);
+        TC += synctex_scanner_free(cached);
+        unlink(sn.n);
+    } else {
+        ++TC;
+    }
+    return TC;
+}
+/**
+ *  Compare a cold load, a cached load and the query latency
+ *  on a synthetic synctex file with the given number of pages.
+ */
+int synctex_bench_cache(int number_of_pages) {
+    int TC = 0;
+    char directory[] = "/tmp/synctex.XXXXXX";
+    char * content = _synctex_test_synthetic_content(number_of_pages);
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
+    if (sn.s>0 && mkdtemp(directory)) {
+        synctex_scanner_p scanner = NULL;
+        double t0, cold, write, cached, edit = 0, display = 0;
+        int page, line, number_of_edits = 0, number_of_displays = 0;
+        float h, v;
+        t0 = _synctex_test_now();
+        scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        cold = _synctex_test_now()-t0;
+        synctex_scanner_free(scanner);
+        t0 = _synctex_test_now();
+        scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_set_cache_directory(scanner, directory);
+        scanner = synctex_scanner_parse(scanner);
+        write = _synctex_test_now()-t0;
+        synctex_scanner_free(scanner);
+        t0 = _synctex_test_now();
+        scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+        synctex_scanner_set_cache_directory(scanner, directory);
+        scanner = synctex_scanner_parse(scanner);
+        cached = _synctex_test_now()-t0;
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            t0 = _synctex_test_now();
+            for (page = 1; page <= number_of_pages; page += 1+number_of_pages/50) {
+                for (h = 0; h < 600; h += 61) {
+                    for (v = 0; v < 800; v += 83) {
+                        synctex_edit_query(scanner,page,h,v);
+                        ++number_of_edits;
                     }
                 }
-                return best;
             }
+            edit = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            for (line = 20; line < 20*number_of_pages; line += 1+number_of_pages/5) {
+                synctex_display_query(scanner,"./main.tex",line,0,-1);
+                synctex_display_query(scanner,"./chapter.tex",line,0,-1);
+                number_of_displays += 2;
+            }
+            display = _synctex_test_now()-t0;
+            _synctex_test_remove_cache(scanner,directory);
         }
-        return nd;
+        synctex_scanner_free(scanner);
+        unlink(sn.n);
+        printf("%i pages: cold load %.3fs, load and cache write %.3fs, cached load %.3fs\n",
+               number_of_pages,cold,write,cached);
+        printf("edit query %.1fus, display query %.1fus\n",
+               number_of_edits? 1e6*edit/number_of_edits: 0,
+               number_of_displays? 1e6*display/number_of_displays: 0);
+    } else {
+        ++TC;
     }
-    return SYNCTEX_ND_0;
+    return TC;
 }
-SYNCTEX_INLINE static synctex_nd_lr_s _synctex_eq_get_closest_children_in_box_v2(synctex_point_p hitP, synctex_node_p node) {
-    synctex_nd_lr_s nds = {SYNCTEX_ND_0,SYNCTEX_ND_0};
-    if(_synctex_tree_has_child(node)) { /* node != NULL */
-        if (node->class_->type==synctex_node_type_hbox ||
-            node->class_->type==synctex_node_type_proxy_hbox) {
-            return __synctex_eq_get_closest_children_in_hbox_v2(hitP,node);
-        } else {
-            return __synctex_eq_get_closest_children_in_vbox_v2(hitP,node);
+#   endif
+#   if !defined(_WIN32)
+/**
+ *  Compare the edit queries with and without the edit index, on all the sheets,
+ *  including points outside of the boxes and outside of the page.
+ */
+static int _synctex_test_compare_edits(synctex_scanner_p scanner, float step) {
+    int TC = 0;
+    int page;
+    float h, v;
+    for (page = 1; synctex_sheet(scanner,page); ++page) {
+        for (h = -50; h < 700; h += step) {
+            for (v = -50; v < 900; v += step) {
+                synctex_iterator_p I1 = _synctex_iterator_new_edit(scanner,page,h,v,synctex_NO);
+                synctex_iterator_p I2 = _synctex_iterator_new_edit(scanner,page,h,v,synctex_YES);
+                synctex_node_p N1, N2;
+                SYNCTEX_TEST_BODY(TC, synctex_iterator_count(I1) == synctex_iterator_count(I2),
+                                  "Edit index count mismatch %i:%f,%f\n",page,h,v);
+                do {
+                    N1 = synctex_iterator_next_result(I1);
+                    N2 = synctex_iterator_next_result(I2);
+                    SYNCTEX_TEST_BODY(TC, _synctex_tree_target(N1) == _synctex_tree_target(N2),
+                                      "Edit index mismatch %i:%f,%f\n",page,h,v);
+                } while (N1 && N2);
+                synctex_iterator_free(I1);
+                synctex_iterator_free(I2);
+            }
         }
     }
-    return nds;
+    return TC;
 }
-
-#ifndef SYNCTEX_NO_UPDATER
-
-#	ifdef SYNCTEX_NOTHING
-#       pragma mark -
-#       pragma mark Updater
-#   endif
-
-typedef int (*synctex_print_f)(synctex_updater_p, const char * , ...); /*  print formatted to either FILE *  or gzFile */
-typedef void (*synctex_close_f)(synctex_updater_p); /*  close FILE *  or gzFile */
-
-#   define SYNCTEX_BITS_PER_BYTE 8
-
-typedef union {
-    gzFile as_gzFile;
-    FILE * as_FILE_p;
-    void * as_ptr;
-} synctex_file_u;
-
-struct synctex_updater_t {
-    synctex_file_u file;
-    synctex_print_f print;
-    synctex_close_f close;
-    int length;             /*  the number of chars appended */
-};
-
-__attribute__((__format__ (__printf__, 2, 3)))
-static int _synctex_updater_print(synctex_updater_p updater, const char * format, ...) {
-    int result = 0;
-    if (updater) {
-        va_list va;
-        va_start(va, format);
-        result = vfprintf(updater->file.as_FILE_p,
-                           format,
-                           va);
-        va_end(va);
+int synctex_test_edit_index() {
+    int TC = 0;
+    char * content = _synctex_test_dense_content(3,40);
+    synctex_test_sn_s sn = synctex_test_tmp_sn(_synctex_test_chunked_content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            TC += _synctex_test_compare_edits(scanner,3.5);
+        }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    return result;
-}
-#if defined(_MSC_VER)
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdarg.h>
-
-static int vasprintf(char **ret,
-                     const char *format,
-                     va_list ap)
-{
-    int len;
-    len = _vsnprintf(NULL, 0, format, ap);
-    if (len < 0) return -1;
-    *ret = malloc(len + 1);
-    if (!*ret) return -1;
-    _vsnprintf(*ret, len+1, format, ap);
-    (*ret)[len] = '\0';
-    return len;
+    sn = (synctex_test_sn_s){0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            TC += _synctex_test_compare_edits(scanner,2.5);
+        }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
+    }
+    return TC;
 }
-
-#endif
-
 /**
- *  gzvprintf is not available until OSX 10.10
+ *  Compare the edit query latency with and without the edit index
+ *  on a synthetic synctex file with the given number of pages
+ *  and the given number of nodes per line, 40 lines per page.
+ *  The first indexed query on each page builds the index of the page.
  */
-__attribute__((__format__ (__printf__, 2, 3)))
-static int _synctex_updater_print_gz(synctex_updater_p updater, const char * format, ...) {
-    int result = 0;
-    if (updater) {
-        char * buffer;
-        va_list va;
-        va_start(va, format);
-        if (vasprintf(&buffer, format, va) < 0) {
-            _synctex_error("Out of memory...");
-        } else if ((result = (int)strlen(buffer))) {
-            result = gzwrite(updater->file.as_gzFile, buffer, (unsigned)result);
-        }
-        va_end(va);
-        free(buffer);
+int synctex_bench_edit_index(int number_of_pages, int number_of_nodes) {
+    int TC = 0;
+    char * content = _synctex_test_dense_content(number_of_pages,number_of_nodes);
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
     }
-    return result;
-}
-
-static void _synctex_updater_close(synctex_updater_p updater) {
-    if (updater) {
-        fclose(updater->file.as_FILE_p);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        double t0, linear = 0, build = 0, indexed = 0;
+        int page, number_of_edits = 0;
+        float h, v;
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            t0 = _synctex_test_now();
+            for (page = 1; page <= number_of_pages; ++page) {
+                for (h = -20; h < 600; h += 31) {
+                    for (v = -20; v < 800; v += 43) {
+                        synctex_iterator_free(_synctex_iterator_new_edit(scanner,page,h,v,synctex_NO));
+                        ++number_of_edits;
+                    }
+                }
+            }
+            linear = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            for (page = 1; page <= number_of_pages; ++page) {
+                _synctex_scanner_edit_index(scanner,synctex_sheet(scanner,page));
+            }
+            build = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            for (page = 1; page <= number_of_pages; ++page) {
+                for (h = -20; h < 600; h += 31) {
+                    for (v = -20; v < 800; v += 43) {
+                        synctex_iterator_free(_synctex_iterator_new_edit(scanner,page,h,v,synctex_YES));
+                    }
+                }
+            }
+            indexed = _synctex_test_now()-t0;
+        }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+        printf("%i pages, %i nodes per page: index build %.1fus per page\n",
+               number_of_pages,40*(number_of_nodes+1),1e6*build/number_of_pages);
+        printf("edit query %.1fus without index, %.1fus with index\n",
+               number_of_edits? 1e6*linear/number_of_edits: 0,
+               number_of_edits? 1e6*indexed/number_of_edits: 0);
+    } else {
+        ++TC;
     }
+    return TC;
 }
-
-static void _synctex_updater_close_gz(synctex_updater_p updater) {
-    if (updater) {
-        gzclose(updater->file.as_gzFile);
+/**
+ *  Compare the display queries with and without the display index, for all the lines.
+ */
+static int _synctex_test_compare_displays(synctex_scanner_p scanner, synctex_scanner_p indexed) {
+    int TC = 0;
+    synctex_node_p input = synctex_scanner_input(scanner);
+    int line;
+    while (input) {
+        const char * name = synctex_scanner_get_name(scanner,synctex_node_tag(input));
+        for (line = 1; line <= synctex_node_line(input)+2; ++line) {
+            synctex_iterator_p I1 = _synctex_iterator_new_display(scanner,name,line,0,line%5-1,synctex_NO);
+            synctex_iterator_p I2 = _synctex_iterator_new_display(indexed,name,line,0,line%5-1,synctex_YES);
+            synctex_node_p N1, N2;
+            SYNCTEX_TEST_BODY(TC, synctex_iterator_count(I1) == synctex_iterator_count(I2),
+                              "Display index count mismatch %s:%i\n",name,line);
+            do {
+                N1 = synctex_iterator_next_result(I1);
+                N2 = synctex_iterator_next_result(I2);
+                SYNCTEX_TEST_BODY(TC, synctex_node_page(N1) == synctex_node_page(N2)
+                                  && synctex_node_h(N1) == synctex_node_h(N2)
+                                  && synctex_node_v(N1) == synctex_node_v(N2),
+                                  "Display index mismatch %s:%i\n",name,line);
+            } while (N1 && N2);
+            synctex_iterator_free(I1);
+            synctex_iterator_free(I2);
+        }
+        input = synctex_node_sibling(input);
     }
+    return TC;
 }
-
-synctex_updater_p synctex_updater_new_with_output_file(const char * output, const char * build_directory) {
-    synctex_updater_p updater = NULL;
-    const char * mode = NULL;
-    synctex_open_s open;
-    /*  prepare the updater, the memory is the only one dynamically allocated */
-    updater = (synctex_updater_p)_synctex_malloc(sizeof(synctex_updater_s));
-    if (NULL == updater) {
-        _synctex_error("!  synctex_updater_new_with_file: malloc problem");
-        return NULL;
-    }
-    open = _synctex_open_v2(output,build_directory,0,synctex_ADD_QUOTES);
-    if (open.status < SYNCTEX_STATUS_OK) {
-        open = _synctex_open_v2(output,build_directory,0,synctex_DONT_ADD_QUOTES);
-        if (open.status < SYNCTEX_STATUS_OK) {
-        return_on_error:
-            _synctex_free(updater);
-            return updater = NULL;
+/*  Nodes of line 2 with different columns. */
+static char * _synctex_test_column_content =
+"SyncTeX Version:1\n"
+"Input:1:./1.tex\n"
+"Output:pdf\n"
+"Magnification:1000\n"
+"Unit:1\n"
+"X Offset:0\n"
+"Y Offset:0\n"
+"Content:\n"
+"!1\n"
+"{1\n"
+"[1,1:0,0:10,10,0\n"
+"(1,2:0,1:10,1,0\n"
+"g1,2,3:1,1\n"
+"g1,2,7:2,1\n"
+"g1,2,3:3,1\n"
+")\n"
+"]\n"
+"}1\n"
+"Postamble:\n"
+"Count:5\n"
+"Post scriptum:\n";
+int synctex_test_display_index() {
+    int TC = 0;
+    char * content = _synctex_test_dense_content(5,10);
+    char * contents[2] = {_synctex_test_chunked_content, content};
+    int i, options;
+    synctex_test_sn_s sn;
+    for (i = 0; i < 2; ++i) {
+        sn = (synctex_test_sn_s){0,""};
+        if (contents[i]) {
+            sn = synctex_test_tmp_sn(contents[i]);
+        }
+        if (sn.s>0) {
+            for (options = 0; options <= synctex_parse_option_lazy; options += synctex_parse_option_lazy) {
+                synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+                synctex_scanner_p indexed = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+                synctex_scanner_set_parse_options(indexed, options);
+                indexed = synctex_scanner_parse(indexed);
+                SYNCTEX_TEST_BODY(TC, scanner && indexed, "Parse failure\n");
+                if (scanner && indexed) {
+                    TC += _synctex_test_compare_displays(scanner,indexed);
+                }
+                TC += synctex_scanner_free(scanner);
+                TC += synctex_scanner_free(indexed);
+            }
+            unlink(sn.n);
+        } else {
+            ++TC;
         }
     }
-    /*  OK, the file exists, we close it and reopen it with the correct mode.
-     *  The receiver is now the owner of the "synctex" variable. */
-    gzclose(open.file);
-    updater->file.as_ptr = NULL;
-    mode = _synctex_get_io_mode_name(open.io_mode|synctex_io_append_mask);/* either "a" or "ab", depending on the file extension */
-    if (open.io_mode&synctex_io_gz_mask) {
-        if (NULL == (updater->file.as_FILE_p = fopen(open.synctex,mode))) {
-        no_write_error:
-            _synctex_error("!  synctex_updater_new_with_file: Can't append to %s",open.synctex);
-            free(open.synctex);
-            goto return_on_error;
+    free(content);
+    sn = synctex_test_tmp_sn(_synctex_test_column_content);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        synctex_node_p node;
+        int count = synctex_display_query(scanner,"./1.tex",2,0,-1);
+        SYNCTEX_TEST_BODY(TC, count > 0, "No result for line 2\n");
+        SYNCTEX_TEST_BODY(TC, synctex_display_query(scanner,"./1.tex",2,9,-1) == count, "Unknown column\n");
+        SYNCTEX_TEST_BODY(TC, synctex_display_query(scanner,"./1.tex",2,7,-1) > 0, "No result for column 7\n");
+        while ((node = synctex_scanner_next_result(scanner))) {
+            SYNCTEX_TEST_BODY(TC, synctex_node_column(node) == 7, "Bad column %i\n",synctex_node_column(node));
         }
-        updater->print = &_synctex_updater_print;
-        updater->close = &_synctex_updater_close;
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
     } else {
-        if (NULL == (updater->file.as_gzFile = gzopen(open.synctex,mode))) {
-            goto no_write_error;
+        ++TC;
+    }
+    return TC;
+}
+/**
+ *  Compare the display query throughput with and without the display index
+ *  on a synthetic synctex file with the given number of pages.
+ */
+int synctex_bench_display_index(int number_of_pages) {
+    int TC = 0;
+    char * content = _synctex_test_synthetic_content(number_of_pages);
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        const char * names[2] = {"./main.tex","./chapter.tex"};
+        double t0, linear = 0, build = 0, indexed = 0;
+        int i, line, number_of_displays = 0;
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            t0 = _synctex_test_now();
+            for (line = 1; line <= 20*number_of_pages+20; ++line) {
+                for (i = 0; i < 2; ++i) {
+                    synctex_iterator_free(_synctex_iterator_new_display(scanner,names[i],line,0,-1,synctex_NO));
+                    ++number_of_displays;
+                }
+            }
+            linear = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            _synctex_scanner_display_index(scanner);
+            build = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            for (line = 1; line <= 20*number_of_pages+20; ++line) {
+                for (i = 0; i < 2; ++i) {
+                    synctex_iterator_free(_synctex_iterator_new_display(scanner,names[i],line,0,-1,synctex_YES));
+                }
+            }
+            indexed = _synctex_test_now()-t0;
         }
-        updater->print = &_synctex_updater_print_gz;
-        updater->close = &_synctex_updater_close_gz;
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+        printf("%i pages: display index build %.3fs\n",number_of_pages,build);
+        printf("display query %.0f queries/s without index, %.0f queries/s with index\n",
+               linear>0? number_of_displays/linear: 0,
+               indexed>0? number_of_displays/indexed: 0);
+    } else {
+        ++TC;
     }
-    printf("SyncTeX: updating %s...",open.synctex);
-    _synctex_free(open.synctex);
-    return updater;
+    return TC;
 }
-
-void synctex_updater_append_magnification(synctex_updater_p updater, char * magnification){
-    if (NULL==updater) {
-        return;
+#   endif
+#   if !defined(_WIN32)
+#       include <sys/resource.h>
+int synctex_test_arena() {
+    int TC = 0;
+    synctex_arena_s arena;
+    char * content = _synctex_test_dense_content(3,40);
+    synctex_test_sn_s sn = {0,""};
+    size_t size;
+    memset(&arena,0,sizeof(arena));
+    for (size = 1; size < 3*SYNCTEX_ARENA_MAX_BLOCK_SIZE; size *= 3) {
+        char * bytes = _synctex_arena_malloc(&arena,size);
+        SYNCTEX_TEST_BODY(TC, bytes && ((uintptr_t)bytes&15) == 0, "Bad arena allocation of %zu bytes\n",size);
+        if (bytes) {
+            SYNCTEX_TEST_BODY(TC, bytes[0] == 0 && bytes[size-1] == 0, "Arena memory not zeroed\n");
+            memset(bytes,0xFF,size);
+        }
     }
-    if (magnification && strlen(magnification)) {
-        updater->length +=
-        updater->print(updater,"Magnification:%s\n",magnification);
+    _synctex_arena_reset(&arena);
+    for (size = 0; size < 1000; ++size) {
+        int * i = _synctex_arena_malloc(&arena,sizeof(int));
+        SYNCTEX_TEST_BODY(TC, i && *i == 0, "Arena memory not zeroed after reset\n");
     }
-}
-
-void synctex_updater_append_x_offset(synctex_updater_p updater, char * x_offset){
-    if (NULL==updater) {
-        return;
+    _synctex_arena_free(&arena);
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
     }
-    if (x_offset && strlen(x_offset)) {
-        updater->length += updater->print(updater,"X Offset:%s\n",x_offset);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            synctex_iterator_p iterators[3];
+            synctex_arena_p arena;
+            int i, page, count = 0;
+            for (page = 1; page <= 3; ++page) {
+                for (i = 0; i < 3; ++i) {
+                    iterators[i] = synctex_iterator_new_edit(scanner,page,10*i,10*i);
+                    SYNCTEX_TEST_BODY(TC, synctex_iterator_has_next(iterators[i]), "No edit result\n");
+                }
+                for (i = 0; i < 3; ++i) {
+                    synctex_iterator_free(iterators[i]);
+                }
+            }
+            for (arena = scanner->spare_arenas; arena; arena = arena->next) {
+                ++count;
+            }
+            SYNCTEX_TEST_BODY(TC, count == 3, "%i query arenas instead of 3\n",count);
+            SYNCTEX_TEST_BODY(TC, scanner->query_arena == NULL, "Pending query arena\n");
+        }
+        TC += synctex_scanner_free(scanner);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
+    return TC;
 }
-
-void synctex_updater_append_y_offset(synctex_updater_p updater, char * y_offset){
-    if (NULL==updater) {
-        return;
+/**
+ *  Report the arena statistics of a synthetic synctex file with the given number of pages:
+ *  the number of allocations for the nodes and for the query results,
+ *  compared to the number of blocks actually allocated,
+ *  the time to free the scanner and the peak resident size of the process.
+ */
+int synctex_bench_arena(int number_of_pages) {
+    int TC = 0;
+    char * content = _synctex_test_synthetic_content(number_of_pages);
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
     }
-    if (y_offset && strlen(y_offset)) {
-        updater->length += updater->print(updater,"Y Offset:%s\n",y_offset);
+    if (sn.s>0) {
+        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            struct rusage usage;
+            synctex_arena_p arena;
+            size_t query_allocations = 0, query_blocks = 0;
+            int page, number_of_queries = 0;
+            double t0;
+            float h, v;
+            for (page = 1; page <= number_of_pages; ++page) {
+                for (h = 0; h < 600; h += 37) {
+                    for (v = 0; v < 800; v += 41) {
+                        synctex_iterator_free(synctex_iterator_new_edit(scanner,page,h,v));
+                        ++number_of_queries;
+                    }
+                }
+                synctex_iterator_free(synctex_iterator_new_display(scanner,"./main.tex",20*page,0,-1));
+                ++number_of_queries;
+            }
+            for (arena = scanner->spare_arenas; arena; arena = arena->next) {
+                query_allocations += arena->number_of_allocations;
+                query_blocks += arena->number_of_blocks;
+            }
+            printf("%i pages: %zu node allocations in %zu blocks of %zu bytes\n",
+                   number_of_pages,scanner->arena.number_of_allocations,
+                   scanner->arena.number_of_blocks,scanner->arena.size);
+            printf("%i queries: %zu handle allocations in %zu blocks\n",
+                   number_of_queries,query_allocations,query_blocks);
+            t0 = _synctex_test_now();
+            TC += synctex_scanner_free(scanner);
+            printf("scanner free %.3fms\n",1e3*(_synctex_test_now()-t0));
+            if (getrusage(RUSAGE_SELF,&usage) == 0) {
+#           if defined(__APPLE__)
+                printf("peak resident size %ld KB\n",(long)usage.ru_maxrss/1024);
+#           else
+                printf("peak resident size %ld KB\n",(long)usage.ru_maxrss);
+#           endif
+            }
+        }
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
+    return TC;
 }
-
-void synctex_updater_free(synctex_updater_p updater){
-    if (NULL==updater) {
-        return;
+#   endif
+#   if !defined(_WIN32)
+/**
+ *  The synthetic content of _synctex_test_dense_content as if the document was typeset again
+ *  after an edit: a new first page is inserted, such that all the page numbers change,
+ *  and the first glue of the given page becomes a boundary.
+ *  The form refs are removed when refs is no, such that all the sheets can be reused.
+ *  - returns: a string to be freed by the caller.
+ */
+static char * _synctex_test_retypeset_content(const char * content, int edited_page, synctex_bool_t refs) {
+    char * result = (char *)malloc(strlen(content)+64);
+    char * ptr = result;
+    int page = 0;
+    synctex_bool_t edited = synctex_NO;
+    if (NULL == result) {
+        return NULL;
     }
-    if (updater->length>0) {
-        updater->print(updater,"!%i\n",updater->length);
+    while (*content) {
+        const char * next = strchr(content,'\n');
+        next = next? next+1: content+strlen(content);
+        switch (*content) {
+            case SYNCTEX_CHAR_BEGIN_SHEET:
+                page = (int)strtol(content+1,NULL,10);
+                if (page == 1) {
+                    ptr += sprintf(ptr,"{1\n[1,1:0,0:0,0,0\n]\n}1\n");
+                }
+                ptr += sprintf(ptr,"{%i\n",page+1);
+                break;
+            case SYNCTEX_CHAR_END_SHEET:
+                ptr += sprintf(ptr,"}%i\n",(int)strtol(content+1,NULL,10)+1);
+                break;
+            case SYNCTEX_CHAR_FORM_REF:
+                if (refs) {
+                    memcpy(ptr,content,next-content);
+                    ptr += next-content;
+                }
+                break;
+            case SYNCTEX_CHAR_GLUE:
+                if (page == edited_page && !edited) {
+                    *ptr++ = SYNCTEX_CHAR_BOUNDARY;
+                    ++content;
+                    edited = synctex_YES;
+                }
+            default:
+                memcpy(ptr,content,next-content);
+                ptr += next-content;
+        }
+        content = next;
     }
-    updater->close(updater);
-    _synctex_free(updater);
-    printf("... done.\n");
-    return;
+    *ptr = '\0';
+    return result;
 }
-#endif
-
-#if defined(SYNCTEX_TESTING)
-#	ifdef SYNCTEX_NOTHING
-#       pragma mark -
-#       pragma mark Testers
-#   endif
 /**
- *  The next nodes corresponds to a deep first tree traversal.
- *  Does not create child proxies as side effect contrary to
- *  the synctex_node_next method above.
- *  May loop infinitely many times if the tree
- *  is not properly built (contains loops).
+ *  A lazy scanner of the given file, with all its sheets parsed.
  */
-static synctex_node_p _synctex_node_next(synctex_node_p node) {
-    synctex_node_p N = _synctex_tree_child(node);
-    if (N) {
-        return N;
+static synctex_scanner_p _synctex_test_lazy_scanner(const char * path, synctex_scanner_p previous) {
+    synctex_scanner_p scanner = synctex_scanner_new_with_output_file(path, NULL, synctex_NO);
+    int page;
+    synctex_scanner_set_parse_options(scanner, synctex_parse_option_lazy);
+    if (previous) {
+        synctex_scanner_set_previous(scanner, previous);
     }
-    return _synctex_node_sibling_or_parents(node);
-}
-static int _synctex_input_copy_name(synctex_node_p input, char * name) {
-    char * copy = _synctex_malloc(strlen(name)+1);
-    memcpy(copy,name,strlen(name)+1);
-    _synctex_data_set_name(input,copy);
-    return 0;
+    if ((scanner = synctex_scanner_parse(scanner))) {
+        for (page = 1; synctex_sheet(scanner,page); ++page) {}
+    }
+    return scanner;
 }
-int synctex_test_setup_scanner_sheets_421(synctex_scanner_p scanner) {
+int synctex_test_reload() {
     int TC = 0;
-    synctex_node_p sheet = synctex_node_new(scanner,synctex_node_type_sheet);
-    _synctex_data_set_page(sheet,4);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==4,"");
-    synctex_node_free(scanner->sheet);
-    scanner->sheet = sheet;
-    sheet = synctex_node_new(scanner,synctex_node_type_sheet);
-    _synctex_data_set_page(sheet,2);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==2,"");
-    __synctex_tree_set_sibling(sheet, scanner->sheet);
-    scanner->sheet = sheet;
-    sheet = synctex_node_new(scanner,synctex_node_type_sheet);
-    _synctex_data_set_page(sheet,1);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet)==1,"");
-    __synctex_tree_set_sibling(sheet, scanner->sheet);
-    scanner->sheet = sheet;
+    char * content = _synctex_test_dense_content(4,10);
+    int refs;
+    for (refs = 0; refs < 2 && content; ++refs) {
+        /*  The initial content is the retypeset content of nothing. */
+        char * before = _synctex_test_retypeset_content(content,0,refs);
+        char * after = before? _synctex_test_retypeset_content(before,3,refs): NULL;
+        synctex_test_sn_s sn1 = {0,""}, sn2 = {0,""};
+        if (after) {
+            sn1 = synctex_test_tmp_sn(before);
+            sn2 = synctex_test_tmp_sn(after);
+        }
+        if (sn1.s>0 && sn2.s>0) {
+            synctex_scanner_p serial = synctex_scanner_new_with_output_file(sn2.n, NULL, synctex_YES);
+            synctex_scanner_p previous = _synctex_test_lazy_scanner(sn1.n,NULL);
+            synctex_scanner_p scanner = NULL;
+            SYNCTEX_TEST_BODY(TC, serial && previous && previous->lazy, "Parse failure\n");
+            scanner = _synctex_test_lazy_scanner(sn2.n,previous);
+            SYNCTEX_TEST_BODY(TC, scanner && scanner->lazy && scanner->lazy->number_of_sheets == 6, "Reload failure\n");
+            if (serial && scanner) {
+                /*  All the sheets but the new and the edited ones, unless they refer to forms. */
+                int reused = scanner->reload? scanner->reload->number_of_reused_sheets: 0;
+                SYNCTEX_TEST_BODY(TC, reused == (refs? 1: 4), "%i sheets reused\n",reused);
+                TC += _synctex_test_compare_queries(serial,scanner);
+            }
+            TC += synctex_scanner_free(serial);
+            TC += synctex_scanner_free(scanner);
+        } else {
+            ++TC;
+        }
+        if (sn1.s>0) {
+            unlink(sn1.n);
+        }
+        if (sn2.s>0) {
+            unlink(sn2.n);
+        }
+        free(before);
+        free(after);
+    }
+    free(content);
     return TC;
 }
-int synctex_test_input(synctex_scanner_p scanner) {
+/**
+ *  Compare a lazy parse of all the pages of a synthetic synctex file after an edit
+ *  with a reload from the scanner of the file before the edit.
+ */
+int synctex_bench_reload(int number_of_pages) {
     int TC = 0;
-    synctex_node_p input = synctex_node_new(scanner,synctex_node_type_input);
-    _synctex_data_set_tag(input,421);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==421,"");
-    _synctex_data_set_tag(input,124);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==124,"");
-    _synctex_data_set_line(input,421);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==421,"");
-    _synctex_data_set_line(input,214);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==214,"");
-    _synctex_data_set_line(input,214);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==214,"");
-    _synctex_input_copy_name(input,"214");
-    SYNCTEX_TEST_BODY(TC, 0==memcmp(_synctex_data_name(input),"214",4),"");
-    _synctex_input_copy_name(input,"421421");
-
-    SYNCTEX_TEST_BODY(TC,
-                      0==memcmp(_synctex_data_name(input),
-                                "421421",
-                                4),
-                      "");
-    synctex_node_free(input);
+    char * content = _synctex_test_dense_content(number_of_pages,40);
+    char * before = content? _synctex_test_retypeset_content(content,0,synctex_NO): NULL;
+    char * after = before? _synctex_test_retypeset_content(before,number_of_pages/2,synctex_NO): NULL;
+    synctex_test_sn_s sn1 = {0,""}, sn2 = {0,""};
+    if (after) {
+        sn1 = synctex_test_tmp_sn(before);
+        sn2 = synctex_test_tmp_sn(after);
+    }
+    if (sn1.s>0 && sn2.s>0) {
+        synctex_scanner_p scanner;
+        double t0, parse, reload;
+        t0 = _synctex_test_now();
+        scanner = _synctex_test_lazy_scanner(sn2.n,NULL);
+        parse = _synctex_test_now()-t0;
+        TC += synctex_scanner_free(scanner);
+        scanner = _synctex_test_lazy_scanner(sn1.n,NULL);
+        t0 = _synctex_test_now();
+        scanner = _synctex_test_lazy_scanner(sn2.n,scanner);
+        reload = _synctex_test_now()-t0;
+        SYNCTEX_TEST_BODY(TC, scanner && scanner->reload, "Reload failure\n");
+        printf("%i pages: full parse %.3fs, reload %.3fs, %i sheets reused\n",number_of_pages+2,parse,reload,
+               scanner && scanner->reload? scanner->reload->number_of_reused_sheets: 0);
+        TC += synctex_scanner_free(scanner);
+    } else {
+        ++TC;
+    }
+    if (sn1.s>0) {
+        unlink(sn1.n);
+    }
+    if (sn2.s>0) {
+        unlink(sn2.n);
+    }
+    free(content);
+    free(before);
+    free(after);
     return TC;
 }
-int synctex_test_proxy(synctex_scanner_p scanner) {
-    int TC = 0;
-    synctex_node_p proxy = synctex_node_new(scanner,synctex_node_type_proxy);
-    synctex_node_p target = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_tree_set_target(proxy,target);
-    _synctex_data_set_tag(target,421);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==421,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==421,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(proxy)==421,"");
-    synctex_node_free(proxy);
-    synctex_node_free(target);
-    return TC;
+#   endif
+#   if !defined(_WIN32)
+/*  The tokenizers available on this machine, synctex_tokenizer_bytes first. */
+static int _synctex_test_tokenizers(synctex_tokenizer_t * tokenizers) {
+    synctex_tokenizer_t best = _synctex_tokenizer_best();
+    int i = 0;
+    tokenizers[i++] = synctex_tokenizer_bytes;
+#       if defined(SYNCTEX_USE_SWAR)
+    tokenizers[i++] = synctex_tokenizer_swar;
+#       endif
+    if (best>=synctex_tokenizer_simd128) {
+        tokenizers[i++] = synctex_tokenizer_simd128;
+    }
+    if (best>=synctex_tokenizer_simd256) {
+        tokenizers[i++] = synctex_tokenizer_simd256;
+    }
+    return i;
 }
-int synctex_test_handle(synctex_scanner_p scanner) {
+static const char * _synctex_test_tokenizer_names[] = {"bytes","swar","simd128","simd256"};
+int synctex_test_tokenizer() {
     int TC = 0;
-    synctex_node_p handle = synctex_node_new(scanner,synctex_node_type_handle);
-    synctex_node_p proxy = synctex_node_new(scanner, synctex_node_type_proxy);
-    synctex_node_p target = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_tree_set_target(handle,target);
-    _synctex_data_set_tag(target,421);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==421,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==421,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(handle)==421,"");
-    _synctex_data_set_line(target,214);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(target)==214,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_line(target)==214,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_line(handle)==214,"");
-    _synctex_data_set_column(target,142);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_column(target)==142,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_column(target)==142,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_column(handle)==142,"");
-    _synctex_tree_set_target(proxy,target);
-    _synctex_tree_set_target(handle,proxy);
-    _synctex_data_set_tag(target,412);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(target)==412,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(target)==412,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_tag(handle)==412,"");
-    _synctex_data_set_line(target,124);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(target)==124,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_line(target)==124,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_line(handle)==124,"");
-    _synctex_data_set_column(target,241);
-    SYNCTEX_TEST_BODY(TC, _synctex_data_column(target)==241,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_column(target)==241,"");
-    SYNCTEX_TEST_BODY(TC, synctex_node_column(handle)==241,"");
-    synctex_node_free(handle);
-    synctex_node_free(proxy);
-    synctex_node_free(target);
+    static const char alphabet[] = "0123456789999-::,,\n=+ x\xB9\xFF";
+    synctex_tokenizer_t tokenizers[4];
+    int number_of_tokenizers = _synctex_test_tokenizers(tokenizers);
+    char buffer[257];
+    unsigned seed = 1;
+    int round, i, j;
+    for (round = 0; round < 2000; ++round) {
+        int size = round%sizeof(buffer);
+        for (i = 0; i < size; ++i) {
+            seed = seed*1103515245+12345;
+            /*  Long runs of digits and few newlines. */
+            buffer[i] = alphabet[(seed>>16)%(round&1? sizeof(alphabet)-1: 13)];
+        }
+        buffer[size] = '\0';
+        for (i = 0; i <= size; ++i) {
+            char * end = NULL;
+            int value = (int)strtol(buffer+i,&end,10);
+            const char * eol = memchr(buffer+i,'\n',size-i);
+            for (j = 0; j < number_of_tokenizers; ++j) {
+                int v = 0;
+                char * e;
+                _synctex_tokenizer = tokenizers[j];
+                SYNCTEX_TEST_BODY(TC, _synctex_tokenizer_newline(buffer+i,buffer+size) == eol,
+                                  "%s: bad newline at %i\n",_synctex_test_tokenizer_names[j],i);
+                e = _synctex_tokenizer_int(buffer+i,buffer+size,&v);
+                SYNCTEX_TEST_BODY(TC, e == end && v == value,
+                                  "%s: bad int at %i (%i/%i)\n",_synctex_test_tokenizer_names[j],i,v,value);
+            }
+        }
+    }
+    _synctex_tokenizer = synctex_tokenizer_auto;
+    {
+        char * content = _synctex_test_dense_content(4,10);
+        synctex_test_sn_s sn = {0,""};
+        if (content) {
+            sn = synctex_test_tmp_sn(content);
+            free(content);
+        }
+        if (sn.s>0) {
+            synctex_scanner_p reference;
+            _synctex_tokenizer = synctex_tokenizer_bytes;
+            reference = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+            for (j = 1; j < number_of_tokenizers; ++j) {
+                synctex_scanner_p scanner;
+                _synctex_tokenizer = tokenizers[j];
+                scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
+                SYNCTEX_TEST_BODY(TC, reference && scanner, "Parse failure\n");
+                if (reference && scanner) {
+                    TC += _synctex_test_compare_queries(reference,scanner);
+                }
+                TC += synctex_scanner_free(scanner);
+            }
+            _synctex_tokenizer = synctex_tokenizer_auto;
+            TC += synctex_scanner_free(reference);
+            unlink(sn.n);
+        } else {
+            ++TC;
+        }
+    }
     return TC;
 }
-int synctex_test_setup_scanner_input(synctex_scanner_p scanner) {
+/*  Decode all the integers of all the lines, like the parser does. */
+static long _synctex_test_tokenize(const char * ptr, const char * end) {
+    long sum = 0;
+    while (ptr<end) {
+        const char * eol = _synctex_tokenizer_newline(ptr,end);
+        char * next;
+        int value;
+        if (NULL == eol) {
+            eol = end;
+        }
+        /*  Skip the record type */
+        ++ptr;
+        while (ptr<eol) {
+            if (*ptr == ':' || *ptr == ',') {
+                ++ptr;
+            }
+            if ((next = _synctex_tokenizer_int(ptr,end,&value)) == ptr) {
+                break;
+            }
+            sum += value;
+            ptr = next;
+        }
+        ptr = eol+1;
+    }
+    return sum;
+}
+/**
+ *  Report the throughput in MB/s of the available tokenizers,
+ *  for the raw tokenization of the lines and for a full parse,
+ *  over a synthetic synctex file with the given number of pages
+ *  and over the given synctex file when path is not NULL.
+ */
+int synctex_bench_tokenizer(const char * path, int number_of_pages) {
     int TC = 0;
-    synctex_node_p input = synctex_node_new(scanner,synctex_node_type_input);
-    _synctex_data_set_tag(input,4);
-    _synctex_input_copy_name(input,"21");
-    _synctex_data_set_line(input,421);
-    synctex_node_free(scanner->input);
-    scanner->input = input;
-    SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input)==4,"");
-    SYNCTEX_TEST_BODY(TC, strcmp(_synctex_data_name(input),"21")==0,"");
-    SYNCTEX_TEST_BODY(TC, _synctex_data_line(input)==421,"");
+    synctex_tokenizer_t tokenizers[4];
+    int number_of_tokenizers = _synctex_test_tokenizers(tokenizers);
+    char * corpora[2] = {_synctex_test_dense_content(number_of_pages,10), NULL};
+    const char * names[2] = {"synthetic", path};
+    int c, j;
+    if (path) {
+        FILE * file = fopen(path,"r");
+        long size;
+        if (file && fseek(file,0,SEEK_END) == 0 && (size = ftell(file))>0
+            && (corpora[1] = malloc(size+1)) && fseek(file,0,SEEK_SET) == 0
+            && fread(corpora[1],1,size,file) == (size_t)size) {
+            corpora[1][size] = '\0';
+        } else {
+            free(corpora[1]);
+            corpora[1] = NULL;
+            ++TC;
+        }
+        if (file) {
+            fclose(file);
+        }
+    }
+    for (c = 0; c < 2; ++c) {
+        synctex_test_sn_s sn = {0,""};
+        size_t size;
+        long reference = 0;
+        if (NULL == corpora[c]) {
+            continue;
+        }
+        size = strlen(corpora[c]);
+        sn = synctex_test_tmp_sn(corpora[c]);
+        for (j = 0; j < number_of_tokenizers; ++j) {
+            double t0, tokenize, parse;
+            long sum = 0;
+            int i;
+            _synctex_tokenizer = tokenizers[j];
+            t0 = _synctex_test_now();
+            for (i = 0; i < 10; ++i) {
+                sum += _synctex_test_tokenize(corpora[c],corpora[c]+size);
+            }
+            tokenize = (_synctex_test_now()-t0)/10;
+            if (j == 0) {
+                reference = sum;
+            }
+            SYNCTEX_TEST_BODY(TC, sum == reference, "%s: tokenizer mismatch\n",_synctex_test_tokenizer_names[tokenizers[j]]);
+            parse = 0;
+            if (sn.s>0) {
+                t0 = _synctex_test_now();
+                TC += synctex_scanner_free(synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES));
+                parse = _synctex_test_now()-t0;
+            }
+            printf("%s, %.1f MB, %s: tokenize %.0f MB/s, parse %.0f MB/s\n",names[c],size/1e6,
+                   _synctex_test_tokenizer_names[tokenizers[j]],size/1e6/tokenize,parse>0? size/1e6/parse: 0);
+        }
+        _synctex_tokenizer = synctex_tokenizer_auto;
+        if (sn.s>0) {
+            unlink(sn.n);
+        }
+        free(corpora[c]);
+    }
     return TC;
 }
-int synctex_test_setup_nodes(synctex_scanner_p scanner, synctex_node_r nodes) {
-    int TC = 0;
-    int n;
-    for (n=0;n<synctex_node_number_of_types;++n) {
-        nodes[n] = synctex_node_new(scanner,n);
-        SYNCTEX_TEST_BODY(TC, nodes[n]!=NULL,"");
+#   endif
+#   if defined(SYNCTEX_USE_THREADED_INFLATE)
+/*  Write the given content to a new gzip file made of the given number of members.
+ *  - returns: a positive value on success, name is then the path of the file. */
+static int _synctex_test_tmp_gz(const char * content, int number_of_members, char * name) {
+    size_t size = strlen(content), done = 0;
+    int fd, i;
+    strcpy(name,"/tmp/test.XXXXXX.synctex.gz");
+    if ((fd = mkstemps(name,11))<0) {
+        fprintf(stderr, "%s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    close(fd);
+    for (i = 1; i <= number_of_members; ++i) {
+        /*  Appending to a gzip file starts a new member. */
+        gzFile file = gzopen(name,i>1? "ab": "wb");
+        size_t next = size*i/number_of_members;
+        if (NULL == file || (next>done && gzwrite(file,content+done,(unsigned)(next-done)) <= 0)) {
+            if (file) {
+                gzclose(file);
+            }
+            unlink(name);
+            return -2;
+        }
+        gzclose(file);
+        done = next;
     }
-    return TC;
+    return 1;
 }
-int synctex_test_teardown_nodes(synctex_scanner_p scanner, synctex_node_r nodes) {
-    int n;
-    for (n=0;n<synctex_node_number_of_types;++n) {
-        synctex_node_free(nodes[n]);
-        nodes[n]=NULL;
+static synctex_scanner_p _synctex_test_inflate_scanner(const char * path, int options) {
+    /*  The scanner looks for the compressed file after the uncompressed one. */
+    char output[32];
+    synctex_scanner_p scanner;
+    size_t length = strlen(path);
+    if (length>=sizeof(output)) {
+        return NULL;
     }
-    return 1;
+    strcpy(output,path);
+    if (length>3 && !strcmp(output+length-3,".gz")) {
+        output[length-3] = '\0';
+    }
+    scanner = synctex_scanner_new_with_output_file(output, NULL, synctex_NO);
+    synctex_scanner_set_parse_options(scanner, options);
+    return synctex_scanner_parse(scanner);
 }
-int synctex_test_tree(synctex_scanner_p scanner) {
+int synctex_test_inflate() {
     int TC = 0;
-    synctex_node_p nodes1[synctex_node_number_of_types];
-    synctex_node_p nodes2[synctex_node_number_of_types];
-    synctex_node_p nodes3[synctex_node_number_of_types];
-    int i,j;
-    TC += synctex_test_setup_nodes(scanner,nodes1);
-    TC += synctex_test_setup_nodes(scanner,nodes2);
-    TC += synctex_test_setup_nodes(scanner,nodes3);
-    /*  Every node has a sibling */
-    for (i=0;i<synctex_node_number_of_types;++i) {
-        for (j=0;j<synctex_node_number_of_types;++j) {
-            _synctex_tree_set_sibling(nodes1[i],nodes2[i]);
-            SYNCTEX_TEST_BODY(TC, nodes2[i]==synctex_node_sibling(nodes1[i]),"");
+    char * content = _synctex_test_dense_content(6,10);
+    synctex_test_sn_s sn = {0,""};
+    int number_of_members[] = {1,3,7};
+    int i, options;
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+    }
+    if (sn.s>0) {
+        synctex_scanner_p serial = _synctex_test_inflate_scanner(sn.n,0);
+        SYNCTEX_TEST_BODY(TC, serial, "Parse failure\n");
+        for (i = 0; serial && i < 3; ++i) {
+            char name[32];
+            if (_synctex_test_tmp_gz(content,number_of_members[i],name)<=0) {
+                ++TC;
+                continue;
+            }
+            if (i == 2) {
+                /*  Trailing garbage is ignored. */
+                FILE * file = fopen(name,"a");
+                if (file) {
+                    fputs("\x1f\x8b\x08 garbage",file);
+                    fclose(file);
+                }
+            }
+            for (options = 0; options < 2; ++options) {
+                synctex_scanner_p scanner = _synctex_test_inflate_scanner(name,
+                    synctex_parse_option_threaded_inflate|(options? synctex_parse_option_lazy: 0));
+                SYNCTEX_TEST_BODY(TC, scanner, "%i members: parse failure\n",number_of_members[i]);
+                if (scanner) {
+                    SYNCTEX_TEST_BODY(TC, scanner->count == serial->count, "%i members: bad count\n",number_of_members[i]);
+                    TC += _synctex_test_compare_queries(serial,scanner);
+                }
+                TC += synctex_scanner_free(scanner);
+            }
+            unlink(name);
         }
+        TC += synctex_scanner_free(serial);
+        unlink(sn.n);
+    } else {
+        ++TC;
     }
-    synctex_test_teardown_nodes(scanner,nodes3);
-    synctex_test_teardown_nodes(scanner,nodes2);
-    synctex_test_teardown_nodes(scanner,nodes1);
-    return TC;
-}
-int synctex_test_page(synctex_scanner_p scanner) {
-    int TC = synctex_test_setup_scanner_sheets_421(scanner);
-    synctex_node_p sheet = scanner->sheet;
-    synctex_node_p node = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_data_set_tag(node,4);
-    _synctex_data_set_line(node,21);
-    synctex_node_free(_synctex_node_set_child(sheet,node));
-    SYNCTEX_TEST_BODY(TC, synctex_node_page(node)==synctex_node_page(sheet),"");
+    free(content);
     return TC;
 }
-int synctex_test_display_query(synctex_scanner_p scanner) {
-    int TC = synctex_test_setup_scanner_sheets_421(scanner);
-    synctex_node_p sheet = scanner->sheet;
-    synctex_node_p node = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_data_set_tag(node,4);
-    _synctex_data_set_line(node,21);
-    synctex_node_free(_synctex_node_set_child(sheet,node));
-    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
-    __synctex_node_make_friend_tlc(node);
-    SYNCTEX_TEST_BODY(TC, _synctex_scanner_friend(scanner, 25)==node,"");
-    sheet = __synctex_tree_sibling(sheet);
-    node = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_data_set_tag(node,4);
-    _synctex_data_set_line(node,21);
-    synctex_node_free(_synctex_node_set_child(sheet,node));
-    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
-    __synctex_node_make_friend_tlc(node);
-    SYNCTEX_TEST_BODY(TC, _synctex_scanner_friend(scanner, 25)==node,"");
-    sheet = __synctex_tree_sibling(sheet);
-    node = synctex_node_new(scanner,synctex_node_type_rule);
-    _synctex_data_set_tag(node,4);
-    _synctex_data_set_line(node,21);
-    synctex_node_free(_synctex_node_set_child(sheet,node));
-    SYNCTEX_TEST_BODY(TC, node==synctex_node_child(sheet),"");
-    __synctex_node_make_friend_tlc(node);
-    SYNCTEX_TEST_BODY(TC, (_synctex_scanner_friend(scanner, 25)==node),"");
-    synctex_test_setup_scanner_input(scanner);
-    scanner->flags.has_parsed = synctex_YES;
-#if 1
-    SYNCTEX_TEST_BODY(TC, (synctex_display_query(scanner,"21",21,4,-1)==3),"");
-#endif
+/**
+ *  Report the time to load a compressed synthetic synctex file with the given number of pages,
+ *  with and without synctex_parse_option_threaded_inflate,
+ *  for a single gzip member and for several members.
+ */
+int synctex_bench_inflate(int number_of_pages) {
+    int TC = 0;
+    char * content = _synctex_test_dense_content(number_of_pages,40);
+    int number_of_members[] = {1,8};
+    int i, lazy, threaded;
+    for (i = 0; content && i < 2; ++i) {
+        char name[32];
+        if (_synctex_test_tmp_gz(content,number_of_members[i],name)<=0) {
+            ++TC;
+            continue;
+        }
+        for (lazy = 0; lazy < 2; ++lazy) {
+            double times[2];
+            for (threaded = 0; threaded < 2; ++threaded) {
+                synctex_scanner_p scanner;
+                double t0 = _synctex_test_now();
+                scanner = _synctex_test_inflate_scanner(name,
+                    (lazy? synctex_parse_option_lazy: 0)|(threaded? synctex_parse_option_threaded_inflate: 0));
+                times[threaded] = _synctex_test_now()-t0;
+                SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+                TC += synctex_scanner_free(scanner);
+            }
+            printf("%i pages, %.1f MB, %i gzip members%s: %.3fs, threaded inflate %.3fs\n",
+                   number_of_pages,strlen(content)/1e6,number_of_members[i],lazy? ", lazy": "",times[0],times[1]);
+        }
+        unlink(name);
+    }
+    if (NULL == content) {
+        ++TC;
+    }
+    free(content);
     return TC;
 }
-typedef struct {
-    int s;      /* status */
-    char n[25]; /* name */
-} synctex_test_sn_s;
-
-synctex_test_sn_s synctex_test_tmp_sn(char * content) {
-    synctex_test_sn_s sn = {0, "/tmp/test.XXXXXX.synctex"};
-    FILE *sfp;
-    int fd = mkstemps(sn.n,8);
-    if (fd < 0) {
-        fprintf(stderr, "%s: %s\n", sn.n, strerror(errno));
-        sn.s = -1;
-        return sn;
+#   endif
+#   if !defined(_WIN32)
+/**
+ *  A synthetic synctex content with the given number of inputs and pages,
+ *  half of the inputs are declared in the preamble, the others before the pages using them.
+ *  Each page has 40 lines, spread over all the inputs.
+ *  - returns: a string to be freed by the caller.
+ */
+static char * _synctex_test_inputs_content(int number_of_inputs, int number_of_pages) {
+    size_t capacity = 1024+(size_t)number_of_inputs*64+(size_t)number_of_pages*(64+40*96);
+    char * content = (char *)malloc(capacity);
+    char * ptr = content;
+    int page, line, tag, declared = number_of_inputs/2;
+    if (NULL == content) {
+        return NULL;
     }
-    if ((sfp = fdopen(fd, "w+")) == NULL) {
-        unlink(sn.n);
-        close(fd);
-        fprintf(stderr, "%s: %s\n", sn.n, strerror(errno));
-        sn.s = -2;
-        return sn;
+#       define SYNCTEX_TEST_PRINT(...) ptr += snprintf(ptr,capacity-(ptr-content),__VA_ARGS__)
+    SYNCTEX_TEST_PRINT("SyncTeX Version:1\n");
+    for (tag = 1; tag <= declared; ++tag) {
+        SYNCTEX_TEST_PRINT("Input:%i:./input%i.tex\n",tag,tag);
+    }
+    SYNCTEX_TEST_PRINT("Output:pdf\nMagnification:1000\nUnit:1\nX Offset:0\nY Offset:0\nContent:\n");
+    for (page = 1; page <= number_of_pages; ++page) {
+        SYNCTEX_TEST_PRINT("!%i\n{%i\n[1,%i:0,0:30000000,40000000,0\n",page,page,page);
+        for (line = 0; line < 40; ++line) {
+            tag = 1+((page-1)*40+line)%number_of_inputs;
+            if (tag > declared) {
+                SYNCTEX_TEST_PRINT("Input:%i:./input%i.tex\n",tag,tag);
+                ++declared;
+            }
+            SYNCTEX_TEST_PRINT("(%i,%i:%i,%i:30000000,650000,200000\ng%i,%i:%i,%i\n)\n",
+                               tag,page+line,4736286,4736286+line*1000000,tag,page+line,5000000,4736286+line*1000000);
+        }
+        SYNCTEX_TEST_PRINT("]\n}%i\n",page);
     }
-    sn.s = fputs(content,sfp);
-    printf("temp:%s\n%i\n",sn.n,sn.s);
-    fclose(sfp);
-    if (sn.s==0) {
-        sn.s = -2;
-        unlink(sn.n);
+    SYNCTEX_TEST_PRINT("!0\nPostamble:\nCount:%i\n!0\nPost scriptum:\n",number_of_pages*80);
+#       undef SYNCTEX_TEST_PRINT
+    return content;
+}
+/*  The input with the given tag, as found by walking the input list. */
+static synctex_node_p _synctex_test_linear_input_with_tag(synctex_scanner_p scanner, int tag) {
+    synctex_node_p input = synctex_scanner_input(scanner);
+    while (input && synctex_node_tag(input) != tag && synctex_node_sibling(input)) {
+        input = synctex_node_sibling(input);
     }
-    return sn;
+    return input;
 }
-int synctex_test_sheet_1() {
+int synctex_test_input_table() {
     int TC = 0;
-    char * content =
-    "SyncTeX Version:1  \n" /*00-19*/
-    "Input:1:./1.tex    \n" /*20-39*/
-    "Output:pdf         \n" /*40-59*/
-    "Magnification:100000000      \n" /*60-89*/
-    "Unit:1   \n"           /*90-99*/
-    "X Offset:0         \n" /*00-19*/
-    "Y Offset:0         \n" /*20-39*/
-    "Content: \n"           /*40-49*/
-    "{1       \n"           /*50-59*/
-    "[1,10:20,350:330,330,0       \n" /*60-89*/
-    "]        \n"           /*90-99*/
-    "}        \n"           /*00-09*/
-    "Postamble:\n";
-    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    char * content = _synctex_test_inputs_content(100,12);
+    synctex_test_sn_s sn = {0,""};
+    int options;
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
     if (sn.s>0) {
-        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
-        synctex_node_p node = synctex_scanner_handle(scanner);
-        printf("Created nodes:\n");
-        while (node) {
-            printf("%s\n",_synctex_node_abstract(node));
-            node = synctex_node_next(node);
+        for (options = 0; options <= synctex_parse_option_lazy; options += synctex_parse_option_lazy) {
+            synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+            int tag, line;
+            synctex_scanner_set_parse_options(scanner, options);
+            scanner = synctex_scanner_parse(scanner);
+            SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+            if (scanner) {
+                for (tag = -1; tag <= 102; ++tag) {
+                    SYNCTEX_TEST_BODY(TC, synctex_scanner_input_with_tag(scanner,tag) == _synctex_test_linear_input_with_tag(scanner,tag),
+                                      "Input table mismatch for tag %i\n",tag);
+                }
+                for (tag = 1; tag <= 100; tag += 7) {
+                    char name[32];
+                    snprintf(name,sizeof(name),"./input%i.tex",tag);
+                    for (line = 1; line <= 52; line += 5) {
+                        synctex_iterator_p I1 = synctex_iterator_new_display(scanner,name,line,0,-1);
+                        synctex_iterator_p I2 = synctex_iterator_new_display_tag(scanner,tag,line,0,-1);
+                        synctex_node_p N1, N2;
+                        SYNCTEX_TEST_BODY(TC, synctex_iterator_count(I1) == synctex_iterator_count(I2),
+                                          "Display by tag count mismatch %s:%i\n",name,line);
+                        do {
+                            N1 = synctex_iterator_next_result(I1);
+                            N2 = synctex_iterator_next_result(I2);
+                            SYNCTEX_TEST_BODY(TC, synctex_node_page(N1) == synctex_node_page(N2)
+                                              && synctex_node_h(N1) == synctex_node_h(N2)
+                                              && synctex_node_v(N1) == synctex_node_v(N2),
+                                              "Display by tag mismatch %s:%i\n",name,line);
+                        } while (N1 && N2);
+                        synctex_iterator_free(I1);
+                        synctex_iterator_free(I2);
+                    }
+                }
+                SYNCTEX_TEST_BODY(TC, synctex_display_query_tag(scanner,0,1,0,-1) == 0, "Result for tag 0\n");
+                SYNCTEX_TEST_BODY(TC, synctex_display_query_tag(scanner,101,1,0,-1) == 0, "Result for unknown tag\n");
+            }
+            TC += synctex_scanner_free(scanner);
         }
-        synctex_scanner_free(scanner);
         unlink(sn.n);
     } else {
         ++TC;
     }
     return TC;
 }
-int synctex_test_sheet_2() {
+/**
+ *  Report the parse time of a synthetic synctex file with the given number of inputs,
+ *  and the display query throughput by name and by tag.
+ */
+int synctex_bench_input_table(int number_of_inputs, int number_of_pages) {
     int TC = 0;
-    char * content =
-    "SyncTeX Version:1  \n" /*00-19*/
-    "Input:1:./1.tex    \n" /*20-39*/
-    "Output:pdf         \n" /*40-59*/
-    "Magnification:100000000      \n" /*60-89*/
-    "Unit:1   \n"           /*90-99*/
-    "X Offset:0         \n" /*00-19*/
-    "Y Offset:0         \n" /*20-39*/
-    "Content: \n"           /*40-49*/
-    "{1       \n"           /*50-59*/
-    "(1,10:20,350:330,330,0       \n" /*60-89*/
-    ")        \n"           /*90-99*/
-    "}        \n"           /*00-09*/
-    "Postamble:\n";
-    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
+    char * content = _synctex_test_inputs_content(number_of_inputs,number_of_pages);
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
     if (sn.s>0) {
+        double t0 = _synctex_test_now(), parse, by_name = 0, by_tag = 0;
         synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
-        synctex_node_p node = synctex_scanner_handle(scanner);
-        printf("Created nodes:\n");
-        while (node) {
-            printf("%s\n",_synctex_node_abstract(node));
-            node = _synctex_node_next(node);
+        int tag, number_of_displays = 0;
+        parse = _synctex_test_now()-t0;
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            char name[32];
+            t0 = _synctex_test_now();
+            for (tag = 1; tag <= number_of_inputs; ++tag) {
+                snprintf(name,sizeof(name),"./input%i.tex",tag);
+                synctex_display_query(scanner,name,1+tag%number_of_pages,0,-1);
+                ++number_of_displays;
+            }
+            by_name = _synctex_test_now()-t0;
+            t0 = _synctex_test_now();
+            for (tag = 1; tag <= number_of_inputs; ++tag) {
+                synctex_display_query_tag(scanner,tag,1+tag%number_of_pages,0,-1);
+            }
+            by_tag = _synctex_test_now()-t0;
         }
         TC += synctex_scanner_free(scanner);
         unlink(sn.n);
+        printf("%i inputs, %i pages: parse %.3fs\n",number_of_inputs,number_of_pages,parse);
+        printf("display query %.0f queries/s by name, %.0f queries/s by tag\n",
+               by_name>0? number_of_displays/by_name: 0,
+               by_tag>0? number_of_displays/by_tag: 0);
     } else {
         ++TC;
     }
     return TC;
 }
-int synctex_test_charindex() {
+/*  The result of the batch with the given request, line and page, NULL if none. */
+static const synctex_display_result_s * _synctex_test_batch_result(synctex_display_batch_p batch, int request, int line, int page) {
+    const synctex_display_result_s * results = synctex_display_batch_results(batch);
+    int i;
+    for (i = 0; i < synctex_display_batch_count(batch); ++i) {
+        if (results[i].request == request && results[i].line == line && results[i].page == page) {
+            return results+i;
+        }
+    }
+    return NULL;
+}
+int synctex_test_display_batch() {
     int TC = 0;
-    char * content =
-    "SyncTeX Version:1  \n" /*00-19*/
-    "Input:1:./1.tex    \n" /*20-39*/
-    "Output:pdf         \n" /*40-59*/
-    "Magnification:100000000      \n" /*60-89*/
-    "Unit:1   \n"           /*90-99*/
-    "X Offset:0         \n" /*00-19*/
-    "Y Offset:0         \n" /*20-39*/
-    "Content: \n"           /*40-49*/
-    "{1       \n"           /*50-59*/
-    "[1,10:20,350:330,330,0       \n" /*60-89*/
-    "(1,58:20,100:250,10,5        \n" /*90-119*/
-    "f1000:50,100       \n" /*20-39*/
-    ")        \n"           /*40-49*/
-    "]        \n"           /*50-59*/
-    "}        \n"           /*60-69*/
-    "Postamble:\n";
-    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
-    if (sn.s>0) {
-        synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
-        synctex_node_p node = synctex_scanner_handle(scanner);
-        printf("Created nodes:\n");
-        while (node) {
-            printf("%s\n",_synctex_node_abstract(node));
-            node = synctex_node_next(node);
+    int number_of_pages = 6;
+    int number_of_lines = 20*number_of_pages+20;
+    int number_of_requests = 2*number_of_lines+5;
+    char * content = _synctex_test_dense_content(number_of_pages,10);
+    synctex_display_request_s * requests = (synctex_display_request_s *)malloc(number_of_requests*sizeof(synctex_display_request_s));
+    synctex_test_sn_s sn = {0,""};
+    int options, line, tag, i;
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
+    if (sn.s>0 && requests) {
+        /*  Both inputs line by line, then all the lines of both inputs, then bad requests. */
+        for (line = 1; line <= number_of_lines; ++line) {
+            requests[2*line-2] = (synctex_display_request_s){1,line};
+            requests[2*line-1] = (synctex_display_request_s){2,line};
+        }
+        requests[2*number_of_lines] = (synctex_display_request_s){1,0};
+        requests[2*number_of_lines+1] = (synctex_display_request_s){2,0};
+        requests[2*number_of_lines+2] = (synctex_display_request_s){3,0};
+        requests[2*number_of_lines+3] = (synctex_display_request_s){0,1};
+        requests[2*number_of_lines+4] = (synctex_display_request_s){1,-1};
+        for (options = 0; options <= synctex_parse_option_lazy; options += synctex_parse_option_lazy) {
+            synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_NO);
+            synctex_display_batch_p batch = NULL;
+            synctex_scanner_set_parse_options(scanner, options);
+            scanner = synctex_scanner_parse(scanner);
+            SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+            if (scanner && (batch = synctex_display_batch_new(scanner,requests,number_of_requests))) {
+                const synctex_display_result_s * results = synctex_display_batch_results(batch);
+                int count = synctex_display_batch_count(batch), number_of_line_results = 0;
+                SYNCTEX_TEST_BODY(TC, count > 0, "No batch result\n");
+                for (i = 0; i < count; ++i) {
+                    const synctex_display_result_s * R = results+i;
+                    SYNCTEX_TEST_BODY(TC, R->request < 2*number_of_lines+2, "Result for bad request %i\n",R->request);
+                    SYNCTEX_TEST_BODY(TC, i == 0 || R[-1].request < R->request
+                                      || (R[-1].request == R->request && (R[-1].line < R->line
+                                          || (R[-1].line == R->line && R[-1].page < R->page))),
+                                      "Batch results not ordered at %i\n",i);
+                    if (R->request < 2*number_of_lines) {
+                        ++number_of_line_results;
+                        SYNCTEX_TEST_BODY(TC, R->line == requests[R->request].line, "Bad line %i\n",R->line);
+                    } else {
+                        /*  All the lines of an input give the results of each line. */
+                        const synctex_display_result_s * L = _synctex_test_batch_result(batch,2*R->line-2+R->request-2*number_of_lines,R->line,R->page);
+                        SYNCTEX_TEST_BODY(TC, L && L->h == R->h && L->v == R->v && L->width == R->width && L->height == R->height,
+                                          "All lines mismatch for line %i page %i\n",R->line,R->page);
+                    }
+                }
+                SYNCTEX_TEST_BODY(TC, 2*number_of_line_results == count, "All lines count mismatch\n");
+                /*  The results of a display query are in the result of the batch for the same line. */
+                for (line = 1; line <= number_of_lines; ++line) {
+                    for (tag = 1; tag <= 2; ++tag) {
+                        int request = 2*line-3+tag;
+                        synctex_iterator_p iterator = synctex_iterator_new_display_tag(scanner,tag,line,0,-1);
+                        synctex_node_p node;
+                        if (synctex_node_line(synctex_iterator_next_result(iterator)) != line) {
+                            /*  no node for the line, the query found a neighbour */
+                            for (i = 1; i <= number_of_pages; ++i) {
+                                SYNCTEX_TEST_BODY(TC, !_synctex_test_batch_result(batch,request,line,i),
+                                                  "Unexpected result for %i:%i\n",tag,line);
+                            }
+                            synctex_iterator_free(iterator);
+                            continue;
+                        }
+                        synctex_iterator_reset(iterator);
+                        while ((node = synctex_iterator_next_result(iterator))) {
+                            const synctex_display_result_s * R = _synctex_test_batch_result(batch,request,line,synctex_node_page(node));
+                            float h = synctex_node_box_visible_h(node);
+                            float v = synctex_node_box_visible_v(node);
+                            SYNCTEX_TEST_BODY(TC, R != NULL, "Missing batch result for %i:%i page %i\n",tag,line,synctex_node_page(node));
+                            if (R) {
+                                SYNCTEX_TEST_BODY(TC, R->h <= h && h+synctex_node_box_visible_width(node) <= R->h+R->width+0.01
+                                                  && R->v <= v-synctex_node_box_visible_height(node)+0.01
+                                                  && v+synctex_node_box_visible_depth(node) <= R->v+R->height+0.01,
+                                                  "Box out of the batch result for %i:%i page %i\n",tag,line,synctex_node_page(node));
+                            }
+                        }
+                        synctex_iterator_free(iterator);
+                    }
+                }
+            }
+            synctex_display_batch_free(batch);
+            TC += synctex_scanner_free(scanner);
         }
-        TC += synctex_scanner_free(scanner);
+        SYNCTEX_TEST_BODY(TC, synctex_display_batch_new(NULL,requests,1) == NULL, "Batch without scanner\n");
         unlink(sn.n);
     } else {
         ++TC;
     }
+    free(requests);
     return TC;
 }
-int synctex_test_form() {
+/**
+ *  Compare a batch of display queries for all the lines of a synthetic synctex file
+ *  with the given number of pages, with the equivalent loop of display queries.
+ */
+int synctex_bench_display_batch(int number_of_pages) {
     int TC = 0;
-    char * content =
-    "SyncTeX Version:1  \n" /*00-19*/
-    "Input:1:./1.tex    \n" /*20-39*/
-    "Output:pdf         \n" /*40-59*/
-    "Magnification:100000000      \n" /*60-89*/
-    "Unit:1   \n"           /*90-99*/
-    "X Offset:0         \n" /*00-19*/
-    "Y Offset:0         \n" /*20-39*/
-    "Content: \n"           /*40-49*/
-    "{1       \n"           /*50-59*/
-    "[1,10:20,350:330,330,0       \n" /*60-89*/
-    "(1,58:20,100:250,10,5        \n" /*90-119*/
-    "f1000:50,100       \n" /*20-39*/
-    ")        \n"           /*40-49*/
-    "]        \n"           /*50-59*/
-    "}        \n"           /*60-69*/
-    "<1000    \n"           /*70-79*/
-    "(1,63:0,0:100,8,3  \n" /*80-99*/
-    ")        \n"           /*00-09*/
-    ">        \n"           /*10-19*/
-    "Postamble:\n";
-    synctex_test_sn_s sn = synctex_test_tmp_sn(content);
-    if (sn.s>0) {
+    int number_of_lines = 20*number_of_pages+20;
+    char * content = _synctex_test_synthetic_content(number_of_pages);
+    synctex_display_request_s * requests = (synctex_display_request_s *)malloc(2*number_of_lines*sizeof(synctex_display_request_s));
+    synctex_test_sn_s sn = {0,""};
+    if (content) {
+        sn = synctex_test_tmp_sn(content);
+        free(content);
+    }
+    if (sn.s>0 && requests) {
         synctex_scanner_p scanner = synctex_scanner_new_with_output_file(sn.n, NULL, synctex_YES);
-        synctex_node_p node = synctex_scanner_handle(scanner);
-        while (node) {
-            printf("%s\n",_synctex_node_abstract(node));
-            node = _synctex_node_next(node);
+        const char * names[2] = {"./main.tex","./chapter.tex"};
+        double t0, loop = 0, batched = 0, whole = 0;
+        int i, line, number_of_results = 0, number_of_batch_results = 0, number_of_whole_results = 0;
+        SYNCTEX_TEST_BODY(TC, scanner, "Parse failure\n");
+        if (scanner) {
+            synctex_display_request_s inputs[2] = {{1,0},{2,0}};
+            synctex_display_batch_p batch;
+            synctex_node_p node;
+            float sum = 0;
+            _synctex_scanner_display_index(scanner);
+            t0 = _synctex_test_now();
+            for (line = 1; line <= number_of_lines; ++line) {
+                for (i = 0; i < 2; ++i) {
+                    synctex_display_query(scanner,names[i],line,0,-1);
+                    while ((node = synctex_scanner_next_result(scanner))) {
+                        sum += synctex_node_box_visible_h(node)+synctex_node_box_visible_v(node);
+                        ++number_of_results;
+                    }
+                }
+            }
+            loop = _synctex_test_now()-t0;
+            for (line = 1; line <= number_of_lines; ++line) {
+                requests[2*line-2] = (synctex_display_request_s){1,line};
+                requests[2*line-1] = (synctex_display_request_s){2,line};
+            }
+            t0 = _synctex_test_now();
+            batch = synctex_display_batch_new(scanner,requests,2*number_of_lines);
+            batched = _synctex_test_now()-t0;
+            number_of_batch_results = synctex_display_batch_count(batch);
+            synctex_display_batch_free(batch);
+            t0 = _synctex_test_now();
+            batch = synctex_display_batch_new(scanner,inputs,2);
+            whole = _synctex_test_now()-t0;
+            number_of_whole_results = synctex_display_batch_count(batch);
+            synctex_display_batch_free(batch);
+            SYNCTEX_TEST_BODY(TC, sum != 0 && number_of_batch_results > 0
+                              && number_of_batch_results == number_of_whole_results, "Bad batch\n");
         }
         TC += synctex_scanner_free(scanner);
         unlink(sn.n);
+        printf("%i pages, %i lines: %i display queries %.3fs, %i results\n",
+               number_of_pages,2*number_of_lines,2*number_of_lines,loop,number_of_results);
+        printf("display batch %.3fs, %i results, all the lines of the inputs %.3fs\n",
+               batched,number_of_batch_results,whole);
     } else {
         ++TC;
     }
+    free(requests);
     return TC;
 }
+#   endif
 #endif
@@ -429,6 +429,54 @@ extern "C" {
      *      }
      */
     synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner,const char *  name,int line,int column, int page_hint);
+    synctex_iterator_p synctex_iterator_new_display_tag(synctex_scanner_p scanner,int tag,int line,int column, int page_hint);
+    /**
+     *  A batch of display queries, to map many lines or whole inputs at once.
+     *  The tag is the one of the input, see synctex_scanner_get_tag,
+     *  a line of 0 stands for all the lines of the input.
+     */
+    typedef struct {
+        int tag;
+        int line;
+    } synctex_display_request_s;
+    /**
+     *  The place of a requested line in a page.
+     *  h, v, width and height is the union of the visible boxes
+     *  of the nodes of the line in the page, in page coordinates,
+     *  v is the top of the union.
+     *  Like for a display query, the box nodes only count
+     *  when the line has no other node.
+     *  Unlike a display query, there is no result for a line without node.
+     */
+    typedef struct {
+        int request;    /*  the index of the request */
+        int line;
+        int page;
+        float h;
+        float v;
+        float width;
+        float height;
+    } synctex_display_result_s;
+    typedef struct synctex_display_batch_t * synctex_display_batch_p;
+    /**
+     *  Designated creator for a batch of display queries.
+     *  Each sheet is visited once, concurrently when possible.
+     *  The results are ordered by request, line then page.
+     *  Returns NULL on error, in particular when scanner is NULL.
+     *  Code example:
+     *      synctex_display_request_s requests[] = {{tag,0},{tag,12}};
+     *      synctex_display_batch_p batch = synctex_display_batch_new(scanner,requests,2);
+     *      const synctex_display_result_s * results = synctex_display_batch_results(batch);
+     *      int i;
+     *      for (i = 0; i < synctex_display_batch_count(batch); ++i) {
+     *          do something with results[i]...
+     *      }
+     *      synctex_display_batch_free(batch);
+     */
+    synctex_display_batch_p synctex_display_batch_new(synctex_scanner_p scanner, const synctex_display_request_s * requests, int number_of_requests);
+    int synctex_display_batch_count(synctex_display_batch_p batch);
+    const synctex_display_result_s * synctex_display_batch_results(synctex_display_batch_p batch);
+    void synctex_display_batch_free(synctex_display_batch_p batch);
     /**
      *  Designated creator for an  edit query, id est,
      *  backward navigation from output to source.
@@ -545,6 +593,26 @@ _Pragma("clang diagnostic ignored \"-Wformat-extra-args\"")
     int synctex_test_sheet_2();
     int synctex_test_sheet_3();
     int synctex_test_form();
+    int synctex_test_mapped();
+    int synctex_test_lazy();
+    int synctex_test_cache();
+    int synctex_bench_cache(int number_of_pages);
+    int synctex_test_edit_index();
+    int synctex_bench_edit_index(int number_of_pages, int number_of_nodes);
+    int synctex_test_display_index();
+    int synctex_bench_display_index(int number_of_pages);
+    int synctex_test_arena();
+    int synctex_bench_arena(int number_of_pages);
+    int synctex_test_reload();
+    int synctex_bench_reload(int number_of_pages);
+    int synctex_test_tokenizer();
+    int synctex_bench_tokenizer(const char * path, int number_of_pages);
+    int synctex_test_inflate();
+    int synctex_bench_inflate(int number_of_pages);
+    int synctex_test_input_table();
+    int synctex_bench_input_table(int number_of_inputs, int number_of_pages);
+    int synctex_test_display_batch();
+    int synctex_bench_display_batch(int number_of_pages);
 #endif
 
 #ifdef __cplusplus